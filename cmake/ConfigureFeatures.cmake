@@ -6,9 +6,12 @@
 option(ENABLE_DYNAMIC "Build with dynamic library support, if supported by the target." ON)
 option(ENABLE_EGL "Build with EGL support, if supported by the target." OFF)
 option(ENABLE_NETWORKING "Build with networking support, if supported by the target." ON)
+option(ENABLE_MP_SHARED_MEMORY "Build with the shared-memory local multiplayer transport, if supported by the target." ON)
 option(ENABLE_SCCACHE "Build with sccache instead of ccache, if available." OFF)
 option(ENABLE_ZLIB "Build with zlib support, if supported by the target." ON)
 option(ENABLE_GLSM_DEBUG "Enable debug output for GLSM." OFF)
+option(ENABLE_TRACE_RECORDER "Record zones to an in-memory ring buffer that players can save as a trace. Ignored in Tracy builds." OFF)
+option(ENABLE_MEMORY_ACCOUNTING "Count heap usage per subsystem, even without Tracy. Adds overhead to every allocation." OFF)
 
 if (ENABLE_SCCACHE)
     find_program(SCCACHE "sccache" PATHS "$ENV{HOME}/.cargo/bin")
@@ -25,16 +28,36 @@ find_package(Threads REQUIRED)
 
 if (Threads_FOUND)
     set(HAVE_THREADS ON)
+
+    if (("${CMAKE_SYSTEM_NAME}" STREQUAL "Linux") OR ("${CMAKE_SYSTEM_NAME}" STREQUAL "Android"))
+        # Telling performance and efficiency cores apart relies on Linux's sysfs
+        set(HAVE_THREAD_PLACEMENT ON)
+    endif ()
 endif ()
 
 if (ENABLE_ZLIB)
     set(HAVE_ZLIB ON)
 endif ()
 
+if (ENABLE_TRACE_RECORDER AND NOT TRACY_ENABLE)
+    set(HAVE_TRACE_RECORDER ON)
+    message(STATUS "Building with the built-in trace recorder")
+endif ()
+
+if (ENABLE_MEMORY_ACCOUNTING OR TRACY_ENABLE)
+    # Tracy builds need the per-subsystem tags for their named memory pools
+    set(HAVE_MEMORY_ACCOUNTING ON)
+    message(STATUS "Building with per-subsystem memory accounting")
+endif ()
+
 if (ENABLE_GLSM_DEBUG)
     set(HAVE_GLSM_DEBUG ON)
 endif ()
 
+if (ENABLE_VULKAN)
+    set(HAVE_VULKAN ON)
+endif ()
+
 if (ENABLE_OPENGL)
     # ENABLE_OGLRENDERER is defined by melonDS's CMakeLists.txt
     if (OPENGL_PROFILE STREQUAL "OpenGL")
@@ -144,6 +167,20 @@ if ("${CMAKE_ANDROID_ARM_NEON}" OR "${HAVE_LIBNX}" OR ("arm64" IN_LIST "${CMAKE_
     message(STATUS "Building with ARM NEON optimizations")
 endif ()
 
+if (ENABLE_MP_SHARED_MEMORY AND ("${CMAKE_SYSTEM_NAME}" STREQUAL "Linux"))
+    # The shared-memory transport sleeps on futexes, which are Linux-specific
+    find_library(LIBRT rt)
+    if (LIBRT)
+        # shm_open was in librt before glibc 2.34
+        list(APPEND CMAKE_REQUIRED_LIBRARIES ${LIBRT})
+    endif ()
+    check_symbol_exists(shm_open "sys/mman.h" HAVE_SHM_OPEN)
+    if (HAVE_SHM_OPEN)
+        set(HAVE_MP_SHARED_MEMORY ON)
+        message(STATUS "Building with the shared-memory local multiplayer transport")
+    endif ()
+endif ()
+
 if (ENABLE_NETWORKING AND (WIN32 OR UNIX) AND HAVE_DYNAMIC)
     set(HAVE_NETWORKING_DIRECT_MODE ON)
     message(STATUS "Building with support for direct-mode networking")
@@ -196,6 +233,14 @@ function(add_common_definitions TARGET)
         target_compile_definitions(${TARGET} PUBLIC HAVE_MMAP)
     endif ()
 
+    if (HAVE_MEMORY_ACCOUNTING)
+        target_compile_definitions(${TARGET} PUBLIC HAVE_MEMORY_ACCOUNTING)
+    endif ()
+
+    if (HAVE_MP_SHARED_MEMORY)
+        target_compile_definitions(${TARGET} PUBLIC HAVE_MP_SHARED_MEMORY)
+    endif ()
+
     if (HAVE_NETWORKING)
         target_compile_definitions(${TARGET} PUBLIC HAVE_NETWORKING)
 
@@ -248,6 +293,19 @@ function(add_common_definitions TARGET)
         target_compile_definitions(${TARGET} PUBLIC HAVE_THREADS)
     endif ()
 
+    if (HAVE_THREAD_PLACEMENT)
+        target_compile_definitions(${TARGET} PUBLIC HAVE_THREAD_PLACEMENT)
+    endif ()
+
+    if (HAVE_TRACE_RECORDER)
+        target_compile_definitions(${TARGET} PUBLIC HAVE_TRACE_RECORDER)
+    endif ()
+
+    if (HAVE_VULKAN)
+        # We load every Vulkan function through the frontend (see vulkan_symbol_wrapper.h)
+        target_compile_definitions(${TARGET} PUBLIC HAVE_VULKAN VK_NO_PROTOTYPES)
+    endif ()
+
     if (HAVE_ZLIB)
         target_compile_definitions(${TARGET} PUBLIC HAVE_ZLIB)
     endif ()
@@ -56,6 +56,11 @@ fetch_dependency(date "https://github.com/HowardHinnant/date" "1ead671")
 # that wasn't compiled with -fPIC, which causes linking errors when building a shared library.
 fetch_dependency(zlib "https://github.com/madler/zlib" "v1.3.1")
 
+if (ENABLE_VULKAN)
+    # Only the headers are needed; the frontend gives us the entry points at runtime
+    fetch_dependency(Vulkan-Headers "https://github.com/KhronosGroup/Vulkan-Headers" "v1.3.290")
+endif()
+
 if (TRACY_ENABLE)
     fetch_dependency(tracy "https://github.com/wolfpld/tracy" "v0.11.1")
 endif()
@@ -78,6 +83,10 @@ if (${CMAKE_MAJOR_VERSION} VERSION_GREATER_EQUAL 4)
 endif ()
 FetchContent_MakeAvailable(melonDS libretro-common embed-binaries glm zlib libslirp pntr fmt yamc span-lite date)
 
+if (ENABLE_VULKAN)
+    FetchContent_MakeAvailable(Vulkan-Headers)
+endif()
+
 if (TRACY_ENABLE)
     set(BUILD_SHARED_LIBS OFF)
     option(TRACY_DELAYED_INIT "" ON)
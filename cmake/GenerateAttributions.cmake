@@ -13,6 +13,12 @@ file(READ "${span-lite_SOURCE_DIR}/LICENSE.txt" SPAN_LITE_LICENSE)
 file(READ "${melonDS_SOURCE_DIR}/src/tiny-AES-c/unlicense.txt" TINY_AES_LICENSE)
 file(READ "${zlib_SOURCE_DIR}/LICENSE" ZLIB_LICENSE)
 
+if (HAVE_VULKAN)
+    file(READ "${vulkan-headers_SOURCE_DIR}/LICENSE.md" VULKAN_HEADERS_LICENSE)
+else ()
+    set(VULKAN_HEADERS_LICENSE "Not included in this build.")
+endif ()
+
 configure_file("${CMAKE_SOURCE_DIR}/cmake/melondsds-LICENSE.txt.in" "${CMAKE_CURRENT_BINARY_DIR}/melondsds-LICENSE.txt")
 
 # TODO: Conditionally add license for tracy
\ No newline at end of file
@@ -129,6 +129,11 @@ if (HAVE_THREADS)
         )
 endif ()
 
+if (HAVE_VULKAN)
+    target_sources(libretro-common PRIVATE ${libretro-common_SOURCE_DIR}/vulkan/vulkan_symbol_wrapper.c)
+    target_link_libraries(libretro-common PUBLIC Vulkan::Headers)
+endif ()
+
 if (HAVE_ZLIB)
     target_sources(libretro-common PRIVATE
         ${libretro-common_SOURCE_DIR}/file/archive_file_zlib.c
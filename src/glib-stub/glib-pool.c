@@ -0,0 +1,328 @@
+/*
+    Copyright 2024 Jesse Talavera
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "glib-pool.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <retro_miscellaneous.h>
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+/* The usable size of each size class's blocks; anything bigger goes to malloc */
+static const size_t SIZE_CLASSES[] = { 16, 32, 64, 128, 256, 512, 1024, 2048 };
+#define NUM_SIZE_CLASSES ARRAY_SIZE(SIZE_CLASSES)
+
+#define SLAB_SIZE (64 * 1024)
+
+/* Served by malloc, but still owned (and freed in bulk) by an arena */
+#define LARGE_CLASS UINT32_MAX
+
+/* Served by malloc because no arena was current */
+#define UNPOOLED_CLASS (UINT32_MAX - 1)
+
+/* Precedes every block, padded so that the block itself is suitably aligned for anything */
+typedef union BlockHeader
+{
+    struct
+    {
+        GPoolArena *arena;
+        size_t size; /* as requested */
+        uint32_t size_class;
+    } info;
+    max_align_t align;
+} BlockHeader;
+
+/* Precedes every slab, and the header of every large block */
+typedef union Links
+{
+    struct
+    {
+        union Links *prev;
+        union Links *next;
+    } list;
+    max_align_t align;
+} Links;
+
+/* Occupies a block while it's in a free list */
+typedef struct FreeBlock
+{
+    struct FreeBlock *next;
+} FreeBlock;
+
+struct GPoolArena
+{
+    FreeBlock *free_lists[NUM_SIZE_CLASSES];
+
+    /* The part of each size class's newest slab that hasn't been handed out yet */
+    uint8_t *slab_cursor[NUM_SIZE_CLASSES];
+    uint8_t *slab_end[NUM_SIZE_CLASSES];
+
+    Links *slabs;
+    Links *large_blocks;
+    GPoolStats stats;
+};
+
+static GPoolArena *current_arena = NULL;
+
+static BlockHeader *header_of(void *ptr)
+{
+    return ((BlockHeader *) ptr) - 1;
+}
+
+static int size_class_of(size_t size)
+{
+    for (int i = 0; i < (int) NUM_SIZE_CLASSES; ++i)
+        if (size <= SIZE_CLASSES[i])
+            return i;
+
+    return -1;
+}
+
+static void link_push(Links **head, Links *links)
+{
+    links->list.prev = NULL;
+    links->list.next = *head;
+    if (*head)
+        (*head)->list.prev = links;
+    *head = links;
+}
+
+static void link_remove(Links **head, Links *links)
+{
+    if (links->list.prev)
+        links->list.prev->list.next = links->list.next;
+    else
+        *head = links->list.next;
+
+    if (links->list.next)
+        links->list.next->list.prev = links->list.prev;
+}
+
+static void count_alloc(GPoolArena *arena, size_t size)
+{
+    GPoolStats *stats = &arena->stats;
+    stats->allocations++;
+    stats->live_blocks++;
+    stats->live_bytes += size;
+    stats->peak_live_blocks = MAX(stats->peak_live_blocks, stats->live_blocks);
+    stats->peak_live_bytes = MAX(stats->peak_live_bytes, stats->live_bytes);
+}
+
+static BlockHeader *pooled_alloc(GPoolArena *arena, int size_class)
+{
+    if (arena->free_lists[size_class])
+    { /* If we have a block of this size that was freed earlier... */
+        FreeBlock *block = arena->free_lists[size_class];
+        arena->free_lists[size_class] = block->next;
+        arena->stats.reuses++;
+        return header_of(block);
+    }
+
+    size_t stride = sizeof(BlockHeader) + SIZE_CLASSES[size_class];
+    if (!arena->slab_cursor[size_class] || arena->slab_cursor[size_class] + stride > arena->slab_end[size_class])
+    { /* If this size class's newest slab is used up (or it doesn't have one yet)... */
+        Links *slab = (Links *) malloc(SLAB_SIZE);
+        if (!slab)
+            return NULL;
+
+        link_push(&arena->slabs, slab);
+        arena->slab_cursor[size_class] = (uint8_t *) (slab + 1);
+        arena->slab_end[size_class] = ((uint8_t *) slab) + SLAB_SIZE;
+        arena->stats.slabs++;
+    }
+
+    BlockHeader *header = (BlockHeader *) arena->slab_cursor[size_class];
+    arena->slab_cursor[size_class] += stride;
+    return header;
+}
+
+static void *block_alloc(GPoolArena *arena, size_t size)
+{
+    BlockHeader *header = NULL;
+    uint32_t size_class = UNPOOLED_CLASS;
+
+    if (!arena)
+    {
+        header = (BlockHeader *) malloc(sizeof(BlockHeader) + size);
+    }
+    else if (size_class_of(size) >= 0)
+    {
+        size_class = (uint32_t) size_class_of(size);
+        header = pooled_alloc(arena, (int) size_class);
+    }
+    else
+    {
+        Links *links = (Links *) malloc(sizeof(Links) + sizeof(BlockHeader) + size);
+        if (links)
+        {
+            link_push(&arena->large_blocks, links);
+            header = (BlockHeader *) (links + 1);
+            size_class = LARGE_CLASS;
+            arena->stats.large_allocations++;
+        }
+    }
+
+    if (!header)
+        return NULL;
+
+    header->info.arena = arena;
+    header->info.size = size;
+    header->info.size_class = size_class;
+    if (arena)
+        count_alloc(arena, size);
+
+    return header + 1;
+}
+
+GPoolArena *gpool_arena_new(void)
+{
+    return (GPoolArena *) calloc(1, sizeof(GPoolArena));
+}
+
+void gpool_arena_free(GPoolArena *arena)
+{
+    if (!arena)
+        return;
+
+    if (current_arena == arena)
+        current_arena = NULL;
+
+    for (Links *slab = arena->slabs; slab;)
+    {
+        Links *next = slab->list.next;
+        free(slab);
+        slab = next;
+    }
+
+    for (Links *block = arena->large_blocks; block;)
+    {
+        Links *next = block->list.next;
+        free(block);
+        block = next;
+    }
+
+    free(arena);
+}
+
+void gpool_arena_set_current(GPoolArena *arena)
+{
+    current_arena = arena;
+}
+
+GPoolArena *gpool_arena_get_current(void)
+{
+    return current_arena;
+}
+
+void gpool_arena_get_stats(const GPoolArena *arena, GPoolStats *stats)
+{
+    if (arena && stats)
+        *stats = arena->stats;
+}
+
+void *gpool_malloc(size_t size)
+{
+    if (size == 0)
+        return NULL; /* Like the real g_malloc */
+
+    return block_alloc(current_arena, size);
+}
+
+void *gpool_malloc0(size_t size)
+{
+    void *ptr = gpool_malloc(size);
+    if (ptr)
+        memset(ptr, 0, size);
+
+    return ptr;
+}
+
+void gpool_free(void *ptr)
+{
+    if (!ptr)
+        return;
+
+    BlockHeader *header = header_of(ptr);
+    GPoolArena *arena = header->info.arena;
+    uint32_t size_class = header->info.size_class;
+
+    if (size_class == UNPOOLED_CLASS)
+    {
+        free(header);
+        return;
+    }
+
+    arena->stats.frees++;
+    arena->stats.live_blocks--;
+    arena->stats.live_bytes -= header->info.size;
+
+    if (size_class == LARGE_CLASS)
+    {
+        Links *links = ((Links *) header) - 1;
+        link_remove(&arena->large_blocks, links);
+        free(links);
+    }
+    else
+    {
+        FreeBlock *block = (FreeBlock *) ptr;
+        block->next = arena->free_lists[size_class];
+        arena->free_lists[size_class] = block;
+    }
+}
+
+void *gpool_realloc(void *ptr, size_t size)
+{
+    if (!ptr)
+        return gpool_malloc(size);
+
+    if (size == 0)
+    {
+        gpool_free(ptr);
+        return NULL;
+    }
+
+    BlockHeader *header = header_of(ptr);
+    GPoolArena *arena = header->info.arena;
+    uint32_t size_class = header->info.size_class;
+
+    if (size_class < NUM_SIZE_CLASSES && size <= SIZE_CLASSES[size_class])
+    { /* If the block already has room for the new size... */
+        arena->stats.live_bytes += size;
+        arena->stats.live_bytes -= header->info.size;
+        arena->stats.peak_live_bytes = MAX(arena->stats.peak_live_bytes, arena->stats.live_bytes);
+        header->info.size = size;
+        return ptr;
+    }
+
+    /* The new block comes from the same arena as the old one */
+    void *resized = block_alloc(arena, size);
+    if (!resized)
+        return NULL;
+
+    memcpy(resized, ptr, MIN(size, header->info.size));
+    gpool_free(ptr);
+    return resized;
+}
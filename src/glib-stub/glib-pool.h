@@ -0,0 +1,91 @@
+/*
+    Copyright 2024 Jesse Talavera
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#ifndef MELONDS_DS_GLIB_POOL_H
+#define MELONDS_DS_GLIB_POOL_H
+
+/**!
+ * @file glib-pool.h
+ * @brief Size-class pool allocator behind the glib stub's g_malloc family
+ *
+ * libslirp makes a lot of small, short-lived allocations while it's handling packets.
+ * These are served from free lists within an arena instead of going through malloc every time.
+ * An arena is made current with gpool_arena_set_current;
+ * allocations made while no arena is current go straight to malloc.
+ * Blocks always return to the arena they came from, whichever arena is current when they're freed.
+ *
+ * None of this is thread-safe; libslirp is only ever driven by one thread at a time
+ * (the emulator thread, or the indirect-mode poll thread while it holds the driver's lock).
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <retro_common_api.h>
+
+RETRO_BEGIN_DECLS
+
+typedef struct GPoolArena GPoolArena;
+
+typedef struct
+{
+    /** Allocations served by this arena since it was created, pooled or not. */
+    uint64_t allocations;
+    uint64_t frees;
+
+    /** Allocations that were served from a free list instead of fresh memory. */
+    uint64_t reuses;
+
+    /** Allocations too big for any size class, which went to malloc instead. */
+    uint64_t large_allocations;
+
+    /** Blocks that are currently allocated. */
+    uint64_t live_blocks;
+    uint64_t peak_live_blocks;
+
+    /** Requested bytes that are currently allocated. */
+    uint64_t live_bytes;
+    uint64_t peak_live_bytes;
+
+    /** Slabs that the arena has carved blocks out of. */
+    uint64_t slabs;
+} GPoolStats;
+
+GPoolArena *gpool_arena_new(void);
+
+/**
+ * Releases every slab and large block owned by the arena at once,
+ * including any that are still allocated.
+ * Nothing allocated from the arena may be used afterwards.
+ * If the arena is current, no arena will be current afterwards.
+ */
+void gpool_arena_free(GPoolArena *arena);
+
+/** Sets the arena that subsequent g_malloc calls allocate from, or NULL to use malloc. */
+void gpool_arena_set_current(GPoolArena *arena);
+GPoolArena *gpool_arena_get_current(void);
+
+void gpool_arena_get_stats(const GPoolArena *arena, GPoolStats *stats);
+
+void *gpool_malloc(size_t size);
+void *gpool_malloc0(size_t size);
+void *gpool_realloc(void *ptr, size_t size);
+void gpool_free(void *ptr);
+
+RETRO_END_DECLS
+
+#endif
@@ -7,13 +7,13 @@
 #include <string/stdstring.h>
 
 GRand *g_rand_new() {
-    GRand *rand = (GRand *) malloc(sizeof(GRand));
+    GRand *rand = g_new(GRand, 1);
     *rand = 32148920;
     return rand;
 }
 
 void g_rand_free(GRand *rand) {
-    free((void *) rand);
+    g_free(rand);
 }
 
 uint32_t g_rand_int_range(GRand *rand, uint32_t begin, uint32_t end) {
@@ -74,7 +74,15 @@ void g_debug(const char *msg, ...)
 
 gchar* g_strdup(const gchar* str)
 {
-    return str ? strdup(str) : NULL;
+    if (!str)
+        return NULL;
+
+    size_t size = strlen(str) + 1;
+    gchar *copy = (gchar *) g_malloc(size);
+    if (copy)
+        memcpy(copy, str, size);
+
+    return copy;
 }
 
 void slirp_insque(void *a, void *b)
@@ -35,6 +35,8 @@
 #include <retro_endianness.h>
 #include <retro_miscellaneous.h>
 
+#include "glib-pool.h"
+
 #define G_BIG_ENDIAN __ORDER_BIG_ENDIAN__
 #define G_LITTLE_ENDIAN __ORDER_LITTLE_ENDIAN__
 #define G_BYTE_ORDER __BYTE_ORDER__
@@ -83,9 +85,9 @@ void g_error(const char *msg, ...);
 void g_warning(const char *msg, ...);
 void g_critical(const char *msg, ...);
 
-#define g_malloc malloc
-#define g_free free
-#define g_realloc realloc
+#define g_malloc gpool_malloc
+#define g_free gpool_free
+#define g_realloc gpool_realloc
 
 gchar* g_strdup(const gchar* str);
 #define g_vsnprintf vsnprintf
@@ -96,11 +98,11 @@ gchar *g_strstr_len(const gchar *haystack, gssize haystack_len, const gchar *nee
 gboolean g_str_has_prefix(const gchar* str,const gchar* prefix);
 gint g_ascii_strcasecmp(const gchar *s1, const gchar *s2);
 
-#define g_new(typ, n) (n > 0 ? (typ*)malloc(sizeof(typ) * n) : NULL)
-#define g_new0(typ, n) (n > 0 ? (typ*)calloc(sizeof(typ), n) : NULL)
+#define g_new(typ, n) (n > 0 ? (typ*)gpool_malloc(sizeof(typ) * n) : NULL)
+#define g_new0(typ, n) (n > 0 ? (typ*)gpool_malloc0(sizeof(typ) * n) : NULL)
 
 #define g_assert assert
-#define g_malloc0(size) calloc(1, (size))
+#define g_malloc0(size) gpool_malloc0(size)
 #define g_getenv(name) getenv(name)
 
 // this can result in double evaluation, but this is how they seem to define it as well
@@ -0,0 +1,106 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "arena.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#include <retro_assert.h>
+
+#include "tracy.hpp"
+#include "tracy/memory.hpp"
+
+namespace {
+    MelonDsDs::FrameArena MainArena;
+    uint64_t LastFrameHeapAllocations = 0;
+}
+
+MelonDsDs::FrameArena::~FrameArena() noexcept {
+    Reset();
+    ::operator delete(_block);
+}
+
+void* MelonDsDs::FrameArena::Allocate(size_t size, size_t alignment) {
+    retro_assert(std::has_single_bit(alignment) && alignment <= alignof(std::max_align_t));
+    if (!_block) {
+        // If this is the first allocation...
+        _capacity = std::bit_ceil(std::max(size, INITIAL_CAPACITY));
+        _block = static_cast<std::byte*>(::operator new(_capacity));
+    }
+
+    size_t offset = (_used + alignment - 1) & ~(alignment - 1);
+    if (offset <= _capacity && size <= _capacity - offset) [[likely]] {
+        _used = offset + size;
+        return _block + offset;
+    }
+
+    // operator new's memory is aligned to max_align_t, so this satisfies any alignment we allow
+    _overflow.reserve(_overflow.size() + 1);
+    auto* chunk = static_cast<std::byte*>(::operator new(std::max<size_t>(size, 1)));
+    _overflow.push_back(chunk);
+    _overflowBytes += size;
+    return chunk;
+}
+
+void MelonDsDs::FrameArena::Reset() noexcept {
+    if (!_overflow.empty()) [[unlikely]] {
+        // If this frame needed more than the block could hold, make room for it next time
+        size_t needed = _used + _overflowBytes;
+        for (std::byte* chunk : _overflow) {
+            ::operator delete(chunk);
+        }
+        _overflow.clear();
+        _overflowBytes = 0;
+
+        ::operator delete(_block);
+        _capacity = std::bit_ceil(std::max(needed, _capacity * 2));
+        _block = static_cast<std::byte*>(::operator new(_capacity, std::nothrow));
+        if (!_block) {
+            _capacity = 0;
+        }
+    }
+
+#ifndef NDEBUG
+    if (_block) {
+        // Make anything that's still using last frame's memory easier to spot
+        memset(_block, 0xCD, _used);
+    }
+#endif
+    _used = 0;
+}
+
+MelonDsDs::FrameArena& MelonDsDs::GetFrameArena() noexcept {
+    return MainArena;
+}
+
+MelonDsDs::FrameScope::FrameScope() noexcept : _allocations(GetThreadAllocationCount()) {
+}
+
+MelonDsDs::FrameScope::~FrameScope() noexcept {
+    TracyPlot("Frame Arena Usage (KiB)", MainArena.Used() / 1024.0);
+    MainArena.Reset();
+
+    // Counted after the reset, since growing the arena allocates too
+    LastFrameHeapAllocations = GetThreadAllocationCount() - _allocations;
+    TracyPlot("Heap Allocations", static_cast<int64_t>(LastFrameHeapAllocations));
+}
+
+uint64_t MelonDsDs::GetLastFrameHeapAllocations() noexcept {
+    return LastFrameHeapAllocations;
+}
@@ -0,0 +1,125 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#ifndef MELONDSDS_ARENA_HPP
+#define MELONDSDS_ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+namespace MelonDsDs {
+    /// A bump allocator for memory that's only needed until the end of the current frame,
+    /// so that steady-state frames don't have to touch the global heap.
+    /// Everything allocated from it is freed at once by \c Reset
+    /// (which \c CoreState::Run does when it returns);
+    /// individual deallocations are no-ops.
+    ///
+    /// Not thread-safe; only use the arena returned by \c GetFrameArena
+    /// from the thread that calls \c retro_run.
+    class FrameArena {
+    public:
+        static constexpr size_t INITIAL_CAPACITY = 64 * 1024;
+
+        FrameArena() noexcept = default;
+        ~FrameArena() noexcept;
+        FrameArena(const FrameArena&) = delete;
+        FrameArena& operator=(const FrameArena&) = delete;
+        FrameArena(FrameArena&&) = delete;
+        FrameArena& operator=(FrameArena&&) = delete;
+
+        /// If this frame's allocations no longer fit in the arena's block,
+        /// the excess is allocated from the heap until the next \c Reset grows the block.
+        /// @param alignment Must be a power of two no greater than \c alignof(std::max_align_t).
+        [[nodiscard]] void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+        /// Frees everything allocated since the last reset.
+        /// If this frame didn't fit in the block, the block is grown so that the next one will.
+        void Reset() noexcept;
+
+        /// Bytes allocated since the last reset, including any that overflowed to the heap.
+        [[nodiscard]] size_t Used() const noexcept { return _used + _overflowBytes; }
+        [[nodiscard]] size_t Capacity() const noexcept { return _capacity; }
+    private:
+        std::byte* _block = nullptr;
+        size_t _capacity = 0;
+        size_t _used = 0;
+
+        // Allocations that didn't fit in the block this frame
+        std::vector<std::byte*> _overflow;
+        size_t _overflowBytes = 0;
+    };
+
+    /// The arena for the frontend's main thread.
+    [[nodiscard]] FrameArena& GetFrameArena() noexcept;
+
+    /// Allocates from \c GetFrameArena, for containers that don't outlive the current frame.
+    template<typename T>
+    class FrameAllocator {
+    public:
+        using value_type = T;
+
+        FrameAllocator() noexcept = default;
+
+        template<typename U>
+        FrameAllocator(const FrameAllocator<U>&) noexcept {}
+
+        [[nodiscard]] T* allocate(size_t n) {
+            if (n > SIZE_MAX / sizeof(T))
+                throw std::bad_array_new_length();
+
+            return static_cast<T*>(GetFrameArena().Allocate(n * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T*, size_t) noexcept {
+            // Reclaimed when the arena is reset
+        }
+
+        template<typename U>
+        bool operator==(const FrameAllocator<U>&) const noexcept { return true; }
+    };
+
+    using FrameString = std::basic_string<char, std::char_traits<char>, FrameAllocator<char>>;
+
+    template<typename T>
+    using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+    /// Like \c fmt::memory_buffer, but overflows into the frame arena instead of the heap.
+    using FrameMemoryBuffer = fmt::basic_memory_buffer<char, fmt::inline_buffer_size, FrameAllocator<char>>;
+
+    /// Delimits one frame: resets the frame arena when destroyed,
+    /// and counts the global heap allocations that this thread made in the meantime.
+    class FrameScope {
+    public:
+        FrameScope() noexcept;
+        ~FrameScope() noexcept;
+        FrameScope(const FrameScope&) = delete;
+        FrameScope& operator=(const FrameScope&) = delete;
+    private:
+        uint64_t _allocations;
+    };
+
+    /// How many times the thread that ran the last \c FrameScope allocated from the global heap during it.
+    /// Always 0 if this build doesn't count allocations (see \c HAVE_MEMORY_ACCOUNTING).
+    [[nodiscard]] uint64_t GetLastFrameHeapAllocations() noexcept;
+}
+
+#endif // MELONDSDS_ARENA_HPP
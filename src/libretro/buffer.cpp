@@ -15,21 +15,77 @@
 */
 
 #include "buffer.hpp"
+#include "pixels.hpp"
 #include "screenlayout.hpp"
 #include "tracy.hpp"
 
+#include <algorithm>
 #include <cstring>
 
+#include <memalign.h>
+#include <retro_assert.h>
+
 using glm::uvec2;
 
 MelonDsDs::PixelBuffer::PixelBuffer(unsigned width, unsigned height) noexcept :
     PixelBuffer(uvec2(width, height)) {
 }
 
-MelonDsDs::PixelBuffer::PixelBuffer(uvec2 size) noexcept :
+MelonDsDs::PixelBuffer::PixelBuffer(uvec2 size, bool padRows) noexcept :
+    size(size),
+    pitch(0),
+    padRows(padRows) {
+    pitch = PitchFor(size.x);
+    Allocate(size_t(pitch) * size.y);
+}
+
+MelonDsDs::PixelBuffer::PixelBuffer(uint32_t* external, uvec2 size, size_t stride) noexcept :
     size(size),
-    stride(size.x * sizeof(uint32_t)),
-    buffer(size.x * size.y, 0) {
+    pitch(stride / sizeof(uint32_t)),
+    data(external) {
+}
+
+MelonDsDs::PixelBuffer::PixelBuffer(const PixelBuffer& other) noexcept :
+    size(other.size),
+    pitch(other.pitch),
+    data(other.data),
+    padRows(other.padRows) {
+    if (other.storage) {
+        // If the other buffer owns its memory, then so should we
+        Allocate(size_t(pitch) * size.y);
+        memcpy(data, other.data, size_t(pitch) * size.y * sizeof(uint32_t));
+    }
+}
+
+MelonDsDs::PixelBuffer& MelonDsDs::PixelBuffer::operator=(const PixelBuffer& other) noexcept {
+    if (this != &other) {
+        *this = PixelBuffer(other);
+    }
+
+    return *this;
+}
+
+void MelonDsDs::PixelBuffer::AlignedDeleter::operator()(uint32_t* pixels) const noexcept {
+    memalign_free(pixels);
+}
+
+unsigned MelonDsDs::PixelBuffer::PitchFor(unsigned width) const noexcept {
+    if (!padRows)
+        return width;
+
+    constexpr unsigned pixelsPerAlignment = PIXEL_BUFFER_ALIGNMENT / sizeof(uint32_t);
+    return (width + pixelsPerAlignment - 1) / pixelsPerAlignment * pixelsPerAlignment;
+}
+
+void MelonDsDs::PixelBuffer::Allocate(size_t pixels) noexcept {
+    ZoneScopedN(TracyFunction);
+    // Never allocate nothing, so an owned buffer always has storage (and isn't mistaken for an external one)
+    size_t bytes = std::max<size_t>(pixels, 1) * sizeof(uint32_t);
+    storage.reset(static_cast<uint32_t*>(memalign_alloc(PIXEL_BUFFER_ALIGNMENT, bytes)));
+    retro_assert(storage != nullptr);
+    memset(storage.get(), 0, bytes);
+    capacity = std::max<size_t>(pixels, 1);
+    data = storage.get();
 }
 
 void MelonDsDs::PixelBuffer::SetSize(uvec2 newSize) noexcept {
@@ -37,28 +93,77 @@ void MelonDsDs::PixelBuffer::SetSize(uvec2 newSize) noexcept {
     if (newSize == size)
         return;
 
+    if (IsExternal()) {
+        // We don't own external memory, so we can't resize it
+        return;
+    }
+
+    unsigned newPitch = PitchFor(newSize.x);
+    size_t required = size_t(newPitch) * newSize.y;
+    if (required > capacity) {
+        // If we've never needed this much memory before...
+        Allocate(required);
+    }
+
     size = newSize;
-    stride = size.x * sizeof(uint32_t);
-    buffer.resize(size.x * size.y);
+    pitch = newPitch;
+}
+
+void MelonDsDs::PixelBuffer::Reserve(uvec2 maxSize) noexcept {
+    if (IsExternal())
+        return;
+
+    size_t required = size_t(PitchFor(maxSize.x)) * maxSize.y;
+    if (required > capacity) {
+        // If we've never needed this much memory before...
+        Allocate(required);
+    }
+}
+
+void MelonDsDs::PixelBuffer::ShrinkToFit() noexcept {
+    ZoneScopedN(TracyFunction);
+    size_t required = size_t(pitch) * size.y;
+    if (IsExternal() || capacity <= required)
+        return;
+
+    std::unique_ptr<uint32_t[], AlignedDeleter> old = std::move(storage);
+    Allocate(required);
+    memcpy(data, old.get(), required * sizeof(uint32_t));
 }
 
 void MelonDsDs::PixelBuffer::Clear() noexcept {
-    memset(buffer.data(), 0, buffer.size() * sizeof(buffer[0]));
+    if (storage) {
+        // If we own this memory, then we can clear the row padding too and do it all at once
+        memset(data, 0, size_t(pitch) * size.y * sizeof(uint32_t));
+        return;
+    }
+
+    pixels::FillRect(data, pitch, size.x, size.y, 0);
+}
+
+void MelonDsDs::PixelBuffer::Clear(uvec2 position, uvec2 extent) noexcept {
+    pixels::FillRect(data + position.y * pitch + position.x, pitch, extent.x, extent.y, 0);
 }
 
 void MelonDsDs::PixelBuffer::CopyDirect(const uint32_t* source, uvec2 destination) noexcept {
     ZoneScopedN(TracyFunction);
+    if (pitch != NDS_SCREEN_WIDTH) {
+        // If this buffer's rows are padded (e.g. it's the frontend's framebuffer)...
+        CopyRows(source, destination, NDS_SCREEN_SIZE<unsigned>);
+        return;
+    }
+
     memcpy(&this->operator[](destination), source, NDS_SCREEN_AREA<size_t> * PIXEL_SIZE);
 }
 
 void MelonDsDs::PixelBuffer::CopyRows(const uint32_t* source, uvec2 destination, uvec2 destinationSize) noexcept {
     ZoneScopedN(TracyFunction);
-    for (unsigned y = 0; y < destinationSize.y; y++) {
-        // For each row of the rendered screen...
-        memcpy(
-            &this->operator[](uvec2(destination.x, destination.y + y)),
-            source + (y * destinationSize.x),
-            destinationSize.x * PIXEL_SIZE
-        );
-    }
-}
\ No newline at end of file
+    pixels::CopyRect(
+        &this->operator[](destination),
+        pitch,
+        source,
+        destinationSize.x,
+        destinationSize.x,
+        destinationSize.y
+    );
+}
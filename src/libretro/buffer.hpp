@@ -20,52 +20,88 @@
 #include <cstddef>
 #include <cstdint>
 #include <memory>
-#include <vector>
 
 #include <glm/vec2.hpp>
 
 #include "std/span.hpp"
 
 namespace MelonDsDs {
+    /// Rows are aligned to this many bytes if padding is enabled,
+    /// and the storage itself always is.
+    constexpr size_t PIXEL_BUFFER_ALIGNMENT = 64;
+
     class PixelBuffer {
     public:
         PixelBuffer(unsigned width, unsigned height) noexcept;
-        explicit PixelBuffer(glm::uvec2 size) noexcept;
-        PixelBuffer(const PixelBuffer&) noexcept = default;
+
+        /// If \c padRows is \c true, each row is padded so that it starts on a \c PIXEL_BUFFER_ALIGNMENT boundary.
+        explicit PixelBuffer(glm::uvec2 size, bool padRows = false) noexcept;
+
+        /// Wraps memory owned by someone else (e.g. the frontend's framebuffer).
+        /// \c stride is in bytes and must be a multiple of the pixel size.
+        /// The resulting buffer can't be resized.
+        PixelBuffer(uint32_t* external, glm::uvec2 size, size_t stride) noexcept;
+        PixelBuffer(const PixelBuffer& other) noexcept;
         PixelBuffer(PixelBuffer&&) noexcept = default;
-        PixelBuffer& operator=(const PixelBuffer&) noexcept = default;
+        PixelBuffer& operator=(const PixelBuffer& other) noexcept;
         PixelBuffer& operator=(PixelBuffer&&) noexcept = default;
 
         [[nodiscard]] uint32_t operator[](glm::uvec2 pos) const noexcept {
-            return buffer[pos.y * size.x + pos.x];
+            return data[pos.y * pitch + pos.x];
         }
 
         [[nodiscard]] uint32_t& operator[](glm::uvec2 pos) noexcept {
-            return buffer[pos.y * size.x + pos.x];
+            return data[pos.y * pitch + pos.x];
         }
 
         [[nodiscard]] uint32_t* operator[](unsigned row) noexcept {
-            return buffer.data() + row * size.x;
+            return data + row * pitch;
         }
 
         [[nodiscard]] const uint32_t* operator[](unsigned row) const noexcept {
-            return buffer.data() + row * size.x;
+            return data + row * pitch;
         }
 
         [[nodiscard]] glm::uvec2 Size() const noexcept { return size; }
+
+        /// Resizes the buffer, only reallocating if it needs more memory than it's ever had.
+        /// Doesn't preserve the buffer's contents.
         void SetSize(glm::uvec2 newSize) noexcept;
+
+        /// Allocates enough memory for the buffer to be resized to \c maxSize without reallocating.
+        /// Doesn't change the current size; may discard the buffer's contents.
+        void Reserve(glm::uvec2 maxSize) noexcept;
+
+        /// Releases any memory beyond what the current size needs.
+        void ShrinkToFit() noexcept;
         [[nodiscard]] unsigned Width() const noexcept { return size.x; }
         [[nodiscard]] unsigned Height() const noexcept { return size.y; }
-        [[nodiscard]] unsigned Stride() const noexcept { return stride; }
-        [[nodiscard]] std::span<uint32_t> Buffer() noexcept { return buffer; }
-        [[nodiscard]] std::span<const uint32_t> Buffer() const noexcept { return buffer; }
+        [[nodiscard]] unsigned Stride() const noexcept { return pitch * sizeof(uint32_t); }
+        [[nodiscard]] bool IsExternal() const noexcept { return !storage && data != nullptr; }
+        [[nodiscard]] std::span<uint32_t> Buffer() noexcept { return {data, size_t(pitch) * size.y}; }
+        [[nodiscard]] std::span<const uint32_t> Buffer() const noexcept { return {data, size_t(pitch) * size.y}; }
         void Clear() noexcept;
+        /// Clears the given rectangle, which must lie within this buffer.
+        void Clear(glm::uvec2 position, glm::uvec2 extent) noexcept;
         void CopyDirect(const uint32_t* source, glm::uvec2 destination) noexcept;
         void CopyRows(const uint32_t* source, glm::uvec2 destination, glm::uvec2 destinationSize) noexcept;
     private:
+        struct AlignedDeleter {
+            void operator()(uint32_t* pixels) const noexcept;
+        };
+
+        [[nodiscard]] unsigned PitchFor(unsigned width) const noexcept;
+        void Allocate(size_t pixels) noexcept;
+
         glm::uvec2 size;
-        unsigned stride;
-        std::vector<uint32_t> buffer;
+        // Distance between the start of each row, in pixels
+        unsigned pitch;
+        // In pixels; may be more than the current size needs
+        size_t capacity = 0;
+        std::unique_ptr<uint32_t[], AlignedDeleter> storage;
+        // Points to either storage or to external memory
+        uint32_t* data = nullptr;
+        bool padRows = false;
     };
 }
 
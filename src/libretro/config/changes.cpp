@@ -0,0 +1,88 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "changes.hpp"
+
+#include <cstring>
+
+#include "config/constants.hpp"
+#include "config/definitions.hpp"
+#include "environment.hpp"
+#include "tracy.hpp"
+
+static MelonDsDs::ConfigSubsystem GetAffectedSubsystems(const char* category) noexcept {
+    using namespace MelonDsDs;
+    using namespace MelonDsDs::config;
+    if (category == nullptr)
+        return ConfigSubsystem::All;
+
+    // The renderer and screen layout are the expensive ones to rebuild,
+    // so only options in their categories should trigger them
+    if (strcmp(category, video::CATEGORY) == 0)
+        return ConfigSubsystem::Renderer | ConfigSubsystem::Screen;
+
+    if (strcmp(category, screen::CATEGORY) == 0)
+        return ConfigSubsystem::Screen;
+
+    if (strcmp(category, audio::CATEGORY) == 0)
+        return ConfigSubsystem::Audio | ConfigSubsystem::Console;
+
+    if (strcmp(category, network::CATEGORY) == 0)
+        return ConfigSubsystem::Network;
+
+    if (strcmp(category, osd::CATEGORY) == 0)
+        return ConfigSubsystem::Osd;
+
+    // System, CPU, firmware, and time options mostly take effect at the next boot
+    return ConfigSubsystem::Console;
+}
+
+void MelonDsDs::OptionChangeTracker::Snapshot() noexcept {
+    ZoneScopedN(TracyFunction);
+    _values.clear();
+    for (const retro_core_option_v2_definition& definition : config::definitions::CoreOptionDefinitions) {
+        if (definition.key) {
+            _values.insert_or_assign(definition.key, std::string(retro::get_variable(definition.key)));
+        }
+    }
+}
+
+MelonDsDs::ConfigSubsystem MelonDsDs::OptionChangeTracker::Update() noexcept {
+    ConfigSubsystem changed = Changes();
+    return changed == ConfigSubsystem::None ? ConfigSubsystem::All : changed;
+}
+
+MelonDsDs::ConfigSubsystem MelonDsDs::OptionChangeTracker::Changes() noexcept {
+    ZoneScopedN(TracyFunction);
+    bool first = _values.empty();
+    ConfigSubsystem changed = ConfigSubsystem::None;
+    for (const retro_core_option_v2_definition& definition : config::definitions::CoreOptionDefinitions) {
+        if (!definition.key)
+            continue;
+
+        std::string_view value = retro::get_variable(definition.key);
+        auto [it, inserted] = _values.try_emplace(definition.key, value);
+        if (!inserted && it->second != value) {
+            // If this option was known and has changed...
+            retro::debug("Option {} changed from \"{}\" to \"{}\"", definition.key, it->second, value);
+            changed |= GetAffectedSubsystems(definition.category_key);
+            it->second = value;
+        }
+    }
+
+    return first ? ConfigSubsystem::All : changed;
+}
@@ -0,0 +1,72 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#ifndef MELONDSDS_CONFIG_CHANGES_HPP
+#define MELONDSDS_CONFIG_CHANGES_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace MelonDsDs {
+    /// The parts of the core that \c CoreState::ApplyConfig can update independently.
+    enum class ConfigSubsystem : uint32_t {
+        None = 0,
+        Console = 1 << 0,
+        Audio = 1 << 1,
+        Screen = 1 << 2,
+        Renderer = 1 << 3,
+        Network = 1 << 4,
+        Osd = 1 << 5,
+        All = ~0u,
+    };
+
+    constexpr ConfigSubsystem operator|(ConfigSubsystem a, ConfigSubsystem b) noexcept {
+        return static_cast<ConfigSubsystem>(static_cast<uint32_t>(a) | static_cast<uint32_t>(b));
+    }
+
+    constexpr ConfigSubsystem& operator|=(ConfigSubsystem& a, ConfigSubsystem b) noexcept {
+        return a = a | b;
+    }
+
+    constexpr bool operator&(ConfigSubsystem a, ConfigSubsystem b) noexcept {
+        return (static_cast<uint32_t>(a) & static_cast<uint32_t>(b)) != 0;
+    }
+
+    /// Remembers each core option's value so that, when the frontend says options were updated,
+    /// only the subsystems whose options actually changed have to be re-applied.
+    class OptionChangeTracker {
+    public:
+        /// Records every option's current value without reporting any changes.
+        void Snapshot() noexcept;
+
+        /// Compares every option against its recorded value, then records the new values.
+        /// \returns The subsystems affected by the changed options,
+        /// or \c ConfigSubsystem::All if nothing was recorded yet or no known option changed
+        /// (in which case something we don't track must have).
+        [[nodiscard]] ConfigSubsystem Update() noexcept;
+
+        /// Like \c Update, but returns \c ConfigSubsystem::None if no known option changed.
+        /// For callers that can't assume something changed, such as a reset.
+        [[nodiscard]] ConfigSubsystem Changes() noexcept;
+    private:
+        std::unordered_map<std::string_view, std::string> _values;
+    };
+}
+
+#endif // MELONDSDS_CONFIG_CHANGES_HPP
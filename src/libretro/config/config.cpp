@@ -30,7 +30,6 @@
 #include <string_view>
 #include <utility>
 #include <vector>
-#include <sys/stat.h>
 
 #include <file/file_path.h>
 #include <streams/file_stream.h>
@@ -55,6 +54,9 @@
 #include "config/constants.hpp"
 #include "config/definitions.hpp"
 #include "config/definitions/categories.hpp"
+#include "config/jitprofile.hpp"
+#include "config/presets.hpp"
+#include "config/sysfiles.hpp"
 #include "../core/core.hpp"
 #include "embedded/melondsds_default_wfc_config.h"
 #include "environment.hpp"
@@ -63,11 +65,12 @@
 #include "input/input.hpp"
 #include "libretro.hpp"
 #include "microphone.hpp"
-#include "net/pcap.hpp"
-#include "retro/dirent.hpp"
+#include "net/net.hpp"
+#include "platform/memory.hpp"
 #include "screenlayout.hpp"
 #include "std/span.hpp"
 #include "tracy.hpp"
+#include "tracy/memory.hpp"
 
 #ifdef interface
 #undef interface
@@ -96,13 +99,20 @@ const char* const DEFAULT_HOMEBREW_SDCARD_DIR_NAME = "dldi_sd_card";
 const char* const DEFAULT_DSI_SDCARD_IMAGE_NAME = "dsi_sd_card.bin";
 const char* const DEFAULT_DSI_SDCARD_DIR_NAME = "dsi_sd_card";
 
+const initializer_list<unsigned> AUDIO_OUTPUT_RATES = {44100, 48000};
 const initializer_list<unsigned> CURSOR_TIMEOUTS = {1, 2, 3, 5, 10, 15, 20, 30, 60};
 const initializer_list<int> JOYSTICK_CURSOR_DEADZONES = {0, 5, 10, 15, 20, 25, 30, 35};
 const initializer_list<int> JOYSTICK_CURSOR_MAXSPEEDS = {1, 2, 3, 4, 5, 6, 7, 8, 9};
 const initializer_list<int> JOYSTICK_CURSOR_RESPONSES = {100, 200};
 const initializer_list<int> JOYSTICK_CURSOR_SPEEDUPS = {33, 50, 66, 150, 200, 250, 300};
+const initializer_list<unsigned> MP_RECEIVE_TIMEOUTS = {10, 25, 50, 100, 200};
 const initializer_list<unsigned> DS_POWER_OK_THRESHOLDS = {0, 10, 20, 30, 40, 50, 60, 70, 80, 90, 100};
+const initializer_list<unsigned> BATTERY_SAVER_THRESHOLDS = {10, 20, 30, 50, 100};
 const initializer_list<unsigned> POWER_UPDATE_INTERVALS = {1, 2, 3, 5, 10, 15, 20, 30, 60};
+const initializer_list<unsigned> RUN_AHEAD_FRAMES = {1, 2, 3, 4};
+const initializer_list<unsigned> FILE_READ_AHEAD_SIZES = {64, 128, 256, 512, 1024, 4096};
+const initializer_list<unsigned> REWIND_BUFFER_SIZES = {16, 32, 64, 128, 256, 512};
+const initializer_list<unsigned> REWIND_INTERVALS = {1, 2, 3, 5, 10, 15, 30, 60};
 const initializer_list<uint16_t> RUMBLE_INTENSITY_VALUES = {0, 6554, 13107, 19661, 26214, 32768, 39321, 45875, 52428, 58982, 65535};
 const initializer_list<int> RELATIVE_DAY_OFFSETS = {
     -364, -180, -150, -120, -90, -60, -30, -14, -13, -12, -11, -10, -9, -8, -7, -6, -5, -4, -3, -2, -1,
@@ -113,7 +123,8 @@ namespace MelonDsDs::config {
     static void ParseSystemOptions(CoreConfig& config) noexcept;
     static void ParseTimeOptions(CoreConfig& config) noexcept;
     static void ParseOsdOptions(CoreConfig& config) noexcept;
-    static void ParseJitOptions(CoreConfig& config) noexcept;
+    static void ParseJitOptions(CoreConfig& config, const JitProfile* profile) noexcept;
+    static void ParseThreadPlacementOptions(CoreConfig& config) noexcept;
     static void ParseHomebrewSaveOptions(CoreConfig& config) noexcept;
     static void ParseDsiStorageOptions(CoreConfig& config) noexcept;
     static void ParseFirmwareOptions(CoreConfig& config) noexcept;
@@ -122,6 +133,12 @@ namespace MelonDsDs::config {
     static void ParseScreenOptions(CoreConfig& config) noexcept;
     static void ParseVideoOptions(CoreConfig& config) noexcept;
 
+    // The current game's preset, only set while ParseConfig is running
+    static const GamePreset* ActivePreset = nullptr;
+
+    /// Like \c retro::get_variable, except that an option left at its default value
+    /// gets the current game's preset value instead (if it has one).
+    static string_view get_variable(string_view key) noexcept;
 }
 
 namespace MelonDsDs::config::definitions {
@@ -147,14 +164,88 @@ namespace MelonDsDs::config::definitions {
     // Work around a clang bug (can't compare pointers for some reason)
     static_assert(AreOptionKeysUnique());
 #endif
+
+    // Every value an option offers (including its default) must be one that its parser accepts.
+    template<typename Parser>
+    constexpr static bool ParsesAllValues(const retro_core_option_v2_definition& definition, Parser parse) {
+        for (const retro_core_option_value& value : definition.values) {
+            if (value.value == nullptr) break;
+            if (!parse(value.value)) return false;
+        }
+
+        return definition.default_value == nullptr || parse(definition.default_value);
+    }
+
+    static_assert(ParsesAllValues(ConsoleMode, MelonDsDs::ParseConsoleType));
+    static_assert(ParsesAllValues(SysfileMode, MelonDsDs::ParseSysfileMode));
+    static_assert(ParsesAllValues(BootMode, MelonDsDs::ParseBootMode));
+    static_assert(ParsesAllValues(Slot2Device, MelonDsDs::ParseSlot2Device));
+    static_assert(ParsesAllValues(StartTimeMode, MelonDsDs::ParseStartTimeMode));
+    static_assert(ParsesAllValues(Language, MelonDsDs::ParseLanguage));
+    static_assert(ParsesAllValues(Username, MelonDsDs::ParseUsernameMode));
+    static_assert(ParsesAllValues(EnableAlarm, MelonDsDs::ParseAlarmMode));
+    static_assert(ParsesAllValues(MicInput, MelonDsDs::ParseMicInputMode));
+    static_assert(ParsesAllValues(MicInputButton, MelonDsDs::ParseMicButtonMode));
+    static_assert(ParsesAllValues(BitDepth, MelonDsDs::ParseBitDepth));
+    static_assert(ParsesAllValues(AudioInterpolation, MelonDsDs::ParseInterpolation));
+    static_assert(ParsesAllValues(AudioResamplerQuality, MelonDsDs::ParseResamplerQuality));
+    static_assert(ParsesAllValues(NetworkMode, MelonDsDs::ParseNetworkMode));
+    static_assert(ParsesAllValues(FrameSkip, MelonDsDs::ParseFrameSkipMode));
+    static_assert(ParsesAllValues(LidPowerSaving, MelonDsDs::ParseLidPowerSaving));
+#ifdef HAVE_THREAD_PLACEMENT
+    static_assert(ParsesAllValues(EmulationThreadPlacement, MelonDsDs::ParseThreadPlacement));
+    static_assert(ParsesAllValues(RenderThreadPlacement, MelonDsDs::ParseThreadPlacement));
+#endif
+#ifdef HAVE_MP_SHARED_MEMORY
+    static_assert(ParsesAllValues(MpTransport, MelonDsDs::ParseMpTransport));
+#endif
+    static_assert(ParsesAllValues(ShowCursor, MelonDsDs::ParseCursorMode));
+    static_assert(ParsesAllValues(TouchMode, MelonDsDs::ParseTouchMode));
+    static_assert(ParsesAllValues(HybridSmallScreen, MelonDsDs::ParseHybridSideScreenDisplay));
+    static_assert(ParsesAllValues(HybridScreenFiltering, MelonDsDs::ParseScreenFilter));
+    static_assert(ParsesAllValues(ScreenRotation, MelonDsDs::ParseScreenRotationMethod));
+    static_assert(ParsesAllValues(ScreenLayout1, MelonDsDs::ParseScreenLayout));
+#if defined(HAVE_OPENGL) || defined(HAVE_OPENGLES)
+    static_assert(ParsesAllValues(RenderMode, MelonDsDs::ParseRenderMode));
+    static_assert(ParsesAllValues(OpenGlStateIsolation, MelonDsDs::ParseOpenGlStateIsolation));
+#endif
 }
 
-void MelonDsDs::ParseConfig(CoreConfig& config) noexcept {
+static string_view MelonDsDs::config::get_variable(string_view key) noexcept {
+    string_view value = retro::get_variable(key);
+    if (!ActivePreset) {
+        return value;
+    }
+
+    auto preset = ActivePreset->Values.find(key);
+    if (preset == ActivePreset->Values.end()) {
+        return value;
+    }
+
+    if (value.empty()) {
+        // If the frontend couldn't give us this option at all...
+        return preset->second;
+    }
+
+    for (const retro_core_option_v2_definition& definition : definitions::CoreOptionDefinitions) {
+        if (definition.key && key == definition.key) {
+            // The player's choice wins over the preset, so only replace the default
+            return definition.default_value && value == definition.default_value ? string_view(preset->second) : value;
+        }
+    }
+
+    return value;
+}
+
+void MelonDsDs::ParseConfig(CoreConfig& config, const JitProfile* jitProfile, const GamePreset* preset) noexcept {
     ZoneScopedN(TracyFunction);
+    MemoryScope memory(MemoryTag::Config);
+    config::ActivePreset = preset;
     config::ParseSystemOptions(config);
     config::ParseTimeOptions(config);
     config::ParseOsdOptions(config);
-    config::ParseJitOptions(config);
+    config::ParseJitOptions(config, jitProfile);
+    config::ParseThreadPlacementOptions(config);
     config::ParseHomebrewSaveOptions(config);
     config::ParseDsiStorageOptions(config);
     config::ParseFirmwareOptions(config);
@@ -162,12 +253,29 @@ void MelonDsDs::ParseConfig(CoreConfig& config) noexcept {
     config::ParseNetworkOptions(config);
     config::ParseScreenOptions(config);
     config::ParseVideoOptions(config);
+    config::ActivePreset = nullptr;
+}
+
+void MelonDsDs::ApplyBatterySaver(CoreConfig& config) noexcept {
+    ZoneScopedN(TracyFunction);
+    config.SetScaleFactor(std::max(1, config.ScaleFactor() / 2));
+
+    if (config.MicInputMode() == MicInputMode::HostMic) {
+        config.SetMicInputMode(MicInputMode::None);
+    }
+
+    if (config.Interpolation() != AudioInterpolation::None) {
+        config.SetInterpolation(AudioInterpolation::Linear);
+    }
+
+    if (config.FrameSkip() == FrameSkipMode::Disabled) {
+        config.SetFrameSkip(FrameSkipMode::Auto);
+    }
 }
 
 static void MelonDsDs::config::ParseSystemOptions(CoreConfig& config) noexcept {
     ZoneScopedN(TracyFunction);
     using namespace MelonDsDs::config::system;
-    using retro::get_variable;
 
     // All of these options take effect when a game starts, so there's no need to update them mid-game
 
@@ -214,6 +322,15 @@ static void MelonDsDs::config::ParseSystemOptions(CoreConfig& config) noexcept {
         config.SetDsPowerOkayThreshold(20);
     }
 
+    if (string_view value = get_variable(BATTERY_SAVER); value == values::DISABLED) {
+        config.SetBatterySaverThreshold(0);
+    } else if (optional<unsigned> threshold = ParseIntegerInList<unsigned>(value, BATTERY_SAVER_THRESHOLDS)) {
+        config.SetBatterySaverThreshold(*threshold);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", BATTERY_SAVER, values::DISABLED);
+        config.SetBatterySaverThreshold(0);
+    }
+
     if (optional<unsigned> value = ParseIntegerInList(get_variable(BATTERY_UPDATE_INTERVAL), POWER_UPDATE_INTERVALS)) {
         config.SetPowerUpdateInterval(*value);
     }
@@ -221,12 +338,97 @@ static void MelonDsDs::config::ParseSystemOptions(CoreConfig& config) noexcept {
         retro::warn("Failed to get value for {}; defaulting to 15 seconds", BATTERY_UPDATE_INTERVAL);
         config.SetPowerUpdateInterval(15);
     }
+
+    if (optional<bool> value = ParseBoolean(get_variable(storage::NDS_SAVE_DIRECT))) {
+        config.SetNdsSaveDirect(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", storage::NDS_SAVE_DIRECT, values::DISABLED);
+        config.SetNdsSaveDirect(false);
+    }
+
+    if (optional<bool> value = ParseBoolean(get_variable(storage::SAVE_JOURNAL))) {
+        config.SetSaveJournal(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", storage::SAVE_JOURNAL, values::DISABLED);
+        config.SetSaveJournal(false);
+    }
+
+    if (string_view value = get_variable(LOW_MEMORY_MODE); value == values::AUTO) {
+        config.SetLowMemoryMode(memory::IsLowMemoryDevice());
+    } else if (optional<bool> lowMemory = ParseBoolean(value)) {
+        config.SetLowMemoryMode(*lowMemory);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", LOW_MEMORY_MODE, values::AUTO);
+        config.SetLowMemoryMode(memory::IsLowMemoryDevice());
+    }
+
+    if (optional<bool> value = ParseBoolean(get_variable(SHARE_FILE_MAPPINGS))) {
+        config.SetShareFileMappings(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", SHARE_FILE_MAPPINGS, values::ENABLED);
+        config.SetShareFileMappings(true);
+    }
+
+    if (string_view value = get_variable(FILE_READ_AHEAD); value == values::DISABLED) {
+        config.SetFileReadAheadSize(0);
+    } else if (optional<unsigned> size = ParseIntegerInList<unsigned>(value, FILE_READ_AHEAD_SIZES)) {
+        config.SetFileReadAheadSize(*size);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to 256KB", FILE_READ_AHEAD);
+        config.SetFileReadAheadSize(256);
+    }
+
+    if (optional<LidPowerSaving> value = ParseLidPowerSaving(get_variable(LID_POWER_SAVING))) {
+        config.SetLidPowerSaving(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", LID_POWER_SAVING, values::ENABLED);
+        config.SetLidPowerSaving(LidPowerSaving::SkipFrames);
+    }
+
+    if (optional<bool> value = ParseBoolean(get_variable(DETERMINISTIC))) {
+        config.SetDeterministic(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", DETERMINISTIC, values::DISABLED);
+        config.SetDeterministic(false);
+    }
+
+    if (string_view value = get_variable(RUN_AHEAD); value == values::DISABLED) {
+        config.SetRunAheadFrames(0);
+    } else if (optional<unsigned> frames = ParseIntegerInList<unsigned>(value, RUN_AHEAD_FRAMES)) {
+        config.SetRunAheadFrames(*frames);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", RUN_AHEAD, values::DISABLED);
+        config.SetRunAheadFrames(0);
+    }
+
+#ifdef HAVE_ZLIB
+    if (string_view value = get_variable(REWIND_BUFFER_SIZE); value == values::DISABLED) {
+        config.SetRewindBufferSize(0);
+    } else if (optional<unsigned> size = ParseIntegerInList<unsigned>(value, REWIND_BUFFER_SIZES)) {
+        config.SetRewindBufferSize(*size);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", REWIND_BUFFER_SIZE, values::DISABLED);
+        config.SetRewindBufferSize(0);
+    }
+
+    if (optional<unsigned> value = ParseIntegerInList(get_variable(REWIND_INTERVAL), REWIND_INTERVALS)) {
+        config.SetRewindInterval(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to 5 frames", REWIND_INTERVAL);
+        config.SetRewindInterval(5);
+    }
+#endif
+
+    if (config.Deterministic() && config.UseRealLightSensor()) {
+        // The other players' light sensors won't read the same thing
+        retro::info("Ignoring the host's light sensor for deterministic emulation");
+        config.SetUseRealLightSensor(false);
+    }
 }
 
 void MelonDsDs::config::ParseTimeOptions(CoreConfig& config) noexcept {
     ZoneScopedN(TracyFunction);
     using namespace MelonDsDs::config::time;
-    using retro::get_variable;
 
     if (optional<StartTimeMode> value = ParseStartTimeMode(get_variable(definitions::StartTimeMode.key))) {
         config.SetStartTimeMode(*value);
@@ -314,7 +516,6 @@ void MelonDsDs::config::ParseTimeOptions(CoreConfig& config) noexcept {
 void MelonDsDs::config::ParseOsdOptions(CoreConfig& config) noexcept {
     ZoneScopedN(TracyFunction);
     using namespace MelonDsDs::config::osd;
-    using retro::get_variable;
 
 #ifndef NDEBUG
     if (optional<bool> value = ParseBoolean(get_variable(osd::POINTER_COORDINATES))) {
@@ -373,12 +574,41 @@ void MelonDsDs::config::ParseOsdOptions(CoreConfig& config) noexcept {
         retro::warn("Failed to get value for {}; defaulting to {}", SENSOR_READING, definitions::ShowSensorReading.default_value);
         config.SetShowSensorReading(true);
     }
+
+    if (optional<bool> value = ParseBoolean(get_variable(osd::FRAME_TIMINGS))) {
+        config.SetShowFrameTimings(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", FRAME_TIMINGS, values::DISABLED);
+        config.SetShowFrameTimings(false);
+    }
+
+    if (optional<bool> value = ParseBoolean(get_variable(osd::PERFORMANCE_OVERLAY))) {
+        config.SetShowPerformanceOverlay(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", PERFORMANCE_OVERLAY, values::DISABLED);
+        config.SetShowPerformanceOverlay(false);
+    }
+
+    if (optional<bool> value = ParseBoolean(get_variable(osd::MP_STATS))) {
+        config.SetShowMpStats(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", MP_STATS, values::DISABLED);
+        config.SetShowMpStats(false);
+    }
+
+#ifdef HAVE_TRACE_RECORDER
+    if (optional<bool> value = ParseBoolean(get_variable(osd::SAVE_TRACE))) {
+        config.SetSaveTraceRequested(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", SAVE_TRACE, values::DISABLED);
+        config.SetSaveTraceRequested(false);
+    }
+#endif
 }
 
-static void MelonDsDs::config::ParseJitOptions(CoreConfig& config) noexcept {
+static void MelonDsDs::config::ParseJitOptions(CoreConfig& config, const JitProfile* profile) noexcept {
 #ifdef HAVE_JIT
     ZoneScopedN(TracyFunction);
-    using retro::get_variable;
 
     if (optional<bool> value = ParseBoolean(get_variable(cpu::JIT_ENABLE))) {
         config.SetJitEnable(*value);
@@ -394,6 +624,13 @@ static void MelonDsDs::config::ParseJitOptions(CoreConfig& config) noexcept {
         config.SetMaxBlockSize(32);
     }
 
+    if (optional<bool> value = ParseBoolean(get_variable(cpu::JIT_AUTO_TUNE))) {
+        config.SetJitAutoTune(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", cpu::JIT_AUTO_TUNE, values::DISABLED);
+        config.SetJitAutoTune(false);
+    }
+
     if (optional<bool> value = ParseBoolean(get_variable(cpu::JIT_BRANCH_OPTIMISATIONS))) {
         config.SetBranchOptimizations(*value);
     } else {
@@ -421,12 +658,52 @@ static void MelonDsDs::config::ParseJitOptions(CoreConfig& config) noexcept {
 #endif
     }
 #endif
+
+    if (config.Deterministic()) {
+        // The JIT tracks cycles per block, and blocks are compiled from wherever execution happens to enter them,
+        // so a player who just loaded a savestate could count cycles differently from one who didn't
+        if (config.JitEnable()) {
+            retro::info("Disabling the JIT recompiler for deterministic emulation");
+        }
+        config.SetJitEnable(false);
+        config.SetJitAutoTune(false);
+        return; // Per-game JIT profiles are local files, so they'd differ between players anyway
+    }
+
+    if (profile) {
+        // If this game has its own JIT settings, they win over the global ones
+        if (profile->MaxBlockSize) config.SetMaxBlockSize(*profile->MaxBlockSize);
+        if (profile->BranchOptimizations) config.SetBranchOptimizations(*profile->BranchOptimizations);
+        if (profile->LiteralOptimizations) config.SetLiteralOptimizations(*profile->LiteralOptimizations);
+#ifdef HAVE_JIT_FASTMEM
+        if (profile->FastMemory) config.SetFastMemory(*profile->FastMemory);
+#endif
+    }
+#endif
+}
+
+static void MelonDsDs::config::ParseThreadPlacementOptions(CoreConfig& config) noexcept {
+    ZoneScopedN(TracyFunction);
+#ifdef HAVE_THREAD_PLACEMENT
+
+    if (optional<ThreadPlacement> value = ParseThreadPlacement(get_variable(cpu::EMULATION_THREAD_PLACEMENT))) {
+        config.SetEmulationThreadPlacement(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", cpu::EMULATION_THREAD_PLACEMENT, values::AUTO);
+        config.SetEmulationThreadPlacement(ThreadPlacement::Any);
+    }
+
+    if (optional<ThreadPlacement> value = ParseThreadPlacement(get_variable(cpu::RENDER_THREAD_PLACEMENT))) {
+        config.SetRenderThreadPlacement(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", cpu::RENDER_THREAD_PLACEMENT, values::AUTO);
+        config.SetRenderThreadPlacement(ThreadPlacement::Any);
+    }
 #endif
 }
 
 static void MelonDsDs::config::ParseHomebrewSaveOptions(CoreConfig& config) noexcept {
     ZoneScopedN(TracyFunction);
-    using retro::get_variable;
 
     optional<string_view> save_directory = retro::get_save_subdirectory();
     if (!save_directory) {
@@ -475,7 +752,22 @@ static void MelonDsDs::config::ParseHomebrewSaveOptions(CoreConfig& config) noex
 
 static void MelonDsDs::config::ParseDsiStorageOptions(CoreConfig& config) noexcept {
     ZoneScopedN(TracyFunction);
-    using retro::get_variable;
+
+    if (optional<bool> value = ParseBoolean(get_variable(storage::DSIWARE_KEEP_INSTALLED))) {
+        config.SetDsiwareKeepInstalled(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", storage::DSIWARE_KEEP_INSTALLED, values::DISABLED);
+        config.SetDsiwareKeepInstalled(false);
+    }
+
+#ifdef HAVE_NETWORKING
+    if (optional<bool> value = ParseBoolean(get_variable(storage::DSIWARE_TMD_PREFETCH))) {
+        config.SetDsiwareTmdPrefetch(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", storage::DSIWARE_TMD_PREFETCH, values::DISABLED);
+        config.SetDsiwareTmdPrefetch(false);
+    }
+#endif
 
     if (optional<bool> value = ParseBoolean(get_variable(storage::DSI_SD_READ_ONLY))) {
         config.SetDsiSdReadOnly(*value);
@@ -541,7 +833,6 @@ static void MelonDsDs::config::ParseDsiStorageOptions(CoreConfig& config) noexce
 
 static void MelonDsDs::config::ParseFirmwareOptions(CoreConfig& config) noexcept {
     ZoneScopedN(TracyFunction);
-    using retro::get_variable;
 
     if (optional<MelonDsDs::FirmwareLanguage> value = ParseLanguage(get_variable(firmware::LANGUAGE))) {
         config.SetLanguage(*value);
@@ -623,7 +914,6 @@ static void MelonDsDs::config::ParseFirmwareOptions(CoreConfig& config) noexcept
 static void MelonDsDs::config::ParseAudioOptions(CoreConfig& config) noexcept {
     ZoneScopedN(TracyFunction);
     using namespace MelonDsDs::config::audio;
-    using retro::get_variable;
 
     if (optional<MicButtonMode> value = ParseMicButtonMode(get_variable(MIC_INPUT_BUTTON))) {
         config.SetMicButtonMode(*value);
@@ -639,6 +929,12 @@ static void MelonDsDs::config::ParseAudioOptions(CoreConfig& config) noexcept {
         config.SetMicInputMode(MicInputMode::None);
     }
 
+    if (config.Deterministic() && config.MicInputMode() == MicInputMode::HostMic) {
+        // Each player's microphone hears something different
+        retro::info("Substituting a blowing sound for the host microphone for deterministic emulation");
+        config.SetMicInputMode(MicInputMode::Blow);
+    }
+
     if (optional<AudioBitDepth> value = ParseBitDepth(get_variable(AUDIO_BITDEPTH))) {
         config.SetBitDepth(*value);
     } else {
@@ -652,11 +948,40 @@ static void MelonDsDs::config::ParseAudioOptions(CoreConfig& config) noexcept {
         retro::warn("Failed to get value for {}; defaulting to {}", AUDIO_INTERPOLATION, values::DISABLED);
         config.SetInterpolation(AudioInterpolation::None);
     }
+
+    if (optional<bool> value = ParseBoolean(get_variable(AUDIO_RATE_CONTROL))) {
+        config.SetAudioRateControl(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", AUDIO_RATE_CONTROL, values::DISABLED);
+        config.SetAudioRateControl(false);
+    }
+
+    if (optional<bool> value = ParseBoolean(get_variable(AUDIO_CALLBACK))) {
+        config.SetAudioCallback(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", AUDIO_CALLBACK, values::DISABLED);
+        config.SetAudioCallback(false);
+    }
+
+    if (string_view value = get_variable(AUDIO_OUTPUT_RATE); value == values::NATIVE) {
+        config.SetAudioOutputRate(std::nullopt);
+    } else if (optional<unsigned> rate = ParseIntegerInList<unsigned>(value, AUDIO_OUTPUT_RATES)) {
+        config.SetAudioOutputRate(*rate);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", AUDIO_OUTPUT_RATE, values::NATIVE);
+        config.SetAudioOutputRate(std::nullopt);
+    }
+
+    if (optional<MelonDsDs::ResamplerQuality> value = ParseResamplerQuality(get_variable(AUDIO_RESAMPLER_QUALITY))) {
+        config.SetResamplerQuality(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", AUDIO_RESAMPLER_QUALITY, values::BALANCED);
+        config.SetResamplerQuality(MelonDsDs::ResamplerQuality::Balanced);
+    }
 }
 
 static void MelonDsDs::config::ParseNetworkOptions(CoreConfig& config) noexcept {
     ZoneScopedN(TracyFunction);
-    using retro::get_variable;
 
 #ifdef HAVE_NETWORKING
     if (optional<NetworkMode> value = ParseNetworkMode(get_variable(network::NETWORK_MODE))) {
@@ -731,12 +1056,34 @@ static void MelonDsDs::config::ParseNetworkOptions(CoreConfig& config) noexcept
         retro::warn("Failed to get value for {}; defaulting to existing firmware value", network::MAC_ADDRESS_MODE);
         config.SetMacAddress(nullopt);
     }
+
+    if (optional<bool> value = ParseBoolean(get_variable(network::MP_PACKET_BATCHING))) {
+        config.SetMpPacketBatching(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", network::MP_PACKET_BATCHING, values::DISABLED);
+        config.SetMpPacketBatching(false);
+    }
+
+    if (optional<unsigned> value = ParseIntegerInList<unsigned>(get_variable(network::MP_RECEIVE_TIMEOUT), MP_RECEIVE_TIMEOUTS)) {
+        config.SetMpReceiveTimeout(std::chrono::milliseconds(*value));
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}ms", network::MP_RECEIVE_TIMEOUT, MpState::DEFAULT_RECV_TIMEOUT.count());
+        config.SetMpReceiveTimeout(MpState::DEFAULT_RECV_TIMEOUT);
+    }
+
+#ifdef HAVE_MP_SHARED_MEMORY
+    if (optional<MpTransport> value = ParseMpTransport(get_variable(network::MP_TRANSPORT))) {
+        config.SetMpTransport(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", network::MP_TRANSPORT, values::NETPLAY);
+        config.SetMpTransport(MpTransport::Netplay);
+    }
+#endif
 }
 
 static void MelonDsDs::config::ParseScreenOptions(CoreConfig& config) noexcept {
     ZoneScopedN(TracyFunction);
     using namespace MelonDsDs::config::screen;
-    using retro::get_variable;
 
     if (optional<unsigned> value = ParseIntegerInRange<unsigned>(get_variable(SCREEN_GAP),0, 126)) {
         config.SetScreenGap(*value);
@@ -745,6 +1092,13 @@ static void MelonDsDs::config::ParseScreenOptions(CoreConfig& config) noexcept {
         config.SetScreenGap(0);
     }
 
+    if (optional<ScreenRotationMethod> value = ParseScreenRotationMethod(get_variable(SCREEN_ROTATION))) {
+        config.SetScreenRotation(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", SCREEN_ROTATION, values::AUTO);
+        config.SetScreenRotation(ScreenRotationMethod::Auto);
+    }
+
     if (optional<unsigned> value = ParseIntegerInList<unsigned>(get_variable(CURSOR_TIMEOUT), CURSOR_TIMEOUTS)) {
         config.SetCursorTimeout(*value);
     } else {
@@ -831,7 +1185,6 @@ static void MelonDsDs::config::ParseScreenOptions(CoreConfig& config) noexcept {
 static void MelonDsDs::config::ParseVideoOptions(CoreConfig& config) noexcept {
     ZoneScopedN(TracyFunction);
     using namespace MelonDsDs::config::video;
-    using retro::get_variable;
 
     if (optional<ScreenFilter> value = ParseScreenFilter(get_variable(OPENGL_FILTERING))) {
         config.SetScreenFilter(*value);
@@ -849,6 +1202,45 @@ static void MelonDsDs::config::ParseVideoOptions(CoreConfig& config) noexcept {
     }
 #endif
 
+#ifdef HAVE_THREADS
+    if (optional<bool> value = ParseBoolean(get_variable(PIPELINED_COMPOSITION))) {
+        config.SetPipelinedComposition(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", PIPELINED_COMPOSITION, values::DISABLED);
+        config.SetPipelinedComposition(false);
+    }
+
+    if (optional<bool> value = ParseBoolean(get_variable(PARALLEL_COMPOSITION))) {
+        config.SetParallelComposition(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", PARALLEL_COMPOSITION, values::DISABLED);
+        config.SetParallelComposition(false);
+    }
+
+    if (string_view value = get_variable(PARALLEL_COMPOSITION_THREADS); value == values::AUTO) {
+        config.SetParallelCompositionThreads(0);
+    } else if (optional<unsigned> threads = ParseIntegerInRange<unsigned>(value, 2, MAX_PARALLEL_COMPOSITION_THREADS)) {
+        config.SetParallelCompositionThreads(*threads);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", PARALLEL_COMPOSITION_THREADS, values::AUTO);
+        config.SetParallelCompositionThreads(0);
+    }
+#endif
+
+    if (optional<FrameSkipMode> value = ParseFrameSkipMode(get_variable(FRAMESKIP))) {
+        config.SetFrameSkip(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", FRAMESKIP, values::DISABLED);
+        config.SetFrameSkip(FrameSkipMode::Disabled);
+    }
+
+    if (optional<bool> value = ParseBoolean(get_variable(RGB565_OUTPUT))) {
+        config.SetRgb565Output(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", RGB565_OUTPUT, values::DISABLED);
+        config.SetRgb565Output(false);
+    }
+
 #if defined(HAVE_OPENGL) || defined(HAVE_OPENGLES)
     if (optional<RenderMode> renderer = ParseRenderMode(get_variable(RENDER_MODE))) {
         config.SetConfiguredRenderer(*renderer);
@@ -864,6 +1256,34 @@ static void MelonDsDs::config::ParseVideoOptions(CoreConfig& config) noexcept {
         config.SetScaleFactor(1);
     }
 
+    if (optional<bool> value = ParseBoolean(get_variable(OPENGL_DYNAMIC_RESOLUTION))) {
+        config.SetDynamicResolution(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", OPENGL_DYNAMIC_RESOLUTION, values::DISABLED);
+        config.SetDynamicResolution(false);
+    }
+
+    if (optional<unsigned> value = ParseIntegerInRange<unsigned>(get_variable(OPENGL_MIN_RESOLUTION), 1, MAX_OPENGL_SCALE)) {
+        config.SetMinScaleFactor(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to 1", OPENGL_MIN_RESOLUTION);
+        config.SetMinScaleFactor(1);
+    }
+
+    if (optional<unsigned> value = ParseIntegerInRange<unsigned>(get_variable(OPENGL_FRAMES_IN_FLIGHT), 1, MAX_FRAMES_IN_FLIGHT)) {
+        config.SetMaxFramesInFlight(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to 2", OPENGL_FRAMES_IN_FLIGHT);
+        config.SetMaxFramesInFlight(2);
+    }
+
+    if (optional<OpenGlStateIsolation> value = ParseOpenGlStateIsolation(get_variable(OPENGL_STATE_ISOLATION))) {
+        config.SetStateIsolation(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", OPENGL_STATE_ISOLATION, values::AUTO);
+        config.SetStateIsolation(OpenGlStateIsolation::Auto);
+    }
+
     if (optional<bool> value = ParseBoolean(get_variable(OPENGL_BETTER_POLYGONS))) {
         config.SetBetterPolygonSplitting(*value);
     } else {
@@ -871,41 +1291,40 @@ static void MelonDsDs::config::ParseVideoOptions(CoreConfig& config) noexcept {
         config.SetBetterPolygonSplitting(false);
     }
 #endif
-}
 
-struct FirmwareEntry {
-    std::string path;
-    Firmware::FirmwareHeader header;
-    struct stat stat;
-};
+#if defined(HAVE_OPENGL) || defined(HAVE_OPENGLES) || defined(HAVE_VULKAN)
+    if (optional<bool> value = ParseBoolean(get_variable(GPU_COMPOSITION))) {
+        config.SetGpuComposition(*value);
+    } else {
+        retro::warn("Failed to get value for {}; defaulting to {}", GPU_COMPOSITION, values::DISABLED);
+        config.SetGpuComposition(false);
+    }
+#endif
+}
 
 struct MacAddressEntry {
     std::string description;
     std::string printedAddress;
 };
 
-static time_t NewestTimestamp(const struct stat& statbuf) noexcept {
-    return std::max({statbuf.st_atime, statbuf.st_mtime, statbuf.st_ctime});
-}
-
-static bool ConsoleTypeMatches(const Firmware::FirmwareHeader& header, MelonDsDs::ConsoleType type) noexcept {
+static bool ConsoleTypeMatches(Firmware::FirmwareConsoleType consoleType, MelonDsDs::ConsoleType type) noexcept {
     if (type == MelonDsDs::ConsoleType::DS) {
-        return header.ConsoleType == Firmware::FirmwareConsoleType::DS || header.ConsoleType == Firmware::FirmwareConsoleType::DSLite;
+        return consoleType == Firmware::FirmwareConsoleType::DS || consoleType == Firmware::FirmwareConsoleType::DSLite;
     }
     else {
-        return header.ConsoleType == Firmware::FirmwareConsoleType::DSi;
+        return consoleType == Firmware::FirmwareConsoleType::DSi;
     }
 }
 
-static const char* SelectDefaultFirmware(const vector<FirmwareEntry>& images, MelonDsDs::ConsoleType type) noexcept {
+static const char* SelectDefaultFirmware(const vector<const MelonDsDs::SystemFile*>& images, MelonDsDs::ConsoleType type) noexcept {
     ZoneScopedN(TracyFunction);
     using namespace MelonDsDs;
 
     optional<string_view> sysdir = retro::get_system_directory();
 
-    const auto& best = std::max_element(images.begin(), images.end(), [type](const FirmwareEntry& a, const FirmwareEntry& b) {
-        bool aMatches = ConsoleTypeMatches(a.header, type);
-        bool bMatches = ConsoleTypeMatches(b.header, type);
+    const auto& best = std::max_element(images.begin(), images.end(), [type](const SystemFile* a, const SystemFile* b) {
+        bool aMatches = ConsoleTypeMatches(a->ConsoleType, type);
+        bool bMatches = ConsoleTypeMatches(b->ConsoleType, type);
 
         if (!aMatches && bMatches) {
             // If the second image matches but the first doesn't, the second is automatically better
@@ -917,28 +1336,20 @@ static const char* SelectDefaultFirmware(const vector<FirmwareEntry>& images, Me
         }
 
         // Both (or neither) images match the console type, so pick the one with the newest timestamp
-        return NewestTimestamp(a.stat) < NewestTimestamp(b.stat);
+        return a->Timestamp < b->Timestamp;
     });
 
     retro_assert(best != images.end());
 
-    string_view name = best->path;
+    string_view name = (*best)->Path;
     name.remove_prefix(sysdir->size() + 1);
 
     return name.data();
 }
 
-#ifdef HAVE_NETWORKING_DIRECT_MODE
-struct AdapterOption {
-    AdapterData adapter;
-    string value;
-    string label;
-};
-#endif
-
 // If I make an option depend on the game (e.g. different defaults for different games),
 // then I can have set_core_option accept a NDSHeader
-bool MelonDsDs::RegisterCoreOptions() noexcept {
+bool MelonDsDs::RegisterCoreOptions(std::span<const AdapterOption> adapters, std::span<const SystemFile> systemFiles) noexcept {
     ZoneScopedN(TracyFunction);
     using namespace MelonDsDs::config;
 
@@ -947,34 +1358,25 @@ bool MelonDsDs::RegisterCoreOptions() noexcept {
 
     optional<string_view> subdir = retro::get_system_subdirectory();
 
-    vector<string> dsiNandPaths;
-    vector<FirmwareEntry> firmware;
+    vector<string_view> dsiNandPaths;
+    vector<const SystemFile*> firmware;
     vector<MacAddressEntry> macAddresses;
     optional<string_view> sysdir = retro::get_system_directory();
 
     if (subdir) {
         ZoneScopedN("MelonDsDs::config::set_core_options::find_system_files");
         retro_assert(sysdir.has_value());
-        u8 headerBytes[sizeof(Firmware::FirmwareHeader)];
-        Firmware::FirmwareHeader& header = *reinterpret_cast<Firmware::FirmwareHeader*>(headerBytes);
-        memset(headerBytes, 0, sizeof(headerBytes));
-        array paths = {*sysdir, *subdir};
-        for (const string_view& path: paths) {
-            ZoneScopedN("MelonDsDs::config::set_core_options::find_system_files::paths");
-            for (const retro::dirent& d : retro::readdir(string(path), true)) {
-                ZoneScopedN("MelonDsDs::config::set_core_options::find_system_files::paths::dirent");
-                // TODO: Pick a particular file name and load MAC addresses from it (one per line)
-
-                if (IsDsiNandImage(d)) {
-                    dsiNandPaths.emplace_back(d.path);
-                } else if (IsFirmwareImage(d, header)) {
-                    struct stat statbuf;
-                    stat(d.path, &statbuf);
-                    firmware.emplace_back(FirmwareEntry {d.path, header, statbuf});
-                }
+        // TODO: Pick a particular file name and load MAC addresses from it (one per line)
+        for (const SystemFile& file : systemFiles) {
+            if (!string_view(file.Path).starts_with(*sysdir))
+                continue; // Left over from a different system directory
+
+            if (file.Type == SystemFileType::DsiNand) {
+                dsiNandPaths.emplace_back(file.Path);
+            } else if (file.Type == SystemFileType::Firmware) {
+                firmware.push_back(&file);
             }
         }
-
     } else {
         retro::set_error_message("Failed to get system directory, anything that needs it won't work.");
     }
@@ -1017,8 +1419,8 @@ bool MelonDsDs::RegisterCoreOptions() noexcept {
 
         int length = std::min((int)firmware.size(), (int)RETRO_NUM_CORE_OPTION_VALUES_MAX - 1);
         for (int i = 0; i < length; ++i) {
-            retro::debug("Found a firmware image at \"{}\"", firmware[i].path);
-            string_view path = firmware[i].path;
+            retro::debug("Found a firmware image at \"{}\"", firmware[i]->Path);
+            string_view path = firmware[i]->Path;
             path.remove_prefix(sysdir->size() + 1);
             firmwarePathOption->values[i] = { path.data(), nullptr };
             firmwarePathDsiOption->values[i] = { path.data(), nullptr };
@@ -1051,18 +1453,13 @@ bool MelonDsDs::RegisterCoreOptions() noexcept {
         }
     }
 
-    // TODO: Pass in the LibPCap instance created by NetState
     // TODO: Create a DynamicOption class, pass in instances of that
 
 #ifdef HAVE_NETWORKING_DIRECT_MODE
-    // holds on to strings used in dynamic options until we finish submitting the options to the frontend
-    // DO NOT move this into a deeper scope, or else the strings that the options point to will be destroyed
-    // ReSharper disable once CppTooWideScope
-    vector<AdapterOption> adapters;
-    if (std::optional<LibPCap> pcap = LibPCap::New(); pcap) {
+    if (!adapters.empty()) {
         ZoneScopedN("MelonDsDs::config::set_core_options::init_adapter_options");
-        // If we successfully initialized PCap and got some adapters...
-        vector<AdapterData> availableAdapters = pcap->GetAdapters();
+        // If we know of any adapters that might work...
+        // (The strings are owned by NetState, so they'll outlive this function)
         retro_core_option_v2_definition* wifiAdapterOption = find_if(definitions.begin(), definitions.end(), [](const auto& def) {
             return string_is_equal(def.key, MelonDsDs::config::network::DIRECT_NETWORK_INTERFACE);
         });
@@ -1070,37 +1467,12 @@ bool MelonDsDs::RegisterCoreOptions() noexcept {
 
         // Zero all option values except for the first (Automatic)
         memset(wifiAdapterOption->values + 1, 0, sizeof(retro_core_option_value) * (RETRO_NUM_CORE_OPTION_VALUES_MAX - 1));
-        for (const AdapterData& adapter : availableAdapters) {
-            if (IsAdapterAcceptable(adapter) && adapters.size() < RETRO_NUM_CORE_OPTION_VALUES_MAX - 1) {
-                // If this interface would potentially work, and we haven't added the max...
-                string mac = fmt::format("{:02x}", fmt::join(adapter.MAC, ":"));
-                retro::debug(
-                    "Found a \"{}\" ({}) interface with ID {} at {} bound to {} ({})",
-                    adapter.FriendlyName,
-                    adapter.Description,
-                    adapter.DeviceName,
-                    mac,
-                    fmt::join(adapter.IP_v4, "."),
-                    static_cast<FormattedPCapFlags>(adapter.Flags)
-                );
-
-                string label = fmt::format("{} ({})", string_is_empty(adapter.FriendlyName) ? adapter.DeviceName : adapter.FriendlyName, mac);
-                adapters.emplace_back(AdapterOption {
-                    .adapter = adapter,
-                    .value = std::move(mac),
-                    .label = std::move(label),
-                });
-            }
-        }
-
         int numAdapters = std::min<int>(RETRO_NUM_CORE_OPTION_VALUES_MAX - 2, adapters.size());
         for (int i = 0; i < numAdapters; ++i) {
             const AdapterOption& adapter = adapters[i];
-            wifiAdapterOption->values[i + 1] = { adapter.value.c_str(), adapter.label.c_str() };
+            wifiAdapterOption->values[i + 1] = { adapter.Value.c_str(), adapter.Label.c_str() };
         }
         wifiAdapterOption->values[numAdapters + 1] = { nullptr, nullptr };
-    } else {
-        retro::warn("Failed to enumerate Wi-fi adapters");
     }
 #endif
 
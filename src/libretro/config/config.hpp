@@ -19,6 +19,7 @@
 
 #undef isnan
 
+#include <algorithm>
 #include <array>
 #include <chrono>
 #include <cstdint>
@@ -32,6 +33,7 @@
 
 #include "parse.hpp"
 #include "definitions.hpp"
+#include "net/mp.hpp"
 #include "std/span.hpp"
 #include "types.hpp"
 #include "std/chrono.hpp"
@@ -57,10 +59,27 @@ namespace MelonDsDs {
     class ScreenLayoutData;
     class InputState;
     class CoreConfig;
+    struct AdapterOption;
+    struct SystemFile;
 
-    void ParseConfig(CoreConfig& config) noexcept;
+    struct GamePreset;
+    struct JitProfile;
 
-    bool RegisterCoreOptions() noexcept;
+    /// @param jitProfile The current game's JIT profile, if it has one;
+    /// its settings take precedence over the JIT options.
+    /// @param preset The current game's preset, if it has one;
+    /// its values replace those of any options that are at their defaults.
+    void ParseConfig(CoreConfig& config, const JitProfile* jitProfile = nullptr, const GamePreset* preset = nullptr) noexcept;
+
+    /// Scales back the settings that cost the most power (without affecting emulation),
+    /// for use while the host's battery is low.
+    void ApplyBatterySaver(CoreConfig& config) noexcept;
+
+    /// @param adapters The network adapters to offer in the Wi-Fi interface option
+    /// (in addition to "Automatic"); ignored without direct-mode networking.
+    /// @param systemFiles The indexed system directory (see \c SystemFileIndex),
+    /// used to offer firmware and DSi NAND images.
+    bool RegisterCoreOptions(std::span<const AdapterOption> adapters, std::span<const SystemFile> systemFiles) noexcept;
 
     using std::string;
     using std::string_view;
@@ -82,6 +101,20 @@ namespace MelonDsDs {
         [[nodiscard]] melonDS::AudioInterpolation Interpolation() const noexcept { return _interpolation; }
         void SetInterpolation(melonDS::AudioInterpolation interpolation) noexcept { _interpolation = interpolation; }
 
+        [[nodiscard]] bool AudioRateControl() const noexcept { return _audioRateControl; }
+        void SetAudioRateControl(bool audioRateControl) noexcept { _audioRateControl = audioRateControl; }
+
+        /// Whether the frontend's audio thread should pull audio from the core's ring buffer.
+        [[nodiscard]] bool AudioCallback() const noexcept { return _audioCallback; }
+        void SetAudioCallback(bool audioCallback) noexcept { _audioCallback = audioCallback; }
+
+        /// The sample rate to resample audio to, or \c std::nullopt to use the SPU's native rate.
+        [[nodiscard]] std::optional<unsigned> AudioOutputRate() const noexcept { return _audioOutputRate; }
+        void SetAudioOutputRate(std::optional<unsigned> audioOutputRate) noexcept { _audioOutputRate = audioOutputRate; }
+
+        [[nodiscard]] MelonDsDs::ResamplerQuality ResamplerQuality() const noexcept { return _resamplerQuality; }
+        void SetResamplerQuality(MelonDsDs::ResamplerQuality quality) noexcept { _resamplerQuality = quality; }
+
         [[nodiscard]] MelonDsDs::AlarmMode AlarmMode() const noexcept { return _alarmMode; }
         void SetAlarmMode(MelonDsDs::AlarmMode alarmMode) noexcept { _alarmMode = alarmMode; }
 
@@ -130,6 +163,17 @@ namespace MelonDsDs {
         [[nodiscard]] optional<melonDS::IpAddress> DnsServer() const noexcept { return _dnsServer; }
         void SetDnsServer(optional<melonDS::IpAddress> dnsServer) noexcept { _dnsServer = dnsServer; }
 
+        [[nodiscard]] bool MpPacketBatching() const noexcept { return _mpPacketBatching; }
+        void SetMpPacketBatching(bool enabled) noexcept { _mpPacketBatching = enabled; }
+
+        [[nodiscard]] std::chrono::milliseconds MpReceiveTimeout() const noexcept { return _mpReceiveTimeout; }
+        void SetMpReceiveTimeout(std::chrono::milliseconds timeout) noexcept { _mpReceiveTimeout = timeout; }
+
+#ifdef HAVE_MP_SHARED_MEMORY
+        [[nodiscard]] MelonDsDs::MpTransport MpTransport() const noexcept { return _mpTransport; }
+        void SetMpTransport(MelonDsDs::MpTransport transport) noexcept { _mpTransport = transport; }
+#endif
+
 #ifdef HAVE_JIT
         [[nodiscard]] bool JitEnable() const noexcept { return _jitEnable; }
         void SetJitEnable(bool enable) noexcept { _jitEnable = enable; }
@@ -137,6 +181,9 @@ namespace MelonDsDs {
         [[nodiscard]] unsigned MaxBlockSize() const noexcept { return _maxBlockSize; }
         void SetMaxBlockSize(unsigned maxBlockSize) noexcept { _maxBlockSize = maxBlockSize; }
 
+        [[nodiscard]] bool JitAutoTune() const noexcept { return _jitAutoTune; }
+        void SetJitAutoTune(bool enable) noexcept { _jitAutoTune = enable; }
+
         [[nodiscard]] bool LiteralOptimizations() const noexcept { return _literalOptimizations; }
         void SetLiteralOptimizations(bool enable) noexcept { _literalOptimizations = enable; }
 
@@ -149,6 +196,12 @@ namespace MelonDsDs {
 #   endif
 #endif
 
+        [[nodiscard]] MelonDsDs::ThreadPlacement EmulationThreadPlacement() const noexcept { return _emulationThreadPlacement; }
+        void SetEmulationThreadPlacement(MelonDsDs::ThreadPlacement placement) noexcept { _emulationThreadPlacement = placement; }
+
+        [[nodiscard]] MelonDsDs::ThreadPlacement RenderThreadPlacement() const noexcept { return _renderThreadPlacement; }
+        void SetRenderThreadPlacement(MelonDsDs::ThreadPlacement placement) noexcept { _renderThreadPlacement = placement; }
+
 #ifdef HAVE_NETWORKING
         [[nodiscard]] MelonDsDs::NetworkMode NetworkMode() const noexcept { return _networkMode; }
         void SetNetworkMode(MelonDsDs::NetworkMode mode) noexcept { _networkMode = mode; }
@@ -192,6 +245,19 @@ namespace MelonDsDs {
         [[nodiscard]] bool ShowBrightnessState() const noexcept { return showBrightnessState; }
         void SetShowBrightnessState(bool show) noexcept { showBrightnessState = show; }
 
+        [[nodiscard]] bool ShowFrameTimings() const noexcept { return _showFrameTimings; }
+        void SetShowFrameTimings(bool show) noexcept { _showFrameTimings = show; }
+
+        [[nodiscard]] bool ShowPerformanceOverlay() const noexcept { return _showPerformanceOverlay; }
+        void SetShowPerformanceOverlay(bool show) noexcept { _showPerformanceOverlay = show; }
+
+        /// True if the player asked for a trace to be saved, and it hasn't been yet
+        [[nodiscard]] bool SaveTraceRequested() const noexcept { return _saveTraceRequested; }
+        void SetSaveTraceRequested(bool requested) noexcept { _saveTraceRequested = requested; }
+
+        [[nodiscard]] bool ShowMpStats() const noexcept { return _showMpStats; }
+        void SetShowMpStats(bool show) noexcept { _showMpStats = show; }
+
         [[nodiscard]] bool DldiEnable() const noexcept { return _dldiEnable; }
         void SetDldiEnable(bool enable) noexcept { _dldiEnable = enable; }
 
@@ -250,6 +316,51 @@ namespace MelonDsDs {
             }) : std::nullopt;
         }
 
+        [[nodiscard]] bool DsiwareKeepInstalled() const noexcept { return _dsiwareKeepInstalled; }
+        void SetDsiwareKeepInstalled(bool keep) noexcept { _dsiwareKeepInstalled = keep; }
+
+#ifdef HAVE_NETWORKING
+        [[nodiscard]] bool DsiwareTmdPrefetch() const noexcept { return _dsiwareTmdPrefetch; }
+        void SetDsiwareTmdPrefetch(bool prefetch) noexcept { _dsiwareTmdPrefetch = prefetch; }
+#endif
+
+        [[nodiscard]] bool NdsSaveDirect() const noexcept { return _ndsSaveDirect; }
+        void SetNdsSaveDirect(bool direct) noexcept { _ndsSaveDirect = direct; }
+
+        [[nodiscard]] bool SaveJournal() const noexcept { return _saveJournal; }
+        void SetSaveJournal(bool journal) noexcept { _saveJournal = journal; }
+
+        /// Already resolved if the option was set to "auto".
+        [[nodiscard]] bool LowMemoryMode() const noexcept { return _lowMemoryMode; }
+        void SetLowMemoryMode(bool lowMemory) noexcept { _lowMemoryMode = lowMemory; }
+
+        [[nodiscard]] bool ShareFileMappings() const noexcept { return _shareFileMappings; }
+        void SetShareFileMappings(bool share) noexcept { _shareFileMappings = share; }
+
+        /// In KiB; 0 if disabled.
+        [[nodiscard]] unsigned FileReadAheadSize() const noexcept { return _fileReadAheadSize; }
+        void SetFileReadAheadSize(unsigned size) noexcept { _fileReadAheadSize = size; }
+
+        /// What the core stops doing while the emulated lid is closed.
+        [[nodiscard]] MelonDsDs::LidPowerSaving LidPowerSaving() const noexcept { return _lidPowerSaving; }
+        void SetLidPowerSaving(MelonDsDs::LidPowerSaving lidPowerSaving) noexcept { _lidPowerSaving = lidPowerSaving; }
+
+        /// If \c true, nothing from the host that the other players can't see (e.g. the clock) reaches the console.
+        [[nodiscard]] bool Deterministic() const noexcept { return _deterministic; }
+        void SetDeterministic(bool deterministic) noexcept { _deterministic = deterministic; }
+
+        /// How many hidden frames to emulate ahead of each shown frame, or 0 if run-ahead is disabled.
+        [[nodiscard]] unsigned RunAheadFrames() const noexcept { return _runAheadFrames; }
+        void SetRunAheadFrames(unsigned runAheadFrames) noexcept { _runAheadFrames = runAheadFrames; }
+
+        /// How many MiB the core's rewind history may use, or 0 if rewinding is disabled.
+        [[nodiscard]] unsigned RewindBufferSize() const noexcept { return _rewindBufferSize; }
+        void SetRewindBufferSize(unsigned rewindBufferSize) noexcept { _rewindBufferSize = rewindBufferSize; }
+
+        /// How many frames apart each rewind snapshot is.
+        [[nodiscard]] unsigned RewindInterval() const noexcept { return _rewindInterval; }
+        void SetRewindInterval(unsigned rewindInterval) noexcept { _rewindInterval = rewindInterval; }
+
         [[nodiscard]] unsigned FlushDelay() const noexcept { return _flushDelay; }
         void SetFlushDelay(unsigned delay) noexcept { _flushDelay = delay; }
 
@@ -264,6 +375,9 @@ namespace MelonDsDs {
         [[nodiscard]] unsigned ScreenGap() const noexcept { return _screenGap; }
         void SetScreenGap(unsigned screenGap) noexcept { _screenGap = screenGap; }
 
+        [[nodiscard]] MelonDsDs::ScreenRotationMethod ScreenRotation() const noexcept { return _screenRotation; }
+        void SetScreenRotation(MelonDsDs::ScreenRotationMethod screenRotation) noexcept { _screenRotation = screenRotation; }
+
         [[nodiscard]] unsigned HybridRatio() const noexcept { return _hybridRatio; }
         void SetHybridRatio(unsigned hybridRatio) noexcept { _hybridRatio = hybridRatio; }
 
@@ -309,6 +423,10 @@ namespace MelonDsDs {
         [[nodiscard]] unsigned DsPowerOkayThreshold() const noexcept { return _dsPowerOkayThreshold; }
         void SetDsPowerOkayThreshold(unsigned dsPowerOkayThreshold) noexcept { _dsPowerOkayThreshold = dsPowerOkayThreshold; }
 
+        /// The host battery percentage below which the battery saver kicks in, or 0 if it's disabled.
+        [[nodiscard]] unsigned BatterySaverThreshold() const noexcept { return _batterySaverThreshold; }
+        void SetBatterySaverThreshold(unsigned batterySaverThreshold) noexcept { _batterySaverThreshold = batterySaverThreshold; }
+
         [[nodiscard]] unsigned PowerUpdateInterval() const noexcept { return _powerUpdateInterval; }
         void SetPowerUpdateInterval(unsigned powerUpdateInterval) noexcept { _powerUpdateInterval = powerUpdateInterval; }
 
@@ -346,6 +464,28 @@ namespace MelonDsDs {
         [[nodiscard]] RenderMode ConfiguredRenderer() const noexcept { return _configuredRenderer; }
         void SetConfiguredRenderer(RenderMode configuredRenderer) noexcept { _configuredRenderer = configuredRenderer; }
 
+#if defined(HAVE_OPENGL) || defined(HAVE_OPENGLES) || defined(HAVE_VULKAN)
+        [[nodiscard]] bool GpuComposition() const noexcept { return _gpuComposition; }
+        void SetGpuComposition(bool gpuComposition) noexcept { _gpuComposition = gpuComposition; }
+#else
+        bool GpuComposition() const noexcept { return false; }
+#endif
+
+#if defined(HAVE_OPENGL) || defined(HAVE_OPENGLES)
+        [[nodiscard]] unsigned MaxFramesInFlight() const noexcept { return _maxFramesInFlight; }
+        void SetMaxFramesInFlight(unsigned maxFramesInFlight) noexcept { _maxFramesInFlight = maxFramesInFlight; }
+
+        [[nodiscard]] MelonDsDs::OpenGlStateIsolation StateIsolation() const noexcept { return _stateIsolation; }
+        void SetStateIsolation(MelonDsDs::OpenGlStateIsolation stateIsolation) noexcept { _stateIsolation = stateIsolation; }
+
+        [[nodiscard]] bool DynamicResolution() const noexcept { return _dynamicResolution; }
+        void SetDynamicResolution(bool dynamicResolution) noexcept { _dynamicResolution = dynamicResolution; }
+
+        /// The lowest scale factor that dynamic resolution may use; never more than \c ScaleFactor.
+        [[nodiscard]] int MinScaleFactor() const noexcept { return std::min(_minScaleFactor, _scaleFactor); }
+        void SetMinScaleFactor(int minScaleFactor) noexcept { _minScaleFactor = minScaleFactor; }
+#endif
+
 #ifdef HAVE_THREADED_RENDERER
         [[nodiscard]] bool ThreadedSoftRenderer() const noexcept { return _threadedSoftRenderer; }
         void SetThreadedSoftRenderer(bool threadedSoftRenderer) noexcept { _threadedSoftRenderer = threadedSoftRenderer; }
@@ -353,6 +493,27 @@ namespace MelonDsDs {
         bool ThreadedSoftRenderer() const noexcept { return false; }
 #endif
 
+#ifdef HAVE_THREADS
+        [[nodiscard]] bool PipelinedComposition() const noexcept { return _pipelinedComposition; }
+        void SetPipelinedComposition(bool pipelinedComposition) noexcept { _pipelinedComposition = pipelinedComposition; }
+        [[nodiscard]] bool ParallelComposition() const noexcept { return _parallelComposition; }
+        void SetParallelComposition(bool parallelComposition) noexcept { _parallelComposition = parallelComposition; }
+
+        /// How many threads parallel composition uses, including the composing thread; 0 means "choose automatically".
+        [[nodiscard]] unsigned ParallelCompositionThreads() const noexcept { return _parallelCompositionThreads; }
+        void SetParallelCompositionThreads(unsigned parallelCompositionThreads) noexcept { _parallelCompositionThreads = parallelCompositionThreads; }
+#else
+        bool PipelinedComposition() const noexcept { return false; }
+        bool ParallelComposition() const noexcept { return false; }
+        unsigned ParallelCompositionThreads() const noexcept { return 0; }
+#endif
+
+        [[nodiscard]] MelonDsDs::FrameSkipMode FrameSkip() const noexcept { return _frameSkip; }
+        void SetFrameSkip(MelonDsDs::FrameSkipMode frameSkip) noexcept { _frameSkip = frameSkip; }
+
+        [[nodiscard]] bool Rgb565Output() const noexcept { return _rgb565Output; }
+        void SetRgb565Output(bool rgb565Output) noexcept { _rgb565Output = rgb565Output; }
+
         [[nodiscard]] MelonDsDs::ScreenFilter ScreenFilter() const noexcept { return _screenFilter; }
         void SetScreenFilter(MelonDsDs::ScreenFilter screenFilter) noexcept { _screenFilter = screenFilter; }
 
@@ -410,6 +571,10 @@ namespace MelonDsDs {
         MelonDsDs::MicInputMode _micInputMode = *ParseMicInputMode(config::definitions::MicInput.default_value);
         melonDS::AudioBitDepth _bitDepth;
         melonDS::AudioInterpolation _interpolation;
+        bool _audioRateControl = false;
+        bool _audioCallback = false;
+        std::optional<unsigned> _audioOutputRate = std::nullopt;
+        MelonDsDs::ResamplerQuality _resamplerQuality = MelonDsDs::ResamplerQuality::Balanced;
         MelonDsDs::AlarmMode _alarmMode;
         optional<unsigned> _alarmHour;
         optional<unsigned> _alarmMinute;
@@ -421,17 +586,25 @@ namespace MelonDsDs {
         string _message;
         optional<melonDS::MacAddress> _macAddress;
         optional<melonDS::IpAddress> _dnsServer;
+        bool _mpPacketBatching = false;
+        std::chrono::milliseconds _mpReceiveTimeout = MpState::DEFAULT_RECV_TIMEOUT;
+#ifdef HAVE_MP_SHARED_MEMORY
+        MelonDsDs::MpTransport _mpTransport = MelonDsDs::MpTransport::Netplay;
+#endif
         MelonDsDs::Slot2Device _slot2 = *ParseSlot2Device(config::definitions::Slot2Device.default_value);
         bool _useRealLightSensor = *ParseBoolean(config::definitions::SolarSensorMode.default_value);
 #ifdef JIT_ENABLED
         bool _jitEnable;
         unsigned _maxBlockSize;
+        bool _jitAutoTune = false;
         bool _literalOptimizations;
         bool _branchOptimizations;
 #   ifdef HAVE_JIT_FASTMEM
         bool _fastMemory;
 #   endif
 #endif
+        MelonDsDs::ThreadPlacement _emulationThreadPlacement = MelonDsDs::ThreadPlacement::Any;
+        MelonDsDs::ThreadPlacement _renderThreadPlacement = MelonDsDs::ThreadPlacement::Any;
 
 
 #ifdef HAVE_NETWORKING
@@ -453,6 +626,10 @@ namespace MelonDsDs {
         bool showLidState = false;
         bool _showSensorReading = false;
         bool showBrightnessState = false;
+        bool _showFrameTimings = false;
+        bool _showPerformanceOverlay = false;
+        bool _saveTraceRequested = false;
+        bool _showMpStats = false;
         bool _dldiEnable;
         bool _dldiFolderSync;
         string _dldiFolderPath;
@@ -465,10 +642,25 @@ namespace MelonDsDs {
         bool _dsiSdReadOnly;
         string _dsiSdImagePath;
         uint64_t _dsiSdImageSize;
+        bool _ndsSaveDirect = false;
+        bool _saveJournal = false;
+        bool _lowMemoryMode = false;
+        bool _shareFileMappings = true;
+        unsigned _fileReadAheadSize = 256;
+        MelonDsDs::LidPowerSaving _lidPowerSaving = MelonDsDs::LidPowerSaving::SkipFrames;
+        bool _deterministic = false;
+        unsigned _runAheadFrames = 0;
+        unsigned _rewindBufferSize = 0;
+        unsigned _rewindInterval = 5;
+        bool _dsiwareKeepInstalled = false;
+#ifdef HAVE_NETWORKING
+        bool _dsiwareTmdPrefetch = false;
+#endif
         unsigned _flushDelay = 120; // TODO: Make configurable
         unsigned _numberOfScreenLayouts = 1;
         std::array<ScreenLayout, config::screen::MAX_SCREEN_LAYOUTS> _screenLayouts;
         unsigned _screenGap = 0;
+        MelonDsDs::ScreenRotationMethod _screenRotation = MelonDsDs::ScreenRotationMethod::Auto;
         unsigned _hybridRatio = 2;
         HybridSideScreenDisplay _smallScreenLayout;
         unsigned _cursorSize = 2.0f;
@@ -484,6 +676,7 @@ namespace MelonDsDs {
         MelonDsDs::BootMode _bootMode;
         MelonDsDs::SysfileMode _sysfileMode;
         unsigned _dsPowerOkayThreshold = 20;
+        unsigned _batterySaverThreshold = 0;
         unsigned _powerUpdateInterval;
         string _firmwarePath;
         string _dsiFirmwarePath;
@@ -491,7 +684,17 @@ namespace MelonDsDs {
         int _scaleFactor = 1;
         bool _betterPolygonSplitting = false;
         RenderMode _configuredRenderer;
+        bool _gpuComposition = false;
+        unsigned _maxFramesInFlight = 2;
+        MelonDsDs::OpenGlStateIsolation _stateIsolation = MelonDsDs::OpenGlStateIsolation::Auto;
+        bool _dynamicResolution = false;
+        int _minScaleFactor = 1;
         bool _threadedSoftRenderer = false;
+        bool _pipelinedComposition = false;
+        bool _parallelComposition = false;
+        unsigned _parallelCompositionThreads = 0;
+        MelonDsDs::FrameSkipMode _frameSkip = MelonDsDs::FrameSkipMode::Disabled;
+        bool _rgb565Output = false;
         MelonDsDs::ScreenFilter _screenFilter;
         MelonDsDs::StartTimeMode _startTimeMode = *ParseStartTimeMode(config::definitions::StartTimeMode.default_value);
         years _relativeYearOffset {};
@@ -16,16 +16,26 @@
 
 #include "console.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <codecvt>
+#include <cstring>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <span>
 #include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include <sys/stat.h>
 
 #include <FreeBIOS.h>
 #include <NDS.h>
 #include <DSi.h>
 
+#include <encodings/crc32.h>
 #include <encodings/utf.h>
 #include <file/file_path.h>
 #include <retro_assert.h>
@@ -38,9 +48,15 @@
 #include "environment.hpp"
 #include "exceptions.hpp"
 #include "format.hpp"
+#include "net/download.hpp"
+#include "platform/file.hpp"
+#include "platform/memory.hpp"
+#include "retro/dirent.hpp"
 #include "retro/file.hpp"
-#include "retro/http.hpp"
 #include "retro/info.hpp"
+#include "retro/task_queue.hpp"
+#include "retro/threads.hpp"
+#include "tracy/memory.hpp"
 #include "types.hpp"
 
 using std::make_optional;
@@ -56,11 +72,146 @@ using melonDS::NDSHeader;
 using namespace melonDS::DSi_NAND;
 using melonDS::DSi_TMD::TitleMetadata;
 
+namespace {
+    /// A system file that was loaded and validated earlier in this process,
+    /// along with what it looked like on disk at the time.
+    template<typename T>
+    struct CachedSystemFile {
+        int64_t Size;
+        int64_t ModifiedTime;
+        T Image;
+    };
+
+    /// A system file's pristine contents; a shared mapping of the file if possible,
+    /// so that other instances of the core using the same file share its pages.
+    struct SystemFileImage {
+        MelonDsDs::memory::SharedFileMapping Mapping;
+        std::vector<uint8_t> Copy;
+
+        [[nodiscard]] span<const uint8_t> Data() const noexcept {
+            if (Mapping) {
+                span<const std::byte> mapped = Mapping.Data();
+                return {reinterpret_cast<const uint8_t*>(mapped.data()), mapped.size()};
+            }
+
+            return Copy;
+        }
+    };
+
+    /// Maps \c path if possible, or copies \c contents (which must be the file's contents) if not.
+    SystemFileImage MakeSystemFileImage(const std::string& path, span<const uint8_t> contents) noexcept {
+        SystemFileImage image { .Mapping = MelonDsDs::memory::SharedFileMapping::Open(path.c_str()) };
+        span<const std::byte> mapped = image.Mapping.Data();
+        if (!image.Mapping || mapped.size() != contents.size() || memcmp(mapped.data(), contents.data(), contents.size()) != 0) {
+            // If the file couldn't be mapped, or it changed since we read it...
+            image.Mapping = {};
+            image.Copy.assign(contents.begin(), contents.end());
+        }
+
+        return image;
+    }
+
+    // BIOS and firmware images don't change between resets or content loads,
+    // so they're kept here (keyed by full path) to skip the reads and validation next time.
+    // Each console still gets its own copy, since melonDS keeps (and patches) its own buffers.
+    // Guarded by systemFileCacheLock, since they're loaded by several threads at once.
+    std::unordered_map<std::string, CachedSystemFile<SystemFileImage>> biosCache;
+    std::unordered_map<std::string, CachedSystemFile<SystemFileImage>> firmwareCache;
+    retro::slock systemFileCacheLock;
+
+    /// A firmware image as \c CustomizeFirmware left it.
+    struct CustomizedFirmware {
+        std::vector<uint8_t> Image;
+
+        /// Whether the source image failed the corruption check, so the warning can be shown again.
+        bool Corrupted;
+    };
+
+    // Customizing the firmware reads the WFC settings from disk and recomputes the checksums,
+    // and it gives the same result for the same source image, settings file, and options;
+    // so the result is kept here (keyed by all of those) for resets and later loads.
+    // Guarded by systemFileCacheLock.
+    std::unordered_map<std::string, CustomizedFirmware> customizedFirmwareCache;
+    constexpr size_t MAX_CUSTOMIZED_FIRMWARE_CACHE_SIZE = 4;
+
+    /// Appends the bytes of \c value to \c key.
+    template<typename T>
+    void AppendToKey(std::string& key, const T& value) noexcept {
+        static_assert(std::is_trivially_copyable_v<T>);
+        key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    template<typename T>
+    void AppendToKey(std::string& key, const optional<T>& value) noexcept {
+        AppendToKey(key, value.has_value());
+        if (value)
+            AppendToKey(key, *value);
+    }
+
+    // The contents of each DSiWare save file (keyed by host path) as last read from the host,
+    // so that unloading a game doesn't rewrite save data that it never touched.
+    // Only holds data known to be on disk; an entry is dropped when its file is about to be rewritten.
+    // DSiWare saves are at most a few hundred KiB, so the bytes themselves are kept instead of a hash.
+    // Guarded by dsiwareSaveDataLock, since titles are installed on the loader threads.
+    std::unordered_map<std::string, std::vector<std::byte>> dsiwareSaveData;
+    retro::slock dsiwareSaveDataLock;
+
+    /// Returns the contents of the file at \c path, or \c nullopt if it can't be read.
+    optional<std::vector<std::byte>> ReadDsiwareSaveFile(const char* path) noexcept {
+        void* buffer = nullptr;
+        int64_t length = 0;
+        if (!filestream_read_file(path, &buffer, &length) || !buffer) {
+            free(buffer);
+            return nullopt;
+        }
+
+        const std::byte* bytes = static_cast<const std::byte*>(buffer);
+        std::vector<std::byte> data(bytes, bytes + length);
+        free(buffer);
+        return data;
+    }
+
+    /// Returns the file's size and modification time, or \c nullopt if it can't be examined.
+    optional<std::pair<int64_t, int64_t>> SystemFileStamp(const std::string& path) noexcept {
+        struct stat statbuf {};
+        if (stat(path.c_str(), &statbuf) != 0)
+            return nullopt;
+
+        return std::make_pair(static_cast<int64_t>(statbuf.st_size), static_cast<int64_t>(statbuf.st_mtime));
+    }
+
+    /// Returns the cached image for \c path if the file hasn't changed since it was cached.
+    /// Stale entries are evicted.
+    template<typename T>
+    const T* FindCachedSystemFile(
+        std::unordered_map<std::string, CachedSystemFile<T>>& cache,
+        const std::string& path,
+        const optional<std::pair<int64_t, int64_t>>& stamp
+    ) noexcept {
+        auto it = cache.find(path);
+        if (it == cache.end())
+            return nullptr;
+
+        if (stamp && it->second.Size == stamp->first && it->second.ModifiedTime == stamp->second)
+            return &it->second.Image;
+
+        cache.erase(it);
+        return nullptr;
+    }
+}
+
 namespace MelonDsDs {
     const char *TMD_DIR_NAME = "tmd";
     const char* SENTINEL_NAME = "melon.dat";
     constexpr uint32_t RSA256_SIGNATURE_TYPE = 16777472;
 
+    // Loading a DSiWare game waits for its title metadata if it isn't cached,
+    // so don't let an unresponsive server hold things up for long
+    constexpr std::chrono::seconds TMD_DOWNLOAD_TIMEOUT(10);
+
+    // A title's metadata doesn't change once it's published
+    constexpr std::chrono::hours TMD_CACHE_MAX_AGE(24 * 30);
+
     // Upstream removed the ROM arguments from melonDS::NDSArgs/DSiArgs
     // because it complicated initialization
     struct NDSArgs {
@@ -84,20 +235,28 @@ namespace MelonDsDs {
 
     static DSiArgs GetDSiArgs(const CoreConfig& config, const retro::GameInfo* ndsInfo);
     static void ApplyCommonArgs(const CoreConfig& config, melonDS::NDSArgs& args) noexcept;
+    static std::optional<melonDS::JITArgs> GetJitArgs(const CoreConfig& config) noexcept;
     static unique_ptr<melonDS::NDSCart::CartCommon> LoadNdsCart(const CoreConfig& config, const retro::GameInfo& ndsInfo);
     static unique_ptr<melonDS::GBACart::CartCommon> LoadGbaCart(const retro::GameInfo& gbaInfo, const retro::GameInfo* gbaSaveInfo);
     static std::pair<unique_ptr<uint8_t[]>, size_t> LoadGbaSram(const retro::GameInfo& gbaSaveInfo);
-    static void InstallDsiware(NANDMount& mount, const retro::GameInfo& nds_info);
-    static void GetTmdPath(const retro::GameInfo &nds_info, std::span<char> buffer);
+    static void InstallDsiware(NANDMount& mount, const retro::GameInfo& nds_info, retro::future<optional<TitleMetadata>>& tmd);
+    static void GetTmdPath(string_view contentPath, std::span<char> buffer);
+    static optional<TitleMetadata> FetchTmd(string_view contentPath, const NDSHeader& header, const std::atomic_bool& cancelled);
     static optional<TitleMetadata> GetCachedTmd(string_view tmdPath) noexcept;
     static bool ValidateTmd(const TitleMetadata &tmd) noexcept;
-    static optional<TitleMetadata> DownloadTmd(const NDSHeader& header, string_view tmdPath) noexcept;
+#ifdef HAVE_NETWORKING
+    static optional<TitleMetadata> DownloadTmd(const NDSHeader& header, string_view tmdPath, const std::atomic_bool& cancelled) noexcept;
+    static unsigned PrefetchTmds(const string& directory, const std::atomic_bool& cancelled);
     static bool CacheTmd(string_view tmd_path, std::span<const std::byte> tmd) noexcept;
+#endif
     static void ImportDsiwareSaveData(NANDMount& nand, const retro::GameInfo& nds_info, const NDSHeader& header, int type) noexcept;
     static optional<Firmware> LoadFirmware(const string& firmwarePath) noexcept;
     static bool LoadBios(const string_view& name, BiosType type, std::span<uint8_t> buffer) noexcept;
     static void CustomizeFirmware(const CoreConfig& config, Firmware& firmware);
     static std::optional<std::string> GetUsername(UsernameMode mode) noexcept;
+    static std::u16string ResolveUsername(UsernameMode mode) noexcept;
+    static optional<Firmware::Language> ResolveFirmwareLanguage(FirmwareLanguage language) noexcept;
+    static void WarnCorruptedFirmware(const CoreConfig& config) noexcept;
     static NANDImage LoadNANDImage(const string& nandPath, const uint8_t* es_keyY);
     static void CustomizeNAND(const CoreConfig& config, NANDMount& mount, const NDSHeader* header, string_view nandName);
     static optional<melonDS::FATStorage> LoadDSiSDCardImage(const CoreConfig& config) noexcept;
@@ -137,6 +296,7 @@ std::unique_ptr<melonDS::NDS> MelonDsDs::CreateConsole(
     const retro::GameInfo* gbaSaveInfo
 ) {
     ZoneScopedN(TracyFunction);
+    MemoryScope memory(MemoryTag::Console);
     ConsoleType type = config.ConsoleType();
     const melonDS::NDSHeader* header = ndsInfo
         ? reinterpret_cast<const melonDS::NDSHeader*>(ndsInfo->GetData().data())
@@ -148,6 +308,17 @@ std::unique_ptr<melonDS::NDS> MelonDsDs::CreateConsole(
         retro::warn("Forcing DSi mode for DSiWare game");
     }
 
+    {
+        // Tell Platform::OpenFile which files the console will be accessing constantly, and how
+        SetLowMemoryFileAccess(config.LowMemoryMode());
+        SetFileReadAheadWindow(size_t(config.FileReadAheadSize()) * 1024);
+        optional<string> nandPath = type == ConsoleType::DSi ? retro::get_system_path(config.DsiNandPath()) : nullopt;
+        bool dsiSd = type == ConsoleType::DSi && config.DsiSdEnable();
+        RegisterHotFile(HotFile::DsiNand, nandPath ? string_view(*nandPath) : string_view());
+        RegisterHotFile(HotFile::DsiSdCard, dsiSd ? config.DsiSdImagePath() : string_view());
+        RegisterHotFile(HotFile::HomebrewSdCard, config.DldiEnable() ? config.DldiImagePath() : string_view());
+    }
+
     if (type == ConsoleType::DSi) {
         // If we're in DSi mode...
         if (gbaInfo || gbaSaveInfo) {
@@ -177,6 +348,64 @@ void MelonDsDs::UpdateConsole(const CoreConfig& config, melonDS::NDS& nds) noexc
     nds.SPU.SetDegrade10Bit(config.BitDepth());
 }
 
+void MelonDsDs::ResetConsole(const CoreConfig& config, melonDS::NDS& nds) {
+    ZoneScopedN(TracyFunction);
+
+    // Everything else that the console was created with is unchanged (see RequiresNewConsole),
+    // and NDS::Reset will take care of the emulated hardware state
+    UpdateConsole(config, nds);
+}
+
+bool MelonDsDs::RequiresNewConsole(const CoreConfig& previous, const CoreConfig& current) noexcept {
+    ZoneScopedN(TracyFunction);
+
+    // System files
+    if (previous.ConsoleType() != current.ConsoleType()) return true;
+    if (previous.SysfileMode() != current.SysfileMode()) return true;
+    if (previous.FirmwarePath() != current.FirmwarePath()) return true;
+    if (previous.DsiFirmwarePath() != current.DsiFirmwarePath()) return true;
+    if (previous.DsiNandPath() != current.DsiNandPath()) return true;
+
+    // Firmware customization (applied when the firmware is loaded)
+    if (previous.Language() != current.Language()) return true;
+    if (previous.BirthdayMonth() != current.BirthdayMonth()) return true;
+    if (previous.BirthdayDay() != current.BirthdayDay()) return true;
+    if (previous.FavoriteColor() != current.FavoriteColor()) return true;
+    if (previous.UsernameMode() != current.UsernameMode()) return true;
+    if (previous.AlarmMode() != current.AlarmMode()) return true;
+    if (previous.AlarmHour() != current.AlarmHour()) return true;
+    if (previous.AlarmMinute() != current.AlarmMinute()) return true;
+    if (previous.MacAddress() != current.MacAddress()) return true;
+    if (previous.DnsServer() != current.DnsServer()) return true;
+
+    // Slot-2 and storage devices
+    if (previous.GetSlot2Device() != current.GetSlot2Device()) return true;
+    if (previous.DldiEnable() != current.DldiEnable()) return true;
+    if (previous.DldiImagePath() != current.DldiImagePath()) return true;
+    if (previous.DldiImageSize() != current.DldiImageSize()) return true;
+    if (previous.DldiReadOnly() != current.DldiReadOnly()) return true;
+    if (previous.DldiFolderSync() != current.DldiFolderSync()) return true;
+    if (previous.DldiFolderPath() != current.DldiFolderPath()) return true;
+    if (previous.DsiSdEnable() != current.DsiSdEnable()) return true;
+    if (previous.DsiSdImagePath() != current.DsiSdImagePath()) return true;
+    if (previous.DsiSdImageSize() != current.DsiSdImageSize()) return true;
+    if (previous.DsiSdReadOnly() != current.DsiSdReadOnly()) return true;
+    if (previous.DsiSdFolderSync() != current.DsiSdFolderSync()) return true;
+    if (previous.DsiSdFolderPath() != current.DsiSdFolderPath()) return true;
+
+#ifdef HAVE_JIT
+    if (previous.JitEnable() != current.JitEnable()) return true;
+    if (previous.MaxBlockSize() != current.MaxBlockSize()) return true;
+    if (previous.LiteralOptimizations() != current.LiteralOptimizations()) return true;
+    if (previous.BranchOptimizations() != current.BranchOptimizations()) return true;
+#   ifdef HAVE_JIT_FASTMEM
+    if (previous.FastMemory() != current.FastMemory()) return true;
+#   endif
+#endif
+
+    return false;
+}
+
 // First, load the system files
 // Then, validate the system files
 // Then, fall back to other system files if needed and possible
@@ -195,19 +424,45 @@ static MelonDsDs::NDSArgs MelonDsDs::GetNdsArgs(
     // - Bootable firmware is required if booting without content.
     // - All system files must be native or all must be built-in. (No mixing.)
     // - If BIOS files are built-in, then Direct Boot mode must be used
-    optional<Firmware> firmware;
-    if (config.SysfileMode() == SysfileMode::Native) {
-        optional<string> firmwarePath = retro::get_system_path(config.FirmwarePath());
+    bool isNative = config.SysfileMode() == SysfileMode::Native;
+    optional<string> firmwarePath;
+    if (isNative) {
+        firmwarePath = retro::get_system_path(config.FirmwarePath());
         if (!firmwarePath) {
             retro::error("Failed to get system directory");
         }
-
-        firmware = firmwarePath ? LoadFirmware(*firmwarePath) : nullopt;
     }
 
+    NDSArgs ndsargs {};
+
+    ApplyCommonArgs(config, ndsargs.args);
+
+    retro_assert(ndsargs.args.ARM7BIOS != nullptr);
+    retro_assert(ndsargs.args.ARM9BIOS != nullptr);
+
+    // Each of these files is independent of the others until they're all validated,
+    // so load them in parallel; the BIOS files are loaded speculatively
+    // and discarded if we end up using generated firmware.
+    retro::future<optional<Firmware>> firmwareLoad([&] {
+        return firmwarePath ? LoadFirmware(*firmwarePath) : nullopt;
+    });
+    retro::future<bool> bios7Load([&] {
+        return isNative && LoadBios(config.Bios7Path(), BiosType::Arm7, *ndsargs.args.ARM7BIOS);
+    });
+    retro::future<bool> bios9Load([&] {
+        return isNative && LoadBios(config.Bios9Path(), BiosType::Arm9, *ndsargs.args.ARM9BIOS);
+    });
+    retro::future<unique_ptr<melonDS::NDSCart::CartCommon>> ndsCartLoad([&] {
+        return ndsInfo ? LoadNdsCart(config, *ndsInfo) : nullptr;
+    });
+
+    // The GBA cart is loaded on this thread because its SRAM loader may need to show messages
+    unique_ptr<melonDS::GBACart::CartCommon> gbaCart = gbaInfo ? LoadGbaCart(*gbaInfo, gbaSaveInfo) : nullptr;
+
+    optional<Firmware> firmware = firmwareLoad.get();
     if (!ndsInfo && !(firmware && firmware->IsBootable())) {
         // If we're trying to boot into the NDS menu, but we didn't load bootable firmware...
-        if (config.SysfileMode() == SysfileMode::Native) {
+        if (isNative) {
             throw nds_firmware_not_bootable_exception(config.FirmwarePath());
         }
         else {
@@ -217,7 +472,7 @@ static MelonDsDs::NDSArgs MelonDsDs::GetNdsArgs(
 
     if (!firmware) {
         // If we haven't loaded any firmware...
-        if (config.SysfileMode() == SysfileMode::Native) {
+        if (isNative) {
             // ...but we were trying to...
             retro::warn("Falling back to built-in firmware");
         }
@@ -229,18 +484,11 @@ static MelonDsDs::NDSArgs MelonDsDs::GetNdsArgs(
         retro::debug("Not loading native ARM BIOS files");
     }
 
-    NDSArgs ndsargs {};
-
-    ApplyCommonArgs(config, ndsargs.args);
-
-    retro_assert(ndsargs.args.ARM7BIOS != nullptr);
-    retro_assert(ndsargs.args.ARM9BIOS != nullptr);
+    // Use the ARM7 and ARM9 BIOS files (but don't bother with the ARM9 BIOS if the ARM7 BIOS failed)
+    bool bios7Loaded = bios7Load.get() && !isFirmwareGenerated;
+    bool bios9Loaded = bios9Load.get() && bios7Loaded;
 
-    // Try to load the ARM7 and ARM9 BIOS files (but don't bother with the ARM9 BIOS if the ARM7 BIOS failed)
-    bool bios7Loaded = !isFirmwareGenerated && LoadBios(config.Bios7Path(), BiosType::Arm7, *ndsargs.args.ARM7BIOS);
-    bool bios9Loaded = bios7Loaded && LoadBios(config.Bios9Path(), BiosType::Arm9, *ndsargs.args.ARM9BIOS);
-
-    if (config.SysfileMode() == SysfileMode::Native && !(bios7Loaded && bios9Loaded)) {
+    if (isNative && !(bios7Loaded && bios9Loaded)) {
         // If we're trying to load native BIOS files, but at least one of them failed...
         retro::warn("Falling back to FreeBIOS");
     }
@@ -273,8 +521,8 @@ static MelonDsDs::NDSArgs MelonDsDs::GetNdsArgs(
     CustomizeFirmware(config, *firmware);
     ndsargs.args.Firmware = std::move(*firmware);
 
-    if (ndsInfo) {
-        ndsargs.ndsCart = LoadNdsCart(config, *ndsInfo);
+    ndsargs.ndsCart = ndsCartLoad.get();
+    if (ndsargs.ndsCart) {
         const uint8_t* romdata = ndsargs.ndsCart->GetROM();
         const NDSHeader &header = ndsargs.ndsCart->GetHeader();
 
@@ -287,7 +535,7 @@ static MelonDsDs::NDSArgs MelonDsDs::GetNdsArgs(
 
     if (gbaInfo) {
         // If loading a specific GBA ROM, then ignore the expansion paks
-        ndsargs.gbaCart = LoadGbaCart(*gbaInfo, gbaSaveInfo);
+        ndsargs.gbaCart = std::move(gbaCart);
     } else {
         switch (config.GetSlot2Device()) {
             case Slot2Device::MemoryExpansionPak:
@@ -349,32 +597,72 @@ static MelonDsDs::DSiArgs MelonDsDs::GetDSiArgs(const CoreConfig& config, const
         throw dsi_no_firmware_found_exception();
     }
 
+    optional<string> firmwarePath = retro::get_system_path(config.DsiFirmwarePath());
+    retro_assert(firmwarePath.has_value());
+    // If we couldn't get the system directory, we wouldn't have gotten this far
+
+    optional<string> nandPath = retro::get_system_path(nandName);
+    const NDSHeader* header = ndsInfo ? reinterpret_cast<const NDSHeader*>(ndsInfo->GetData().data()) : nullptr;
+
+    // A DSiWare game can't be installed without its title metadata,
+    // which may need to be downloaded; start on that now so the network isn't on the critical path.
+    // (It might not be needed if the game's already installed, but we won't know that until the NAND is mounted.)
+    std::atomic_bool tmdCancelled = false;
+    retro::future<optional<TitleMetadata>> tmdLoad([&]() -> optional<TitleMetadata> {
+        return header && header->IsDSiWare() ? FetchTmd(ndsInfo->GetPath(), *header, tmdCancelled) : nullopt;
+    });
+
+    // Stop the download early if it turns out we don't need it (or if loading fails)
+    struct CancelOnExit {
+        std::atomic_bool& Cancelled;
+        ~CancelOnExit() noexcept { Cancelled = true; }
+    } cancelTmd { tmdCancelled };
+
     // DSi mode requires all native BIOS files
     unique_ptr<melonDS::DSiBIOSImage> arm7i = make_unique<melonDS::DSiBIOSImage>();
-    if (!LoadBios(config.DsiBios7Path(), BiosType::Arm7i, *arm7i)) {
+    unique_ptr<melonDS::DSiBIOSImage> arm9i = make_unique<melonDS::DSiBIOSImage>();
+    unique_ptr<melonDS::ARM7BIOSImage> arm7 = make_unique<melonDS::ARM7BIOSImage>();
+    unique_ptr<melonDS::ARM9BIOSImage> arm9 = make_unique<melonDS::ARM9BIOSImage>();
+
+    // The system files, the ROM, and the SD card are independent of one another
+    // (except for the NAND image, which needs the DSi ARM7 BIOS's keys),
+    // so load them all in parallel; the results are checked in the same order as before
+    // so that the same error is reported if more than one thing is wrong.
+    bool arm7iLoaded = false;
+    retro::future<optional<NANDImage>> nandLoad([&]() -> optional<NANDImage> {
+        arm7iLoaded = LoadBios(config.DsiBios7Path(), BiosType::Arm7i, *arm7i);
+        if (!arm7iLoaded || !nandPath)
+            return nullopt;
+
+        return make_optional(LoadNANDImage(*nandPath, &(*arm7i)[0x8308]));
+    });
+    retro::future<bool> arm9iLoad([&] { return LoadBios(config.DsiBios9Path(), BiosType::Arm9i, *arm9i); });
+    retro::future<bool> arm7Load([&] { return LoadBios(config.Bios7Path(), BiosType::Arm7, *arm7); });
+    retro::future<bool> arm9Load([&] { return LoadBios(config.Bios9Path(), BiosType::Arm9, *arm9); });
+    retro::future<optional<Firmware>> firmwareLoad([&] { return firmwarePath ? LoadFirmware(*firmwarePath) : nullopt; });
+    retro::future<unique_ptr<melonDS::NDSCart::CartCommon>> ndsRomLoad([&] {
+        return ndsInfo ? LoadNdsCart(config, *ndsInfo) : nullptr;
+    });
+    retro::future<optional<melonDS::FATStorage>> sdCardLoad([&] { return LoadDSiSDCardImage(config); });
+
+    nandLoad.wait();
+    if (!arm7iLoaded) {
         throw dsi_missing_bios_exception(BiosType::Arm7i, config.DsiBios7Path());
     }
 
-    unique_ptr<melonDS::DSiBIOSImage> arm9i = make_unique<melonDS::DSiBIOSImage>();
-    if (!LoadBios(config.DsiBios9Path(), BiosType::Arm9i, *arm9i)) {
+    if (!arm9iLoad.get()) {
         throw dsi_missing_bios_exception(BiosType::Arm9i, config.DsiBios9Path());
     }
 
-    unique_ptr<melonDS::ARM7BIOSImage> arm7 = make_unique<melonDS::ARM7BIOSImage>();
-    if (!LoadBios(config.Bios7Path(), BiosType::Arm7, *arm7)) {
+    if (!arm7Load.get()) {
         throw dsi_missing_bios_exception(BiosType::Arm7, config.Bios7Path());
     }
 
-    unique_ptr<melonDS::ARM9BIOSImage> arm9 = make_unique<melonDS::ARM9BIOSImage>();
-    if (!LoadBios(config.Bios9Path(), BiosType::Arm9, *arm9)) {
+    if (!arm9Load.get()) {
         throw dsi_missing_bios_exception(BiosType::Arm9, config.Bios9Path());
     }
 
-    optional<string> firmwarePath = retro::get_system_path(config.DsiFirmwarePath());
-    retro_assert(firmwarePath.has_value());
-    // If we couldn't get the system directory, we wouldn't have gotten this far
-
-    optional<Firmware> firmware = LoadFirmware(*firmwarePath);
+    optional<Firmware> firmware = firmwareLoad.get();
     if (!firmware) {
         throw firmware_missing_exception(config.DsiFirmwarePath());
     }
@@ -391,13 +679,13 @@ static MelonDsDs::DSiArgs MelonDsDs::GetDSiArgs(const CoreConfig& config, const
     // TODO: Customize the NAND first, then use the final value of TWLCFG to patch the firmware
     CustomizeFirmware(config, *firmware);
 
-    optional<string> nandPath = retro::get_system_path(nandName);
-    if (!nandPath) {
+    optional<NANDImage> loadedNand = nandLoad.get();
+    if (!loadedNand) {
         throw environment_exception("Failed to get the system directory, which means the NAND image can't be loaded.");
     }
 
-    NANDImage nand = LoadNANDImage(*nandPath, &(*arm7i)[0x8308]);
-    unique_ptr<melonDS::NDSCart::CartCommon> ndsRom = ndsInfo ? LoadNdsCart(config, *ndsInfo) : nullptr;
+    NANDImage nand = std::move(*loadedNand);
+    unique_ptr<melonDS::NDSCart::CartCommon> ndsRom = ndsRomLoad.get();
 
     { // Scoped to limit the mount's lifetime
         NANDMount mount(nand);
@@ -406,12 +694,11 @@ static MelonDsDs::DSiArgs MelonDsDs::GetDSiArgs(const CoreConfig& config, const
         }
         retro::debug("Opened and mounted the DSi NAND image file at {}", *nandPath);
 
-        const NDSHeader* header = ndsInfo ? reinterpret_cast<const NDSHeader*>(ndsInfo->GetData().data()) : nullptr;
         CustomizeNAND(config, mount, header, nandName);
 
         if (ndsInfo && ndsRom != nullptr && ndsRom->GetHeader().IsDSiWare()) {
             // If we're trying to play a DSiWare game...
-            InstallDsiware(mount, *ndsInfo); // Temporarily install the game on the NAND
+            InstallDsiware(mount, *ndsInfo, tmdLoad); // Temporarily install the game on the NAND
             ndsRom = nullptr; // Don't want to insert the DSiWare into the cart slot
         }
     }
@@ -426,7 +713,7 @@ static MelonDsDs::DSiArgs MelonDsDs::GetDSiArgs(const CoreConfig& config, const
             std::move(arm9i),
             std::move(arm7i),
             std::move(nand),
-            LoadDSiSDCardImage(config),
+            sdCardLoad.get(),
         },
         .ndsCart = std::move(ndsRom),
     };
@@ -440,9 +727,13 @@ static void MelonDsDs::ApplyCommonArgs(const CoreConfig& config, melonDS::NDSArg
     ZoneScopedN(TracyFunction);
     args.Interpolation = config.Interpolation();
     args.BitDepth = config.BitDepth();
+    args.JIT = GetJitArgs(config);
+}
+
+static std::optional<melonDS::JITArgs> MelonDsDs::GetJitArgs(const CoreConfig& config) noexcept {
 #ifdef JIT_ENABLED
     if (config.JitEnable()) {
-        args.JIT = {
+        return melonDS::JITArgs {
             .MaxBlockSize = config.MaxBlockSize(),
             .LiteralOptimizations = config.LiteralOptimizations(),
             .BranchOptimizations = config.BranchOptimizations(),
@@ -453,18 +744,17 @@ static void MelonDsDs::ApplyCommonArgs(const CoreConfig& config, melonDS::NDSArg
 #   endif
         };
     }
-    else {
-        args.JIT = std::nullopt;
-    }
-#else
-    args.JIT = std::nullopt;
 #endif
+    return std::nullopt;
 }
 
-static unique_ptr<melonDS::NDSCart::CartCommon> MelonDsDs::LoadNdsCart(const CoreConfig& config, const retro::GameInfo& ndsInfo) {
+void MelonDsDs::UpdateJit(const CoreConfig& config, melonDS::NDS& nds) noexcept {
     ZoneScopedN(TracyFunction);
-    span<const std::byte> rom = ndsInfo.GetData();
+    // Flushes the JIT's block cache, so the next few frames will be slower while it recompiles
+    nds.SetJITArgs(GetJitArgs(config));
+}
 
+void MelonDsDs::ValidateNdsRom(span<const std::byte> rom) {
     if (rom.size() < sizeof(NDSHeader)) {
         retro::error("ROM is only {} bytes, smaller than an NDS ROM header", rom.size());
         throw invalid_rom_exception("ROM is too small to be valid.");
@@ -482,6 +772,66 @@ static unique_ptr<melonDS::NDSCart::CartCommon> MelonDsDs::LoadNdsCart(const Cor
         retro::error("Expected logo CRC16 of 0xCF56, got 0x{:04x}", header.NintendoLogoCRC16);
         throw invalid_rom_exception("ROM isn't valid, did you select the right file?");
     }
+}
+
+unsigned MelonDsDs::PreloadSystemFiles(
+    const CoreConfig& config,
+    const NDSHeader* header,
+    string_view contentPath,
+    const std::atomic_bool& cancelled
+) noexcept {
+    ZoneScopedN(TracyFunction);
+    bool dsi = config.ConsoleType() == ConsoleType::DSi || (header && header->IsDSiWare());
+    if (!dsi && config.SysfileMode() != SysfileMode::Native) {
+        // If the console will use the built-in system files, there's nothing to read
+        return 0;
+    }
+
+    // Only the cache entries matter, the images themselves are thrown away
+    unsigned loaded = 0;
+    {
+        unique_ptr<melonDS::ARM7BIOSImage> arm7 = make_unique<melonDS::ARM7BIOSImage>();
+        unique_ptr<melonDS::ARM9BIOSImage> arm9 = make_unique<melonDS::ARM9BIOSImage>();
+        loaded += LoadBios(config.Bios7Path(), BiosType::Arm7, *arm7);
+        loaded += !cancelled && LoadBios(config.Bios9Path(), BiosType::Arm9, *arm9);
+    }
+
+    if (dsi && !cancelled) {
+        unique_ptr<melonDS::DSiBIOSImage> arm7i = make_unique<melonDS::DSiBIOSImage>();
+        unique_ptr<melonDS::DSiBIOSImage> arm9i = make_unique<melonDS::DSiBIOSImage>();
+        loaded += LoadBios(config.DsiBios7Path(), BiosType::Arm7i, *arm7i);
+        loaded += !cancelled && LoadBios(config.DsiBios9Path(), BiosType::Arm9i, *arm9i);
+    }
+
+    string_view firmwareName = dsi ? config.DsiFirmwarePath() : config.FirmwarePath();
+    if (firmwareName != config::values::NOT_FOUND && !cancelled) {
+        if (optional<string> firmwarePath = retro::get_system_path(firmwareName)) {
+            loaded += LoadFirmware(*firmwarePath).has_value();
+        }
+    }
+
+    if (header && header->IsDSiWare() && !cancelled) {
+        // If the next game is DSiWare, its title metadata may have to be downloaded
+        try {
+            loaded += FetchTmd(contentPath, *header, cancelled).has_value();
+        }
+        catch (const std::exception& e) {
+            retro::warn("Failed to preload title metadata for \"{}\": {}", contentPath, e.what());
+        }
+    }
+
+    return loaded;
+}
+
+static unique_ptr<melonDS::NDSCart::CartCommon> MelonDsDs::LoadNdsCart(const CoreConfig& config, const retro::GameInfo& ndsInfo) {
+    ZoneScopedN(TracyFunction);
+    span<const std::byte> rom = ndsInfo.GetData();
+    ValidateNdsRom(rom);
+
+    if (config.DldiEnable() && !config.DldiReadOnly() && config.DldiImageSize() > 0) {
+        // If melonDS would create a new image, create it sparse first so it isn't written out in full
+        CreateSparseFile(string(config.DldiImagePath()), config.DldiImageSize());
+    }
 
     melonDS::NDSCart::NDSCartArgs sdargs = {
         .SDCard = config.DldiSdCardArgs(),
@@ -600,7 +950,7 @@ static std::pair<unique_ptr<uint8_t[]>, size_t> MelonDsDs::LoadGbaSram(const ret
     return {std::move(gba_save_data), gba_save_file_size};
 }
 
-void MelonDsDs::InstallDsiware(NANDMount& mount, const retro::GameInfo& nds_info) {
+void MelonDsDs::InstallDsiware(NANDMount& mount, const retro::GameInfo& nds_info, retro::future<optional<TitleMetadata>>& tmdLoad) {
     ZoneScopedN(TracyFunction);
     std::string_view path = nds_info.GetPath();
     retro::info("Temporarily installing DSiWare title \"{}\" onto DSi NAND image", path);
@@ -614,19 +964,11 @@ void MelonDsDs::InstallDsiware(NANDMount& mount, const retro::GameInfo& nds_info
     } else {
         retro::info("Title \"{}\" is not on loaded NAND; will install it for the duration of this session.", path);
 
-        char tmd_path[PATH_MAX];
-        GetTmdPath(nds_info, tmd_path);
-
-        optional<TitleMetadata> tmd = GetCachedTmd(tmd_path);
-
+        optional<TitleMetadata> tmd = tmdLoad.get();
         if (!tmd) {
-            // If the TMD isn't available locally...
-
+            // If the TMD isn't available locally and we couldn't download it...
 #ifdef HAVE_NETWORKING
-            if (tmd = DownloadTmd(header, tmd_path); !tmd) {
-                // ...then download it and save it to disk. If that didn't work...
-                throw missing_metadata_exception("Cannot get title metadata for installation");
-            }
+            throw missing_metadata_exception("Cannot get title metadata for installation");
 #else
             throw missing_metadata_exception("Cannot get title metadata for installation, and this build does not support downloading it");
 #endif
@@ -636,6 +978,8 @@ void MelonDsDs::InstallDsiware(NANDMount& mount, const retro::GameInfo& nds_info
             throw emulator_exception("Failed to import DSiWare title into NAND image");
         }
 
+        // If the title is kept installed after this session,
+        // this is the last time its save data is imported (until it's uninstalled)
         ImportDsiwareSaveData(mount, nds_info, header, TitleData_PublicSav);
         ImportDsiwareSaveData(mount, nds_info, header, TitleData_PrivateSav);
         ImportDsiwareSaveData(mount, nds_info, header, TitleData_BannerSav);
@@ -647,11 +991,10 @@ void MelonDsDs::InstallDsiware(NANDMount& mount, const retro::GameInfo& nds_info
     }
 }
 
-static void MelonDsDs::GetTmdPath(const retro::GameInfo &nds_info, std::span<char> buffer) {
-    auto path = nds_info.GetPath();
+static void MelonDsDs::GetTmdPath(string_view contentPath, std::span<char> buffer) {
     char tmd_name[PATH_MAX] {}; // "/path/to/game.zip#game.nds"
-    const char *ptr = path_basename(path.data());  // "game.nds"
-    strlcpy(tmd_name, ptr ? ptr : path.data(), sizeof(tmd_name));
+    const char *ptr = path_basename(contentPath.data());  // "game.nds"
+    strlcpy(tmd_name, ptr ? ptr : contentPath.data(), sizeof(tmd_name));
     path_remove_extension(tmd_name); // "game"
     strlcat(tmd_name, ".tmd", sizeof(tmd_name)); // "game.tmd"
 
@@ -669,6 +1012,27 @@ static void MelonDsDs::GetTmdPath(const retro::GameInfo &nds_info, std::span<cha
     // "/libretro/system/melonDS DS/tmd/game.tmd"
 }
 
+/// Returns the title metadata for the given DSiWare game,
+/// either from the local cache or (if networking is enabled) from Nintendo's servers.
+static optional<TitleMetadata> MelonDsDs::FetchTmd(string_view contentPath, const NDSHeader& header, const std::atomic_bool& cancelled) {
+    ZoneScopedN(TracyFunction);
+    char tmd_path[PATH_MAX];
+    GetTmdPath(contentPath, tmd_path);
+
+    if (optional<TitleMetadata> tmd = GetCachedTmd(tmd_path)) {
+        return tmd;
+    }
+
+#ifdef HAVE_NETWORKING
+    // If the TMD isn't available locally, then download it and save it to disk
+    return DownloadTmd(header, tmd_path, cancelled);
+#else
+    (void)header;
+    (void)cancelled;
+    return nullopt;
+#endif
+}
+
 static optional<TitleMetadata> MelonDsDs::GetCachedTmd(string_view tmdPath) noexcept {
     ZoneScopedN(TracyFunction);
     RFILE *tmd_file = filestream_open(tmdPath.data(), RETRO_VFS_FILE_ACCESS_READ, RETRO_VFS_FILE_ACCESS_HINT_NONE);
@@ -714,7 +1078,8 @@ static bool MelonDsDs::ValidateTmd(const TitleMetadata &tmd) noexcept {
     return true;
 }
 
-static optional<TitleMetadata> MelonDsDs::DownloadTmd(const NDSHeader &header, string_view tmdPath) noexcept {
+#ifdef HAVE_NETWORKING
+static optional<TitleMetadata> MelonDsDs::DownloadTmd(const NDSHeader &header, string_view tmdPath, const std::atomic_bool& cancelled) noexcept {
     ZoneScopedN(TracyFunction);
     auto url = fmt::format(
         "http://nus.cdn.t.shop.nintendowifi.net/ccs/download/{:08x}{:08x}/tmd",
@@ -724,31 +1089,23 @@ static optional<TitleMetadata> MelonDsDs::DownloadTmd(const NDSHeader &header, s
     // The URL comes from here https://problemkaputt.de/gbatek.htm#dsisdmmcdsiwarefilesfromnintendosserver
     // Example: http://nus.cdn.t.shop.nintendowifi.net/ccs/download/00030015484e4250/tmd
 
-    retro::info("Downloading title metadata from \"{}\"", url);
+    retro::info("Fetching title metadata from \"{}\"", url);
 
-    // Create and send the HTTP request
-    retro::HttpConnection connection(url, "GET");
-
-    size_t progress = 0, total = 0;
-    while (!connection.Update(progress, total)) {
-        retro_sleep(20);
-        // TODO: Use select with a timeout instead of a busy loop
+    optional<DownloadCache> cache = DownloadCache::Default();
+    if (!cache) {
+        retro::error("No system directory is available to cache downloads in");
+        return nullopt;
     }
 
-    if (connection.IsError()) {
-        // If there was a problem...
-        if (int status = connection.Status(); status > 0) {
-            // ...but we did manage to get a status code...
-            retro::error("HTTP request to {} failed with {}", url, connection.Status());
-        } else {
-            retro::error("HTTP request to {} failed with unknown error", url);
-        }
-
+    // This runs on one of the loader threads (or a background task's), so blocking won't hold up anything else.
+    // If the prefetch task is already downloading this TMD, we'll just wait for it.
+    optional<std::vector<std::byte>> body = cache->Fetch(url, TMD_CACHE_MAX_AGE, TMD_DOWNLOAD_TIMEOUT, cancelled);
+    if (!body) {
+        // Fetch already logged why
         return nullopt;
     }
 
-    // If the request succeeded, get the payload
-    span<const std::byte> payload = connection.Data(false);
+    span<const std::byte> payload = *body;
     if (payload.empty()) {
         // If there was no payload...
         retro::error("HTTP request to {} succeeded, but it sent no data", url);
@@ -805,6 +1162,91 @@ static bool MelonDsDs::CacheTmd(string_view tmd_path, std::span<const std::byte>
     }
 }
 
+/// Downloads the title metadata for each DSiWare game in \c directory that doesn't have it cached yet.
+/// Returns the number of titles whose metadata was downloaded.
+static unsigned MelonDsDs::PrefetchTmds(const string& directory, const std::atomic_bool& cancelled) {
+    ZoneScopedN(TracyFunction);
+    unsigned downloaded = 0;
+    for (const retro::dirent& d : retro::readdir(directory, false)) {
+        if (cancelled)
+            break;
+
+        const char* extension = path_get_extension(d.path);
+        if (!d.is_regular_file() || !(string_is_equal_noncase(extension, "nds") || string_is_equal_noncase(extension, "dsi")))
+            continue;
+
+        NDSHeader header {};
+        RFILE* file = filestream_open(d.path, RETRO_VFS_FILE_ACCESS_READ, RETRO_VFS_FILE_ACCESS_HINT_NONE);
+        if (!file)
+            continue;
+
+        int64_t bytesRead = filestream_read(file, &header, sizeof(header));
+        filestream_close(file);
+        if (bytesRead != sizeof(header) || !header.IsDSiWare())
+            continue;
+
+        char tmd_path[PATH_MAX];
+        GetTmdPath(d.path, tmd_path);
+        if (path_is_valid(tmd_path))
+            continue; // We've already got this one (it'll be validated when it's loaded)
+
+        if (DownloadTmd(header, tmd_path, cancelled)) {
+            ++downloaded;
+        }
+    }
+
+    return downloaded;
+}
+
+retro::task::TaskSpec MelonDsDs::PrefetchTmdTask(string_view contentPath) {
+    ZoneScopedN(TracyFunction);
+    char content_dir[PATH_MAX] {}; // "/path/to/game.zip#game.nds"
+    strlcpy(content_dir, contentPath.data(), sizeof(content_dir));
+    path_basedir(content_dir); // "/path/to/"
+
+    struct Prefetch {
+        std::atomic_bool Cancelled = false;
+        std::unique_ptr<retro::future<unsigned>> Downloads;
+    };
+
+    auto prefetch = std::make_shared<Prefetch>();
+    return retro::task::TaskSpec(
+        [prefetch, directory = string(content_dir)](retro::task::TaskHandle& task) noexcept {
+            if (!prefetch->Downloads) {
+                // Start on the task's first tick so that whoever queued it isn't held up
+                prefetch->Downloads = std::make_unique<retro::future<unsigned>>([cancelled = &prefetch->Cancelled, directory] {
+                    return PrefetchTmds(directory, *cancelled);
+                });
+            }
+
+            if (!prefetch->Downloads->ready())
+                return;
+
+            try {
+                unsigned downloaded = prefetch->Downloads->get();
+                retro::info("Prefetched title metadata for {} DSiWare game(s) in \"{}\"", downloaded, directory);
+            }
+            catch (const std::exception& e) {
+                task.SetError(e.what());
+            }
+
+            task.Finish();
+        },
+        [](retro::task::TaskHandle& task, void*, string_view error) noexcept {
+            if (!task.IsCancelled() && !error.empty())
+                retro::warn("Failed to prefetch DSiWare title metadata: {}", error);
+        },
+        [prefetch](retro::task::TaskHandle&) noexcept {
+            // Stops the download in progress (if any), then waits for the thread
+            prefetch->Cancelled = true;
+            prefetch->Downloads = nullptr;
+        },
+        retro::task::ASAP,
+        "DsiwareTmdPrefetchTask"
+    );
+}
+#endif
+
 static void MelonDsDs::ImportDsiwareSaveData(NANDMount& nand, const retro::GameInfo& nds_info, const NDSHeader& header, int type) noexcept {
     ZoneScopedN(TracyFunction);
 
@@ -836,11 +1278,39 @@ static void MelonDsDs::ImportDsiwareSaveData(NANDMount& nand, const retro::GameI
         retro::info("No DSiWare save data found at \"{}\"", sav_file);
     } else if (nand.ImportTitleData(header.DSiTitleIDHigh, header.DSiTitleIDLow, type, sav_file)) {
         retro::info("Imported DSiWare save data from \"{}\"", sav_file);
+        if (optional<std::vector<std::byte>> data = ReadDsiwareSaveFile(sav_file)) {
+            std::lock_guard lock(dsiwareSaveDataLock);
+            dsiwareSaveData.insert_or_assign(sav_file, std::move(*data));
+        }
     } else {
         retro::warn("Couldn't import DSiWare save data from \"{}\"", sav_file);
     }
 }
 
+bool MelonDsDs::IsDsiwareSaveDataUnchanged(std::string_view path, std::span<const std::byte> data) noexcept {
+    ZoneScopedN(TracyFunction);
+    string key(path);
+
+    std::lock_guard lock(dsiwareSaveDataLock);
+    auto it = dsiwareSaveData.find(key);
+    if (it == dsiwareSaveData.end()) {
+        // If this file wasn't imported (or was rewritten) since it was last read, compare against what's on disk
+        optional<std::vector<std::byte>> existing = ReadDsiwareSaveFile(key.c_str());
+        if (!existing)
+            return false;
+
+        it = dsiwareSaveData.insert_or_assign(std::move(key), std::move(*existing)).first;
+    }
+
+    if (std::ranges::equal(it->second, data))
+        return true;
+
+    // The caller is about to rewrite this file, but the write might fail;
+    // the next check reads whatever actually ended up on disk
+    dsiwareSaveData.erase(it);
+    return false;
+}
+
 bool MelonDsDs::GetDsiwareSaveDataHostPath(std::span<char> buffer, const retro::GameInfo& nds_info, int type) noexcept {
     if (buffer.empty()) {
         return false;
@@ -880,6 +1350,18 @@ static bool MelonDsDs::LoadBios(const string_view& name, BiosType type, std::spa
     ZoneScopedN(TracyFunction);
 
     auto LoadBiosImpl = [&](const string& path) -> bool {
+        optional<std::pair<int64_t, int64_t>> stamp = SystemFileStamp(path);
+        {
+            std::lock_guard lock(systemFileCacheLock);
+            const SystemFileImage* cached = FindCachedSystemFile(biosCache, path, stamp);
+            if (cached && cached->Data().size() == buffer.size()) {
+                // If we've already loaded and validated this exact file...
+                memcpy(buffer.data(), cached->Data().data(), buffer.size());
+                retro::debug("Using cached {}-byte {} file \"{}\"", buffer.size(), type, path);
+                return true;
+            }
+        }
+
         RFILE* file = filestream_open(path.c_str(), RETRO_VFS_FILE_ACCESS_READ, RETRO_VFS_FILE_ACCESS_HINT_NONE);
 
         if (!file) {
@@ -904,6 +1386,15 @@ static bool MelonDsDs::LoadBios(const string_view& name, BiosType type, std::spa
         filestream_close(file);
         retro::info("Successfully loaded {}-byte {} file \"{}\"", buffer.size(), type, path);
 
+        if (stamp) {
+            std::lock_guard lock(systemFileCacheLock);
+            biosCache.insert_or_assign(path, CachedSystemFile<SystemFileImage> {
+                .Size = stamp->first,
+                .ModifiedTime = stamp->second,
+                .Image = MakeSystemFileImage(path, buffer),
+            });
+        }
+
         return true;
     };
 
@@ -930,6 +1421,17 @@ static optional<Firmware> MelonDsDs::LoadFirmware(const string& firmwarePath) no
     using namespace MelonDsDs;
     using namespace MelonDsDs::config::firmware;
 
+    optional<std::pair<int64_t, int64_t>> stamp = SystemFileStamp(firmwarePath);
+    {
+        std::lock_guard lock(systemFileCacheLock);
+        if (const SystemFileImage* cached = FindCachedSystemFile(firmwareCache, firmwarePath, stamp)) {
+            // If we've already loaded and validated this exact file...
+            // (the copy is customized later, the cached image stays pristine)
+            retro::debug("Using cached firmware file \"{}\"", firmwarePath);
+            return make_optional<Firmware>(cached->Data().data(), cached->Data().size());
+        }
+    }
+
     // Try to open the configured firmware dump.
     RFILE* file = filestream_open(firmwarePath.c_str(), RETRO_VFS_FILE_ACCESS_READ, RETRO_VFS_FILE_ACCESS_HINT_NONE);
     if (!file) {
@@ -968,6 +1470,15 @@ static optional<Firmware> MelonDsDs::LoadFirmware(const string& firmwarePath) no
         string_view(reinterpret_cast<const char*>(id.data()), 4)
     );
 
+    if (stamp) {
+        std::lock_guard lock(systemFileCacheLock);
+        firmwareCache.insert_or_assign(firmwarePath, CachedSystemFile<SystemFileImage> {
+            .Size = stamp->first,
+            .ModifiedTime = stamp->second,
+            .Image = MakeSystemFileImage(firmwarePath, span<const uint8_t>(buffer.get(), fileSize)),
+        });
+    }
+
     return firmware;
 }
 
@@ -981,7 +1492,60 @@ static void MelonDsDs::CustomizeFirmware(const CoreConfig& config, Firmware& fir
         throw environment_exception("No system directory is available");
     }
 
+    // These may come from the frontend or the environment, so they're resolved before consulting the cache
+    optional<u16string> username;
+    if (config.UsernameMode() != UsernameMode::Firmware) {
+        // If we want to override the existing username...
+        username = ResolveUsername(config.UsernameMode());
+    }
+    optional<Firmware::Language> language = ResolveFirmwareLanguage(config.Language());
+
+    string key;
+    AppendToKey(key, firmware.Length());
+    AppendToKey(key, encoding_crc32(0, firmware.Buffer(), firmware.Length()));
+    optional<std::pair<int64_t, int64_t>> stamp = SystemFileStamp(*wfcsettingspath);
+    AppendToKey(key, stamp.has_value());
+    if (stamp) {
+        AppendToKey(key, stamp->first);
+        AppendToKey(key, stamp->second);
+    }
+    AppendToKey(key, language);
+    AppendToKey(key, config.FavoriteColor());
+    auto birthday = config.Birthday();
+    AppendToKey(key, birthday.has_value());
+    if (birthday) {
+        AppendToKey(key, static_cast<unsigned>(birthday->month()));
+        AppendToKey(key, static_cast<unsigned>(birthday->day()));
+    }
+    auto alarm = config.Alarm();
+    AppendToKey(key, alarm.has_value());
+    if (alarm) {
+        AppendToKey(key, alarm->hours().count());
+        AppendToKey(key, alarm->minutes().count());
+    }
+    AppendToKey(key, config.DnsServer());
+    AppendToKey(key, config.MacAddress());
+    AppendToKey(key, username ? username->size() : SIZE_MAX);
+    if (username) {
+        key.append(reinterpret_cast<const char*>(username->data()), username->size() * sizeof(char16_t));
+    }
+    key += *wfcsettingspath;
+
+    {
+        std::lock_guard lock(systemFileCacheLock);
+        if (auto cached = customizedFirmwareCache.find(key); cached != customizedFirmwareCache.end()) {
+            // If we've already customized this exact image with these exact settings...
+            retro::debug("Using cached customized firmware");
+            firmware = Firmware(cached->second.Image.data(), cached->second.Image.size());
+            if (cached->second.Corrupted) {
+                WarnCorruptedFirmware(config);
+            }
+            return;
+        }
+    }
+
     const Firmware::FirmwareHeader& header = firmware.GetHeader();
+    bool corrupted = false;
 
     // If using generated firmware, we keep the wi-fi settings on the host disk separately.
     // Wi-fi access point data includes Nintendo WFC settings,
@@ -1035,61 +1599,25 @@ static void MelonDsDs::CustomizeFirmware(const CoreConfig& config, Firmware& fir
         memset(&chk2[0x0C], 0, 8);
 
         if (!memcmp(chk1, chk2, sizeof(chk1))) {
-            constexpr const char* const WARNING_MESSAGE =
-                "Corrupted firmware detected!\n"
-                "Any game that alters Wi-fi settings will break this firmware, even on real hardware.\n";
-
-            if (config.ShowBiosWarnings()) {
-                retro::set_warn_message(WARNING_MESSAGE);
-            }
-            else {
-                retro::warn(WARNING_MESSAGE);
-            }
+            corrupted = true;
+            WarnCorruptedFirmware(config);
         }
     }
 
     Firmware::UserData& currentData = firmware.GetEffectiveUserData();
 
     // setting up username
-    if (config.UsernameMode() != UsernameMode::Firmware) {
-        // If we want to override the existing username...
-        optional<string> username = GetUsername(config.UsernameMode());
-        if (!username || username->empty()) {
-            retro::set_warn_message("Failed to get username, or none was provided; using default");
-            username = config::values::firmware::DEFAULT_USERNAME;
-        }
-
-        optional<u16string> convertedUsername = ConvertUsername(*username);
-        if (!convertedUsername) {
-            retro::set_warn_message("Can't use the name \"{}\" on the DS, using default name instead.", *username);
-            convertedUsername = ConvertUsername(config::values::firmware::DEFAULT_USERNAME);
-        }
-
-        size_t usernameLength = std::min(convertedUsername->length(), (size_t)config::DS_NAME_LIMIT);
+    if (username) {
+        size_t usernameLength = std::min(username->length(), (size_t)config::DS_NAME_LIMIT);
         currentData.NameLength = usernameLength;
 
         memset(currentData.Nickname, 0, sizeof(currentData.Nickname));
-        memcpy(currentData.Nickname, convertedUsername->data(), usernameLength * sizeof(char16_t));
+        memcpy(currentData.Nickname, username->data(), usernameLength * sizeof(char16_t));
     }
 
-    switch (config.Language()) {
-        case FirmwareLanguage::Auto:
-
-            if (optional<retro_language> retroLanguage = retro::get_language()) {
-                currentData.Settings &= ~Firmware::Language::Reserved; // clear the existing language bits
-                currentData.Settings |= GetFirmwareLanguage(*retroLanguage);
-            }
-            else {
-                retro::warn("Failed to get language from frontend; defaulting to existing firmware value");
-            }
-            break;
-        case FirmwareLanguage::Default:
-            // do nothing, leave the existing language in place
-            break;
-        default:
-            currentData.Settings &= ~Firmware::Language::Reserved;
-            currentData.Settings |= static_cast<Firmware::Language>(config.Language());
-            break;
+    if (language) {
+        currentData.Settings &= ~Firmware::Language::Reserved; // clear the existing language bits
+        currentData.Settings |= *language;
     }
 
     if (config.FavoriteColor() != Color::Default) {
@@ -1130,6 +1658,63 @@ static void MelonDsDs::CustomizeFirmware(const CoreConfig& config, Firmware& fir
     currentData.TouchCalibrationPixel2[1] = 191;
 
     firmware.UpdateChecksums();
+
+    std::lock_guard lock(systemFileCacheLock);
+    if (customizedFirmwareCache.size() >= MAX_CUSTOMIZED_FIRMWARE_CACHE_SIZE) {
+        // If the options keep changing, there's no point in holding on to the old results
+        customizedFirmwareCache.clear();
+    }
+    customizedFirmwareCache.insert_or_assign(std::move(key), CustomizedFirmware {
+        .Image = std::vector<uint8_t>(firmware.Buffer(), firmware.Buffer() + firmware.Length()),
+        .Corrupted = corrupted,
+    });
+}
+
+static void MelonDsDs::WarnCorruptedFirmware(const CoreConfig& config) noexcept {
+    constexpr const char* const WARNING_MESSAGE =
+        "Corrupted firmware detected!\n"
+        "Any game that alters Wi-fi settings will break this firmware, even on real hardware.\n";
+
+    if (config.ShowBiosWarnings()) {
+        retro::set_warn_message(WARNING_MESSAGE);
+    }
+    else {
+        retro::warn(WARNING_MESSAGE);
+    }
+}
+
+static std::u16string MelonDsDs::ResolveUsername(UsernameMode mode) noexcept {
+    optional<string> username = GetUsername(mode);
+    if (!username || username->empty()) {
+        retro::set_warn_message("Failed to get username, or none was provided; using default");
+        username = config::values::firmware::DEFAULT_USERNAME;
+    }
+
+    optional<u16string> convertedUsername = ConvertUsername(*username);
+    if (!convertedUsername) {
+        retro::set_warn_message("Can't use the name \"{}\" on the DS, using default name instead.", *username);
+        convertedUsername = ConvertUsername(config::values::firmware::DEFAULT_USERNAME);
+    }
+
+    return std::move(*convertedUsername);
+}
+
+/// Returns the language that the firmware should be set to, or \c nullopt to keep its own.
+static optional<Firmware::Language> MelonDsDs::ResolveFirmwareLanguage(FirmwareLanguage language) noexcept {
+    switch (language) {
+        case FirmwareLanguage::Auto:
+            if (optional<retro_language> retroLanguage = retro::get_language()) {
+                return GetFirmwareLanguage(*retroLanguage);
+            }
+
+            retro::warn("Failed to get language from frontend; defaulting to existing firmware value");
+            return nullopt;
+        case FirmwareLanguage::Default:
+            // do nothing, leave the existing language in place
+            return nullopt;
+        default:
+            return static_cast<Firmware::Language>(language);
+    }
 }
 
 static std::optional<std::string> MelonDsDs::GetUsername(UsernameMode mode) noexcept {
@@ -1232,6 +1817,7 @@ static void MelonDsDs::CustomizeNAND(const CoreConfig& config, NANDMount& mount,
     if (!mount.ReadUserData(settings)) {
         throw emulator_exception("Failed to read user data from NAND image");
     }
+    const DSiFirmwareSystemSettings originalSettings = settings;
 
     // Right now, I only modify the user data with the firmware overrides defined by core options
     // If there are any problems, I may want to completely synchronize the user data and firmware myself.
@@ -1328,6 +1914,12 @@ static void MelonDsDs::CustomizeNAND(const CoreConfig& config, NANDMount& mount,
 
     settings.UpdateHash();
 
+    if (memcmp(&settings, &originalSettings, sizeof(settings)) == 0) {
+        // If the NAND already has these settings (e.g. from the last session with the same options)...
+        retro::debug("DSi NAND user data is already up-to-date, not rewriting it");
+        return;
+    }
+
     if (!mount.ApplyUserData(settings)) {
         throw emulator_exception("Failed to write user data to NAND image");
     }
@@ -1337,10 +1929,27 @@ static optional<melonDS::FATStorage> MelonDsDs::LoadDSiSDCardImage(const CoreCon
     ZoneScopedN(TracyFunction);
     if (!config.DsiSdEnable()) return nullopt;
 
-    return melonDS::FATStorage(
+    // With folder sync enabled, this is where the host folder's changes are imported into the image;
+    // FATStorage keeps an index next to the image so that only changed files are copied
+    auto start = std::chrono::steady_clock::now();
+    if (!config.DsiSdReadOnly() && config.DsiSdImageSize() > 0) {
+        // If melonDS would create a new image, create it sparse first so it isn't written out in full
+        CreateSparseFile(string(config.DsiSdImagePath()), config.DsiSdImageSize());
+    }
+
+    melonDS::FATStorage sdCard(
         string(config.DsiSdImagePath()),
         config.DsiSdImageSize(),
         config.DsiSdReadOnly(),
         config.DsiSdFolderSync() ? make_optional(string(config.DsiSdFolderPath())) : nullopt
     );
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    retro::info(
+        "Loaded DSi SD card image \"{}\" in {:.1f}ms{}",
+        config.DsiSdImagePath(),
+        elapsed.count(),
+        config.DsiSdFolderSync() ? " (including folder sync)" : ""
+    );
+
+    return sdCard;
 }
\ No newline at end of file
@@ -17,17 +17,25 @@
 #ifndef MELONDSDS_CONFIG_CONSOLE_HPP
 #define MELONDSDS_CONFIG_CONSOLE_HPP
 
+#include <atomic>
+#include <cstddef>
 #include <memory>
+#include <string_view>
 #include "std/span.hpp"
 
 namespace melonDS {
     class NDS;
+    struct NDSHeader;
 }
 
 namespace retro {
     class GameInfo;
 }
 
+namespace retro::task {
+    class TaskSpec;
+}
+
 namespace MelonDsDs {
     class CoreConfig;
     class CoreState;
@@ -44,10 +52,48 @@ namespace MelonDsDs {
     /// Modify a console instance with core options that are safe to adjust at runtime.
     void UpdateConsole(const CoreConfig& config, melonDS::NDS& nds) noexcept;
 
+    /// Applies the JIT options to a running console,
+    /// e.g. to try out a different block size without a reset.
+    void UpdateJit(const CoreConfig& config, melonDS::NDS& nds) noexcept;
+
     /// Modify a console instance with core options that require a reset to adjust.
     void ResetConsole(const CoreConfig& config, melonDS::NDS& nds);
 
+    /// Returns \c true if any options that were baked into the console by \c CreateConsole
+    /// (e.g. the console type, system files, or firmware settings) differ between \c previous and \c current,
+    /// meaning that the console can't be reset in-place.
+    [[nodiscard]] bool RequiresNewConsole(const CoreConfig& previous, const CoreConfig& current) noexcept;
+
+    /// Throws \c invalid_rom_exception if \c rom doesn't look like an NDS ROM.
+    void ValidateNdsRom(std::span<const std::byte> rom);
+
+    /// Loads and validates the system files that \c CreateConsole would need for the game with \c header
+    /// (or for booting without content, if it's \c nullptr) into the caches that it reads from,
+    /// so that the next console can skip the reads.
+    /// Safe to call from any thread; stops early once \c cancelled is set.
+    /// @returns The number of files that were loaded or already cached.
+    unsigned PreloadSystemFiles(
+        const CoreConfig& config,
+        const melonDS::NDSHeader* header,
+        std::string_view contentPath,
+        const std::atomic_bool& cancelled
+    ) noexcept;
+
     bool GetDsiwareSaveDataHostPath(std::span<char> buffer, const retro::GameInfo& nds_info, int type) noexcept;
+
+    /// Compares \c data byte-for-byte with the DSiWare save file at \c path
+    /// as it was when last imported (or read by this function), reading it if need be.
+    /// Safe to call from any thread.
+    /// @returns \c true if they match, in which case the file doesn't need to be written.
+    /// If they don't, the remembered contents are dropped so that
+    /// a failed write of \c data can't be mistaken for a successful one later.
+    bool IsDsiwareSaveDataUnchanged(std::string_view path, std::span<const std::byte> data) noexcept;
+
+#ifdef HAVE_NETWORKING
+    /// Returns a task that downloads the title metadata for each DSiWare game
+    /// in the same directory as \c contentPath, so that loading them later doesn't have to wait for the network.
+    retro::task::TaskSpec PrefetchTmdTask(std::string_view contentPath);
+#endif
 }
 
 #endif // MELONDSDS_CONFIG_CONSOLE_HPP
@@ -43,18 +43,25 @@ namespace MelonDsDs::config {
     namespace audio {
         static constexpr const char *const CATEGORY = "audio";
         static constexpr const char *const AUDIO_BITDEPTH = "melonds_audio_bitdepth";
+        static constexpr const char *const AUDIO_CALLBACK = "melonds_audio_callback";
         static constexpr const char *const AUDIO_INTERPOLATION = "melonds_audio_interpolation";
+        static constexpr const char *const AUDIO_OUTPUT_RATE = "melonds_audio_output_rate";
+        static constexpr const char *const AUDIO_RATE_CONTROL = "melonds_audio_rate_control";
+        static constexpr const char *const AUDIO_RESAMPLER_QUALITY = "melonds_audio_resampler_quality";
         static constexpr const char *const MIC_INPUT = "melonds_mic_input";
         static constexpr const char *const MIC_INPUT_BUTTON = "melonds_mic_input_active";
     }
 
     namespace cpu {
         static constexpr const char* const CATEGORY = "cpu";
+        static constexpr const char *const EMULATION_THREAD_PLACEMENT = "melonds_emulation_thread_placement";
+        static constexpr const char *const JIT_AUTO_TUNE = "melonds_jit_auto_tune";
         static constexpr const char *const JIT_BLOCK_SIZE = "melonds_jit_block_size";
         static constexpr const char *const JIT_BRANCH_OPTIMISATIONS = "melonds_jit_branch_optimisations";
         static constexpr const char *const JIT_ENABLE = "melonds_jit_enable";
         static constexpr const char *const JIT_FAST_MEMORY = "melonds_jit_fast_memory";
         static constexpr const char *const JIT_LITERAL_OPTIMISATIONS = "melonds_jit_literal_optimisations";
+        static constexpr const char *const RENDER_THREAD_PLACEMENT = "melonds_render_thread_placement";
     }
 
     namespace firmware {
@@ -75,6 +82,9 @@ namespace MelonDsDs::config {
         static constexpr const char *const NETWORK_MODE = "melonds_network_mode";
         static constexpr const char *const DIRECT_NETWORK_INTERFACE = "melonds_direct_network_interface";
         static constexpr const char *const MAC_ADDRESS_MODE = "melonds_mac_address_mode";
+        static constexpr const char *const MP_PACKET_BATCHING = "melonds_mp_packet_batching";
+        static constexpr const char *const MP_RECEIVE_TIMEOUT = "melonds_mp_receive_timeout";
+        static constexpr const char *const MP_TRANSPORT = "melonds_mp_transport";
     }
 
     namespace osd {
@@ -88,6 +98,10 @@ namespace MelonDsDs::config {
         static constexpr const char *const LID_STATE = "melonds_show_lid_state";
         static constexpr const char *const SENSOR_READING = "melonds_show_sensor_reading";
         static constexpr const char *const BRIGHTNESS_STATE = "melonds_show_brightness_state";
+        static constexpr const char *const FRAME_TIMINGS = "melonds_show_frame_timings";
+        static constexpr const char *const PERFORMANCE_OVERLAY = "melonds_show_performance_overlay";
+        static constexpr const char *const MP_STATS = "melonds_show_mp_stats";
+        static constexpr const char *const SAVE_TRACE = "melonds_save_trace";
     }
 
     namespace screen {
@@ -102,6 +116,7 @@ namespace MelonDsDs::config {
         static constexpr const char *const HYBRID_SMALL_SCREEN = "melonds_hybrid_small_screen";
         static constexpr const char *const NUMBER_OF_SCREEN_LAYOUTS = "melonds_number_of_screen_layouts";
         static constexpr const char *const SCREEN_GAP = "melonds_screen_gap";
+        static constexpr const char *const SCREEN_ROTATION = "melonds_screen_rotation";
         static constexpr const char *const SCREEN_LAYOUT1 = "melonds_screen_layout1";
         static constexpr const char *const SCREEN_LAYOUT2 = "melonds_screen_layout2";
         static constexpr const char *const SCREEN_LAYOUT3 = "melonds_screen_layout3";
@@ -130,13 +145,22 @@ namespace MelonDsDs::config {
 
     namespace system {
         static constexpr const char *const CATEGORY = "system";
+        static constexpr const char *const BATTERY_SAVER = "melonds_battery_saver";
         static constexpr const char *const BATTERY_UPDATE_INTERVAL = "melonds_battery_update_interval";
         static constexpr const char *const BOOT_MODE = "melonds_boot_mode";
         static constexpr const char *const CONSOLE_MODE = "melonds_console_mode";
+        static constexpr const char *const DETERMINISTIC = "melonds_deterministic";
         static constexpr const char *const DS_POWER_OK = "melonds_ds_battery_ok_threshold";
+        static constexpr const char *const FILE_READ_AHEAD = "melonds_file_read_ahead";
         static constexpr const char *const FIRMWARE_PATH = "melonds_firmware_nds_path";
         static constexpr const char *const FIRMWARE_DSI_PATH = "melonds_firmware_dsi_path";
+        static constexpr const char *const LID_POWER_SAVING = "melonds_lid_power_saving";
+        static constexpr const char *const LOW_MEMORY_MODE = "melonds_low_memory_mode";
         static constexpr const char *const OVERRIDE_FIRMWARE_SETTINGS = "melonds_override_fw_settings";
+        static constexpr const char *const REWIND_BUFFER_SIZE = "melonds_rewind_buffer_size";
+        static constexpr const char *const SHARE_FILE_MAPPINGS = "melonds_share_file_mappings";
+        static constexpr const char *const RUN_AHEAD = "melonds_run_ahead";
+        static constexpr const char *const REWIND_INTERVAL = "melonds_rewind_interval";
         static constexpr const char *const RUMBLE_INTENSITY = "melonds_rumble_intensity";
         static constexpr const char *const RUMBLE_TYPE = "melonds_rumble_type";
         static constexpr const char *const SLOT2_DEVICE = "melonds_slot2_device";
@@ -149,10 +173,14 @@ namespace MelonDsDs::config {
         static constexpr const char *const DSI_SD_SAVE_MODE = "melonds_dsi_sdcard";
         static constexpr const char *const DSI_SD_SYNC_TO_HOST = "melonds_dsi_sdcard_sync_sdcard_to_host";
         static constexpr const char *const DSI_NAND_PATH = "melonds_dsi_nand_path";
+        static constexpr const char *const DSIWARE_KEEP_INSTALLED = "melonds_dsiware_keep_installed";
+        static constexpr const char *const DSIWARE_TMD_PREFETCH = "melonds_dsiware_tmd_prefetch";
         static constexpr const char *const GBA_FLUSH_DELAY = "melonds_gba_flush_delay";
         static constexpr const char *const HOMEBREW_READ_ONLY = "melonds_homebrew_readonly";
         static constexpr const char *const HOMEBREW_SAVE_MODE = "melonds_homebrew_sdcard";
         static constexpr const char *const HOMEBREW_SYNC_TO_HOST = "melonds_homebrew_sync_sdcard_to_host";
+        static constexpr const char *const NDS_SAVE_DIRECT = "melonds_nds_save_direct";
+        static constexpr const char *const SAVE_JOURNAL = "melonds_save_journal";
     }
 
     namespace time {
@@ -173,11 +201,24 @@ namespace MelonDsDs::config {
     namespace video {
         constexpr unsigned INITIAL_MAX_OPENGL_SCALE = 4;
         constexpr unsigned MAX_OPENGL_SCALE = 8;
+        constexpr unsigned MAX_FRAMES_IN_FLIGHT = 3;
+        // Including the thread that's composing the frame
+        constexpr unsigned MAX_PARALLEL_COMPOSITION_THREADS = 8;
         static constexpr const char *const CATEGORY = "video";
+        static constexpr const char *const FRAMESKIP = "melonds_frameskip";
+        static constexpr const char *const GPU_COMPOSITION = "melonds_gpu_composition";
         static constexpr const char *const OPENGL_BETTER_POLYGONS = "melonds_opengl_better_polygons";
+        static constexpr const char *const OPENGL_DYNAMIC_RESOLUTION = "melonds_opengl_dynamic_resolution";
         static constexpr const char *const OPENGL_FILTERING = "melonds_opengl_filtering";
+        static constexpr const char *const OPENGL_FRAMES_IN_FLIGHT = "melonds_opengl_frames_in_flight";
+        static constexpr const char *const OPENGL_MIN_RESOLUTION = "melonds_opengl_min_resolution";
         static constexpr const char *const OPENGL_RESOLUTION = "melonds_opengl_resolution";
+        static constexpr const char *const OPENGL_STATE_ISOLATION = "melonds_opengl_state_isolation";
+        static constexpr const char *const PARALLEL_COMPOSITION = "melonds_parallel_composition";
+        static constexpr const char *const PIPELINED_COMPOSITION = "melonds_pipelined_composition";
         static constexpr const char *const RENDER_MODE = "melonds_render_mode";
+        static constexpr const char *const RGB565_OUTPUT = "melonds_rgb565_output";
+        static constexpr const char *const PARALLEL_COMPOSITION_THREADS = "melonds_parallel_composition_threads";
         static constexpr const char *const THREADED_RENDERER = "melonds_threaded_renderer";
     }
 
@@ -203,12 +244,15 @@ namespace MelonDsDs::config {
         static constexpr const char *const ABSOLUTE_TIME = "absolute";
         static constexpr const char *const ALWAYS = "always";
         static constexpr const char *const AUTO = "auto";
+        static constexpr const char *const BALANCED = "balanced";
+        static constexpr const char *const BEST = "best";
         static constexpr const char *const BLOW = "blow";
         static constexpr const char *const BOTTOM_TOP = "bottom-top";
         static constexpr const char *const BOTH = "both";
         static constexpr const char *const BOTTOM = "bottom";
         static constexpr const char *const BUILT_IN = "builtin";
         static constexpr const char *const BUTTONS = "buttons";
+        static constexpr const char *const CORE = "core";
         static constexpr const char *const COSINE = "cosine";
         static constexpr const char *const CUBIC = "cubic";
         static constexpr const char *const DEDICATED = "dedicated";
@@ -217,21 +261,26 @@ namespace MelonDsDs::config {
         static constexpr const char *const DISABLED = "disabled";
         static constexpr const char *const DS = "ds";
         static constexpr const char *const DSI = "dsi";
+        static constexpr const char *const EFFICIENCY = "efficiency";
         static constexpr const char *const ENABLED = "enabled";
         static constexpr const char *const ENGLISH = "en";
         static constexpr const char *const EXISTING = "existing";
         static constexpr const char *const EXPANSION_PAK = "expansion-pak";
+        static constexpr const char *const FAST = "fast";
+        static constexpr const char *const FAST_FORWARD = "fast-forward";
         static constexpr const char *const FIRMWARE = "firmware";
         static constexpr const char *const FLIPPED_HYBRID_BOTTOM = "flipped-hybrid-bottom";
         static constexpr const char *const FLIPPED_HYBRID_TOP = "flipped-hybrid-top";
         static constexpr const char *const FLIPPED_LARGESCREEN_BOTTOM = "flipped-largescreen-bottom";
         static constexpr const char *const FLIPPED_LARGESCREEN_TOP = "flipped-largescreen-top";
         static constexpr const char *const FRENCH = "fr";
+        static constexpr const char *const FRONTEND = "frontend";
         static constexpr const char *const GAUSSIAN = "gaussian";
         static constexpr const char *const GERMAN = "de";
         static constexpr const char *const HOLD = "hold";
         static constexpr const char *const HYBRID_BOTTOM = "hybrid-bottom";
         static constexpr const char *const HYBRID_TOP = "hybrid-top";
+        static constexpr const char *const IDLE = "idle";
         static constexpr const char *const INDIRECT = "indirect";
         static constexpr const char *const ITALIAN = "it";
         static constexpr const char *const JAPANESE = "ja";
@@ -242,12 +291,14 @@ namespace MelonDsDs::config {
         static constexpr const char *const LINEAR = "linear";
         static constexpr const char *const NATIVE = "native";
         static constexpr const char *const NEAREST = "nearest";
+        static constexpr const char *const NETPLAY = "netplay";
         static constexpr const char *const MICROPHONE = "microphone";
         static constexpr const char *const MOUSE = "mouse";
         static constexpr const char *const NOISE = "noise";
         static constexpr const char *const NOT_FOUND = "/notfound";
         static constexpr const char *const ONE = "one";
         static constexpr const char *const OPENGL = "opengl";
+        static constexpr const char *const PERFORMANCE = "performance";
         static constexpr const char *const REAL = "real";
         static constexpr const char *const RELATIVE_TIME = "relative";
         static constexpr const char *const RIGHT_LEFT = "right-left";
@@ -256,6 +307,7 @@ namespace MelonDsDs::config {
         static constexpr const char *const RUMBLE_PAK = "rumble-pak";
         static constexpr const char *const SENSOR = "sensor";
         static constexpr const char *const SHARED = "shared";
+        static constexpr const char *const SHARED_MEMORY = "shared-memory";
         static constexpr const char *const SILENCE = "silence";
         static constexpr const char *const SOFTWARE = "software";
         static constexpr const char *const SPANISH = "es";
@@ -39,18 +39,32 @@ namespace MelonDsDs::config::definitions {
         MicInputButton,
         BitDepth,
         AudioInterpolation,
+        AudioRateControl,
+        AudioCallback,
+        AudioOutputRate,
+        AudioResamplerQuality,
 
 #ifdef JIT_ENABLED
         JitEnabled,
         JitBlockSize,
+        JitAutoTune,
         JitBranchOptimizations,
         JitLiteralOptimizations,
 #   ifdef HAVE_JIT_FASTMEM
         JitFastMemory,
 #   endif
+#endif
+#ifdef HAVE_THREAD_PLACEMENT
+        EmulationThreadPlacement,
+        RenderThreadPlacement,
 #endif
 
         LanMacAddressMode,
+        MpPacketBatching,
+        MpReceiveTimeout,
+#ifdef HAVE_MP_SHARED_MEMORY
+        MpTransport,
+#endif
 #ifdef HAVE_NETWORKING
         NetworkMode,
 #   ifdef HAVE_NETWORKING_DIRECT_MODE
@@ -78,6 +92,7 @@ namespace MelonDsDs::config::definitions {
         HybridSmallScreen,
         HybridScreenFiltering,
         ScreenGap,
+        ScreenRotation,
 
         DnsOverride,
         Language,
@@ -97,6 +112,12 @@ namespace MelonDsDs::config::definitions {
         DsiFirmwarePath,
         NandPath,
         BootMode,
+        NdsSaveDirect,
+        SaveJournal,
+        DsiwareKeepInstalled,
+#ifdef HAVE_NETWORKING
+        DsiwareTmdPrefetch,
+#endif
         DsiSdCardSaveMode,
         DsiSdCardReadOnly,
         DsiSdCardSyncToHost,
@@ -105,6 +126,17 @@ namespace MelonDsDs::config::definitions {
         HomebrewSdCardSyncToHost,
         BatteryUpdateInterval,
         NdsPowerOkThreshold,
+        BatterySaver,
+        LowMemoryMode,
+        ShareFileMappings,
+        FileReadAhead,
+        LidPowerSaving,
+        Deterministic,
+        RunAhead,
+#ifdef HAVE_ZLIB
+        RewindBufferSize,
+        RewindInterval,
+#endif
 
         StartTimeMode,
         RelativeYearOffset,
@@ -120,11 +152,25 @@ namespace MelonDsDs::config::definitions {
 #if defined(HAVE_OPENGL) || defined(HAVE_OPENGLES)
         RenderMode,
         OpenGlScaleFactor,
+        OpenGlDynamicResolution,
+        OpenGlMinScaleFactor,
         OpenGlBetterPolygons,
+        OpenGlFramesInFlight,
+        OpenGlStateIsolation,
+#endif
+#if defined(HAVE_OPENGL) || defined(HAVE_OPENGLES) || defined(HAVE_VULKAN)
+        GpuComposition,
 #endif
 #if defined(HAVE_THREADS) && defined(HAVE_THREADED_RENDERER)
         ThreadedSoftwareRenderer,
 #endif
+#ifdef HAVE_THREADS
+        PipelinedComposition,
+        ParallelComposition,
+        ParallelCompositionThreads,
+#endif
+        FrameSkip,
+        Rgb565Output,
 
         ShowUnsupportedFeatures,
         ShowBiosWarnings,
@@ -133,6 +179,12 @@ namespace MelonDsDs::config::definitions {
         ShowCameraState,
         ShowLidState,
         ShowSensorReading,
+        ShowFrameTimings,
+        ShowPerformanceOverlay,
+        ShowMpStats,
+#ifdef HAVE_TRACE_RECORDER
+        SaveTrace,
+#endif
 #ifndef NDEBUG
         ShowPointerCoordinates,
 #endif
@@ -107,11 +107,97 @@ namespace MelonDsDs::config::definitions {
         MelonDsDs::config::values::DISABLED
     };
 
+    constexpr retro_core_option_v2_definition AudioRateControl {
+        config::audio::AUDIO_RATE_CONTROL,
+        "Dynamic Audio Rate Control",
+        "Rate Control",
+        "Slightly adjusts the audio output rate "
+        "to keep the frontend's audio buffer from running dry or overflowing. "
+        "Allows for smaller audio buffers (and less audio latency) without crackling. "
+        "Requires a frontend that reports its audio buffer's status; "
+        "has no effect otherwise. "
+        "If unsure, leave this disabled.",
+        nullptr,
+        config::audio::CATEGORY,
+        {
+            {MelonDsDs::config::values::DISABLED, nullptr},
+            {MelonDsDs::config::values::ENABLED, nullptr},
+            {nullptr, nullptr},
+        },
+        MelonDsDs::config::values::DISABLED
+    };
+
+    constexpr retro_core_option_v2_definition AudioCallback {
+        config::audio::AUDIO_CALLBACK,
+        "Threaded Audio Delivery",
+        "Threaded Delivery",
+        "Hands audio to the frontend's audio thread through a small buffer, "
+        "instead of sending it all at once at the end of each frame. "
+        "Smooths out crackling caused by uneven frame times. "
+        "Requires a frontend that supports audio callbacks; "
+        "has no effect otherwise. "
+        "Changes take effect at next restart. "
+        "If unsure, leave this disabled.",
+        nullptr,
+        config::audio::CATEGORY,
+        {
+            {MelonDsDs::config::values::DISABLED, nullptr},
+            {MelonDsDs::config::values::ENABLED, nullptr},
+            {nullptr, nullptr},
+        },
+        MelonDsDs::config::values::DISABLED
+    };
+
+    constexpr retro_core_option_v2_definition AudioOutputRate {
+        config::audio::AUDIO_OUTPUT_RATE,
+        "Audio Output Rate",
+        "Output Rate",
+        "The sample rate of the audio sent to the frontend. "
+        "Native sends the DS's own rate (about 32.7 kHz) "
+        "and leaves resampling to the frontend. "
+        "Choose your audio device's rate to resample in the core instead, "
+        "which lets the frontend skip its own resampler. "
+        "Changes take effect at next restart. "
+        "If unsure, leave this at Native.",
+        nullptr,
+        config::audio::CATEGORY,
+        {
+            {MelonDsDs::config::values::NATIVE, "Native"},
+            {"44100", "44.1 kHz"},
+            {"48000", "48 kHz"},
+            {nullptr, nullptr},
+        },
+        MelonDsDs::config::values::NATIVE
+    };
+
+    constexpr retro_core_option_v2_definition AudioResamplerQuality {
+        config::audio::AUDIO_RESAMPLER_QUALITY,
+        "Audio Resampler Quality",
+        "Resampler Quality",
+        "How carefully the core resamples audio to the Audio Output Rate. "
+        "Higher quality reduces aliasing but takes more CPU time. "
+        "Ignored if Audio Output Rate is set to Native. "
+        "Changes take effect at next restart.",
+        nullptr,
+        config::audio::CATEGORY,
+        {
+            {MelonDsDs::config::values::FAST, "Fast"},
+            {MelonDsDs::config::values::BALANCED, "Balanced"},
+            {MelonDsDs::config::values::BEST, "Best"},
+            {nullptr, nullptr},
+        },
+        MelonDsDs::config::values::BALANCED
+    };
+
     constexpr std::initializer_list<retro_core_option_v2_definition> AudioOptionDefinitions {
         MicInput,
         MicInputButton,
         BitDepth,
         AudioInterpolation,
+        AudioRateControl,
+        AudioCallback,
+        AudioOutputRate,
+        AudioResamplerQuality,
     };
 }
 #endif //MELONDS_DS_AUDIO_HPP
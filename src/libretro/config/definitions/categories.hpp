@@ -59,7 +59,7 @@ namespace MelonDsDs::config::definitions {
             "Network",
             "Change Nintendo Wi-Fi emulation settings."
         },
-#ifdef JIT_ENABLED
+#if defined(JIT_ENABLED) || defined(HAVE_THREAD_PLACEMENT)
         retro_core_option_v2_category {
             MelonDsDs::config::cpu::CATEGORY,
             "CPU Emulation",
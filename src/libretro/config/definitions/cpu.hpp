@@ -86,6 +86,27 @@ namespace MelonDsDs::config::definitions {
         "32"
     };
 
+    constexpr retro_core_option_v2_definition JitAutoTune {
+        config::cpu::JIT_AUTO_TUNE,
+        "Auto-Tune Block Size",
+        nullptr,
+        "If enabled, the first time a game is played "
+        "it will try a few block sizes for several seconds each "
+        "and keep whichever runs fastest. "
+        "The result is saved in jit_profiles.txt in the system directory, "
+        "which can also be edited by hand to override any JIT option for specific games. "
+        "May cause a few brief stutters while tuning. "
+        "If unsure, leave disabled.",
+        nullptr,
+        MelonDsDs::config::cpu::CATEGORY,
+        {
+            {MelonDsDs::config::values::DISABLED, nullptr},
+            {MelonDsDs::config::values::ENABLED, nullptr},
+            {nullptr, nullptr},
+        },
+        MelonDsDs::config::values::DISABLED
+    };
+
     constexpr retro_core_option_v2_definition JitBranchOptimizations {
         config::cpu::JIT_BRANCH_OPTIMISATIONS,
         "Branch Optimizations",
@@ -147,15 +168,60 @@ namespace MelonDsDs::config::definitions {
 #   endif
 #endif
 
+#ifdef HAVE_THREAD_PLACEMENT
+    constexpr retro_core_option_v2_definition EmulationThreadPlacement {
+        config::cpu::EMULATION_THREAD_PLACEMENT,
+        "Emulation Thread Placement",
+        nullptr,
+        "Which of the CPU's cores the emulated console runs on. "
+        "Only matters on CPUs with both performance and efficiency cores (e.g. big.LITTLE); "
+        "such handhelds may drop frames if the emulator lands on an efficiency core. "
+        "If unsure, leave this set to Any.",
+        nullptr,
+        MelonDsDs::config::cpu::CATEGORY,
+        {
+            {MelonDsDs::config::values::AUTO, "Any"},
+            {MelonDsDs::config::values::PERFORMANCE, "Performance Cores"},
+            {MelonDsDs::config::values::EFFICIENCY, "Efficiency Cores"},
+            {nullptr, nullptr},
+        },
+        MelonDsDs::config::values::AUTO
+    };
+
+    constexpr retro_core_option_v2_definition RenderThreadPlacement {
+        config::cpu::RENDER_THREAD_PLACEMENT,
+        "Render Thread Placement",
+        nullptr,
+        "Which of the CPU's cores the threaded software renderer "
+        "and the screen composition workers run on. "
+        "Only matters on CPUs with both performance and efficiency cores (e.g. big.LITTLE). "
+        "If unsure, leave this set to Any.",
+        nullptr,
+        MelonDsDs::config::cpu::CATEGORY,
+        {
+            {MelonDsDs::config::values::AUTO, "Any"},
+            {MelonDsDs::config::values::PERFORMANCE, "Performance Cores"},
+            {MelonDsDs::config::values::EFFICIENCY, "Efficiency Cores"},
+            {nullptr, nullptr},
+        },
+        MelonDsDs::config::values::AUTO
+    };
+#endif
+
     constexpr std::initializer_list<retro_core_option_v2_definition> CpuOptionDefinitions {
 #ifdef JIT_ENABLED
         JitEnabled,
         JitBlockSize,
+        JitAutoTune,
         JitBranchOptimizations,
         JitLiteralOptimizations,
 #   ifdef HAVE_JIT_FASTMEM
         JitFastMemory,
 #   endif
+#endif
+#ifdef HAVE_THREAD_PLACEMENT
+        EmulationThreadPlacement,
+        RenderThreadPlacement,
 #endif
     };
 }
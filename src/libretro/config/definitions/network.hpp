@@ -91,6 +91,76 @@ namespace MelonDsDs::config::definitions {
         MelonDsDs::config::values::FIRMWARE
     };
 
+    constexpr retro_core_option_v2_definition MpPacketBatching {
+        config::network::MP_PACKET_BATCHING,
+        "Local Multiplayer Packet Batching",
+        "Multiplayer Packet Batching",
+        "Combines the local wireless packets that the emulated console sends in quick succession "
+        "into one network packet, reducing the number of packets and system calls. "
+        "Can lower CPU usage in sessions with several players. "
+        "All players must use a version of melonDS DS that supports this option, "
+        "but they don't all need to enable it. "
+        "If unsure, leave this disabled.",
+        nullptr,
+        config::network::CATEGORY,
+        {
+            {MelonDsDs::config::values::DISABLED, nullptr},
+            {MelonDsDs::config::values::ENABLED, nullptr},
+            {nullptr, nullptr},
+        },
+        MelonDsDs::config::values::DISABLED
+    };
+
+    constexpr retro_core_option_v2_definition MpReceiveTimeout {
+        config::network::MP_RECEIVE_TIMEOUT,
+        "Local Multiplayer Receive Timeout",
+        "Multiplayer Receive Timeout",
+        "How long to wait for another player's local wireless packets before giving up on them. "
+        "Raise this if you play over the internet (e.g. through a netplay relay) "
+        "and the game keeps losing its connection; "
+        "the game will pause for longer when a packet really is lost. "
+        "Lower it on a fast LAN to recover from lost packets sooner. "
+        "All players should use the same setting. "
+        "If unsure, leave this at 25ms.",
+        nullptr,
+        config::network::CATEGORY,
+        {
+            {"10", "10ms"},
+            {"25", "25ms"},
+            {"50", "50ms"},
+            {"100", "100ms"},
+            {"200", "200ms"},
+            {nullptr, nullptr},
+        },
+        "25"
+    };
+
+#ifdef HAVE_MP_SHARED_MEMORY
+    constexpr retro_core_option_v2_definition MpTransport {
+        config::network::MP_TRANSPORT,
+        "Local Multiplayer Transport",
+        "Multiplayer Transport",
+        "Selects how local wireless packets reach other players.\n"
+        "\n"
+        "Netplay: Sends packets through the frontend's netplay session. "
+        "Works across machines.\n"
+        "Shared Memory: Exchanges packets directly with other instances of melonDS DS "
+        "running on this machine, with much lower latency. "
+        "Each instance joins when its game is loaded; doesn't need (or use) netplay.\n"
+        "\n"
+        "Changes take effect at next restart. "
+        "If unsure, use Netplay.",
+        nullptr,
+        config::network::CATEGORY,
+        {
+            {MelonDsDs::config::values::NETPLAY, "Netplay"},
+            {MelonDsDs::config::values::SHARED_MEMORY, "Shared Memory"},
+            {nullptr, nullptr},
+        },
+        MelonDsDs::config::values::NETPLAY
+    };
+#endif
+
     constexpr std::initializer_list<retro_core_option_v2_definition> NetworkOptionDefinitions {
 #ifdef HAVE_NETWORKING
         NetworkMode,
@@ -99,6 +169,11 @@ namespace MelonDsDs::config::definitions {
 #   endif
 #endif
         LanMacAddressMode,
+        MpPacketBatching,
+        MpReceiveTimeout,
+#ifdef HAVE_MP_SHARED_MEMORY
+        MpTransport,
+#endif
     };
 }
 
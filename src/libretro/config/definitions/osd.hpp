@@ -136,6 +136,63 @@ namespace MelonDsDs::config::definitions {
         MelonDsDs::config::values::ENABLED
     };
 
+    constexpr retro_core_option_v2_definition ShowFrameTimings {
+        config::osd::FRAME_TIMINGS,
+        "Show Frame Timings",
+        nullptr,
+        "Enable to show how long each frame takes to emulate and render, "
+        "averaged over the last few seconds. "
+        "Meant for diagnosing performance problems. "
+        "Leave disabled if unsure.",
+        nullptr,
+        config::osd::CATEGORY,
+        {
+            {MelonDsDs::config::values::DISABLED, nullptr},
+            {MelonDsDs::config::values::ENABLED, nullptr},
+            {nullptr, nullptr},
+        },
+        MelonDsDs::config::values::DISABLED
+    };
+
+    constexpr retro_core_option_v2_definition ShowPerformanceOverlay {
+        config::osd::PERFORMANCE_OVERLAY,
+        "Show Performance Overlay",
+        nullptr,
+        "Enable to show a compact summary of the core's performance, "
+        "including the effective frame rate, the time spent emulating and rendering each frame, "
+        "and how full the audio buffer is. "
+        "Refreshed a few times per second so that it stays readable. "
+        "Meant for diagnosing slowdowns. "
+        "Leave disabled if unsure.",
+        nullptr,
+        config::osd::CATEGORY,
+        {
+            {MelonDsDs::config::values::DISABLED, nullptr},
+            {MelonDsDs::config::values::ENABLED, nullptr},
+            {nullptr, nullptr},
+        },
+        MelonDsDs::config::values::DISABLED
+    };
+
+    constexpr retro_core_option_v2_definition ShowMpStats {
+        config::osd::MP_STATS,
+        "Show Local Multiplayer Stats",
+        nullptr,
+        "Enable to show the connection quality of a local wireless session, "
+        "including each player's round-trip time, timeouts, and packets sent per second. "
+        "The same stats are logged when the session ends. "
+        "Meant for diagnosing desyncs and network problems. "
+        "Leave disabled if unsure.",
+        nullptr,
+        config::osd::CATEGORY,
+        {
+            {MelonDsDs::config::values::DISABLED, nullptr},
+            {MelonDsDs::config::values::ENABLED, nullptr},
+            {nullptr, nullptr},
+        },
+        MelonDsDs::config::values::DISABLED
+    };
+
 #ifndef NDEBUG
     constexpr retro_core_option_v2_definition ShowPointerCoordinates {
         config::osd::POINTER_COORDINATES,
@@ -155,6 +212,27 @@ namespace MelonDsDs::config::definitions {
     };
 #endif
 
+#ifdef HAVE_TRACE_RECORDER
+    constexpr retro_core_option_v2_definition SaveTrace {
+        config::osd::SAVE_TRACE,
+        "Save Performance Trace",
+        nullptr,
+        "Select Save Now to write the last few seconds of the core's activity "
+        "to a trace file in the melonDS DS save folder; "
+        "open it with ui.perfetto.dev, or attach it to a bug report about stuttering or slowdown. "
+        "Switches back to Off once the trace is saved. "
+        "A trace is also saved if the core crashes.",
+        nullptr,
+        config::osd::CATEGORY,
+        {
+            {MelonDsDs::config::values::DISABLED, "Off"},
+            {MelonDsDs::config::values::ENABLED, "Save Now"},
+            {nullptr, nullptr},
+        },
+        MelonDsDs::config::values::DISABLED
+    };
+#endif
+
     constexpr std::initializer_list<retro_core_option_v2_definition> OsdOptionDefinitions {
         ShowUnsupportedFeatures,
         ShowBiosWarnings,
@@ -163,6 +241,12 @@ namespace MelonDsDs::config::definitions {
         ShowCameraState,
         ShowLidState,
         ShowSensorReading,
+        ShowFrameTimings,
+        ShowPerformanceOverlay,
+        ShowMpStats,
+#ifdef HAVE_TRACE_RECORDER
+        SaveTrace,
+#endif
 #ifndef NDEBUG
         ShowPointerCoordinates,
 #endif
@@ -220,6 +220,26 @@ namespace MelonDsDs::config::definitions {
         MelonDsDs::config::values::NEAREST
     };
 
+    constexpr retro_core_option_v2_definition ScreenRotation {
+        config::screen::SCREEN_ROTATION,
+        "Screen Rotation Method",
+        nullptr,
+        "How to rotate the screens for the rotated layouts. "
+        "Frontend asks the frontend to do it, which some video drivers do slowly or not at all. "
+        "Core rotates each frame before sending it, so the frontend has nothing to do. "
+        "Auto uses the frontend if it can rotate the screen and the core otherwise. "
+        "If unsure, leave this at Auto.",
+        nullptr,
+        config::screen::CATEGORY,
+        {
+            {MelonDsDs::config::values::AUTO, "Auto"},
+            {MelonDsDs::config::values::FRONTEND, "Frontend"},
+            {MelonDsDs::config::values::CORE, "Core"},
+            {nullptr, nullptr},
+        },
+        MelonDsDs::config::values::AUTO
+    };
+
     constexpr retro_core_option_v2_definition ScreenGap {
         config::screen::SCREEN_GAP,
         "Screen Gap",
@@ -644,6 +664,7 @@ namespace MelonDsDs::config::definitions {
         HybridSmallScreen,
         HybridScreenFiltering,
         ScreenGap,
+        ScreenRotation,
     };
 }
 
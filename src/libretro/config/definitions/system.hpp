@@ -173,6 +173,86 @@ namespace MelonDsDs::config::definitions {
         MelonDsDs::config::values::DIRECT
     };
 
+    constexpr retro_core_option_v2_definition NdsSaveDirect {
+        config::storage::NDS_SAVE_DIRECT,
+        "Write Save Data Directly",
+        nullptr,
+        "If enabled, the core writes DS game save data to the save directory itself, "
+        "touching only the parts that the game changed. "
+        "Useful for games with large save files or that save often. "
+        "If disabled, the frontend rewrites the whole save file whenever it saves. "
+        "Uses the same file as the frontend, so existing save data carries over either way. "
+        "Ignored for homebrew and DSiWare. "
+        "Changes take effect at next boot.",
+        nullptr,
+        config::system::CATEGORY,
+        {
+            {MelonDsDs::config::values::DISABLED, nullptr},
+            {MelonDsDs::config::values::ENABLED, nullptr},
+            {nullptr, nullptr},
+        },
+        MelonDsDs::config::values::DISABLED
+    };
+
+    constexpr retro_core_option_v2_definition SaveJournal {
+        config::storage::SAVE_JOURNAL,
+        "Save Journal",
+        nullptr,
+        "If enabled, every write a game makes to its save data is also appended to a small journal file "
+        "next to the save, and any writes that never made it into the save file "
+        "(e.g. because the frontend crashed) are recovered at next boot. "
+        "Applies to GBA save data and to DS save data written directly by the core. "
+        "Changes take effect at next boot.",
+        nullptr,
+        config::system::CATEGORY,
+        {
+            {MelonDsDs::config::values::DISABLED, nullptr},
+            {MelonDsDs::config::values::ENABLED, nullptr},
+            {nullptr, nullptr},
+        },
+        MelonDsDs::config::values::DISABLED
+    };
+
+    constexpr retro_core_option_v2_definition DsiwareKeepInstalled {
+        config::storage::DSIWARE_KEEP_INSTALLED,
+        "Keep DSiWare Installed",
+        nullptr,
+        "If enabled, DSiWare games stay installed on the DSi NAND image after they're closed, "
+        "so later sessions skip installing them again. "
+        "Their save data is still exported at the end of each session, "
+        "but while a game is installed, its save data on the NAND is used instead of the exported copy. "
+        "If disabled, DSiWare games are installed when loaded and removed when closed. "
+        "Changes take effect at next boot.",
+        nullptr,
+        config::system::CATEGORY,
+        {
+            {MelonDsDs::config::values::DISABLED, nullptr},
+            {MelonDsDs::config::values::ENABLED, nullptr},
+            {nullptr, nullptr},
+        },
+        MelonDsDs::config::values::DISABLED
+    };
+
+#ifdef HAVE_NETWORKING
+    constexpr retro_core_option_v2_definition DsiwareTmdPrefetch {
+        config::storage::DSIWARE_TMD_PREFETCH,
+        "Prefetch DSiWare Metadata",
+        nullptr,
+        "If enabled, the title metadata needed to install each DSiWare game "
+        "in the same folder as the loaded game is downloaded in the background, "
+        "so that loading those games later doesn't have to wait for the network. "
+        "Changes take effect at next boot.",
+        nullptr,
+        config::system::CATEGORY,
+        {
+            {MelonDsDs::config::values::DISABLED, nullptr},
+            {MelonDsDs::config::values::ENABLED, nullptr},
+            {nullptr, nullptr},
+        },
+        MelonDsDs::config::values::DISABLED
+    };
+#endif
+
     constexpr retro_core_option_v2_definition DsiSdCardSaveMode {
         config::storage::DSI_SD_SAVE_MODE,
         "Virtual SD Card (DSi)",
@@ -332,6 +412,30 @@ namespace MelonDsDs::config::definitions {
         "20"
     };
 
+    constexpr retro_core_option_v2_definition BatterySaver {
+        config::system::BATTERY_SAVER,
+        "Battery Saver Threshold",
+        nullptr,
+        "If the host is running on battery below this percentage, "
+        "the core halves the OpenGL resolution, stops capturing the host microphone, "
+        "uses linear audio interpolation at most, and turns on automatic frameskip. "
+        "Your settings come back once the device is charging or above the threshold again. "
+        "Checked as often as the Battery Update Interval. "
+        "Ignored if the frontend can't query the power status.",
+        nullptr,
+        config::system::CATEGORY,
+        {
+            {MelonDsDs::config::values::DISABLED, nullptr},
+            {"10", "10%"},
+            {"20", "20%"},
+            {"30", "30%"},
+            {"50", "50%"},
+            {"100", "Always on Battery"},
+            {nullptr, nullptr},
+        },
+        MelonDsDs::config::values::DISABLED
+    };
+
     constexpr retro_core_option_v2_definition Slot2Device {
         config::system::SLOT2_DEVICE,
         "Slot-2 Device",
@@ -384,6 +488,193 @@ namespace MelonDsDs::config::definitions {
         values::ENABLED
     };
 
+    constexpr retro_core_option_v2_definition LowMemoryMode {
+        config::system::LOW_MEMORY_MODE,
+        "Low-Memory Mode",
+        nullptr,
+        "If enabled, the core trades some speed for a smaller memory footprint, "
+        "which helps devices with 1GB of memory or less run DSi games. "
+        "The core frees its copy of the loaded game once the emulated cart has its own, "
+        "releases screen buffers that the current layout doesn't need, "
+        "and reads the DSi NAND and SD card images from disk instead of mapping them into memory. "
+        "Auto enables this on devices with about 1.5GB of memory or less. "
+        "Changes take effect at next restart.",
+        nullptr,
+        config::system::CATEGORY,
+        {
+            {values::AUTO, "Auto"},
+            {values::DISABLED, nullptr},
+            {values::ENABLED, nullptr},
+            {nullptr, nullptr},
+        },
+        values::AUTO
+    };
+
+    constexpr retro_core_option_v2_definition ShareFileMappings {
+        config::system::SHARE_FILE_MAPPINGS,
+        "Share Loaded Files",
+        nullptr,
+        "If enabled, the core reads the loaded game, BIOS, and firmware straight from their files "
+        "instead of keeping its own copies, "
+        "so that other running instances of the core can share them in memory. "
+        "Don't edit, replace, or delete these files while the game is running; "
+        "if one of them shrinks in the meantime, the core will crash. "
+        "Disable this if they're on storage that other programs write to. "
+        "Changes take effect at next load.",
+        nullptr,
+        config::system::CATEGORY,
+        {
+            {values::DISABLED, nullptr},
+            {values::ENABLED, nullptr},
+            {nullptr, nullptr},
+        },
+        values::ENABLED
+    };
+
+    constexpr retro_core_option_v2_definition FileReadAhead {
+        config::system::FILE_READ_AHEAD,
+        "File Read-Ahead",
+        nullptr,
+        "When the core reads a ROM, firmware, or other read-only file from start to finish, "
+        "it fetches this much of the file at a time and reads the next chunk in the background. "
+        "Larger values help on SD cards and network storage, where every read is slow. "
+        "The DSi NAND and SD card images aren't affected. "
+        "Changes take effect at next restart.",
+        nullptr,
+        config::system::CATEGORY,
+        {
+            {MelonDsDs::config::values::DISABLED, nullptr},
+            {"64", "64KB"},
+            {"128", "128KB"},
+            {"256", "256KB"},
+            {"512", "512KB"},
+            {"1024", "1MB"},
+            {"4096", "4MB"},
+            {nullptr, nullptr},
+        },
+        "256"
+    };
+
+    constexpr retro_core_option_v2_definition LidPowerSaving {
+        config::system::LID_POWER_SAVING,
+        "Power Saving While Lid Closed",
+        nullptr,
+        "Controls what the core does while the emulated lid is closed (or the game is in sleep mode). "
+        "Enabled repeats the last (blank) frame instead of drawing new ones. "
+        "Idle also sleeps through the rest of each frame, "
+        "which saves battery on handhelds but may upset frontends that rely on busy frames for timing. "
+        "Idle has no effect while fast-forwarding or during local multiplayer.",
+        nullptr,
+        config::system::CATEGORY,
+        {
+            {values::DISABLED, nullptr},
+            {values::ENABLED, nullptr},
+            {values::IDLE, "Idle"},
+            {nullptr, nullptr},
+        },
+        values::ENABLED
+    };
+
+    constexpr retro_core_option_v2_definition Deterministic {
+        config::system::DETERMINISTIC,
+        "Deterministic Emulation",
+        nullptr,
+        "If enabled, the emulated console only depends on the game, the core options, and the player's input, "
+        "so that netplay sessions rarely fall out of sync. "
+        "The clock starts at the date and time given in the Time options (and never follows the host's), "
+        "the host microphone is replaced with a blowing sound, "
+        "host light sensors and battery readings are ignored, "
+        "and the JIT recompiler is disabled. "
+        "Every player needs the same core options. "
+        "Changes take effect at next restart.",
+        nullptr,
+        config::system::CATEGORY,
+        {
+            {values::DISABLED, nullptr},
+            {values::ENABLED, nullptr},
+            {nullptr, nullptr},
+        },
+        values::DISABLED
+    };
+
+    constexpr retro_core_option_v2_definition RunAhead {
+        config::system::RUN_AHEAD,
+        "Run-Ahead Frames",
+        nullptr,
+        "Hides this many frames of input lag by emulating ahead of what's shown, "
+        "then rolling back to the real frame. "
+        "Unlike the frontend's run-ahead, the hidden frames skip drawing the screens, "
+        "audio, the microphone, and the core's background tasks, "
+        "so each one costs little more than emulating it. "
+        "Use the fewest frames that hide the game's own lag; "
+        "don't combine this with the frontend's run-ahead. "
+        "Ignored in DSi mode, during local multiplayer, and while recording or replaying input.",
+        nullptr,
+        config::system::CATEGORY,
+        {
+            {MelonDsDs::config::values::DISABLED, nullptr},
+            {"1", "1 frame"},
+            {"2", "2 frames"},
+            {"3", "3 frames"},
+            {"4", "4 frames"},
+            {nullptr, nullptr},
+        },
+        MelonDsDs::config::values::DISABLED
+    };
+
+#ifdef HAVE_ZLIB
+    constexpr retro_core_option_v2_definition RewindBufferSize {
+        config::system::REWIND_BUFFER_SIZE,
+        "Rewind Buffer Size",
+        nullptr,
+        "If enabled, the core keeps its own history of recent states, "
+        "which you can step back through by holding L2+X. "
+        "Snapshots are compressed in the background, "
+        "so this is much cheaper than the frontend's rewind on slower devices. "
+        "This is how much memory the compressed history may use; "
+        "the core also needs two uncompressed savestates' worth on top of this. "
+        "Ignored in DSi mode, during local multiplayer, "
+        "while recording or replaying input, and with deterministic emulation.",
+        nullptr,
+        config::system::CATEGORY,
+        {
+            {MelonDsDs::config::values::DISABLED, nullptr},
+            {"16", "16MB"},
+            {"32", "32MB"},
+            {"64", "64MB"},
+            {"128", "128MB"},
+            {"256", "256MB"},
+            {"512", "512MB"},
+            {nullptr, nullptr},
+        },
+        MelonDsDs::config::values::DISABLED
+    };
+
+    constexpr retro_core_option_v2_definition RewindInterval {
+        config::system::REWIND_INTERVAL,
+        "Rewind Interval",
+        nullptr,
+        "How often the core saves a snapshot for rewinding, "
+        "and how far back each step goes. "
+        "Lower values rewind more smoothly, but cost more time and fill the rewind buffer sooner. "
+        "Ignored if Rewind Buffer Size is disabled.",
+        nullptr,
+        config::system::CATEGORY,
+        {
+            {"1", "1 frame"},
+            {"2", "2 frames"},
+            {"3", "3 frames"},
+            {"5", "5 frames"},
+            {"10", "10 frames"},
+            {"15", "15 frames"},
+            {"30", "30 frames"},
+            {"60", "60 frames"},
+            {nullptr, nullptr},
+        },
+        "5"
+    };
+#endif
+
     constexpr std::initializer_list<retro_core_option_v2_definition> SystemOptionDefinitions {
         ConsoleMode,
         SysfileMode,
@@ -391,6 +682,12 @@ namespace MelonDsDs::config::definitions {
         DsiFirmwarePath,
         NandPath,
         BootMode,
+        NdsSaveDirect,
+        SaveJournal,
+        DsiwareKeepInstalled,
+#ifdef HAVE_NETWORKING
+        DsiwareTmdPrefetch,
+#endif
         DsiSdCardSaveMode,
         DsiSdCardReadOnly,
         DsiSdCardSyncToHost,
@@ -400,6 +697,17 @@ namespace MelonDsDs::config::definitions {
         HomebrewSdCardSyncToHost,
         BatteryUpdateInterval,
         NdsPowerOkThreshold,
+        BatterySaver,
+        LowMemoryMode,
+        ShareFileMappings,
+        FileReadAhead,
+        LidPowerSaving,
+        Deterministic,
+        RunAhead,
+#ifdef HAVE_ZLIB
+        RewindBufferSize,
+        RewindInterval,
+#endif
     };
 }
 
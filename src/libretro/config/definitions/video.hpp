@@ -68,6 +68,49 @@ namespace MelonDsDs::config::definitions {
         "1"
     };
 
+    constexpr retro_core_option_v2_definition OpenGlDynamicResolution {
+        config::video::OPENGL_DYNAMIC_RESOLUTION,
+        "Dynamic Internal Resolution",
+        nullptr,
+        "If enabled, the internal resolution is lowered during demanding 3D scenes "
+        "and raised again when there's room, "
+        "based on how long the GPU takes to render each frame. "
+        "Stays between the Minimum Internal Resolution and the Internal Resolution. "
+        "Requires GPU timer support; "
+        "OpenGL renderer only.",
+        nullptr,
+        config::video::CATEGORY,
+        {
+            {MelonDsDs::config::values::DISABLED, nullptr},
+            {MelonDsDs::config::values::ENABLED, nullptr},
+            {nullptr, nullptr},
+        },
+        MelonDsDs::config::values::DISABLED
+    };
+
+    constexpr retro_core_option_v2_definition OpenGlMinScaleFactor {
+        config::video::OPENGL_MIN_RESOLUTION,
+        "Minimum Internal Resolution",
+        nullptr,
+        "The lowest internal resolution that Dynamic Internal Resolution may use. "
+        "Has no effect if it's higher than the Internal Resolution. "
+        "OpenGL renderer only.",
+        nullptr,
+        config::video::CATEGORY,
+        {
+            {"1", "1x native (256 x 192)"},
+            {"2", "2x native (512 x 384)"},
+            {"3", "3x native (768 x 576)"},
+            {"4", "4x native (1024 x 768)"},
+            {"5", "5x native (1280 x 960)"},
+            {"6", "6x native (1536 x 1152)"},
+            {"7", "7x native (1792 x 1344)"},
+            {"8", "8x native (2048 x 1536)"},
+            {nullptr, nullptr},
+        },
+        "1"
+    };
+
     constexpr retro_core_option_v2_definition OpenGlBetterPolygons {
         config::video::OPENGL_BETTER_POLYGONS,
         "Improved Polygon Splitting",
@@ -83,6 +126,75 @@ namespace MelonDsDs::config::definitions {
         },
         MelonDsDs::config::values::ENABLED
     };
+
+    constexpr retro_core_option_v2_definition OpenGlFramesInFlight {
+        config::video::OPENGL_FRAMES_IN_FLIGHT,
+        "Maximum Frames in Flight",
+        nullptr,
+        "How many frames the CPU may submit before waiting for the GPU to catch up. "
+        "Lower values reduce input latency, "
+        "while higher values can improve performance on slower GPUs. "
+        "OpenGL only. "
+        "Changes take effect immediately. "
+        "If unsure, leave this at 2.",
+        nullptr,
+        config::video::CATEGORY,
+        {
+            {"1", "1 (lowest latency)"},
+            {"2", nullptr},
+            {"3", "3 (highest throughput)"},
+            {nullptr, nullptr},
+        },
+        "2"
+    };
+
+    constexpr retro_core_option_v2_definition OpenGlStateIsolation {
+        config::video::OPENGL_STATE_ISOLATION,
+        "OpenGL State Isolation",
+        nullptr,
+        "If enabled, the core won't save and restore the frontend's OpenGL state around every frame, "
+        "which reduces the CPU cost of presenting each frame (especially on mobile GPUs). "
+        "Only safe if the frontend doesn't touch the core's OpenGL state between frames. "
+        "Auto skips this work if the frontend gives the core a shared context, "
+        "and does it anyway otherwise. "
+        "Disable this if you see graphical glitches in the frontend's menus or overlays. "
+        "OpenGL only. "
+        "Changes take effect at next restart. "
+        "If unsure, leave this at Auto.",
+        nullptr,
+        config::video::CATEGORY,
+        {
+            {MelonDsDs::config::values::AUTO, "Auto"},
+            {MelonDsDs::config::values::ENABLED, nullptr},
+            {MelonDsDs::config::values::DISABLED, nullptr},
+            {nullptr, nullptr},
+        },
+        MelonDsDs::config::values::AUTO
+    };
+#endif
+#if defined(HAVE_OPENGL) || defined(HAVE_OPENGLES) || defined(HAVE_VULKAN)
+    constexpr retro_core_option_v2_definition GpuComposition {
+        config::video::GPU_COMPOSITION,
+        "GPU Screen Composition",
+        nullptr,
+        "If enabled, the software renderer's screens are combined into the final image "
+        "with OpenGL or Vulkan instead of on the CPU "
+        "(whichever the frontend's video driver uses). "
+        "Frees up the CPU for emulation, especially with a high hybrid ratio, "
+        "but requires OpenGL or Vulkan support. "
+        "Software renderer only. "
+        "Changes take effect immediately "
+        "but may require the frontend's video driver to be restarted. "
+        "If unsure, leave this disabled.",
+        nullptr,
+        config::video::CATEGORY,
+        {
+            {MelonDsDs::config::values::DISABLED, nullptr},
+            {MelonDsDs::config::values::ENABLED, nullptr},
+            {nullptr, nullptr},
+        },
+        MelonDsDs::config::values::DISABLED
+    };
 #endif
 #if defined(HAVE_THREADS) && defined(HAVE_THREADED_RENDERER)
     constexpr retro_core_option_v2_definition ThreadedSoftwareRenderer {
@@ -102,16 +214,141 @@ namespace MelonDsDs::config::definitions {
         MelonDsDs::config::values::ENABLED
     };
 #endif
+#ifdef HAVE_THREADS
+    constexpr retro_core_option_v2_definition PipelinedComposition {
+        config::video::PIPELINED_COMPOSITION,
+        "Pipelined Screen Composition",
+        nullptr,
+        "If enabled, the emulated screens are combined into the final image "
+        "on a separate thread while the next frame is emulated. "
+        "Can improve performance on slower devices, "
+        "but adds one frame of input latency. "
+        "Software renderer only. "
+        "Changes take effect immediately. "
+        "If unsure, leave this disabled.",
+        nullptr,
+        config::video::CATEGORY,
+        {
+            {MelonDsDs::config::values::DISABLED, nullptr},
+            {MelonDsDs::config::values::ENABLED, nullptr},
+            {nullptr, nullptr},
+        },
+        MelonDsDs::config::values::DISABLED
+    };
+
+    constexpr retro_core_option_v2_definition ParallelComposition {
+        config::video::PARALLEL_COMPOSITION,
+        "Parallel Screen Composition",
+        nullptr,
+        "If enabled, hybrid and large-screen layouts are drawn "
+        "using several threads at once. "
+        "Can improve performance on multi-core devices "
+        "when using a high hybrid ratio. "
+        "Software renderer only. "
+        "Changes take effect immediately. "
+        "If unsure, leave this disabled.",
+        nullptr,
+        config::video::CATEGORY,
+        {
+            {MelonDsDs::config::values::DISABLED, nullptr},
+            {MelonDsDs::config::values::ENABLED, nullptr},
+            {nullptr, nullptr},
+        },
+        MelonDsDs::config::values::DISABLED
+    };
+
+    constexpr retro_core_option_v2_definition ParallelCompositionThreads {
+        config::video::PARALLEL_COMPOSITION_THREADS,
+        "Parallel Composition Threads",
+        nullptr,
+        "How many threads Parallel Screen Composition splits each frame across, "
+        "counting the one that's already drawing it. "
+        "Higher values can help at high hybrid ratios on many-core devices. "
+        "Automatic uses up to 4, depending on the device's cores. "
+        "Does nothing unless Parallel Screen Composition is enabled. "
+        "Changes take effect immediately. "
+        "If unsure, leave this set to Automatic.",
+        nullptr,
+        config::video::CATEGORY,
+        {
+            {MelonDsDs::config::values::AUTO, "Automatic"},
+            {"2", nullptr},
+            {"3", nullptr},
+            {"4", nullptr},
+            {"6", nullptr},
+            {"8", nullptr},
+            {nullptr, nullptr},
+        },
+        MelonDsDs::config::values::AUTO
+    };
+#endif
+
+    constexpr retro_core_option_v2_definition FrameSkip {
+        config::video::FRAMESKIP,
+        "Frameskip",
+        nullptr,
+        "Skips showing some frames so that emulation itself can keep up. "
+        "Skipped frames are still emulated (and heard), just not drawn. "
+        "Fast-Forward only skips while the frontend is fast-forwarding. "
+        "Auto also skips whenever the core falls behind real time, "
+        "which trades smoothness for speed on slow devices. "
+        "The core never skips more than a few frames in a row. "
+        "If unsure, leave this disabled.",
+        nullptr,
+        config::video::CATEGORY,
+        {
+            {MelonDsDs::config::values::DISABLED, nullptr},
+            {MelonDsDs::config::values::FAST_FORWARD, "Fast-Forward"},
+            {MelonDsDs::config::values::AUTO, "Auto"},
+            {nullptr, nullptr},
+        },
+        MelonDsDs::config::values::DISABLED
+    };
+
+    constexpr retro_core_option_v2_definition Rgb565Output {
+        config::video::RGB565_OUTPUT,
+        "16-bit Color Output",
+        nullptr,
+        "If enabled, frames are sent to the frontend in 16-bit color instead of 32-bit. "
+        "The DS only has 18-bit color, so the difference is hard to see, "
+        "but this halves the memory bandwidth needed to show each frame. "
+        "Can improve performance on devices with slow GPU uploads. "
+        "Has no effect on the OpenGL renderer. "
+        "Changes take effect at next restart. "
+        "If unsure, leave this disabled.",
+        nullptr,
+        config::video::CATEGORY,
+        {
+            {MelonDsDs::config::values::DISABLED, nullptr},
+            {MelonDsDs::config::values::ENABLED, nullptr},
+            {nullptr, nullptr},
+        },
+        MelonDsDs::config::values::DISABLED
+    };
 
     constexpr std::initializer_list<retro_core_option_v2_definition> VideoOptionDefinitions {
 #if defined(HAVE_OPENGL) || defined(HAVE_OPENGLES)
         RenderMode,
         OpenGlScaleFactor,
+        OpenGlDynamicResolution,
+        OpenGlMinScaleFactor,
         OpenGlBetterPolygons,
+        OpenGlFramesInFlight,
+        OpenGlStateIsolation,
+#endif
+#if defined(HAVE_OPENGL) || defined(HAVE_OPENGLES) || defined(HAVE_VULKAN)
+        GpuComposition,
 #endif
 #if defined(HAVE_THREADS) && defined(HAVE_THREADED_RENDERER)
         ThreadedSoftwareRenderer,
 #endif
+#ifdef HAVE_THREADS
+        PipelinedComposition,
+        ParallelComposition,
+        ParallelCompositionThreads,
+#endif
+        FrameSkip,
+        Rgb565Output,
     };
 }
 
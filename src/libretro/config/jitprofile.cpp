@@ -0,0 +1,193 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "jitprofile.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <iterator>
+#include <vector>
+
+#include <fmt/format.h>
+#include <compat/strl.h>
+#include <file/file_path.h>
+#include <retro_miscellaneous.h>
+#include <streams/file_stream.h>
+
+#include "config/constants.hpp"
+#include "config/parse.hpp"
+#include "environment.hpp"
+#include "tracy.hpp"
+
+using std::nullopt;
+using std::optional;
+using std::string;
+using std::string_view;
+
+// One game per line: a game code followed by "option=value" pairs that use the core options' own keys and values,
+// e.g. "AMCE melonds_jit_block_size=8 melonds_jit_branch_optimisations=disabled".
+// Lines that start with '#' are comments.
+constexpr string_view JIT_PROFILE_STORE_NAME = "jit_profiles.txt";
+constexpr string_view TUNED_KEY = "tuned";
+
+optional<string> MelonDsDs::GetGameKey(string_view gameCode) noexcept {
+    if (gameCode.size() != 4) {
+        return nullopt;
+    }
+
+    if (!std::all_of(gameCode.begin(), gameCode.end(), [](char c) { return std::isalnum(static_cast<unsigned char>(c)); })) {
+        // Homebrew usually uses "####" or leaves the game code blank,
+        // so there's no telling one homebrew program from another
+        return nullopt;
+    }
+
+    return string(gameCode);
+}
+
+static void ParseJitProfileField(MelonDsDs::JitProfile& profile, string_view name, string_view value) noexcept {
+    using namespace MelonDsDs;
+    using namespace MelonDsDs::config;
+
+    if (name == cpu::JIT_BLOCK_SIZE) {
+        profile.MaxBlockSize = ParseIntegerInRange<unsigned>(value, 1, 32);
+    }
+    else if (name == cpu::JIT_BRANCH_OPTIMISATIONS) {
+        profile.BranchOptimizations = ParseBoolean(value);
+    }
+    else if (name == cpu::JIT_LITERAL_OPTIMISATIONS) {
+        profile.LiteralOptimizations = ParseBoolean(value);
+    }
+    else if (name == cpu::JIT_FAST_MEMORY) {
+        profile.FastMemory = ParseBoolean(value);
+    }
+    else if (name == TUNED_KEY) {
+        profile.Tuned = ParseBoolean(value).value_or(false);
+    }
+    else {
+        retro::warn("Ignoring unknown JIT profile field \"{}\"", name);
+    }
+}
+
+// Returns the lines that aren't for the given key, and the profile for the line that is (if any)
+static std::pair<std::vector<string>, optional<MelonDsDs::JitProfile>> ReadJitProfileStore(const string& path, string_view key) noexcept {
+    void* buffer = nullptr;
+    int64_t length = 0;
+    if (!filestream_read_file(path.c_str(), &buffer, &length) || !buffer) {
+        return {{}, nullopt};
+    }
+
+    std::vector<string> others;
+    optional<MelonDsDs::JitProfile> profile;
+    string_view contents(static_cast<const char*>(buffer), length);
+    while (!contents.empty()) {
+        size_t end = contents.find('\n');
+        string_view line = contents.substr(0, end);
+        contents = end == string_view::npos ? string_view() : contents.substr(end + 1);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+
+        size_t space = line.find(' ');
+        if (line.empty() || line.front() == '#' || line.substr(0, space) != key) {
+            // Keep comments and other games' profiles as-is
+            others.emplace_back(line);
+            continue;
+        }
+
+        profile.emplace();
+        string_view fields = space == string_view::npos ? string_view() : line.substr(space + 1);
+        while (!fields.empty()) {
+            size_t fieldEnd = fields.find(' ');
+            string_view field = fields.substr(0, fieldEnd);
+            fields = fieldEnd == string_view::npos ? string_view() : fields.substr(fieldEnd + 1);
+            if (field.empty()) {
+                continue;
+            }
+
+            size_t equals = field.find('=');
+            if (equals == string_view::npos) {
+                retro::warn("Ignoring malformed JIT profile field \"{}\" for {}", field, key);
+                continue;
+            }
+
+            ParseJitProfileField(*profile, field.substr(0, equals), field.substr(equals + 1));
+        }
+    }
+
+    free(buffer);
+    return {std::move(others), profile};
+}
+
+optional<MelonDsDs::JitProfile> MelonDsDs::LoadJitProfile(string_view key) noexcept {
+    ZoneScopedN(TracyFunction);
+    optional<string> path = retro::get_system_subdir_path(JIT_PROFILE_STORE_NAME);
+    if (!path) {
+        return nullopt;
+    }
+
+    return ReadJitProfileStore(*path, key).second;
+}
+
+void MelonDsDs::SaveJitProfile(string_view key, const JitProfile& profile) noexcept {
+    ZoneScopedN(TracyFunction);
+    using namespace MelonDsDs::config;
+    optional<string> path = retro::get_system_subdir_path(JIT_PROFILE_STORE_NAME);
+    if (!path) {
+        retro::warn("Failed to get the path of the JIT profile store");
+        return;
+    }
+
+    fmt::memory_buffer contents;
+    auto inserter = std::back_inserter(contents);
+    for (const string& line : ReadJitProfileStore(*path, key).first) {
+        fmt::format_to(inserter, "{}\n", line);
+    }
+
+    fmt::format_to(inserter, "{}", key);
+    if (profile.MaxBlockSize) {
+        fmt::format_to(inserter, " {}={}", cpu::JIT_BLOCK_SIZE, *profile.MaxBlockSize);
+    }
+    if (profile.BranchOptimizations) {
+        fmt::format_to(inserter, " {}={}", cpu::JIT_BRANCH_OPTIMISATIONS, *profile.BranchOptimizations ? values::ENABLED : values::DISABLED);
+    }
+    if (profile.LiteralOptimizations) {
+        fmt::format_to(inserter, " {}={}", cpu::JIT_LITERAL_OPTIMISATIONS, *profile.LiteralOptimizations ? values::ENABLED : values::DISABLED);
+    }
+    if (profile.FastMemory) {
+        fmt::format_to(inserter, " {}={}", cpu::JIT_FAST_MEMORY, *profile.FastMemory ? values::ENABLED : values::DISABLED);
+    }
+    if (profile.Tuned) {
+        fmt::format_to(inserter, " {}={}", TUNED_KEY, values::ENABLED);
+    }
+    fmt::format_to(inserter, "\n");
+
+    char dir[PATH_MAX_LENGTH];
+    strlcpy(dir, path->c_str(), sizeof(dir));
+    path_basedir(dir);
+    if (!path_mkdir(dir)) {
+        retro::warn("Failed to create directory \"{}\" for the JIT profile store", dir);
+        return;
+    }
+
+    if (filestream_write_file(path->c_str(), contents.data(), contents.size())) {
+        retro::debug("Saved the JIT profile for {}", key);
+    }
+    else {
+        retro::warn("Failed to write the JIT profile store to \"{}\"", *path);
+    }
+}
@@ -0,0 +1,49 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#ifndef MELONDSDS_CONFIG_JITPROFILE_HPP
+#define MELONDSDS_CONFIG_JITPROFILE_HPP
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace MelonDsDs {
+    /// Per-game overrides for the JIT options, for games that break or slow down with the global settings.
+    /// Each unset field falls back to the corresponding core option.
+    struct JitProfile {
+        std::optional<unsigned> MaxBlockSize;
+        std::optional<bool> BranchOptimizations;
+        std::optional<bool> LiteralOptimizations;
+        std::optional<bool> FastMemory;
+
+        /// True if \c MaxBlockSize was picked by the auto-tuner rather than by hand.
+        bool Tuned = false;
+    };
+
+    /// Returns the key that a game's JIT profile and preset are stored under, given the game code from its ROM header,
+    /// or \c nullopt if the code doesn't identify a specific game (e.g. most homebrew uses "####").
+    [[nodiscard]] std::optional<std::string> GetGameKey(std::string_view gameCode) noexcept;
+
+    /// Looks up the JIT profile for the given game code in the system directory's profile store.
+    [[nodiscard]] std::optional<JitProfile> LoadJitProfile(std::string_view key) noexcept;
+
+    /// Saves a JIT profile to the store, replacing any existing profile with the same key.
+    void SaveJitProfile(std::string_view key, const JitProfile& profile) noexcept;
+}
+
+#endif // MELONDSDS_CONFIG_JITPROFILE_HPP
@@ -0,0 +1,121 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#ifndef MELONDSDS_CONFIG_LOOKUP_HPP
+#define MELONDSDS_CONFIG_LOOKUP_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace MelonDsDs::config {
+    /// FNV-1a, salted with a seed so that \c OptionValueTable can search for one without collisions.
+    constexpr uint32_t HashOptionValue(std::string_view value, uint32_t seed) noexcept {
+        uint32_t hash = 2166136261u ^ (seed * 16777619u);
+        for (char c : value) {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 16777619u;
+        }
+
+        // FNV's low bits only depend on the low bits of its input, so mix the high bits back down;
+        // otherwise most seeds would produce the same slots.
+        hash ^= hash >> 16;
+        hash *= 0x45d9f3bu;
+        hash ^= hash >> 16;
+        return hash;
+    }
+
+    template<typename T>
+    struct OptionValue {
+        std::string_view Value;
+        T Parsed;
+    };
+
+    namespace detail {
+        // Not constexpr, so calling it while building a table at compile time is a compile error
+        // whose message names the problem.
+        inline void OptionValueTableHasDuplicateValues() noexcept {}
+
+        constexpr size_t OptionValueTableSize(size_t entries) noexcept {
+            size_t size = 1;
+            while (size < entries * 2) size <<= 1;
+            return size;
+        }
+    }
+
+    /// Maps a core option's value strings to the enum they parse to.
+    /// The table is built at compile time with a perfect hash,
+    /// so a lookup is one hash and at most one string comparison.
+    template<typename T, size_t N>
+    class OptionValueTable {
+    public:
+        static_assert(N > 0 && N < 0xFF, "OptionValueTable supports between 1 and 254 values");
+
+        constexpr explicit OptionValueTable(const OptionValue<T> (&entries)[N]) noexcept {
+            for (size_t i = 0; i < N; ++i) {
+                _entries[i] = entries[i];
+                for (size_t j = 0; j < i; ++j) {
+                    if (_entries[i].Value == _entries[j].Value) {
+                        detail::OptionValueTableHasDuplicateValues();
+                    }
+                }
+            }
+
+            // The keys are distinct, so some seed eventually puts each one in its own slot.
+            while (!TryBuild(_seed)) ++_seed;
+        }
+
+        constexpr std::optional<T> operator()(std::string_view value) const noexcept {
+            uint8_t index = _slots[HashOptionValue(value, _seed) & (SIZE - 1)];
+            if (index != EMPTY && _entries[index].Value == value) return _entries[index].Parsed;
+
+            return std::nullopt;
+        }
+
+        constexpr const std::array<OptionValue<T>, N>& Entries() const noexcept { return _entries; }
+    private:
+        static constexpr size_t SIZE = detail::OptionValueTableSize(N);
+        static constexpr uint8_t EMPTY = 0xFF;
+
+        constexpr bool TryBuild(uint32_t seed) noexcept {
+            for (uint8_t& slot : _slots) slot = EMPTY;
+
+            for (size_t i = 0; i < N; ++i) {
+                uint8_t& slot = _slots[HashOptionValue(_entries[i].Value, seed) & (SIZE - 1)];
+                if (slot != EMPTY) return false;
+
+                slot = static_cast<uint8_t>(i);
+            }
+
+            return true;
+        }
+
+        std::array<OptionValue<T>, N> _entries {};
+        std::array<uint8_t, SIZE> _slots {};
+        uint32_t _seed = 0;
+    };
+
+    /// Builds an \c OptionValueTable, deducing its size from the initializer.
+    template<typename T, size_t N>
+    constexpr OptionValueTable<T, N> MakeOptionValueTable(const OptionValue<T> (&entries)[N]) noexcept {
+        return OptionValueTable<T, N>(entries);
+    }
+}
+
+#endif // MELONDSDS_CONFIG_LOOKUP_HPP
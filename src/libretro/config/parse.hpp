@@ -22,6 +22,7 @@
 #include <string_view>
 
 #include "constants.hpp"
+#include "config/lookup.hpp"
 #include "config/types.hpp"
 
 #include "tracy.hpp"
@@ -66,176 +67,295 @@ namespace MelonDsDs {
         return std::nullopt;
     }
 
+    inline constexpr auto BootModeValues = config::MakeOptionValueTable<MelonDsDs::BootMode>({
+        {config::values::NATIVE, BootMode::Native},
+        {config::values::DIRECT, BootMode::Direct},
+    });
+
     constexpr std::optional<MelonDsDs::BootMode> ParseBootMode(std::string_view value) noexcept {
-        if (value == config::values::NATIVE) return BootMode::Native;
-        if (value == config::values::DIRECT) return BootMode::Direct;
-        return std::nullopt;
+        return BootModeValues(value);
     }
 
+    inline constexpr auto SysfileModeValues = config::MakeOptionValueTable<MelonDsDs::SysfileMode>({
+        {config::values::NATIVE, SysfileMode::Native},
+        {config::values::BUILT_IN, SysfileMode::BuiltIn},
+    });
+
     constexpr std::optional<MelonDsDs::SysfileMode> ParseSysfileMode(std::string_view value) noexcept {
-        if (value == config::values::NATIVE) return SysfileMode::Native;
-        if (value == config::values::BUILT_IN) return SysfileMode::BuiltIn;
-        return std::nullopt;
+        return SysfileModeValues(value);
     }
 
+    inline constexpr auto AlarmModeValues = config::MakeOptionValueTable<MelonDsDs::AlarmMode>({
+        {config::values::DISABLED, AlarmMode::Disabled},
+        {config::values::ENABLED, AlarmMode::Enabled},
+        {config::values::DEFAULT, AlarmMode::Default},
+    });
+
     constexpr std::optional<MelonDsDs::AlarmMode> ParseAlarmMode(std::string_view value) noexcept {
-        if (value == config::values::DISABLED) return AlarmMode::Disabled;
-        if (value == config::values::ENABLED) return AlarmMode::Enabled;
-        if (value == config::values::DEFAULT) return AlarmMode::Default;
-        return std::nullopt;
+        return AlarmModeValues(value);
     }
 
+    inline constexpr auto UsernameModeValues = config::MakeOptionValueTable<MelonDsDs::UsernameMode>({
+        {config::values::firmware::DEFAULT_USERNAME, UsernameMode::MelonDSDS},
+        {config::values::firmware::FIRMWARE_USERNAME, UsernameMode::Firmware},
+        {config::values::firmware::GUESS_USERNAME, UsernameMode::Guess},
+    });
+
     constexpr std::optional<MelonDsDs::UsernameMode> ParseUsernameMode(std::string_view value) noexcept {
-        if (value.empty() || value == config::values::firmware::DEFAULT_USERNAME) return UsernameMode::MelonDSDS;
-        if (value == config::values::firmware::FIRMWARE_USERNAME) return UsernameMode::Firmware;
-        if (value == config::values::firmware::GUESS_USERNAME) return UsernameMode::Guess;
-        return std::nullopt;
+        if (value.empty()) return UsernameMode::MelonDSDS;
+        return UsernameModeValues(value);
     }
 
+    inline constexpr auto RenderModeValues = config::MakeOptionValueTable<MelonDsDs::RenderMode>({
+        {config::values::SOFTWARE, MelonDsDs::RenderMode::Software},
+        {config::values::OPENGL, MelonDsDs::RenderMode::OpenGl},
+    });
+
     constexpr std::optional<MelonDsDs::RenderMode> ParseRenderMode(std::string_view value) noexcept {
-        if (value == config::values::SOFTWARE) return MelonDsDs::RenderMode::Software;
-        if (value == config::values::OPENGL) return MelonDsDs::RenderMode::OpenGl;
-        return std::nullopt;
+        return RenderModeValues(value);
     }
 
+    inline constexpr auto CursorModeValues = config::MakeOptionValueTable<MelonDsDs::CursorMode>({
+        {config::values::DISABLED, MelonDsDs::CursorMode::Never},
+        {config::values::TOUCHING, MelonDsDs::CursorMode::Touching},
+        {config::values::TIMEOUT, MelonDsDs::CursorMode::Timeout},
+        {config::values::ALWAYS, MelonDsDs::CursorMode::Always},
+    });
+
     constexpr std::optional<MelonDsDs::CursorMode> ParseCursorMode(std::string_view value) noexcept {
-        if (value == config::values::DISABLED) return MelonDsDs::CursorMode::Never;
-        if (value == config::values::TOUCHING) return MelonDsDs::CursorMode::Touching;
-        if (value == config::values::TIMEOUT) return MelonDsDs::CursorMode::Timeout;
-        if (value == config::values::ALWAYS) return MelonDsDs::CursorMode::Always;
-        return std::nullopt;
+        return CursorModeValues(value);
     }
 
+    inline constexpr auto ConsoleTypeValues = config::MakeOptionValueTable<MelonDsDs::ConsoleType>({
+        {config::values::DS, MelonDsDs::ConsoleType::DS},
+        {config::values::DSI, MelonDsDs::ConsoleType::DSi},
+    });
+
     constexpr std::optional<MelonDsDs::ConsoleType> ParseConsoleType(std::string_view value) noexcept {
-        if (value == config::values::DS) return MelonDsDs::ConsoleType::DS;
-        if (value == config::values::DSI) return MelonDsDs::ConsoleType::DSi;
-        return std::nullopt;
+        return ConsoleTypeValues(value);
     }
 
+    inline constexpr auto Slot2DeviceValues = config::MakeOptionValueTable<MelonDsDs::Slot2Device>({
+        {config::values::AUTO, MelonDsDs::Slot2Device::Auto},
+        {config::values::RUMBLE_PAK, MelonDsDs::Slot2Device::RumblePak},
+        {config::values::EXPANSION_PAK, MelonDsDs::Slot2Device::MemoryExpansionPak},
+        {config::values::system::SOLAR_SENSOR_1, MelonDsDs::Slot2Device::SolarSensorBoktai1},
+        {config::values::system::SOLAR_SENSOR_2, MelonDsDs::Slot2Device::SolarSensorBoktai2},
+        {config::values::system::SOLAR_SENSOR_3, MelonDsDs::Slot2Device::SolarSensorBoktai3},
+    });
+
     constexpr std::optional<MelonDsDs::Slot2Device> ParseSlot2Device(std::string_view value) noexcept {
-        if (value == config::values::AUTO) return MelonDsDs::Slot2Device::Auto;
-        if (value == config::values::RUMBLE_PAK) return MelonDsDs::Slot2Device::RumblePak;
-        if (value == config::values::EXPANSION_PAK) return MelonDsDs::Slot2Device::MemoryExpansionPak;
-        if (value == config::values::system::SOLAR_SENSOR_1) return MelonDsDs::Slot2Device::SolarSensorBoktai1;
-        if (value == config::values::system::SOLAR_SENSOR_2) return MelonDsDs::Slot2Device::SolarSensorBoktai2;
-        if (value == config::values::system::SOLAR_SENSOR_3) return MelonDsDs::Slot2Device::SolarSensorBoktai3;
-        return std::nullopt;
+        return Slot2DeviceValues(value);
     }
 
+    inline constexpr auto RumbleMotorTypeValues = config::MakeOptionValueTable<MelonDsDs::RumbleMotorType>({
+        {config::values::BOTH, MelonDsDs::RumbleMotorType::Both},
+        {config::values::STRONG, MelonDsDs::RumbleMotorType::Strong},
+        {config::values::WEAK, MelonDsDs::RumbleMotorType::Weak},
+    });
+
     constexpr std::optional<MelonDsDs::RumbleMotorType> ParseRumbleMotorType(std::string_view value) noexcept {
-        if (value == config::values::BOTH) return MelonDsDs::RumbleMotorType::Both;
-        if (value == config::values::STRONG) return MelonDsDs::RumbleMotorType::Strong;
-        if (value == config::values::WEAK) return MelonDsDs::RumbleMotorType::Weak;
-        return std::nullopt;
+        return RumbleMotorTypeValues(value);
     }
 
+    inline constexpr auto NetworkModeValues = config::MakeOptionValueTable<MelonDsDs::NetworkMode>({
+        {config::values::DISABLED, MelonDsDs::NetworkMode::None},
+        {config::values::DIRECT, MelonDsDs::NetworkMode::Direct},
+        {config::values::INDIRECT, MelonDsDs::NetworkMode::Indirect},
+    });
+
     constexpr std::optional<MelonDsDs::NetworkMode> ParseNetworkMode(std::string_view value) noexcept {
-        if (value == config::values::DISABLED) return MelonDsDs::NetworkMode::None;
-        if (value == config::values::DIRECT) return MelonDsDs::NetworkMode::Direct;
-        if (value == config::values::INDIRECT) return MelonDsDs::NetworkMode::Indirect;
-        return std::nullopt;
+        return NetworkModeValues(value);
     }
 
+    inline constexpr auto MpTransportValues = config::MakeOptionValueTable<MelonDsDs::MpTransport>({
+        {config::values::NETPLAY, MelonDsDs::MpTransport::Netplay},
+        {config::values::SHARED_MEMORY, MelonDsDs::MpTransport::SharedMemory},
+    });
+
+    constexpr std::optional<MelonDsDs::MpTransport> ParseMpTransport(std::string_view value) noexcept {
+        return MpTransportValues(value);
+    }
+
+    inline constexpr auto ScreenLayoutValues = config::MakeOptionValueTable<MelonDsDs::ScreenLayout>({
+        {config::values::TOP_BOTTOM, ScreenLayout::TopBottom},
+        {config::values::BOTTOM_TOP, ScreenLayout::BottomTop},
+        {config::values::LEFT_RIGHT, ScreenLayout::LeftRight},
+        {config::values::RIGHT_LEFT, ScreenLayout::RightLeft},
+        {config::values::TOP, ScreenLayout::TopOnly},
+        {config::values::BOTTOM, ScreenLayout::BottomOnly},
+        {config::values::HYBRID_TOP, ScreenLayout::HybridTop},
+        {config::values::HYBRID_BOTTOM, ScreenLayout::HybridBottom},
+        {config::values::FLIPPED_HYBRID_TOP, ScreenLayout::FlippedHybridTop},
+        {config::values::FLIPPED_HYBRID_BOTTOM, ScreenLayout::FlippedHybridBottom},
+        {config::values::ROTATE_LEFT, ScreenLayout::TurnLeft},
+        {config::values::ROTATE_RIGHT, ScreenLayout::TurnRight},
+        {config::values::UPSIDE_DOWN, ScreenLayout::UpsideDown},
+        {config::values::LARGESCREEN_TOP, ScreenLayout::LargescreenTop},
+        {config::values::LARGESCREEN_BOTTOM, ScreenLayout::LargescreenBottom},
+        {config::values::FLIPPED_LARGESCREEN_TOP, ScreenLayout::FlippedLargescreenTop},
+        {config::values::FLIPPED_LARGESCREEN_BOTTOM, ScreenLayout::FlippedLargescreenBottom},
+    });
+
     constexpr std::optional<MelonDsDs::ScreenLayout> ParseScreenLayout(std::string_view value) noexcept {
-        using MelonDsDs::ScreenLayout;
-        if (value == config::values::TOP_BOTTOM) return ScreenLayout::TopBottom;
-        if (value == config::values::BOTTOM_TOP) return ScreenLayout::BottomTop;
-        if (value == config::values::LEFT_RIGHT) return ScreenLayout::LeftRight;
-        if (value == config::values::RIGHT_LEFT) return ScreenLayout::RightLeft;
-        if (value == config::values::TOP) return ScreenLayout::TopOnly;
-        if (value == config::values::BOTTOM) return ScreenLayout::BottomOnly;
-        if (value == config::values::HYBRID_TOP) return ScreenLayout::HybridTop;
-        if (value == config::values::HYBRID_BOTTOM) return ScreenLayout::HybridBottom;
-        if (value == config::values::FLIPPED_HYBRID_TOP) return ScreenLayout::FlippedHybridTop;
-        if (value == config::values::FLIPPED_HYBRID_BOTTOM) return ScreenLayout::FlippedHybridBottom;
-        if (value == config::values::ROTATE_LEFT) return ScreenLayout::TurnLeft;
-        if (value == config::values::ROTATE_RIGHT) return ScreenLayout::TurnRight;
-        if (value == config::values::UPSIDE_DOWN) return ScreenLayout::UpsideDown;
-        if (value == config::values::LARGESCREEN_TOP) return ScreenLayout::LargescreenTop;
-        if (value == config::values::LARGESCREEN_BOTTOM) return ScreenLayout::LargescreenBottom;
-        if (value == config::values::FLIPPED_LARGESCREEN_TOP) return ScreenLayout::FlippedLargescreenTop;
-        if (value == config::values::FLIPPED_LARGESCREEN_BOTTOM) return ScreenLayout::FlippedLargescreenBottom;
-        return std::nullopt;
+        return ScreenLayoutValues(value);
     }
 
-    constexpr std::optional<HybridSideScreenDisplay> ParseHybridSideScreenDisplay(std::string_view value) noexcept {
-        using MelonDsDs::ScreenLayout;
-        if (value == config::values::ONE) return MelonDsDs::HybridSideScreenDisplay::One;
-        if (value == config::values::BOTH) return MelonDsDs::HybridSideScreenDisplay::Both;
+    inline constexpr auto HybridSideScreenDisplayValues = config::MakeOptionValueTable<HybridSideScreenDisplay>({
+        {config::values::ONE, MelonDsDs::HybridSideScreenDisplay::One},
+        {config::values::BOTH, MelonDsDs::HybridSideScreenDisplay::Both},
+    });
 
-        return std::nullopt;
+    constexpr std::optional<HybridSideScreenDisplay> ParseHybridSideScreenDisplay(std::string_view value) noexcept {
+        return HybridSideScreenDisplayValues(value);
     }
 
-    constexpr std::optional<FirmwareLanguage> ParseLanguage(std::string_view value) noexcept {
-        if (value == config::values::AUTO) return MelonDsDs::FirmwareLanguage::Auto;
-        if (value == config::values::DEFAULT) return MelonDsDs::FirmwareLanguage::Default;
-        if (value == config::values::JAPANESE) return MelonDsDs::FirmwareLanguage::Japanese;
-        if (value == config::values::ENGLISH) return MelonDsDs::FirmwareLanguage::English;
-        if (value == config::values::FRENCH) return MelonDsDs::FirmwareLanguage::French;
-        if (value == config::values::GERMAN) return MelonDsDs::FirmwareLanguage::German;
-        if (value == config::values::ITALIAN) return MelonDsDs::FirmwareLanguage::Italian;
-        if (value == config::values::SPANISH) return MelonDsDs::FirmwareLanguage::Spanish;
+    inline constexpr auto LanguageValues = config::MakeOptionValueTable<FirmwareLanguage>({
+        {config::values::AUTO, MelonDsDs::FirmwareLanguage::Auto},
+        {config::values::DEFAULT, MelonDsDs::FirmwareLanguage::Default},
+        {config::values::JAPANESE, MelonDsDs::FirmwareLanguage::Japanese},
+        {config::values::ENGLISH, MelonDsDs::FirmwareLanguage::English},
+        {config::values::FRENCH, MelonDsDs::FirmwareLanguage::French},
+        {config::values::GERMAN, MelonDsDs::FirmwareLanguage::German},
+        {config::values::ITALIAN, MelonDsDs::FirmwareLanguage::Italian},
+        {config::values::SPANISH, MelonDsDs::FirmwareLanguage::Spanish},
+    });
 
-        return std::nullopt;
+    constexpr std::optional<FirmwareLanguage> ParseLanguage(std::string_view value) noexcept {
+        return LanguageValues(value);
     }
 
-    constexpr std::optional<MicInputMode> ParseMicInputMode(std::string_view value) noexcept {
-        if (value == config::values::MICROPHONE) return MicInputMode::HostMic;
-        if (value == config::values::NOISE) return MicInputMode::WhiteNoise;
-        if (value == config::values::BLOW) return MicInputMode::Blow;
-        if (value == config::values::SILENCE) return MicInputMode::None;
+    inline constexpr auto MicInputModeValues = config::MakeOptionValueTable<MicInputMode>({
+        {config::values::MICROPHONE, MicInputMode::HostMic},
+        {config::values::NOISE, MicInputMode::WhiteNoise},
+        {config::values::BLOW, MicInputMode::Blow},
+        {config::values::SILENCE, MicInputMode::None},
+    });
 
-        return std::nullopt;
+    constexpr std::optional<MicInputMode> ParseMicInputMode(std::string_view value) noexcept {
+        return MicInputModeValues(value);
     }
 
-    constexpr std::optional<MicButtonMode> ParseMicButtonMode(std::string_view value) noexcept {
-        if (value == config::values::HOLD) return MicButtonMode::Hold;
-        if (value == config::values::TOGGLE) return MicButtonMode::Toggle;
-        if (value == config::values::ALWAYS) return MicButtonMode::Always;
+    inline constexpr auto MicButtonModeValues = config::MakeOptionValueTable<MicButtonMode>({
+        {config::values::HOLD, MicButtonMode::Hold},
+        {config::values::TOGGLE, MicButtonMode::Toggle},
+        {config::values::ALWAYS, MicButtonMode::Always},
+    });
 
-        return std::nullopt;
+    constexpr std::optional<MicButtonMode> ParseMicButtonMode(std::string_view value) noexcept {
+        return MicButtonModeValues(value);
     }
 
-    constexpr std::optional<MelonDsDs::TouchMode> ParseTouchMode(std::string_view value) noexcept {
-        if (value == config::values::AUTO) return TouchMode::Auto;
-        if (value == config::values::TOUCH) return TouchMode::Pointer;
-        if (value == config::values::JOYSTICK) return TouchMode::Joystick;
+    inline constexpr auto TouchModeValues = config::MakeOptionValueTable<MelonDsDs::TouchMode>({
+        {config::values::AUTO, TouchMode::Auto},
+        {config::values::TOUCH, TouchMode::Pointer},
+        {config::values::JOYSTICK, TouchMode::Joystick},
+    });
 
-        return std::nullopt;
+    constexpr std::optional<MelonDsDs::TouchMode> ParseTouchMode(std::string_view value) noexcept {
+        return TouchModeValues(value);
     }
 
-    constexpr std::optional<melonDS::AudioBitDepth> ParseBitDepth(std::string_view value) noexcept {
-        if (value == config::values::_10BIT) return melonDS::AudioBitDepth::_10Bit;
-        if (value == config::values::_16BIT) return melonDS::AudioBitDepth::_16Bit;
-        if (value == config::values::AUTO) return melonDS::AudioBitDepth::Auto;
+    inline constexpr auto BitDepthValues = config::MakeOptionValueTable<melonDS::AudioBitDepth>({
+        {config::values::_10BIT, melonDS::AudioBitDepth::_10Bit},
+        {config::values::_16BIT, melonDS::AudioBitDepth::_16Bit},
+        {config::values::AUTO, melonDS::AudioBitDepth::Auto},
+    });
 
-        return std::nullopt;
+    constexpr std::optional<melonDS::AudioBitDepth> ParseBitDepth(std::string_view value) noexcept {
+        return BitDepthValues(value);
     }
 
+    inline constexpr auto InterpolationValues = config::MakeOptionValueTable<melonDS::AudioInterpolation>({
+        {config::values::CUBIC, melonDS::AudioInterpolation::Cubic},
+        {config::values::COSINE, melonDS::AudioInterpolation::Cosine},
+        {config::values::LINEAR, melonDS::AudioInterpolation::Linear},
+        {config::values::GAUSSIAN, melonDS::AudioInterpolation::SNESGaussian},
+        {config::values::DISABLED, melonDS::AudioInterpolation::None},
+    });
+
     constexpr std::optional<melonDS::AudioInterpolation> ParseInterpolation(std::string_view value) noexcept {
-        if (value == config::values::CUBIC) return melonDS::AudioInterpolation::Cubic;
-        if (value == config::values::COSINE) return melonDS::AudioInterpolation::Cosine;
-        if (value == config::values::LINEAR) return melonDS::AudioInterpolation::Linear;
-        if (value == config::values::GAUSSIAN) return melonDS::AudioInterpolation::SNESGaussian;
-        if (value == config::values::DISABLED) return melonDS::AudioInterpolation::None;
+        return InterpolationValues(value);
+    }
 
-        return std::nullopt;
+    inline constexpr auto ResamplerQualityValues = config::MakeOptionValueTable<ResamplerQuality>({
+        {config::values::FAST, ResamplerQuality::Fast},
+        {config::values::BALANCED, ResamplerQuality::Balanced},
+        {config::values::BEST, ResamplerQuality::Best},
+    });
+
+    constexpr std::optional<ResamplerQuality> ParseResamplerQuality(std::string_view value) noexcept {
+        return ResamplerQualityValues(value);
     }
 
-    constexpr std::optional<ScreenFilter> ParseScreenFilter(std::string_view value) noexcept {
-        if (value == config::values::LINEAR) return ScreenFilter::Linear;
-        if (value == config::values::NEAREST) return ScreenFilter::Nearest;
+    inline constexpr auto ScreenRotationMethodValues = config::MakeOptionValueTable<ScreenRotationMethod>({
+        {config::values::AUTO, ScreenRotationMethod::Auto},
+        {config::values::FRONTEND, ScreenRotationMethod::Frontend},
+        {config::values::CORE, ScreenRotationMethod::Core},
+    });
 
-        return std::nullopt;
+    constexpr std::optional<ScreenRotationMethod> ParseScreenRotationMethod(std::string_view value) noexcept {
+        return ScreenRotationMethodValues(value);
     }
 
-    constexpr std::optional<MelonDsDs::StartTimeMode> ParseStartTimeMode(std::string_view value) noexcept {
-        if (value == config::values::REAL) return StartTimeMode::Real;
-        if (value == config::values::SYNC) return StartTimeMode::Sync;
-        if (value == config::values::RELATIVE_TIME) return StartTimeMode::Relative;
-        if (value == config::values::ABSOLUTE_TIME) return StartTimeMode::Absolute;
+    inline constexpr auto OpenGlStateIsolationValues = config::MakeOptionValueTable<OpenGlStateIsolation>({
+        {config::values::AUTO, OpenGlStateIsolation::Auto},
+        {config::values::ENABLED, OpenGlStateIsolation::Enabled},
+        {config::values::DISABLED, OpenGlStateIsolation::Disabled},
+    });
 
-        return std::nullopt;
+    constexpr std::optional<OpenGlStateIsolation> ParseOpenGlStateIsolation(std::string_view value) noexcept {
+        return OpenGlStateIsolationValues(value);
+    }
+
+    inline constexpr auto FrameSkipModeValues = config::MakeOptionValueTable<FrameSkipMode>({
+        {config::values::DISABLED, FrameSkipMode::Disabled},
+        {config::values::FAST_FORWARD, FrameSkipMode::FastForward},
+        {config::values::AUTO, FrameSkipMode::Auto},
+    });
+
+    constexpr std::optional<FrameSkipMode> ParseFrameSkipMode(std::string_view value) noexcept {
+        return FrameSkipModeValues(value);
+    }
+
+    inline constexpr auto LidPowerSavingValues = config::MakeOptionValueTable<LidPowerSaving>({
+        {config::values::DISABLED, LidPowerSaving::Disabled},
+        {config::values::ENABLED, LidPowerSaving::SkipFrames},
+        {config::values::IDLE, LidPowerSaving::Idle},
+    });
+
+    constexpr std::optional<LidPowerSaving> ParseLidPowerSaving(std::string_view value) noexcept {
+        return LidPowerSavingValues(value);
+    }
+
+    inline constexpr auto ThreadPlacementValues = config::MakeOptionValueTable<ThreadPlacement>({
+        {config::values::AUTO, ThreadPlacement::Any},
+        {config::values::PERFORMANCE, ThreadPlacement::Performance},
+        {config::values::EFFICIENCY, ThreadPlacement::Efficiency},
+    });
+
+    constexpr std::optional<ThreadPlacement> ParseThreadPlacement(std::string_view value) noexcept {
+        return ThreadPlacementValues(value);
+    }
+
+    inline constexpr auto ScreenFilterValues = config::MakeOptionValueTable<ScreenFilter>({
+        {config::values::LINEAR, ScreenFilter::Linear},
+        {config::values::NEAREST, ScreenFilter::Nearest},
+    });
+
+    constexpr std::optional<ScreenFilter> ParseScreenFilter(std::string_view value) noexcept {
+        return ScreenFilterValues(value);
+    }
+
+    inline constexpr auto StartTimeModeValues = config::MakeOptionValueTable<MelonDsDs::StartTimeMode>({
+        {config::values::REAL, StartTimeMode::Real},
+        {config::values::SYNC, StartTimeMode::Sync},
+        {config::values::RELATIVE_TIME, StartTimeMode::Relative},
+        {config::values::ABSOLUTE_TIME, StartTimeMode::Absolute},
+    });
+
+    constexpr std::optional<MelonDsDs::StartTimeMode> ParseStartTimeMode(std::string_view value) noexcept {
+        return StartTimeModeValues(value);
     }
 
     std::optional<melonDS::IpAddress> ParseIpAddress(std::string_view value) noexcept;
@@ -0,0 +1,100 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "presets.hpp"
+
+#include <cstdlib>
+
+#include <streams/file_stream.h>
+
+#include "embedded/melondsds_default_presets.h"
+#include "environment.hpp"
+#include "tracy.hpp"
+
+using std::nullopt;
+using std::optional;
+using std::string;
+using std::string_view;
+
+// Same format as the built-in presets (see assets/presets.txt)
+constexpr string_view USER_PRESETS_NAME = "presets.txt";
+
+// Adds the values from the line for the given key (if any) to the preset, replacing any that it already has.
+// Returns true if such a line was found.
+static bool ParsePresets(string_view contents, string_view key, MelonDsDs::GamePreset& preset) noexcept {
+    bool found = false;
+    while (!contents.empty()) {
+        size_t end = contents.find('\n');
+        string_view line = contents.substr(0, end);
+        contents = end == string_view::npos ? string_view() : contents.substr(end + 1);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+
+        size_t space = line.find(' ');
+        if (line.empty() || line.front() == '#' || line.substr(0, space) != key) {
+            continue;
+        }
+
+        found = true;
+        string_view fields = space == string_view::npos ? string_view() : line.substr(space + 1);
+        while (!fields.empty()) {
+            size_t fieldEnd = fields.find(' ');
+            string_view field = fields.substr(0, fieldEnd);
+            fields = fieldEnd == string_view::npos ? string_view() : fields.substr(fieldEnd + 1);
+            if (field.empty()) {
+                continue;
+            }
+
+            size_t equals = field.find('=');
+            if (equals == string_view::npos || equals == 0) {
+                retro::warn("Ignoring malformed preset field \"{}\" for {}", field, key);
+                continue;
+            }
+
+            preset.Values.insert_or_assign(string(field.substr(0, equals)), string(field.substr(equals + 1)));
+        }
+    }
+
+    return found;
+}
+
+optional<MelonDsDs::GamePreset> MelonDsDs::LoadGamePreset(string_view key) noexcept {
+    ZoneScopedN(TracyFunction);
+    GamePreset preset;
+    bool found = ParsePresets(embedded_melondsds_default_presets, key, preset);
+
+    if (optional<string> path = retro::get_system_subdir_path(USER_PRESETS_NAME)) {
+        // If the player might have presets of their own...
+        void* buffer = nullptr;
+        int64_t length = 0;
+        if (filestream_read_file(path->c_str(), &buffer, &length) && buffer) {
+            // ...then they're applied over the built-in ones.
+            if (ParsePresets(string_view(static_cast<const char*>(buffer), length), key, preset)) {
+                found = true;
+                preset.UserDefined = true;
+            }
+            free(buffer);
+        }
+    }
+
+    if (!found) {
+        return nullopt;
+    }
+
+    return preset;
+}
@@ -0,0 +1,45 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#ifndef MELONDSDS_CONFIG_PRESETS_HPP
+#define MELONDSDS_CONFIG_PRESETS_HPP
+
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace MelonDsDs {
+    /// Core option values that replace the options' defaults for a particular game,
+    /// e.g. a renderer or scale factor that's known to work well with it.
+    /// Options that the player has changed from their defaults are left alone.
+    struct GamePreset {
+        /// Option keys mapped to values, in the same format as the core options.
+        std::map<std::string, std::string, std::less<>> Values;
+
+        /// True if any of the values came from the player's own preset file rather than the built-in one.
+        bool UserDefined = false;
+    };
+
+    /// Looks up the preset for the given game (see \c GetGameKey),
+    /// merging the built-in presets with the player's presets.txt in the system directory.
+    /// The player's values take precedence.
+    [[nodiscard]] std::optional<GamePreset> LoadGamePreset(std::string_view key) noexcept;
+}
+
+#endif // MELONDSDS_CONFIG_PRESETS_HPP
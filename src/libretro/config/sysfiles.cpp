@@ -0,0 +1,351 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "sysfiles.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <string_view>
+#include <sys/stat.h>
+
+#include <compat/strl.h>
+#include <file/file_path.h>
+#include <streams/file_stream.h>
+#include <fmt/format.h>
+
+#include "config/constants.hpp"
+#include "environment.hpp"
+#include "retro/dirent.hpp"
+#include "retro/threads.hpp"
+#include "tracy.hpp"
+
+using std::optional;
+using std::nullopt;
+using std::span;
+using std::string;
+using std::string_view;
+using std::vector;
+
+constexpr string_view SYSTEM_FILE_INDEX_NAME = "sysfiles.txt";
+
+// Everything else in the system directory is ruled out by its size alone,
+// so it doesn't need to be stat'd or indexed.
+static bool IsCandidateSize(int64_t size) noexcept {
+    using namespace MelonDsDs::config;
+    for (size_t nandSize : DSI_NAND_SIZES_NOFOOTER) {
+        if (size == static_cast<int64_t>(nandSize) || size == static_cast<int64_t>(nandSize + NOCASH_FOOTER_SIZE))
+            return true;
+    }
+
+    return std::find(FIRMWARE_SIZES.begin(), FIRMWARE_SIZES.end(), static_cast<size_t>(size)) != FIRMWARE_SIZES.end();
+}
+
+static int64_t NewestTimestamp(const struct stat& statbuf) noexcept {
+    return std::max({statbuf.st_atime, statbuf.st_mtime, statbuf.st_ctime});
+}
+
+static bool SameFile(const MelonDsDs::SystemFile& a, const MelonDsDs::SystemFile& b) noexcept {
+    return a.Path == b.Path && a.Type == b.Type && a.ConsoleType == b.ConsoleType && a.Size == b.Size && a.ModifiedTime == b.ModifiedTime;
+}
+
+template<typename T>
+static optional<T> ParseNumber(string_view text) noexcept {
+    T value {};
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc() || end != text.data() + text.size())
+        return nullopt;
+
+    return value;
+}
+
+// Splits off the next tab-separated field of line
+static string_view NextField(string_view& line) noexcept {
+    size_t end = std::min(line.find('\t'), line.size());
+    string_view field = line.substr(0, end);
+    line.remove_prefix(std::min(end + 1, line.size()));
+    return field;
+}
+
+// Returns the system file at the given entry, reusing what's known about it if it hasn't changed.
+static optional<MelonDsDs::SystemFile> Examine(const retro::dirent& d, span<const MelonDsDs::SystemFile> known) noexcept {
+    ZoneScopedN(TracyFunction);
+    using namespace MelonDsDs;
+
+    if (!d.is_regular_file() || !IsCandidateSize(d.size))
+        return nullopt;
+
+    struct stat statbuf {};
+    if (stat(d.path, &statbuf) != 0)
+        return nullopt;
+
+    SystemFile file {
+        .Path = d.path,
+        .Size = static_cast<int64_t>(statbuf.st_size),
+        .ModifiedTime = static_cast<int64_t>(statbuf.st_mtime),
+        .Timestamp = NewestTimestamp(statbuf),
+    };
+
+    auto match = std::find_if(known.begin(), known.end(), [&file](const SystemFile& f) {
+        return f.Path == file.Path && f.Size == file.Size && f.ModifiedTime == file.ModifiedTime;
+    });
+
+    if (match != known.end()) {
+        // If this file hasn't changed since we last looked at it...
+        file.Type = match->Type;
+        file.ConsoleType = match->ConsoleType;
+        return file;
+    }
+
+    melonDS::Firmware::FirmwareHeader header {};
+    if (config::IsDsiNandImage(d)) {
+        file.Type = SystemFileType::DsiNand;
+    } else if (config::IsFirmwareImage(d, header)) {
+        file.Type = SystemFileType::Firmware;
+        file.ConsoleType = header.ConsoleType;
+    }
+
+    return file;
+}
+
+static optional<int64_t> DirectoryModifiedTime(const string& path) noexcept {
+    struct stat statbuf {};
+    if (stat(path.c_str(), &statbuf) != 0)
+        return nullopt;
+
+    return static_cast<int64_t>(statbuf.st_mtime);
+}
+
+vector<string> MelonDsDs::SystemFileIndex::Directories() noexcept {
+    optional<string_view> sysdir = retro::get_system_directory();
+    optional<string_view> subdir = retro::get_system_subdirectory();
+    if (!sysdir || !subdir)
+        return {};
+
+    return { string(*sysdir), string(*subdir) };
+}
+
+MelonDsDs::SystemFileIndex::ScanResult MelonDsDs::SystemFileIndex::Scan(vector<string> directories, span<const SystemFile> known) noexcept {
+    ZoneScopedN(TracyFunction);
+
+    ScanResult result;
+    for (string& path : directories) {
+        // Take the timestamp first, so that a file added during the scan makes the index stale
+        optional<int64_t> modifiedTime = DirectoryModifiedTime(path);
+        for (const retro::dirent& d : retro::readdir(path, true)) {
+            if (optional<SystemFile> file = Examine(d, known)) {
+                result.Files.push_back(std::move(*file));
+            }
+        }
+
+        result.Directories.push_back({ .Path = std::move(path), .ModifiedTime = modifiedTime.value_or(0) });
+    }
+
+    return result;
+}
+
+bool MelonDsDs::SystemFileIndex::IsStale() const noexcept {
+    vector<string> directories = Directories();
+    if (directories.size() != _directories.size())
+        return true;
+
+    for (size_t i = 0; i < directories.size(); ++i) {
+        if (directories[i] != _directories[i].Path || DirectoryModifiedTime(directories[i]) != _directories[i].ModifiedTime)
+            return true;
+    }
+
+    return false;
+}
+
+void MelonDsDs::SystemFileIndex::Load() noexcept {
+    ZoneScopedN(TracyFunction);
+
+    if (_loaded)
+        return;
+
+    _loaded = true;
+    optional<string> path = retro::get_system_subdir_path(SYSTEM_FILE_INDEX_NAME);
+    void* buffer = nullptr;
+    int64_t size = 0;
+    if (!path || !path_is_valid(path->c_str()) || !filestream_read_file(path->c_str(), &buffer, &size)) {
+        // If this is the first session (or the index couldn't be read), there's nothing to reuse
+        ScanResult result = Scan(Directories(), {});
+        _directories = std::move(result.Directories);
+        _files = std::move(result.Files);
+        retro::info("Scanned the system directory and found {} candidate system files", _files.size());
+        Save();
+        return;
+    }
+
+    // One entry per line, either "dir\tmtime\tpath" or "file\ttype\tconsoletype\tsize\tmtime\tpath"
+    vector<SystemFile> indexed;
+    for (string_view contents(static_cast<const char*>(buffer), size); !contents.empty();) {
+        size_t end = std::min(contents.find('\n'), contents.size());
+        string_view line = contents.substr(0, end);
+        contents.remove_prefix(std::min(end + 1, contents.size()));
+
+        string_view kind = NextField(line);
+        if (kind == "dir") {
+            optional<int64_t> modifiedTime = ParseNumber<int64_t>(NextField(line));
+            if (modifiedTime && !line.empty())
+                _directories.push_back({ .Path = string(line), .ModifiedTime = *modifiedTime });
+        } else if (kind == "file") {
+            optional<uint8_t> type = ParseNumber<uint8_t>(NextField(line));
+            optional<uint8_t> consoleType = ParseNumber<uint8_t>(NextField(line));
+            optional<int64_t> fileSize = ParseNumber<int64_t>(NextField(line));
+            optional<int64_t> modifiedTime = ParseNumber<int64_t>(NextField(line));
+            if (type && *type <= static_cast<uint8_t>(SystemFileType::DsiNand) && consoleType && fileSize && modifiedTime && !line.empty()) {
+                indexed.push_back({
+                    .Path = string(line),
+                    .Type = static_cast<SystemFileType>(*type),
+                    .ConsoleType = static_cast<melonDS::Firmware::FirmwareConsoleType>(*consoleType),
+                    .Size = *fileSize,
+                    .ModifiedTime = *modifiedTime,
+                });
+            }
+        }
+    }
+    free(buffer);
+
+    // Only the indexed files are re-checked now; anything new is picked up by Refresh
+    bool changed = false;
+    for (const SystemFile& file : indexed) {
+        struct stat statbuf {};
+        if (stat(file.Path.c_str(), &statbuf) != 0) {
+            changed = true;
+            continue; // The file was probably deleted
+        }
+
+        retro::dirent d;
+        strlcpy(d.path, file.Path.c_str(), sizeof(d.path));
+        d.size = static_cast<int32_t>(statbuf.st_size);
+        d.flags = RETRO_VFS_STAT_IS_VALID;
+        if (optional<SystemFile> current = Examine(d, indexed)) {
+            changed |= !SameFile(*current, file);
+            _files.push_back(std::move(*current));
+        } else {
+            changed = true;
+        }
+    }
+
+    retro::debug("Loaded {} candidate system files from \"{}\"", _files.size(), *path);
+    if (changed) {
+        Save();
+    }
+}
+
+void MelonDsDs::SystemFileIndex::Refresh(FilesRefreshedFn onRefreshed) noexcept {
+    ZoneScopedN(TracyFunction);
+
+    _onRefreshed = std::move(onRefreshed);
+    if (_scanTaskId && retro::task::find(*_scanTaskId)) {
+        retro::debug("A system directory scan is already underway");
+        return;
+    }
+
+    if (!IsStale())
+        return;
+
+    struct ScanState {
+        vector<string> Directories;
+        vector<SystemFile> Known;
+        std::unique_ptr<retro::future<ScanResult>> Result;
+        bool FilesChanged = false;
+    };
+
+    auto scan = std::make_shared<ScanState>();
+    scan->Directories = Directories(); // The environment can't be queried from the scanning thread
+    scan->Known = _files;
+    retro::task::TaskSpec scanTask(
+        [this, scan](retro::task::TaskHandle& task) noexcept {
+            if (!scan->Result) {
+                // The future is destroyed before the state it points to
+                scan->Result = std::make_unique<retro::future<ScanResult>>([state = scan.get()] {
+                    return Scan(state->Directories, state->Known);
+                });
+            }
+
+            if (!scan->Result->ready())
+                return;
+
+            ScanResult result = scan->Result->get();
+            scan->FilesChanged = !std::equal(_files.begin(), _files.end(), result.Files.begin(), result.Files.end(), SameFile);
+            _directories = std::move(result.Directories);
+            _files = std::move(result.Files);
+            retro::info("Rescanned the system directory and found {} candidate system files", _files.size());
+            Save();
+            task.Finish();
+        },
+        [this, scan](retro::task::TaskHandle& task, void*, string_view) noexcept {
+            if (task.IsCancelled())
+                return; // The game is probably being unloaded
+
+            if (_onRefreshed)
+                _onRefreshed(scan->FilesChanged);
+        },
+        [scan](retro::task::TaskHandle&) noexcept {
+            // Waits for the scanning thread if the task was cancelled before it finished
+            scan->Result = nullptr;
+        },
+        retro::task::ASAP,
+        "SystemFileScanTask"
+    );
+
+    _scanTaskId = retro::task::push(std::move(scanTask));
+}
+
+void MelonDsDs::SystemFileIndex::Save() noexcept {
+    ZoneScopedN(TracyFunction);
+
+    optional<string> path = retro::get_system_subdir_path(SYSTEM_FILE_INDEX_NAME);
+    if (!path)
+        return;
+
+    if (!path_is_valid(path->c_str()) && filestream_write_file(path->c_str(), "", 0)) {
+        // Creating the index touches its own directory, which would otherwise make the index stale right away
+        for (ScannedDirectory& directory : _directories) {
+            if (path->size() == directory.Path.size() + 1 + SYSTEM_FILE_INDEX_NAME.size() && path->starts_with(directory.Path)) {
+                directory.ModifiedTime = DirectoryModifiedTime(directory.Path).value_or(0);
+            }
+        }
+    }
+
+    string contents;
+    for (const ScannedDirectory& directory : _directories) {
+        fmt::format_to(std::back_inserter(contents), "dir\t{}\t{}\n", directory.ModifiedTime, directory.Path);
+    }
+
+    for (const SystemFile& file : _files) {
+        fmt::format_to(
+            std::back_inserter(contents),
+            "file\t{}\t{}\t{}\t{}\t{}\n",
+            static_cast<uint8_t>(file.Type),
+            static_cast<uint8_t>(file.ConsoleType),
+            file.Size,
+            file.ModifiedTime,
+            file.Path
+        );
+    }
+
+    if (filestream_write_file(path->c_str(), contents.data(), contents.size())) {
+        retro::debug("Saved {} candidate system files to \"{}\"", _files.size(), *path);
+    } else {
+        retro::warn("Failed to save the system file index to \"{}\"", *path);
+    }
+}
@@ -0,0 +1,98 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#ifndef MELONDSDS_CONFIG_SYSFILES_HPP
+#define MELONDSDS_CONFIG_SYSFILES_HPP
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <SPI_Firmware.h>
+
+#include "retro/task_queue.hpp"
+
+namespace MelonDsDs {
+    enum class SystemFileType : uint8_t {
+        /// A file whose size matched a system file, but whose contents didn't.
+        /// Indexed anyway so that it isn't opened again until it changes.
+        None,
+        Firmware,
+        DsiNand,
+    };
+
+    /// A candidate system file found in the system directory.
+    struct SystemFile {
+        std::string Path;
+        SystemFileType Type = SystemFileType::None;
+        /// Only meaningful if \c Type is \c SystemFileType::Firmware.
+        melonDS::Firmware::FirmwareConsoleType ConsoleType {};
+        int64_t Size = 0;
+        int64_t ModifiedTime = 0;
+        /// The newest of the file's access, modification, and status-change times.
+        int64_t Timestamp = 0;
+    };
+
+    /// Remembers which files in the system directory are firmware or DSi NAND images,
+    /// so that a game can be loaded without opening every file in the system directory.
+    /// The index is saved to the system subdirectory and keyed by each file's path, size, and mtime.
+    class SystemFileIndex {
+    public:
+        /// Loads the index saved by a previous session and re-checks only the files that changed since then.
+        /// If there is no saved index, scans the system directory right away.
+        /// Does nothing if the index was already loaded in this session.
+        void Load() noexcept;
+
+        /// Called on the main thread when a scan finishes.
+        /// The argument is \c true if the list from \c Files changed.
+        using FilesRefreshedFn = std::function<void(bool filesChanged)>;
+
+        /// Scans the system directory in the background if it changed since the index was saved,
+        /// then saves the new index for future sessions.
+        /// Does nothing if the index is up-to-date or a scan is already underway.
+        void Refresh(FilesRefreshedFn onRefreshed) noexcept;
+
+        /// The indexed files, including those with type \c SystemFileType::None.
+        [[nodiscard]] std::span<const SystemFile> Files() const noexcept { return _files; }
+    private:
+        struct ScannedDirectory {
+            std::string Path;
+            int64_t ModifiedTime = 0;
+        };
+
+        struct ScanResult {
+            std::vector<ScannedDirectory> Directories;
+            std::vector<SystemFile> Files;
+        };
+
+        static ScanResult Scan(std::vector<std::string> directories, std::span<const SystemFile> known) noexcept;
+        static std::vector<std::string> Directories() noexcept;
+        bool IsStale() const noexcept;
+        void Save() noexcept;
+
+        std::vector<ScannedDirectory> _directories;
+        std::vector<SystemFile> _files;
+        std::optional<uint32_t> _scanTaskId;
+        FilesRefreshedFn _onRefreshed;
+        bool _loaded = false;
+    };
+}
+
+#endif // MELONDSDS_CONFIG_SYSFILES_HPP
@@ -131,11 +131,60 @@ namespace MelonDsDs {
         Default,
     };
 
+    enum class ResamplerQuality {
+        Fast,
+        Balanced,
+        Best,
+    };
+
     enum class ScreenFilter {
         Nearest,
         Linear,
     };
 
+    enum class ScreenRotationMethod {
+        // Ask the frontend to rotate the screen, and do it in the core if the frontend can't
+        Auto,
+        // Ask the frontend to rotate the screen, and don't rotate it at all if the frontend can't
+        Frontend,
+        // Always rotate the screen in the core, and report the rotated size to the frontend
+        Core,
+    };
+
+    enum class OpenGlStateIsolation {
+        // Skip saving and restoring GL state if the frontend grants a shared context
+        Auto,
+        // Always skip it; the user asserts that the frontend leaves the core's GL state alone
+        Enabled,
+        // Always save and restore the full GL state around each frame
+        Disabled,
+    };
+
+    enum class FrameSkipMode {
+        Disabled,
+        // Skip composition only while the frontend is fast-forwarding
+        FastForward,
+        // As above, and also whenever emulation falls behind real time
+        Auto,
+    };
+
+    enum class LidPowerSaving {
+        Disabled,
+        // Repeat the last frame instead of drawing new ones while the lid is closed
+        SkipFrames,
+        // As above, but also sleep away the rest of each frame's time budget
+        Idle,
+    };
+
+    /// Which of the host's CPU cores a thread may run on.
+    enum class ThreadPlacement {
+        Any,
+        // The fastest cores on a big.LITTLE (or similar) CPU
+        Performance,
+        // The slowest cores on a big.LITTLE (or similar) CPU
+        Efficiency,
+    };
+
 
     enum class ScreenLayout {
         TopBottom = 0,
@@ -175,6 +224,11 @@ namespace MelonDsDs {
         Indirect,
     };
 
+    enum class MpTransport {
+        Netplay,
+        SharedMemory,
+    };
+
     enum class StartTimeMode {
         Real,
         Sync,
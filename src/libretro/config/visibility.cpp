@@ -24,37 +24,119 @@
 #include "tracy.hpp"
 
 using std::optional;
+using std::string_view;
+
+// In the same order as CoreOptionVisibility::Source
+static constexpr std::array VISIBILITY_SOURCE_KEYS = {
+    MelonDsDs::config::audio::MIC_INPUT,
+#if defined(HAVE_OPENGL) || defined(HAVE_OPENGLES)
+    MelonDsDs::config::video::RENDER_MODE,
+    MelonDsDs::config::video::OPENGL_DYNAMIC_RESOLUTION,
+#endif
+    MelonDsDs::config::system::CONSOLE_MODE,
+    MelonDsDs::config::storage::DSI_SD_SAVE_MODE,
+    MelonDsDs::config::storage::HOMEBREW_SAVE_MODE,
+    MelonDsDs::config::screen::SHOW_CURSOR,
+    MelonDsDs::config::screen::NUMBER_OF_SCREEN_LAYOUTS,
+    MelonDsDs::config::screen::SCREEN_LAYOUTS[0],
+    MelonDsDs::config::screen::SCREEN_LAYOUTS[1],
+    MelonDsDs::config::screen::SCREEN_LAYOUTS[2],
+    MelonDsDs::config::screen::SCREEN_LAYOUTS[3],
+    MelonDsDs::config::screen::SCREEN_LAYOUTS[4],
+    MelonDsDs::config::screen::SCREEN_LAYOUTS[5],
+    MelonDsDs::config::screen::SCREEN_LAYOUTS[6],
+    MelonDsDs::config::screen::SCREEN_LAYOUTS[7],
+    MelonDsDs::config::firmware::ENABLE_ALARM,
+#ifdef JIT_ENABLED
+    MelonDsDs::config::cpu::JIT_ENABLE,
+#endif
+#ifdef HAVE_NETWORKING_DIRECT_MODE
+    MelonDsDs::config::network::NETWORK_MODE,
+#endif
+    MelonDsDs::config::time::START_TIME_MODE,
+    MelonDsDs::config::system::DETERMINISTIC,
+};
+
+static_assert(MelonDsDs::config::screen::MAX_SCREEN_LAYOUTS == 8, "Update VISIBILITY_SOURCE_KEYS to list every screen layout");
+
+void MelonDsDs::CoreOptionVisibility::Read(Source source) noexcept {
+    size_t index = static_cast<size_t>(source);
+    static_assert(VISIBILITY_SOURCE_KEYS.size() == SOURCE_COUNT);
+
+    string_view value = retro::get_variable(VISIBILITY_SOURCE_KEYS[index]);
+    if (!VisibilityInitialized || value != _values[index]) {
+        _values[index] = value;
+        _changed.set(index);
+    }
+}
+
+string_view MelonDsDs::CoreOptionVisibility::Value(Source source) const noexcept {
+    return _values[static_cast<size_t>(source)];
+}
+
+bool MelonDsDs::CoreOptionVisibility::Changed(std::initializer_list<Source> sources) const noexcept {
+    for (Source source : sources) {
+        if (_changed.test(static_cast<size_t>(source)))
+            return true;
+    }
+
+    return false;
+}
 
 bool MelonDsDs::CoreOptionVisibility::Update() noexcept {
     ZoneScopedN(TracyFunction);
     using namespace MelonDsDs::config;
-    using retro::environment;
-    using retro::get_variable;
     using retro::set_option_visible;
     bool updated = false;
 
     retro::debug(TracyFunction);
 
+    // Each option is read once; each rule below only runs if one of the options it depends on changed
+    _changed.reset();
+    for (size_t i = 0; i < SOURCE_COUNT; ++i) {
+        Source source = static_cast<Source>(i);
+        if (source < Source::ScreenLayout || source >= Source::EnableAlarm) {
+            // Only the screen layouts that are in use are read (see below)
+            Read(source);
+        }
+    }
+
     // Convention: if an option is not found, show any dependent options
-    bool oldShowMicButtonMode = ShowMicButtonMode;
-    optional<MicInputMode> micInputMode = ParseMicInputMode(get_variable(audio::MIC_INPUT));
-    ShowMicButtonMode = !micInputMode || *micInputMode != MicInputMode::None;
-    if (!VisibilityInitialized || ShowMicButtonMode != oldShowMicButtonMode) {
-        set_option_visible(audio::MIC_INPUT_BUTTON, ShowMicButtonMode);
-        updated = true;
+    if (Changed({Source::MicInput})) {
+        bool oldShowMicButtonMode = ShowMicButtonMode;
+        optional<MicInputMode> micInputMode = ParseMicInputMode(Value(Source::MicInput));
+        ShowMicButtonMode = !micInputMode || *micInputMode != MicInputMode::None;
+        if (!VisibilityInitialized || ShowMicButtonMode != oldShowMicButtonMode) {
+            set_option_visible(audio::MIC_INPUT_BUTTON, ShowMicButtonMode);
+            updated = true;
+        }
     }
 
 #if defined(HAVE_OPENGL) || defined(HAVE_OPENGLES)
     // Show/hide OpenGL core options
-    bool oldShowOpenGlOptions = ShowOpenGlOptions;
     bool oldShowSoftwareRenderOptions = ShowSoftwareRenderOptions;
-    optional<RenderMode> renderer = ParseRenderMode(get_variable(video::RENDER_MODE));
-    ShowOpenGlOptions = !renderer || *renderer == RenderMode::OpenGl;
-    ShowSoftwareRenderOptions = !ShowOpenGlOptions;
-    if (!VisibilityInitialized || ShowOpenGlOptions != oldShowOpenGlOptions) {
-        set_option_visible(video::OPENGL_RESOLUTION, ShowOpenGlOptions);
-        set_option_visible(video::OPENGL_BETTER_POLYGONS, ShowOpenGlOptions);
-        updated = true;
+    if (Changed({Source::RenderMode})) {
+        bool oldShowOpenGlOptions = ShowOpenGlOptions;
+        optional<RenderMode> renderer = ParseRenderMode(Value(Source::RenderMode));
+        ShowOpenGlOptions = !renderer || *renderer == RenderMode::OpenGl;
+        ShowSoftwareRenderOptions = !ShowOpenGlOptions;
+        if (!VisibilityInitialized || ShowOpenGlOptions != oldShowOpenGlOptions) {
+            set_option_visible(video::OPENGL_RESOLUTION, ShowOpenGlOptions);
+            set_option_visible(video::OPENGL_DYNAMIC_RESOLUTION, ShowOpenGlOptions);
+            set_option_visible(video::OPENGL_BETTER_POLYGONS, ShowOpenGlOptions);
+            set_option_visible(video::GPU_COMPOSITION, ShowSoftwareRenderOptions);
+            updated = true;
+        }
+    }
+
+    if (Changed({Source::RenderMode, Source::DynamicResolution})) {
+        bool oldShowDynamicResolutionOptions = ShowDynamicResolutionOptions;
+        optional<bool> dynamicResolution = ParseBoolean(Value(Source::DynamicResolution));
+        ShowDynamicResolutionOptions = ShowOpenGlOptions && (!dynamicResolution || *dynamicResolution);
+        if (!VisibilityInitialized || ShowDynamicResolutionOptions != oldShowDynamicResolutionOptions) {
+            set_option_visible(video::OPENGL_MIN_RESOLUTION, ShowDynamicResolutionOptions);
+            updated = true;
+        }
     }
 #ifdef HAVE_THREADED_RENDERER
     if (!VisibilityInitialized || ShowSoftwareRenderOptions != oldShowSoftwareRenderOptions) {
@@ -62,148 +144,189 @@ bool MelonDsDs::CoreOptionVisibility::Update() noexcept {
         updated = true;
     }
 #endif
+#ifdef HAVE_THREADS
+    if (!VisibilityInitialized || ShowSoftwareRenderOptions != oldShowSoftwareRenderOptions) {
+        set_option_visible(video::PIPELINED_COMPOSITION, ShowSoftwareRenderOptions);
+        set_option_visible(video::PARALLEL_COMPOSITION, ShowSoftwareRenderOptions);
+        set_option_visible(video::PARALLEL_COMPOSITION_THREADS, ShowSoftwareRenderOptions);
+        updated = true;
+    }
+#endif
 
 #else
-    set_option_visible(video::RENDER_MODE, false);
+    if (!VisibilityInitialized) {
+        set_option_visible(video::RENDER_MODE, false);
+    }
 #endif
 
-    bool oldShowDsiOptions = ShowDsiOptions;
-    optional<ConsoleType> consoleType = ParseConsoleType(get_variable(system::CONSOLE_MODE));
-    ShowDsiOptions = !consoleType || *consoleType == ConsoleType::DSi;
-    if (!VisibilityInitialized || ShowDsiOptions != oldShowDsiOptions) {
-        set_option_visible(config::system::FIRMWARE_DSI_PATH, ShowDsiOptions);
-        set_option_visible(config::storage::DSI_NAND_PATH, ShowDsiOptions);
-        set_option_visible(storage::DSI_SD_SAVE_MODE, ShowDsiOptions);
-        updated = true;
-    }
+    if (Changed({Source::ConsoleMode, Source::DsiSdSaveMode})) {
+        optional<ConsoleType> consoleType = ParseConsoleType(Value(Source::ConsoleMode));
 
-    bool oldShowDsiSdCardOptions = ShowDsiSdCardOptions && ShowDsiOptions;
-    optional<bool> dsiSdEnable = ParseBoolean(get_variable(storage::DSI_SD_SAVE_MODE));
-    ShowDsiSdCardOptions = !dsiSdEnable || *dsiSdEnable;
-    if (!VisibilityInitialized || ShowDsiSdCardOptions != oldShowDsiSdCardOptions) {
-        set_option_visible(storage::DSI_SD_READ_ONLY, ShowDsiSdCardOptions);
-        set_option_visible(storage::DSI_SD_SYNC_TO_HOST, ShowDsiSdCardOptions);
-        updated = true;
-    }
+        bool oldShowDsiOptions = ShowDsiOptions;
+        ShowDsiOptions = !consoleType || *consoleType == ConsoleType::DSi;
+        if (!VisibilityInitialized || ShowDsiOptions != oldShowDsiOptions) {
+            set_option_visible(config::system::FIRMWARE_DSI_PATH, ShowDsiOptions);
+            set_option_visible(config::storage::DSI_NAND_PATH, ShowDsiOptions);
+            set_option_visible(storage::DSI_SD_SAVE_MODE, ShowDsiOptions);
+            updated = true;
+        }
 
-    bool oldShowDsOptions = ShowDsOptions;
-    ShowDsOptions = !consoleType || *consoleType == ConsoleType::DS;
-    if (!VisibilityInitialized || ShowDsOptions != oldShowDsOptions) {
-        set_option_visible(config::system::SYSFILE_MODE, ShowDsOptions);
-        set_option_visible(config::system::FIRMWARE_PATH, ShowDsOptions);
-        set_option_visible(config::system::DS_POWER_OK, ShowDsOptions);
-        set_option_visible(system::SLOT2_DEVICE, ShowDsOptions);
-        updated = true;
+        bool oldShowDsiSdCardOptions = ShowDsiSdCardOptions && ShowDsiOptions;
+        optional<bool> dsiSdEnable = ParseBoolean(Value(Source::DsiSdSaveMode));
+        ShowDsiSdCardOptions = !dsiSdEnable || *dsiSdEnable;
+        if (!VisibilityInitialized || ShowDsiSdCardOptions != oldShowDsiSdCardOptions) {
+            set_option_visible(storage::DSI_SD_READ_ONLY, ShowDsiSdCardOptions);
+            set_option_visible(storage::DSI_SD_SYNC_TO_HOST, ShowDsiSdCardOptions);
+            updated = true;
+        }
+
+        bool oldShowDsOptions = ShowDsOptions;
+        ShowDsOptions = !consoleType || *consoleType == ConsoleType::DS;
+        if (!VisibilityInitialized || ShowDsOptions != oldShowDsOptions) {
+            set_option_visible(config::system::SYSFILE_MODE, ShowDsOptions);
+            set_option_visible(config::system::FIRMWARE_PATH, ShowDsOptions);
+            set_option_visible(config::system::DS_POWER_OK, ShowDsOptions);
+            set_option_visible(system::SLOT2_DEVICE, ShowDsOptions);
+            updated = true;
+        }
     }
 
-    bool oldShowHomebrewSdOptions = ShowHomebrewSdOptions;
-    optional<bool> homebrewSdCardEnabled = ParseBoolean(get_variable(storage::HOMEBREW_SAVE_MODE));
-    ShowHomebrewSdOptions = !homebrewSdCardEnabled || *homebrewSdCardEnabled;
-    if (!VisibilityInitialized || ShowHomebrewSdOptions != oldShowHomebrewSdOptions) {
-        set_option_visible(storage::HOMEBREW_READ_ONLY, ShowHomebrewSdOptions);
-        set_option_visible(storage::HOMEBREW_SYNC_TO_HOST, ShowHomebrewSdOptions);
-        updated = true;
+    if (Changed({Source::HomebrewSaveMode})) {
+        bool oldShowHomebrewSdOptions = ShowHomebrewSdOptions;
+        optional<bool> homebrewSdCardEnabled = ParseBoolean(Value(Source::HomebrewSaveMode));
+        ShowHomebrewSdOptions = !homebrewSdCardEnabled || *homebrewSdCardEnabled;
+        if (!VisibilityInitialized || ShowHomebrewSdOptions != oldShowHomebrewSdOptions) {
+            set_option_visible(storage::HOMEBREW_READ_ONLY, ShowHomebrewSdOptions);
+            set_option_visible(storage::HOMEBREW_SYNC_TO_HOST, ShowHomebrewSdOptions);
+            updated = true;
+        }
     }
 
-    bool oldShowCursorTimeout = ShowCursorTimeout;
-    optional<CursorMode> cursorMode = ParseCursorMode(get_variable(screen::SHOW_CURSOR));
-    ShowCursorTimeout = !cursorMode || *cursorMode == CursorMode::Timeout;
-    if (!VisibilityInitialized || ShowCursorTimeout != oldShowCursorTimeout) {
-        set_option_visible(screen::CURSOR_TIMEOUT, ShowCursorTimeout);
-        updated = true;
+    if (Changed({Source::ShowCursor})) {
+        bool oldShowCursorTimeout = ShowCursorTimeout;
+        optional<CursorMode> cursorMode = ParseCursorMode(Value(Source::ShowCursor));
+        ShowCursorTimeout = !cursorMode || *cursorMode == CursorMode::Timeout;
+        if (!VisibilityInitialized || ShowCursorTimeout != oldShowCursorTimeout) {
+            set_option_visible(screen::CURSOR_TIMEOUT, ShowCursorTimeout);
+            updated = true;
+        }
     }
 
-    unsigned oldNumberOfShownScreenLayouts = NumberOfShownScreenLayouts;
-    optional<unsigned> numberOfScreenLayouts = ParseIntegerInRange(get_variable(screen::NUMBER_OF_SCREEN_LAYOUTS), 1u, screen::MAX_SCREEN_LAYOUTS);
-    NumberOfShownScreenLayouts = numberOfScreenLayouts ? *numberOfScreenLayouts : screen::MAX_SCREEN_LAYOUTS;
-    if (!VisibilityInitialized || NumberOfShownScreenLayouts != oldNumberOfShownScreenLayouts) {
-        for (unsigned i = 0; i < screen::MAX_SCREEN_LAYOUTS; ++i) {
-            set_option_visible(screen::SCREEN_LAYOUTS[i], i < NumberOfShownScreenLayouts);
+    if (Changed({Source::NumberOfScreenLayouts})) {
+        unsigned oldNumberOfShownScreenLayouts = NumberOfShownScreenLayouts;
+        optional<unsigned> numberOfScreenLayouts = ParseIntegerInRange(Value(Source::NumberOfScreenLayouts), 1u, screen::MAX_SCREEN_LAYOUTS);
+        NumberOfShownScreenLayouts = numberOfScreenLayouts ? *numberOfScreenLayouts : screen::MAX_SCREEN_LAYOUTS;
+        if (!VisibilityInitialized || NumberOfShownScreenLayouts != oldNumberOfShownScreenLayouts) {
+            for (unsigned i = 0; i < screen::MAX_SCREEN_LAYOUTS; ++i) {
+                set_option_visible(screen::SCREEN_LAYOUTS[i], i < NumberOfShownScreenLayouts);
+            }
+            updated = true;
         }
-        updated = true;
     }
 
-    // Show/hide Hybrid screen options
-    bool oldShowHybridOptions = ShowHybridOptions;
-    bool oldShowVerticalLayoutOptions = ShowVerticalLayoutOptions;
-    bool anyHybridLayouts = false;
-    bool anyVerticalLayouts = false;
+    // Hidden screen layouts don't affect anything, so there's no need to read them
+    bool anyLayoutChanged = false;
     for (unsigned i = 0; i < NumberOfShownScreenLayouts; i++) {
-        optional<MelonDsDs::ScreenLayout> parsedLayout = ParseScreenLayout(get_variable(screen::SCREEN_LAYOUTS[i]));
-        anyHybridLayouts |= !parsedLayout || IsHybridLayout(*parsedLayout) || IsLargeScreenLayout(*parsedLayout);
-        anyVerticalLayouts |= !parsedLayout || LayoutSupportsScreenGap(*parsedLayout);
+        Source layoutSource = static_cast<Source>(static_cast<unsigned>(Source::ScreenLayout) + i);
+        Read(layoutSource);
+        anyLayoutChanged |= Changed({layoutSource});
     }
-    ShowHybridOptions = anyHybridLayouts;
-    ShowVerticalLayoutOptions = anyVerticalLayouts;
 
-    if (!VisibilityInitialized || ShowHybridOptions != oldShowHybridOptions) {
-        set_option_visible(screen::HYBRID_SMALL_SCREEN, ShowHybridOptions);
-        set_option_visible(screen::HYBRID_RATIO, ShowHybridOptions);
-        set_option_visible(screen::HYBRID_SCREEN_FILTERING, ShowHybridOptions);
-        updated = true;
-    }
+    if (anyLayoutChanged || Changed({Source::NumberOfScreenLayouts})) {
+        // Show/hide Hybrid screen options
+        bool oldShowHybridOptions = ShowHybridOptions;
+        bool oldShowVerticalLayoutOptions = ShowVerticalLayoutOptions;
+        bool anyHybridLayouts = false;
+        bool anyVerticalLayouts = false;
+        for (unsigned i = 0; i < NumberOfShownScreenLayouts; i++) {
+            Source layoutSource = static_cast<Source>(static_cast<unsigned>(Source::ScreenLayout) + i);
+            optional<MelonDsDs::ScreenLayout> parsedLayout = ParseScreenLayout(Value(layoutSource));
+            anyHybridLayouts |= !parsedLayout || IsHybridLayout(*parsedLayout) || IsLargeScreenLayout(*parsedLayout);
+            anyVerticalLayouts |= !parsedLayout || LayoutSupportsScreenGap(*parsedLayout);
+        }
+        ShowHybridOptions = anyHybridLayouts;
+        ShowVerticalLayoutOptions = anyVerticalLayouts;
 
-    if (!VisibilityInitialized || ShowVerticalLayoutOptions != oldShowVerticalLayoutOptions) {
-        set_option_visible(screen::SCREEN_GAP, ShowVerticalLayoutOptions);
-        updated = true;
+        if (!VisibilityInitialized || ShowHybridOptions != oldShowHybridOptions) {
+            set_option_visible(screen::HYBRID_SMALL_SCREEN, ShowHybridOptions);
+            set_option_visible(screen::HYBRID_RATIO, ShowHybridOptions);
+            set_option_visible(screen::HYBRID_SCREEN_FILTERING, ShowHybridOptions);
+            updated = true;
+        }
+
+        if (!VisibilityInitialized || ShowVerticalLayoutOptions != oldShowVerticalLayoutOptions) {
+            set_option_visible(screen::SCREEN_GAP, ShowVerticalLayoutOptions);
+            updated = true;
+        }
     }
 
-    bool oldShowAlarm = ShowAlarm;
-    optional<AlarmMode> alarmMode = ParseAlarmMode(get_variable(firmware::ENABLE_ALARM));
-    ShowAlarm = !alarmMode || *alarmMode == AlarmMode::Enabled;
-    if (!VisibilityInitialized || ShowAlarm != oldShowAlarm) {
-        set_option_visible(firmware::ALARM_HOUR, ShowAlarm);
-        set_option_visible(firmware::ALARM_MINUTE, ShowAlarm);
-        updated = true;
+    if (Changed({Source::EnableAlarm})) {
+        bool oldShowAlarm = ShowAlarm;
+        optional<AlarmMode> alarmMode = ParseAlarmMode(Value(Source::EnableAlarm));
+        ShowAlarm = !alarmMode || *alarmMode == AlarmMode::Enabled;
+        if (!VisibilityInitialized || ShowAlarm != oldShowAlarm) {
+            set_option_visible(firmware::ALARM_HOUR, ShowAlarm);
+            set_option_visible(firmware::ALARM_MINUTE, ShowAlarm);
+            updated = true;
+        }
     }
 
 #ifdef JIT_ENABLED
     // Show/hide JIT core options
-    bool oldShowJitOptions = ShowJitOptions;
-    optional<bool> jitEnabled = MelonDsDs::ParseBoolean(get_variable(cpu::JIT_ENABLE));
-    ShowJitOptions = !jitEnabled || *jitEnabled;
-    if (!VisibilityInitialized || ShowJitOptions != oldShowJitOptions) {
-        set_option_visible(cpu::JIT_BLOCK_SIZE, ShowJitOptions);
-        set_option_visible(cpu::JIT_BRANCH_OPTIMISATIONS, ShowJitOptions);
-        set_option_visible(cpu::JIT_LITERAL_OPTIMISATIONS, ShowJitOptions);
+    if (Changed({Source::JitEnable})) {
+        bool oldShowJitOptions = ShowJitOptions;
+        optional<bool> jitEnabled = MelonDsDs::ParseBoolean(Value(Source::JitEnable));
+        ShowJitOptions = !jitEnabled || *jitEnabled;
+        if (!VisibilityInitialized || ShowJitOptions != oldShowJitOptions) {
+            set_option_visible(cpu::JIT_BLOCK_SIZE, ShowJitOptions);
+            set_option_visible(cpu::JIT_AUTO_TUNE, ShowJitOptions);
+            set_option_visible(cpu::JIT_BRANCH_OPTIMISATIONS, ShowJitOptions);
+            set_option_visible(cpu::JIT_LITERAL_OPTIMISATIONS, ShowJitOptions);
 #ifdef HAVE_JIT_FASTMEM
-        set_option_visible(cpu::JIT_FAST_MEMORY, ShowJitOptions);
+            set_option_visible(cpu::JIT_FAST_MEMORY, ShowJitOptions);
 #endif
-        updated = true;
+            updated = true;
+        }
     }
 #endif
 
 #ifdef HAVE_NETWORKING_DIRECT_MODE
-    bool oldShowWifiInterface = ShowWifiInterface;
-    optional<NetworkMode> networkMode = ParseNetworkMode(get_variable(network::NETWORK_MODE));
+    if (Changed({Source::NetworkMode})) {
+        bool oldShowWifiInterface = ShowWifiInterface;
+        optional<NetworkMode> networkMode = ParseNetworkMode(Value(Source::NetworkMode));
 
-    ShowWifiInterface = !networkMode || *networkMode == NetworkMode::Direct;
-    if (!VisibilityInitialized || ShowWifiInterface != oldShowWifiInterface) {
-        set_option_visible(network::DIRECT_NETWORK_INTERFACE, ShowWifiInterface);
-        updated = true;
+        ShowWifiInterface = !networkMode || *networkMode == NetworkMode::Direct;
+        if (!VisibilityInitialized || ShowWifiInterface != oldShowWifiInterface) {
+            set_option_visible(network::DIRECT_NETWORK_INTERFACE, ShowWifiInterface);
+            updated = true;
+        }
     }
 #endif
 
-    optional<StartTimeMode> timeMode = ParseStartTimeMode(get_variable(time::START_TIME_MODE));
-    bool oldShowRelativeTime = ShowRelativeStartTime;
-    ShowRelativeStartTime = !timeMode || *timeMode == StartTimeMode::Relative;
-    if (!VisibilityInitialized || ShowRelativeStartTime != oldShowRelativeTime) {
-        set_option_visible(time::RELATIVE_YEAR_OFFSET, ShowRelativeStartTime);
-        set_option_visible(time::RELATIVE_DAY_OFFSET, ShowRelativeStartTime);
-        set_option_visible(time::RELATIVE_HOUR_OFFSET, ShowRelativeStartTime);
-        set_option_visible(time::RELATIVE_MINUTE_OFFSET, ShowRelativeStartTime);
-        updated = true;
-    }
+    if (Changed({Source::StartTimeMode, Source::Deterministic})) {
+        optional<StartTimeMode> timeMode = ParseStartTimeMode(Value(Source::StartTimeMode));
+        // Deterministic emulation always starts the clock at the absolute time
+        bool deterministic = ParseBoolean(Value(Source::Deterministic)).value_or(false);
+        bool oldShowRelativeTime = ShowRelativeStartTime;
+        ShowRelativeStartTime = !deterministic && (!timeMode || *timeMode == StartTimeMode::Relative);
+        if (!VisibilityInitialized || ShowRelativeStartTime != oldShowRelativeTime) {
+            set_option_visible(time::RELATIVE_YEAR_OFFSET, ShowRelativeStartTime);
+            set_option_visible(time::RELATIVE_DAY_OFFSET, ShowRelativeStartTime);
+            set_option_visible(time::RELATIVE_HOUR_OFFSET, ShowRelativeStartTime);
+            set_option_visible(time::RELATIVE_MINUTE_OFFSET, ShowRelativeStartTime);
+            updated = true;
+        }
 
-    bool oldShowAbsoluteTime = ShowAbsoluteStartTime;
-    ShowAbsoluteStartTime = !timeMode || *timeMode == StartTimeMode::Absolute;
-    if (!VisibilityInitialized || ShowAbsoluteStartTime != oldShowAbsoluteTime) {
-        set_option_visible(time::ABSOLUTE_YEAR, ShowAbsoluteStartTime);
-        set_option_visible(time::ABSOLUTE_MONTH, ShowAbsoluteStartTime);
-        set_option_visible(time::ABSOLUTE_DAY, ShowAbsoluteStartTime);
-        set_option_visible(time::ABSOLUTE_HOUR, ShowAbsoluteStartTime);
-        set_option_visible(time::ABSOLUTE_MINUTE, ShowAbsoluteStartTime);
-        updated = true;
+        bool oldShowAbsoluteTime = ShowAbsoluteStartTime;
+        ShowAbsoluteStartTime = deterministic || !timeMode || *timeMode == StartTimeMode::Absolute;
+        if (!VisibilityInitialized || ShowAbsoluteStartTime != oldShowAbsoluteTime) {
+            set_option_visible(time::ABSOLUTE_YEAR, ShowAbsoluteStartTime);
+            set_option_visible(time::ABSOLUTE_MONTH, ShowAbsoluteStartTime);
+            set_option_visible(time::ABSOLUTE_DAY, ShowAbsoluteStartTime);
+            set_option_visible(time::ABSOLUTE_HOUR, ShowAbsoluteStartTime);
+            set_option_visible(time::ABSOLUTE_MINUTE, ShowAbsoluteStartTime);
+            updated = true;
+        }
     }
 
     VisibilityInitialized = true;
@@ -17,11 +17,25 @@
 #ifndef MELONDSDS_CONFIG_VISIBILITY_HPP
 #define MELONDSDS_CONFIG_VISIBILITY_HPP
 
+#include <array>
+#include <bitset>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+
 #include "constants.hpp"
 
 namespace MelonDsDs {
     struct CoreOptionVisibility {
+        /// Shows or hides options based on the values of the options they depend on.
+        /// Only the options downstream of a changed value are re-evaluated,
+        /// and only the options whose visibility actually changed are sent to the frontend.
+        /// @return \c true if any option's visibility changed.
         bool Update() noexcept;
+
+        /// Makes the next \c Update re-evaluate and send every option's visibility.
+        /// Call after re-registering the core options, since the frontend shows them all again.
+        void Invalidate() noexcept { VisibilityInitialized = false; }
         bool ShowMicButtonMode = true;
         bool ShowHomebrewSdOptions = true;
         bool ShowDsOptions = true;
@@ -40,11 +54,46 @@ namespace MelonDsDs {
 #endif
 #if defined(HAVE_OPENGL) || defined(HAVE_OPENGLES)
         bool ShowOpenGlOptions = true;
+        bool ShowDynamicResolutionOptions = true;
 #endif
 #ifdef HAVE_NETWORKING_DIRECT_MODE
         bool ShowWifiInterface = true;
 #endif
     private:
+        /// The options whose values decide whether other options are visible.
+        enum class Source : unsigned {
+            MicInput,
+#if defined(HAVE_OPENGL) || defined(HAVE_OPENGLES)
+            RenderMode,
+            DynamicResolution,
+#endif
+            ConsoleMode,
+            DsiSdSaveMode,
+            HomebrewSaveMode,
+            ShowCursor,
+            NumberOfScreenLayouts,
+            ScreenLayout, // One per screen layout, up to config::screen::MAX_SCREEN_LAYOUTS
+            EnableAlarm = ScreenLayout + config::screen::MAX_SCREEN_LAYOUTS,
+#ifdef JIT_ENABLED
+            JitEnable,
+#endif
+#ifdef HAVE_NETWORKING_DIRECT_MODE
+            NetworkMode,
+#endif
+            StartTimeMode,
+            Deterministic,
+            Count,
+        };
+
+        static constexpr size_t SOURCE_COUNT = static_cast<size_t>(Source::Count);
+
+        /// Reads the option's current value, and notes whether it changed since the last update.
+        void Read(Source source) noexcept;
+        [[nodiscard]] std::string_view Value(Source source) const noexcept;
+        [[nodiscard]] bool Changed(std::initializer_list<Source> sources) const noexcept;
+
+        std::array<std::string, SOURCE_COUNT> _values {};
+        std::bitset<SOURCE_COUNT> _changed {};
         bool VisibilityInitialized = false;
     };
 }
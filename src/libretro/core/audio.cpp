@@ -0,0 +1,204 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "audio.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+
+#include "constants.hpp"
+#include "environment.hpp"
+#include "tracy.hpp"
+
+// How much each new buffer reading contributes to the output rate,
+// so the rate doesn't jump around with the frontend's reports
+constexpr double RATIO_SMOOTHING = 0.1;
+
+void MelonDsDs::AudioRateControl::Update() noexcept {
+    Update(retro::audio_buffer_status());
+}
+
+void MelonDsDs::AudioRateControl::Update(std::optional<retro::AudioBufferStatus> status) noexcept {
+    ZoneScopedN(TracyFunction);
+
+    if (!status) {
+        // If the frontend doesn't tell us how full its buffer is (or audio is inactive)...
+        _ratio = 1.0;
+        return;
+    }
+
+    if (std::optional<retro_throttle_state> throttle = retro::get_throttle_state()) {
+        if (throttle->mode != RETRO_THROTTLE_NONE && throttle->mode != RETRO_THROTTLE_VSYNC) {
+            // If the frontend is fast-forwarding, rewinding, etc., then the buffer level means nothing
+            _ratio = 1.0;
+            return;
+        }
+    }
+
+    if (std::optional<std::chrono::microseconds> frameTime = retro::last_frame_time(); frameTime && *frameTime > 2 * US_PER_FRAME) {
+        // If the last frame hitched, the drop in the buffer isn't a rate mismatch; don't overcorrect for it
+        return;
+    }
+
+    // Produce more audio when the buffer is less than half full, and less when it's more than half full
+    double fill = std::clamp(status->Occupancy, 0u, 100u) / 100.0;
+    double target = status->UnderrunLikely ? 1.0 + MAX_DEVIATION : 1.0 + (1.0 - 2.0 * fill) * MAX_DEVIATION;
+    _ratio = std::lerp(_ratio, target, RATIO_SMOOTHING);
+    TracyPlot("Audio Rate Ratio", _ratio);
+}
+
+size_t MelonDsDs::AudioRateControl::Process(std::span<const int16_t> input, std::span<int16_t> output) noexcept {
+    ZoneScopedN(TracyFunction);
+
+    size_t inputFrames = input.size() / 2;
+    size_t outputCapacity = output.size() / 2;
+    if (inputFrames == 0) {
+        return 0;
+    }
+
+    // Linearly interpolate between adjacent input frames,
+    // treating the previous batch's last frame as frame -1
+    double step = 1.0 / _ratio;
+    size_t written = 0;
+    while (_position < inputFrames && written < outputCapacity) {
+        auto i = static_cast<size_t>(_position);
+        double t = _position - i;
+        for (size_t channel = 0; channel < 2; ++channel) {
+            double a = i == 0 ? _previous[channel] : input[(i - 1) * 2 + channel];
+            double b = input[i * 2 + channel];
+            output[written * 2 + channel] = static_cast<int16_t>(std::lround(a + (b - a) * t));
+        }
+        ++written;
+        _position += step;
+    }
+
+    _position = std::max(_position - inputFrames, 0.0);
+    _previous = { input[(inputFrames - 1) * 2], input[(inputFrames - 1) * 2 + 1] };
+
+    return written;
+}
+
+void MelonDsDs::AudioRateControl::Reset() noexcept {
+    _ratio = 1.0;
+    _position = 1.0;
+    _previous = {};
+}
+
+template <size_t Channels, size_t Capacity>
+size_t MelonDsDs::AudioRing<Channels, Capacity>::Write(std::span<const int16_t> input) noexcept {
+    ZoneScopedN(TracyFunction);
+
+    size_t write = _writeIndex.load(std::memory_order_relaxed);
+    size_t read = _readIndex.load(std::memory_order_acquire);
+    size_t frames = input.size() / CHANNELS;
+    size_t count = std::min(frames, CAPACITY - (write - read));
+
+    // Copy in at most two pieces, in case the free space wraps around the end of the buffer
+    size_t start = write & MASK;
+    size_t first = std::min(count, CAPACITY - start);
+    std::copy_n(input.begin(), first * CHANNELS, _buffer.begin() + start * CHANNELS);
+    std::copy_n(input.begin() + first * CHANNELS, (count - first) * CHANNELS, _buffer.begin());
+
+    _writeIndex.store(write + count, std::memory_order_release);
+    _framesWritten.fetch_add(count, std::memory_order_relaxed);
+    if (count < frames) {
+        // If the reader has fallen so far behind that the ring is full...
+        _droppedFrames.fetch_add(frames - count, std::memory_order_relaxed);
+    }
+
+    return count;
+}
+
+template <size_t Channels, size_t Capacity>
+size_t MelonDsDs::AudioRing<Channels, Capacity>::Read(std::span<int16_t> output) noexcept {
+    ZoneScopedN(TracyFunction);
+
+    size_t read = _readIndex.load(std::memory_order_relaxed);
+    size_t write = _writeIndex.load(std::memory_order_acquire);
+    size_t fill = write - read;
+
+    // Only the reader records the fill level, so these don't need compare-exchange loops
+    if (fill < _minFill.load(std::memory_order_relaxed)) {
+        _minFill.store(fill, std::memory_order_relaxed);
+    }
+    if (fill > _maxFill.load(std::memory_order_relaxed)) {
+        _maxFill.store(fill, std::memory_order_relaxed);
+    }
+
+    if (fill == 0) {
+        _underruns.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+
+    size_t count = std::min(fill, output.size() / CHANNELS);
+    size_t start = read & MASK;
+    size_t first = std::min(count, CAPACITY - start);
+    std::copy_n(_buffer.begin() + start * CHANNELS, first * CHANNELS, output.begin());
+    std::copy_n(_buffer.begin(), (count - first) * CHANNELS, output.begin() + first * CHANNELS);
+
+    _readIndex.store(read + count, std::memory_order_release);
+    _framesRead.fetch_add(count, std::memory_order_relaxed);
+
+    return count;
+}
+
+template <size_t Channels, size_t Capacity>
+void MelonDsDs::AudioRing<Channels, Capacity>::Skip(size_t frames) noexcept {
+    size_t read = _readIndex.load(std::memory_order_relaxed);
+    size_t write = _writeIndex.load(std::memory_order_acquire);
+    _readIndex.store(read + std::min(frames, write - read), std::memory_order_release);
+}
+
+template <size_t Channels, size_t Capacity>
+void MelonDsDs::AudioRing<Channels, Capacity>::Discard() noexcept {
+    _readIndex.store(_writeIndex.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+template <size_t Channels, size_t Capacity>
+size_t MelonDsDs::AudioRing<Channels, Capacity>::Size() const noexcept {
+    return _writeIndex.load(std::memory_order_acquire) - _readIndex.load(std::memory_order_acquire);
+}
+
+template <size_t Channels, size_t Capacity>
+MelonDsDs::AudioRingStats MelonDsDs::AudioRing<Channels, Capacity>::Stats() const noexcept {
+    size_t minFill = _minFill.load(std::memory_order_relaxed);
+    size_t maxFill = _maxFill.load(std::memory_order_relaxed);
+    return {
+        .Capacity = CAPACITY,
+        .Fill = Size(),
+        .MinFill = minFill > maxFill ? 0 : minFill, // If nothing has been read since the last reset
+        .MaxFill = maxFill,
+        .Underruns = _underruns.load(std::memory_order_relaxed),
+        .DroppedFrames = _droppedFrames.load(std::memory_order_relaxed),
+        .FramesWritten = _framesWritten.load(std::memory_order_relaxed),
+        .FramesRead = _framesRead.load(std::memory_order_relaxed),
+    };
+}
+
+template <size_t Channels, size_t Capacity>
+void MelonDsDs::AudioRing<Channels, Capacity>::ResetStats() noexcept {
+    _minFill.store(CAPACITY, std::memory_order_relaxed);
+    _maxFill.store(0, std::memory_order_relaxed);
+    _underruns.store(0, std::memory_order_relaxed);
+    _droppedFrames.store(0, std::memory_order_relaxed);
+    _framesWritten.store(0, std::memory_order_relaxed);
+    _framesRead.store(0, std::memory_order_relaxed);
+}
+
+template class MelonDsDs::AudioRing<2, 8192>;
+template class MelonDsDs::AudioRing<1, 4096>;
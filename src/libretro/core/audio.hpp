@@ -0,0 +1,163 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#ifndef MELONDSDS_CORE_AUDIO_HPP
+#define MELONDSDS_CORE_AUDIO_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+#include "environment.hpp"
+
+namespace MelonDsDs {
+    /// \brief Nudges the audio output rate to keep the frontend's audio buffer about half full.
+    /// The emulator's output is stretched or squeezed by a fraction of a percent
+    /// (too little to hear as a change in pitch),
+    /// so the frontend can use a much smaller audio buffer without underrunning.
+    class AudioRateControl {
+    public:
+        /// The most that the output rate may differ from the emulator's, as a fraction.
+        static constexpr double MAX_DEVIATION = 0.005;
+
+        /// Recomputes the output rate from the frontend's reported audio buffer state.
+        /// Call once per frame before \c Process.
+        void Update() noexcept;
+
+        /// Recomputes the output rate from the given buffer state,
+        /// e.g. the core's own audio ring when the frontend pulls audio through a callback.
+        void Update(std::optional<retro::AudioBufferStatus> status) noexcept;
+
+        /// Resamples interleaved stereo \c input into \c output at the current rate.
+        /// \returns The number of stereo frames written to \c output.
+        size_t Process(std::span<const int16_t> input, std::span<int16_t> output) noexcept;
+
+        /// Forgets the current rate and the last frame of audio,
+        /// e.g. when rate control is disabled.
+        void Reset() noexcept;
+
+        /// The current number of output frames per input frame.
+        [[nodiscard]] double Ratio() const noexcept { return _ratio; }
+    private:
+        double _ratio = 1.0;
+
+        // Position of the next output frame in the input,
+        // where 0 is the last input frame of the previous batch
+        double _position = 1.0;
+        std::array<int16_t, 2> _previous {};
+    };
+
+    /// A snapshot of an \c AudioRing's fill level and history.
+    struct AudioRingStats {
+        /// Total capacity of the ring, in frames.
+        size_t Capacity;
+
+        /// Frames currently waiting to be read.
+        size_t Fill;
+
+        /// The lowest and highest fill levels seen by the reader since the last reset,
+        /// for deciding how big the ring must be on a given device.
+        size_t MinFill;
+        size_t MaxFill;
+
+        /// Times the reader found the ring empty.
+        uint64_t Underruns;
+
+        /// Frames that the writer dropped because the ring was full.
+        uint64_t DroppedFrames;
+        uint64_t FramesWritten;
+        uint64_t FramesRead;
+    };
+
+    /// A single-producer, single-consumer lock-free ring of interleaved audio,
+    /// for handing samples between two threads that each run at their own pace
+    /// (e.g. the emulator and the frontend's audio thread).
+    /// \tparam Channels Samples per frame.
+    /// \tparam Capacity In frames; a power of two so that indices can wrap with a mask.
+    template <size_t Channels, size_t Capacity>
+    class AudioRing {
+    public:
+        static constexpr size_t CHANNELS = Channels;
+        static constexpr size_t CAPACITY = Capacity;
+
+        /// Copies interleaved \c input into the ring. Only call from the writer's thread.
+        /// \returns The number of frames written;
+        /// anything that doesn't fit is dropped and counted.
+        size_t Write(std::span<const int16_t> input) noexcept;
+
+        /// Copies up to <tt>output.size() / CHANNELS</tt> frames out of the ring.
+        /// Only call from the reader's thread.
+        /// \returns The number of frames read.
+        size_t Read(std::span<int16_t> output) noexcept;
+
+        /// Throws away up to \c frames of the oldest audio waiting to be read,
+        /// e.g. to keep latency down when the writer has gotten ahead.
+        /// Only call from the reader's thread.
+        void Skip(size_t frames) noexcept;
+
+        /// Throws away everything waiting to be read,
+        /// e.g. when the frontend resumes audio after a pause and the backlog is stale.
+        /// Only call from the reader's thread, or while no other thread is using the ring.
+        void Discard() noexcept;
+
+        /// The number of frames waiting to be read.
+        /// From the writer's thread this may be an overestimate, and vice versa.
+        [[nodiscard]] size_t Size() const noexcept;
+
+        [[nodiscard]] AudioRingStats Stats() const noexcept;
+
+        /// Clears the fill history and counters, but not the audio itself.
+        /// Only call while no other thread is using the ring,
+        /// since each counter is updated by the reader or the writer without expecting anyone else to.
+        void ResetStats() noexcept;
+    private:
+        static_assert((CAPACITY & (CAPACITY - 1)) == 0, "AudioRing::CAPACITY must be a power of two");
+        static constexpr size_t MASK = CAPACITY - 1;
+
+        std::array<int16_t, CAPACITY * CHANNELS> _buffer {};
+
+        // Both indices only ever increase, and are wrapped when used;
+        // each is written by exactly one thread.
+        // Kept on separate cache lines so the two threads don't fight over them.
+        alignas(64) std::atomic<size_t> _writeIndex = 0;
+        alignas(64) std::atomic<size_t> _readIndex = 0;
+
+        // Telemetry, written by one thread and read by any
+        alignas(64) std::atomic<size_t> _minFill = CAPACITY;
+        std::atomic<size_t> _maxFill = 0;
+        std::atomic<uint64_t> _underruns = 0;
+        std::atomic<uint64_t> _droppedFrames = 0;
+        std::atomic<uint64_t> _framesWritten = 0;
+        std::atomic<uint64_t> _framesRead = 0;
+    };
+
+    /// Carries the SPU's stereo output to the frontend's audio thread.
+    /// About 250ms at the DS's native rate.
+    using SpuAudioRing = AudioRing<2, 8192>;
+
+    /// Carries mono host microphone audio from the capture thread to the emulator.
+    /// About 90ms at the DS's microphone rate.
+    using MicAudioRing = AudioRing<1, 4096>;
+
+    extern template class AudioRing<2, 8192>;
+    extern template class AudioRing<1, 4096>;
+}
+
+#endif // MELONDSDS_CORE_AUDIO_HPP
@@ -0,0 +1,164 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "benchmark.hpp"
+
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#include <fmt/format.h>
+#include <streams/file_stream.h>
+#include <string/stdstring.h>
+
+#include "environment.hpp"
+#include "tracy.hpp"
+#include "version.hpp"
+
+using std::optional;
+using std::nullopt;
+using std::string;
+
+// Returns the peak resident set size of this process in KiB, if the platform can tell us.
+static optional<size_t> PeakRssKib() noexcept {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters {};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize / 1024;
+    }
+#elif defined(__unix__) || defined(__APPLE__)
+    rusage usage {};
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+        return usage.ru_maxrss / 1024; // macOS reports this in bytes...
+#else
+        return usage.ru_maxrss; // ...but everyone else uses KiB
+#endif
+    }
+#endif
+    return nullopt;
+}
+
+optional<MelonDsDs::Benchmark> MelonDsDs::Benchmark::FromEnvironment() noexcept {
+    const char* framesVar = getenv("MELONDSDS_BENCHMARK_FRAMES");
+    if (string_is_empty(framesVar))
+        return nullopt;
+
+    unsigned frames = 0;
+    const char* framesEnd = framesVar + strlen(framesVar);
+    if (auto [end, ec] = std::from_chars(framesVar, framesEnd, frames); ec != std::errc() || end != framesEnd || frames == 0) {
+        retro::warn("Ignoring invalid MELONDSDS_BENCHMARK_FRAMES value \"{}\"", framesVar);
+        return nullopt;
+    }
+
+    Benchmark benchmark(frames);
+    benchmark._skipAv = getenv("MELONDSDS_BENCHMARK_SKIP_AV") != nullptr;
+
+    if (const char* savestate = getenv("MELONDSDS_BENCHMARK_SAVESTATE"); !string_is_empty(savestate)) {
+        benchmark._savestatePath = savestate;
+    }
+
+    if (const char* report = getenv("MELONDSDS_BENCHMARK_REPORT"); !string_is_empty(report)) {
+        benchmark._reportPath = report;
+    }
+
+    retro::info(
+        "Benchmark mode enabled: {} frames{}{}",
+        frames,
+        benchmark._skipAv ? ", skipping audio/video output" : "",
+        benchmark._savestatePath ? fmt::format(", starting from {}", *benchmark._savestatePath) : ""
+    );
+
+    return benchmark;
+}
+
+void MelonDsDs::Benchmark::Start() noexcept {
+    _started = FrameTimings::clock::now();
+    _finished = *_started;
+}
+
+bool MelonDsDs::Benchmark::EndFrame(const FrameTimings& timings) noexcept {
+    if (Finished())
+        return true;
+
+    for (size_t i = 0; i < FRAME_PHASE_COUNT; ++i) {
+        _totals[i] += timings.Latest(static_cast<FramePhase>(i));
+    }
+
+    ++_frames;
+    _finished = FrameTimings::clock::now();
+    return Finished();
+}
+
+void MelonDsDs::Benchmark::Report(const FrameTimings& timings) const noexcept {
+    ZoneScopedN(TracyFunction);
+    using std::chrono::duration;
+
+    double seconds = duration<double>(_finished - _started.value_or(_finished)).count();
+    double fps = seconds > 0 ? _frames / seconds : 0;
+    optional<size_t> peakRss = PeakRssKib();
+
+    // Averages cover the entire run; min and p99 only cover the most recent window,
+    // since that's all FrameTimings keeps around.
+    fmt::memory_buffer phases;
+    for (size_t i = 0; i < FRAME_PHASE_COUNT; ++i) {
+        auto phase = static_cast<FramePhase>(i);
+        PhaseStatistics stats = timings.Statistics(phase);
+        fmt::format_to(
+            std::back_inserter(phases),
+            R"({}"{}":{{"avg_ms":{:.4f},"min_ms":{:.4f},"p99_ms":{:.4f}}})",
+            i == 0 ? "" : ",",
+            FramePhaseName(phase),
+            _frames ? _totals[i] / _frames : 0.0,
+            stats.Min,
+            stats.P99
+        );
+    }
+
+    string report = fmt::format(
+        R"({{"version":"{}","frames":{},"target_frames":{},"seconds":{:.4f},"fps":{:.2f},"skip_av":{},"peak_rss_kib":{},"phases":{{{}}}}})",
+        MELONDSDS_VERSION,
+        _frames,
+        _targetFrames,
+        seconds,
+        fps,
+        _skipAv,
+        peakRss ? fmt::to_string(*peakRss) : "null",
+        fmt::to_string(phases)
+    );
+
+    retro::info("Benchmark finished: {} frames in {:.3f}s ({:.2f} FPS)", _frames, seconds, fps);
+    if (!_reportPath) {
+        retro::info("Benchmark report: {}", report);
+        return;
+    }
+
+    if (filestream_write_file(_reportPath->c_str(), report.data(), report.size())) {
+        retro::info("Wrote benchmark report to {}", *_reportPath);
+    }
+    else {
+        retro::error("Failed to write benchmark report to {}", *_reportPath);
+        retro::info("Benchmark report: {}", report);
+    }
+}
@@ -0,0 +1,69 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#ifndef MELONDSDS_CORE_BENCHMARK_HPP
+#define MELONDSDS_CORE_BENCHMARK_HPP
+
+#include <array>
+#include <optional>
+#include <string>
+
+#include "timing.hpp"
+
+namespace MelonDsDs {
+    /// Runs the core for a fixed number of frames and reports how fast it went.
+    /// Configured entirely through environment variables so that it can be driven
+    /// by the test harness (or any frontend) without touching the core options:
+    ///
+    /// - \c MELONDSDS_BENCHMARK_FRAMES: Number of frames to run before shutting down. Required.
+    /// - \c MELONDSDS_BENCHMARK_SAVESTATE: Savestate to load before the first frame.
+    /// - \c MELONDSDS_BENCHMARK_SKIP_AV: If set, video and audio aren't sent to the frontend.
+    /// - \c MELONDSDS_BENCHMARK_REPORT: Path to write the JSON report to. Logged if not set.
+    class Benchmark {
+    public:
+        /// Returns \c nullopt if benchmark mode isn't enabled.
+        static std::optional<Benchmark> FromEnvironment() noexcept;
+
+        [[nodiscard]] const std::optional<std::string>& SavestatePath() const noexcept { return _savestatePath; }
+        [[nodiscard]] bool SkipAv() const noexcept { return _skipAv; }
+        [[nodiscard]] bool Started() const noexcept { return _started.has_value(); }
+        [[nodiscard]] bool Finished() const noexcept { return _frames >= _targetFrames; }
+
+        /// Call before the first benchmarked frame, after any savestate is loaded.
+        void Start() noexcept;
+
+        /// Accumulates the timings of the frame that just ended.
+        /// Returns \c true if the benchmark has run for all of its frames.
+        bool EndFrame(const FrameTimings& timings) noexcept;
+
+        /// Writes the report to the configured path (or the log).
+        void Report(const FrameTimings& timings) const noexcept;
+    private:
+        Benchmark(unsigned frames) noexcept : _targetFrames(frames) {}
+
+        unsigned _targetFrames;
+        unsigned _frames = 0;
+        bool _skipAv = false;
+        std::optional<std::string> _savestatePath;
+        std::optional<std::string> _reportPath;
+        std::optional<FrameTimings::clock::time_point> _started;
+        FrameTimings::clock::time_point _finished;
+        std::array<double, FRAME_PHASE_COUNT> _totals {};
+    };
+}
+
+#endif // MELONDSDS_CORE_BENCHMARK_HPP
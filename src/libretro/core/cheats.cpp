@@ -0,0 +1,108 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "cheats.hpp"
+
+#include "tracy.hpp"
+
+static constexpr size_t CHEAT_WORD_DIGITS = 8;
+
+static constexpr bool IsCheatWhitespace(char c) noexcept {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+static constexpr bool IsCheatSeparator(char c) noexcept {
+    return IsCheatWhitespace(c) || c == '+' || c == '-';
+}
+
+static constexpr int HexDigitValue(char c) noexcept {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool MelonDsDs::ParseCheatCode(std::string_view code, std::vector<uint32_t>& out) noexcept {
+    ZoneScopedN(TracyFunction);
+
+    size_t i = 0;
+    while (i < code.size() && IsCheatWhitespace(code[i])) ++i;
+
+    out.clear();
+    out.reserve((code.size() - i) / CHEAT_WORD_DIGITS);
+    while (true) {
+        if (code.size() - i < CHEAT_WORD_DIGITS)
+            return false; // Every word must have exactly 8 digits
+
+        uint32_t word = 0;
+        for (size_t end = i + CHEAT_WORD_DIGITS; i < end; ++i) {
+            int digit = HexDigitValue(code[i]);
+            if (digit < 0)
+                return false;
+
+            word = (word << 4) | static_cast<uint32_t>(digit);
+        }
+        out.push_back(word);
+
+        if (i == code.size())
+            return true;
+
+        while (i < code.size() && IsCheatSeparator(code[i])) ++i;
+        // Trailing separators aren't allowed, so there must be another word after them
+    }
+}
+
+bool MelonDsDs::ValidateCheatCode(std::span<const uint32_t> code) noexcept {
+    ZoneScopedN(TracyFunction);
+
+    if (code.empty() || code.size() % 2 != 0)
+        return false; // Every instruction is a pair of words
+
+    for (size_t i = 0; i < code.size(); i += 2) {
+        uint32_t a = code[i];
+        uint32_t b = code[i + 1];
+        switch (a >> 28) {
+            case 0xC:
+                // C0 (repeat), C4 (offset = here), C5 (counter), C6 (store offset)
+                switch (a >> 24) {
+                    case 0xC0: case 0xC4: case 0xC5: case 0xC6:
+                        break;
+                    default:
+                        return false;
+                }
+                break;
+            case 0xD:
+                if ((a >> 24) > 0xDC)
+                    return false; // D0 through DC are the only data register operations
+                break;
+            case 0xE: {
+                // Followed by b bytes of data to patch in, padded to a whole number of instructions
+                size_t dataWords = ((static_cast<size_t>(b) + 7) / 8) * 2;
+                if (dataWords > code.size() - (i + 2))
+                    return false;
+
+                i += dataWords;
+                break;
+            }
+            default:
+                // 0-B are plain writes, conditions, and offset loads; F is a memory copy
+                break;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,37 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "std/span.hpp"
+
+namespace MelonDsDs {
+    /// Parses an Action Replay code, which is a sequence of 32-bit words written as 8 hex digits each.
+    /// Words may be separated by any mix of whitespace, \c + and \c -, and the code may have leading whitespace.
+    /// @param out Receives the parsed words; its contents are unspecified if parsing fails.
+    /// @return \c true if \c code was a valid cheat code.
+    bool ParseCheatCode(std::string_view code, std::vector<uint32_t>& out) noexcept;
+
+    /// Checks that \c code is a program that melonDS's Action Replay engine can run:
+    /// whole two-word instructions, opcodes it knows, and \c E (patch) blocks that end within the code.
+    /// The engine itself doesn't check any of this, and reads past the end of malformed codes.
+    bool ValidateCheatCode(std::span<const uint32_t> code) noexcept;
+}
@@ -16,7 +16,10 @@
 
 #include "core.hpp"
 
+#include <algorithm>
 #include <charconv>
+#include <ctime>
+#include <thread>
 #include <DSi.h>
 #include <GPU3D_OpenGL.h>
 #include <GPU3D_Soft.h>
@@ -24,21 +27,31 @@
 #include <retro_assert.h>
 
 #include <NDS.h>
+#include <fatfs/ff.h>
 #include <compat/strl.h>
 #include <file/file_path.h>
+#include <streams/file_stream.h>
 #include <string/stdstring.h>
 
 #include "console/dsi.hpp"
 #include "constants.hpp"
+#include "../arena.hpp"
 #include "../config/console.hpp"
 #include "../exceptions.hpp"
 #include "../format.hpp"
 #include "../info.hpp"
+#include "../libretro.hpp"
 #include "../microphone.hpp"
 #include "../message/error.hpp"
+#include "../platform/file.hpp"
+#include "../platform/placement.hpp"
 #include "../render/render.hpp"
 #include "../retro/task_queue.hpp"
+#include "../tracy/memory.hpp"
 #include "render/software.hpp"
+#include "cheats.hpp"
+#include "savestate.hpp"
+#include "startup.hpp"
 
 #if defined(HAVE_OPENGL) || defined(HAVE_OPENGLES)
 #include "../render/opengl.hpp"
@@ -49,6 +62,33 @@ using namespace melonDS::DSi_NAND;
 
 constexpr size_t DS_MEMORY_SIZE = 0x400000;
 constexpr size_t DSI_MEMORY_SIZE = 0x1000000;
+
+// How much audio the frontend's audio thread takes from the ring per callback (at most), in stereo frames
+constexpr size_t AUDIO_CALLBACK_FRAMES = 512;
+
+// How much silence to send when the ring is empty; short, to add as little latency as possible
+constexpr size_t AUDIO_UNDERRUN_FRAMES = 64;
+
+// How full dynamic rate control tries to keep the ring, in stereo frames (roughly two frames' worth)
+constexpr size_t AUDIO_RING_TARGET_FRAMES = 1024;
+static_assert(2 * AUDIO_RING_TARGET_FRAMES <= MelonDsDs::SpuAudioRing::CAPACITY);
+
+// How many frames to draw after the lid closes before repeating the last one;
+// a few, so that pipelined composition has presented the blank screen by then
+constexpr unsigned LID_CLOSED_PRESENTED_FRAMES = 3;
+
+// The most frames that frameskip will skip in a row, so that the screen never freezes for long
+constexpr unsigned AUTO_FRAMESKIP_MAX_SKIPPED_FRAMES = 3;
+
+// While fast-forwarding, the frontend won't show most frames anyway
+constexpr unsigned FAST_FORWARD_MAX_SKIPPED_FRAMES = 7;
+
+// Below this audio buffer occupancy (in percent), auto frameskip considers the core to be falling behind
+constexpr unsigned FRAMESKIP_AUDIO_THRESHOLD = 25;
+
+// How much of the frame budget to leave unslept while the lid is closed, to absorb the OS's wakeup latency
+constexpr std::chrono::microseconds LID_CLOSED_IDLE_SLACK {2000};
+
 static const char* const INTERNAL_ERROR_MESSAGE =
     "An internal error occurred with melonDS DS. "
     "Please contact the developer with the log file.";
@@ -68,18 +108,70 @@ date::local_seconds LocalTime() noexcept {
     return static_cast<local_days>(date) + time;
 }
 
+// Most background work waits on I/O, so a few workers are enough even on machines with many cores
+static unsigned ThreadPoolSize() noexcept {
+    if (const char* sizeVar = getenv("MELONDSDS_THREAD_POOL_SIZE"); !string_is_empty(sizeVar)) {
+        unsigned size = 0;
+        const char* sizeEnd = sizeVar + strlen(sizeVar);
+        if (auto [end, ec] = std::from_chars(sizeVar, sizeEnd, size); ec == std::errc() && end == sizeEnd && size <= 64) {
+            return size; // 0 means "run background work inline"
+        }
+
+        retro::warn("Ignoring invalid MELONDSDS_THREAD_POOL_SIZE value \"{}\"", sizeVar);
+    }
+
+    unsigned cores = std::thread::hardware_concurrency();
+    return std::clamp(cores > 1 ? cores - 1 : 1u, 2u, 6u);
+}
+
+// A comma-separated list of CPUs to pin the workers to, e.g. "2,3"
+static std::vector<unsigned> ThreadPoolAffinity() noexcept {
+    std::vector<unsigned> cpus;
+    const char* affinityVar = getenv("MELONDSDS_THREAD_POOL_AFFINITY");
+    if (string_is_empty(affinityVar))
+        return cpus;
+
+    std::string_view affinity(affinityVar);
+    while (!affinity.empty()) {
+        std::string_view cpu = affinity.substr(0, affinity.find(','));
+        unsigned index = 0;
+        if (auto [end, ec] = std::from_chars(cpu.data(), cpu.data() + cpu.size(), index); ec != std::errc() || end != cpu.data() + cpu.size()) {
+            retro::warn("Ignoring invalid MELONDSDS_THREAD_POOL_AFFINITY value \"{}\"", affinityVar);
+            return {};
+        }
+
+        cpus.push_back(index);
+        affinity.remove_prefix(std::min(cpu.size() + 1, affinity.size()));
+    }
+
+    return cpus;
+}
+
+MelonDsDs::CoreState::CoreState() noexcept : _threadPool(ThreadPoolSize(), ThreadPoolAffinity()) {
+}
+
 MelonDsDs::CoreState::~CoreState() noexcept {
     ZoneScopedN(TracyFunction);
+    if (_benchmark) {
+        _benchmark->Report(_frameTimings);
+        retro::set_av_output_suppressed(false);
+    }
+
     Console = nullptr;
     melonDS::NDS::Current = nullptr;
+#ifdef HAVE_TRACE_RECORDER
+    trace::UninstallCrashHandler();
+#endif
 }
 
 retro_system_av_info MelonDsDs::CoreState::GetSystemAvInfo(RenderMode renderer) const noexcept {
+    retro_game_geometry geometry = _screenLayout.Geometry(renderer);
+    _reportedMaxSize = glm::uvec2(geometry.max_width, geometry.max_height);
     return {
-        .geometry = _screenLayout.Geometry(renderer),
+        .geometry = geometry,
         .timing {
             .fps = FPS,
-            .sample_rate = SAMPLE_RATE,
+            .sample_rate = _resampler ? static_cast<double>(_resampler->OutputRate()) : SAMPLE_RATE,
         },
     };
 }
@@ -98,6 +190,74 @@ retro_system_av_info MelonDsDs::CoreState::GetSystemAvInfo() const noexcept {
 }
 
 void MelonDsDs::CoreState::UnloadGame() noexcept {
+    _frameTimings.Log();
+
+#ifdef HAVE_MEMORY_ACCOUNTING
+    int64_t heapBytes = 0;
+    for (size_t i = 0; i < MEMORY_TAG_COUNT; ++i) {
+        // Logged while the console still exists, so its share isn't zero
+        MemoryTag tag = static_cast<MemoryTag>(i);
+        MemoryUsage usage = GetMemoryUsage(tag);
+        heapBytes += usage.Bytes;
+        retro::info(
+            "{} memory: {} bytes in {} allocations (peak {} bytes)",
+            GetMemoryTagName(tag), usage.Bytes, usage.Allocations, usage.PeakBytes
+        );
+    }
+    retro::info("Private heap memory: {} bytes in total", heapBytes);
+#endif
+    memory::SharedMappingUsage mapped = memory::GetSharedMappingUsage();
+    retro::info(
+        "Shared file mappings: {} bytes in {} mappings ({} resident bytes shared with other processes, {} resident in this one only)",
+        mapped.MappedBytes, mapped.Mappings, mapped.SharedBytes, mapped.PrivateBytes
+    );
+
+    if (_inputRecording) {
+        _inputRecording->Save();
+        _inputRecording = nullopt;
+    }
+
+    if (_frameHashes) {
+        // (Any frames still being read back from the GPU are dropped)
+        _frameHashes->Finish();
+        _frameHashes = nullopt;
+        _renderState.SetFrameReadbackEnabled(false);
+    }
+
+    _scratchSavestate = nullptr;
+#ifdef HAVE_ZLIB
+    _rewind.SetCapacity(0); // The next game's config decides whether to allocate it again
+#endif
+
+    // Queue any unsaved SRAM or firmware changes, then wait for them to hit the disk
+    FlushSaveData();
+    RumbleStop();
+    _scheduler.Clear();
+    _saveWriter.Wait();
+
+    if (sram::SaveJournal* journal = _gbaSaveManager ? _gbaSaveManager->Journal() : nullptr; journal && _gbaSaveInfo) {
+        // If the final GBA SRAM write succeeded, the journal has nothing left to recover
+        if (_saveWriter.IsWritten(_gbaSaveInfo->GetPath())) {
+            journal->FinishCompaction();
+        }
+    }
+
+#ifdef HAVE_MP_SHARED_MEMORY
+    StopSharedMemoryMp();
+#endif
+
+    if (_audioCallbackRegistered) {
+        AudioRingStats stats = _audioRing.Stats();
+        retro::info(
+            "Audio ring: {}/{} frames at unload, fill range {}-{}, {} underruns, {} frames dropped",
+            stats.Fill, stats.Capacity, stats.MinFill, stats.MaxFill, stats.Underruns, stats.DroppedFrames
+        );
+
+        // The frontend forgets the audio callback along with the game.
+        // Its audio thread may still be finishing a call, so the ring is reset when the next game registers it.
+        _audioCallbackRegistered = false;
+    }
+
     if (Console && Console->IsRunning()) {
         // If the NDS wasn't already stopped due to some internal event...
         Console->Stop();
@@ -118,18 +278,37 @@ void MelonDsDs::CoreState::UnloadGame() noexcept {
         }
     }
 
+    if (_measuredSavestateSize && Console) {
+        // If a savestate didn't fit in the size we settled on at load time, fix the cache for next time
+        CacheSavestateSize(GetSavestateSizeKey(*Console), *_measuredSavestateSize);
+    }
+    _savestateSize = std::nullopt;
+    _measuredSavestateSize = std::nullopt;
+
     Console = nullptr;
     melonDS::NDS::Current = nullptr;
+    _consoleConfig = std::nullopt;
+    _resampler = std::nullopt;
+    _gameKey = nullopt;
+    _jitProfile = nullopt;
+    _gamePreset = nullopt;
+    _jitTuner = nullopt;
+    _cheats.clear();
+    _cheatsChanged = false;
+
+    // Now that the console's closed all of its files
+    LogFileIoStats();
+    ClearLocalFileCache();
+
+    // The frontend may free the content data after this (if we didn't copy it)
+    _ndsInfo = std::nullopt;
+    _gbaInfo = std::nullopt;
 }
 
 void MelonDsDs::CoreState::Run() noexcept {
     ZoneScopedN(TracyFunction);
-
-    if (_deferredInitializationPending && !RunDeferredInitialization()) [[unlikely]] {
-        // If we needed to run any extra setup, but that process failed...
-        retro::shutdown();
-        return;
-    }
+    // Resets the frame arena on every way out of this function
+    FrameScope frame;
 
     if (_messageScreen) [[unlikely]] {
         RenderErrorScreen();
@@ -139,12 +318,44 @@ void MelonDsDs::CoreState::Run() noexcept {
     retro_assert(Console != nullptr);
     melonDS::NDS& nds = *Console;
 
+    if (_cheatsChanged) [[unlikely]] {
+        PublishCheats();
+    }
+
+#ifdef HAVE_TRACE_RECORDER
+    if (Config.SaveTraceRequested()) [[unlikely]] {
+        SaveTrace();
+    }
+#endif
+
+    if (std::optional<std::chrono::microseconds> frameTime = retro::last_frame_time()) {
+        // How long the frontend says passed since the last frame, including time spent outside the core
+        TracyPlot("Frontend Frame Time (ms)", std::chrono::duration<double, std::milli>(*frameTime).count());
+    }
+
     if (retro::is_variable_updated()) [[unlikely]] {
         // If any settings have changed...
         retro::debug("At least one setting has changed; updating now");
-        ParseConfig(Config);
-        ApplyConfig(Config);
-        UpdateConsole(Config, nds);
+        ReparseConfig();
+#ifdef HAVE_JIT
+        if (_jitTuner && _jitTuner->Started()) {
+            // If we're partway through tuning, keep the block size that's being measured
+            Config.SetMaxBlockSize(_jitTuner->Current());
+        }
+#endif
+
+        // Only rebuild what the changed options affect, so that a cosmetic tweak doesn't cause a hitch
+        ConfigSubsystem changed = _optionChanges.Update();
+        ApplyConfig(Config, changed);
+        if (changed & ConfigSubsystem::Console) {
+            UpdateConsole(Config, nds);
+        }
+    }
+
+    if (Config.EmulationThreadPlacement() != _emulationThreadPlacement) [[unlikely]] {
+        // Done here rather than in ApplyConfig, as the frontend may load content on a different thread
+        placement::PlaceEmulationThread(Config.EmulationThreadPlacement());
+        _emulationThreadPlacement = Config.EmulationThreadPlacement();
     }
 
     if (!_ndsSramInstalled) [[unlikely]] {
@@ -152,47 +363,491 @@ void MelonDsDs::CoreState::Run() noexcept {
         _ndsSramInstalled = true;
     }
 
-    if (_renderState.Ready()) [[likely]] {
+    if (_renderState.Ready(nds)) [[likely]] {
         // If the global state needed for rendering is ready...
-        _inputState.Update(Config, _screenLayout);
-        _inputState.Apply(nds, _screenLayout, _micState, Config);
-        std::array<int16_t, 735> buffer {};
-        _micState.Read(buffer);
-        nds.MicInputFrame(buffer.data(), buffer.size());
+        if (_inputRecording && !_inputRecording->Started()) [[unlikely]] {
+            // Before the benchmark starts, so that loading the replay's savestate isn't timed
+            StartInputRecording(nds);
+        }
+
+        if (_benchmark && !_benchmark->Started()) [[unlikely]] {
+            StartBenchmark();
+        }
+
+        FrameTimings::clock::time_point frameStart = FrameTimings::clock::now();
+
+        if (_syncClock && !_inputRecording) {
+            // (Recordings pin the RTC instead, so that replays see the same time)
+            SetConsoleTime(nds, LocalTime());
+        }
+
+        // Wait for the GPU if the CPU is too far ahead of it,
+        // before reading input so that it's as fresh as possible
+        _renderState.BeginFrame(Config);
+
+        // Input is polled as late as melonDS allows;
+        // it has no hook for reading input partway through NDS::RunFrame,
+        // so anything between here and RunFrame is added input latency.
+        // Keep it to what depends on this frame's input (e.g. the mic button).
+        {
+            ScopedPhaseTimer timer(_frameTimings, FramePhase::Input);
+            _inputState.Update(Config, _screenLayout);
+#ifdef HAVE_ZLIB
+            if (_inputState.RewindButtonDown() && Config.RewindBufferSize() > 0) [[unlikely]] {
+                // Before the new input is applied, so that this frame is played from the rewound state
+                StepBackRewind();
+            }
+#endif
+            _inputState.Apply(nds, _screenLayout, _micState, Config);
+            if (_inputRecording) [[unlikely]] {
+                UpdateInputRecording(nds);
+            }
+        }
+
+        {
+            ScopedPhaseTimer timer(_frameTimings, FramePhase::Microphone);
+            std::span<int16_t> samples = _micState.Read();
+            nds.MicInputFrame(samples.data(), samples.size());
+        }
+
+        // NDS::RunFrame renders the Nintendo DS state to a framebuffer,
+        // which is then drawn to the screen by _renderState.Render
+        {
+            ZoneScopedN("NDS::RunFrame");
+            ScopedPhaseTimer timer(_frameTimings, FramePhase::RunFrame);
+            nds.RunFrame();
+        }
+
+        if (_mpState.IsReady()) {
+            // If we're in a local wireless session, send whatever's left in the batch...
+            _mpState.Flush();
+            _mpState.UpdateStats();
+
+            // ...and see how much of RunFrame was spent waiting on other players
+            std::chrono::steady_clock::duration waited = _mpState.TakeWaitTime();
+            _frameTimings.Record(FramePhase::MpWait, waited);
+            TracyPlot("MP Wait Time (ms)", std::chrono::duration<double, std::milli>(waited).count());
+        }
 
         if (_screenLayout.Dirty()) {
             // If the active screen layout has changed (either by settings or by hotkey)...
+            // (done after RunFrame, since the emulated frame doesn't depend on it;
+            // this frame's touch input was already mapped with the old layout, as before)
 
             // Apply the new screen layout
+            // (if only the layout index changed, this just selects the precomputed geometry)
             _screenLayout.Update();
 
-            RenderMode renderer = Console->GPU.GetRenderer3D().Accelerated ? RenderMode::OpenGl : RenderMode::Software;
+            // (The OpenGL presenter may briefly show the software renderer's output while it warms up,
+            // so ask the render state rather than the 3D renderer)
+            RenderMode renderer = _renderState.GetRenderMode().value_or(RenderMode::Software);
             // And update the geometry
-            if (!retro::set_geometry(_screenLayout.Geometry(renderer))) {
+            retro_game_geometry geometry = _screenLayout.Geometry(renderer);
+            if (geometry.max_width > _reportedMaxSize.x || geometry.max_height > _reportedMaxSize.y) [[unlikely]] {
+                // If the layout options changed such that the frontend's framebuffer is too small...
+                // (switching between the configured layouts never does this, see ScreenLayoutData::Geometry)
+                retro::debug(
+                    "Screen layouts need up to {}x{}, more than the {}x{} we reported; updating system AV info",
+                    geometry.max_width, geometry.max_height, _reportedMaxSize.x, _reportedMaxSize.y
+                );
+                if (!retro::set_system_av_info(GetSystemAvInfo(renderer))) {
+                    retro::warn("Failed to update system AV info after screen layout change");
+                }
+            }
+            else if (!retro::set_geometry(geometry)) {
                 retro::warn("Failed to update geometry after screen layout change");
             }
+            TracyPlot("Geometry Width", static_cast<int64_t>(geometry.base_width));
+            TracyPlot("Geometry Height", static_cast<int64_t>(geometry.base_height));
+
+            if (_screenLayout.Generation() != _refreshedLayoutGeneration) {
+                // If the layouts themselves changed (rather than which one is active),
+                // the renderer may need more than the new layout's vertices
+                _renderState.RequestRefresh();
+                _refreshedLayoutGeneration = _screenLayout.Generation();
+            }
+        }
+
+        LidPowerSaving powerSaving = Config.LidPowerSaving();
+        _lidClosedFrames = nds.IsLidClosed() && powerSaving != LidPowerSaving::Disabled ? _lidClosedFrames + 1 : 0;
+        bool lidDupe = _lidClosedFrames > LID_CLOSED_PRESENTED_FRAMES;
+        bool dupe = !_frameHashes && retro::can_dupe() && (lidDupe || ShouldSkipFrame());
+
+        bool audioRendered = false;
+        bool ranAhead = false;
+        FrameTimings::clock::duration runAheadTime {};
+        if (!dupe && Config.RunAheadFrames() > 0 && CanRunAhead()) [[unlikely]] {
+            // If this frame will be shown, and we want to show a later one in its place...
+            {
+                // The real frame's audio has to go out before the hidden frames add their own
+                ScopedPhaseTimer timer(_frameTimings, FramePhase::Audio);
+                RenderAudio(nds);
+                audioRendered = true;
+            }
 
-            _renderState.RequestRefresh();
+            FrameTimings::clock::time_point runAheadStart = FrameTimings::clock::now();
+            ranAhead = RunAhead(nds, Config.RunAheadFrames());
+            runAheadTime = FrameTimings::clock::now() - runAheadStart;
         }
 
-        if (_syncClock) {
-            SetConsoleTime(nds, LocalTime());
+        {
+            ScopedPhaseTimer timer(_frameTimings, FramePhase::Render);
+            if (dupe) [[unlikely]] {
+                // The blank screen is already on display (or frameskip kicked in),
+                // so the frontend can keep showing the last frame
+                retro::video_refresh(nullptr, _screenLayout.OutputWidth(), _screenLayout.OutputHeight(), 0);
+            }
+            else {
+                _renderState.Render(nds, _inputState, Config, _screenLayout);
+                _skippedFrames = 0;
+            }
+        }
+
+        if (ranAhead) [[unlikely]] {
+            // Now that the last hidden frame is on screen, go back to the real one
+            FrameTimings::clock::time_point rollbackStart = FrameTimings::clock::now();
+            EndRunAhead(nds);
+            runAheadTime += FrameTimings::clock::now() - rollbackStart;
+            _frameTimings.Record(FramePhase::RunAhead, runAheadTime);
+            TracyPlot("Run-Ahead Time (ms)", std::chrono::duration<double, std::milli>(runAheadTime).count());
+        }
+        startup::FirstFrame();
+
+        if (_frameHashes) [[unlikely]] {
+            _renderState.TakeFrameChecksums(_frameChecksums);
+            _frameHashes->Update(_frameChecksums);
+            _frameChecksums.clear();
+        }
+
+        if (!audioRendered) {
+            ScopedPhaseTimer timer(_frameTimings, FramePhase::Audio);
+            RenderAudio(*Console);
         }
 
-        // NDS::RunFrame renders the Nintendo DS state to a framebuffer,
-        // which is then drawn to the screen by _renderState.Render
         {
-            ZoneScopedN("NDS::RunFrame");
-            nds.RunFrame();
+            ScopedPhaseTimer timer(_frameTimings, FramePhase::Tasks);
+            _scheduler.Tick();
+            retro::task::check();
         }
 
-        _renderState.Render(nds, _inputState, Config, _screenLayout);
-        RenderAudio(*Console);
+        FrameTimings::clock::duration frameTime = FrameTimings::clock::now() - frameStart;
+        _frameTimings.Record(FramePhase::Total, frameTime);
+        _frameTimings.EndFrame();
+        if (_skippedFrames == 0) {
+            _lastComposedFrameTime = _frameTimings.Latest(FramePhase::Total);
+        }
 
-        retro::task::check();
+        if (_lidClosedFrames > 0 && powerSaving == LidPowerSaving::Idle && frameTime < US_PER_FRAME) [[unlikely]] {
+            IdleWhileLidClosed(frameTime);
+        }
+
+#ifdef HAVE_JIT
+        if (_jitTuner) [[unlikely]] {
+            UpdateJitTuner(nds);
+        }
+#endif
+
+        if (_benchmark && _benchmark->EndFrame(_frameTimings)) [[unlikely]] {
+            // If we've run all the frames that the benchmark asked for...
+            retro::shutdown();
+        }
     }
 }
 
+bool MelonDsDs::CoreState::ShouldSkipFrame() noexcept {
+    FrameSkipMode mode = Config.FrameSkip();
+    if (mode == FrameSkipMode::Disabled) {
+        return false;
+    }
+
+    unsigned limit = 0;
+    if (retro::is_fastforwarding().value_or(false)) {
+        limit = FAST_FORWARD_MAX_SKIPPED_FRAMES;
+    }
+    else if (mode == FrameSkipMode::Auto) {
+        std::optional<unsigned> audioFill = AudioBufferFill();
+        std::optional<std::chrono::microseconds> frameTime = retro::last_frame_time();
+        float budgetMs = std::chrono::duration<float, std::milli>(US_PER_FRAME).count();
+        // Skipping only helps if the core (rather than the frontend or a vsync wait) is why frames are late
+        bool coreIsSlow = _lastComposedFrameTime > budgetMs * 0.75f;
+        bool frameIsLate = frameTime && *frameTime > US_PER_FRAME * 11 / 10;
+        bool audioIsStarving = audioFill && *audioFill < FRAMESKIP_AUDIO_THRESHOLD;
+        if (coreIsSlow && (frameIsLate || audioIsStarving)) {
+            limit = AUTO_FRAMESKIP_MAX_SKIPPED_FRAMES;
+        }
+    }
+
+    if (_skippedFrames >= limit) {
+        return false;
+    }
+
+    _skippedFrames++;
+    TracyPlot("Skipped Frames", static_cast<int64_t>(_skippedFrames));
+    return true;
+}
+
+bool MelonDsDs::CoreState::CanRunAhead() const noexcept {
+    return !_mpState.IsReady() && !_inputRecording && !_frameHashes && !_benchmark;
+}
+
+bool MelonDsDs::CoreState::RunAhead(melonDS::NDS& nds, unsigned frames) noexcept {
+    ZoneScopedN(TracyFunction);
+    size_t size = SerializeSize();
+    if (size == 0) {
+        // If this console can't be snapshotted (e.g. in DSi mode)...
+        return false;
+    }
+
+    // Straight into a buffer we keep around, without the bookkeeping that the frontend's savestates need
+    _runAheadState.resize(size);
+    melonDS::Savestate snapshot(_runAheadState.data(), _runAheadState.size(), true);
+    if (!nds.DoSavestate(&snapshot) || snapshot.Error) {
+        retro::error("Failed to snapshot the console for run-ahead");
+        return false;
+    }
+
+    for (unsigned i = 0; i < frames; ++i) {
+        // The hidden frames see the same input as the real one,
+        // but don't read the microphone, draw the screens, deliver audio, or run tasks
+        ZoneScopedN("NDS::RunFrame (Run-Ahead)");
+        nds.RunFrame();
+    }
+
+    return true;
+}
+
+void MelonDsDs::CoreState::EndRunAhead(melonDS::NDS& nds) noexcept {
+    ZoneScopedN(TracyFunction);
+    melonDS::Savestate snapshot(_runAheadState.data(), _runAheadState.size(), false);
+
+    // The restored SRAM is usually what we already have, so don't flush it again
+    _unserializing = true;
+    bool restored = !snapshot.Error && nds.DoSavestate(&snapshot) && !snapshot.Error;
+    _unserializing = false;
+    if (!restored) [[unlikely]] {
+        retro::error("Failed to roll back from run-ahead");
+    }
+
+    // The real frame's audio already went out, so whatever the hidden frames produced can go
+    int16_t discarded[0x1000];
+    while (int outputSize = nds.SPU.GetOutputSize()) {
+        int length = std::min(outputSize, static_cast<int>(sizeof(discarded) / (2 * sizeof(int16_t))));
+        if (nds.SPU.ReadOutput(discarded, length) == 0)
+            break;
+    }
+}
+
+void MelonDsDs::CoreState::IdleWhileLidClosed(FrameTimings::clock::duration frameTime) noexcept {
+    ZoneScopedN(TracyFunction);
+    if (_benchmark || _mpState.IsReady() || retro::is_fastforwarding().value_or(false)) {
+        // Don't throttle anything that's meant to run flat out or in lockstep with other players
+        return;
+    }
+
+    FrameTimings::clock::duration idle = US_PER_FRAME - LID_CLOSED_IDLE_SLACK - frameTime;
+    if (idle > FrameTimings::clock::duration::zero()) {
+        std::this_thread::sleep_for(idle);
+    }
+}
+
+void MelonDsDs::CoreState::StartBenchmark() noexcept {
+    ZoneScopedN(TracyFunction);
+    retro_assert(_benchmark);
+
+    if (const optional<string>& path = _benchmark->SavestatePath()) {
+        // If the benchmark should start from a savestate...
+        if (_inputRecording && _inputRecording->SavestatePath()) {
+            // (Loading another one would undo the replay's)
+            retro::warn("Ignoring benchmark savestate {}, since the input recording starts from its own", *path);
+        }
+        else if (!LoadSavestateFile(*path)) {
+            retro::error("Failed to load benchmark savestate {}; starting from boot instead", *path);
+        }
+    }
+
+    _frameTimings.Reset();
+    _benchmark->Start();
+}
+
+std::chrono::system_clock::time_point ToSystemTime(std::chrono::local_seconds time) noexcept {
+    return std::chrono::system_clock::from_time_t(time.time_since_epoch().count());
+}
+
+void MelonDsDs::CoreState::StartInputRecording(melonDS::NDS& nds) noexcept {
+    ZoneScopedN(TracyFunction);
+    retro_assert(_inputRecording);
+
+    if (const optional<string>& path = _inputRecording->SavestatePath()) {
+        if (!LoadSavestateFile(*path)) {
+            retro::error("Failed to load input recording savestate {}; starting from boot instead", *path);
+        }
+    }
+
+    _inputRecording->Start(ConfiguredStartTime(), Config.MicInputMode());
+    if (_inputRecording->Replaying() && _inputRecording->RecordedMicInputMode() != Config.MicInputMode()) {
+        retro::warn("This input was recorded with a different microphone input mode; the replay may diverge");
+    }
+
+    if (Config.MicInputMode() == MicInputMode::HostMic) {
+        retro::warn("The host microphone's input isn't recorded; the replay may diverge");
+    }
+
+    // Pinned every time (rather than just for replays) in case the recording was started from a savestate
+    SetConsoleTime(nds, _inputRecording->StartTime());
+    retro::info(
+        "{} input with the RTC pinned to {:%F %T}",
+        _inputRecording->Replaying() ? "Replaying" : "Recording",
+        ToSystemTime(_inputRecording->StartTime())
+    );
+}
+
+void MelonDsDs::CoreState::UpdateInputRecording(melonDS::NDS& nds) noexcept {
+    retro_assert(_inputRecording);
+
+    if (!_inputRecording->Replaying()) {
+        glm::uvec2 touch = _inputState.ConsoleTouch();
+        RecordedInput input {
+            .Buttons = _inputState.ConsoleButtons(),
+            .TouchX = _inputState.IsTouching() ? static_cast<uint8_t>(touch.x) : uint8_t(0),
+            .TouchY = _inputState.IsTouching() ? static_cast<uint8_t>(touch.y) : uint8_t(0),
+            .Flags = static_cast<uint8_t>(
+                (_inputState.IsTouching() ? RecordedInput::Touching : 0) |
+                (nds.IsLidClosed() ? RecordedInput::LidClosed : 0) |
+                (_inputState.MicButtonDown() ? RecordedInput::MicButton : 0)
+            ),
+        };
+        _inputRecording->Record(input);
+        return;
+    }
+
+    optional<RecordedInput> input = _inputRecording->Next();
+    if (!input) {
+        // If we've replayed everything that was recorded...
+        retro::info("Input replay finished after {} frames; using the frontend's input from now on", _inputRecording->Frames());
+        _inputRecording = nullopt;
+        return;
+    }
+
+    // Override whatever the frontend's input did to the console this frame
+    nds.SetKeyMask(input->Buttons);
+    if (input->Flags & RecordedInput::Touching) {
+        nds.TouchScreen(input->TouchX, input->TouchY);
+    }
+    else {
+        nds.ReleaseScreen();
+    }
+
+    if (bool lidClosed = input->Flags & RecordedInput::LidClosed; lidClosed != nds.IsLidClosed()) {
+        nds.SetLidClosed(lidClosed);
+    }
+
+    _micState.SetMicButtonState(input->Flags & RecordedInput::MicButton);
+}
+
+bool MelonDsDs::CoreState::LoadSavestateFile(const string& path) noexcept {
+    ZoneScopedN(TracyFunction);
+    void* buffer = nullptr;
+    int64_t length = 0;
+    if (!filestream_read_file(path.c_str(), &buffer, &length) || !buffer) {
+        retro::error("Failed to read savestate {}", path);
+        return false;
+    }
+
+    span<const std::byte> file(static_cast<const std::byte*>(buffer), static_cast<size_t>(length));
+#ifdef HAVE_ZLIB
+    if (IsStateFile(file)) {
+        // If this savestate was compressed by SaveStateFile...
+        std::vector<std::byte> state;
+        bool decoded = _stateFiles.Decode(file, state);
+        free(buffer);
+        return decoded && Unserialize(state);
+    }
+#endif
+
+    bool loaded = Unserialize(file);
+    free(buffer);
+    return loaded;
+}
+
+#ifdef HAVE_ZLIB
+bool MelonDsDs::CoreState::SaveStateFile(const string& path) noexcept {
+    ZoneScopedN(TracyFunction);
+    size_t size = SerializeSize();
+    if (size == 0) {
+        // If there's nothing we can save right now (e.g. an error screen or DSi mode)...
+        retro::error("Can't save a state to {} right now", path);
+        return false;
+    }
+
+    // Only the snapshot happens on this thread; compressing and writing it happen while the game keeps running
+    std::vector<std::byte> state(size);
+    if (!Serialize(state)) {
+        return false;
+    }
+
+    retro_assert(Console != nullptr);
+    StateThumbnail thumbnail {
+        .Pixels = std::vector<uint32_t>(NDS_SCREEN_AREA<size_t> * 2),
+        .Width = NDS_SCREEN_WIDTH,
+        .Height = NDS_SCREEN_HEIGHT * 2,
+    };
+    int frontBuffer = Console->GPU.FrontBuffer;
+    memcpy(thumbnail.Pixels.data(), Console->GPU.Framebuffer[frontBuffer][0].get(), NDS_SCREEN_AREA<size_t> * PIXEL_SIZE);
+    memcpy(thumbnail.Pixels.data() + NDS_SCREEN_AREA<size_t>, Console->GPU.Framebuffer[frontBuffer][1].get(), NDS_SCREEN_AREA<size_t> * PIXEL_SIZE);
+
+    _stateFiles.Write(path, std::move(state), std::move(thumbnail));
+    return true;
+}
+
+bool MelonDsDs::CoreState::CanRewind() const noexcept {
+    return !Config.Deterministic() && !_inputRecording && !_mpState.IsReady();
+}
+
+unsigned MelonDsDs::CoreState::TakeRewindSnapshot() noexcept {
+    ZoneScopedN(TracyFunction);
+    if (Config.RewindBufferSize() == 0)
+        return 0;
+
+    if (!CanRewind())
+        return Config.RewindInterval();
+
+    size_t size = SerializeSize();
+    std::span<std::byte> snapshot = _rewind.BeginSnapshot(size);
+    if (snapshot.empty()) {
+        // If the last snapshot is still being compressed (or there's nothing we can snapshot right now)...
+        TracyMessageL("Skipped a rewind snapshot");
+        return Config.RewindInterval();
+    }
+
+    if (Serialize(snapshot) && SerializeSize() == size) {
+        // If the snapshot came out the size we expected...
+        _rewind.EndSnapshot();
+    }
+
+    return Config.RewindInterval();
+}
+
+void MelonDsDs::CoreState::StepBackRewind() noexcept {
+    ZoneScopedN(TracyFunction);
+    if (!CanRewind())
+        return;
+
+    // Don't snapshot while going backwards, or the next step would land where this one started
+    _scheduler.Schedule(_rewindTimer, Config.RewindInterval());
+
+    std::span<const std::byte> snapshot = _rewind.StepBack();
+    if (snapshot.empty()) {
+        // If we've gone as far back as the history goes...
+        return;
+    }
+
+    if (!Unserialize(snapshot)) {
+        retro::error("Failed to load a rewind snapshot, discarding the rewind history");
+        _rewind.Clear();
+    }
+}
+#endif
+
 void MelonDsDs::CoreState::Reset() {
     ZoneScopedN(TracyFunction);
 
@@ -204,71 +859,101 @@ void MelonDsDs::CoreState::Reset() {
     }
 
     // Flush all data before resetting
-    _timeToFirmwareFlush = 0;
-    _timeToGbaFlush = 0;
-    if (optional<retro::task::TaskHandle> task = retro::task::find(_flushTaskId)) {
-        task->Cancel();
-    }
-    retro::task::check();
-    _savestateSize = std::nullopt;
+    FlushSaveData();
+#ifdef HAVE_ZLIB
+    _rewind.Clear(); // Stepping back past a reset would undo it
+#endif
 
     retro_assert(Console != nullptr);
-    RegisterCoreOptions();
-    ParseConfig(Config);
-    ApplyConfig(Config);
-    _syncClock = Config.StartTimeMode() == StartTimeMode::Sync;
 
-    std::vector<uint8_t> ndsSram(Console->GetNDSSaveLength());
-    if (Console->GetNDSSaveLength() && Console->GetNDSSave()) {
-        memcpy(ndsSram.data(), Console->GetNDSSave(), Console->GetNDSSaveLength());
+    // Options, network adapters, and system files are registered once per content load,
+    // so a reset only has to pick up option values that changed since they were last applied
+    ConfigSubsystem changed = _optionChanges.Changes();
+    if (changed != ConfigSubsystem::None) {
+        ReparseConfig();
+    }
+#ifdef HAVE_JIT
+    if (_jitTuner) {
+        // The game is about to start over, so give up on tuning it for this session
+        retro::debug("Abandoning JIT tuning due to a reset");
+        _jitTuner = nullopt;
+        if (changed == ConfigSubsystem::None) {
+            ReparseConfig(); // Restore the configured block size
+        }
+        UpdateJit(Config, *Console);
+    }
+#endif
+    if (changed != ConfigSubsystem::None) {
+        ApplyConfig(Config, changed);
     }
+    _syncClock = Config.StartTimeMode() == StartTimeMode::Sync && !Config.Deterministic();
 
-    std::vector<uint8_t> gbaSram(Console->GetGBASaveLength());
-    if (Console->GetGBASaveLength() && Console->GetGBASave()) {
-        memcpy(gbaSram.data(), Console->GetGBASave(), Console->GetGBASaveLength());
+    if (_consoleConfig && !RequiresNewConsole(*_consoleConfig, Config)) {
+        // If none of the options that were baked into the console have changed...
+        // (StartConsole will reset the emulated hardware)
+        retro::debug("Resetting the existing console in-place");
+        ResetConsole(Config, *Console);
     }
+    else {
+        // Otherwise, the console needs to be rebuilt with its new system files and devices.
+        retro::debug("At least one option requires a new console; recreating it");
+        if (_measuredSavestateSize) {
+            // If a savestate didn't fit in the old console's size, fix the cache before the new console reads it
+            CacheSavestateSize(GetSavestateSizeKey(*Console), *_measuredSavestateSize);
+        }
+        _savestateSize = std::nullopt; // The new console's savestates might be a different size
+        _measuredSavestateSize = std::nullopt;
+        std::vector<uint8_t> ndsSram(Console->GetNDSSaveLength());
+        if (Console->GetNDSSaveLength() && Console->GetNDSSave()) {
+            memcpy(ndsSram.data(), Console->GetNDSSave(), Console->GetNDSSaveLength());
+        }
 
-    std::vector<melonDS::ARCode> cheats = std::move(Console->AREngine.Cheats);
+        std::vector<uint8_t> gbaSram(Console->GetGBASaveLength());
+        if (Console->GetGBASaveLength() && Console->GetGBASave()) {
+            memcpy(gbaSram.data(), Console->GetGBASave(), Console->GetGBASaveLength());
+        }
 
-    Console = nullptr;
-    melonDS::NDS::Current = nullptr;
-    Console = CreateConsole(
-        *this,
-        Config,
-        _ndsInfo ? &*_ndsInfo : nullptr,
-        _gbaInfo ? &*_gbaInfo : nullptr,
-        _gbaSaveInfo ? &*_gbaSaveInfo : nullptr
-    );
-    retro_assert(Console != nullptr);
-    melonDS::NDS::Current = Console.get();
-    // TODO: Don't throw out the NDS object (unless changing console type), customize it instead
-    if (!ndsSram.empty()) {
-        Console->SetNDSSave(ndsSram.data(), ndsSram.size());
-    }
+        // The new console needs the whole ROM again
+        ReloadContent();
+        Console = nullptr;
+        melonDS::NDS::Current = nullptr;
+        Console = CreateConsole(
+            *this,
+            Config,
+            _ndsInfo ? &*_ndsInfo : nullptr,
+            _gbaInfo ? &*_gbaInfo : nullptr,
+            _gbaSaveInfo ? &*_gbaSaveInfo : nullptr
+        );
+        retro_assert(Console != nullptr);
+        melonDS::NDS::Current = Console.get();
+        _consoleConfig = Config;
+        AdviseHugePages();
+        PublishMemoryMaps();
 
-    if (!gbaSram.empty()) {
-        Console->SetGBASave(gbaSram.data(), gbaSram.size());
-    }
+        if (!ndsSram.empty()) {
+            Console->SetNDSSave(ndsSram.data(), ndsSram.size());
+        }
 
-    Console->AREngine.Cheats = std::move(cheats);
+        if (!gbaSram.empty()) {
+            Console->SetGBASave(gbaSram.data(), gbaSram.size());
+        }
 
-    _ndsSramInstalled = false;
-    InitFlushFirmwareTask();
+        PublishCheats();
+        ReleaseContent();
 
-    if (std::optional<retro::task::TaskHandle> rumble_task = retro::task::find(RUMBLE_TASK)) {
-        // Stop the existing rumble task, if any
-        rumble_task->Finish();
+        _ndsSramInstalled = false;
     }
 
+    InitFirmwareFlush();
+
+    // Stop any rumble that was still running
+    RumbleStop();
+
     if (const auto* gbacart = Console->GetGBACart()) {
         // If the console has a GBA cart (even if it's not a real ROM)...
         _inputState.SetSlot2Input(*gbacart); // ...then let the input system know.
         _inputState.SetConfig(Config);
-
-        if (gbacart->Type() == melonDS::GBACart::CartType::RumblePak) {
-            // If the console has a rumble pak...
-            retro::task::push(_inputState.RumbleTask());
-        }
+        ScheduleSolarSensor();
     }
 
 
@@ -279,48 +964,104 @@ void MelonDsDs::CoreState::Reset() {
 void MelonDsDs::CoreState::RenderAudio(melonDS::NDS& nds) noexcept {
     ZoneScopedN(TracyFunction);
     int16_t audio_buffer[0x1000]; // 4096 samples == 2048 stereo frames
-    uint32_t size = std::min(nds.SPU.GetOutputSize(), static_cast<int>(sizeof(audio_buffer) / (2 * sizeof(int16_t))));
+    int outputSize = nds.SPU.GetOutputSize();
+    TracyPlot("SPU Output Size", static_cast<int64_t>(outputSize));
+    uint32_t size = std::min(outputSize, static_cast<int>(sizeof(audio_buffer) / (2 * sizeof(int16_t))));
     // Ensure that we don't overrun the buffer
 
-    size_t read = nds.SPU.ReadOutput(audio_buffer, size);
-    retro::audio_sample_batch(audio_buffer, read);
+    size_t read = nds.SPU.ReadOutput(audio_buffer, size);
+    std::span<const int16_t> samples(audio_buffer, read * 2);
+
+    // Big enough for the input at the highest output rate, plus one frame for the fractional remainder
+    constexpr auto MAX_STRETCHED_FRAMES = static_cast<size_t>(2048 * (1 + AudioRateControl::MAX_DEVIATION)) + 2;
+    int16_t stretched[MAX_STRETCHED_FRAMES * 2];
+    if (Config.AudioRateControl()) {
+        // If we're adjusting the output rate to match the frontend's audio buffer...
+        if (_audioCallbackRegistered) {
+            // If the frontend pulls audio from our ring, then the ring's fill level is the one that matters
+            size_t fill = _audioRing.Size();
+            _audioRateControl.Update(retro::AudioBufferStatus {
+                .Occupancy = static_cast<unsigned>(std::min<size_t>(fill * 100 / (2 * AUDIO_RING_TARGET_FRAMES), 100)),
+                .UnderrunLikely = fill < AUDIO_CALLBACK_FRAMES,
+            });
+        }
+        else {
+            _audioRateControl.Update();
+        }
+        size_t written = _audioRateControl.Process(samples, stretched);
+        samples = std::span(stretched, written * 2);
+    }
+    else {
+        _audioRateControl.Reset();
+    }
+
+    // Big enough for the stretched input (plus what the resampler held back) at the highest supported output rate
+    constexpr auto MAX_RESAMPLED_FRAMES = static_cast<size_t>((MAX_STRETCHED_FRAMES + 64) * (AudioResampler::MAX_OUTPUT_RATE / SAMPLE_RATE)) + 2;
+    int16_t resampled[MAX_RESAMPLED_FRAMES * 2];
+    if (_resampler) {
+        // If we're sending audio at the frontend's native rate...
+        size_t written = _resampler->Process(samples, resampled);
+        samples = std::span(resampled, written * 2);
+    }
+
+    TracyPlot("Audio Frames Delivered", static_cast<int64_t>(samples.size() / 2));
+    if (_audioCallbackRegistered) {
+        // If the frontend's audio thread will pick this up later...
+        _audioRing.Write(samples);
+        TracyPlot("Audio Ring Fill", static_cast<int64_t>(_audioRing.Size()));
+    }
+    else {
+        retro::audio_sample_batch(samples.data(), samples.size() / 2);
+    }
+}
+
+void MelonDsDs::CoreState::PullAudio() noexcept {
+    ZoneScopedN(TracyFunction);
+
+    if (_audioRingStale.exchange(false, std::memory_order_acq_rel)) {
+        // If the frontend just resumed audio, anything that piled up while it was paused is stale
+        _audioRing.Discard();
+    }
+
+    std::array<int16_t, AUDIO_CALLBACK_FRAMES * 2> buffer {};
+    size_t read = _audioRing.Read(buffer);
+    if (read == 0) {
+        // If the emulator hasn't caught up yet, send a moment of silence;
+        // the frontend's audio thread will block on its device instead of spinning on us
+        retro::audio_sample_batch(buffer.data(), AUDIO_UNDERRUN_FRAMES);
+        return;
+    }
+
+    retro::audio_sample_batch(buffer.data(), read);
+}
+
+void MelonDsDs::CoreState::SetAudioCallbackState(bool enabled) noexcept {
+    ZoneScopedN(TracyFunction);
+    retro::debug("Frontend {} the audio callback", enabled ? "enabled" : "disabled");
+    if (enabled) {
+        _audioRingStale.store(true, std::memory_order_release);
+    }
+}
+
+std::optional<unsigned> MelonDsDs::CoreState::AudioBufferFill() const noexcept {
+    if (_audioCallbackRegistered) {
+        // Measured like dynamic rate control does, so 50% means the ring is right on target
+        return static_cast<unsigned>(std::min<size_t>(_audioRing.Size() * 100 / (2 * AUDIO_RING_TARGET_FRAMES), 100));
+    }
+
+    if (std::optional<retro::AudioBufferStatus> status = retro::audio_buffer_status()) {
+        return status->Occupancy;
+    }
+
+    return std::nullopt;
 }
 
-bool MelonDsDs::CoreState::RunDeferredInitialization() noexcept {
-    ZoneScopedN(TracyFunction);
-    retro_assert(Console != nullptr);
-    try {
-        retro::debug("Starting deferred initialization");
-        StartConsole();
-        _deferredInitializationPending = false;
-
-        retro::debug("Completed deferred initialization");
-    }
-    catch (const config_exception& e) {
-        retro::error("Deferred initialization failed; displaying error screen");
-        retro::error("{}", e.what());
-        retro::set_error_message(e.user_message());
-        if (!InitErrorScreen(e))
-            return false;
-    }
-    catch (const emulator_exception& e) {
-        retro::error("Deferred initialization failed; exiting core");
-        retro::error("{}", e.what());
-        retro::set_error_message(e.user_message());
-        return false;
-    }
-    catch (const std::exception& e) {
-        retro::error("Deferred initialization failed; exiting core");
-        retro::set_error_message(e.what());
-        return false;
-    }
-    catch (...) {
-        retro::error("Deferred initialization failed; exiting core");
-        retro::set_error_message(UNKNOWN_ERROR_MESSAGE);
-        return false;
+std::optional<MelonDsDs::AudioRingStats> MelonDsDs::CoreState::GetAudioRingStats() const noexcept {
+    if (!_audioCallbackRegistered) {
+        return std::nullopt;
     }
 
-    return true;
+    return _audioRing.Stats();
 }
 
 bool MelonDsDs::CoreState::InitErrorScreen(const config_exception& e) noexcept {
@@ -335,6 +1076,9 @@ bool MelonDsDs::CoreState::InitErrorScreen(const config_exception& e) noexcept {
     retro::task::reset();
     _messageScreen = std::make_unique<error::ErrorScreen>(e);
     Config.SetConfiguredRenderer(RenderMode::Software);
+#if defined(HAVE_OPENGL) || defined(HAVE_OPENGLES) || defined(HAVE_VULKAN)
+    Config.SetGpuComposition(false); // The error screen is only drawn by the software render state
+#endif
     _renderState.Apply(Config);
     _screenLayout.Apply(Config, _renderState);
     _screenLayout.Update();
@@ -345,10 +1089,7 @@ bool MelonDsDs::CoreState::InitErrorScreen(const config_exception& e) noexcept {
 void MelonDsDs::CoreState::RenderErrorScreen() noexcept {
     assert(_messageScreen != nullptr);
     _renderState.Render(*_messageScreen, Config, _screenLayout);
-}
-
-std::chrono::system_clock::time_point ToSystemTime(std::chrono::local_seconds time) noexcept {
-    return std::chrono::system_clock::from_time_t(time.time_since_epoch().count());
+    startup::FirstFrame();
 }
 
 void MelonDsDs::CoreState::InstallNdsSram() noexcept {
@@ -376,6 +1117,22 @@ void MelonDsDs::CoreState::InstallNdsSram() noexcept {
 
 void MelonDsDs::CoreState::SetConsoleTime(melonDS::NDS& nds) noexcept {
     ZoneScopedN(TracyFunction);
+    if (_inputRecording && _inputRecording->Started()) {
+        // If the console is reset partway through a recording or replay, its RTC must start over from the same time
+        SetConsoleTime(nds, _inputRecording->StartTime());
+        return;
+    }
+
+    SetConsoleTime(nds, ConfiguredStartTime());
+}
+
+local_seconds MelonDsDs::CoreState::ConfiguredStartTime() const noexcept {
+    if (Config.Deterministic()) {
+        // If every player's console needs to start at the same time, regardless of their clocks or time zones...
+        local_seconds targetTime = Config.AbsoluteStartDateTime();
+        retro::debug("Starting the RTC at {:%F %r} (deterministic)", ToSystemTime(targetTime));
+        return targetTime;
+    }
 
     local_seconds now = LocalTime();
     local_seconds targetTime;
@@ -409,7 +1166,7 @@ void MelonDsDs::CoreState::SetConsoleTime(melonDS::NDS& nds) noexcept {
         }
     }
 
-    SetConsoleTime(nds, targetTime);
+    return targetTime;
 }
 
 void MelonDsDs::CoreState::SetConsoleTime(melonDS::NDS& nds, local_seconds time) noexcept {
@@ -475,22 +1232,242 @@ void MelonDsDs::CoreState::StartConsole() {
 
     Console->Start();
 
+    if (!_savestateSize) {
+        // If this console is new, settle its savestate size before the frontend asks for it
+        InitSavestateSize();
+    }
+
     retro::info("Started emulated console");
 }
 
-void MelonDsDs::CoreState::InitFlushFirmwareTask() noexcept
-{
+void MelonDsDs::CoreState::RefreshNetworkAdapters() noexcept {
+    _netState.RefreshAdapters([this](bool optionsChanged) {
+        ZoneScopedN("MelonDsDs::CoreState::RefreshNetworkAdapters::callback");
+        if (optionsChanged && RegisterCoreOptions(_netState.GetAdapterOptions(), _systemFiles.Files())) {
+            // If the list of Wi-Fi interfaces is different from the one we registered...
+            ReparseConfig();
+            _optionVisibility.Invalidate();
+            _optionVisibility.Update();
+        }
+
+        // Direct mode may have been waiting for the adapter list
+        _netState.Apply(Config);
+    });
+}
+
+void MelonDsDs::CoreState::RefreshSystemFiles() noexcept {
+    _systemFiles.Refresh([this](bool filesChanged) {
+        ZoneScopedN("MelonDsDs::CoreState::RefreshSystemFiles::callback");
+        if (filesChanged && RegisterCoreOptions(_netState.GetAdapterOptions(), _systemFiles.Files())) {
+            // If the system directory gained or lost firmware or NAND images...
+            ReparseConfig();
+            _optionVisibility.Invalidate();
+            _optionVisibility.Update();
+        }
+    });
+}
+
+#ifdef HAVE_TRACE_RECORDER
+void MelonDsDs::CoreState::SaveTrace() noexcept {
+    ZoneScopedN(TracyFunction);
+    // A one-shot request, so flip the option back for the next one
+    Config.SetSaveTraceRequested(false);
+    retro::set_variable(config::osd::SAVE_TRACE, config::values::DISABLED);
+
+    std::time_t now = std::time(nullptr);
+    char name[64] {};
+    std::strftime(name, sizeof(name), "melonDS DS trace %Y-%m-%d %H-%M-%S.json", std::localtime(&now));
+    optional<string> path = retro::get_save_subdir_path(name);
+    if (!path) {
+        retro::set_error_message("Can't save a performance trace without a save directory.");
+        return;
+    }
+
+    if (trace::Save(path->c_str())) {
+        retro::info("Saved a performance trace to \"{}\"", *path);
+        retro::fmt_message(RETRO_LOG_INFO, "Saved a performance trace to \"{}\"", fmt::make_format_args(*path));
+    } else {
+        retro::set_error_message("Failed to save a performance trace to \"{}\"", *path);
+    }
+}
+#endif
+
+void MelonDsDs::CoreState::InitGameSettings() noexcept {
+    ZoneScopedN(TracyFunction);
+    _gameKey = nullopt;
+    _jitProfile = nullopt;
+    _gamePreset = nullopt;
+    if (!_ndsInfo || _ndsInfo->GetData().size() < sizeof(melonDS::NDSHeader)) {
+        // If we're booting into the DS menu, or the ROM is too small to be a real game...
+        return;
+    }
+
+    const melonDS::NDSHeader& header = *reinterpret_cast<const melonDS::NDSHeader*>(_ndsInfo->GetData().data());
+    _gameKey = GetGameKey(std::string_view(header.GameCode, sizeof(header.GameCode)));
+    if (!_gameKey) {
+        return;
+    }
+
+    if ((_gamePreset = LoadGamePreset(*_gameKey))) {
+        fmt::memory_buffer values;
+        for (const auto& [option, value] : _gamePreset->Values) {
+            fmt::format_to(std::back_inserter(values), " {}={}", option, value);
+        }
+        retro::info(
+            "Applying the {} preset for {}:{}",
+            _gamePreset->UserDefined ? "custom" : "built-in",
+            *_gameKey,
+            fmt::to_string(values)
+        );
+    }
+
+#ifdef HAVE_JIT
+    if ((_jitProfile = LoadJitProfile(*_gameKey))) {
+        retro::info(
+            "Using the {} JIT profile for {}",
+            _jitProfile->Tuned ? "auto-tuned" : "custom",
+            *_gameKey
+        );
+    }
+#endif
+}
+
+size_t MelonDsDs::CoreState::ReleaseContent() noexcept {
+    ZoneScopedN(TracyFunction);
+    if (!Config.LowMemoryMode())
+        return 0;
+
+    size_t freed = 0;
+    if (_ndsInfo) {
+        // The header is still consulted for the rest of the session (e.g. for game-specific settings)
+        freed += _ndsInfo->ReleaseData(sizeof(melonDS::NDSHeader));
+    }
+
+    if (_gbaInfo) {
+        freed += _gbaInfo->ReleaseData(0);
+    }
+
+    return freed;
+}
+
+void MelonDsDs::CoreState::ReloadContent() {
+    ZoneScopedN(TracyFunction);
+    for (std::optional<retro::GameInfo>* info : {&_ndsInfo, &_gbaInfo}) {
+        if (*info && (*info)->IsDataReleased() && !(*info)->ReloadData()) {
+            throw emulator_exception(
+                fmt::format("Failed to reload \"{}\" to recreate the console", (*info)->GetPath()),
+                "The game's file was changed or removed after it was loaded. Please reload the game."
+            );
+        }
+    }
+}
+
+void MelonDsDs::CoreState::AdviseHugePages() noexcept {
+    ZoneScopedN(TracyFunction);
+    retro_assert(Console != nullptr);
+
+    // melonDS allocates the full DSi-sized buffer even in DS mode
+    _mainRamHugePages = memory::AdviseHugePages(Console->MainRAM, melonDS::MainRAMMaxSize);
+    retro::info(
+        "Huge pages for main RAM: {}",
+        memory::GetHugePageStatusName(_mainRamHugePages)
+    );
+}
+
+void MelonDsDs::CoreState::PublishMemoryMaps() noexcept {
+    ZoneScopedN(TracyFunction);
     retro_assert(Console != nullptr);
-    string_view firmwareName = Config.FirmwarePath(static_cast<ConsoleType>(Console->ConsoleType));
-    if (retro::task::TaskSpec flushTask = FlushFirmwareTask(firmwareName)) {
-        _flushTaskId = *retro::task::push(std::move(flushTask));
+
+    // Each region is mirrored throughout its part of the address space,
+    // so match on the top bits and ignore the ones that only select a mirror
+    bool isDsi = static_cast<ConsoleType>(Console->ConsoleType) == ConsoleType::DSi;
+    size_t mainRamSize = isDsi ? melonDS::MainRAMMaxSize : DS_MEMORY_SIZE;
+    _memoryDescriptors[0] = {
+        .flags = RETRO_MEMDESC_SYSTEM_RAM,
+        .ptr = Console->MainRAM,
+        .start = 0x02000000,
+        .select = 0xFF000000,
+        .disconnect = 0x00FFFFFF & ~(mainRamSize - 1),
+        .len = mainRamSize,
+        .addrspace = isDsi ? "DSi RAM" : "Main RAM",
+    };
+
+    // WRAMCNT decides how the two CPUs split this bank, so expose all of it at the ARM9's address
+    _memoryDescriptors[1] = {
+        .ptr = Console->SharedWRAM,
+        .start = 0x03000000,
+        .select = 0xFF800000,
+        .disconnect = 0x007F8000,
+        .len = melonDS::SharedWRAMSize,
+        .addrspace = "Shared WRAM",
+    };
+
+    _memoryDescriptors[2] = {
+        .ptr = Console->ARM7WRAM,
+        .start = 0x03800000,
+        .select = 0xFF800000,
+        .disconnect = 0x007F0000,
+        .len = melonDS::ARM7WRAMSize,
+        .addrspace = "ARM7 WRAM",
+    };
+
+    retro_memory_map map {
+        .descriptors = _memoryDescriptors.data(),
+        .num_descriptors = static_cast<unsigned>(_memoryDescriptors.size()),
+    };
+    if (!retro::set_memory_maps(map)) {
+        retro::debug("Frontend doesn't support memory maps; only the flat main RAM block is available");
     }
-    else {
-        retro::set_error_message("System path not found, changes to firmware settings won't be saved.");
+}
+
+#ifdef HAVE_JIT
+void MelonDsDs::CoreState::UpdateJitTuner(melonDS::NDS& nds) noexcept {
+    ZoneScopedN(TracyFunction);
+    retro_assert(_jitTuner);
+    retro_assert(_gameKey);
+
+    // Time spent waiting on other players has nothing to do with the block size
+    float runFrameTime = _frameTimings.Latest(FramePhase::RunFrame) - _frameTimings.Latest(FramePhase::MpWait);
+    optional<unsigned> blockSize = _jitTuner->EndFrame(runFrameTime);
+    if (!blockSize) {
+        return;
+    }
+
+    Config.SetMaxBlockSize(*blockSize);
+    UpdateJit(Config, nds);
+    if (!_jitTuner->Done()) {
+        retro::debug("Measuring JIT block size {} for {}", *blockSize, *_gameKey);
+        return;
+    }
+
+    fmt::memory_buffer results;
+    for (size_t i = 0; i < JitTuner::CANDIDATES.size(); ++i) {
+        fmt::format_to(
+            std::back_inserter(results),
+            "{}{}: {:.2f}ms",
+            i == 0 ? "" : ", ",
+            JitTuner::CANDIDATES[i],
+            _jitTuner->Results()[i]
+        );
+    }
+    retro::info("Picked JIT block size {} for {} ({})", *blockSize, *_gameKey, fmt::to_string(results));
+
+    if (_consoleConfig) {
+        // The running console now uses the winning block size, so a reset shouldn't have to recreate it
+        _consoleConfig->SetMaxBlockSize(*blockSize);
     }
+
+    JitProfile profile = _jitProfile.value_or(JitProfile {});
+    profile.MaxBlockSize = *blockSize;
+    profile.Tuned = true;
+    SaveJitProfile(*_gameKey, profile);
+    _jitProfile = profile;
+    _jitTuner = nullopt;
 }
+#endif
 
 void MelonDsDs::CoreState::ResetRenderState() {
+    startup::Stage stage("ContextReset");
     _renderState.ContextReset(*Console, Config);
 }
 
@@ -501,34 +1478,107 @@ void MelonDsDs::CoreState::DestroyRenderState() {
 bool MelonDsDs::CoreState::LoadGame(unsigned type, std::span<const retro_game_info> game) noexcept try {
     ZoneScopedN(TracyFunction);
 
-    InitContent(type, game);
+    // The frontend may have added or removed system files since the last game
+    ClearLocalFileCache();
+    InitTimers();
+#ifdef HAVE_TRACE_RECORDER
+    if (optional<string> crashTracePath = retro::get_save_subdir_path("melonDS DS crash trace.json")) {
+        trace::InstallCrashHandler(crashTracePath->c_str());
+    }
+#endif
+    {
+        startup::Stage stage("InitContent");
+        InitContent(type, game);
+    }
+    InitGameSettings();
+
+    // Offer the adapters we found last time, so loading doesn't have to wait for libpcap
+    _netState.LoadAdapterCache();
+    RefreshNetworkAdapters();
+
+    // Likewise for the system files, so loading doesn't have to open everything in the system directory
+    {
+        startup::Stage stage("RegisterCoreOptions");
+        _systemFiles.Load();
+        RefreshSystemFiles();
+        if (RegisterCoreOptions(_netState.GetAdapterOptions(), _systemFiles.Files())) {
+            ReparseConfig();
+            _optionVisibility.Invalidate();
+            _optionVisibility.Update();
+        }
+    }
+    {
+        startup::Stage stage("ApplyConfig");
+        ApplyConfig(Config);
+    }
+    _optionChanges.Snapshot();
 
     // ...then load the game.
-    if (!retro::set_pixel_format(RETRO_PIXEL_FORMAT_XRGB8888)) {
+    if (Config.Rgb565Output() && retro::set_pixel_format(RETRO_PIXEL_FORMAT_RGB565)) {
+        // If we want 16-bit output and the frontend supports it...
+        retro::info("Sending frames to the frontend in RGB565 format");
+    }
+    else if (!retro::set_pixel_format(RETRO_PIXEL_FORMAT_XRGB8888)) {
         throw environment_exception(
             "Failed to set the required XRGB8888 pixel format for rendering; it may not be supported.");
     }
 
-    if (RegisterCoreOptions()) {
-        ParseConfig(Config);
-        _optionVisibility.Update();
+    if (Config.AudioCallback()) {
+        // If we want the frontend's audio thread to pull audio from us...
+        // (the frontend only accepts this during retro_load_game)
+        retro_audio_callback callback { .callback = MelonDsDs::AudioCallback, .set_state = MelonDsDs::AudioSetState };
+
+        // Nothing can be reading from the ring until the callback is registered, so it's safe to reset here
+        _audioRing.Discard();
+        _audioRing.ResetStats();
+        _audioCallbackRegistered = retro::set_audio_callback(callback);
+        if (_audioCallbackRegistered) {
+            retro::info("Delivering audio through the frontend's audio callback");
+        }
+        else {
+            retro::warn("Frontend doesn't support audio callbacks; sending audio once per frame instead");
+        }
+    }
+
+    if (std::optional<unsigned> rate = Config.AudioOutputRate()) {
+        // If we want to send audio at the frontend's native rate...
+        // (chosen once per session, since the frontend only learns the rate from GetSystemAvInfo)
+        _resampler.emplace(SAMPLE_RATE, *rate, Config.ResamplerQuality());
+        retro::info("Resampling audio to {} Hz with a {}-tap filter", _resampler->OutputRate(), _resampler->Taps());
     }
-    ApplyConfig(Config);
 
-    _syncClock = Config.StartTimeMode() == StartTimeMode::Sync;
+    _syncClock = Config.StartTimeMode() == StartTimeMode::Sync && !Config.Deterministic();
     retro_assert(Console == nullptr);
-    // Instantiates the console with games and save data installed
-    Console = CreateConsole(
-        *this,
-        Config,
-        _ndsInfo ? &*_ndsInfo : nullptr,
-        _gbaInfo ? &*_gbaInfo : nullptr,
-        _gbaSaveInfo ? &*_gbaSaveInfo : nullptr
-    );
+
+    // DSiWare save data exported by the last game might still be on its way to the disk
+    _saveWriter.Wait();
+    {
+        // Instantiates the console with games and save data installed
+        startup::Stage stage("CreateConsole");
+        Console = CreateConsole(
+            *this,
+            Config,
+            _ndsInfo ? &*_ndsInfo : nullptr,
+            _gbaInfo ? &*_gbaInfo : nullptr,
+            _gbaSaveInfo ? &*_gbaSaveInfo : nullptr
+        );
+    }
 
     retro_assert(Console != nullptr);
     melonDS::NDS::Current = Console.get();
+    _consoleConfig = Config;
+    AdviseHugePages();
+    PublishMemoryMaps();
 
+    if (Config.LowMemoryMode()) {
+        // If we're on a device that can't spare the memory...
+        size_t freed = ReleaseContent();
+        retro::info(
+            "Low-memory mode is enabled; freed {:.1f} MiB of content copies, "
+            "and disk images will be read through the frontend instead of being memory-mapped",
+            freed / 1024.0 / 1024.0
+        );
+    }
 
     if (Console->GetNDSCart()) {
         assert(!Console->GetNDSCart()->GetHeader().IsDSiWare());
@@ -539,8 +1589,17 @@ bool MelonDsDs::CoreState::LoadGame(unsigned type, std::span<const retro_game_in
     if (_gbaInfo && _gbaSaveInfo && Console->GetGBASave() && Console->GetGBASaveLength()) {
         // If we inserted a GBA ROM with SRAM...
         _gbaSaveManager = std::make_optional<sram::SaveManager>(Console->GetGBASaveLength());
-        retro::task::push(FlushGbaSramTask());
-        retro::debug("Initialized and loaded GBA SRAM, and started GBA SRAM flush task.");
+        memcpy(_gbaSaveManager->Sram(), Console->GetGBASave(), _gbaSaveManager->SramLength());
+        retro::debug("Initialized and loaded GBA SRAM.");
+
+        if (Config.SaveJournal() && !_gbaSaveInfo->GetPath().empty()) {
+            // If we want writes to survive a crash before they're flushed...
+            if (optional<uint32_t> replayed = _gbaSaveManager->OpenJournal(_gbaSaveInfo->GetPath()); replayed && *replayed > 0) {
+                // Give the recovered writes to the cart, then put them in the save file
+                Console->SetGBASave(_gbaSaveManager->Sram(), _gbaSaveManager->SramLength());
+                FlushGbaSram(*_gbaSaveInfo);
+            }
+        }
     }
     else {
         retro::info("No GBA SRAM was provided.");
@@ -550,15 +1609,11 @@ bool MelonDsDs::CoreState::LoadGame(unsigned type, std::span<const retro_game_in
         // If the console has a GBA cart (even if it's not a real ROM)...
         _inputState.SetSlot2Input(*gbacart); // ...then let the input system know.
         _inputState.SetConfig(Config);
-
-        if (gbacart->Type() == melonDS::GBACart::CartType::RumblePak) {
-            // If the console has a rumble pak...
-            retro::task::push(_inputState.RumbleTask());
-        }
+        ScheduleSolarSensor();
     }
 
     if (retro::supports_power_status()) {
-        retro::task::push(PowerStatusUpdateTask());
+        _scheduler.Schedule(_powerStatusTimer, 1);
     }
 
     if (optional<unsigned> version = retro::message_interface_version(); version && version >= 1) {
@@ -566,19 +1621,53 @@ bool MelonDsDs::CoreState::LoadGame(unsigned type, std::span<const retro_game_in
         retro::task::push(OnScreenDisplayTask());
     }
 
+#ifdef HAVE_NETWORKING
+    if (_ndsInfo && Config.DsiwareTmdPrefetch()) {
+        // If we want the other DSiWare games next to this one to load faster next time...
+        retro::task::push(PrefetchTmdTask(_ndsInfo->GetPath()));
+    }
+#endif
+
     retro::environment(RETRO_ENVIRONMENT_SET_INPUT_DESCRIPTORS, (void*)&MelonDsDs::input_descriptors);
 
-    InitFlushFirmwareTask();
+    InitFirmwareFlush();
 
-    if (_renderState.GetRenderMode() == RenderMode::OpenGl) {
-        retro::info("Deferring initialization until the OpenGL context is ready");
-        _deferredInitializationPending = true;
+#ifdef HAVE_MP_SHARED_MEMORY
+    if (Config.MpTransport() == MpTransport::SharedMemory) {
+        // If we want to play local multiplayer with other instances on this machine...
+        StartSharedMemoryMp();
     }
-    else {
-        retro::info("No need to defer initialization, proceeding now");
-        StartConsole();
+#endif
+
+    if ((_benchmark = Benchmark::FromEnvironment())) {
+        // If we're being run as a benchmark...
+        retro::set_av_output_suppressed(_benchmark->SkipAv());
+    }
+
+    // melonDS writes savestates in the host's byte order
+    if (optional<uint64_t> quirks = retro::set_serialization_quirks(RETRO_SERIALIZATION_QUIRK_ENDIAN_DEPENDENT)) {
+        retro::debug("Frontend acknowledged serialization quirks {:#x}", *quirks);
+    }
+
+    _inputRecording = InputRecording::FromEnvironment();
+    if ((_frameHashes = FrameHashLog::FromEnvironment())) {
+        // If we're checking that the presented frames match those of an earlier run...
+        _renderState.SetFrameReadbackEnabled(true);
     }
 
+#ifdef HAVE_JIT
+    if (Config.JitEnable() && Config.JitAutoTune() && _gameKey && !_benchmark && !(_jitProfile && _jitProfile->MaxBlockSize)) {
+        // If we want to find the best block size for a game that doesn't have one yet...
+        // (benchmarks need consistent settings, so they're never tuned)
+        retro::info("Will tune the JIT block size for {} once the game is running", *_gameKey);
+        _jitTuner.emplace();
+    }
+#endif
+
+    // If we're using OpenGL, the console starts now anyway;
+    // the software renderer's screens are shown until the context is ready
+    StartConsole();
+
     return true;
 }
 catch (const config_exception& e) {
@@ -626,6 +1715,12 @@ void MelonDsDs::CoreState::UninstallDsiware(melonDS::DSi_NAND::NANDImage& nand)
         ExportDsiwareSaveData(mount, *_ndsInfo, header, TitleData_PrivateSav);
         ExportDsiwareSaveData(mount, *_ndsInfo, header, TitleData_BannerSav);
 
+        if (_consoleConfig ? _consoleConfig->DsiwareKeepInstalled() : Config.DsiwareKeepInstalled()) {
+            // If we want to skip installing the title next time...
+            retro::info("Keeping DSiWare title \"{}\" installed on NAND image", _ndsInfo->GetPath());
+            return;
+        }
+
         mount.DeleteTitle(header.DSiTitleIDHigh, header.DSiTitleIDLow);
         retro::info("Removed temporarily-installed DSiWare title \"{}\" from NAND image", _ndsInfo->GetPath());
     } else {
@@ -633,6 +1728,35 @@ void MelonDsDs::CoreState::UninstallDsiware(melonDS::DSi_NAND::NANDImage& nand)
     }
 }
 
+// Reads a title's save data out of the mounted NAND image,
+// from the same file that NANDMount::ExportTitleData would copy to the host.
+// FatFs has no handle for a volume, just a global table of them; "0:" is whichever volume was mounted last.
+// So this only works while the caller's NANDMount is alive and nothing else (e.g. the DSi's SD card) has mounted over it.
+static std::optional<std::vector<std::byte>> ReadDsiwareSaveData(const melonDS::NDSHeader& header, int type) noexcept {
+    ZoneScopedN(TracyFunction);
+    const char* name = nullptr;
+    switch (type) {
+        case TitleData_PublicSav: name = "public.sav"; break;
+        case TitleData_PrivateSav: name = "private.sav"; break;
+        case TitleData_BannerSav: name = "banner.sav"; break;
+        default: return std::nullopt;
+    }
+
+    string path = fmt::format("0:/title/{:08x}/{:08x}/data/{}", header.DSiTitleIDHigh, header.DSiTitleIDLow, name);
+    FF_FIL file;
+    if (f_open(&file, path.c_str(), FA_OPEN_EXISTING | FA_READ) != FR_OK)
+        return std::nullopt;
+
+    std::vector<std::byte> data(f_size(&file));
+    UINT bytesRead = 0;
+    FRESULT result = f_read(&file, data.data(), data.size(), &bytesRead);
+    f_close(&file);
+    if (result != FR_OK || bytesRead != data.size())
+        return std::nullopt;
+
+    return data;
+}
+
 void MelonDsDs::CoreState::ExportDsiwareSaveData(NANDMount& nand, const retro::GameInfo& nds_info, const melonDS::NDSHeader& header, int type) noexcept {
     ZoneScopedN(TracyFunction);
 
@@ -659,26 +1783,83 @@ void MelonDsDs::CoreState::ExportDsiwareSaveData(NANDMount& nand, const retro::G
         return;
     }
 
-    if (nand.ExportTitleData(header.DSiTitleIDHigh, header.DSiTitleIDLow, type, sav_file)) {
-        retro::info("Exported DSiWare save data to \"{}\"", sav_file);
+    // The NAND has to be read while it's still mounted (i.e. on this thread),
+    // but it's read into memory so that the host only sees a write if the data changed,
+    // and then it's the save writer's thread that makes it.
+    std::optional<std::vector<std::byte>> data = ReadDsiwareSaveData(header, type);
+    if (!data) {
+        retro::warn("Couldn't read DSiWare save data from the NAND image, not exporting it to \"{}\"", sav_file);
+        return;
+    }
+
+    if (IsDsiwareSaveDataUnchanged(sav_file, *data)) {
+        // If the game didn't change this save data since it was imported...
+        retro::info("DSiWare save data in \"{}\" is unchanged, not exporting it", sav_file);
     } else {
-        retro::warn("Couldn't export DSiWare save data to \"{}\"", sav_file);
+        _saveWriter.Write(sav_file, *data);
+        retro::info("Exporting DSiWare save data to \"{}\"", sav_file);
+    }
+}
+
+void MelonDsDs::CoreState::ReparseConfig() noexcept {
+    ParseConfig(Config, _jitProfile ? &*_jitProfile : nullptr, _gamePreset ? &*_gamePreset : nullptr);
+    if (_batterySaverActive) {
+        ApplyBatterySaver(Config);
     }
+
+    // Set here rather than when the console is created, since the content is mapped before that
+    memory::SetFileSharingEnabled(Config.ShareFileMappings());
 }
 
-void MelonDsDs::CoreState::ApplyConfig(const CoreConfig& config) noexcept {
+void MelonDsDs::CoreState::ApplyConfig(const CoreConfig& config, ConfigSubsystem changed) noexcept {
     ZoneScopedN(TracyFunction);
     MicInputMode oldMicInputMode = config.MicInputMode();
 
     std::optional<RenderMode> oldRenderer = _renderState.GetRenderMode();
-    _renderState.Apply(config);
-    _screenLayout.Apply(config, _renderState);
-    _inputState.SetConfig(config);
-    _micState.SetConfig(config);
-    _netState.Apply(config);
-    _screenLayout.SetDirty();
-
-    if (oldMicInputMode != MicInputMode::HostMic && config.MicInputMode() == MicInputMode::HostMic) {
+    if (changed & ConfigSubsystem::Renderer) {
+        _renderState.Apply(config);
+    }
+
+    if (changed & (ConfigSubsystem::Renderer | ConfigSubsystem::Screen)) {
+        // The layout depends on the renderer (e.g. for the OpenGL resolution)
+        _screenLayout.Apply(config, _renderState);
+    }
+
+    _inputState.SetConfig(config); // Cheap, and input options are spread across several categories
+    ScheduleSolarSensor();
+
+    if (changed & ConfigSubsystem::Audio) {
+        _micState.SetConfig(config);
+    }
+
+    if (changed & ConfigSubsystem::Console) {
+        placement::PlaceRenderThreads(config.RenderThreadPlacement());
+        if (config.RunAheadFrames() == 0) {
+            // If run-ahead was disabled, don't hold on to its snapshot
+            _runAheadState = {};
+        }
+#ifdef HAVE_ZLIB
+        _rewind.SetCapacity(size_t(config.RewindBufferSize()) * 1024 * 1024);
+        if (config.RewindBufferSize() == 0) {
+            _scheduler.Cancel(_rewindTimer);
+        }
+        else if (!_scheduler.Armed(_rewindTimer)) {
+            _scheduler.Schedule(_rewindTimer, config.RewindInterval());
+        }
+#endif
+    }
+
+    if (changed & ConfigSubsystem::Network) {
+        _netState.Apply(config);
+        _mpState.SetBatching(config.MpPacketBatching());
+        _mpState.SetReceiveTimeout(config.MpReceiveTimeout());
+    }
+
+    if (changed & (ConfigSubsystem::Renderer | ConfigSubsystem::Screen | ConfigSubsystem::Osd)) {
+        _screenLayout.SetDirty();
+    }
+
+    if ((changed & ConfigSubsystem::Audio) && oldMicInputMode != MicInputMode::HostMic && config.MicInputMode() == MicInputMode::HostMic) {
         // If we want to use the host's microphone, and we're coming from another setting...
         // (so that excessive warnings aren't shown)
         if (!_micState.IsMicInterfaceAvailable() && config.ShowUnsupportedFeatureWarnings()) {
@@ -690,6 +1871,11 @@ void MelonDsDs::CoreState::ApplyConfig(const CoreConfig& config) noexcept {
         }
     }
 
+    if (!(changed & ConfigSubsystem::Renderer)) {
+        // If the renderer's options didn't change, there's nothing else to do
+        return;
+    }
+
     std::optional<RenderMode> newRenderer = _renderState.GetRenderMode();
 
     if (oldRenderer && newRenderer) {
@@ -713,6 +1899,19 @@ void MelonDsDs::CoreState::ApplyConfig(const CoreConfig& config) noexcept {
 
 void MelonDsDs::CoreState::InitContent(unsigned type, std::span<const retro_game_info> game) {
     ZoneScopedN(TracyFunction);
+    MemoryScope memory(MemoryTag::Console);
+
+    // If the frontend honored the persistent_data flag in our content info overrides,
+    // then the ROM data stays valid until retro_unload_game
+    // and there's no need to keep our own copy of it.
+    const retro_game_info_ext* ext = retro::get_game_info_ext();
+    auto isPersistent = [ext](size_t i) noexcept {
+        return ext && ext[i].persistent_data && ext[i].data;
+    };
+
+    // If the frontend told us this game was next, its ROM is already mapped
+    // and its system files are already cached
+    optional<PreloadedContent> preloaded = _preloader.Take(!game.empty() && game[0].path ? game[0].path : "");
 
     // First initialize the content info...
     switch (type) {
@@ -727,7 +1926,7 @@ void MelonDsDs::CoreState::InitContent(unsigned type, std::span<const retro_game
             if (game.size() > 1) {
                 // If we got a GBA ROM...
                 retro_assert(game[1].data != nullptr);
-                _gbaInfo = game[1];
+                _gbaInfo.emplace(game[1], isPersistent(1));
             }
 
             [[fallthrough]];
@@ -750,7 +1949,15 @@ void MelonDsDs::CoreState::InitContent(unsigned type, std::span<const retro_game
                     throw content_exception("Failed to load the content data, the frontend may have a bug.");
                 }
 
-                _ndsInfo = game[0];
+                if (preloaded) {
+                    retro::info("Using preloaded content \"{}\"", preloaded->Path);
+                }
+                _ndsInfo.emplace(game[0], isPersistent(0), preloaded ? std::move(preloaded->Rom) : memory::SharedFileMapping());
+                retro::debug(
+                    "{} the {}-byte NDS ROM",
+                    _ndsInfo->IsMapped() ? "Mapped" : _ndsInfo->OwnsData() ? "Copied" : "Frontend keeps ownership of",
+                    game[0].size
+                );
             }
             break;
         default:
@@ -766,57 +1973,76 @@ bool MelonDsDs::CoreState::UpdateOptionVisibility() noexcept {
 
 /// Savestates in melonDS can vary in size depending on the game,
 /// so we have to try saving the state first before we can know how big it'll be.
-/// RetroArch may try to call this function before the ROM is installed
-/// if rewind mode is enabled
-size_t MelonDsDs::CoreState::SerializeSize() const noexcept {
+/// That's done once per console (unless this process already measured the same setup),
+/// since frontends expect retro_serialize_size to stay the same while the content is loaded.
+/// A size cached by an earlier process is never trusted on its own;
+/// if it were too small, every savestate, rewind, and run-ahead would fail for the whole session.
+void MelonDsDs::CoreState::InitSavestateSize() noexcept {
     ZoneScopedN(TracyFunction);
-    if (_messageScreen)
-        return 0;
-    // If there's an error, there's nothing to serialize
+    MemoryScope memory(MemoryTag::Savestate);
+    retro_assert(Console != nullptr);
 
-    if (!_savestateSize.has_value()) {
-        // If we haven't yet figured out how big the savestate should be...
+    if (static_cast<ConsoleType>(Console->ConsoleType) == ConsoleType::DSi) {
+        // DSi mode doesn't support savestates right now
+        _savestateSize = 0;
+        // TODO: When DSi mode supports savestates, remove this conditional block
+        return;
+    }
 
-        retro_assert(Console != nullptr);
-        if (static_cast<ConsoleType>(Console->ConsoleType) == ConsoleType::DSi) {
-            // DSi mode doesn't support savestates right now
-            _savestateSize = 0;
-            // TODO: When DSi mode supports savestates, remove this conditional block
-        }
-        else {
 #ifndef NDEBUG
-            if (_ndsInfo) {
-                // If we're booting with a ROM...
-
-                // Savestate size varies by several factors, but SRAM length is the big one.
-                // We won't know the size of the cart's SRAM until it's loaded,
-                // so we can't know the savestate size until then.
-                // We must ensure the cart is loaded before the frontend starts to ask about the savestate size!
-                retro_assert(Console->NDSCartSlot.GetCart() != nullptr);
-            }
+    if (_ndsInfo) {
+        // If we're booting with a ROM...
+
+        // Savestate size varies by several factors, but SRAM length is the big one.
+        // We won't know the size of the cart's SRAM until it's loaded,
+        // so we can't know the savestate size until then.
+        retro_assert(Console->NDSCartSlot.GetCart() != nullptr);
+    }
 #endif
 
-            melonDS::Savestate state;
-            Console->DoSavestate(&state);
-            size_t length = state.Length();
-            _savestateSize = length;
+    string key = GetSavestateSizeKey(*Console);
+    optional<size_t> cachedSize = GetCachedSavestateSize(key);
+    if (cachedSize && IsSavestateSizeVerified(key)) {
+        // If we've already measured savestates for this exact setup since the core was loaded...
+        _savestateSize = cachedSize;
+        retro::info("Savestate requires {}B (cached)", *cachedSize);
+        return;
+    }
 
-            retro::info(
-                "Savestate requires {}B = {}KiB = {}MiB (before compression)",
-                length,
-                length / 1024.0f,
-                length / 1024.0f / 1024.0f
-            );
-        }
+    melonDS::Savestate& state = ScratchSavestate();
+    Console->DoSavestate(&state);
+    size_t length = state.Length();
+    _savestateSize = length;
+    if (cachedSize && *cachedSize != length) {
+        // If an earlier session (most likely a different build) cached the wrong size...
+        retro::warn("Savestate size cache said {}B for {}, but it's actually {}B", *cachedSize, key, length);
     }
+    CacheSavestateSize(key, length);
 
-    retro_assert(_savestateSize.has_value());
+    // Measuring is rare, so don't hold on to a whole savestate we don't need
+    _scratchSavestate = nullptr;
 
-    return *_savestateSize;
+    retro::info(
+        "Savestate requires {}B = {}KiB = {}MiB (before compression)",
+        length,
+        length / 1024.0f,
+        length / 1024.0f / 1024.0f
+    );
+}
+
+/// RetroArch may try to call this function before the ROM is installed
+/// if rewind mode is enabled
+size_t MelonDsDs::CoreState::SerializeSize() const noexcept {
+    if (_messageScreen)
+        return 0;
+    // If there's an error, there's nothing to serialize
+
+    return _savestateSize.value_or(0);
 }
 
 bool MelonDsDs::CoreState::Serialize(std::span<std::byte> data) const noexcept {
     ZoneScopedN(TracyFunction);
+    MemoryScope memory(MemoryTag::Savestate);
     if (_messageScreen)
         return false;
 
@@ -834,29 +2060,36 @@ bool MelonDsDs::CoreState::Serialize(std::span<std::byte> data) const noexcept {
         return false;
     }
 
-    if (_savestateSize) {
-        // If we know how big the savestate for this game should be...
+    {
+        // Write straight into the frontend's buffer;
+        // it was sized with SerializeSize, so this should almost always fit.
         melonDS::Savestate state(data.data(), data.size(), true);
+        if (Console->DoSavestate(&state) && !state.Error) {
+            // If the savestate fit in the frontend's buffer...
+            TracyPlot("Savestate Size", static_cast<int64_t>(state.Length()));
+            if (state.Length() < data.size()) {
+                // ...then keep the unused end of it the same from one state to the next
+                memset(data.data() + state.Length(), 0, data.size() - state.Length());
+            }
 
-        return Console->DoSavestate(&state) && !state.Error;
+            return true;
+        }
     }
 
-    melonDS::Savestate state;
+    // The frontend's buffer was too small (most likely the cached size was wrong),
+    // so find out how big it should've been; the size can't change now, but the cache is fixed at unload
+    melonDS::Savestate& state = ScratchSavestate();
     Console->DoSavestate(&state);
-    size_t length = state.Length();
-    _savestateSize = length;
-
-    if (_savestateSize != data.size()) {
-        retro::error("Expected to save a {}-byte savestate, got a {}-byte buffer", *_savestateSize, data.size());
-        return false;
-    }
+    _measuredSavestateSize = state.Length();
+    _scratchSavestate = nullptr;
 
-    memcpy(data.data(), state.Buffer(), state.Length());
-    return true;
+    retro::error("Expected to save a {}-byte savestate, got a {}-byte buffer", *_measuredSavestateSize, data.size());
+    return false;
 }
 
 bool MelonDsDs::CoreState::Unserialize(std::span<const std::byte> data) noexcept {
     ZoneScopedN(TracyFunction);
+    MemoryScope memory(MemoryTag::Savestate);
     if (_messageScreen)
         return false;
 
@@ -876,8 +2109,8 @@ bool MelonDsDs::CoreState::Unserialize(std::span<const std::byte> data) noexcept
     }
 
     if (!_savestateSize) {
-        // If the frontend hasn't asked us about the savestate size yet...
-        _savestateSize = SerializeSize();
+        retro::error("Can't load a savestate before the console is started");
+        return false;
     }
 
     if (data.size() != _savestateSize) {
@@ -915,7 +2148,23 @@ bool MelonDsDs::CoreState::Unserialize(std::span<const std::byte> data) noexcept
         return false;
     }
 
-    return Console->DoSavestate(&savestate) && !savestate.Error;
+    _unserializing = true;
+    bool loaded = Console->DoSavestate(&savestate) && !savestate.Error;
+    _unserializing = false;
+    return loaded;
+}
+
+melonDS::Savestate& MelonDsDs::CoreState::ScratchSavestate() const noexcept {
+    if (!_scratchSavestate) {
+        _scratchSavestate = std::make_unique<melonDS::Savestate>();
+    }
+    else {
+        // Keep the buffer (and its capacity), but start over
+        _scratchSavestate->Rewind(true);
+        _scratchSavestate->Error = false;
+    }
+
+    return *_scratchSavestate;
 }
 
 std::byte* MelonDsDs::CoreState::GetMemoryData(unsigned id) noexcept {
@@ -928,7 +2177,8 @@ std::byte* MelonDsDs::CoreState::GetMemoryData(unsigned id) noexcept {
             retro_assert(Console != nullptr);
             return reinterpret_cast<std::byte*>(Console->MainRAM);
         case RETRO_MEMORY_SAVE_RAM:
-            return _ndsSaveManager ? reinterpret_cast<std::byte*>(_ndsSaveManager->Sram()) : nullptr;
+            // If we're writing SRAM ourselves, don't let the frontend load or save it too
+            return _ndsSaveManager && !_ndsSaveManager->IsDirect() ? reinterpret_cast<std::byte*>(_ndsSaveManager->Sram()) : nullptr;
         default:
             return nullptr;
     }
@@ -953,7 +2203,7 @@ size_t MelonDsDs::CoreState::GetMemorySize(unsigned id) const noexcept {
             }
         }
         case RETRO_MEMORY_SAVE_RAM:
-            return _ndsSaveManager ? _ndsSaveManager->SramLength() : 0;
+            return _ndsSaveManager && !_ndsSaveManager->IsDirect() ? _ndsSaveManager->SramLength() : 0;
         default:
             return 0;
     }
@@ -964,10 +2214,8 @@ void MelonDsDs::CoreState::CheatReset() noexcept
     ZoneScopedN(TracyFunction);
     retro::debug("retro_cheat_reset()\n");
 
-    if (Console)
-    {
-        Console->AREngine.Cheats.clear();
-    }
+    _cheats.clear();
+    _cheatsChanged = true;
 }
 
 void MelonDsDs::CoreState::CheatSet(unsigned index, bool enabled, std::string_view code) noexcept {
@@ -976,15 +2224,6 @@ void MelonDsDs::CoreState::CheatSet(unsigned index, bool enabled, std::string_vi
     if (code.empty())
         return;
 
-    if (!Console)
-        return;
-
-    if (!regex_match(code.cbegin(), code.cend(), _cheatSyntax)) {
-        // If we're trying to activate this cheat code, but it's not valid...
-        retro::set_warn_message("Cheat #{} ({:.8}...) isn't valid, ignoring it.", index, code);
-        return;
-    }
-
     melonDS::ARCode curcode {
         .Name = string(code),
         .Enabled = enabled,
@@ -992,22 +2231,39 @@ void MelonDsDs::CoreState::CheatSet(unsigned index, bool enabled, std::string_vi
     };
 
     // NDS cheats are sequence of unsigned 32-bit integers, each of which is hex-encoded
-    auto end = std::cregex_iterator();
-    for (auto i = std::cregex_iterator(code.cbegin(), code.cend(), _tokenSyntax); i != end; ++i) {
-        const std::csub_match& match = (*i)[0];
-        retro_assert(match.matched);
-        uint32_t token = 0;
-        std::from_chars_result result = std::from_chars(match.first, match.second, token, 16);
-        retro_assert(result.ec == std::errc());
-        curcode.Code.push_back(token);
+    if (!ParseCheatCode(code, curcode.Code) || !ValidateCheatCode(curcode.Code)) {
+        // If we're trying to activate this cheat code, but it's not valid...
+        retro::set_warn_message("Cheat #{} ({:.8}...) isn't valid, ignoring it.", index, code);
+        return;
     }
 
-    if (index < Console->AREngine.Cheats.size())
+    if (index < _cheats.size())
     { // If we're updating the state of a cheat that already exists...
-        Console->AREngine.Cheats[index] = std::move(curcode);
+        _cheats[index] = std::move(curcode);
     }
     else
     { // If we're adding a new cheat...
-        Console->AREngine.Cheats.push_back(std::move(curcode));
+        _cheats.push_back(std::move(curcode));
+    }
+
+    _cheatsChanged = true;
+}
+
+void MelonDsDs::CoreState::PublishCheats() noexcept {
+    ZoneScopedN(TracyFunction);
+    retro_assert(Console != nullptr);
+
+    // The engine checks each code's Enabled flag every frame,
+    // so leaving the disabled ones out spares it the work.
+    // It doesn't use the names either, so those stay here.
+    std::vector<melonDS::ARCode>& active = Console->AREngine.Cheats;
+    active.clear();
+    for (const melonDS::ARCode& cheat : _cheats) {
+        if (cheat.Enabled) {
+            active.push_back({ .Name = {}, .Enabled = true, .Code = cheat.Code });
+        }
     }
+
+    retro::debug("Installed {} enabled cheat codes ({} in total)", active.size(), _cheats.size());
+    _cheatsChanged = false;
 }
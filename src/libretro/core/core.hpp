@@ -17,25 +17,50 @@
 #ifndef MELONDSDS_CORE_HPP
 #define MELONDSDS_CORE_HPP
 
+#include <array>
+#include <atomic>
 #include <cstddef>
 #include <libretro.h>
 #include <memory>
-#include <regex>
 
 #include <NDS.h>
 
+#include "../config/changes.hpp"
 #include "../config/config.hpp"
+#include "../config/jitprofile.hpp"
+#include "../config/presets.hpp"
+#include "../config/sysfiles.hpp"
 #include "../config/visibility.hpp"
 #include "../message/error.hpp"
 #include "../microphone.hpp"
+#include "../platform/memory.hpp"
 #include "../render/render.hpp"
 #include "../retro/info.hpp"
+#include "../retro/threadpool.hpp"
 #include "../screenlayout.hpp"
 #include "../PlatformOGLPrivate.h"
 #include "../sram.hpp"
 #include "net/net.hpp"
 #include "net/mp.hpp"
+#ifdef HAVE_MP_SHARED_MEMORY
+#include "net/shm.hpp"
+#endif
+#include "std/chrono.hpp"
 #include "std/span.hpp"
+#include "audio.hpp"
+#include "benchmark.hpp"
+#include "framehash.hpp"
+#include "jittuner.hpp"
+#include "preload.hpp"
+#include "replay.hpp"
+#include "resampler.hpp"
+#include "savewriter.hpp"
+#include "scheduler.hpp"
+#ifdef HAVE_ZLIB
+#include "rewind.hpp"
+#include "statefile.hpp"
+#endif
+#include "timing.hpp"
 
 struct retro_game_info;
 struct retro_system_av_info;
@@ -64,7 +89,7 @@ namespace MelonDsDs {
 
     class CoreState {
     public:
-        CoreState() noexcept = default;
+        CoreState() noexcept;
         ~CoreState() noexcept;
         CoreState(const CoreState&) = delete;
         CoreState& operator=(const CoreState&) = delete;
@@ -80,8 +105,22 @@ namespace MelonDsDs {
         size_t SerializeSize() const noexcept;
         [[gnu::hot]] bool Serialize(std::span<std::byte> data) const noexcept;
         bool Unserialize(std::span<const std::byte> data) noexcept;
+        /// Loads a savestate from disk, either a plain \c retro_serialize buffer or (if supported) a compressed savestate file.
+        [[gnu::cold]] bool LoadSavestateFile(const std::string& path) noexcept;
+#ifdef HAVE_ZLIB
+        /// Snapshots the console and queues it to be compressed and written to \c path in the background.
+        [[gnu::cold]] bool SaveStateFile(const std::string& path) noexcept;
+        /// Waits for every queued savestate file to be written; \c false if any failed.
+        bool WaitForStateFiles() noexcept { return _stateFiles.Wait(); }
+#endif
+        /// Starts reading \c path (and the system files it needs) in the background for the next \c LoadGame.
+        bool PreloadContent(std::string_view path) noexcept { return _preloader.Begin(path, Config); }
+        void CancelPreload() noexcept { _preloader.Cancel(); }
+        [[nodiscard]] melondsds_preload_status GetPreloadStatus() noexcept { return _preloader.Status(); }
         void CheatReset() noexcept;
         void CheatSet(unsigned index, bool enabled, std::string_view code) noexcept;
+        /// The number of valid cheats the frontend has set, whether or not they're enabled.
+        [[nodiscard]] size_t CheatCount() const noexcept { return _cheats.size(); }
         bool LoadGame(unsigned type, std::span<const retro_game_info> game) noexcept;
         void UnloadGame() noexcept;
         std::byte* GetMemoryData(unsigned id) noexcept;
@@ -94,81 +133,279 @@ namespace MelonDsDs {
         void MpStarted(retro_netpacket_send_t send, retro_netpacket_poll_receive_t poll_receive) noexcept;
         void MpPacketReceived(const void *buf, size_t len, uint16_t client_id) noexcept;
         void MpStopped() noexcept;
-        bool MpSendPacket(const Packet &p) noexcept;
-        std::optional<Packet> MpNextPacket() noexcept;
-        std::optional<Packet> MpNextPacketBlock() noexcept;
+        bool MpSendPacket(std::span<const uint8_t> data, uint64_t timestamp, uint8_t aid, Packet::Type type) noexcept;
+        const Packet* MpNextPacket() noexcept;
+        const Packet* MpNextPacketBlock() noexcept;
+        void MpPopPacket() noexcept;
+        uint16_t MpRecvReplies(uint8_t* packets, uint64_t timestamp, uint16_t aidmask) noexcept;
         bool MpActive() const noexcept;
 
+        /// Sends the frontend's audio thread whatever's waiting in the audio ring.
+        [[gnu::hot]] void PullAudio() noexcept;
+        void SetAudioCallbackState(bool enabled) noexcept;
+
         void WriteNdsSave(std::span<const std::byte> savedata, uint32_t writeoffset, uint32_t writelen) noexcept;
         void WriteGbaSave(std::span<const std::byte> savedata, uint32_t writeoffset, uint32_t writelen) noexcept;
         void WriteFirmware(const melonDS::Firmware& firmware, uint32_t writeoffset, uint32_t writelen) noexcept;
+        void RumbleStart(std::chrono::milliseconds len) noexcept;
+        void RumbleStop() noexcept;
         bool UpdateOptionVisibility() noexcept;
 
         const melonDS::NDS* GetConsole() const noexcept { return Console.get(); }
         [[nodiscard]] const InputState& GetInputState() const noexcept { return _inputState; }
         [[nodiscard]] InputState& GetInputState() noexcept { return _inputState; }
+        [[nodiscard]] const MicrophoneState& GetMicrophoneState() const noexcept { return _micState; }
         std::optional<RenderMode> GetRenderMode() const noexcept { return _renderState.GetRenderMode(); }
+        [[nodiscard]] unsigned GetGlCallsLastFrame() const noexcept { return _renderState.GlCallsLastFrame(); }
+        void SetFrameReadbackEnabled(bool enabled) noexcept { _renderState.SetFrameReadbackEnabled(enabled); }
+        [[nodiscard]] std::optional<uint32_t> GetLastFrameChecksum() const noexcept { return _renderState.LastFrameChecksum(); }
+        void SetSeparateScreenOutput(bool enabled) noexcept { _renderState.SetSeparateScreenOutput(enabled); }
+        bool SetNv12Output(bool enabled) noexcept { return _renderState.SetNv12Output(enabled); }
+        [[nodiscard]] const Nv12Frame* GetLastNv12Frame() const noexcept { return _renderState.LastNv12Frame(); }
+        [[nodiscard]] const std::optional<FrameHashLog>& GetFrameHashLog() const noexcept { return _frameHashes; }
+        [[nodiscard]] memory::HugePageStatus GetMainRamHugePageStatus() const noexcept { return _mainRamHugePages; }
         const ScreenLayoutData& GetScreenLayoutData() const noexcept { return _screenLayout; }
+        [[nodiscard]] const FrameTimings& GetFrameTimings() const noexcept { return _frameTimings; }
+#ifdef HAVE_ZLIB
+        [[nodiscard]] RewindBuffer& GetRewindBuffer() noexcept { return _rewind; }
+        /// Loads the previous rewind snapshot, as if the rewind button were held for a frame.
+        void StepBackRewind() noexcept;
+#endif
+
+        /// The audio ring's telemetry, or \c nullopt if the frontend isn't pulling audio through a callback.
+        [[nodiscard]] std::optional<AudioRingStats> GetAudioRingStats() const noexcept;
     private:
-        static constexpr auto REGEX_OPTIONS = std::regex_constants::ECMAScript | std::regex_constants::optimize;
-        [[gnu::cold]] void ApplyConfig(const CoreConfig& config) noexcept;
-        [[gnu::cold]] bool RunDeferredInitialization() noexcept;
+        /// Parses the core options into \c Config, then applies the battery saver if it's active.
+        void ReparseConfig() noexcept;
+        [[gnu::cold]] void ApplyConfig(const CoreConfig& config, ConfigSubsystem changed = ConfigSubsystem::All) noexcept;
         [[gnu::cold]] void InstallNdsSram() noexcept;
         [[gnu::cold]] void StartConsole();
+        /// Looks up or measures the size of this console's savestates, which then stays fixed until the console is replaced.
+        [[gnu::cold]] void InitSavestateSize() noexcept;
+        [[gnu::cold]] void StartBenchmark() noexcept;
+        /// Decides whether frameskip should skip composing this frame, and counts the skip if so.
+        bool ShouldSkipFrame() noexcept;
+        /// Sleeps through the rest of a frame's time budget while the lid is closed.
+        void IdleWhileLidClosed(FrameTimings::clock::duration frameTime) noexcept;
+        /// False while something depends on every emulated frame being a real one
+        /// (e.g. local multiplayer, an input recording, or frame hashes).
+        [[nodiscard]] bool CanRunAhead() const noexcept;
+        /// Snapshots the console, then emulates \c frames hidden frames with the same input.
+        /// @returns \c false (and runs nothing) if the console couldn't be snapshotted.
+        bool RunAhead(melonDS::NDS& nds, unsigned frames) noexcept;
+        /// Rolls the console back to the snapshot taken by \c RunAhead and discards the hidden frames' audio.
+        void EndRunAhead(melonDS::NDS& nds) noexcept;
+        [[gnu::cold]] void StartInputRecording(melonDS::NDS& nds) noexcept;
+        /// Records this frame's console input, or overrides it with the replay's.
+        void UpdateInputRecording(melonDS::NDS& nds) noexcept;
+        void PublishCheats() noexcept;
         [[gnu::cold]] void SetConsoleTime(melonDS::NDS& nds) noexcept;
+        /// The time that the RTC should start at, according to the start time options.
+        [[nodiscard]] local_seconds ConfiguredStartTime() const noexcept;
         [[gnu::cold]] void SetConsoleTime(melonDS::NDS& nds, local_seconds time) noexcept;
+        /// Returns \c _scratchSavestate, ready to be saved into.
+        [[nodiscard]] melonDS::Savestate& ScratchSavestate() const noexcept;
         [[gnu::cold]] void UninstallDsiware(melonDS::DSi_NAND::NANDImage& nand) noexcept;
-        [[gnu::cold]] static void ExportDsiwareSaveData(
+        [[gnu::cold]] void ExportDsiwareSaveData(
             melonDS::DSi_NAND::NANDMount& nand,
             const retro::GameInfo& nds_info,
             const melonDS::NDSHeader& header,
             int type
         ) noexcept;
-        [[gnu::hot]] static void RenderAudio(melonDS::NDS& nds) noexcept;
+        [[gnu::hot]] void RenderAudio(melonDS::NDS& nds) noexcept;
+
+        /// How full the audio buffer that matters right now is, as a percentage;
+        /// the core's own ring if the frontend pulls audio through a callback, or else the frontend's buffer.
+        /// \c nullopt if the frontend doesn't report its buffer's state.
+        [[nodiscard]] std::optional<unsigned> AudioBufferFill() const noexcept;
         [[gnu::cold]] bool InitErrorScreen(const config_exception& e) noexcept;
         [[gnu::cold]] void RenderErrorScreen() noexcept;
         [[gnu::cold]] void InitContent(unsigned type, std::span<const retro_game_info> game);
 
         const melonDS::AdapterData* SelectNetworkInterface(std::span<const melonDS::AdapterData> adapters) const noexcept;
+        void RefreshNetworkAdapters() noexcept;
+        void RefreshSystemFiles() noexcept;
 
-        retro::task::TaskSpec PowerStatusUpdateTask() noexcept;
+        void InitTimers() noexcept;
+        unsigned UpdatePowerStatus() noexcept;
+        /// Turns the battery saver on or off (and reapplies the config) if the host's battery status calls for it.
+        void UpdateBatterySaver(const retro_device_power& devicePower) noexcept;
+        /// Starts reading the host's light sensor on a timer if the solar sensor uses it, or stops if not.
+        void ScheduleSolarSensor() noexcept;
+#ifdef HAVE_ZLIB
+        /// False while something else depends on every frame happening exactly once
+        /// (e.g. local multiplayer or an input recording).
+        [[nodiscard]] bool CanRewind() const noexcept;
+        /// @returns The number of frames until the next snapshot, or 0 if rewinding is disabled.
+        unsigned TakeRewindSnapshot() noexcept;
+#endif
         retro::task::TaskSpec OnScreenDisplayTask() noexcept;
-        retro::task::TaskSpec FlushGbaSramTask() noexcept;
         void FlushGbaSram(const retro::GameInfo& gbaSaveInfo) noexcept;
-        retro::task::TaskSpec FlushFirmwareTask(string_view firmwareName) noexcept;
-        void InitFlushFirmwareTask() noexcept;
+        void InitFirmwareFlush() noexcept;
         void FlushFirmware(string_view firmwarePath, string_view wfcSettingsPath) noexcept;
+        void FlushSaveData() noexcept;
+        [[gnu::cold]] void InitGameSettings() noexcept;
+        /// In low-memory mode, frees our copies of the loaded content now that the console has its own.
+        /// @returns The number of bytes freed.
+        size_t ReleaseContent() noexcept;
+        /// Reads back any content freed by \c ReleaseContent, so that a new console can be created from it.
+        [[gnu::cold]] void ReloadContent();
+        /// Asks the OS to back the new console's main RAM with huge pages.
+        void AdviseHugePages() noexcept;
+        /// Tells the frontend where the new console's RAM is, since each console allocates its own.
+        void PublishMemoryMaps() noexcept;
+#ifdef HAVE_JIT
+        void UpdateJitTuner(melonDS::NDS& nds) noexcept;
+#endif
+#ifdef HAVE_TRACE_RECORDER
+        [[gnu::cold]] void SaveTrace() noexcept;
+#endif
         [[gnu::cold]] void InitNdsSave(const NdsCart &nds_cart);
+        void StartMp(retro_netpacket_send_t send, retro_netpacket_poll_receive_t poll_receive) noexcept;
+        void StopMp() noexcept;
+#ifdef HAVE_MP_SHARED_MEMORY
+        [[gnu::cold]] void StartSharedMemoryMp() noexcept;
+        [[gnu::cold]] void StopSharedMemoryMp() noexcept;
+#endif
 
+        // Declared first so it outlives everything that might have work queued on it
+        retro::ThreadPool _threadPool;
         std::unique_ptr<melonDS::NDS> Console = nullptr;
         NetState _netState;
+        SystemFileIndex _systemFiles;
         CoreConfig Config {};
         CoreOptionVisibility _optionVisibility {};
+        OptionChangeTracker _optionChanges {};
         ScreenLayoutData _screenLayout {};
         InputState _inputState {};
         MicrophoneState _micState {};
         RenderStateWrapper _renderState {};
         MpState _mpState {};
+#ifdef HAVE_MP_SHARED_MEMORY
+        // Used instead of the frontend's netpacket interface if the player chose the shared-memory transport
+        ShmTransport _shmTransport {};
+#endif
+        FrameTimings _frameTimings {};
+        // The performance overlay is only rebuilt a few times per second so that it's readable
+        std::string _performanceOverlay {};
+        FrameTimings::clock::time_point _performanceOverlayTime {};
+        uint32_t _performanceOverlayFrame = 0;
+
+        /// Everything shown in the on-screen display, as precise as it's displayed;
+        /// the message is only rebuilt when this changes.
+        struct OsdState {
+            glm::i16vec2 PointerRaw {};
+            glm::ivec2 PointerTouch {};
+            glm::ivec2 JoystickTouch {};
+            bool MicActive = false;
+            bool MicLit = false;
+            unsigned LayoutIndex = 0;
+            unsigned NumberOfLayouts = 0;
+            bool LidClosed = false;
+            int LightLevel = -1;
+            int LuxTenths = -1;
+            // Bumped a few times per second while any timings or stats are shown
+            uint32_t TelemetryGeneration = 0;
+
+            bool operator==(const OsdState&) const noexcept = default;
+        };
+        std::optional<OsdState> _osdState = std::nullopt;
+        std::string _osdMessage {};
+        uint32_t _osdMessageFrame = 0;
+        FrameTimings::clock::time_point _osdTelemetryTime {};
+        uint32_t _osdTelemetryGeneration = 0;
+        AudioRateControl _audioRateControl {};
+        std::optional<AudioResampler> _resampler = std::nullopt;
+        SpuAudioRing _audioRing {};
+        // True if the frontend accepted our audio callback for this session
+        bool _audioCallbackRegistered = false;
+        // Set when the frontend resumes audio, so the reader can drop whatever piled up while it was paused
+        std::atomic_bool _audioRingStale = false;
+        std::optional<Benchmark> _benchmark = std::nullopt;
+        std::optional<InputRecording> _inputRecording = std::nullopt;
+        std::optional<FrameHashLog> _frameHashes = std::nullopt;
+        // Reused every frame while _frameHashes is set, so that it doesn't allocate
+        std::vector<FrameChecksum> _frameChecksums;
+        // Empty if the game has no game code of its own (e.g. homebrew)
+        std::optional<std::string> _gameKey = std::nullopt;
+        std::optional<JitProfile> _jitProfile = std::nullopt;
+        std::optional<GamePreset> _gamePreset = std::nullopt;
+        // Only set while the current game's block size is being tuned
+        std::optional<JitTuner> _jitTuner = std::nullopt;
+        // The config that Console was created with, used to decide whether a reset needs a new console
+        std::optional<CoreConfig> _consoleConfig = std::nullopt;
+        memory::HugePageStatus _mainRamHugePages = memory::HugePageStatus::Unsupported;
+        // Main RAM, shared WRAM, and ARM7 WRAM; kept here in case the frontend doesn't copy them
+        std::array<retro_memory_descriptor, 3> _memoryDescriptors {};
+        // The screen layout generation that the renderer was last refreshed for
+        uint32_t _refreshedLayoutGeneration = 0;
+        // True if the host's battery was low enough for the battery saver at the last power status update
+        bool _batterySaverActive = false;
+        // How many frames in a row have ended with the emulated lid closed
+        unsigned _lidClosedFrames = 0;
+        // How many frames in a row have been skipped by frameskip
+        unsigned _skippedFrames = 0;
+        // How long (in ms) the most recent frame that wasn't skipped took, composition included
+        float _lastComposedFrameTime = 0;
         std::optional<retro::GameInfo> _ndsInfo = std::nullopt;
         std::optional<retro::GameInfo> _gbaInfo = std::nullopt;
         std::optional<retro::GameInfo> _gbaSaveInfo = std::nullopt;
         std::optional<sram::SaveManager> _ndsSaveManager = std::nullopt;
         std::optional<sram::SaveManager> _gbaSaveManager = std::nullopt;
-        std::optional<int> _timeToGbaFlush = std::nullopt;
-        std::optional<int> _timeToFirmwareFlush = std::nullopt;
-        mutable std::optional<size_t> _savestateSize = std::nullopt;
+        FrameScheduler _scheduler {};
+        // Each save timer is pushed back with every write,
+        // so a burst of writes ends up as one batch of disk writes
+        FrameScheduler::TimerId _ndsFlushTimer = FrameScheduler::INVALID_TIMER;
+        FrameScheduler::TimerId _gbaFlushTimer = FrameScheduler::INVALID_TIMER;
+        FrameScheduler::TimerId _firmwareFlushTimer = FrameScheduler::INVALID_TIMER;
+        FrameScheduler::TimerId _powerStatusTimer = FrameScheduler::INVALID_TIMER;
+        FrameScheduler::TimerId _rumbleTimer = FrameScheduler::INVALID_TIMER;
+        FrameScheduler::TimerId _solarSensorTimer = FrameScheduler::INVALID_TIMER;
+#ifdef HAVE_ZLIB
+        FrameScheduler::TimerId _rewindTimer = FrameScheduler::INVALID_TIMER;
+#endif
+        // Empty if the system directory couldn't be found
+        std::string _firmwareFlushPath {};
+        std::string _wfcSettingsFlushPath {};
+        // Set when the emulated system writes to its firmware, since there's nothing to flush until then
+        bool _firmwareDirty = false;
+        // The cores that the frontend's emulation thread was last moved to
+        ThreadPlacement _emulationThreadPlacement = ThreadPlacement::Any;
+        SaveWriter _saveWriter;
+        // Outlives LoadGame and UnloadGame, since the next game is preloaded while the current one runs
+        ContentPreloader _preloader;
+#ifdef HAVE_ZLIB
+        StateFileWriter _stateFiles;
+        RewindBuffer _rewind;
+#endif
+        // Settled once per console, since retro_serialize_size must not change while the content is loaded
+        std::optional<size_t> _savestateSize = std::nullopt;
+        // What a savestate actually needed, if it didn't fit in _savestateSize; written to the size cache later
+        mutable std::optional<size_t> _measuredSavestateSize = std::nullopt;
+        // The real frame that run-ahead rolls back to; reused every frame
+        std::vector<std::byte> _runAheadState {};
+        // Only allocated while we need a savestate of our own (e.g. to measure one),
+        // since melonDS's default buffer is several MiB that would otherwise sit unused
+        mutable std::unique_ptr<melonDS::Savestate> _scratchSavestate = nullptr;
+        // True while a savestate is being loaded, so the SRAM it restores can be compared to what we already have
+        bool _unserializing = false;
+        // The largest frame we've told the frontend to expect, as of the last GetSystemAvInfo
+        mutable glm::uvec2 _reportedMaxSize {0};
         bool _syncClock = false;
         std::unique_ptr<error::ErrorScreen> _messageScreen = nullptr;
-        // TODO: Switch to compile time regular expressions (see https://compile-time.re)
-        std::regex _cheatSyntax { "^\\s*[0-9A-Fa-f]{8}([+\\s-]*[0-9A-Fa-f]{8})*$", REGEX_OPTIONS };
-        std::regex _tokenSyntax { "[0-9A-Fa-f]{8}", REGEX_OPTIONS };
+        // Every valid cheat the frontend has set (enabled or not), already decoded and validated.
+        // Indexed by the frontend's cheat index.
+        std::vector<melonDS::ARCode> _cheats {};
+
+        // Frontends set cheats one at a time in a burst (usually right after a reset),
+        // so only the enabled ones are given to the Action Replay engine, all at once at the start of the next frame.
+        // With none enabled, the engine has nothing to run.
+        bool _cheatsChanged = false;
         // This object is meant to be stored in a placement-new'd byte array,
         // so having this flag lets us detect if the core has been initialized
         // regardless of the state of the underlying resources
         const bool _initialized = true;
         bool _ndsSramInstalled = false;
-        bool _deferredInitializationPending = false;
-        uint32_t _flushTaskId = 0;
     };
 }
 #endif //MELONDSDS_CORE_HPP
@@ -0,0 +1,169 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "framehash.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <memory>
+
+#include <fmt/format.h>
+#include <streams/file_stream.h>
+#include <string/stdstring.h>
+
+#include "environment.hpp"
+#include "tracy.hpp"
+
+using std::optional;
+using std::nullopt;
+using std::string;
+
+namespace {
+    // Plain text so that two logs can be diffed:
+    // a header line, then one "<frame> <crc32 in hex>" line per frame.
+    constexpr const char* HEADER = "# melonDS DS frame checksums v1";
+}
+
+optional<MelonDsDs::FrameHashLog> MelonDsDs::FrameHashLog::FromEnvironment() noexcept {
+    const char* verifyVar = getenv("MELONDSDS_FRAME_HASH_VERIFY");
+    const char* recordVar = getenv("MELONDSDS_FRAME_HASH_RECORD");
+    if (!string_is_empty(verifyVar)) {
+        if (!string_is_empty(recordVar)) {
+            retro::warn("Both MELONDSDS_FRAME_HASH_VERIFY and MELONDSDS_FRAME_HASH_RECORD are set; only verifying");
+        }
+
+        FrameHashLog log(verifyVar, true);
+        if (!log.Load())
+            return nullopt;
+
+        retro::info("Will verify frames against {} checksums from {}", log._checksums.size(), verifyVar);
+        return log;
+    }
+
+    if (!string_is_empty(recordVar)) {
+        retro::info("Will record frame checksums to {}", recordVar);
+        return FrameHashLog(recordVar, false);
+    }
+
+    return nullopt;
+}
+
+bool MelonDsDs::FrameHashLog::Load() noexcept {
+    ZoneScopedN(TracyFunction);
+    void* buffer = nullptr;
+    int64_t length = 0;
+    if (!filestream_read_file(_path.c_str(), &buffer, &length) || !buffer) {
+        retro::error("Failed to read frame checksums from {}", _path);
+        return false;
+    }
+
+    // filestream_read_file null-terminates the buffer
+    std::unique_ptr<void, decltype(&free)> owner(buffer, &free);
+    const char* text = static_cast<const char*>(buffer);
+    if (!string_starts_with(text, HEADER)) {
+        retro::error("{} isn't a frame checksum log", _path);
+        return false;
+    }
+
+    const char* line = strchr(text, '\n');
+    while (line && *++line) {
+        // For each line after the header...
+        unsigned long long frame = 0;
+        unsigned checksum = 0;
+        if (sscanf(line, "%llu %x", &frame, &checksum) != 2) {
+            retro::error("Malformed line in frame checksum log {}", _path);
+            return false;
+        }
+
+        if (!_checksums.empty() && frame <= _checksums.back().Frame) {
+            retro::error("Frame checksum log {} isn't in order (frame {} after {})", _path, frame, _checksums.back().Frame);
+            return false;
+        }
+
+        _checksums.push_back({frame, checksum});
+        line = strchr(line, '\n');
+    }
+
+    return true;
+}
+
+void MelonDsDs::FrameHashLog::Update(std::span<const FrameChecksum> checksums) noexcept {
+    if (!_verifying) {
+        _checksums.insert(_checksums.end(), checksums.begin(), checksums.end());
+        _frames += checksums.size();
+        return;
+    }
+
+    for (const FrameChecksum& actual : checksums) {
+        while (_next < _checksums.size() && _checksums[_next].Frame < actual.Frame) {
+            // Skip recorded frames that weren't read back this time
+            ++_next;
+        }
+
+        if (_next >= _checksums.size() || _checksums[_next].Frame != actual.Frame)
+            continue; // This frame wasn't read back when recording, so there's nothing to compare it to
+
+        const FrameChecksum& expected = _checksums[_next++];
+        ++_frames;
+        if (expected.Checksum != actual.Checksum) [[unlikely]] {
+            if (!_firstMismatch) {
+                retro::error(
+                    "Frame {} doesn't match its recorded checksum (expected {:08x}, got {:08x})",
+                    actual.Frame, expected.Checksum, actual.Checksum
+                );
+                _firstMismatch = actual.Frame;
+            }
+            ++_mismatches;
+        }
+    }
+}
+
+bool MelonDsDs::FrameHashLog::Finish() const noexcept {
+    ZoneScopedN(TracyFunction);
+    if (_verifying) {
+        if (_firstMismatch) {
+            retro::error(
+                "{} of {} verified frames didn't match {}; the first was frame {}",
+                _mismatches, _frames, _path, *_firstMismatch
+            );
+        }
+        else {
+            retro::info("All {} verified frames matched {}", _frames, _path);
+        }
+
+        if (_next < _checksums.size()) {
+            retro::warn("{} recorded frames were never reached", _checksums.size() - _next);
+        }
+        return true;
+    }
+
+    string out = fmt::format("{}\n", HEADER);
+    out.reserve(out.size() + _checksums.size() * 20);
+    for (const FrameChecksum& checksum : _checksums) {
+        fmt::format_to(std::back_inserter(out), "{} {:08x}\n", checksum.Frame, checksum.Checksum);
+    }
+
+    if (!filestream_write_file(_path.c_str(), out.data(), out.size())) {
+        retro::error("Failed to write frame checksums to {}", _path);
+        return false;
+    }
+
+    retro::info("Wrote {} frame checksums to {}", _checksums.size(), _path);
+    return true;
+}
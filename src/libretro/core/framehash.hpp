@@ -0,0 +1,76 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#ifndef MELONDSDS_CORE_FRAMEHASH_HPP
+#define MELONDSDS_CORE_FRAMEHASH_HPP
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "render/render.hpp"
+
+namespace MelonDsDs {
+    /// Checksums every presented frame so that optimizations can be checked for visual differences.
+    /// Configured through environment variables, like \c Benchmark:
+    ///
+    /// - \c MELONDSDS_FRAME_HASH_RECORD: Path to write each frame's checksum to when the game is unloaded.
+    /// - \c MELONDSDS_FRAME_HASH_VERIFY: Path of checksums recorded earlier;
+    ///   each frame is compared to its recorded counterpart, and the first mismatch is reported.
+    ///
+    /// Both runs need to see the same input, so pair this with an input replay (see \c InputRecording).
+    /// Frames are numbered from when the game was loaded; with OpenGL,
+    /// frames that couldn't be read back without stalling are skipped.
+    class FrameHashLog {
+    public:
+        /// Returns \c nullopt if frame hashing isn't enabled.
+        static std::optional<FrameHashLog> FromEnvironment() noexcept;
+
+        [[nodiscard]] bool Verifying() const noexcept { return _verifying; }
+
+        /// Records or checks the given checksums, which must be in order.
+        void Update(std::span<const FrameChecksum> checksums) noexcept;
+
+        /// The number of frames that were recorded, or that had a recorded counterpart to compare to.
+        [[nodiscard]] uint64_t Frames() const noexcept { return _frames; }
+
+        /// The first frame that didn't match its recorded checksum, if any.
+        [[nodiscard]] std::optional<uint64_t> FirstMismatch() const noexcept { return _firstMismatch; }
+
+        /// Writes the recorded checksums (if recording) or logs the verification results.
+        /// \returns \c false if recording and the checksums couldn't be written.
+        bool Finish() const noexcept;
+    private:
+        FrameHashLog(std::string path, bool verifying) noexcept : _path(std::move(path)), _verifying(verifying) {}
+        bool Load() noexcept;
+
+        std::string _path;
+        bool _verifying;
+        // Recorded checksums if recording, or the ones to compare against if verifying
+        std::vector<FrameChecksum> _checksums;
+        // Index of the next checksum in _checksums to compare against
+        size_t _next = 0;
+        uint64_t _frames = 0;
+        uint64_t _mismatches = 0;
+        std::optional<uint64_t> _firstMismatch;
+    };
+}
+
+#endif // MELONDSDS_CORE_FRAMEHASH_HPP
@@ -0,0 +1,72 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "jittuner.hpp"
+
+#include <algorithm>
+
+#include "tracy.hpp"
+
+MelonDsDs::JitTuner::JitTuner() noexcept {
+    _samples.reserve(MEASURE_FRAMES);
+}
+
+unsigned MelonDsDs::JitTuner::Current() const noexcept {
+    return Done() ? CANDIDATES[_winner] : CANDIDATES[_candidate];
+}
+
+std::optional<unsigned> MelonDsDs::JitTuner::EndFrame(float runFrameTime) noexcept {
+    ZoneScopedN(TracyFunction);
+    if (Done()) {
+        return std::nullopt;
+    }
+
+    if (_delay > 0) {
+        // If we're still waiting for the game to get past its boot sequence...
+        if (--_delay == 0) {
+            return CANDIDATES[_candidate];
+        }
+        return std::nullopt;
+    }
+
+    if (++_frame <= WARMUP_FRAMES) {
+        // Don't count the frames where the JIT is recompiling everything
+        return std::nullopt;
+    }
+
+    _samples.push_back(runFrameTime);
+    if (_samples.size() < MEASURE_FRAMES) {
+        return std::nullopt;
+    }
+
+    // The median shrugs off the occasional loading screen or stall better than the mean does
+    auto median = _samples.begin() + _samples.size() / 2;
+    std::nth_element(_samples.begin(), median, _samples.end());
+    _results[_candidate] = *median;
+    TracyPlot("JIT Tuner Median (ms)", *median);
+
+    _samples.clear();
+    _frame = 0;
+    _candidate++;
+    if (Done()) {
+        // Ties go to the earlier (larger) candidate, as that's the default
+        _winner = std::min_element(_results.begin(), _results.end()) - _results.begin();
+        return CANDIDATES[_winner];
+    }
+
+    return CANDIDATES[_candidate];
+}
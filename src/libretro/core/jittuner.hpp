@@ -0,0 +1,65 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#ifndef MELONDSDS_CORE_JITTUNER_HPP
+#define MELONDSDS_CORE_JITTUNER_HPP
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+namespace MelonDsDs {
+    /// Picks a game's JIT block size by timing a few candidates in turn during normal play.
+    /// The caller applies each block size that \c EndFrame returns, then persists the winner.
+    class JitTuner {
+    public:
+        static constexpr std::array<unsigned, 4> CANDIDATES {32, 16, 8, 4};
+
+        /// Frames to wait before the first candidate is tried, so that the boot sequence isn't measured.
+        static constexpr unsigned START_DELAY_FRAMES = 1200;
+
+        /// Frames to skip after each switch, since the JIT has to recompile everything.
+        static constexpr unsigned WARMUP_FRAMES = 60;
+
+        /// Frames to measure for each candidate.
+        static constexpr unsigned MEASURE_FRAMES = 300;
+
+        JitTuner() noexcept;
+
+        /// Reports how long the emulator took to run the frame that just finished, in milliseconds.
+        /// \returns The block size to switch to, if it should change now.
+        [[nodiscard]] std::optional<unsigned> EndFrame(float runFrameTime) noexcept;
+
+        /// The block size that's currently being measured (or the winner, once done).
+        [[nodiscard]] unsigned Current() const noexcept;
+        [[nodiscard]] bool Started() const noexcept { return _delay == 0; }
+        [[nodiscard]] bool Done() const noexcept { return _candidate == CANDIDATES.size(); }
+
+        /// The median frame time measured for each candidate, in milliseconds.
+        [[nodiscard]] const std::array<float, CANDIDATES.size()>& Results() const noexcept { return _results; }
+    private:
+        size_t _candidate = 0;
+        unsigned _frame = 0;
+        unsigned _delay = START_DELAY_FRAMES;
+        std::vector<float> _samples;
+        std::array<float, CANDIDATES.size()> _results {};
+        size_t _winner = 0;
+    };
+}
+
+#endif // MELONDSDS_CORE_JITTUNER_HPP
@@ -0,0 +1,234 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "preload.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <stdexcept>
+
+#include <NDSCart.h>
+#include <streams/file_stream.h>
+
+#include "config/config.hpp"
+#include "config/console.hpp"
+#include "core.hpp"
+#include "environment.hpp"
+#include "retro/threadpool.hpp"
+#include "retro/threads.hpp"
+#include "tracy.hpp"
+
+using std::optional;
+using std::nullopt;
+using std::span;
+using std::string;
+using std::string_view;
+
+namespace {
+    // Not the real page size everywhere, but touching one byte every 4KiB faults in every page either way
+    constexpr size_t PREFAULT_STRIDE = 4096;
+
+    // How often the ROM's pages are checked for cancellation while they're faulted in
+    constexpr size_t PREFAULT_CANCEL_INTERVAL = 4 * 1024 * 1024;
+
+    /// Reads one byte from each page of \c data so the OS pages it all in now instead of while the game is loading.
+    /// @returns \c false if it was cancelled first.
+    bool Prefault(span<const std::byte> data, const std::atomic_bool& cancelled) noexcept {
+        ZoneScopedN(TracyFunction);
+        std::byte sum {};
+        for (size_t i = 0; i < data.size(); i += PREFAULT_STRIDE) {
+            if (i % PREFAULT_CANCEL_INTERVAL == 0 && cancelled) {
+                return false;
+            }
+            sum ^= data[i];
+        }
+
+        // So the reads aren't optimized away
+        [[maybe_unused]] volatile std::byte sink = sum;
+        return true;
+    }
+
+    MelonDsDs::PreloadedContent ReadContent(const string& path, const MelonDsDs::CoreConfig& config, const std::atomic_bool& cancelled) {
+        ZoneScopedN(TracyFunction);
+        MelonDsDs::PreloadedContent content { .Path = path };
+        if (cancelled) {
+            // If the preload was cancelled before a worker got to it...
+            return content;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        content.Rom = MelonDsDs::memory::SharedFileMapping::Open(path.c_str());
+        span<const std::byte> rom = content.Rom.Data();
+        std::unique_ptr<void, decltype(&free)> copy {nullptr, free};
+        if (!content.Rom) {
+            // If the ROM can't be mapped, read it anyway to validate it (and so the OS caches it)
+            void* buffer = nullptr;
+            int64_t length = 0;
+            if (!filestream_read_file(path.c_str(), &buffer, &length) || !buffer) {
+                throw std::runtime_error("Couldn't read the file");
+            }
+            copy.reset(buffer);
+            rom = span(static_cast<const std::byte*>(buffer), static_cast<size_t>(length));
+        }
+
+        MelonDsDs::ValidateNdsRom(rom);
+
+        if (content.Rom && !Prefault(rom, cancelled)) {
+            return content;
+        }
+
+        const melonDS::NDSHeader& header = *reinterpret_cast<const melonDS::NDSHeader*>(rom.data());
+        content.SystemFiles = MelonDsDs::PreloadSystemFiles(config, &header, path, cancelled);
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        retro::info(
+            "Preloaded the {}-byte ROM \"{}\" and {} system file(s) in {:.1f}ms",
+            rom.size(), path, content.SystemFiles, elapsed.count()
+        );
+        return content;
+    }
+}
+
+MelonDsDs::ContentPreloader::ContentPreloader() noexcept = default;
+
+MelonDsDs::ContentPreloader::~ContentPreloader() noexcept {
+    Cancel();
+    // Destroying _abandoned waits for the cancelled workers, which should notice soon enough
+}
+
+bool MelonDsDs::ContentPreloader::Begin(string_view path, const CoreConfig& config) noexcept {
+    ZoneScopedN(TracyFunction);
+    if (path.empty())
+        return false;
+
+    if ((_preload || _result) && _path == path) {
+        // If we're already preloading this game (or we're done)...
+        return true;
+    }
+
+    retro::ThreadPool* pool = retro::ThreadPool::Current();
+    if (!pool || pool->Size() == 0) {
+        // If there are no workers, the preload would hold up the current game's frame instead
+        retro::warn("Can't preload \"{}\" without worker threads", path);
+        return false;
+    }
+
+    Cancel();
+    ReapAbandoned();
+    _path = path;
+    _cancelled = std::make_shared<std::atomic_bool>(false);
+    _preload = std::make_unique<retro::future<PreloadedContent>>([path = _path, config, cancelled = _cancelled] {
+        return ReadContent(path, config, *cancelled);
+    });
+    retro::debug("Preloading \"{}\"", _path);
+    return true;
+}
+
+void MelonDsDs::ContentPreloader::Cancel() noexcept {
+    if (_preload) {
+        // If a preload is in progress, tell its worker to stop, but don't wait for it
+        // (it may be in the middle of downloading a DSiWare title's metadata)
+        *_cancelled = true;
+        if (!_preload->ready()) {
+            _abandoned.push_back(std::move(_preload));
+        }
+        _preload = nullptr;
+    }
+
+    _cancelled = nullptr;
+    _result = nullopt;
+    _failed = false;
+    _path.clear();
+}
+
+void MelonDsDs::ContentPreloader::ReapAbandoned() noexcept {
+    std::erase_if(_abandoned, [](const std::unique_ptr<retro::future<PreloadedContent>>& preload) {
+        return preload->ready();
+    });
+}
+
+melondsds_preload_status MelonDsDs::ContentPreloader::Status() noexcept {
+    ReapAbandoned();
+    if (!_preload && !_result && !_failed)
+        return MELONDSDS_PRELOAD_NONE;
+
+    if (!Collect(false))
+        return MELONDSDS_PRELOAD_PENDING;
+
+    return _result ? MELONDSDS_PRELOAD_READY : MELONDSDS_PRELOAD_FAILED;
+}
+
+optional<MelonDsDs::PreloadedContent> MelonDsDs::ContentPreloader::Take(string_view path) noexcept {
+    ZoneScopedN(TracyFunction);
+    if (_path.empty())
+        return nullopt;
+
+    if (_path != path) {
+        retro::info("Discarding the preloaded \"{}\", since \"{}\" was loaded instead", _path, path);
+        Cancel();
+        return nullopt;
+    }
+
+    Collect(true);
+    optional<PreloadedContent> result = std::move(_result);
+    Cancel();
+    return result;
+}
+
+bool MelonDsDs::ContentPreloader::Collect(bool wait) noexcept {
+    if (!_preload)
+        return true;
+
+    if (!wait && !_preload->ready())
+        return false;
+
+    try {
+        _result = _preload->get();
+    }
+    catch (const std::exception& e) {
+        retro::warn("Failed to preload \"{}\": {}", _path, e.what());
+        _failed = true;
+    }
+    _preload = nullptr;
+    return true;
+}
+
+static bool PreloadContent(const char* path) {
+    if (!path || !*path)
+        return false;
+
+    return MelonDsDs::Core.PreloadContent(path);
+}
+
+static void CancelPreload() {
+    MelonDsDs::Core.CancelPreload();
+}
+
+static melondsds_preload_status GetPreloadStatus() {
+    return MelonDsDs::Core.GetPreloadStatus();
+}
+
+extern "C" const melondsds_preload_interface* melondsds_get_preload_interface() {
+    static constexpr melondsds_preload_interface preloadInterface {
+        .interface_version = MELONDSDS_PRELOAD_INTERFACE_VERSION,
+        .preload_content = PreloadContent,
+        .cancel_preload = CancelPreload,
+        .get_preload_status = GetPreloadStatus,
+    };
+
+    return &preloadInterface;
+}
@@ -0,0 +1,96 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#ifndef MELONDSDS_CORE_PRELOAD_HPP
+#define MELONDSDS_CORE_PRELOAD_HPP
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "melondsds_preload.h"
+#include "platform/memory.hpp"
+
+namespace retro {
+    template <typename T>
+    class future;
+}
+
+namespace MelonDsDs {
+    class CoreConfig;
+
+    /// The next game's ROM, read ahead of time by \c ContentPreloader.
+    struct PreloadedContent {
+        std::string Path;
+        /// Empty if the ROM couldn't be mapped; it was still read (and validated) to warm the OS's file cache.
+        memory::SharedFileMapping Rom;
+        unsigned SystemFiles = 0;
+    };
+
+    /// Reads the next game (and the system files its console will need) on a worker thread,
+    /// so that the next \c retro_load_game doesn't have to wait on the disk (or the network).
+    /// Only the files are preloaded; the console itself is still created on the main thread,
+    /// since melonDS keeps global state about the current console.
+    class ContentPreloader {
+    public:
+        ContentPreloader() noexcept;
+
+        /// Cancels the preload in progress (if any) and waits for every cancelled preload to stop.
+        ~ContentPreloader() noexcept;
+        ContentPreloader(const ContentPreloader&) = delete;
+        ContentPreloader(ContentPreloader&&) = delete;
+        ContentPreloader& operator=(const ContentPreloader&) = delete;
+        ContentPreloader& operator=(ContentPreloader&&) = delete;
+
+        /// Starts preloading \c path with the system files that \c config calls for.
+        /// Does nothing if \c path is already being preloaded.
+        /// @returns \c false if there are no worker threads to preload on.
+        bool Begin(std::string_view path, const CoreConfig& config) noexcept;
+
+        /// Cancels the preload in progress (if any) without waiting for it,
+        /// since its worker may be blocked on the network for a while.
+        void Cancel() noexcept;
+
+        [[nodiscard]] melondsds_preload_status Status() noexcept;
+
+        /// If \c path was preloaded successfully, hands it over (waiting for it to finish if necessary).
+        /// Any other preload is discarded either way.
+        [[nodiscard]] std::optional<PreloadedContent> Take(std::string_view path) noexcept;
+    private:
+        /// Moves the worker's result into \c _result (or notes its failure) once it's done.
+        bool Collect(bool wait) noexcept;
+
+        /// Forgets the cancelled preloads whose workers have stopped.
+        void ReapAbandoned() noexcept;
+
+        std::string _path;
+        // Each preload gets its own flag, since a cancelled one may still be running after the next one starts
+        std::shared_ptr<std::atomic_bool> _cancelled;
+        std::unique_ptr<retro::future<PreloadedContent>> _preload;
+        // Cancelled preloads that hadn't finished yet; destroying them any sooner would wait for them
+        std::vector<std::unique_ptr<retro::future<PreloadedContent>>> _abandoned;
+        std::optional<PreloadedContent> _result;
+        bool _failed = false;
+    };
+}
+
+extern "C" const melondsds_preload_interface* melondsds_get_preload_interface();
+
+#endif // MELONDSDS_CORE_PRELOAD_HPP
@@ -0,0 +1,227 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "replay.hpp"
+
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#include <fmt/format.h>
+#include <streams/file_stream.h>
+#include <string/stdstring.h>
+
+#include "environment.hpp"
+#include "tracy.hpp"
+
+using std::optional;
+using std::nullopt;
+using std::string;
+
+namespace {
+    // Layout (all integers little-endian):
+    // - char[8]  magic
+    // - u16      format version
+    // - u8       mic input mode
+    // - u8       reserved
+    // - i64      RTC start time, in seconds since the epoch (local time)
+    // - u32      number of runs
+    // - runs, each of which is:
+    //   - u32 length (in frames)
+    //   - u32 buttons
+    //   - u8  touch X
+    //   - u8  touch Y
+    //   - u8  flags
+    //   - u8  reserved
+    constexpr std::array<char, 8> MAGIC { 'M', 'D', 'S', 'D', 'I', 'N', 'P', 'T' };
+    constexpr uint16_t FORMAT_VERSION = 1;
+    constexpr size_t HEADER_SIZE = MAGIC.size() + 2 + 1 + 1 + 8 + 4;
+    constexpr size_t RUN_SIZE = 4 + 4 + 4;
+
+    template<typename T>
+    void Put(std::vector<uint8_t>& out, T value) noexcept {
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            out.push_back(static_cast<uint8_t>(static_cast<uint64_t>(value) >> (i * 8)));
+        }
+    }
+
+    template<typename T>
+    T Get(const uint8_t*& in) noexcept {
+        uint64_t value = 0;
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            value |= static_cast<uint64_t>(in[i]) << (i * 8);
+        }
+        in += sizeof(T);
+        return static_cast<T>(value);
+    }
+}
+
+optional<MelonDsDs::InputRecording> MelonDsDs::InputRecording::FromEnvironment() noexcept {
+    const char* replayVar = getenv("MELONDSDS_INPUT_REPLAY");
+    const char* recordVar = getenv("MELONDSDS_INPUT_RECORD");
+    if (string_is_empty(replayVar) && string_is_empty(recordVar))
+        return nullopt;
+
+    InputRecording recording;
+    if (const char* savestate = getenv("MELONDSDS_INPUT_SAVESTATE"); !string_is_empty(savestate)) {
+        recording._savestatePath = savestate;
+    }
+
+    if (!string_is_empty(replayVar)) {
+        if (!string_is_empty(recordVar)) {
+            retro::warn("Both MELONDSDS_INPUT_REPLAY and MELONDSDS_INPUT_RECORD are set; only replaying");
+        }
+
+        if (!recording.Load(replayVar))
+            return nullopt;
+
+        retro::info("Will replay {} frames of input from {}", recording._frames, replayVar);
+        recording._frames = 0;
+    }
+    else {
+        recording._recordPath = recordVar;
+        retro::info("Will record input to {}", recordVar);
+    }
+
+    return recording;
+}
+
+bool MelonDsDs::InputRecording::Load(const string& path) noexcept {
+    ZoneScopedN(TracyFunction);
+    void* buffer = nullptr;
+    int64_t length = 0;
+    if (!filestream_read_file(path.c_str(), &buffer, &length) || !buffer) {
+        retro::error("Failed to read input recording {}", path);
+        return false;
+    }
+
+    std::unique_ptr<void, decltype(&free)> owner(buffer, &free);
+    const uint8_t* in = static_cast<const uint8_t*>(buffer);
+    const uint8_t* end = in + length;
+    if (static_cast<size_t>(length) < HEADER_SIZE || memcmp(in, MAGIC.data(), MAGIC.size()) != 0) {
+        retro::error("{} isn't an input recording", path);
+        return false;
+    }
+    in += MAGIC.size();
+
+    if (uint16_t version = Get<uint16_t>(in); version != FORMAT_VERSION) {
+        retro::error("Input recording {} has format version {}, expected {}", path, version, FORMAT_VERSION);
+        return false;
+    }
+
+    uint8_t micInputMode = Get<uint8_t>(in);
+    if (micInputMode > static_cast<uint8_t>(MicInputMode::WhiteNoise)) {
+        retro::error("Input recording {} has an invalid mic input mode ({})", path, micInputMode);
+        return false;
+    }
+    _micInputMode = static_cast<MicInputMode>(micInputMode);
+    in += 1; // reserved
+
+    _startTime = std::chrono::local_seconds(std::chrono::seconds(Get<int64_t>(in)));
+    uint32_t runs = Get<uint32_t>(in);
+    if (static_cast<size_t>(end - in) != size_t(runs) * RUN_SIZE) {
+        retro::error("Input recording {} is truncated or corrupt ({} runs in {} bytes)", path, runs, end - in);
+        return false;
+    }
+
+    _runs.reserve(runs);
+    _frames = 0;
+    for (uint32_t i = 0; i < runs; ++i) {
+        Run run {};
+        run.Length = Get<uint32_t>(in);
+        run.Input.Buttons = Get<uint32_t>(in);
+        run.Input.TouchX = Get<uint8_t>(in);
+        run.Input.TouchY = Get<uint8_t>(in);
+        run.Input.Flags = Get<uint8_t>(in);
+        in += 1; // reserved
+        if (run.Length == 0) {
+            retro::error("Input recording {} has an empty run at index {}", path, i);
+            return false;
+        }
+
+        _frames += run.Length;
+        _runs.push_back(run);
+    }
+
+    return true;
+}
+
+void MelonDsDs::InputRecording::Start(std::chrono::local_seconds startTime, MicInputMode micInputMode) noexcept {
+    if (!Replaying()) {
+        _startTime = startTime;
+        _micInputMode = micInputMode;
+    }
+
+    _started = true;
+}
+
+void MelonDsDs::InputRecording::Record(const RecordedInput& input) noexcept {
+    if (!_runs.empty() && _runs.back().Input == input && _runs.back().Length < UINT32_MAX) {
+        ++_runs.back().Length;
+    }
+    else {
+        _runs.push_back({1, input});
+    }
+
+    ++_frames;
+}
+
+optional<MelonDsDs::RecordedInput> MelonDsDs::InputRecording::Next() noexcept {
+    if (_run >= _runs.size())
+        return nullopt;
+
+    RecordedInput input = _runs[_run].Input;
+    if (++_runFrame >= _runs[_run].Length) {
+        ++_run;
+        _runFrame = 0;
+    }
+
+    ++_frames;
+    return input;
+}
+
+bool MelonDsDs::InputRecording::Save() const noexcept {
+    ZoneScopedN(TracyFunction);
+    if (!_recordPath)
+        return false;
+
+    std::vector<uint8_t> out;
+    out.reserve(HEADER_SIZE + _runs.size() * RUN_SIZE);
+    out.insert(out.end(), MAGIC.begin(), MAGIC.end());
+    Put<uint16_t>(out, FORMAT_VERSION);
+    Put<uint8_t>(out, static_cast<uint8_t>(_micInputMode));
+    Put<uint8_t>(out, 0);
+    Put<int64_t>(out, _startTime.time_since_epoch().count());
+    Put<uint32_t>(out, _runs.size());
+    for (const Run& run : _runs) {
+        Put<uint32_t>(out, run.Length);
+        Put<uint32_t>(out, run.Input.Buttons);
+        Put<uint8_t>(out, run.Input.TouchX);
+        Put<uint8_t>(out, run.Input.TouchY);
+        Put<uint8_t>(out, run.Input.Flags);
+        Put<uint8_t>(out, 0);
+    }
+
+    if (!filestream_write_file(_recordPath->c_str(), out.data(), out.size())) {
+        retro::error("Failed to write input recording to {}", *_recordPath);
+        return false;
+    }
+
+    retro::info("Wrote {} frames of input ({} bytes) to {}", _frames, out.size(), *_recordPath);
+    return true;
+}
@@ -0,0 +1,112 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#ifndef MELONDSDS_CORE_REPLAY_HPP
+#define MELONDSDS_CORE_REPLAY_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "config/types.hpp"
+#include "std/chrono.hpp"
+
+namespace MelonDsDs {
+    /// The input that reached the emulated console on one frame,
+    /// i.e. after the frontend's input has been mapped through the screen layout and button bindings.
+    struct RecordedInput {
+        enum Flags : uint8_t {
+            Touching = 1 << 0,
+            LidClosed = 1 << 1,
+            MicButton = 1 << 2,
+        };
+
+        /// As given to \c NDS::SetKeyMask
+        uint32_t Buttons = 0;
+        /// In console pixels; only meaningful if \c Touching is set
+        uint8_t TouchX = 0;
+        uint8_t TouchY = 0;
+        uint8_t Flags = 0;
+
+        bool operator==(const RecordedInput&) const noexcept = default;
+    };
+
+    /// Records each frame's console input to a file, or replays a recording in place of the frontend's input,
+    /// so that benchmarks and frame-by-frame comparisons can run the exact same workload every time.
+    /// The RTC is pinned to the recording's start time, so the emulated clock doesn't differ between runs either.
+    ///
+    /// Recordings are run-length encoded; a frame that repeats the last one costs nothing.
+    /// Only input is recorded; replays must use the same content, system files, and core options as the recording.
+    ///
+    /// Configured through environment variables, like \c Benchmark:
+    ///
+    /// - \c MELONDSDS_INPUT_REPLAY: Recording to replay, starting on the first frame.
+    /// - \c MELONDSDS_INPUT_RECORD: Path to record to; written when the game is unloaded.
+    ///   Ignored if \c MELONDSDS_INPUT_REPLAY is set.
+    /// - \c MELONDSDS_INPUT_SAVESTATE: Savestate to load before the first recorded or replayed frame.
+    ///   A recording must be replayed from the same savestate (or lack thereof) that it was recorded from.
+    class InputRecording {
+    public:
+        /// Returns \c nullopt if neither recording nor replay is enabled, or if the recording can't be read.
+        static std::optional<InputRecording> FromEnvironment() noexcept;
+
+        [[nodiscard]] bool Replaying() const noexcept { return !_recordPath; }
+        [[nodiscard]] bool Started() const noexcept { return _started; }
+        [[nodiscard]] const std::optional<std::string>& SavestatePath() const noexcept { return _savestatePath; }
+        [[nodiscard]] std::chrono::local_seconds StartTime() const noexcept { return _startTime; }
+        [[nodiscard]] MicInputMode RecordedMicInputMode() const noexcept { return _micInputMode; }
+
+        /// Call before the first frame, after any savestate is loaded.
+        /// When recording, \c startTime and \c micInputMode are saved with the recording;
+        /// when replaying, they're ignored in favor of the recorded ones.
+        void Start(std::chrono::local_seconds startTime, MicInputMode micInputMode) noexcept;
+
+        /// Appends a frame to the recording.
+        void Record(const RecordedInput& input) noexcept;
+
+        /// The next frame of the replay, or \c nullopt once the recording has run out.
+        [[nodiscard]] std::optional<RecordedInput> Next() noexcept;
+
+        /// Frames recorded or replayed so far
+        [[nodiscard]] uint64_t Frames() const noexcept { return _frames; }
+
+        /// Writes the recording to its path, if recording.
+        bool Save() const noexcept;
+    private:
+        struct Run {
+            uint32_t Length;
+            RecordedInput Input;
+        };
+
+        InputRecording() noexcept = default;
+        [[nodiscard]] bool Load(const std::string& path) noexcept;
+
+        std::vector<Run> _runs;
+        // Position of the next replayed frame
+        size_t _run = 0;
+        uint32_t _runFrame = 0;
+        uint64_t _frames = 0;
+        bool _started = false;
+        std::chrono::local_seconds _startTime {};
+        MicInputMode _micInputMode = MicInputMode::None;
+        std::optional<std::string> _recordPath;
+        std::optional<std::string> _savestatePath;
+    };
+}
+
+#endif // MELONDSDS_CORE_REPLAY_HPP
@@ -0,0 +1,246 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "resampler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define MELONDSDS_RESAMPLER_X86
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define MELONDSDS_RESAMPLER_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(MELONDSDS_RESAMPLER_X86) && (defined(__GNUC__) || defined(__clang__))
+#define MELONDSDS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define MELONDSDS_TARGET_AVX2
+#endif
+
+#include <retro_assert.h>
+
+#include "cpu.hpp"
+#include "tracy.hpp"
+
+namespace cpu = MelonDsDs::cpu;
+
+namespace {
+    struct FilterDesign {
+        unsigned Taps;
+        // Cutoff frequency as a fraction of the lower of the two Nyquist frequencies
+        double Cutoff;
+        // Kaiser window shape; higher values trade a wider transition band for better stopband attenuation
+        double Beta;
+    };
+
+    constexpr FilterDesign GetFilterDesign(MelonDsDs::ResamplerQuality quality) noexcept {
+        switch (quality) {
+            case MelonDsDs::ResamplerQuality::Fast:
+                return { 8, 0.80, 5.0 };
+            case MelonDsDs::ResamplerQuality::Best:
+                return { 32, 0.95, 9.0 };
+            case MelonDsDs::ResamplerQuality::Balanced:
+            default:
+                return { 16, 0.90, 7.0 };
+        }
+    }
+
+    // Zeroth-order modified Bessel function of the first kind, for the Kaiser window
+    double BesselI0(double x) noexcept {
+        double sum = 1;
+        double term = 1;
+        for (int k = 1; k < 32; ++k) {
+            term *= (x / (2 * k)) * (x / (2 * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    // All filter lengths are multiples of 8, so none of these have a scalar tail to handle
+    using DotFn = float (*)(const float* a, const float* b, size_t count) noexcept;
+
+    float DotScalar(const float* a, const float* b, size_t count) noexcept {
+        float sum = 0;
+        for (size_t i = 0; i < count; ++i) {
+            sum += a[i] * b[i];
+        }
+        return sum;
+    }
+
+#ifdef MELONDSDS_RESAMPLER_X86
+    float DotSse2(const float* a, const float* b, size_t count) noexcept {
+        __m128 sum = _mm_setzero_ps();
+        for (size_t i = 0; i < count; i += 4) {
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        }
+        // Add up the four lanes
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+        return _mm_cvtss_f32(sum);
+    }
+
+    MELONDSDS_TARGET_AVX2 float DotAvx2(const float* a, const float* b, size_t count) noexcept {
+        __m256 sum = _mm256_setzero_ps();
+        for (size_t i = 0; i < count; i += 8) {
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+        }
+        // Fold the upper half onto the lower half, then add up the four lanes that are left
+        __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+        half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+        half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+        return _mm_cvtss_f32(half);
+    }
+#endif
+
+#ifdef MELONDSDS_RESAMPLER_NEON
+    float DotNeon(const float* a, const float* b, size_t count) noexcept {
+        float32x4_t sum = vdupq_n_f32(0);
+        for (size_t i = 0; i < count; i += 4) {
+            sum = vmlaq_f32(sum, vld1q_f32(a + i), vld1q_f32(b + i));
+        }
+        float32x2_t pair = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+        return vget_lane_f32(vpadd_f32(pair, pair), 0);
+    }
+#endif
+
+    using cpu::Feature;
+    using cpu::Variant;
+
+    // Best first; cpu::Init picks the first one that the CPU and MELONDSDS_CPU_FEATURES allow
+    constexpr Variant<DotFn> DOT_VARIANTS[] {
+#ifdef MELONDSDS_RESAMPLER_X86
+        { "avx2", Feature::Avx2, DotAvx2 },
+        { "sse2", Feature::Sse2, DotSse2 },
+#endif
+#ifdef MELONDSDS_RESAMPLER_NEON
+        { "neon", Feature::Neon, DotNeon },
+#endif
+        { "scalar", std::nullopt, DotScalar },
+    };
+
+    cpu::Kernel<DotFn> DotKernel("resampler", DOT_VARIANTS);
+
+    int16_t ToSample(float value) noexcept {
+        return static_cast<int16_t>(std::clamp(std::lround(value), -32768L, 32767L));
+    }
+}
+
+MelonDsDs::AudioResampler::AudioResampler(double inputRate, double outputRate, ResamplerQuality quality, unsigned channels) noexcept :
+    _outputRate(outputRate),
+    _channels(channels),
+    _step(inputRate / outputRate) {
+    ZoneScopedN(TracyFunction);
+    FilterDesign design = GetFilterDesign(quality);
+    _taps = design.Taps;
+    retro_assert(_taps % 4 == 0);
+    retro_assert(_channels == 1 || _channels == 2);
+
+    // When downsampling, the filter has to cut off below the output's Nyquist frequency instead
+    double cutoff = design.Cutoff * std::min(1.0, outputRate / inputRate);
+    double center = _taps / 2.0 - 1;
+    double window = BesselI0(design.Beta);
+
+    _filters.resize(PHASES * _taps);
+    for (unsigned phase = 0; phase < PHASES; ++phase) {
+        // Each phase is the filter for an output frame that lies this far between two input frames
+        double fraction = static_cast<double>(phase) / PHASES;
+        float* filter = _filters.data() + phase * _taps;
+        double total = 0;
+        for (unsigned tap = 0; tap < _taps; ++tap) {
+            double x = tap - center - fraction;
+            double sinc = x == 0 ? 1 : std::sin(std::numbers::pi * cutoff * x) / (std::numbers::pi * cutoff * x);
+            double r = x / (_taps / 2.0);
+            double kaiser = std::abs(r) >= 1 ? 0 : BesselI0(design.Beta * std::sqrt(1 - r * r)) / window;
+            filter[tap] = static_cast<float>(sinc * kaiser);
+            total += filter[tap];
+        }
+
+        for (unsigned tap = 0; tap < _taps; ++tap) {
+            // Normalize each phase so that it doesn't change the volume
+            filter[tap] = static_cast<float>(filter[tap] / total);
+        }
+    }
+
+    // Start with a filter's worth of silence, so the first output frames have something to look back on
+    _left.assign(_taps + MAX_INPUT_FRAMES, 0.0f);
+    if (_channels == 2) {
+        _right.assign(_taps + MAX_INPUT_FRAMES, 0.0f);
+    }
+    _buffered = _taps;
+}
+
+size_t MelonDsDs::AudioResampler::MaxOutputFrames(size_t inputFrames) const noexcept {
+    return static_cast<size_t>(std::ceil((inputFrames + _taps) / _step)) + 1;
+}
+
+size_t MelonDsDs::AudioResampler::Process(std::span<const int16_t> input, std::span<int16_t> output) noexcept {
+    ZoneScopedN(TracyFunction);
+
+    bool stereo = _channels == 2;
+    size_t inputFrames = std::min(input.size() / _channels, _left.size() - _buffered);
+    if (stereo) {
+        for (size_t i = 0; i < inputFrames; ++i) {
+            _left[_buffered + i] = input[i * 2];
+            _right[_buffered + i] = input[i * 2 + 1];
+        }
+    }
+    else {
+        std::copy_n(input.begin(), inputFrames, _left.begin() + _buffered);
+    }
+    _buffered += inputFrames;
+
+    size_t outputCapacity = output.size() / _channels;
+    size_t written = 0;
+    DotFn dot = DotKernel.Get();
+    while (written < outputCapacity) {
+        auto base = static_cast<size_t>(_position);
+        auto phase = static_cast<unsigned>(std::lround((_position - base) * PHASES));
+        if (phase == PHASES) {
+            // If we rounded up to the next input frame...
+            ++base;
+            phase = 0;
+        }
+
+        if (base + _taps > _buffered) {
+            // If we need more input to compute this frame, then wait for the next batch
+            break;
+        }
+
+        const float* filter = _filters.data() + phase * _taps;
+        output[written * _channels] = ToSample(dot(_left.data() + base, filter, _taps));
+        if (stereo) {
+            output[written * 2 + 1] = ToSample(dot(_right.data() + base, filter, _taps));
+        }
+        ++written;
+        _position += _step;
+    }
+
+    // Discard the input frames that no future output frame needs
+    auto consumed = std::min(static_cast<size_t>(_position), _buffered);
+    std::copy(_left.begin() + consumed, _left.begin() + _buffered, _left.begin());
+    if (stereo) {
+        std::copy(_right.begin() + consumed, _right.begin() + _buffered, _right.begin());
+    }
+    _buffered -= consumed;
+    _position -= consumed;
+
+    return written;
+}
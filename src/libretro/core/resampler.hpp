@@ -0,0 +1,78 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#ifndef MELONDSDS_CORE_RESAMPLER_HPP
+#define MELONDSDS_CORE_RESAMPLER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "config/types.hpp"
+
+namespace MelonDsDs {
+    /// \brief Converts audio between sample rates with a windowed-sinc filter,
+    /// e.g. the SPU's output to the frontend's native rate (so the frontend doesn't have to)
+    /// or the host microphone's input to the DS's.
+    /// Uses SSE2 or NEON for the filter where the build supports it.
+    class AudioResampler {
+    public:
+        /// The highest output rate that callers must size their buffers for.
+        static constexpr unsigned MAX_OUTPUT_RATE = 48000;
+
+        /// The most input frames that \c Process accepts at once.
+        static constexpr size_t MAX_INPUT_FRAMES = 4096;
+
+        /// \param channels 1 for mono or 2 for interleaved stereo.
+        AudioResampler(double inputRate, double outputRate, ResamplerQuality quality, unsigned channels = 2) noexcept;
+
+        /// Resamples interleaved \c input into \c output.
+        /// Output lags input by half the filter's length, so a little audio is held back between calls.
+        /// \returns The number of frames written to \c output.
+        size_t Process(std::span<const int16_t> input, std::span<int16_t> output) noexcept;
+
+        [[nodiscard]] double OutputRate() const noexcept { return _outputRate; }
+        [[nodiscard]] unsigned Taps() const noexcept { return _taps; }
+
+        /// The most output frames that \c Process will write for the given number of input frames.
+        [[nodiscard]] size_t MaxOutputFrames(size_t inputFrames) const noexcept;
+    private:
+        // Number of fractional positions between input frames that have their own precomputed filter
+        static constexpr unsigned PHASES = 256;
+
+        double _outputRate;
+        unsigned _taps;
+        unsigned _channels;
+        // Input frames per output frame
+        double _step;
+        // Position of the next output frame, relative to the oldest buffered input frame
+        double _position = 0;
+
+        // PHASES filters of _taps coefficients each, one after another
+        std::vector<float> _filters;
+
+        // Deinterleaved input that hasn't been fully consumed yet;
+        // allocated up front so that Process never allocates
+        // (_right is left empty for mono)
+        std::vector<float> _left;
+        std::vector<float> _right;
+        size_t _buffered;
+    };
+}
+
+#endif // MELONDSDS_CORE_RESAMPLER_HPP
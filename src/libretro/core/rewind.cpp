@@ -0,0 +1,377 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include "rewind.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+#include <retro_assert.h>
+#include <zlib.h>
+
+#include "environment.hpp"
+#include "render/jobs.hpp"
+#include "tracy.hpp"
+
+using std::optional;
+using std::nullopt;
+using std::span;
+using std::vector;
+
+// Deltas are mostly zeroes, so the fastest level compresses them almost as well as any other
+constexpr int REWIND_COMPRESSION_LEVEL = Z_BEST_SPEED;
+
+// Including the rewind thread, which runs jobs too; the emulator still needs a core to itself
+constexpr unsigned MAX_REWIND_THREADS = 3;
+
+static void XorInto(span<std::byte> dest, span<const std::byte> src) noexcept {
+    retro_assert(dest.size() == src.size());
+    // Simple enough for the compiler to vectorize
+    for (size_t i = 0; i < dest.size(); ++i) {
+        dest[i] ^= src[i];
+    }
+}
+
+static size_t ChunkCount(size_t stateSize) noexcept {
+    return (stateSize + MelonDsDs::REWIND_CHUNK_SIZE - 1) / MelonDsDs::REWIND_CHUNK_SIZE;
+}
+
+static uint32_t ReadU32(const std::byte* data) noexcept {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value)); // Never leaves this process, so native byte order is fine
+    return value;
+}
+
+MelonDsDs::RewindBuffer::RewindBuffer() noexcept {
+    ZoneScopedN(TracyFunction);
+    _lock = slock_new();
+    retro_assert(_lock != nullptr);
+
+#ifdef HAVE_THREADS
+    _wake = scond_new();
+    _idle = scond_new();
+    if (_wake && _idle) {
+        _thread = sthread_create(WorkerThread, this);
+    }
+
+    if (!_thread) {
+        retro::warn("Couldn't start a background thread for rewinding; snapshots will be compressed inline");
+    }
+#endif
+}
+
+MelonDsDs::RewindBuffer::~RewindBuffer() noexcept {
+    ZoneScopedN(TracyFunction);
+
+    if (_thread) {
+        slock_lock(_lock);
+        _stopping = true;
+        scond_signal(_wake);
+        slock_unlock(_lock);
+        sthread_join(_thread); // The worker finishes any pending snapshot before it exits
+    }
+
+    _workers = nullptr;
+
+    if (_idle) {
+        scond_free(_idle);
+    }
+
+    if (_wake) {
+        scond_free(_wake);
+    }
+
+    slock_free(_lock);
+}
+
+void MelonDsDs::RewindBuffer::SetCapacity(size_t bytes) noexcept {
+    ZoneScopedN(TracyFunction);
+    Wait();
+    if (bytes == _capacity)
+        return;
+
+    Clear();
+    _capacity = bytes;
+    _warnedTooSmall = false;
+
+    // Reallocated (at the new size) when the next delta is stored
+    _ring = {};
+    if (bytes == 0) {
+        // If rewinding was disabled, don't hold on to the snapshots either
+        _head = {};
+        _next = {};
+        _compressed = {};
+        _workers = nullptr;
+    }
+}
+
+span<std::byte> MelonDsDs::RewindBuffer::BeginSnapshot(size_t stateSize) noexcept {
+    ZoneScopedN(TracyFunction);
+    if (_capacity == 0 || stateSize == 0)
+        return {};
+
+    slock_lock(_lock);
+    bool pending = _pending;
+    slock_unlock(_lock);
+    if (pending) {
+        // If the last snapshot is still being compressed, don't wait for it
+        return {};
+    }
+
+    if (stateSize != _head.size()) {
+        // If the console's setup changed in a way that affects savestates (or this is the first snapshot)...
+        Clear();
+        _head.resize(stateSize);
+        _next.resize(stateSize);
+    }
+
+    // The first snapshot becomes the head as-is, since there's nothing to diff it against
+    return _hasHead ? span(_next) : span(_head);
+}
+
+void MelonDsDs::RewindBuffer::EndSnapshot() noexcept {
+    ZoneScopedN(TracyFunction);
+    if (!_hasHead) {
+        _hasHead = true;
+        return;
+    }
+
+    if (!_thread) {
+        EncodeDelta();
+        return;
+    }
+
+    slock_lock(_lock);
+    _pending = true;
+    scond_signal(_wake);
+    slock_unlock(_lock);
+}
+
+span<const std::byte> MelonDsDs::RewindBuffer::StepBack() noexcept {
+    ZoneScopedN(TracyFunction);
+    Wait();
+    if (_deltas.empty())
+        return {};
+
+    Delta delta = _deltas.back();
+    size_t chunkCount = ChunkCount(_head.size());
+    const std::byte* data = _ring.data() + delta.Offset;
+
+    // Find where each chunk starts before handing them out, as they're packed back-to-back
+    vector<size_t> offsets(chunkCount + 1);
+    offsets[0] = chunkCount * sizeof(uint32_t);
+    for (size_t i = 0; i < chunkCount; ++i) {
+        offsets[i + 1] = offsets[i] + ReadU32(data + i * sizeof(uint32_t));
+    }
+    retro_assert(offsets.back() == delta.Size);
+
+    // Undo the delta chunk by chunk, which turns the head into the snapshot before it
+    std::atomic_bool failed = false;
+    Jobs().Run(chunkCount, [&](unsigned index) {
+        size_t start = size_t(index) * REWIND_CHUNK_SIZE;
+        size_t length = std::min(REWIND_CHUNK_SIZE, _head.size() - start);
+        uLongf decompressedLength = length;
+        int result = uncompress(
+            reinterpret_cast<Bytef*>(_next.data() + start),
+            &decompressedLength,
+            reinterpret_cast<const Bytef*>(data + offsets[index]),
+            offsets[index + 1] - offsets[index]
+        );
+
+        if (result != Z_OK || decompressedLength != length) {
+            failed.store(true, std::memory_order_relaxed);
+            return;
+        }
+
+        XorInto(span(_head).subspan(start, length), span(_next).subspan(start, length));
+    });
+
+    if (failed.load(std::memory_order_relaxed)) {
+        // Some chunks of the head may have been stepped back and others not, so none of it can be trusted
+        retro::error("Rewind snapshot is corrupt, discarding the rewind history");
+        Clear();
+        return {};
+    }
+
+    _deltas.pop_back();
+    _writeOffset = delta.Offset; // The next delta can go where this one was
+    return _head;
+}
+
+void MelonDsDs::RewindBuffer::Clear() noexcept {
+    ZoneScopedN(TracyFunction);
+    Wait();
+    _deltas.clear();
+    _writeOffset = 0;
+    _hasHead = false;
+}
+
+size_t MelonDsDs::RewindBuffer::Length() noexcept {
+    Wait();
+    return _deltas.size();
+}
+
+size_t MelonDsDs::RewindBuffer::Evicted() noexcept {
+    Wait();
+    return _evicted;
+}
+
+void MelonDsDs::RewindBuffer::Wait() noexcept {
+    slock_lock(_lock);
+    while (_pending) {
+        scond_wait(_idle, _lock);
+    }
+    slock_unlock(_lock);
+}
+
+void MelonDsDs::RewindBuffer::WorkerThread(void* self) noexcept {
+    RewindBuffer& rewind = *static_cast<RewindBuffer*>(self);
+
+    slock_lock(rewind._lock);
+    while (true) {
+        if (!rewind._pending) {
+            if (rewind._stopping) {
+                break;
+            }
+
+            scond_wait(rewind._wake, rewind._lock);
+            continue;
+        }
+
+        slock_unlock(rewind._lock);
+        rewind.EncodeDelta();
+        slock_lock(rewind._lock);
+
+        rewind._pending = false;
+        scond_broadcast(rewind._idle);
+    }
+    slock_unlock(rewind._lock);
+}
+
+void MelonDsDs::RewindBuffer::EncodeDelta() noexcept {
+    ZoneScopedN(TracyFunction);
+    retro_assert(_hasHead);
+    retro_assert(_head.size() == _next.size());
+
+    size_t chunkCount = ChunkCount(_head.size());
+    _compressed.resize(chunkCount);
+    Jobs().Run(chunkCount, [this](unsigned index) {
+        size_t start = size_t(index) * REWIND_CHUNK_SIZE;
+        size_t length = std::min(REWIND_CHUNK_SIZE, _head.size() - start);
+        span<std::byte> next = span(_next).subspan(start, length);
+        span<std::byte> head = span(_head).subspan(start, length);
+
+        // next becomes the delta; xor-ing it into the old head yields the new snapshot,
+        // so the new head doesn't need a copy of its own
+        XorInto(next, head);
+        XorInto(head, next);
+
+        vector<std::byte>& compressed = _compressed[index];
+        uLongf compressedLength = compressBound(length);
+        compressed.resize(compressedLength);
+        int result = compress2(
+            reinterpret_cast<Bytef*>(compressed.data()),
+            &compressedLength,
+            reinterpret_cast<const Bytef*>(next.data()),
+            length,
+            REWIND_COMPRESSION_LEVEL
+        );
+
+        compressed.resize(result == Z_OK ? compressedLength : 0);
+    });
+
+    if (std::ranges::any_of(_compressed, [](const vector<std::byte>& block) { return block.empty(); })) {
+        // The head is the new snapshot either way, but the snapshot before it can't be stepped back to
+        retro::error("Failed to compress a rewind snapshot, discarding the rewind history");
+        _deltas.clear();
+        _writeOffset = 0;
+        return;
+    }
+
+    size_t size = chunkCount * sizeof(uint32_t);
+    for (const vector<std::byte>& block : _compressed) {
+        size += block.size();
+    }
+
+    optional<size_t> offset = Reserve(size);
+    if (!offset) {
+        // Each delta depends on the one after it, so the older ones are useless now
+        if (!_warnedTooSmall) {
+            retro::warn("Rewind snapshot needs {}KiB, but the rewind buffer only has {}KiB", size / 1024, _capacity / 1024);
+            _warnedTooSmall = true;
+        }
+        _evicted += _deltas.size();
+        _deltas.clear();
+        _writeOffset = 0;
+        return;
+    }
+
+    std::byte* data = _ring.data() + *offset;
+    for (size_t i = 0; i < chunkCount; ++i) {
+        uint32_t blockSize = _compressed[i].size();
+        memcpy(data + i * sizeof(uint32_t), &blockSize, sizeof(blockSize));
+    }
+
+    data += chunkCount * sizeof(uint32_t);
+    for (const vector<std::byte>& block : _compressed) {
+        memcpy(data, block.data(), block.size());
+        data += block.size();
+    }
+
+    _deltas.push_back({*offset, size});
+    _writeOffset = *offset + size;
+    TracyPlot("Rewind Snapshots", static_cast<int64_t>(_deltas.size()));
+    TracyPlot("Rewind Delta Size", static_cast<int64_t>(size));
+}
+
+optional<size_t> MelonDsDs::RewindBuffer::Reserve(size_t size) noexcept {
+    if (size > _capacity)
+        return nullopt;
+
+    if (_ring.size() != _capacity) {
+        // Allocated here, on the rewind thread, instead of when the option is set
+        _ring.resize(_capacity);
+    }
+
+    // Deltas never wrap around the end of the ring; if this one won't fit, it starts over at the beginning
+    size_t start = (_writeOffset + size <= _capacity) ? _writeOffset : 0;
+    bool wrapped = start != _writeOffset;
+    while (!_deltas.empty()) {
+        // Going forward from _writeOffset, the deltas are stored oldest first,
+        // so only the oldest can be in the way
+        const Delta& oldest = _deltas.front();
+        bool skipped = wrapped && oldest.Offset >= _writeOffset; // Between the old write offset and the end
+        bool overlaps = oldest.Offset < start + size && start < oldest.Offset + oldest.Size;
+        if (!skipped && !overlaps)
+            break;
+
+        _deltas.pop_front();
+        ++_evicted;
+    }
+
+    return start;
+}
+
+MelonDsDs::JobGroup& MelonDsDs::RewindBuffer::Jobs() noexcept {
+    if (!_workers) {
+        unsigned threads = std::clamp(std::thread::hardware_concurrency(), 2u, MAX_REWIND_THREADS);
+        _workers = std::make_unique<JobGroup>(threads - 1);
+    }
+
+    return *_workers;
+}
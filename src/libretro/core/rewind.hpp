@@ -0,0 +1,138 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef MELONDSDS_CORE_REWIND_HPP
+#define MELONDSDS_CORE_REWIND_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <rthreads/rthreads.h>
+
+#include "std/span.hpp"
+
+namespace MelonDsDs {
+    class JobGroup;
+
+    /// Uncompressed bytes in each independently-compressed chunk of a rewind snapshot.
+    constexpr size_t REWIND_CHUNK_SIZE = 256 * 1024;
+
+    /// Keeps a bounded history of savestates for stepping back in time.
+    ///
+    /// Only the newest snapshot is kept as-is. Every older one is stored as the zlib-compressed XOR
+    /// of itself and the snapshot after it, which is almost all zeroes between nearby frames.
+    /// Stepping back decompresses one delta and applies it to the newest snapshot,
+    /// so it takes about as long as loading a savestate no matter how far back the history goes.
+    ///
+    /// Deltas are computed and compressed in chunks on a background thread (and its pool of workers),
+    /// then packed into a ring of preallocated memory; the oldest deltas are dropped to make room.
+    class RewindBuffer {
+    public:
+        RewindBuffer() noexcept;
+
+        /// Waits for any snapshot that's still being compressed.
+        ~RewindBuffer() noexcept;
+        RewindBuffer(const RewindBuffer&) = delete;
+        RewindBuffer(RewindBuffer&&) = delete;
+        RewindBuffer& operator=(const RewindBuffer&) = delete;
+        RewindBuffer& operator=(RewindBuffer&&) = delete;
+
+        /// Sets how much memory the compressed deltas may use, discarding the history if it changed.
+        /// The uncompressed newest snapshot (and a scratch buffer of the same size) aren't counted.
+        void SetCapacity(size_t bytes) noexcept;
+        [[nodiscard]] size_t Capacity() const noexcept { return _capacity; }
+
+        /// Returns the buffer that the next snapshot should be serialized into,
+        /// or an empty span if the previous snapshot is still being compressed
+        /// (in which case this one should be skipped, rather than stalling the frame).
+        /// If \c stateSize differs from the previous snapshots' size, the history is discarded.
+        [[nodiscard]] std::span<std::byte> BeginSnapshot(size_t stateSize) noexcept;
+
+        /// Queues the snapshot written to the span returned by \c BeginSnapshot
+        /// to be delta-encoded and compressed.
+        void EndSnapshot() noexcept;
+
+        /// Waits for any pending snapshot, then steps the history back by one snapshot.
+        /// @returns The snapshot before the newest one (which is now the newest),
+        /// or an empty span if there's nothing older to go back to.
+        /// Valid until the next call to any other method.
+        [[nodiscard]] std::span<const std::byte> StepBack() noexcept;
+
+        /// Discards every snapshot, but keeps the memory allocated.
+        void Clear() noexcept;
+
+        /// Waits for any pending snapshot.
+        /// @returns The number of snapshots that can be stepped back to.
+        [[nodiscard]] size_t Length() noexcept;
+
+        /// Waits for any pending snapshot.
+        /// @returns How many snapshots have been discarded to make room for newer ones.
+        [[nodiscard]] size_t Evicted() noexcept;
+    private:
+        struct Delta {
+            size_t Offset;
+            size_t Size;
+        };
+
+        static void WorkerThread(void* self) noexcept;
+        void Wait() noexcept;
+        void EncodeDelta() noexcept;
+        /// Finds room in the ring for a delta of \c size bytes, dropping the oldest deltas that are in the way.
+        /// @returns Where the delta should be written, or \c nullopt if it can't fit at all.
+        [[nodiscard]] std::optional<size_t> Reserve(size_t size) noexcept;
+        JobGroup& Jobs() noexcept;
+
+        slock_t* _lock = nullptr;
+        scond_t* _wake = nullptr;
+        scond_t* _idle = nullptr;
+        sthread_t* _thread = nullptr;
+        bool _stopping = false;
+        bool _pending = false;
+
+        // Everything below is only touched by the worker while _pending is set,
+        // and only by the emulator thread otherwise
+
+        // The newest snapshot, uncompressed
+        std::vector<std::byte> _head;
+
+        // Where the next snapshot is serialized before it's delta-encoded against _head
+        // (after which it holds the delta)
+        std::vector<std::byte> _next;
+        bool _hasHead = false;
+
+        // One compressed block per chunk of the latest delta, kept around to reuse their capacity
+        std::vector<std::vector<std::byte>> _compressed;
+
+        // Each delta starts with its chunks' compressed sizes (as uint32_t), followed by the chunks themselves.
+        // Deltas are stored oldest to newest going forward from _writeOffset, wrapping around at the end.
+        std::vector<std::byte> _ring;
+        std::deque<Delta> _deltas;
+        size_t _capacity = 0;
+        size_t _writeOffset = 0;
+        size_t _evicted = 0;
+        // So that a buffer too small for even one delta only says so once
+        bool _warnedTooSmall = false;
+
+        // Only started once the first delta is encoded
+        std::unique_ptr<JobGroup> _workers;
+    };
+}
+
+#endif // MELONDSDS_CORE_REWIND_HPP
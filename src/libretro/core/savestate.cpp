@@ -0,0 +1,170 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "savestate.hpp"
+
+#include <charconv>
+#include <cstdlib>
+#include <unordered_set>
+#include <vector>
+
+#include <fmt/format.h>
+#include <compat/strl.h>
+#include <file/file_path.h>
+#include <retro_miscellaneous.h>
+#include <streams/file_stream.h>
+
+#include <GBACart.h>
+#include <NDS.h>
+#include <NDSCart.h>
+#include <Savestate.h>
+
+#include "environment.hpp"
+#include "tracy.hpp"
+#include "version.hpp"
+
+using std::optional;
+using std::nullopt;
+using std::string;
+using std::string_view;
+
+// One "key size" pair per line
+constexpr string_view SAVESTATE_SIZE_CACHE_NAME = "savestate_sizes.txt";
+
+namespace {
+    // Keys whose sizes were measured by this process, and so can't be stale.
+    // Not cleared by retro_deinit, since the build (and thus the size) can't change until the core is unloaded.
+    std::unordered_set<string> verifiedSavestateSizes;
+}
+
+std::string MelonDsDs::GetSavestateSizeKey(melonDS::NDS& nds) noexcept {
+    ZoneScopedN(TracyFunction);
+    string_view gameCode = "----";
+    unsigned headerCrc = 0;
+    if (const melonDS::NDSCart::CartCommon* cart = nds.GetNDSCart()) {
+        const melonDS::NDSHeader& header = cart->GetHeader();
+        gameCode = string_view(header.GameCode, sizeof(header.GameCode));
+        headerCrc = header.HeaderCRC16;
+        // The game code alone isn't unique enough; most homebrew uses "####"
+    }
+
+    int gbaCartType = -1;
+    if (const melonDS::GBACart::CartCommon* gbaCart = nds.GetGBACart()) {
+        gbaCartType = static_cast<int>(gbaCart->Type());
+    }
+
+    // The core version is included in case melonDS DS changes what it adds to the savestate
+    return fmt::format(
+        "{}-{:04x}-{}-{}-{}-{}-{}.{}-{}",
+        gameCode,
+        headerCrc,
+        nds.ConsoleType,
+        nds.GetNDSSaveLength(),
+        gbaCartType,
+        nds.GetGBASaveLength(),
+        SAVESTATE_MAJOR,
+        SAVESTATE_MINOR,
+        MELONDSDS_VERSION
+    );
+}
+
+// Returns the entries that don't have the given key, and the size of the entry that does (if any)
+static std::pair<std::vector<string>, optional<size_t>> ReadSavestateSizeCache(const string& path, string_view key) noexcept {
+    void* buffer = nullptr;
+    int64_t length = 0;
+    if (!filestream_read_file(path.c_str(), &buffer, &length) || !buffer) {
+        return {{}, nullopt};
+    }
+
+    std::vector<string> others;
+    optional<size_t> size;
+    string_view contents(static_cast<const char*>(buffer), length);
+    while (!contents.empty()) {
+        size_t end = contents.find('\n');
+        string_view line = contents.substr(0, end);
+        contents = end == string_view::npos ? string_view() : contents.substr(end + 1);
+
+        size_t space = line.rfind(' ');
+        if (space == string_view::npos) {
+            continue; // Skip malformed lines
+        }
+
+        if (line.substr(0, space) == key) {
+            size_t value = 0;
+            string_view sizeText = line.substr(space + 1);
+            if (auto [ptr, ec] = std::from_chars(sizeText.data(), sizeText.data() + sizeText.size(), value); ec == std::errc() && value > 0) {
+                size = value;
+            }
+        }
+        else {
+            others.emplace_back(line);
+        }
+    }
+
+    free(buffer);
+    return {std::move(others), size};
+}
+
+optional<size_t> MelonDsDs::GetCachedSavestateSize(string_view key) noexcept {
+    ZoneScopedN(TracyFunction);
+    optional<string> path = retro::get_system_subdir_path(SAVESTATE_SIZE_CACHE_NAME);
+    if (!path) {
+        return nullopt;
+    }
+
+    return ReadSavestateSizeCache(*path, key).second;
+}
+
+bool MelonDsDs::IsSavestateSizeVerified(string_view key) noexcept {
+    return verifiedSavestateSizes.contains(string(key));
+}
+
+void MelonDsDs::CacheSavestateSize(string_view key, size_t size) noexcept {
+    ZoneScopedN(TracyFunction);
+    verifiedSavestateSizes.emplace(key);
+    optional<string> path = retro::get_system_subdir_path(SAVESTATE_SIZE_CACHE_NAME);
+    if (!path) {
+        retro::warn("Failed to get the path of the savestate size cache");
+        return;
+    }
+
+    auto [entries, oldSize] = ReadSavestateSizeCache(*path, key);
+    if (oldSize == size) {
+        return; // Nothing to do
+    }
+
+    fmt::memory_buffer contents;
+    for (const string& entry : entries) {
+        fmt::format_to(std::back_inserter(contents), "{}\n", entry);
+    }
+    fmt::format_to(std::back_inserter(contents), "{} {}\n", key, size);
+
+    char dir[PATH_MAX_LENGTH];
+    strlcpy(dir, path->c_str(), sizeof(dir));
+    path_basedir(dir);
+    if (!path_mkdir(dir)) {
+        retro::warn("Failed to create directory \"{}\" for the savestate size cache", dir);
+        return;
+    }
+
+    if (filestream_write_file(path->c_str(), contents.data(), contents.size())) {
+        retro::debug("Cached savestate size {} for {}", size, key);
+    }
+    else {
+        retro::warn("Failed to write savestate size cache to \"{}\"", *path);
+    }
+}
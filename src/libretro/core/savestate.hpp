@@ -0,0 +1,48 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#ifndef MELONDSDS_CORE_SAVESTATE_HPP
+#define MELONDSDS_CORE_SAVESTATE_HPP
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace melonDS {
+    class NDS;
+}
+
+namespace MelonDsDs {
+    /// Returns a string that identifies everything about the console's current setup
+    /// that affects the size of its savestates (e.g. the game, the SRAM length, and the savestate version).
+    [[nodiscard]] std::string GetSavestateSizeKey(melonDS::NDS& nds) noexcept;
+
+    /// Looks up a savestate size that was computed before, possibly in a previous session.
+    /// A size from a previous session may be stale (e.g. written by a build with a different melonDS),
+    /// so it's only trusted if \c IsSavestateSizeVerified.
+    [[nodiscard]] std::optional<size_t> GetCachedSavestateSize(std::string_view key) noexcept;
+
+    /// Returns \c true if \c CacheSavestateSize was called for \c key since the core was loaded,
+    /// i.e. the cached size comes from a real savestate taken by this very build.
+    [[nodiscard]] bool IsSavestateSizeVerified(std::string_view key) noexcept;
+
+    /// Saves the size of a real savestate to the cache, replacing any existing entry with the same key.
+    void CacheSavestateSize(std::string_view key, size_t size) noexcept;
+}
+
+#endif // MELONDSDS_CORE_SAVESTATE_HPP
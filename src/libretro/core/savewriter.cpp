@@ -0,0 +1,200 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "savewriter.hpp"
+
+#include <algorithm>
+
+#include <retro_assert.h>
+#include <streams/file_stream.h>
+
+#include "environment.hpp"
+#include "tracy.hpp"
+
+using std::string;
+using std::string_view;
+
+MelonDsDs::SaveWriter::SaveWriter() noexcept {
+    ZoneScopedN(TracyFunction);
+    _lock = slock_new();
+    retro_assert(_lock != nullptr);
+
+#ifdef HAVE_THREADS
+    _wake = scond_new();
+    _idle = scond_new();
+    if (_wake && _idle) {
+        _thread = sthread_create(WorkerThread, this);
+    }
+
+    if (!_thread) {
+        retro::warn("Couldn't start a background thread for writing save data; it'll be written inline");
+    }
+#endif
+}
+
+MelonDsDs::SaveWriter::~SaveWriter() noexcept {
+    ZoneScopedN(TracyFunction);
+
+    if (_thread) {
+        slock_lock(_lock);
+        _stopping = true;
+        scond_signal(_wake);
+        slock_unlock(_lock);
+        sthread_join(_thread); // The worker drains the queue before it exits
+    }
+
+    if (_idle) {
+        scond_free(_idle);
+    }
+
+    if (_wake) {
+        scond_free(_wake);
+    }
+
+    slock_free(_lock);
+}
+
+bool MelonDsDs::SaveWriter::Write(string_view path, std::span<const std::byte> data) noexcept {
+    ZoneScopedN(TracyFunction);
+    retro_assert(!path.empty());
+
+    string key(path);
+    slock_lock(_lock);
+    auto last = _lastWritten.find(key);
+    if (last != _lastWritten.end() && std::ranges::equal(last->second, data)) {
+        // If this is exactly what we last wrote (or are about to write) here...
+        slock_unlock(_lock);
+        return false;
+    }
+
+    std::vector<std::byte> snapshot(data.begin(), data.end());
+    _lastWritten.insert_or_assign(key, snapshot);
+
+    if (!_thread) {
+        slock_unlock(_lock);
+        Job job {std::move(key), std::move(snapshot)};
+        WriteJob(job);
+        return true;
+    }
+
+    auto queued = std::ranges::find(_jobs, key, &Job::Path);
+    if (queued != _jobs.end()) {
+        // If an older version of this file hasn't been written yet, there's no point in writing it
+        queued->Data = std::move(snapshot);
+    }
+    else {
+        _jobs.push_back({std::move(key), std::move(snapshot)});
+    }
+
+    scond_signal(_wake);
+    slock_unlock(_lock);
+    return true;
+}
+
+void MelonDsDs::SaveWriter::Wait() noexcept {
+    ZoneScopedN(TracyFunction);
+    if (!_thread) {
+        return;
+    }
+
+    slock_lock(_lock);
+    while (!_jobs.empty() || _busy) {
+        scond_wait(_idle, _lock);
+    }
+    slock_unlock(_lock);
+}
+
+bool MelonDsDs::SaveWriter::IsWritten(string_view path) const noexcept {
+    string key(path);
+    slock_lock(_lock);
+    bool written = _writing != key && std::ranges::find(_jobs, key, &Job::Path) == _jobs.end() && _lastWritten.contains(key);
+    slock_unlock(_lock);
+    return written;
+}
+
+void MelonDsDs::SaveWriter::WorkerThread(void* self) noexcept {
+    SaveWriter& writer = *static_cast<SaveWriter*>(self);
+
+    slock_lock(writer._lock);
+    while (true) {
+        if (writer._jobs.empty()) {
+            scond_broadcast(writer._idle);
+            if (writer._stopping) {
+                break;
+            }
+
+            scond_wait(writer._wake, writer._lock);
+            continue;
+        }
+
+        Job job = std::move(writer._jobs.front());
+        writer._jobs.pop_front();
+        writer._busy = true;
+        writer._writing = job.Path;
+        slock_unlock(writer._lock);
+
+        writer.WriteJob(job);
+
+        slock_lock(writer._lock);
+        writer._busy = false;
+        writer._writing.clear();
+    }
+    slock_unlock(writer._lock);
+}
+
+void MelonDsDs::SaveWriter::WriteJob(Job& job) noexcept {
+    ZoneScopedN(TracyFunction);
+
+    if (WriteAtomically(job.Path, job.Data)) {
+        retro::debug("Wrote {} bytes to \"{}\"", job.Data.size(), job.Path);
+        return;
+    }
+
+    retro::error("Failed to write {} bytes to \"{}\"", job.Data.size(), job.Path);
+
+    slock_lock(_lock);
+    auto last = _lastWritten.find(job.Path);
+    if (last != _lastWritten.end() && last->second == job.Data) {
+        // If nothing newer was queued in the meantime, make sure the next flush tries again
+        _lastWritten.erase(last);
+    }
+    slock_unlock(_lock);
+}
+
+bool MelonDsDs::SaveWriter::WriteAtomically(const string& path, std::span<const std::byte> data) noexcept {
+    ZoneScopedN(TracyFunction);
+    string temporaryPath = path + ".tmp";
+
+    if (!filestream_write_file(temporaryPath.c_str(), data.data(), data.size())) {
+        filestream_delete(temporaryPath.c_str());
+        return false;
+    }
+
+    if (filestream_rename(temporaryPath.c_str(), path.c_str()) == 0) {
+        return true;
+    }
+
+    // Some platforms (e.g. Windows) won't rename a file over an existing one,
+    // so delete the destination and try again; the new data is safe in the temporary file until then
+    filestream_delete(path.c_str());
+    if (filestream_rename(temporaryPath.c_str(), path.c_str()) == 0) {
+        return true;
+    }
+
+    retro::warn("Couldn't rename \"{}\" to \"{}\"; the new data is still in the former", temporaryPath, path);
+    return false;
+}
@@ -0,0 +1,86 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <rthreads/rthreads.h>
+
+#include "std/span.hpp"
+
+namespace MelonDsDs {
+    /// Writes whole save files (GBA SRAM, firmware, WFC settings) in the background.
+    ///
+    /// Each write goes to a temporary file that's then renamed over the destination,
+    /// so a crash or power loss mid-write leaves the previous save intact.
+    /// Contents identical to what was last written to the same path are skipped.
+    class SaveWriter {
+    public:
+        SaveWriter() noexcept;
+
+        /// Finishes any pending writes.
+        ~SaveWriter() noexcept;
+        SaveWriter(const SaveWriter&) = delete;
+        SaveWriter(SaveWriter&&) = delete;
+        SaveWriter& operator=(const SaveWriter&) = delete;
+        SaveWriter& operator=(SaveWriter&&) = delete;
+
+        /// Copies \c data and queues it to be written to \c path.
+        /// If a write to \c path is already queued, it's replaced.
+        /// @returns \c false if \c data matches what was last written to \c path, in which case nothing is queued.
+        bool Write(std::string_view path, std::span<const std::byte> data) noexcept;
+
+        /// Blocks until every queued write has finished.
+        void Wait() noexcept;
+
+        /// Returns \c true if nothing is queued or being written to \c path,
+        /// and the last write to it succeeded.
+        [[nodiscard]] bool IsWritten(std::string_view path) const noexcept;
+
+        /// Writes \c data to a temporary file next to \c path, then renames it over \c path.
+        static bool WriteAtomically(const std::string& path, std::span<const std::byte> data) noexcept;
+    private:
+        struct Job {
+            std::string Path;
+            std::vector<std::byte> Data;
+        };
+
+        static void WorkerThread(void* self) noexcept;
+        void WriteJob(Job& job) noexcept;
+
+        slock_t* _lock = nullptr;
+        scond_t* _wake = nullptr;
+        scond_t* _idle = nullptr;
+        sthread_t* _thread = nullptr;
+        bool _stopping = false;
+        bool _busy = false;
+        std::deque<Job> _jobs;
+
+        // The path the worker is writing right now, if any
+        std::string _writing;
+
+        // What was last queued for each path, so unchanged data isn't written again.
+        // Failed writes are forgotten so the next flush retries them.
+        std::unordered_map<std::string, std::vector<std::byte>> _lastWritten;
+    };
+}
@@ -0,0 +1,161 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include "scheduler.hpp"
+
+#include <algorithm>
+
+#include <retro_assert.h>
+
+#include "tracy.hpp"
+
+using MelonDsDs::FrameScheduler;
+
+FrameScheduler::TimerId FrameScheduler::Add(const char* name, Callback&& callback) noexcept {
+    retro_assert(callback != nullptr);
+    _timers.push_back(Timer { .Name = name, .OnExpire = std::move(callback) });
+    return static_cast<TimerId>(_timers.size() - 1);
+}
+
+void FrameScheduler::Schedule(TimerId id, unsigned frames) noexcept {
+    if (id >= _timers.size())
+        return;
+
+    _timers[id].Pending = false;
+    if (_timers[id].Armed) {
+        Unlink(id);
+    }
+
+    Link(id, _now + std::max(frames, 1u));
+}
+
+void FrameScheduler::Cancel(TimerId id) noexcept {
+    if (id >= _timers.size())
+        return;
+
+    _timers[id].Pending = false;
+    if (_timers[id].Armed) {
+        Unlink(id);
+    }
+}
+
+bool FrameScheduler::Fire(TimerId id) noexcept {
+    if (id >= _timers.size() || !(_timers[id].Armed || _timers[id].Pending))
+        return false;
+
+    _timers[id].Pending = false;
+    if (_timers[id].Armed) {
+        Unlink(id);
+    }
+    Run(id);
+    return true;
+}
+
+bool FrameScheduler::Armed(TimerId id) const noexcept {
+    return id < _timers.size() && _timers[id].Armed;
+}
+
+unsigned FrameScheduler::Remaining(TimerId id) const noexcept {
+    if (!Armed(id))
+        return 0;
+
+    return static_cast<unsigned>(_timers[id].Deadline - _now);
+}
+
+void FrameScheduler::Tick() noexcept {
+    ++_now;
+    if (_armed == 0)
+        return;
+
+    uint32_t head = _slots[_now & SLOT_MASK];
+    if (head == NONE)
+        return;
+
+    ZoneScopedN(TracyFunction);
+
+    // Detach everything that's due before running any callbacks,
+    // since a callback may schedule or cancel other timers in this slot
+    _expired.clear();
+    for (uint32_t id = head; id != NONE;) {
+        uint32_t next = _timers[id].Next;
+        if (_timers[id].Deadline <= _now) {
+            Unlink(id);
+            _timers[id].Pending = true;
+            _expired.push_back(id);
+        }
+        id = next;
+    }
+
+    for (TimerId id : _expired) {
+        if (_timers[id].Pending) {
+            // If an earlier callback didn't cancel or reschedule this one...
+            _timers[id].Pending = false;
+            Run(id);
+        }
+    }
+}
+
+void FrameScheduler::Clear() noexcept {
+    _timers.clear();
+    _expired.clear();
+    _slots.fill(NONE);
+    _armed = 0;
+}
+
+void FrameScheduler::Link(TimerId id, uint64_t deadline) noexcept {
+    Timer& timer = _timers[id];
+    retro_assert(!timer.Armed);
+    uint32_t& head = _slots[deadline & SLOT_MASK];
+
+    timer.Deadline = deadline;
+    timer.Previous = NONE;
+    timer.Next = head;
+    timer.Armed = true;
+    if (head != NONE) {
+        _timers[head].Previous = id;
+    }
+    head = id;
+    ++_armed;
+}
+
+void FrameScheduler::Unlink(TimerId id) noexcept {
+    Timer& timer = _timers[id];
+    retro_assert(timer.Armed);
+
+    if (timer.Previous != NONE) {
+        _timers[timer.Previous].Next = timer.Next;
+    }
+    else {
+        _slots[timer.Deadline & SLOT_MASK] = timer.Next;
+    }
+
+    if (timer.Next != NONE) {
+        _timers[timer.Next].Previous = timer.Previous;
+    }
+
+    timer.Previous = NONE;
+    timer.Next = NONE;
+    timer.Armed = false;
+    --_armed;
+}
+
+void FrameScheduler::Run(TimerId id) noexcept {
+    unsigned again = _timers[id].OnExpire();
+    if (again > 0 && !_timers[id].Armed) {
+        // If the callback wants to run again and didn't already reschedule itself...
+        Link(id, _now + again);
+    }
+}
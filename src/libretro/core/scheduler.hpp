@@ -0,0 +1,98 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace MelonDsDs {
+    /// Runs callbacks after a given number of emulated frames.
+    ///
+    /// Timers live in a 256-slot wheel keyed on their deadline,
+    /// so each tick only looks at the timers that might expire on that frame
+    /// and a tick with nothing armed costs a single comparison.
+    /// Deadlines further out than one revolution stay in their slot until their frame comes around.
+    class FrameScheduler {
+    public:
+        using TimerId = uint32_t;
+
+        /// Called when a timer expires.
+        /// @returns The number of frames until the timer should fire again, or 0 to disarm it.
+        using Callback = std::function<unsigned()>;
+
+        static constexpr TimerId INVALID_TIMER = UINT32_MAX;
+
+        /// Registers a disarmed timer.
+        /// Must not be called from within a timer's callback.
+        [[nodiscard]] TimerId Add(const char* name, Callback&& callback) noexcept;
+
+        /// Arms \c id to fire \c frames ticks from now, replacing its existing deadline if it has one.
+        /// A delay of 0 is treated as 1.
+        void Schedule(TimerId id, unsigned frames) noexcept;
+
+        /// Disarms \c id without running its callback.
+        void Cancel(TimerId id) noexcept;
+
+        /// Disarms \c id and runs its callback now (and re-arms it if the callback asks).
+        /// @returns \c true if the timer was armed.
+        bool Fire(TimerId id) noexcept;
+
+        [[nodiscard]] bool Armed(TimerId id) const noexcept;
+
+        /// @returns The number of ticks until \c id fires, or 0 if it isn't armed.
+        [[nodiscard]] unsigned Remaining(TimerId id) const noexcept;
+
+        /// Advances the scheduler by one frame and runs any timers that expire on it.
+        void Tick() noexcept;
+
+        /// Removes all timers; their IDs become invalid.
+        void Clear() noexcept;
+    private:
+        static constexpr unsigned SLOT_COUNT = 256;
+        static constexpr unsigned SLOT_MASK = SLOT_COUNT - 1;
+        static constexpr uint32_t NONE = UINT32_MAX;
+
+        struct Timer {
+            const char* Name;
+            Callback OnExpire;
+            uint64_t Deadline = 0;
+            uint32_t Previous = NONE;
+            uint32_t Next = NONE;
+            bool Armed = false;
+            // Expired on this tick, but its callback hasn't run yet
+            bool Pending = false;
+        };
+
+        void Link(TimerId id, uint64_t deadline) noexcept;
+        void Unlink(TimerId id) noexcept;
+        void Run(TimerId id) noexcept;
+
+        std::vector<Timer> _timers {};
+        std::array<uint32_t, SLOT_COUNT> _slots = MakeEmptySlots();
+        std::vector<TimerId> _expired {};
+        uint64_t _now = 0;
+        unsigned _armed = 0;
+
+        static constexpr std::array<uint32_t, SLOT_COUNT> MakeEmptySlots() noexcept {
+            std::array<uint32_t, SLOT_COUNT> slots {};
+            slots.fill(NONE);
+            return slots;
+        }
+    };
+}
@@ -0,0 +1,67 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "screens.hpp"
+
+#include <NDS.h>
+
+#include "core.hpp"
+#include "environment.hpp"
+
+namespace MelonDsDs {
+    extern CoreState& Core;
+}
+
+static bool SetSeparateScreens(bool enabled) {
+    if (enabled && !retro::can_dupe()) {
+        retro::warn("Can't output screens separately, as the frontend doesn't accept duplicate frames");
+        return false;
+    }
+
+    MelonDsDs::Core.SetSeparateScreenOutput(enabled);
+    retro::info("{} separate screen output", enabled ? "Enabled" : "Disabled");
+    return true;
+}
+
+static bool GetScreen(melondsds_screen screen, melondsds_screen_image* image) {
+    const melonDS::NDS* nds = MelonDsDs::Core.GetConsole();
+    if (!image || !nds || (screen != MELONDSDS_SCREEN_TOP && screen != MELONDSDS_SCREEN_BOTTOM))
+        return false;
+
+    if (nds->GPU.GetRenderer3D().Accelerated)
+        // If the OpenGL renderer is drawing the screens, they never make it back to main memory
+        return false;
+
+    *image = {
+        .data = nds->GPU.Framebuffer[nds->GPU.FrontBuffer][screen].get(),
+        .width = MelonDsDs::NDS_SCREEN_WIDTH,
+        .height = MelonDsDs::NDS_SCREEN_HEIGHT,
+        .pitch = MelonDsDs::NDS_SCREEN_WIDTH * sizeof(uint32_t),
+    };
+
+    return image->data != nullptr;
+}
+
+extern "C" const melondsds_screen_interface* melondsds_get_screen_interface() {
+    static constexpr melondsds_screen_interface screenInterface {
+        .interface_version = MELONDSDS_SCREEN_INTERFACE_VERSION,
+        .set_separate_screens = SetSeparateScreens,
+        .get_screen = GetScreen,
+    };
+
+    return &screenInterface;
+}
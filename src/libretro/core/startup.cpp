@@ -0,0 +1,165 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "startup.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+#include <streams/file_stream.h>
+#include <string/stdstring.h>
+
+#include "environment.hpp"
+#include "tracy.hpp"
+
+using std::optional;
+using std::string;
+using std::chrono::duration;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using Clock = MelonDsDs::startup::clock;
+
+namespace {
+    struct StageRecord {
+        const char* Name;
+        Clock::time_point Start;
+        Clock::duration Duration;
+        unsigned Depth;
+    };
+
+    struct StartupState {
+        bool Active = false;
+        Clock::time_point Begin;
+        optional<string> TracePath;
+        std::vector<StageRecord> Stages;
+        unsigned Depth = 0;
+    };
+
+    StartupState State;
+
+    double Milliseconds(Clock::duration d) noexcept {
+        return duration<double, std::milli>(d).count();
+    }
+
+    long long Microseconds(Clock::duration d) noexcept {
+        return duration_cast<microseconds>(d).count();
+    }
+}
+
+void MelonDsDs::startup::Begin() noexcept {
+    State = {};
+    const char* trace = getenv("MELONDSDS_STARTUP_TRACE");
+    if (string_is_empty(trace))
+        return;
+
+    State.Active = true;
+    State.Begin = Clock::now();
+    if (!string_is_equal(trace, "log")) {
+        State.TracePath = trace;
+    }
+    State.Stages.reserve(16);
+}
+
+bool MelonDsDs::startup::Active() noexcept {
+    return State.Active;
+}
+
+MelonDsDs::startup::Stage::Stage(const char* name) noexcept : _name(name) {
+    if (State.Active) {
+        _start = Clock::now();
+        ++State.Depth;
+    }
+}
+
+MelonDsDs::startup::Stage::~Stage() noexcept {
+    if (!State.Active || State.Depth == 0)
+        return; // Startup finished (or restarted) while this stage was running
+
+    --State.Depth;
+    try {
+        State.Stages.push_back({_name, _start, Clock::now() - _start, State.Depth});
+    }
+    catch (...) {
+        // Not worth crashing over a missing stage
+    }
+}
+
+void MelonDsDs::startup::FirstFrame() noexcept try {
+    if (!State.Active)
+        return;
+
+    ZoneScopedN(TracyFunction);
+    State.Active = false;
+    Clock::duration total = Clock::now() - State.Begin;
+
+    // Stages are recorded when they end, so nested stages come before their parents;
+    // sorting by start time puts them back in the order they began
+    std::stable_sort(State.Stages.begin(), State.Stages.end(), [](const StageRecord& a, const StageRecord& b) {
+        return a.Start < b.Start || (a.Start == b.Start && a.Depth < b.Depth);
+    });
+
+    retro::info("Startup took {:.2f}ms from retro_init to the first frame", Milliseconds(total));
+    for (const StageRecord& stage : State.Stages) {
+        retro::info(
+            "  {:>{}}{}: {:.2f}ms (at {:.2f}ms)",
+            "",
+            stage.Depth * 2,
+            stage.Name,
+            Milliseconds(stage.Duration),
+            Milliseconds(stage.Start - State.Begin)
+        );
+    }
+
+    if (State.TracePath) {
+        // Chrome's trace event format; complete ("X") events with microsecond timestamps
+        fmt::memory_buffer trace;
+        fmt::format_to(
+            std::back_inserter(trace),
+            R"({{"traceEvents":[{{"name":"Startup","ph":"X","ts":0,"dur":{},"pid":1,"tid":1}})",
+            Microseconds(total)
+        );
+        for (const StageRecord& stage : State.Stages) {
+            fmt::format_to(
+                std::back_inserter(trace),
+                R"(,{{"name":"{}","ph":"X","ts":{},"dur":{},"pid":1,"tid":1}})",
+                stage.Name,
+                Microseconds(stage.Start - State.Begin),
+                Microseconds(stage.Duration)
+            );
+        }
+        fmt::format_to(std::back_inserter(trace), R"(],"displayTimeUnit":"ms"}})");
+
+        if (filestream_write_file(State.TracePath->c_str(), trace.data(), trace.size())) {
+            retro::info("Wrote startup trace to {}", *State.TracePath);
+        }
+        else {
+            retro::error("Failed to write startup trace to {}", *State.TracePath);
+        }
+    }
+
+    State.Stages = {};
+}
+catch (const std::exception& e) {
+    retro::error("Failed to report startup timings: {}", e.what());
+}
+catch (...) {
+    retro::error("Failed to report startup timings");
+}
@@ -0,0 +1,60 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#ifndef MELONDSDS_CORE_STARTUP_HPP
+#define MELONDSDS_CORE_STARTUP_HPP
+
+#include <chrono>
+
+namespace MelonDsDs::startup {
+    /// Measures how long the core takes to go from \c retro_init to its first presented frame,
+    /// broken down by the stages that run in between.
+    /// Configured through the \c MELONDSDS_STARTUP_TRACE environment variable:
+    ///
+    /// - Unset or empty: Nothing is recorded.
+    /// - \c log: A summary of each stage is logged once the first frame is presented.
+    /// - Anything else: The summary is logged and a Chrome trace (viewable in \c about:tracing or Perfetto)
+    ///   is written to that path.
+    ///
+    /// Not thread-safe; stages must only be recorded on the main thread.
+    using clock = std::chrono::steady_clock;
+
+    /// Call at the very start of \c retro_init.
+    void Begin() noexcept;
+
+    /// Call after the first frame is sent to the frontend.
+    /// Writes the report, then stops recording; does nothing on subsequent calls.
+    void FirstFrame() noexcept;
+
+    /// Whether stages are still being recorded.
+    [[nodiscard]] bool Active() noexcept;
+
+    /// Records the time between its construction and destruction as a startup stage.
+    /// Stages may be nested; \c name must have static storage duration.
+    class Stage {
+    public:
+        explicit Stage(const char* name) noexcept;
+        ~Stage() noexcept;
+        Stage(const Stage&) = delete;
+        Stage& operator=(const Stage&) = delete;
+    private:
+        const char* _name;
+        clock::time_point _start;
+    };
+}
+
+#endif // MELONDSDS_CORE_STARTUP_HPP
@@ -0,0 +1,486 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "statefile.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include <retro_assert.h>
+#include <streams/file_stream.h>
+#include <zlib.h>
+
+#include "core.hpp"
+#include "environment.hpp"
+#include "render/jobs.hpp"
+#include "savewriter.hpp"
+#include "tracy.hpp"
+
+namespace MelonDsDs {
+    extern CoreState& Core;
+}
+
+using std::optional;
+using std::nullopt;
+using std::span;
+using std::string;
+using std::vector;
+
+// Little-endian throughout:
+//   0  char[4]  magic ("MDSZ")
+//   4  u16      version
+//   6  u16      reserved (0)
+//   8  u32      uncompressed savestate size
+//  12  u32      uncompressed bytes per chunk (the last chunk may be shorter)
+//  16  u32      number of chunks
+//  20  u16      thumbnail width
+//  22  u16      thumbnail height
+//  24  u32      compressed thumbnail size
+//  28  u32[n]   compressed size of each chunk
+// ...followed by the compressed thumbnail, then each compressed chunk in order.
+// Every compressed block is its own zlib stream, so each can be (de)compressed on its own thread.
+constexpr std::array<char, 4> STATE_FILE_MAGIC = {'M', 'D', 'S', 'Z'};
+constexpr uint16_t STATE_FILE_VERSION = 1;
+constexpr size_t STATE_FILE_HEADER_SIZE = 28;
+
+// Savestates are mostly zeroes and repetitive tables, so faster levels lose very little
+constexpr int STATE_FILE_COMPRESSION_LEVEL = 3;
+
+// Including the writer thread, which runs jobs too; the emulator still needs a core to itself
+constexpr unsigned MAX_STATE_FILE_THREADS = 4;
+
+namespace {
+    struct StateFileHeader {
+        uint32_t StateSize;
+        uint32_t ChunkSize;
+        uint32_t ChunkCount;
+        uint16_t ThumbnailWidth;
+        uint16_t ThumbnailHeight;
+        uint32_t ThumbnailSize;
+        // Where the compressed thumbnail starts; the chunks come right after it
+        size_t DataOffset;
+    };
+}
+
+static uint16_t ReadU16(const std::byte* data) noexcept {
+    return static_cast<uint16_t>(data[0]) | (static_cast<uint16_t>(data[1]) << 8);
+}
+
+static uint32_t ReadU32(const std::byte* data) noexcept {
+    return static_cast<uint32_t>(ReadU16(data)) | (static_cast<uint32_t>(ReadU16(data + 2)) << 16);
+}
+
+static void AppendU16(vector<std::byte>& out, uint16_t value) noexcept {
+    out.push_back(static_cast<std::byte>(value & 0xFF));
+    out.push_back(static_cast<std::byte>(value >> 8));
+}
+
+static void AppendU32(vector<std::byte>& out, uint32_t value) noexcept {
+    AppendU16(out, value & 0xFFFF);
+    AppendU16(out, value >> 16);
+}
+
+static optional<StateFileHeader> ReadHeader(span<const std::byte> file) noexcept {
+    if (!MelonDsDs::IsStateFile(file) || file.size() < STATE_FILE_HEADER_SIZE)
+        return nullopt;
+
+    if (uint16_t version = ReadU16(file.data() + 4); version != STATE_FILE_VERSION) {
+        retro::error("Unsupported savestate file version {} (expected {})", version, STATE_FILE_VERSION);
+        return nullopt;
+    }
+
+    StateFileHeader header {
+        .StateSize = ReadU32(file.data() + 8),
+        .ChunkSize = ReadU32(file.data() + 12),
+        .ChunkCount = ReadU32(file.data() + 16),
+        .ThumbnailWidth = ReadU16(file.data() + 20),
+        .ThumbnailHeight = ReadU16(file.data() + 22),
+        .ThumbnailSize = ReadU32(file.data() + 24),
+    };
+
+    if (header.ChunkSize == 0 || header.ChunkCount != (size_t(header.StateSize) + header.ChunkSize - 1) / header.ChunkSize) {
+        retro::error("Savestate file's chunks don't add up to its {}-byte state", header.StateSize);
+        return nullopt;
+    }
+
+    header.DataOffset = STATE_FILE_HEADER_SIZE + size_t(header.ChunkCount) * sizeof(uint32_t);
+    if (file.size() < header.DataOffset + header.ThumbnailSize) {
+        retro::error("Savestate file is truncated");
+        return nullopt;
+    }
+
+    return header;
+}
+
+bool MelonDsDs::IsStateFile(span<const std::byte> file) noexcept {
+    return file.size() >= STATE_FILE_MAGIC.size() && memcmp(file.data(), STATE_FILE_MAGIC.data(), STATE_FILE_MAGIC.size()) == 0;
+}
+
+static vector<std::byte> Compress(span<const std::byte> data) noexcept {
+    uLongf length = compressBound(data.size());
+    vector<std::byte> compressed(length);
+    int result = compress2(
+        reinterpret_cast<Bytef*>(compressed.data()),
+        &length,
+        reinterpret_cast<const Bytef*>(data.data()),
+        data.size(),
+        STATE_FILE_COMPRESSION_LEVEL
+    );
+
+    if (result != Z_OK) {
+        retro::error("Failed to compress {} bytes of savestate (zlib error {})", data.size(), result);
+        return {};
+    }
+
+    compressed.resize(length);
+    return compressed;
+}
+
+static bool Decompress(span<std::byte> dest, span<const std::byte> src) noexcept {
+    uLongf length = dest.size();
+    int result = uncompress(reinterpret_cast<Bytef*>(dest.data()), &length, reinterpret_cast<const Bytef*>(src.data()), src.size());
+    return result == Z_OK && length == dest.size();
+}
+
+vector<std::byte> MelonDsDs::EncodeStateFile(span<const std::byte> state, const StateThumbnail& thumbnail, JobGroup* jobs) noexcept {
+    ZoneScopedN(TracyFunction);
+    retro_assert(thumbnail.Pixels.size() == size_t(thumbnail.Width) * thumbnail.Height);
+    size_t chunkCount = (state.size() + STATE_FILE_CHUNK_SIZE - 1) / STATE_FILE_CHUNK_SIZE;
+
+    // One job per chunk, plus one for the thumbnail
+    vector<vector<std::byte>> compressed(chunkCount + 1);
+    auto compress = [&](unsigned index) {
+        if (index < chunkCount) {
+            compressed[index] = Compress(state.subspan(index * STATE_FILE_CHUNK_SIZE, std::min(STATE_FILE_CHUNK_SIZE, state.size() - index * STATE_FILE_CHUNK_SIZE)));
+        }
+        else {
+            compressed[index] = Compress(std::as_bytes(span(thumbnail.Pixels)));
+        }
+    };
+
+    if (jobs) {
+        jobs->Run(compressed.size(), compress);
+    }
+    else {
+        for (unsigned i = 0; i < compressed.size(); ++i) {
+            compress(i);
+        }
+    }
+
+    if (std::ranges::any_of(compressed, [](const vector<std::byte>& block) { return block.empty(); })) {
+        return {};
+    }
+
+    size_t total = STATE_FILE_HEADER_SIZE + chunkCount * sizeof(uint32_t);
+    for (const vector<std::byte>& block : compressed) {
+        total += block.size();
+    }
+
+    vector<std::byte> file;
+    file.reserve(total);
+    for (char c : STATE_FILE_MAGIC) {
+        file.push_back(static_cast<std::byte>(c));
+    }
+    AppendU16(file, STATE_FILE_VERSION);
+    AppendU16(file, 0);
+    AppendU32(file, state.size());
+    AppendU32(file, STATE_FILE_CHUNK_SIZE);
+    AppendU32(file, chunkCount);
+    AppendU16(file, thumbnail.Width);
+    AppendU16(file, thumbnail.Height);
+    AppendU32(file, compressed.back().size());
+    for (size_t i = 0; i < chunkCount; ++i) {
+        AppendU32(file, compressed[i].size());
+    }
+
+    file.insert(file.end(), compressed.back().begin(), compressed.back().end());
+    for (size_t i = 0; i < chunkCount; ++i) {
+        file.insert(file.end(), compressed[i].begin(), compressed[i].end());
+    }
+
+    retro_assert(file.size() == total);
+    return file;
+}
+
+bool MelonDsDs::DecodeStateFile(span<const std::byte> file, vector<std::byte>& state, JobGroup* jobs) noexcept {
+    ZoneScopedN(TracyFunction);
+    optional<StateFileHeader> header = ReadHeader(file);
+    if (!header)
+        return false;
+
+    // Find where each chunk starts before handing them out, as they're packed back-to-back
+    vector<size_t> offsets(header->ChunkCount + 1);
+    offsets[0] = header->DataOffset + header->ThumbnailSize;
+    for (uint32_t i = 0; i < header->ChunkCount; ++i) {
+        offsets[i + 1] = offsets[i] + ReadU32(file.data() + STATE_FILE_HEADER_SIZE + i * sizeof(uint32_t));
+    }
+
+    if (offsets.back() > file.size()) {
+        retro::error("Savestate file is truncated");
+        return false;
+    }
+
+    // Each chunk decompresses straight into its place in the state
+    state.resize(header->StateSize);
+    std::atomic_bool failed = false;
+    auto decompress = [&](unsigned index) {
+        size_t start = size_t(index) * header->ChunkSize;
+        span<std::byte> dest = span(state).subspan(start, std::min<size_t>(header->ChunkSize, state.size() - start));
+        if (!Decompress(dest, file.subspan(offsets[index], offsets[index + 1] - offsets[index]))) {
+            failed.store(true, std::memory_order_relaxed);
+        }
+    };
+
+    if (jobs) {
+        jobs->Run(header->ChunkCount, decompress);
+    }
+    else {
+        for (unsigned i = 0; i < header->ChunkCount; ++i) {
+            decompress(i);
+        }
+    }
+
+    if (failed.load(std::memory_order_relaxed)) {
+        retro::error("Savestate file is corrupt");
+        return false;
+    }
+
+    return true;
+}
+
+optional<MelonDsDs::StateThumbnail> MelonDsDs::DecodeStateFileThumbnail(span<const std::byte> file) noexcept {
+    ZoneScopedN(TracyFunction);
+    optional<StateFileHeader> header = ReadHeader(file);
+    if (!header)
+        return nullopt;
+
+    StateThumbnail thumbnail {
+        .Pixels = vector<uint32_t>(size_t(header->ThumbnailWidth) * header->ThumbnailHeight),
+        .Width = header->ThumbnailWidth,
+        .Height = header->ThumbnailHeight,
+    };
+
+    if (!Decompress(std::as_writable_bytes(span(thumbnail.Pixels)), file.subspan(header->DataOffset, header->ThumbnailSize))) {
+        retro::error("Savestate file's thumbnail is corrupt");
+        return nullopt;
+    }
+
+    return thumbnail;
+}
+
+MelonDsDs::StateFileWriter::StateFileWriter() noexcept {
+    ZoneScopedN(TracyFunction);
+    _lock = slock_new();
+    retro_assert(_lock != nullptr);
+
+#ifdef HAVE_THREADS
+    _wake = scond_new();
+    _idle = scond_new();
+    if (_wake && _idle) {
+        _thread = sthread_create(WorkerThread, this);
+    }
+
+    if (!_thread) {
+        retro::warn("Couldn't start a background thread for writing savestate files; they'll be written inline");
+    }
+#endif
+}
+
+MelonDsDs::StateFileWriter::~StateFileWriter() noexcept {
+    ZoneScopedN(TracyFunction);
+
+    if (_thread) {
+        slock_lock(_lock);
+        _stopping = true;
+        scond_signal(_wake);
+        slock_unlock(_lock);
+        sthread_join(_thread); // The worker drains the queue before it exits
+    }
+
+    _workers = nullptr;
+
+    if (_idle) {
+        scond_free(_idle);
+    }
+
+    if (_wake) {
+        scond_free(_wake);
+    }
+
+    slock_free(_lock);
+}
+
+void MelonDsDs::StateFileWriter::Write(string path, vector<std::byte> state, StateThumbnail thumbnail) noexcept {
+    ZoneScopedN(TracyFunction);
+    retro_assert(!path.empty());
+
+    if (!_thread) {
+        WriteJob({std::move(path), std::move(state), std::move(thumbnail)});
+        return;
+    }
+
+    slock_lock(_lock);
+    auto queued = std::ranges::find(_jobs, path, &Job::Path);
+    if (queued != _jobs.end()) {
+        // If an older state hasn't been written here yet, there's no point in writing it
+        queued->State = std::move(state);
+        queued->Thumbnail = std::move(thumbnail);
+    }
+    else {
+        _jobs.push_back({std::move(path), std::move(state), std::move(thumbnail)});
+    }
+
+    scond_signal(_wake);
+    slock_unlock(_lock);
+}
+
+bool MelonDsDs::StateFileWriter::Wait() noexcept {
+    ZoneScopedN(TracyFunction);
+    slock_lock(_lock);
+    while (_thread && (!_jobs.empty() || _busy)) {
+        scond_wait(_idle, _lock);
+    }
+
+    bool succeeded = !_failed;
+    _failed = false;
+    slock_unlock(_lock);
+    return succeeded;
+}
+
+bool MelonDsDs::StateFileWriter::Decode(span<const std::byte> file, vector<std::byte>& state) noexcept {
+    ZoneScopedN(TracyFunction);
+
+    // The writer thread is idle once this returns, so the workers are ours until the next Write
+    Wait();
+    return DecodeStateFile(file, state, &Jobs());
+}
+
+MelonDsDs::JobGroup& MelonDsDs::StateFileWriter::Jobs() noexcept {
+    if (!_workers) {
+        unsigned threads = std::clamp(std::thread::hardware_concurrency(), 2u, MAX_STATE_FILE_THREADS);
+        _workers = std::make_unique<JobGroup>(threads - 1);
+    }
+
+    return *_workers;
+}
+
+void MelonDsDs::StateFileWriter::WorkerThread(void* self) noexcept {
+    StateFileWriter& writer = *static_cast<StateFileWriter*>(self);
+
+    slock_lock(writer._lock);
+    while (true) {
+        if (writer._jobs.empty()) {
+            scond_broadcast(writer._idle);
+            if (writer._stopping) {
+                break;
+            }
+
+            scond_wait(writer._wake, writer._lock);
+            continue;
+        }
+
+        Job job = std::move(writer._jobs.front());
+        writer._jobs.pop_front();
+        writer._busy = true;
+        slock_unlock(writer._lock);
+
+        writer.WriteJob(job);
+
+        slock_lock(writer._lock);
+        writer._busy = false;
+    }
+    slock_unlock(writer._lock);
+}
+
+void MelonDsDs::StateFileWriter::WriteJob(const Job& job) noexcept {
+    ZoneScopedN(TracyFunction);
+
+    vector<std::byte> file = EncodeStateFile(job.State, job.Thumbnail, &Jobs());
+    if (!file.empty() && SaveWriter::WriteAtomically(job.Path, file)) {
+        retro::info(
+            "Wrote savestate to \"{}\" ({}KiB, compressed from {}KiB)",
+            job.Path,
+            file.size() / 1024,
+            job.State.size() / 1024
+        );
+        return;
+    }
+
+    retro::error("Failed to write savestate to \"{}\"", job.Path);
+    slock_lock(_lock);
+    _failed = true;
+    slock_unlock(_lock);
+}
+
+static bool SaveStateFile(const char* path) {
+    if (!path || !*path)
+        return false;
+
+    return MelonDsDs::Core.SaveStateFile(path);
+}
+
+static bool LoadStateFile(const char* path) {
+    if (!path || !*path)
+        return false;
+
+    return MelonDsDs::Core.LoadSavestateFile(path);
+}
+
+static bool WaitForStateFiles() {
+    return MelonDsDs::Core.WaitForStateFiles();
+}
+
+static bool GetStateFileThumbnail(const char* path, uint32_t* pixels, size_t capacity, unsigned* width, unsigned* height) {
+    if (!path || !width || !height)
+        return false;
+
+    void* buffer = nullptr;
+    int64_t length = 0;
+    if (!filestream_read_file(path, &buffer, &length) || !buffer) {
+        retro::error("Failed to read savestate file {}", path);
+        return false;
+    }
+
+    optional<MelonDsDs::StateThumbnail> thumbnail = MelonDsDs::DecodeStateFileThumbnail(span(static_cast<const std::byte*>(buffer), static_cast<size_t>(length)));
+    free(buffer);
+    if (!thumbnail)
+        return false;
+
+    *width = thumbnail->Width;
+    *height = thumbnail->Height;
+    if (!pixels || capacity < thumbnail->Pixels.size())
+        return false;
+
+    std::ranges::copy(thumbnail->Pixels, pixels);
+    return true;
+}
+
+extern "C" const melondsds_savestate_interface* melondsds_get_savestate_interface() {
+    static constexpr melondsds_savestate_interface savestateInterface {
+        .interface_version = MELONDSDS_SAVESTATE_INTERFACE_VERSION,
+        .save_state_file = SaveStateFile,
+        .load_state_file = LoadStateFile,
+        .wait_for_state_files = WaitForStateFiles,
+        .get_state_file_thumbnail = GetStateFileThumbnail,
+    };
+
+    return &savestateInterface;
+}
@@ -0,0 +1,115 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#ifndef MELONDSDS_CORE_STATEFILE_HPP
+#define MELONDSDS_CORE_STATEFILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <rthreads/rthreads.h>
+
+#include "melondsds_savestate.h"
+#include "std/span.hpp"
+
+namespace MelonDsDs {
+    class JobGroup;
+
+    /// Uncompressed bytes in each independently-compressed chunk of a savestate file.
+    /// Big enough that zlib compresses each one about as well as the whole state,
+    /// small enough that even a DS-sized state is split across several threads.
+    constexpr size_t STATE_FILE_CHUNK_SIZE = 512 * 1024;
+
+    /// Both screens at native resolution, stacked vertically, as tightly-packed XRGB8888.
+    struct StateThumbnail {
+        std::vector<uint32_t> Pixels;
+        unsigned Width = 0;
+        unsigned Height = 0;
+    };
+
+    /// Returns \c true if \c file starts with a savestate file's header
+    /// (as opposed to being a plain \c retro_serialize buffer).
+    [[nodiscard]] bool IsStateFile(std::span<const std::byte> file) noexcept;
+
+    /// Compresses \c state chunk by chunk (in parallel across \c jobs, if given) into a savestate file.
+    /// @returns The encoded file, or an empty vector if compression failed.
+    [[nodiscard]] std::vector<std::byte> EncodeStateFile(std::span<const std::byte> state, const StateThumbnail& thumbnail, JobGroup* jobs) noexcept;
+
+    /// Decompresses the savestate in \c file into \c state (in parallel across \c jobs, if given),
+    /// resizing \c state to fit.
+    [[nodiscard]] bool DecodeStateFile(std::span<const std::byte> file, std::vector<std::byte>& state, JobGroup* jobs) noexcept;
+
+    [[nodiscard]] std::optional<StateThumbnail> DecodeStateFileThumbnail(std::span<const std::byte> file) noexcept;
+
+    /// Compresses and writes savestate files on a background thread,
+    /// which splits each one across a pool of workers.
+    /// Files are written to a temporary path first (see \c SaveWriter::WriteAtomically).
+    class StateFileWriter {
+    public:
+        StateFileWriter() noexcept;
+
+        /// Finishes any pending writes.
+        ~StateFileWriter() noexcept;
+        StateFileWriter(const StateFileWriter&) = delete;
+        StateFileWriter(StateFileWriter&&) = delete;
+        StateFileWriter& operator=(const StateFileWriter&) = delete;
+        StateFileWriter& operator=(StateFileWriter&&) = delete;
+
+        /// Queues \c state to be compressed and written to \c path.
+        /// If a write to \c path is already queued, it's replaced.
+        void Write(std::string path, std::vector<std::byte> state, StateThumbnail thumbnail) noexcept;
+
+        /// Blocks until every queued write has finished.
+        /// @returns \c false if any write since the last call failed.
+        bool Wait() noexcept;
+
+        /// Waits for any queued writes, then decompresses the savestate file in \c file across the worker pool.
+        [[nodiscard]] bool Decode(std::span<const std::byte> file, std::vector<std::byte>& state) noexcept;
+    private:
+        struct Job {
+            std::string Path;
+            std::vector<std::byte> State;
+            StateThumbnail Thumbnail;
+        };
+
+        static void WorkerThread(void* self) noexcept;
+        void WriteJob(const Job& job) noexcept;
+        JobGroup& Jobs() noexcept;
+
+        slock_t* _lock = nullptr;
+        scond_t* _wake = nullptr;
+        scond_t* _idle = nullptr;
+        sthread_t* _thread = nullptr;
+        bool _stopping = false;
+        bool _busy = false;
+        bool _failed = false;
+        std::deque<Job> _jobs;
+
+        // Only started once a state file is first saved or loaded,
+        // and only used by one thread at a time (the writer, or a loader that waited for it)
+        std::unique_ptr<JobGroup> _workers;
+    };
+}
+
+extern "C" const melondsds_savestate_interface* melondsds_get_savestate_interface();
+
+#endif // MELONDSDS_CORE_STATEFILE_HPP
@@ -28,7 +28,9 @@
 #include <streams/file_stream.h>
 
 
+#include "../arena.hpp"
 #include "../config/config.hpp"
+#include "../config/console.hpp"
 #include "core.hpp"
 #include "environment.hpp"
 #include "microphone.hpp"
@@ -47,6 +49,28 @@ constexpr const char* const OSD_DELIMITER = " || ";
 constexpr const char* const OSD_YES = "✔";
 constexpr const char* const OSD_NO = "✘";
 
+// How often the performance overlay is rebuilt; any faster and the numbers flicker too much to read
+constexpr std::chrono::milliseconds PERFORMANCE_OVERLAY_INTERVAL(250);
+
+// How long each on-screen display message stays up, in frames
+constexpr unsigned OSD_MESSAGE_DURATION = 60;
+
+// An unchanged message is sent again after this many frames, before the last one expires
+constexpr unsigned OSD_MESSAGE_REFRESH_FRAMES = OSD_MESSAGE_DURATION / 2;
+
+static void SendOsdMessage(const char* text) noexcept {
+    retro_message_ext message {
+        .msg = text,
+        .duration = OSD_MESSAGE_DURATION,
+        .priority = 0,
+        .level = RETRO_LOG_DEBUG,
+        .target = RETRO_MESSAGE_TARGET_OSD,
+        .type = RETRO_MESSAGE_TYPE_STATUS,
+        .progress = -1
+    };
+    retro::set_message(message);
+}
+
 static u8 GetDsiBatteryLevel(u8 percent) noexcept {
     u8 level = std::round(percent / 25.0f); // Round the percent from 0 to 4
     switch (level) {
@@ -66,75 +90,142 @@ static u8 GetDsiBatteryLevel(u8 percent) noexcept {
     }
 }
 
-retro::task::TaskSpec MelonDsDs::CoreState::PowerStatusUpdateTask() noexcept {
+void MelonDsDs::CoreState::InitTimers() noexcept {
     ZoneScopedN(TracyFunction);
-    retro::task::TaskSpec updatePowerStatus(
-        [this, timeToPowerStatusUpdate=0](retro::task::TaskHandle& task) mutable noexcept {
-            ZoneScopedN(TracyFunction);
-            if (!retro::supports_power_status()) {
-                // If this frontend or device doesn't support querying the power status...
-                task.Finish();
-                return;
-            }
+    _scheduler.Clear();
 
-            if (timeToPowerStatusUpdate > 0) {
-                // If we'll be checking the power status soon...
-                timeToPowerStatusUpdate--;
-            }
+    _ndsFlushTimer = _scheduler.Add("NDS SRAM Flush", [this]() noexcept {
+        if (_ndsSaveManager && _ndsSaveManager->IsDirect()) {
+            retro::debug("NDS SRAM flush timer expired, writing dirty ranges now");
+            _ndsSaveManager->WriteDirtyRanges();
+        }
+        return 0u;
+    });
 
-            if (timeToPowerStatusUpdate != 0) {
-                // If it's not yet time to check the power status...
-                return;
-            }
+    _gbaFlushTimer = _scheduler.Add("GBA SRAM Flush", [this]() noexcept {
+        if (_gbaSaveInfo) {
+            retro::debug("GBA SRAM flush timer expired, flushing save data now");
+            FlushGbaSram(*_gbaSaveInfo);
+        }
+        return 0u;
+    });
 
-            if (Console == nullptr)
-                return;
+    _firmwareFlushTimer = _scheduler.Add("Firmware Flush", [this]() noexcept {
+        if (Console && !_firmwareFlushPath.empty()) {
+            retro::debug("Firmware flush timer expired, flushing data now");
+            FlushFirmware(_firmwareFlushPath, _wfcSettingsFlushPath);
+        }
+        return 0u;
+    });
+
+    _powerStatusTimer = _scheduler.Add("Power Status Update", [this]() noexcept {
+        return UpdatePowerStatus();
+    });
+
+    _rumbleTimer = _scheduler.Add("Rumble", [this]() noexcept {
+        _inputState.RumbleStop();
+        return 0u;
+    });
+
+    _solarSensorTimer = _scheduler.Add("Solar Sensor", [this]() noexcept {
+        return _inputState.PollSolarSensor();
+    });
+
+#ifdef HAVE_ZLIB
+    _rewindTimer = _scheduler.Add("Rewind Snapshot", [this]() noexcept {
+        return TakeRewindSnapshot();
+    });
+#endif
+}
 
-            retro_assert(Console != nullptr);
-            if (optional<retro_device_power> devicePower = retro::get_device_power()) {
-                // ...and the check succeeded...
-                bool charging =
-                    devicePower->state == RETRO_POWERSTATE_CHARGING ||
-                    devicePower->state == RETRO_POWERSTATE_PLUGGED_IN;
-
-                switch (static_cast<ConsoleType>(Console->ConsoleType)) {
-                    case ConsoleType::DS: {
-                        // If the threshold is 0, the battery level is always okay
-                        // If the threshold is 100, the battery level is never okay
-                        bool ok =
-                            charging ||
-                            static_cast<unsigned>(devicePower->percent) > Config.DsPowerOkayThreshold();
-
-                        retro_assert(Console->SPI.GetPowerMan() != nullptr);
-                        Console->SPI.GetPowerMan()->SetBatteryLevelOkay(ok);
-                        break;
-                    }
-                    case ConsoleType::DSi: {
-                        DSi& dsi = *static_cast<DSi*>(Console.get());
-                        u8 percent = devicePower->percent == RETRO_POWERSTATE_NO_ESTIMATE ? 100 : devicePower->percent;
-                        u8 batteryLevel = GetDsiBatteryLevel(percent);
-                        retro_assert(dsi.I2C.GetBPTWL() != nullptr);
-                        dsi.I2C.GetBPTWL()->SetBatteryCharging(charging);
-                        dsi.I2C.GetBPTWL()->SetBatteryLevel(batteryLevel);
-                        break;
-                    }
-                }
+// Returns the number of frames until the next update, or 0 if there won't be one
+unsigned MelonDsDs::CoreState::UpdatePowerStatus() noexcept {
+    ZoneScopedN(TracyFunction);
+    if (!retro::supports_power_status()) {
+        // If this frontend or device doesn't support querying the power status...
+        return 0;
+    }
+
+    if (Config.Deterministic() && Config.BatterySaverThreshold() == 0 && !_batterySaverActive) {
+        // If the other players' batteries shouldn't affect the game (and nothing else needs the battery level)...
+        // (the console keeps its default full, okay battery)
+        return 0;
+    }
+
+    if (Console == nullptr)
+        return 1;
+
+    if (optional<retro_device_power> devicePower = retro::get_device_power()) {
+        // ...and the check succeeded...
+        bool charging =
+            devicePower->state == RETRO_POWERSTATE_CHARGING ||
+            devicePower->state == RETRO_POWERSTATE_PLUGGED_IN;
+
+        UpdateBatterySaver(*devicePower);
+        if (Config.Deterministic()) {
+            // The battery saver doesn't touch emulation, but the emulated battery would
+            return Config.PowerUpdateInterval() * 60;
+        }
+
+        switch (static_cast<ConsoleType>(Console->ConsoleType)) {
+            case ConsoleType::DS: {
+                // If the threshold is 0, the battery level is always okay
+                // If the threshold is 100, the battery level is never okay
+                bool ok =
+                    charging ||
+                    static_cast<unsigned>(devicePower->percent) > Config.DsPowerOkayThreshold();
+
+                retro_assert(Console->SPI.GetPowerMan() != nullptr);
+                Console->SPI.GetPowerMan()->SetBatteryLevelOkay(ok);
+                break;
             }
-            else {
-                retro::warn("Failed to get device power status\n");
+            case ConsoleType::DSi: {
+                DSi& dsi = *static_cast<DSi*>(Console.get());
+                u8 percent = devicePower->percent == RETRO_POWERSTATE_NO_ESTIMATE ? 100 : devicePower->percent;
+                u8 batteryLevel = GetDsiBatteryLevel(percent);
+                retro_assert(dsi.I2C.GetBPTWL() != nullptr);
+                dsi.I2C.GetBPTWL()->SetBatteryCharging(charging);
+                dsi.I2C.GetBPTWL()->SetBatteryLevel(batteryLevel);
+                break;
             }
+        }
+    }
+    else {
+        retro::warn("Failed to get device power status\n");
+    }
 
-            timeToPowerStatusUpdate = Config.PowerUpdateInterval() * 60; // Reset the timer
-        },
-        nullptr,
-        nullptr,
-        retro::task::ASAP,
-        "PowerStatusUpdateTask"
-    );
-
-    return updatePowerStatus;
+    return Config.PowerUpdateInterval() * 60;
 }
 
+void MelonDsDs::CoreState::UpdateBatterySaver(const retro_device_power& devicePower) noexcept {
+    ZoneScopedN(TracyFunction);
+    unsigned threshold = Config.BatterySaverThreshold();
+    bool discharging = devicePower.state == RETRO_POWERSTATE_DISCHARGING;
+    bool low = threshold >= 100 || (devicePower.percent != RETRO_POWERSTATE_NO_ESTIMATE && static_cast<unsigned>(devicePower.percent) <= threshold);
+    bool active = threshold > 0 && discharging && low;
+    if (active == _batterySaverActive) {
+        return;
+    }
+
+    _batterySaverActive = active;
+    if (active) {
+        retro::info("Host battery is at {}%, enabling the battery saver", devicePower.percent);
+    }
+    else {
+        retro::info("Host battery is charging or above the threshold, disabling the battery saver");
+    }
+
+    // The battery saver only touches settings that can change mid-game
+#ifdef HAVE_JIT
+    unsigned maxBlockSize = Config.MaxBlockSize(); // In case the JIT tuner is partway through measuring it
+#endif
+    ReparseConfig();
+#ifdef HAVE_JIT
+    Config.SetMaxBlockSize(maxBlockSize);
+#endif
+    ApplyConfig(Config, ConfigSubsystem::Renderer | ConfigSubsystem::Screen | ConfigSubsystem::Audio);
+    UpdateConsole(Config, *Console);
+}
 
 void MelonDsDs::CoreState::FlushFirmware(string_view firmwarePath, string_view wfcSettingsPath) noexcept {
     ZoneScopedN(TracyFunction);
@@ -145,6 +236,13 @@ void MelonDsDs::CoreState::FlushFirmware(string_view firmwarePath, string_view w
     retro_assert(path_is_absolute(wfcSettingsPath.data()));
     retro_assert(Console != nullptr);
 
+    if (!_firmwareDirty) {
+        // If the emulated system hasn't written to its firmware since it was loaded or last flushed...
+        retro::debug("Firmware hasn't been written to, not flushing it");
+        return;
+    }
+    _firmwareDirty = false;
+
     const Firmware& firmware = Console->GetFirmware();
 
     retro_assert(firmware.Buffer() != nullptr);
@@ -165,14 +263,14 @@ void MelonDsDs::CoreState::FlushFirmware(string_view firmwarePath, string_view w
         }
 
         retro_assert(firmwarePath.rfind("//notfound") == std::string_view::npos);
-        Firmware firmwareCopy(firmware);
         // TODO: Apply the original values of the settings that were overridden
-        if (filestream_write_file(firmwarePath.data(), firmware.Buffer(), firmware.Length())) {
+        std::span<const std::byte> data(reinterpret_cast<const std::byte*>(firmware.Buffer()), firmware.Length());
+        if (_saveWriter.Write(firmwarePath, data)) {
             // ...then write the whole thing back.
-            retro::debug("Flushed {}-byte firmware to \"{}\"", firmware.Length(), firmwarePath);
+            retro::debug("Queued {}-byte firmware to be written to \"{}\"", firmware.Length(), firmwarePath);
         }
         else {
-            retro::error("Failed to write {}-byte firmware to \"{}\"", firmware.Length(), firmwarePath);
+            retro::debug("Firmware hasn't changed since it was last flushed, not writing it");
         }
     }
     else {
@@ -198,44 +296,16 @@ void MelonDsDs::CoreState::FlushFirmware(string_view firmwarePath, string_view w
         retro_assert(eapend == apstart);
 
         const u8* buffer = firmware.GetExtendedAccessPointPosition();
-        if (filestream_write_file(wfcSettingsPath.data(), buffer, expectedWfcSettingsSize)) {
-            retro::debug("Flushed {}-byte WFC settings to \"{}\"", expectedWfcSettingsSize, wfcSettingsPath);
+        std::span<const std::byte> data(reinterpret_cast<const std::byte*>(buffer), expectedWfcSettingsSize);
+        if (_saveWriter.Write(wfcSettingsPath, data)) {
+            retro::debug("Queued {}-byte WFC settings to be written to \"{}\"", expectedWfcSettingsSize, wfcSettingsPath);
         }
         else {
-            retro::error("Failed to write {}-byte WFC settings to \"{}\"", expectedWfcSettingsSize, wfcSettingsPath);
+            retro::debug("WFC settings haven't changed since they were last flushed, not writing them");
         }
     }
 }
 
-// This task keeps running for the lifetime of the task queue.
-retro::task::TaskSpec MelonDsDs::CoreState::FlushGbaSramTask() noexcept {
-    ZoneScopedN(TracyFunction);
-    return {
-        [this](retro::task::TaskHandle &task) noexcept {
-            if (!_gbaSaveInfo) {
-                task.Finish();
-                return;
-            }
-
-            if (_timeToGbaFlush != nullopt && (*_timeToGbaFlush)-- <= 0) {
-                // If it's time to flush the GBA's SRAM...
-                retro::debug("GBA SRAM flush timer expired, flushing save data now");
-                FlushGbaSram(*_gbaSaveInfo);
-                _timeToGbaFlush = nullopt; // Reset the timer
-            }
-        },
-        nullptr,
-        [this](retro::task::TaskHandle& task) noexcept {
-            if (_gbaSaveInfo) {
-                FlushGbaSram(*_gbaSaveInfo);
-                _timeToGbaFlush = nullopt;
-            }
-        },
-        retro::task::ASAP,
-        "GBA SRAM Flush"
-    };
-}
-
 void MelonDsDs::CoreState::FlushGbaSram(const retro::GameInfo& gbaSaveInfo) noexcept {
     ZoneScopedN(TracyFunction);
 
@@ -251,22 +321,35 @@ void MelonDsDs::CoreState::FlushGbaSram(const retro::GameInfo& gbaSaveInfo) noex
         return; // TODO: Report this error
     }
 
-    if (!filestream_write_file(save_data_path.data(), gba_sram, gba_sram_length)) {
-        retro::error("Failed to write {}-byte GBA SRAM to \"{}\"", gba_sram_length, save_data_path);
-        // TODO: Report this to the user
+    // Written in the background; failures are logged by the writer
+    std::span<const std::byte> data(reinterpret_cast<const std::byte*>(gba_sram), gba_sram_length);
+    if (_saveWriter.Write(save_data_path, data)) {
+        retro::debug("Queued {}-byte GBA SRAM to be written to \"{}\"", gba_sram_length, save_data_path);
     } else {
-        retro::debug("Flushed {}-byte GBA SRAM to \"{}\"", gba_sram_length, save_data_path);
+        retro::debug("GBA SRAM hasn't changed since it was last flushed, not writing it");
+    }
+
+    if (sram::SaveJournal* journal = _gbaSaveManager->Journal()) {
+        // Either way, everything journaled so far is (or will be) in the save file
+        journal->BeginCompaction();
     }
 }
 
 
-retro::task::TaskSpec MelonDsDs::CoreState::FlushFirmwareTask(string_view firmwareName) noexcept {
+void MelonDsDs::CoreState::InitFirmwareFlush() noexcept {
     ZoneScopedN(TracyFunction);
+    retro_assert(Console != nullptr);
+    _firmwareDirty = false;
+    _firmwareFlushPath.clear();
+    _wfcSettingsFlushPath.clear();
+
+    string_view firmwareName = Config.FirmwarePath(static_cast<ConsoleType>(Console->ConsoleType));
     optional<string> firmwarePath = retro::get_system_path(firmwareName);
     if (!firmwarePath) {
         retro::error("Failed to get system path for firmware named \"{}\", firmware changes won't be saved.",
                      firmwareName);
-        return {};
+        retro::set_error_message("System path not found, changes to firmware settings won't be saved.");
+        return;
     }
 
     string_view wfcSettingsName = Config.GeneratedFirmwareSettingsPath();
@@ -274,26 +357,56 @@ retro::task::TaskSpec MelonDsDs::CoreState::FlushFirmwareTask(string_view firmwa
     if (!wfcSettingsPath) {
         retro::error("Failed to get system path for WFC settings at \"{}\", firmware changes won't be saved.",
                      wfcSettingsName);
-        return {};
+        retro::set_error_message("System path not found, changes to firmware settings won't be saved.");
+        return;
     }
 
-    return retro::task::TaskSpec(
-        [this, firmwarePath=*firmwarePath, wfcSettingsPath=*wfcSettingsPath](retro::task::TaskHandle&) noexcept {
-            if (_timeToFirmwareFlush != nullopt && (*_timeToFirmwareFlush)-- <= 0) {
-                // If it's time to flush the firmware...
-                retro::debug("Firmware flush timer expired, flushing data now");
-                FlushFirmware(firmwarePath, wfcSettingsPath);
-                _timeToFirmwareFlush = nullopt; // Reset the timer
-            }
-        },
-        nullptr,
-        [this, path=*firmwarePath, wfcSettingsPath=*wfcSettingsPath](retro::task::TaskHandle&) noexcept {
-            FlushFirmware(path, wfcSettingsPath);
-            _timeToFirmwareFlush = nullopt;
-        },
-        retro::task::ASAP,
-        "Firmware Flush"
-    );
+    _firmwareFlushPath = std::move(*firmwarePath);
+    _wfcSettingsFlushPath = std::move(*wfcSettingsPath);
+}
+
+// Writes out all pending save data now instead of waiting for the flush timers
+void MelonDsDs::CoreState::FlushSaveData() noexcept {
+    ZoneScopedN(TracyFunction);
+    _scheduler.Cancel(_ndsFlushTimer);
+    _scheduler.Cancel(_gbaFlushTimer);
+    _scheduler.Cancel(_firmwareFlushTimer);
+
+    if (_ndsSaveManager && _ndsSaveManager->IsDirect()) {
+        _ndsSaveManager->WriteDirtyRanges();
+    }
+
+    if (_gbaSaveInfo) {
+        FlushGbaSram(*_gbaSaveInfo);
+    }
+
+    if (Console && !_firmwareFlushPath.empty()) {
+        FlushFirmware(_firmwareFlushPath, _wfcSettingsFlushPath);
+    }
+}
+
+void MelonDsDs::CoreState::RumbleStart(std::chrono::milliseconds len) noexcept {
+    ZoneScopedN(TracyFunction);
+    if (unsigned frames = _inputState.RumbleStart(len)) {
+        // Each pulse extends the rumble instead of replacing it
+        _scheduler.Schedule(_rumbleTimer, _scheduler.Remaining(_rumbleTimer) + frames);
+    }
+}
+
+void MelonDsDs::CoreState::RumbleStop() noexcept {
+    ZoneScopedN(TracyFunction);
+    _scheduler.Cancel(_rumbleTimer);
+    _inputState.RumbleStop();
+}
+
+void MelonDsDs::CoreState::ScheduleSolarSensor() noexcept {
+    if (_inputState.UsesHostLightSensor()) {
+        // Read the sensor on the next frame, then let the timer set its own pace
+        _scheduler.Schedule(_solarSensorTimer, 1);
+    }
+    else {
+        _scheduler.Cancel(_solarSensorTimer);
+    }
 }
 
 #pragma clang diagnostic push
@@ -309,13 +422,67 @@ retro::task::TaskSpec MelonDsDs::CoreState::OnScreenDisplayTask() noexcept {
             NDS& nds = *Console;
 
             // TODO: If an on-screen display isn't supported, finish the task
-            fmt::memory_buffer buf;
+            OsdState state;
+            if (Config.ShowPointerCoordinates()) {
+                state.PointerRaw = _inputState.PointerRawPosition();
+                state.PointerTouch = _inputState.PointerTouchPosition();
+                state.JoystickTouch = _inputState.JoystickTouchPosition();
+            }
+
+            if (Config.ShowMicState() && _micState.IsHostMicActive()) {
+                // Toggle between a filled circle and an empty one every second
+                // (kind of like a blinking "recording" light)
+                state.MicActive = true;
+                state.MicLit = nds.NumFrames % 120 > 60;
+            }
+
+            if (Config.ShowCurrentLayout()) {
+                state.LayoutIndex = _screenLayout.LayoutIndex();
+                state.NumberOfLayouts = _screenLayout.NumberOfLayouts();
+            }
+
+            state.LidClosed = Config.ShowLidState() && nds.IsLidClosed();
+
+            const GBACart::CartGameSolarSensor* solarsensor = nullptr;
+            if (Config.ShowSensorReading()) {
+                if (const auto *gbacart = nds.GetGBACart(); gbacart && gbacart->Type() == GBACart::CartType::GameSolarSensor) {
+                    solarsensor = static_cast<const GBACart::CartGameSolarSensor*>(gbacart);
+                    state.LightLevel = solarsensor->GetLightLevel();
+                    if (auto lux = _inputState.LuxReading()) {
+                        state.LuxTenths = std::lround(*lux * 10);
+                    }
+                }
+            }
+
+            if (Config.ShowFrameTimings() || Config.ShowPerformanceOverlay() || Config.ShowMpStats()) {
+                // If we're showing numbers that change every frame, only refresh them a few times per second
+                FrameTimings::clock::time_point now = FrameTimings::clock::now();
+                if (now - _osdTelemetryTime >= PERFORMANCE_OVERLAY_INTERVAL) {
+                    _osdTelemetryTime = now;
+                    _osdTelemetryGeneration++;
+                }
+                state.TelemetryGeneration = _osdTelemetryGeneration;
+            }
+
+            if (state == _osdState) {
+                // If nothing on display has changed...
+                if (!_osdMessage.empty() && nds.NumFrames - _osdMessageFrame >= OSD_MESSAGE_REFRESH_FRAMES) {
+                    // ...but the last message is about to expire, then send it again as-is
+                    SendOsdMessage(_osdMessage.c_str());
+                    _osdMessageFrame = nds.NumFrames;
+                }
+                return;
+            }
+            _osdState = state;
+
+            // Runs inside CoreState::Run, so the arena outlives this buffer
+            FrameMemoryBuffer buf;
             auto inserter = std::back_inserter(buf);
 
             if (Config.ShowPointerCoordinates()) {
-                i16vec2 pointerInput = _inputState.PointerRawPosition();
-                ivec2 joystick = _inputState.JoystickTouchPosition();
-                ivec2 touch = _inputState.PointerTouchPosition();
+                i16vec2 pointerInput = state.PointerRaw;
+                ivec2 joystick = state.JoystickTouch;
+                ivec2 touch = state.PointerTouch;
                 fmt::format_to(
                     inserter,
                     "Pointer: ({}, {}) → ({}, {}) || Joystick: ({}, {})",
@@ -325,16 +492,14 @@ retro::task::TaskSpec MelonDsDs::CoreState::OnScreenDisplayTask() noexcept {
                 );
             }
 
-            if (Config.ShowMicState() && _micState.IsHostMicActive()) {
+            if (state.MicActive) {
                 // If the microphone is open and turned on...
                 fmt::format_to(
                     inserter,
                     "{}{}",
                     buf.size() == 0 ? "" : OSD_DELIMITER,
-                    (nds.NumFrames % 120 > 60) ? "●" : "○"
+                    state.MicLit ? "●" : "○"
                 );
-                // Toggle between a filled circle and an empty one every second
-                // (kind of like a blinking "recording" light)
             }
 
             if (Config.ShowCurrentLayout()) {
@@ -342,12 +507,12 @@ retro::task::TaskSpec MelonDsDs::CoreState::OnScreenDisplayTask() noexcept {
                     inserter,
                     "{}Layout {}/{}",
                     buf.size() == 0 ? "" : OSD_DELIMITER,
-                    _screenLayout.LayoutIndex() + 1,
-                    _screenLayout.NumberOfLayouts()
+                    state.LayoutIndex + 1,
+                    state.NumberOfLayouts
                 );
             }
 
-            if (Config.ShowLidState() && nds.IsLidClosed()) {
+            if (state.LidClosed) {
                 fmt::format_to(
                     inserter,
                     "{}Closed",
@@ -355,46 +520,126 @@ retro::task::TaskSpec MelonDsDs::CoreState::OnScreenDisplayTask() noexcept {
                 );
             }
 
-            if (Config.ShowSensorReading()) {
+            if (solarsensor) {
                 // If we want to show the active sensor reading...
-                if (const auto *gbacart = nds.GetGBACart(); gbacart && gbacart->Type() == GBACart::CartType::GameSolarSensor) {
-                    const auto* solarsensor = static_cast<const GBACart::CartGameSolarSensor*>(gbacart);
+                fmt::format_to(
+                    inserter,
+                    "{}☼ {}%",
+                    buf.size() == 0 ? "" : OSD_DELIMITER,
+                    state.LightLevel * 10
+                );
+                // LightLevel is an abstract value from 0 to 10 (inclusive)
 
+                // TODO: Add an option for showing the lux reading
+                if (state.LuxTenths >= 0) {
                     fmt::format_to(
                         inserter,
-                        "{}☼ {}%",
+                        "{} {:.1f} lux",
                         buf.size() == 0 ? "" : OSD_DELIMITER,
-                        solarsensor->GetLightLevel() * 10
+                        state.LuxTenths / 10.0f
                     );
-                    // LightLevel is an abstract value from 0 to 10 (inclusive)
+                }
+            }
 
-                    // TODO: Add an option for showing the lux reading
-                    if (auto lux = _inputState.LuxReading()) {
-                        fmt::format_to(
-                            inserter,
-                            "{} {:.1f} lux",
-                            buf.size() == 0 ? "" : OSD_DELIMITER,
-                            *lux
-                        );
+            if (Config.ShowFrameTimings() && _frameTimings.Frames() > 0) {
+                // If we want to see where each frame's time is going...
+                PhaseStatistics total = _frameTimings.Statistics(FramePhase::Total);
+                fmt::format_to(
+                    inserter,
+                    "{}{:.1f}ms (p99 {:.1f}) | Run {:.1f} | Render {:.1f} | Input {:.1f} | Audio {:.1f}",
+                    buf.size() == 0 ? "" : OSD_DELIMITER,
+                    total.Average,
+                    total.P99,
+                    _frameTimings.Statistics(FramePhase::RunFrame).Average,
+                    _frameTimings.Statistics(FramePhase::Render).Average,
+                    _frameTimings.Statistics(FramePhase::Input).Average,
+                    _frameTimings.Statistics(FramePhase::Audio).Average
+                );
+
+                if (std::optional<float> gpuFrameTime = _renderState.GpuFrameTime()) {
+                    // If the renderer can tell us how long the GPU takes per frame...
+                    fmt::format_to(inserter, " | GPU {:.1f}", *gpuFrameTime);
+                    if (std::optional<GpuStageTimes> stages = _renderState.GpuFrameStages()) {
+                        fmt::format_to(inserter, " (Emu {:.1f}, Present {:.1f})", stages->Emulation, stages->Presentation);
+                    }
+                }
+
+                if (_mpState.IsReady()) {
+                    // If we're waiting on other players' packets, show how long
+                    fmt::format_to(inserter, " | MP Wait {:.1f}", _frameTimings.Statistics(FramePhase::MpWait).Average);
+                }
+            }
+
+            if (Config.ShowPerformanceOverlay()) {
+                // If we want a compact summary of how well the core is keeping up...
+                // (Refreshed on the same schedule as the rest of the telemetry)
+                FrameTimings::clock::time_point now = _osdTelemetryTime;
+                auto elapsed = now - _performanceOverlayTime;
+                if (now != _performanceOverlayTime || nds.NumFrames < _performanceOverlayFrame) {
+                    // If it's time to refresh the overlay (or the console was reset)...
+                    using seconds = std::chrono::duration<double>;
+                    uint32_t frames = nds.NumFrames - _performanceOverlayFrame;
+                    bool firstUpdate = _performanceOverlayFrame == 0 || nds.NumFrames < _performanceOverlayFrame;
+                    _performanceOverlay.clear();
+                    auto overlay = std::back_inserter(_performanceOverlay);
+
+                    if (!firstUpdate) {
+                        // If we have a previous sample to measure the frame rate against...
+                        fmt::format_to(overlay, "{:.1f} FPS | ", frames / std::chrono::duration_cast<seconds>(elapsed).count());
+                    }
+
+                    fmt::format_to(
+                        overlay,
+                        "Emu {:.1f}ms | Render {:.1f}ms",
+                        _frameTimings.Statistics(FramePhase::RunFrame).Average,
+                        _frameTimings.Statistics(FramePhase::Render).Average
+                    );
+
+                    if (std::optional<float> gpuFrameTime = _renderState.GpuFrameTime()) {
+                        fmt::format_to(overlay, " | GPU {:.1f}ms", *gpuFrameTime);
+                    }
+
+                    if (std::optional<unsigned> audioFill = AudioBufferFill()) {
+                        fmt::format_to(overlay, " | Audio {}%", *audioFill);
+                    }
+
+                    _performanceOverlayTime = now;
+                    _performanceOverlayFrame = nds.NumFrames;
+                }
+
+                fmt::format_to(inserter, "{}{}", buf.size() == 0 ? "" : OSD_DELIMITER, _performanceOverlay);
+            }
+
+            if (Config.ShowMpStats() && _mpState.IsReady()) {
+                // If we want to see how well the local wireless session is holding up...
+                const MpStats& stats = _mpState.Stats();
+                fmt::format_to(
+                    inserter,
+                    "{}MP {:.0f}/{:.0f} pkt/s | Queue {} | Wait {:.1f}ms | Timeouts {}",
+                    buf.size() == 0 ? "" : OSD_DELIMITER,
+                    stats.PacketsSent,
+                    stats.PacketsReceived,
+                    stats.MaxQueueDepth,
+                    stats.ReplyWait,
+                    stats.Timeouts
+                );
+
+                for (uint8_t aid = 1; aid <= MpState::MAX_CLIENTS; aid++) {
+                    if (stats.PeerMask & (1 << aid)) {
+                        // For each client that's replied to us (if we're the host)...
+                        const MpPeerStats& peer = stats.Peers[aid];
+                        fmt::format_to(inserter, " | P{} {:.1f}±{:.1f}ms", aid, peer.RoundTripTime, peer.Jitter);
+                        if (peer.MissedReplies > 0) {
+                            fmt::format_to(inserter, " ({} missed)", peer.MissedReplies);
+                        }
                     }
                 }
             }
 
-            // fmt::format_to does not append a null terminator
-            buf.push_back('\0');
-
-
-            if (buf.size() > 0) {
-                retro_message_ext message {
-                    .msg = buf.data(),
-                    .duration = 60,
-                    .priority = 0,
-                    .level = RETRO_LOG_DEBUG,
-                    .target = RETRO_MESSAGE_TARGET_OSD,
-                    .type = RETRO_MESSAGE_TYPE_STATUS,
-                    .progress = -1
-                };
-                retro::set_message(message);
+            _osdMessage.assign(buf.data(), buf.size());
+            if (!_osdMessage.empty()) {
+                SendOsdMessage(_osdMessage.c_str());
+                _osdMessageFrame = nds.NumFrames;
             }
         },
         nullptr,
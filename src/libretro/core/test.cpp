@@ -16,10 +16,35 @@
 
 #include "test.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <numbers>
+#include <optional>
+#include <thread>
+#include <vector>
+
 #include <string/stdstring.h>
+#ifdef HAVE_OPENGL
+#include <glsm/glsm.h>
+#endif
 
 #include "core.hpp"
+#include "arena.hpp"
+#include "screens.hpp"
+#include "video.hpp"
 #include "environment.hpp"
+#include "config/parse.hpp"
+#include "cpu.hpp"
+#include "net/download.hpp"
+#include "pixels.hpp"
+#include "platform/sync.hpp"
+#include "retro/threads.hpp"
+#include "std/semaphore.hpp"
+#include "tracy/memory.hpp"
 
 namespace MelonDsDs
 {
@@ -175,6 +200,68 @@ extern "C" bool melondsds_is_opengl_renderer() {
     return mode && *mode == RenderMode::OpenGl;
 }
 
+extern "C" unsigned melondsds_opengl_calls_last_frame() {
+    return MelonDsDs::Core.GetGlCallsLastFrame();
+}
+
+/// Returns the first OpenGL error raised since the last call (clearing the rest),
+/// or 0 if there were none or the core wasn't built with OpenGL.
+extern "C" unsigned melondsds_opengl_error() {
+#ifdef HAVE_OPENGL
+    GLenum first = GL_NO_ERROR;
+    for (int i = 0; i < 16; ++i) {
+        // A lost context may report errors forever, so don't loop indefinitely
+        GLenum error = glGetError();
+        if (error == GL_NO_ERROR)
+            break;
+
+        if (first == GL_NO_ERROR)
+            first = error;
+    }
+
+    return first;
+#else
+    return 0;
+#endif
+}
+
+extern "C" void melondsds_set_frame_readback(bool enabled) {
+    MelonDsDs::Core.SetFrameReadbackEnabled(enabled);
+}
+
+extern "C" bool melondsds_frame_checksum(uint32_t* checksum) {
+    auto result = MelonDsDs::Core.GetLastFrameChecksum();
+    if (!result || !checksum)
+        return false;
+
+    *checksum = *result;
+    return true;
+}
+
+extern "C" uint64_t melondsds_frame_hashes_checked() {
+    const auto& log = MelonDsDs::Core.GetFrameHashLog();
+    return log ? log->Frames() : 0;
+}
+
+extern "C" bool melondsds_first_frame_hash_mismatch(uint64_t* frame) {
+    const auto& log = MelonDsDs::Core.GetFrameHashLog();
+    if (!log || !log->FirstMismatch() || !frame)
+        return false;
+
+    *frame = *log->FirstMismatch();
+    return true;
+}
+
+extern "C" bool melondsds_get_rtc_date_time(int* year, int* month, int* day, int* hour, int* minute) {
+    const auto* console = MelonDsDs::Core.GetConsole();
+    if (!console || !year || !month || !day || !hour || !minute)
+        return false;
+
+    int second = 0;
+    console->RTC.GetDateTime(*year, *month, *day, *hour, *minute, second);
+    return true;
+}
+
 extern "C" bool melondsds_is_software_renderer() {
     using namespace MelonDsDs;
     auto mode = Core.GetRenderMode();
@@ -188,7 +275,7 @@ extern "C" unsigned melondsds_num_cheats() {
     if (!console)
         return 0;
 
-    return console->AREngine.Cheats.size();
+    return Core.CheatCount();
 }
 
 extern "C" uint32_t melondsds_get_gba_cart_type() {
@@ -224,7 +311,456 @@ extern "C" unsigned melondsds_get_controller_port_device(unsigned port) noexcept
     return Core.GetInputState().GetControllerPortDevice(port);
 }
 
+extern "C" bool melondsds_get_frame_phase_stats(unsigned phase, float* min, float* avg, float* p99) {
+    using namespace MelonDsDs;
+    if (phase >= FRAME_PHASE_COUNT)
+        return false;
+
+    PhaseStatistics stats = Core.GetFrameTimings().Statistics(static_cast<FramePhase>(phase));
+    if (min) *min = stats.Min;
+    if (avg) *avg = stats.Average;
+    if (p99) *p99 = stats.P99;
+
+    return stats.Samples > 0;
+}
+
+extern "C" bool melondsds_get_audio_ring_stats(size_t* fill, size_t* minFill, size_t* maxFill, uint64_t* underruns, uint64_t* written) {
+    using namespace MelonDsDs;
+    std::optional<AudioRingStats> stats = Core.GetAudioRingStats();
+    if (!stats)
+        return false;
+
+    if (fill) *fill = stats->Fill;
+    if (minFill) *minFill = stats->MinFill;
+    if (maxFill) *maxFill = stats->MaxFill;
+    if (underruns) *underruns = stats->Underruns;
+    if (written) *written = stats->FramesWritten;
+
+    return true;
+}
+
+extern "C" bool melondsds_get_mic_capture_stats(uint64_t* captured, uint64_t* consumed, uint64_t* underruns) {
+    using namespace MelonDsDs;
+    const MicrophoneState& mic = Core.GetMicrophoneState();
+    if (!mic.IsHostMicOpen())
+        return false;
+
+    AudioRingStats stats = mic.GetCaptureStats();
+    if (captured) *captured = stats.FramesWritten;
+    if (consumed) *consumed = stats.FramesRead;
+    if (underruns) *underruns = stats.Underruns;
+
+    return true;
+}
+
+extern "C" void melondsds_log_frame_timings() {
+    using namespace MelonDsDs;
+    Core.GetFrameTimings().Log();
+}
+
+extern "C" const char* melondsds_pixel_kernel_set() {
+    using namespace MelonDsDs;
+    return pixels::GetName(pixels::Active().Set);
+}
+
+/// The variant that the named kernel (e.g. "pixels") was dispatched to, or \c nullptr if there's no such kernel.
+extern "C" const char* melondsds_kernel_variant(const char* kernel) {
+    return MelonDsDs::cpu::GetSelectedVariant(kernel ? kernel : "");
+}
+
+/// Checks that every kernel set this CPU supports produces the same results as the scalar one.
+extern "C" bool melondsds_pixel_kernels_match() {
+    using namespace MelonDsDs::pixels;
+    // An odd length, so that the scalar tails of the vectorized loops are covered too
+    constexpr size_t length = 1021;
+    std::vector<uint32_t> source(length);
+    for (size_t i = 0; i < length; i++) {
+        source[i] = static_cast<uint32_t>(i * 2654435761u);
+    }
+
+    const Kernels* scalar = Get(KernelSet::Scalar);
+    for (KernelSet set : {KernelSet::Sse2, KernelSet::Avx2, KernelSet::Neon}) {
+        const Kernels* kernels = Get(set);
+        if (!kernels)
+            continue;
+
+        std::vector<uint32_t> expected(length), actual(length);
+        scalar->Fill(expected.data(), length, 0x12345678);
+        kernels->Fill(actual.data(), length, 0x12345678);
+        if (expected != actual)
+            return false;
+
+        expected = source;
+        actual = source;
+        scalar->Invert(expected.data(), length);
+        kernels->Invert(actual.data(), length);
+        if (expected != actual)
+            return false;
+
+        scalar->SwapRedBlue(expected.data(), source.data(), length);
+        kernels->SwapRedBlue(actual.data(), source.data(), length);
+        if (expected != actual)
+            return false;
+
+        std::vector<uint16_t> expected16(length), actual16(length);
+        scalar->ConvertToRgb565(expected16.data(), source.data(), length);
+        kernels->ConvertToRgb565(actual16.data(), source.data(), length);
+        if (expected16 != actual16)
+            return false;
+    }
+
+    return true;
+}
+
+/// Runs one kernel over a frame-sized buffer \c iterations times.
+/// Returns the average nanoseconds per pixel, or a negative number if the kernel or set isn't available.
+extern "C" double melondsds_benchmark_pixel_kernel(const char* kernel, const char* set, unsigned iterations) {
+    using namespace MelonDsDs::pixels;
+    const Kernels* kernels = nullptr;
+    for (KernelSet s : {KernelSet::Scalar, KernelSet::Sse2, KernelSet::Avx2, KernelSet::Neon}) {
+        if (string_is_equal(set, GetName(s))) {
+            kernels = Get(s);
+            break;
+        }
+    }
+
+    if (!kernels || iterations == 0)
+        return -1;
+
+    // About the size of a 2x hybrid layout
+    constexpr size_t length = 1024 * 768;
+    std::vector<uint32_t> source(length, 0xFF336699);
+    std::vector<uint32_t> dest(length);
+    std::vector<uint16_t> dest16(length);
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < iterations; i++) {
+        if (string_is_equal(kernel, "fill")) {
+            kernels->Fill(dest.data(), length, i);
+        }
+        else if (string_is_equal(kernel, "invert")) {
+            kernels->Invert(dest.data(), length);
+        }
+        else if (string_is_equal(kernel, "swap_red_blue")) {
+            kernels->SwapRedBlue(dest.data(), source.data(), length);
+        }
+        else if (string_is_equal(kernel, "rgb565")) {
+            kernels->ConvertToRgb565(dest16.data(), source.data(), length);
+        }
+        else if (string_is_equal(kernel, "copy_rect")) {
+            // Copies a screen-wide column with padded rows, as PixelBuffer::CopyRows does
+            CopyRect(dest.data(), 1024, source.data(), 512, 512, 768);
+        }
+        else {
+            return -1;
+        }
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+
+    return elapsed.count() / (double(iterations) * length);
+}
+
+/// Returns the average time taken to produce each output frame in nanoseconds,
+/// or a negative number if the arguments are invalid or the resampler produced the wrong number of frames.
+extern "C" double melondsds_benchmark_resampler(const char* quality, unsigned outputRate, unsigned iterations) {
+    using namespace MelonDsDs;
+    std::optional<ResamplerQuality> parsedQuality = ParseResamplerQuality(quality);
+    if (!parsedQuality || outputRate == 0 || outputRate > AudioResampler::MAX_OUTPUT_RATE || iterations == 0)
+        return -1;
+
+    AudioResampler resampler(SAMPLE_RATE, outputRate, *parsedQuality);
+
+    // About one frame's worth of audio, as RenderAudio would get from the SPU
+    constexpr size_t inputFrames = 548;
+    std::vector<int16_t> input(inputFrames * 2);
+    for (size_t i = 0; i < inputFrames; ++i) {
+        // A 440 Hz tone in both channels
+        input[i * 2] = input[i * 2 + 1] = static_cast<int16_t>(16384 * std::sin(2 * std::numbers::pi * 440 * i / SAMPLE_RATE));
+    }
+    std::vector<int16_t> output(resampler.MaxOutputFrames(inputFrames) * 2);
+
+    size_t totalFrames = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < iterations; i++) {
+        totalFrames += resampler.Process(input, output);
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+
+    double expectedFrames = iterations * inputFrames * (outputRate / SAMPLE_RATE);
+    if (std::abs(totalFrames - expectedFrames) > resampler.Taps() + 2)
+        return -2;
+
+    return elapsed.count() / totalFrames;
+}
+
+namespace {
+    // Adapts the primitives that melonDS's semaphores and mutexes used to wrap
+    struct LegacySemaphore {
+        std::counting_semaphore<> semaphore {0};
+        void acquire() { semaphore.acquire(); }
+        void release(uint32_t count = 1) { semaphore.release(count); }
+        void reset() { while (semaphore.try_acquire()); }
+    };
+
+    // Two threads hand a permit back and forth, like the threaded renderer and the emulator thread
+    template <typename Semaphore>
+    double BenchmarkSemaphorePingPong(unsigned iterations) {
+        Semaphore ping, pong;
+        auto start = std::chrono::steady_clock::now();
+        std::thread partner([&] {
+            for (unsigned i = 0; i < iterations; i++) {
+                ping.acquire();
+                pong.release();
+            }
+        });
+
+        for (unsigned i = 0; i < iterations; i++) {
+            ping.release();
+            pong.acquire();
+        }
+        partner.join();
+        auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+
+        return elapsed.count() / iterations;
+    }
+
+    // Posts a burst of permits and then discards them, as the threaded renderer does when it restarts
+    template <typename Semaphore>
+    double BenchmarkSemaphoreReset(unsigned iterations) {
+        Semaphore semaphore;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned i = 0; i < iterations; i++) {
+            semaphore.release(192); // One for each scanline
+            semaphore.reset();
+        }
+        auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+
+        return elapsed.count() / iterations;
+    }
+
+    // A few threads take turns incrementing a shared counter
+    template <typename Mutex>
+    double BenchmarkMutex(unsigned iterations) {
+        constexpr unsigned THREADS = 4;
+        Mutex mutex;
+        unsigned counter = 0;
+        std::vector<std::thread> threads;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned t = 0; t < THREADS; t++) {
+            threads.emplace_back([&] {
+                for (unsigned i = 0; i < iterations; i++) {
+                    std::lock_guard guard(mutex);
+                    counter++;
+                }
+            });
+        }
+
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+
+        if (counter != THREADS * iterations)
+            return -2;
+
+        return elapsed.count() / (THREADS * iterations);
+    }
+}
+
+/// Returns the average time taken by one operation of the named benchmark in nanoseconds,
+/// or a negative number if the arguments are invalid or the primitive failed to exclude other threads.
+/// Benchmarks prefixed with "legacy_" use the primitives that the platform layer used to wrap.
+extern "C" double melondsds_benchmark_sync(const char* benchmark, unsigned iterations) {
+    using namespace MelonDsDs;
+    if (iterations == 0)
+        return -1;
+
+    if (string_is_equal(benchmark, "semaphore"))
+        return BenchmarkSemaphorePingPong<LightSemaphore>(iterations);
+
+    if (string_is_equal(benchmark, "legacy_semaphore"))
+        return BenchmarkSemaphorePingPong<LegacySemaphore>(iterations);
+
+    if (string_is_equal(benchmark, "semaphore_reset"))
+        return BenchmarkSemaphoreReset<LightSemaphore>(iterations);
+
+    if (string_is_equal(benchmark, "legacy_semaphore_reset"))
+        return BenchmarkSemaphoreReset<LegacySemaphore>(iterations);
+
+    if (string_is_equal(benchmark, "mutex"))
+        return BenchmarkMutex<LightMutex>(iterations);
+
+    if (string_is_equal(benchmark, "legacy_mutex"))
+        return BenchmarkMutex<retro::slock>(iterations);
+
+    return -1;
+}
+
+/// Writes the contention counters shared by the core's semaphores and mutexes.
+extern "C" void melondsds_get_sync_stats(uint64_t* spinAcquires, uint64_t* waits) {
+    MelonDsDs::SyncStats stats = MelonDsDs::GetSyncStats();
+    *spinAcquires = stats.SpinAcquires;
+    *waits = stats.Waits;
+}
+
+/// Writes the heap usage charged to the named subsystem (e.g. "Console").
+/// Returns false if the tag is unknown or this build doesn't count allocations.
+extern "C" bool melondsds_get_memory_usage(
+    [[maybe_unused]] const char* tag,
+    [[maybe_unused]] int64_t* bytes,
+    [[maybe_unused]] int64_t* peakBytes,
+    [[maybe_unused]] int64_t* allocations
+) {
+#ifdef HAVE_MEMORY_ACCOUNTING
+    std::optional<MelonDsDs::MemoryTag> memoryTag = MelonDsDs::ParseMemoryTag(tag ? tag : "");
+    if (!memoryTag)
+        return false;
+
+    MelonDsDs::MemoryUsage usage = MelonDsDs::GetMemoryUsage(*memoryTag);
+    *bytes = usage.Bytes;
+    *peakBytes = usage.PeakBytes;
+    *allocations = usage.Allocations;
+    return true;
+#else
+    return false;
+#endif
+}
+
+/// Whether the OS was asked to back main RAM with huge pages; see \c MelonDsDs::memory::HugePageStatus.
+extern "C" const char* melondsds_main_ram_huge_page_status() {
+    return MelonDsDs::memory::GetHugePageStatusName(Core.GetMainRamHugePageStatus());
+}
+
+/// How much of main RAM is currently backed by huge pages; \c false if that can't be determined.
+extern "C" bool melondsds_get_main_ram_huge_page_bytes(uint64_t* bytes) {
+    const melonDS::NDS* console = Core.GetConsole();
+    if (!console || !bytes)
+        return false;
+
+    std::optional<size_t> hugeBytes = MelonDsDs::memory::GetHugePageBytes(console->MainRAM, melonDS::MainRAMMaxSize);
+    if (!hugeBytes)
+        return false;
+
+    *bytes = *hugeBytes;
+    return true;
+}
+
+/// Reports the read-only file mappings shared with other processes (BIOS, firmware, and ROM images);
+/// the resident byte counts are 0 if the OS can't report them.
+extern "C" void melondsds_get_shared_mapping_usage(int64_t* mappings, int64_t* mappedBytes, int64_t* sharedBytes, int64_t* privateBytes) {
+    MelonDsDs::memory::SharedMappingUsage usage = MelonDsDs::memory::GetSharedMappingUsage();
+    *mappings = usage.Mappings;
+    *mappedBytes = usage.MappedBytes;
+    *sharedBytes = usage.SharedBytes;
+    *privateBytes = usage.PrivateBytes;
+}
+
+/// How many times the frontend's input callbacks were called while reading the last frame's input.
+extern "C" uint32_t melondsds_get_frame_input_calls() {
+    return Core.GetInputState().FrontendCallsPerFrame();
+}
+
+/// How many times the last frame allocated from the global heap; \c false if this build doesn't count allocations.
+extern "C" bool melondsds_get_frame_heap_allocations([[maybe_unused]] uint64_t* allocations) {
+#ifdef HAVE_MEMORY_ACCOUNTING
+    if (!allocations)
+        return false;
+
+    *allocations = MelonDsDs::GetLastFrameHeapAllocations();
+    return true;
+#else
+    return false;
+#endif
+}
+
+/// Logs \c count numbered records from a new thread, then waits for it to finish.
+extern "C" void melondsds_log_from_worker(unsigned count) {
+    std::thread worker([count] {
+        for (unsigned i = 0; i < count; ++i) {
+            retro::info("Worker log record {} of {}", i, count);
+        }
+    });
+    worker.join();
+}
+
+#ifdef HAVE_ZLIB
+/// Reports how many rewind snapshots can be stepped back to, and how many were evicted to make room for newer ones.
+extern "C" void melondsds_get_rewind_stats(uint64_t* length, uint64_t* evicted) {
+    MelonDsDs::RewindBuffer& rewind = Core.GetRewindBuffer();
+    *length = rewind.Length();
+    *evicted = rewind.Evicted();
+}
+
+/// Replaces the rewind buffer with one of \c bytes bytes, discarding the history.
+/// Lasts until the rewind buffer size option is next applied.
+extern "C" void melondsds_set_rewind_capacity(uint64_t bytes) {
+    Core.GetRewindBuffer().SetCapacity(bytes);
+}
+
+extern "C" void melondsds_rewind_step_back() {
+    Core.StepBackRewind();
+}
+#endif
+
+#ifdef HAVE_NETWORKING
+/// Fetches \c url through the download cache, treating cached copies older than \c maxAge seconds as stale.
+/// @returns The body's size (with as much of it as fits copied to \c buffer),
+/// or -1 if it couldn't be downloaded and wasn't cached.
+extern "C" int64_t melondsds_download(const char* url, int64_t maxAge, int64_t timeout, uint8_t* buffer, int64_t bufferSize) {
+    std::optional<MelonDsDs::DownloadCache> cache = MelonDsDs::DownloadCache::Default();
+    if (!cache)
+        return -1;
+
+    std::atomic_bool cancelled = false;
+    std::optional<std::vector<std::byte>> body = cache->Fetch(url, std::chrono::seconds(maxAge), std::chrono::seconds(timeout), cancelled);
+    if (!body)
+        return -1;
+
+    memcpy(buffer, body->data(), std::min<size_t>(body->size(), bufferSize));
+    return body->size();
+}
+
+/// Whether the download cache can ask the server if a stale copy is still current.
+extern "C" bool melondsds_download_cache_revalidates() {
+#ifdef HAVE_NET_HTTP_HEADERS
+    return true;
+#else
+    return false;
+#endif
+}
+#endif
+
 extern "C" retro_proc_address_t MelonDsDs::GetRetroProcAddress(const char* sym) noexcept {
+    if (string_is_equal(sym, MELONDSDS_GET_SCREEN_INTERFACE))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_get_screen_interface);
+
+    if (string_is_equal(sym, MELONDSDS_GET_VIDEO_INTERFACE))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_get_video_interface);
+
+    if (string_is_equal(sym, MELONDSDS_GET_PRELOAD_INTERFACE))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_get_preload_interface);
+
+#ifdef HAVE_ZLIB
+    if (string_is_equal(sym, MELONDSDS_GET_SAVESTATE_INTERFACE))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_get_savestate_interface);
+
+    if (string_is_equal(sym, "melondsds_get_rewind_stats"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_get_rewind_stats);
+
+    if (string_is_equal(sym, "melondsds_set_rewind_capacity"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_set_rewind_capacity);
+
+    if (string_is_equal(sym, "melondsds_rewind_step_back"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_rewind_step_back);
+#endif
+
+#ifdef HAVE_NETWORKING
+    if (string_is_equal(sym, "melondsds_download"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_download);
+
+    if (string_is_equal(sym, "melondsds_download_cache_revalidates"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_download_cache_revalidates);
+#endif
+
     if (string_is_equal(sym, "libretropy_add_integers"))
         return reinterpret_cast<retro_proc_address_t>(libretropy_add_integers);
 
@@ -291,6 +827,27 @@ extern "C" retro_proc_address_t MelonDsDs::GetRetroProcAddress(const char* sym)
     if (string_is_equal(sym, "melondsds_is_opengl_renderer"))
         return reinterpret_cast<retro_proc_address_t>(melondsds_is_opengl_renderer);
 
+    if (string_is_equal(sym, "melondsds_opengl_calls_last_frame"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_opengl_calls_last_frame);
+
+    if (string_is_equal(sym, "melondsds_opengl_error"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_opengl_error);
+
+    if (string_is_equal(sym, "melondsds_set_frame_readback"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_set_frame_readback);
+
+    if (string_is_equal(sym, "melondsds_frame_checksum"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_frame_checksum);
+
+    if (string_is_equal(sym, "melondsds_get_rtc_date_time"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_get_rtc_date_time);
+
+    if (string_is_equal(sym, "melondsds_frame_hashes_checked"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_frame_hashes_checked);
+
+    if (string_is_equal(sym, "melondsds_first_frame_hash_mismatch"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_first_frame_hash_mismatch);
+
     if (string_is_equal(sym, "melondsds_is_software_renderer"))
         return reinterpret_cast<retro_proc_address_t>(melondsds_is_software_renderer);
 
@@ -306,6 +863,60 @@ extern "C" retro_proc_address_t MelonDsDs::GetRetroProcAddress(const char* sym)
     if (string_is_equal(sym, "melondsds_get_controller_port_device"))
         return reinterpret_cast<retro_proc_address_t>(melondsds_get_controller_port_device);
 
+    if (string_is_equal(sym, "melondsds_get_frame_phase_stats"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_get_frame_phase_stats);
+
+    if (string_is_equal(sym, "melondsds_get_audio_ring_stats"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_get_audio_ring_stats);
+
+    if (string_is_equal(sym, "melondsds_get_mic_capture_stats"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_get_mic_capture_stats);
+
+    if (string_is_equal(sym, "melondsds_log_frame_timings"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_log_frame_timings);
+
+    if (string_is_equal(sym, "melondsds_pixel_kernel_set"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_pixel_kernel_set);
+
+    if (string_is_equal(sym, "melondsds_main_ram_huge_page_status"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_main_ram_huge_page_status);
+
+    if (string_is_equal(sym, "melondsds_get_main_ram_huge_page_bytes"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_get_main_ram_huge_page_bytes);
+
+    if (string_is_equal(sym, "melondsds_get_frame_heap_allocations"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_get_frame_heap_allocations);
+
+    if (string_is_equal(sym, "melondsds_get_shared_mapping_usage"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_get_shared_mapping_usage);
+
+    if (string_is_equal(sym, "melondsds_get_frame_input_calls"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_get_frame_input_calls);
+
+    if (string_is_equal(sym, "melondsds_kernel_variant"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_kernel_variant);
+
+    if (string_is_equal(sym, "melondsds_pixel_kernels_match"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_pixel_kernels_match);
+
+    if (string_is_equal(sym, "melondsds_benchmark_pixel_kernel"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_benchmark_pixel_kernel);
+
+    if (string_is_equal(sym, "melondsds_benchmark_resampler"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_benchmark_resampler);
+
+    if (string_is_equal(sym, "melondsds_benchmark_sync"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_benchmark_sync);
+
+    if (string_is_equal(sym, "melondsds_get_sync_stats"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_get_sync_stats);
+
+    if (string_is_equal(sym, "melondsds_get_memory_usage"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_get_memory_usage);
+
+    if (string_is_equal(sym, "melondsds_log_from_worker"))
+        return reinterpret_cast<retro_proc_address_t>(melondsds_log_from_worker);
+
     return nullptr;
 }
 
@@ -0,0 +1,89 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include "timing.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+#include "environment.hpp"
+#include "tracy.hpp"
+
+using std::chrono::duration;
+using std::chrono::duration_cast;
+
+void MelonDsDs::FrameTimings::Record(FramePhase phase, clock::duration elapsed) noexcept {
+    _samples[static_cast<size_t>(phase)][_cursor] = duration_cast<duration<float, std::milli>>(elapsed).count();
+}
+
+void MelonDsDs::FrameTimings::EndFrame() noexcept {
+    _cursor = (_cursor + 1) % WINDOW_SIZE;
+    // The slot under the cursor belongs to the frame in progress,
+    // so it's never included in the statistics
+    _count = std::min(_count + 1, WINDOW_SIZE - 1);
+
+    for (auto& phase : _samples) {
+        // Phases that don't run in the next frame shouldn't report stale timings
+        phase[_cursor] = 0;
+    }
+}
+
+void MelonDsDs::FrameTimings::Reset() noexcept {
+    for (auto& phase : _samples) {
+        phase.fill(0);
+    }
+    _cursor = 0;
+    _count = 0;
+}
+
+MelonDsDs::PhaseStatistics MelonDsDs::FrameTimings::Statistics(FramePhase phase) const noexcept {
+    ZoneScopedN(TracyFunction);
+    if (_count == 0)
+        return {};
+
+    const auto& samples = _samples[static_cast<size_t>(phase)];
+
+    // The completed frames are the _count slots just before the cursor
+    std::array<float, WINDOW_SIZE> sorted;
+    size_t start = (_cursor + WINDOW_SIZE - _count) % WINDOW_SIZE;
+    for (size_t i = 0; i < _count; ++i) {
+        sorted[i] = samples[(start + i) % WINDOW_SIZE];
+    }
+
+    auto end = sorted.begin() + _count;
+    auto p99 = sorted.begin() + std::min(_count - 1, (_count * 99) / 100);
+    std::nth_element(sorted.begin(), p99, end);
+
+    return {
+        .Min = *std::min_element(sorted.begin(), end),
+        .Average = std::accumulate(sorted.begin(), end, 0.0f) / _count,
+        .P99 = *p99,
+        .Samples = _count,
+    };
+}
+
+void MelonDsDs::FrameTimings::Log() const noexcept {
+    ZoneScopedN(TracyFunction);
+    if (_count == 0)
+        return;
+
+    retro::info("Frame timings over the last {} frames (min/avg/p99, in ms):", _count);
+    for (size_t i = 0; i < FRAME_PHASE_COUNT; ++i) {
+        auto phase = static_cast<FramePhase>(i);
+        PhaseStatistics stats = Statistics(phase);
+        retro::info("  {:<10} {:7.3f} {:7.3f} {:7.3f}", FramePhaseName(phase), stats.Min, stats.Average, stats.P99);
+    }
+}
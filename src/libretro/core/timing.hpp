@@ -0,0 +1,113 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef MELONDSDS_CORE_TIMING_HPP
+#define MELONDSDS_CORE_TIMING_HPP
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <string_view>
+
+namespace MelonDsDs {
+    /// The parts of \c CoreState::Run that are timed individually.
+    enum class FramePhase : unsigned {
+        Input,
+        Microphone,
+        RunFrame,
+        Render,
+        Audio,
+        Tasks,
+        /// Time spent waiting for local wireless packets; a subset of \c RunFrame.
+        MpWait,
+        /// Time spent emulating hidden run-ahead frames and rolling back from them.
+        RunAhead,
+        Total,
+    };
+
+    constexpr size_t FRAME_PHASE_COUNT = static_cast<size_t>(FramePhase::Total) + 1;
+
+    constexpr std::string_view FramePhaseName(FramePhase phase) noexcept {
+        switch (phase) {
+            case FramePhase::Input: return "Input";
+            case FramePhase::Microphone: return "Mic";
+            case FramePhase::RunFrame: return "RunFrame";
+            case FramePhase::Render: return "Render";
+            case FramePhase::Audio: return "Audio";
+            case FramePhase::Tasks: return "Tasks";
+            case FramePhase::MpWait: return "MP Wait";
+            case FramePhase::RunAhead: return "Run-Ahead";
+            case FramePhase::Total: return "Total";
+            default: return "Unknown";
+        }
+    }
+
+    /// Summary of a phase's recent timings, in milliseconds.
+    struct PhaseStatistics {
+        float Min = 0;
+        float Average = 0;
+        float P99 = 0;
+        size_t Samples = 0;
+    };
+
+    /// Keeps a rolling window of per-phase frame timings.
+    /// Always compiled in (unlike the Tracy zones),
+    /// so it's cheap enough to leave on in production builds.
+    class FrameTimings {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        void Record(FramePhase phase, clock::duration elapsed) noexcept;
+
+        /// Moves on to the next sample in the window.
+        /// Call once per frame after all phases have been recorded.
+        void EndFrame() noexcept;
+        void Reset() noexcept;
+
+        [[nodiscard]] PhaseStatistics Statistics(FramePhase phase) const noexcept;
+        [[nodiscard]] size_t Frames() const noexcept { return _count; }
+
+        /// The time spent in \c phase during the most recently completed frame, in milliseconds.
+        [[nodiscard]] float Latest(FramePhase phase) const noexcept {
+            return _count ? _samples[static_cast<size_t>(phase)][(_cursor + WINDOW_SIZE - 1) % WINDOW_SIZE] : 0;
+        }
+
+        /// Writes a summary of every phase to the log.
+        void Log() const noexcept;
+    private:
+        // 5 seconds' worth of frames at 60 FPS
+        static constexpr size_t WINDOW_SIZE = 300;
+        std::array<std::array<float, WINDOW_SIZE>, FRAME_PHASE_COUNT> _samples {};
+        size_t _cursor = 0;
+        size_t _count = 0;
+    };
+
+    /// Records the time spent in its scope to a \c FrameTimings.
+    class ScopedPhaseTimer {
+    public:
+        ScopedPhaseTimer(FrameTimings& timings, FramePhase phase) noexcept :
+            _timings(timings), _phase(phase), _start(FrameTimings::clock::now()) {}
+        ~ScopedPhaseTimer() noexcept { _timings.Record(_phase, FrameTimings::clock::now() - _start); }
+        ScopedPhaseTimer(const ScopedPhaseTimer&) = delete;
+        ScopedPhaseTimer& operator=(const ScopedPhaseTimer&) = delete;
+    private:
+        FrameTimings& _timings;
+        FramePhase _phase;
+        FrameTimings::clock::time_point _start;
+    };
+}
+
+#endif // MELONDSDS_CORE_TIMING_HPP
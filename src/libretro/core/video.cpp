@@ -0,0 +1,70 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "video.hpp"
+
+#include "core.hpp"
+#include "environment.hpp"
+
+namespace MelonDsDs {
+    extern CoreState& Core;
+}
+
+static bool SetNv12Output(bool enabled) {
+    if (enabled && !retro::can_dupe()) {
+        retro::warn("Can't output NV12 frames, as the frontend doesn't accept duplicate frames");
+        return false;
+    }
+
+    if (!MelonDsDs::Core.SetNv12Output(enabled)) {
+        retro::warn("Can't output NV12 frames with the current renderer");
+        return false;
+    }
+
+    retro::info("{} NV12 frame output", enabled ? "Enabled" : "Disabled");
+    return true;
+}
+
+static bool GetNv12Frame(melondsds_nv12_frame* frame) {
+    if (!frame)
+        return false;
+
+    const MelonDsDs::Nv12Frame* nv12 = MelonDsDs::Core.GetLastNv12Frame();
+    if (!nv12)
+        return false;
+
+    *frame = {
+        .luma = nv12->Luma,
+        .luma_pitch = nv12->LumaPitch,
+        .chroma = nv12->Chroma,
+        .chroma_pitch = nv12->ChromaPitch,
+        .width = nv12->Width,
+        .height = nv12->Height,
+    };
+
+    return true;
+}
+
+extern "C" const melondsds_video_interface* melondsds_get_video_interface() {
+    static constexpr melondsds_video_interface videoInterface {
+        .interface_version = MELONDSDS_VIDEO_INTERFACE_VERSION,
+        .set_nv12_output = SetNv12Output,
+        .get_nv12_frame = GetNv12Frame,
+    };
+
+    return &videoInterface;
+}
@@ -0,0 +1,195 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "cpu.hpp"
+
+#include <cstdlib>
+#include <iterator>
+#include <string>
+
+#include <features/features_cpu.h>
+#include <fmt/format.h>
+#include <string/stdstring.h>
+
+#include "environment.hpp"
+#include "tracy.hpp"
+
+using std::string_view;
+
+namespace {
+    // Constant-initialized, so kernels can register themselves during static initialization
+    MelonDsDs::cpu::KernelBase* Kernels = nullptr;
+
+    bool Initialized = false;
+    uint32_t DetectedFeatures = 0;
+    uint32_t EnabledFeatures = 0;
+
+    constexpr uint32_t Bit(MelonDsDs::cpu::Feature feature) noexcept {
+        return static_cast<uint32_t>(feature);
+    }
+
+    uint32_t DetectFeatures() noexcept {
+        using enum MelonDsDs::cpu::Feature;
+        uint64_t simd = cpu_features_get();
+        uint32_t features = 0;
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+        // Part of the x86-64 baseline, and required by 32-bit builds that define __SSE2__
+        features |= Bit(Sse2);
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+        // If the compiler lets us use NEON, then the target CPU is guaranteed to have it
+        features |= Bit(Neon);
+#endif
+
+        if (simd & RETRO_SIMD_SSE2) features |= Bit(Sse2);
+        if (simd & RETRO_SIMD_SSE4) features |= Bit(Sse41);
+        if (simd & RETRO_SIMD_AVX2) features |= Bit(Avx2);
+        if (simd & RETRO_SIMD_NEON) features |= Bit(Neon);
+
+        return features;
+    }
+
+    // Returns the features that MELONDSDS_CPU_FEATURES allows, or all of them if it isn't set
+    uint32_t ParseFeatureOverride(const char* text, bool log) noexcept {
+        using namespace MelonDsDs::cpu;
+        if (string_is_empty(text)) {
+            return ~0u;
+        }
+
+        uint32_t allowed = 0;
+        string_view list(text);
+        while (!list.empty()) {
+            size_t comma = list.find(',');
+            string_view name = list.substr(0, comma);
+            list = comma == string_view::npos ? string_view() : list.substr(comma + 1);
+            if (name.empty() || name == "none" || name == "scalar") {
+                continue;
+            }
+
+            bool known = false;
+            for (Feature feature : ALL_FEATURES) {
+                if (name == GetName(feature)) {
+                    allowed |= Bit(feature);
+                    known = true;
+                }
+            }
+
+            if (!known && log) {
+                retro::warn("Ignoring unknown CPU feature \"{}\" in MELONDSDS_CPU_FEATURES", name);
+            }
+        }
+
+        return allowed;
+    }
+
+    void EnsureDetected() noexcept {
+        if (!Initialized) {
+            // If a kernel is used before Init (e.g. during static initialization)...
+            DetectedFeatures = DetectFeatures();
+            EnabledFeatures = DetectedFeatures & ParseFeatureOverride(getenv("MELONDSDS_CPU_FEATURES"), false);
+        }
+    }
+
+    std::string FormatFeatures(uint32_t features) {
+        using namespace MelonDsDs::cpu;
+        fmt::memory_buffer buffer;
+        for (Feature feature : ALL_FEATURES) {
+            if (features & Bit(feature)) {
+                fmt::format_to(std::back_inserter(buffer), "{}{}", buffer.size() == 0 ? "" : " ", GetName(feature));
+            }
+        }
+
+        return buffer.size() == 0 ? std::string("none") : fmt::to_string(buffer);
+    }
+}
+
+MelonDsDs::cpu::KernelBase::KernelBase(const char* name) noexcept : _name(name), _next(Kernels) {
+    Kernels = this;
+}
+
+void MelonDsDs::cpu::Init() noexcept {
+    ZoneScopedN(TracyFunction);
+    DetectedFeatures = DetectFeatures();
+    const char* override = getenv("MELONDSDS_CPU_FEATURES");
+    EnabledFeatures = DetectedFeatures & ParseFeatureOverride(override, true);
+    Initialized = true;
+
+    if (string_is_empty(override)) {
+        retro::info("CPU features: {}", FormatFeatures(EnabledFeatures));
+    }
+    else {
+        retro::info(
+            "CPU features: {} (restricted by MELONDSDS_CPU_FEATURES=\"{}\"; detected {})",
+            FormatFeatures(EnabledFeatures),
+            override,
+            FormatFeatures(DetectedFeatures)
+        );
+    }
+
+    fmt::memory_buffer selections;
+    for (KernelBase* kernel = Kernels; kernel != nullptr; kernel = kernel->_next) {
+        // Re-selected every time, in case MELONDSDS_CPU_FEATURES changed since the last session
+        kernel->Select();
+        fmt::format_to(
+            std::back_inserter(selections),
+            "{}{}={}",
+            selections.size() == 0 ? "" : ", ",
+            kernel->Name(),
+            kernel->SelectedVariant()
+        );
+    }
+
+    if (selections.size() > 0) {
+        retro::info("Kernels: {}", fmt::to_string(selections));
+    }
+}
+
+bool MelonDsDs::cpu::Detected(Feature feature) noexcept {
+    EnsureDetected();
+    return DetectedFeatures & Bit(feature);
+}
+
+bool MelonDsDs::cpu::Enabled(Feature feature) noexcept {
+    EnsureDetected();
+    return EnabledFeatures & Bit(feature);
+}
+
+const char* MelonDsDs::cpu::GetName(Feature feature) noexcept {
+    switch (feature) {
+        case Feature::Sse2:
+            return "sse2";
+        case Feature::Sse41:
+            return "sse4.1";
+        case Feature::Avx2:
+            return "avx2";
+        case Feature::Neon:
+            return "neon";
+        default:
+            return "unknown";
+    }
+}
+
+const char* MelonDsDs::cpu::GetSelectedVariant(string_view kernel) noexcept {
+    for (KernelBase* k = Kernels; k != nullptr; k = k->_next) {
+        if (kernel == k->Name()) {
+            return k->SelectedVariant();
+        }
+    }
+
+    return nullptr;
+}
@@ -0,0 +1,124 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#ifndef MELONDSDS_CPU_HPP
+#define MELONDSDS_CPU_HPP
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "std/span.hpp"
+
+/// Detects the host CPU's instruction set extensions
+/// and lets each vectorized kernel pick its best implementation once, at startup.
+/// Set \c MELONDSDS_CPU_FEATURES to a comma-separated list of features (e.g. "sse2,avx2"), or to "none",
+/// to restrict the kernels to those features for A/B benchmarking.
+namespace MelonDsDs::cpu {
+    enum class Feature : uint32_t {
+        Sse2 = 1 << 0,
+        Sse41 = 1 << 1,
+        Avx2 = 1 << 2,
+        Neon = 1 << 3,
+    };
+
+    inline constexpr std::array ALL_FEATURES { Feature::Sse2, Feature::Sse41, Feature::Avx2, Feature::Neon };
+
+    /// Detects the CPU's features, applies \c MELONDSDS_CPU_FEATURES,
+    /// selects every kernel's variant, and logs the results.
+    /// Call from \c retro_init, before any threads that might use the kernels are started.
+    void Init() noexcept;
+
+    /// True if the CPU (and this build) supports \c feature, regardless of \c MELONDSDS_CPU_FEATURES.
+    [[nodiscard]] bool Detected(Feature feature) noexcept;
+
+    /// True if kernels are allowed to use \c feature.
+    [[nodiscard]] bool Enabled(Feature feature) noexcept;
+
+    [[nodiscard]] const char* GetName(Feature feature) noexcept;
+
+    /// The name of the variant that the named kernel is using, or \c nullptr if there's no such kernel.
+    [[nodiscard]] const char* GetSelectedVariant(std::string_view kernel) noexcept;
+
+    /// One implementation of a kernel.
+    template<typename Fn>
+    struct Variant {
+        const char* Name;
+        /// The feature this variant needs, or \c nullopt for the portable fallback.
+        std::optional<Feature> Requires;
+        Fn Function;
+    };
+
+    class KernelBase {
+    public:
+        KernelBase(const KernelBase&) = delete;
+        KernelBase& operator=(const KernelBase&) = delete;
+
+        [[nodiscard]] const char* Name() const noexcept { return _name; }
+        [[nodiscard]] virtual const char* SelectedVariant() const noexcept = 0;
+    protected:
+        /// Adds this kernel to the list that \c Init selects variants for.
+        explicit KernelBase(const char* name) noexcept;
+        ~KernelBase() = default;
+        virtual void Select() noexcept = 0;
+    private:
+        friend void Init() noexcept;
+        friend const char* GetSelectedVariant(std::string_view kernel) noexcept;
+        const char* _name;
+        KernelBase* _next;
+    };
+
+    /// A function (or table of functions) that's dispatched to the best variant
+    /// that the CPU and \c MELONDSDS_CPU_FEATURES allow.
+    /// Define each one at namespace scope, so that it's registered before \c Init runs.
+    template<typename Fn>
+    class Kernel final : public KernelBase {
+    public:
+        /// @param variants Listed from best to worst; the last one shouldn't require any features.
+        Kernel(const char* name, std::span<const Variant<Fn>> variants) noexcept :
+            KernelBase(name), _variants(variants) {}
+
+        /// The selected variant's function.
+        /// If \c Init hasn't run yet, the variant is selected now.
+        [[nodiscard]] Fn Get() noexcept {
+            if (!_selected) [[unlikely]] {
+                Select();
+            }
+            return _selected->Function;
+        }
+
+        [[nodiscard]] const char* SelectedVariant() const noexcept override {
+            return _selected ? _selected->Name : "unselected";
+        }
+    private:
+        void Select() noexcept override {
+            for (const Variant<Fn>& variant : _variants) {
+                if (!variant.Requires || Enabled(*variant.Requires)) {
+                    _selected = &variant;
+                    return;
+                }
+            }
+            _selected = &_variants.back();
+        }
+
+        std::span<const Variant<Fn>> _variants;
+        const Variant<Fn>* _selected = nullptr;
+    };
+}
+
+#endif // MELONDSDS_CPU_HPP
@@ -22,6 +22,7 @@
 #include <cstring>
 #include <string>
 #include <string_view>
+#include <utility>
 #include <vector>
 
 #include <fmt/core.h>
@@ -41,6 +42,7 @@
 #include "config/config.hpp"
 #include "core/test.hpp"
 #include "net/mp.hpp"
+#include "retro/logsink.hpp"
 #include "tracy.hpp"
 #include "version.hpp"
 
@@ -51,6 +53,8 @@ using std::nullopt;
 using std::vector;
 using namespace std::literals;
 
+std::atomic<retro_log_level> retro::detail::minLogLevel {RETRO_LOG_DEBUG};
+
 namespace retro {
     static retro_environment_t _environment;
     static retro_video_refresh_t _video_refresh;
@@ -58,11 +62,23 @@ namespace retro {
     static retro_input_poll_t _input_poll;
     static retro_input_state_t _input_state;
     static retro_log_printf_t _log;
+#ifdef HAVE_THREADS
+    // Only created if MELONDSDS_LOG_ASYNC is set, and never destroyed,
+    // since other threads may still log while the core shuts down
+    static std::atomic<AsyncLogSink*> _logSink = nullptr;
+#endif
     static bool _supports_bitmasks;
+    // input_poll and input_state calls since the last take_input_call_count
+    static uint32_t _inputCalls = 0;
     static bool _supportsPowerStatus;
     static bool _supportsNoGameMode;
+    static bool _canDupe;
+    // The frontend's default, per libretro.h
+    static retro_pixel_format _pixelFormat = RETRO_PIXEL_FORMAT_0RGB1555;
     static bool isShuttingDown = false;
+    static bool _avOutputSuppressed = false;
     static std::optional<std::chrono::microseconds> _lastFrameTime = std::nullopt;
+    static std::optional<AudioBufferStatus> _audioBufferStatus = std::nullopt;
 
     static unsigned _message_interface_version = UINT_MAX;
     constexpr size_t PATH_LENGTH = PATH_MAX + 1;
@@ -98,12 +114,27 @@ bool retro::environment(unsigned cmd, void* data) noexcept {
 
 bool retro::set_pixel_format(retro_pixel_format format) noexcept {
     ZoneScopedN(TracyFunction);
-    return environment(RETRO_ENVIRONMENT_SET_PIXEL_FORMAT, &format);
+    if (!environment(RETRO_ENVIRONMENT_SET_PIXEL_FORMAT, &format))
+        return false;
+
+    _pixelFormat = format;
+    return true;
+}
+
+bool retro::set_audio_callback(const retro_audio_callback& callback) noexcept {
+    ZoneScopedN(TracyFunction);
+    retro_audio_callback cb = callback;
+    return environment(RETRO_ENVIRONMENT_SET_AUDIO_CALLBACK, &cb);
+}
+
+retro_pixel_format retro::get_pixel_format() noexcept {
+    return _pixelFormat;
 }
 
 int16_t retro::input_state(unsigned port, unsigned device, unsigned index, unsigned id) {
     ZoneScopedN(TracyFunction);
     if (_input_state) {
+        _inputCalls++;
         return _input_state(port, device, index, id);
     } else {
         return 0;
@@ -138,12 +169,21 @@ glm::i16vec2 retro::analog_state(unsigned port, unsigned index) noexcept {
 void retro::input_poll() {
     ZoneScopedN(TracyFunction);
     if (_input_poll) {
+        _inputCalls++;
         _input_poll();
     }
 }
 
+uint32_t retro::take_input_call_count() noexcept {
+    return std::exchange(_inputCalls, 0);
+}
+
 size_t retro::audio_sample_batch(const int16_t* data, size_t frames) {
     ZoneScopedN(TracyFunction);
+    if (_avOutputSuppressed) {
+        return frames;
+    }
+
     if (_audio_sample_batch) {
         return _audio_sample_batch(data, frames);
     } else {
@@ -153,11 +193,15 @@ size_t retro::audio_sample_batch(const int16_t* data, size_t frames) {
 
 void retro::video_refresh(const void* data, unsigned width, unsigned height, size_t pitch) {
     ZoneScopedN(TracyFunction);
-    if (_video_refresh) {
+    if (_video_refresh && !_avOutputSuppressed) {
         _video_refresh(data, width, height, pitch);
     }
 }
 
+void retro::set_av_output_suppressed(bool suppressed) noexcept {
+    _avOutputSuppressed = suppressed;
+}
+
 bool retro::set_screen_rotation(ScreenOrientation orientation) noexcept {
     ZoneScopedN(TracyFunction);
     bool rotated = false;
@@ -304,10 +348,45 @@ std::optional<retro_throttle_state> retro::get_throttle_state() noexcept {
     return ok ? std::make_optional(throttleState) : std::nullopt;
 }
 
+std::optional<uint64_t> retro::set_serialization_quirks(uint64_t quirks) noexcept {
+    bool ok = environment(RETRO_ENVIRONMENT_SET_SERIALIZATION_QUIRKS, &quirks);
+    return ok ? std::make_optional(quirks) : std::nullopt;
+}
+
+retro_savestate_context retro::get_savestate_context() noexcept {
+    int context = RETRO_SAVESTATE_CONTEXT_UNKNOWN;
+    if (!environment(RETRO_ENVIRONMENT_GET_SAVESTATE_CONTEXT, &context))
+        return RETRO_SAVESTATE_CONTEXT_UNKNOWN;
+
+    return static_cast<retro_savestate_context>(context);
+}
+
+std::optional<retro_framebuffer> retro::get_software_framebuffer(unsigned width, unsigned height, unsigned access) noexcept {
+    retro_framebuffer framebuffer {};
+    framebuffer.width = width;
+    framebuffer.height = height;
+    framebuffer.access_flags = access;
+
+    if (!environment(RETRO_ENVIRONMENT_GET_CURRENT_SOFTWARE_FRAMEBUFFER, &framebuffer) || !framebuffer.data) {
+        return std::nullopt;
+    }
+
+    return framebuffer;
+}
+
+const retro_game_info_ext* retro::get_game_info_ext() noexcept {
+    const retro_game_info_ext* ext = nullptr;
+    return environment(RETRO_ENVIRONMENT_GET_GAME_INFO_EXT, &ext) ? ext : nullptr;
+}
+
 std::optional<std::chrono::microseconds> retro::last_frame_time() noexcept {
     return _lastFrameTime;
 }
 
+std::optional<retro::AudioBufferStatus> retro::audio_buffer_status() noexcept {
+    return _audioBufferStatus;
+}
+
 bool retro::is_variable_updated() noexcept {
     ZoneScopedN(TracyFunction);
 
@@ -333,10 +412,37 @@ constexpr uint32_t GetLogColor(retro_log_level level) noexcept {
 }
 #endif
 
+namespace retro {
+    // Where this thread's log records go instead of the frontend, if anywhere
+    static thread_local LogBuffer* _logCapture = nullptr;
+}
+
+retro::ScopedLogCapture::ScopedLogCapture(LogBuffer& buffer) noexcept : _previous(_logCapture) {
+    _logCapture = &buffer;
+}
+
+retro::ScopedLogCapture::~ScopedLogCapture() noexcept {
+    _logCapture = _previous;
+}
+
+void retro::LogBuffer::Replay() noexcept {
+    for (const auto& [level, text] : _records) {
+        // May be captured again, if this thread's own records are being held for another one
+        fmt_log(level, "{}", fmt::make_format_args(text));
+    }
+    _records.clear();
+}
+
 void retro::fmt_log(retro_log_level level, fmt::string_view fmt, fmt::format_args args) noexcept {
     fmt::basic_memory_buffer<char, 1024> buffer;
     fmt::vformat_to(std::back_inserter(buffer), fmt, args);
 
+    if (_logCapture) {
+        // If another thread is going to deliver this record...
+        _logCapture->_records.emplace_back(level, string(buffer.data(), buffer.size()));
+        return;
+    }
+
     if (buffer[buffer.size() - 1] != '\n')
         // If the string doesn't end with a newline...
         buffer.push_back('\n');
@@ -345,7 +451,15 @@ void retro::fmt_log(retro_log_level level, fmt::string_view fmt, fmt::format_arg
     buffer.push_back('\0');
 
     if (_log) {
+#ifdef HAVE_THREADS
+        AsyncLogSink* sink = _logSink.load(std::memory_order_acquire);
+        // Errors are delivered before returning, in case they're followed by a crash
+        if (!sink || !sink->Running() || !sink->Push(level, std::string_view(buffer.data(), buffer.size()), level >= RETRO_LOG_ERROR)) {
+            _log(level, buffer.data());
+        }
+#else
         _log(level, buffer.data());
+#endif
 #ifdef TRACY_ENABLE
         if (tracy::ProfilerAvailable()) {
             TracyMessageCS(buffer.data(), buffer.size() - 1, GetLogColor(level), 8);
@@ -361,7 +475,7 @@ void retro_vlog(enum retro_log_level level, const char* fmt, va_list va) {
 }
 
 void retro::vlog(enum retro_log_level level, const char* fmt, va_list va) noexcept {
-    if (fmt == nullptr)
+    if (fmt == nullptr || !is_log_enabled(level))
         return;
 
     if (_log) {
@@ -405,9 +519,12 @@ bool retro::set_error_message(const char* message, unsigned duration) {
 }
 
 bool retro::fmt_message(retro_log_level level, fmt::string_view format, fmt::format_args arg) noexcept {
-    string message = fmt::vformat(format, arg);
+    // Most notifications fit in the inline buffer, so this usually won't touch the heap
+    fmt::memory_buffer message;
+    fmt::vformat_to(std::back_inserter(message), format, arg);
+    message.push_back('\0');
     struct retro_message_ext message_ext {
-        .msg = message.c_str(),
+        .msg = message.data(),
         .duration = retro::DEFAULT_ERROR_DURATION,
         .priority = retro::DEFAULT_ERROR_PRIORITY,
         .level = level,
@@ -593,6 +710,10 @@ bool retro::supports_power_status() noexcept {
     return _supportsPowerStatus;
 }
 
+bool retro::can_dupe() noexcept {
+    return _canDupe;
+}
+
 optional<retro_device_power> retro::get_device_power() noexcept
 {
     ZoneScopedN(TracyFunction);
@@ -610,6 +731,22 @@ bool retro::set_hw_render(retro_hw_render_callback& callback) noexcept {
     return environment(RETRO_ENVIRONMENT_SET_HW_RENDER, &callback);
 }
 
+bool retro::set_hw_shared_context() noexcept {
+    ZoneScopedN(TracyFunction);
+
+    return environment(RETRO_ENVIRONMENT_SET_HW_SHARED_CONTEXT, nullptr);
+}
+
+optional<retro_hw_context_type> retro::get_preferred_hw_render() noexcept {
+    ZoneScopedN(TracyFunction);
+    unsigned preferred = RETRO_HW_CONTEXT_NONE;
+    if (!environment(RETRO_ENVIRONMENT_GET_PREFERRED_HW_RENDER, &preferred)) {
+        return nullopt;
+    }
+
+    return static_cast<retro_hw_context_type>(preferred);
+}
+
 optional<string_view> retro::get_save_directory() noexcept {
     return _saveDirLength ? std::make_optional<string_view>(_saveDir, _saveDirLength) : nullopt;
 }
@@ -737,6 +874,12 @@ bool retro::set_fastforwarding_override(const retro_fastforwarding_override& ove
     return environment(RETRO_ENVIRONMENT_SET_FASTFORWARDING_OVERRIDE, (void*) &override);
 }
 
+bool retro::set_memory_maps(const retro_memory_map& map) noexcept {
+    ZoneScopedN(TracyFunction);
+
+    return environment(RETRO_ENVIRONMENT_SET_MEMORY_MAPS, (void*) &map);
+}
+
 bool retro::clear_fastforwarding_override() noexcept {
     retro_fastforwarding_override override {};
     override.inhibit_toggle = false;
@@ -765,11 +908,23 @@ void retro::env::deinit() noexcept {
     _sysDirLength = 0;
     _sysSubdirLength = 0;
     _environment = nullptr;
+#ifdef HAVE_THREADS
+    if (AsyncLogSink* sink = _logSink.load(std::memory_order_acquire); sink && sink->Running()) {
+        // Deliver everything that's still queued while the frontend's log callback is still valid
+        LogSinkStats stats = sink->Stats();
+        retro::debug("Async log sink queued {} records ({} logged directly, {} stalls)", stats.Queued, stats.Oversized, stats.Stalls);
+        sink->Stop();
+    }
+#endif
     _log = nullptr;
     _supports_bitmasks = false;
     _supportsPowerStatus = false;
     _supportsNoGameMode = false;
+    _canDupe = false;
+    _pixelFormat = RETRO_PIXEL_FORMAT_0RGB1555;
     _lastFrameTime = std::nullopt;
+    _audioBufferStatus = std::nullopt;
+    _avOutputSuppressed = false;
     _message_interface_version = UINT_MAX;
 }
 
@@ -778,6 +933,15 @@ void retro::env::deinit() noexcept {
     retro::_lastFrameTime = std::chrono::microseconds(usec);
 }
 
+[[gnu::hot]] static void AudioBufferStatusCallback(bool active, unsigned occupancy, bool underrunLikely) noexcept {
+    if (active) {
+        retro::_audioBufferStatus = retro::AudioBufferStatus { occupancy, underrunLikely };
+    }
+    else {
+        retro::_audioBufferStatus = std::nullopt;
+    }
+}
+
 // This function might be called multiple times by the frontend,
 // and not always with the same value of cb.
 PUBLIC_SYMBOL void retro_set_environment(retro_environment_t cb) {
@@ -813,9 +977,38 @@ PUBLIC_SYMBOL void retro_set_environment(retro_environment_t cb) {
         _sensor = sensor;
     }
 
+    if (const char* level = getenv("MELONDSDS_LOG_LEVEL"); !string_is_empty(level)) {
+        // If the user wants to skip less severe messages without even formatting them...
+        // (the frontend's own log level only filters messages that we've already formatted)
+        if (string_is_equal_noncase(level, "debug")) {
+            detail::minLogLevel = RETRO_LOG_DEBUG;
+        } else if (string_is_equal_noncase(level, "info")) {
+            detail::minLogLevel = RETRO_LOG_INFO;
+        } else if (string_is_equal_noncase(level, "warn")) {
+            detail::minLogLevel = RETRO_LOG_WARN;
+        } else if (string_is_equal_noncase(level, "error")) {
+            detail::minLogLevel = RETRO_LOG_ERROR;
+        }
+    }
+
     retro_log_callback log_callback = {nullptr};
     if (environment(RETRO_ENVIRONMENT_GET_LOG_INTERFACE, &log_callback) && log_callback.log) {
         retro::_log = log_callback.log;
+#ifdef HAVE_THREADS
+        if (const char* async = getenv("MELONDSDS_LOG_ASYNC"); !string_is_empty(async)) {
+            // If the user wants log records handed to the frontend on a background thread...
+            // (some frontends write and flush each record to disk, which can stall us during bursts)
+            AsyncLogSink* sink = _logSink.load(std::memory_order_acquire);
+            if (!sink) {
+                sink = new AsyncLogSink;
+                _logSink.store(sink, std::memory_order_release);
+            }
+
+            if (!sink->Start(log_callback.log)) {
+                retro::warn("Failed to start the async log sink, logging synchronously instead");
+            }
+        }
+#endif
         retro::debug("retro_set_environment({})", fmt::ptr(cb));
     } else if (!retro::_log) {
         // retro_set_environment might be called multiple times with different callbacks
@@ -825,12 +1018,19 @@ PUBLIC_SYMBOL void retro_set_environment(retro_environment_t cb) {
     retro_frame_time_callback frame_time {FrameTimeCallback, static_cast<retro_usec_t>(MelonDsDs::US_PER_FRAME.count())};
     environment(RETRO_ENVIRONMENT_SET_FRAME_TIME_CALLBACK, &frame_time);
 
+    retro_audio_buffer_status_callback audio_buffer_status {AudioBufferStatusCallback};
+    environment(RETRO_ENVIRONMENT_SET_AUDIO_BUFFER_STATUS_CALLBACK, &audio_buffer_status);
+
     retro_get_proc_address_interface get_proc_address {MelonDsDs::GetRetroProcAddress};
     environment(RETRO_ENVIRONMENT_SET_PROC_ADDRESS_CALLBACK, &get_proc_address);
 
     retro::_supports_bitmasks |= environment(RETRO_ENVIRONMENT_GET_INPUT_BITMASKS, nullptr);
     retro::_supportsPowerStatus |= environment(RETRO_ENVIRONMENT_GET_DEVICE_POWER, nullptr);
 
+    if (bool canDupe = false; environment(RETRO_ENVIRONMENT_GET_CAN_DUPE, &canDupe)) {
+        retro::_canDupe |= canDupe;
+    }
+
     if (retro::_message_interface_version == UINT_MAX && !environment(RETRO_ENVIRONMENT_GET_MESSAGE_INTERFACE_VERSION, &retro::_message_interface_version)) {
         retro::_message_interface_version = UINT_MAX;
     }
@@ -17,19 +17,35 @@
 #ifndef MELONDS_DS_ENVIRONMENT_HPP
 #define MELONDS_DS_ENVIRONMENT_HPP
 
+#include <atomic>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <utility>
+#include <vector>
 #include <libretro.h>
 #include <glm/ext/vector_int2_sized.hpp>
 #undef isnan
 #include <fmt/format.h>
 #include "std/chrono.hpp"
 
+#ifndef MELONDSDS_MIN_LOG_LEVEL
+/// The least severe log level compiled into the core;
+/// calls to less severe logging functions compile to nothing.
+#define MELONDSDS_MIN_LOG_LEVEL RETRO_LOG_DEBUG
+#endif
+
 namespace retro {
     constexpr unsigned DEFAULT_ERROR_DURATION = 5000; // in ms
     constexpr unsigned DEFAULT_ERROR_PRIORITY = 3;
 
+    /// The frontend's most recent report of its audio buffer's state.
+    struct AudioBufferStatus {
+        /// How full the frontend's audio buffer is, from 0 to 100.
+        unsigned Occupancy;
+        bool UnderrunLikely;
+    };
+
     enum class ScreenOrientation {
         Normal = 0,
         RotatedLeft = 1,
@@ -41,30 +57,91 @@ namespace retro {
     bool environment(unsigned cmd, void *data) noexcept;
 
     bool set_pixel_format(retro_pixel_format format) noexcept;
+
+    /// The pixel format most recently accepted by the frontend.
+    retro_pixel_format get_pixel_format() noexcept;
     bool set_screen_rotation(ScreenOrientation orientation) noexcept;
     bool set_core_options(const retro_core_options_v2& options) noexcept;
 
+    /// Asks the frontend to pull audio from its own thread instead of the core pushing it once per frame.
+    /// Must be called during \c retro_load_game.
+    bool set_audio_callback(const retro_audio_callback& callback) noexcept;
+
     [[nodiscard]] bool is_variable_updated() noexcept;
 
+    namespace detail {
+        /// The least severe level logged at runtime, set once when the log interface is acquired.
+        /// Read on every logging call (possibly from other threads), hence the atomic.
+        extern std::atomic<retro_log_level> minLogLevel;
+    }
+
+    /// \c true if a message at \c level would be logged.
+    /// Logging functions check this before formatting anything.
+    [[nodiscard]] inline bool is_log_enabled(retro_log_level level) noexcept {
+        return level >= MELONDSDS_MIN_LOG_LEVEL && level >= detail::minLogLevel.load(std::memory_order_relaxed);
+    }
+
     void fmt_log(retro_log_level level, fmt::string_view fmt, fmt::format_args args) noexcept;
 
+    /// Log records held back from the frontend so that another thread can deliver them,
+    /// since the frontend's log callback isn't guaranteed to be safe to call from anywhere else.
+    class LogBuffer {
+    public:
+        /// Logs every held record (in order) on the calling thread, then forgets them.
+        void Replay() noexcept;
+    private:
+        friend void fmt_log(retro_log_level level, fmt::string_view fmt, fmt::format_args args) noexcept;
+        std::vector<std::pair<retro_log_level, std::string>> _records;
+    };
+
+    /// Holds every record logged on the calling thread in a \c LogBuffer until this guard is destroyed.
+    class ScopedLogCapture {
+    public:
+        explicit ScopedLogCapture(LogBuffer& buffer) noexcept;
+        ~ScopedLogCapture() noexcept;
+        ScopedLogCapture(const ScopedLogCapture&) = delete;
+        ScopedLogCapture& operator=(const ScopedLogCapture&) = delete;
+    private:
+        LogBuffer* _previous;
+    };
+
+    template <typename... T>
+    void log(retro_log_level level, fmt::format_string<T...> format, T&&... args) noexcept {
+        if (is_log_enabled(level)) {
+            fmt_log(level, format, fmt::make_format_args(args...));
+        }
+    }
+
     template <typename... T>
     void debug(fmt::format_string<T...> format, T&&... args) noexcept {
-        fmt_log(RETRO_LOG_DEBUG, format, fmt::make_format_args(args...));
+        if constexpr (RETRO_LOG_DEBUG >= MELONDSDS_MIN_LOG_LEVEL) {
+            if (is_log_enabled(RETRO_LOG_DEBUG)) {
+                fmt_log(RETRO_LOG_DEBUG, format, fmt::make_format_args(args...));
+            }
+        }
     }
 
     template <typename... T>
     void info(fmt::format_string<T...> format, T&&... args) noexcept {
-        fmt_log(RETRO_LOG_INFO, format, fmt::make_format_args(args...));
+        if constexpr (RETRO_LOG_INFO >= MELONDSDS_MIN_LOG_LEVEL) {
+            if (is_log_enabled(RETRO_LOG_INFO)) {
+                fmt_log(RETRO_LOG_INFO, format, fmt::make_format_args(args...));
+            }
+        }
     }
 
     template <typename... T>
     void warn(fmt::format_string<T...> format, T&&... args) noexcept {
-        fmt_log(RETRO_LOG_WARN, format, fmt::make_format_args(args...));
+        if constexpr (RETRO_LOG_WARN >= MELONDSDS_MIN_LOG_LEVEL) {
+            if (is_log_enabled(RETRO_LOG_WARN)) {
+                fmt_log(RETRO_LOG_WARN, format, fmt::make_format_args(args...));
+            }
+        }
     }
 
     template <typename... T>
     void error(fmt::format_string<T...> format, T&&... args) noexcept {
+        // Errors are always logged
         fmt_log(RETRO_LOG_ERROR, format, fmt::make_format_args(args...));
     }
 
@@ -99,17 +176,36 @@ namespace retro {
     std::optional<std::string_view> username() noexcept;
     void set_option_visible(const char* key, bool visible) noexcept;
     bool supports_power_status() noexcept;
+
+    /// If \c true, \c video_refresh can be given \c nullptr to show the previous frame again.
+    bool can_dupe() noexcept;
     std::optional<retro_device_power> get_device_power() noexcept;
     bool set_hw_render(retro_hw_render_callback& callback) noexcept;
 
+    /// Asks the frontend to give the core its own GL context (or one that it won't touch).
+    /// Must be called before \c set_hw_render.
+    /// @returns \c true if the frontend agreed.
+    bool set_hw_shared_context() noexcept;
+
+    /// The kind of hardware context that the frontend's video driver would rather give the core,
+    /// or \c std::nullopt if it won't say.
+    std::optional<retro_hw_context_type> get_preferred_hw_render() noexcept;
+
     bool supports_bitmasks();
     void input_poll();
     int16_t input_state(unsigned port, unsigned device, unsigned index, unsigned id);
     uint32_t joypad_state(unsigned port) noexcept;
     glm::i16vec2 analog_state(unsigned port, unsigned index) noexcept;
+
+    /// How many times the frontend's input callbacks were called since the last call to this function.
+    uint32_t take_input_call_count() noexcept;
     size_t audio_sample_batch(const int16_t *data, size_t frames);
     void video_refresh(const void *data, unsigned width, unsigned height, size_t pitch);
 
+    /// If \c true, \c audio_sample_batch and \c video_refresh become no-ops.
+    /// Used by the benchmark mode to measure emulation without frontend overhead.
+    void set_av_output_suppressed(bool suppressed) noexcept;
+
     bool shutdown() noexcept;
     bool set_rumble_state(unsigned port, retro_rumble_effect effect, uint16_t strength) noexcept;
     bool set_rumble_state(unsigned port, uint16_t strength) noexcept;
@@ -117,13 +213,37 @@ namespace retro {
     std::optional<float> sensor_get_input(unsigned port, unsigned id) noexcept;
 
     bool set_fastforwarding_override(const retro_fastforwarding_override& override) noexcept;
+
+    /// Describes where the console's memory regions live in its address space,
+    /// so achievement runtimes and memory scanners can read exact addresses without copying.
+    bool set_memory_maps(const retro_memory_map& map) noexcept;
     bool clear_fastforwarding_override() noexcept;
 
     std::optional<retro_microphone_interface> get_microphone_interface() noexcept;
     std::optional<bool> is_fastforwarding() noexcept;
     std::optional<retro_throttle_state> get_throttle_state() noexcept;
+
+    /// Tells the frontend how this core's savestates deviate from what it expects.
+    /// \returns The quirks the frontend acknowledged (plus any of its own, e.g. \c RETRO_SERIALIZATION_QUIRK_FRONT_VARIABLE_SIZE),
+    /// or \c nullopt if it doesn't support this.
+    std::optional<uint64_t> set_serialization_quirks(uint64_t quirks) noexcept;
+
+    /// Returns why the frontend is about to save or load a state,
+    /// or \c RETRO_SAVESTATE_CONTEXT_UNKNOWN if it won't say.
+    retro_savestate_context get_savestate_context() noexcept;
+
+    /// Asks the frontend for a framebuffer of the given size that the core can draw into directly.
+    /// Returns \c nullopt if the frontend doesn't support this or can't provide one this frame.
+    std::optional<retro_framebuffer> get_software_framebuffer(unsigned width, unsigned height, unsigned access) noexcept;
     std::optional<std::chrono::microseconds> last_frame_time() noexcept;
 
+    /// Returns \c nullopt if the frontend doesn't report its audio buffer's status,
+    /// or if audio is currently inactive (e.g. while fast-forwarding).
+    std::optional<AudioBufferStatus> audio_buffer_status() noexcept;
+
+    /// Returns one element for each loaded content file, or \c nullptr if the frontend doesn't support this.
+    const retro_game_info_ext* get_game_info_ext() noexcept;
+
     std::optional<std::string_view> get_save_directory() noexcept;
     std::optional<std::string_view> get_save_subdirectory() noexcept;
     std::optional<std::string> get_save_path(std::string_view name) noexcept;
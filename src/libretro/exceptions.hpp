@@ -171,6 +171,16 @@ namespace MelonDsDs
     public:
         using opengl_exception::opengl_exception;
     };
+
+    class vulkan_exception : public emulator_exception {
+    public:
+        using emulator_exception::emulator_exception;
+    };
+
+    class vulkan_not_initialized_exception : public vulkan_exception {
+    public:
+        using vulkan_exception::vulkan_exception;
+    };
 }
 
 #endif //MELONDS_DS_EXCEPTIONS_HPP
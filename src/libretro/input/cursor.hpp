@@ -46,6 +46,8 @@ namespace MelonDsDs {
         [[nodiscard]] glm::ivec2 JoypadTouchPosition() const noexcept { return _joystickCursorPosition; }
         [[nodiscard]] glm::ivec2 PointerTouchPosition() const noexcept { return _pointerCursorPosition; }
         [[nodiscard]] bool IsTouching() const noexcept;
+        /// Where the console's touch screen is being touched, in console pixels; only meaningful if \c IsTouching
+        [[nodiscard]] glm::uvec2 ConsoleTouch() const noexcept { return _consoleTouchPosition; }
         [[nodiscard]] bool TouchReleased() const noexcept { return _isTouchReleased; }
         [[nodiscard]] bool CursorVisible() const noexcept;
     private:
@@ -60,7 +60,7 @@ const struct retro_input_descriptor MelonDsDs::input_descriptors[] = {
         {0, RETRO_DEVICE_JOYPAD, 0,                               RETRO_DEVICE_ID_JOYPAD_START,  "Start"},
         {0, RETRO_DEVICE_JOYPAD, 0,                               RETRO_DEVICE_ID_JOYPAD_R,      "R"},
         {0, RETRO_DEVICE_JOYPAD, 0,                               RETRO_DEVICE_ID_JOYPAD_L,      "L"},
-        {0, RETRO_DEVICE_JOYPAD, 0,                               RETRO_DEVICE_ID_JOYPAD_X,      "X / ---"},
+        {0, RETRO_DEVICE_JOYPAD, 0,                               RETRO_DEVICE_ID_JOYPAD_X,      "X / Rewind"},
         {0, RETRO_DEVICE_JOYPAD, 0,                               RETRO_DEVICE_ID_JOYPAD_Y,      "Y / Close Lid"},
         {0, RETRO_DEVICE_JOYPAD, 0,                               RETRO_DEVICE_ID_JOYPAD_L2,     "Speedup/Slowdown Pointer+Enable Alternate Controls"},
         {0, RETRO_DEVICE_JOYPAD, 0,                               RETRO_DEVICE_ID_JOYPAD_R2,     "Touch Joystick"},
@@ -102,9 +102,10 @@ void MelonDsDs::InputState::SetControllerPortDevice(unsigned int port, unsigned
 void InputState::Update(const CoreConfig& config, const ScreenLayoutData& layout) noexcept {
     ZoneScopedN(TracyFunction);
 
+    // First get the raw input from libretro itself, all at once
+    retro::take_input_call_count(); // Don't count anything that happened between frames
     retro::input_poll();
 
-    // First get the raw input from libretro itself
     InputPollResult pollResult;
 
     pollResult.JoypadButtons = retro::joypad_state(0);
@@ -120,19 +121,29 @@ void InputState::Update(const CoreConfig& config, const ScreenLayoutData& layout
         pollResult.PointerPosition.x = retro::input_state(0, RETRO_DEVICE_POINTER, 0, RETRO_DEVICE_ID_POINTER_X);
         pollResult.PointerPosition.y = retro::input_state(0, RETRO_DEVICE_POINTER, 0, RETRO_DEVICE_ID_POINTER_Y);
     }
+
+    auto* solar = get_if<SolarSensorState>(&_slot2);
+    if (solar && solar->UsesLightLevelButtons()) {
+        // If the player adjusts the light level with buttons (or the mouse wheel) instead of a real sensor...
+        pollResult.MouseWheelUp = retro::input_state(0, RETRO_DEVICE_MOUSE, 0, RETRO_DEVICE_ID_MOUSE_WHEELUP) != 0;
+        pollResult.MouseWheelDown = retro::input_state(0, RETRO_DEVICE_MOUSE, 0, RETRO_DEVICE_ID_MOUSE_WHEELDOWN) != 0;
+    }
     pollResult.Timestamp = cpu_features_get_perf_counter();
+    pollResult.FrontendCalls = retro::take_input_call_count();
+    _frontendCalls = pollResult.FrontendCalls;
+    TracyPlot("Input Callbacks Per Frame", static_cast<int64_t>(pollResult.FrontendCalls));
 
     // Update each device's internal state
     _joypad.Update(pollResult);
-    if (auto* solar = get_if<SolarSensorState>(&_slot2)) {
-        solar->Update(_joypad);
+    if (solar) {
+        solar->Update(_joypad, pollResult);
     }
     _pointer.Update(pollResult);
 
     _cursor.Update(config, layout, _pointer, _joypad);
 }
 
-void InputState::Apply(melonDS::NDS& nds, ScreenLayoutData& layout, MicrophoneState& mic, CoreConfig& config) const noexcept {
+void InputState::Apply(melonDS::NDS& nds, ScreenLayoutData& layout, MicrophoneState& mic, CoreConfig& config) noexcept {
     ZoneScopedN(TracyFunction);
 
     // Adjust the screen layout based on the frontend's input
@@ -145,7 +156,7 @@ void InputState::Apply(melonDS::NDS& nds, ScreenLayoutData& layout, MicrophoneSt
     _joypad.Apply(mic);
 
     _joypad.Apply(config);
-    if (const auto* solar = get_if<SolarSensorState>(&_slot2)) {
+    if (auto* solar = get_if<SolarSensorState>(&_slot2)) {
         solar->Apply(nds);
     }
 
@@ -182,10 +193,20 @@ void InputState::SetSlot2Input(const melonDS::GBACart::CartCommon& gbacart) noex
     }
 }
 
-void InputState::RumbleStart(std::chrono::milliseconds len) noexcept {
+unsigned InputState::PollSolarSensor() noexcept {
+    if (auto* solar = get_if<SolarSensorState>(&_slot2)) {
+        return solar->Poll();
+    }
+
+    return 0;
+}
+
+unsigned InputState::RumbleStart(std::chrono::milliseconds len) noexcept {
     if (auto* rumble = get_if<RumbleState>(&_slot2)) {
-        rumble->RumbleStart(len);
+        return rumble->RumbleStart(len);
     }
+
+    return 0;
 }
 
 void InputState::RumbleStop() noexcept {
@@ -198,12 +219,12 @@ void melonDS::Platform::Addon_RumbleStart(melonDS::u32 len, void* userdata)
 {
     ZoneScopedN(TracyFunction);
     MelonDsDs::CoreState& core = *reinterpret_cast<MelonDsDs::CoreState*>(userdata);
-    core.GetInputState().RumbleStart(std::chrono::milliseconds(len));
+    core.RumbleStart(std::chrono::milliseconds(len));
 }
 
 void melonDS::Platform::Addon_RumbleStop(void* userdata)
 {
     ZoneScopedN(TracyFunction);
     MelonDsDs::CoreState& core = *reinterpret_cast<MelonDsDs::CoreState*>(userdata);
-    core.GetInputState().RumbleStop();
+    core.RumbleStop();
 }
@@ -26,7 +26,6 @@
 #include "cursor.hpp"
 #include "joypad.hpp"
 #include "pointer.hpp"
-#include "retro/task_queue.hpp"
 #include "rumble.hpp"
 #include "solar.hpp"
 #include "std/chrono.hpp"
@@ -40,18 +39,25 @@ namespace melonDS {
 }
 
 namespace MelonDsDs {
-    constexpr const char* const RUMBLE_TASK = "RumbleTask";
     class CoreConfig;
     class ScreenLayoutData;
     class MicrophoneState;
     extern const struct retro_input_descriptor input_descriptors[];
 
+    /// Everything read from the frontend in one frame, fetched all at once by \c InputState::Update
+    /// so that the individual devices never have to call into the frontend themselves.
+    /// Fields for devices that the current configuration doesn't use are left at their defaults.
     struct InputPollResult {
-        uint32_t JoypadButtons;
-        i16vec2 AnalogCursorDirection;
-        i16vec2 PointerPosition;
-        bool PointerPressed;
-        retro_perf_tick_t Timestamp;
+        uint32_t JoypadButtons = 0;
+        i16vec2 AnalogCursorDirection {};
+        i16vec2 PointerPosition {};
+        bool PointerPressed = false;
+        bool MouseWheelUp = false;
+        bool MouseWheelDown = false;
+        retro_perf_tick_t Timestamp = 0;
+
+        /// How many times the frontend's input callbacks were called to fill this in.
+        uint32_t FrontendCalls = 0;
     };
 
     using Slot2State = std::variant<std::monostate, SolarSensorState, RumbleState>;
@@ -62,7 +68,7 @@ namespace MelonDsDs {
         void SetConfig(const CoreConfig& config) noexcept;
         void Update(const CoreConfig& config, const ScreenLayoutData& layout) noexcept;
         void SetSlot2Input(const melonDS::GBACart::CartCommon& gbacart) noexcept;
-        void Apply(melonDS::NDS& nds, ScreenLayoutData& layout, MicrophoneState& mic, CoreConfig& config) const noexcept;
+        void Apply(melonDS::NDS& nds, ScreenLayoutData& layout, MicrophoneState& mic, CoreConfig& config) noexcept;
         [[nodiscard]] bool CursorVisible() const noexcept { return _cursor.CursorVisible(); }
         [[nodiscard]] bool IsTouching() const noexcept { return _cursor.IsTouching(); }
         [[nodiscard]] bool TouchReleased() const noexcept {
@@ -72,6 +78,10 @@ namespace MelonDsDs {
         [[nodiscard]] ivec2 PointerTouchPosition() const noexcept { return _cursor.PointerTouchPosition(); }
         [[nodiscard]] ivec2 JoystickTouchPosition() const noexcept { return _cursor.JoypadTouchPosition(); }
         [[nodiscard]] i16vec2 PointerRawPosition() const noexcept { return _pointer.RawPosition(); }
+        [[nodiscard]] uint32_t ConsoleButtons() const noexcept { return _joypad.ConsoleButtons(); }
+        [[nodiscard]] glm::uvec2 ConsoleTouch() const noexcept { return _cursor.ConsoleTouch(); }
+        [[nodiscard]] bool MicButtonDown() const noexcept { return _joypad.MicButtonDown(); }
+        [[nodiscard]] bool RewindButtonDown() const noexcept { return _joypad.RewindButtonDown(); }
 
         void SetControllerPortDevice(unsigned port, unsigned device) noexcept;
         [[nodiscard]] unsigned GetControllerPortDevice(unsigned port) const noexcept {
@@ -87,15 +97,23 @@ namespace MelonDsDs {
             return std::nullopt;
         }
 
-        void RumbleStart(std::chrono::milliseconds len) noexcept;
-        void RumbleStop() noexcept;
-        [[nodiscard]] retro::task::TaskSpec RumbleTask() noexcept {
-            if (auto* rumble = std::get_if<RumbleState>(&_slot2)) {
-                return rumble->RumbleTask();
+        /// @returns How many frames until the host's light sensor should be read again,
+        /// or 0 if there's no solar sensor or it isn't using the host's.
+        [[nodiscard]] unsigned PollSolarSensor() noexcept;
+        [[nodiscard]] bool UsesHostLightSensor() const noexcept {
+            if (const auto* solar = std::get_if<SolarSensorState>(&_slot2)) {
+                return solar->UsesHostSensor();
             }
 
-            return retro::task::TaskSpec();
+            return false;
         }
+
+        /// How many times the frontend's input callbacks were called during the last \c Update.
+        [[nodiscard]] uint32_t FrontendCallsPerFrame() const noexcept { return _frontendCalls; }
+
+        /// @returns How many frames the rumble should last for, or 0 if there's no Rumble Pak.
+        [[nodiscard]] unsigned RumbleStart(std::chrono::milliseconds len) noexcept;
+        void RumbleStop() noexcept;
     private:
         JoypadState _joypad;
         PointerState _pointer;
@@ -105,5 +123,6 @@ namespace MelonDsDs {
         enum TouchMode _touchMode;
 
         Slot2State _slot2;
+        uint32_t _frontendCalls = 0;
     };
 }
@@ -90,8 +90,10 @@ void JoypadState::Update(const InputPollResult& poll) noexcept {
     _previousToggleLidButton = _toggleLidButton;
     if (_joystickSpeedupCursorButton){
         _toggleLidButton = poll.JoypadButtons & (1 << RETRO_DEVICE_ID_JOYPAD_Y);
+        _rewindButton = poll.JoypadButtons & (1 << RETRO_DEVICE_ID_JOYPAD_X);
     } else {
         _toggleLidButton = false;
+        _rewindButton = false;
     }
 
     _previousCycleLayoutButton = _cycleLayoutButton;
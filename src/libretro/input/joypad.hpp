@@ -57,6 +57,10 @@ namespace MelonDsDs {
         [[nodiscard]] retro_perf_tick_t LastPointerUpdate() const noexcept { return _lastPointerUpdate; }
         [[nodiscard]] bool CycleLayoutPressed() const noexcept { return _cycleLayoutButton && !_previousCycleLayoutButton; }
         [[nodiscard]] bool MicButtonDown() const noexcept { return _micButton; }
+        /// Held for as long as the player wants to keep stepping back through the rewind history.
+        [[nodiscard]] bool RewindButtonDown() const noexcept { return _rewindButton; }
+        /// The key mask given to the console on the last \c Apply
+        [[nodiscard]] uint32_t ConsoleButtons() const noexcept { return _consoleButtons; }
         [[nodiscard]] bool MicButtonPressed() const noexcept { return _micButton && !_previousMicButton; }
         [[nodiscard]] bool MicButtonReleased() const noexcept { return !_micButton && _previousMicButton; }
 
@@ -80,6 +84,7 @@ namespace MelonDsDs {
     private:
         bool _toggleLidButton;
         bool _previousToggleLidButton;
+        bool _rewindButton;
         bool _micButton;
         bool _previousMicButton;
         bool _cycleLayoutButton;
@@ -16,54 +16,34 @@
 
 #include "rumble.hpp"
 
-#include <optional>
+#include <cmath>
 
 #include "constants.hpp"
 #include "environment.hpp"
-#include "retro/task_queue.hpp"
 #include "tracy/client.hpp"
 
 using MelonDsDs::RumbleState;
-using namespace std::chrono_literals;
 
 // We add a bit of decay so the rumble doesn't feel too instant.
 // TODO: Make customizable?
 constexpr double RUMBLE_DECAY = 0.5;
 
-void RumbleState::RumbleStart(std::chrono::milliseconds len) noexcept {
-    _rumbleTimeout += len;
-    retro::set_rumble_state(0, 0xFFFF);
+// The emulated Rumble Pak is edge-triggered (i.e. turned on and off rapidly),
+// and the frontend's rumble API is level-based,
+// so the core keeps the motor running until a timer covering each pulse runs out.
+unsigned RumbleState::RumbleStart(std::chrono::milliseconds len) noexcept {
+    if (!_motorOn) {
+        retro::set_rumble_state(0, 0xFFFF);
+        _motorOn = true;
+    }
+
+    auto frameLength = std::chrono::duration<double, std::micro>(US_PER_FRAME) * RUMBLE_DECAY;
+    return static_cast<unsigned>(std::ceil(std::chrono::duration<double, std::micro>(len) / frameLength));
 }
 
 void RumbleState::RumbleStop() noexcept {
-    _rumbleTimeout = 0us;
-    retro::set_rumble_state(0, 0);
-}
-
-// We need a rumble task because the emulated Rumble Pak is edge-triggered
-// (i.e. turned on and off rapidly), and the frontend's rumble API is level-based.
-retro::task::TaskSpec RumbleState::RumbleTask() noexcept {
-    ZoneScopedN(TracyFunction);
-
-    return retro::task::TaskSpec(
-        [this](retro::task::TaskHandle&) noexcept {
-            ZoneScopedN(TracyFunction);
-            std::optional<std::chrono::microseconds> last_frame_time = retro::last_frame_time();
-            if (!last_frame_time) {
-                last_frame_time = US_PER_FRAME;
-            }
-
-            _rumbleTimeout -= std::chrono::microseconds(static_cast<int>(last_frame_time->count() * RUMBLE_DECAY));
-            if (_rumbleTimeout <= 0us) {
-                _rumbleTimeout = 0us;
-                retro::set_rumble_state(0, 0);
-            }
-        },
-        nullptr,
-        [](retro::task::TaskHandle&) noexcept {
-            retro::set_rumble_state(0, 0);
-        },
-        retro::task::ASAP,
-        "RumbleTask"
-    );
+    if (_motorOn) {
+        retro::set_rumble_state(0, 0);
+        _motorOn = false;
+    }
 }
@@ -18,19 +18,18 @@
 
 #include "std/chrono.hpp"
 
-namespace retro::task {
-    class TaskSpec;
-}
-
 namespace MelonDsDs {
     class CoreConfig;
 
     class RumbleState {
     public:
-        [[nodiscard]] retro::task::TaskSpec RumbleTask() noexcept;
-        void RumbleStart(std::chrono::milliseconds len) noexcept;
+        /// Turns on the frontend's rumble.
+        /// @returns How many frames \c len lasts for, including decay.
+        [[nodiscard]] unsigned RumbleStart(std::chrono::milliseconds len) noexcept;
         void RumbleStop() noexcept;
     private:
-        std::chrono::microseconds _rumbleTimeout;
+        // The Rumble Pak pulses its motor many times a second,
+        // so the frontend is only told when the motor actually turns on or off
+        bool _motorOn = false;
     };
 }
\ No newline at end of file
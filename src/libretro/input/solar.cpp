@@ -21,6 +21,7 @@
 
 #include "config/config.hpp"
 #include "environment.hpp"
+#include "input.hpp"
 #include "joypad.hpp"
 #include "tracy/client.hpp"
 
@@ -45,6 +46,8 @@ SolarSensorState& SolarSensorState::operator=(SolarSensorState&& other) noexcept
         }
         _port = other._port;
         _lux = other._lux;
+        _pendingLightLevel = other._pendingLightLevel;
+        _lightLevel = other._lightLevel;
         _buttonUp = other._buttonUp;
         _buttonDown = other._buttonDown;
         _state = other._state;
@@ -58,6 +61,8 @@ SolarSensorState& SolarSensorState::operator=(SolarSensorState&& other) noexcept
 SolarSensorState::SolarSensorState(SolarSensorState&& other) noexcept :
     _port(other._port),
     _lux(other._lux),
+    _pendingLightLevel(other._pendingLightLevel),
+    _lightLevel(other._lightLevel),
     _buttonUp(other._buttonUp),
     _buttonDown(other._buttonDown),
     _state(other._state) {
@@ -67,49 +72,67 @@ SolarSensorState::SolarSensorState(SolarSensorState&& other) noexcept :
     other._lux = std::nullopt;
 }
 
-void SolarSensorState::Update(const JoypadState& joypad) noexcept {
+void SolarSensorState::Update(const JoypadState& joypad, const InputPollResult& poll) noexcept {
     ZoneScopedN(TracyFunction);
     if (_state != InterfaceState::On) {
         // If we're not using the real light sensor...
-        _buttonUp = joypad.LightLevelUpPressed() || (retro::input_state(0, RETRO_DEVICE_MOUSE, 0, RETRO_DEVICE_ID_MOUSE_WHEELUP) != 0);
-        _buttonDown = joypad.LightLevelDownPressed() || (retro::input_state(0, RETRO_DEVICE_MOUSE, 0, RETRO_DEVICE_ID_MOUSE_WHEELDOWN) != 0);
+        _buttonUp = joypad.LightLevelUpPressed() || poll.MouseWheelUp;
+        _buttonDown = joypad.LightLevelDownPressed() || poll.MouseWheelDown;
     }
     else {
         _buttonUp = false;
         _buttonDown = false;
     }
+}
 
+unsigned SolarSensorState::Poll() noexcept {
+    ZoneScopedN(TracyFunction);
     if (_state == InterfaceState::Deferred) [[unlikely]] {
         // If the sensor interface wasn't ready in retro_load_game...
-      if (retro::set_sensor_state(_port, RETRO_SENSOR_ILLUMINANCE_ENABLE, 0)) {
-          retro::debug("Initialized sensor interface in port {} after deferral", _port);
-          _state = InterfaceState::On;
-      }
-      else {
-          retro::warn("Failed to enable host illuminance sensor at port {}", _port);
-          retro::set_warn_message("Can't find this device's luminance sensor. See the core options for more info.");
-          _state = InterfaceState::Unavailable;
-      }
-    }
-
-    if (_state == InterfaceState::On) {
-        // If we're using the illuminance sensor...
-        _lux = retro::sensor_get_input(0, RETRO_SENSOR_ILLUMINANCE);
-#ifdef HAVE_TRACY
-        if (_lux) {
-            TracyPlot("Illuminance Reading", *_lux);
+        if (retro::set_sensor_state(_port, RETRO_SENSOR_ILLUMINANCE_ENABLE, 0)) {
+            retro::debug("Initialized sensor interface in port {} after deferral", _port);
+            _state = InterfaceState::On;
+        }
+        else {
+            retro::warn("Failed to enable host illuminance sensor at port {}", _port);
+            retro::set_warn_message("Can't find this device's luminance sensor. See the core options for more info.");
+            _state = InterfaceState::Unavailable;
         }
-#endif
     }
-    else {
+
+    if (_state != InterfaceState::On) {
         _lux = std::nullopt;
+        _pendingLightLevel = std::nullopt;
+        _lightLevel = std::nullopt;
+        return 0;
     }
-}
 
+    // If we're using the illuminance sensor...
+    _lux = retro::sensor_get_input(0, RETRO_SENSOR_ILLUMINANCE);
+    if (_lux) {
+        TracyPlot("Illuminance Reading", *_lux);
+
+        // Taken from the mgba core's use of the light sensor
+        // (I don't actually know how this math works)
+        uint8_t lightLevel = static_cast<uint8_t>(cbrtf(*_lux) * 8);
+        if (lightLevel != _lightLevel) {
+            // Most readings land on the same level as the last one, and those don't need to reach the cart
+            _lightLevel = lightLevel;
+            _pendingLightLevel = lightLevel;
+        }
+    }
+
+    return POLL_INTERVAL;
+}
 
 void SolarSensorState::SetConfig(const CoreConfig& config) noexcept {
     ZoneScopedN(TracyFunction);
     bool useRealSensor = config.UseRealLightSensor();
+
+    // Forget the last reading so that the next one reaches the cart even if it didn't change
+    _lux = std::nullopt;
+    _pendingLightLevel = std::nullopt;
+    _lightLevel = std::nullopt;
     if (useRealSensor) {
         // If we're using the host's luminance sensor...
         if (retro::set_sensor_state(_port, RETRO_SENSOR_ILLUMINANCE_ENABLE, 0)) {
@@ -133,7 +156,11 @@ void SolarSensorState::SetConfig(const CoreConfig& config) noexcept {
     }
 }
 
-void SolarSensorState::Apply(melonDS::NDS& nds) const noexcept {
+void SolarSensorState::Apply(melonDS::NDS& nds) noexcept {
+    if (!_pendingLightLevel && !_buttonUp && !_buttonDown) [[likely]]
+        // If nothing changed since the last frame...
+        return;
+
     auto* gbacart = nds.GetGBACart();
     if (!gbacart || gbacart->Type() != melonDS::GBACart::CartType::GameSolarSensor)
         // If a photosensor-enabled GBA game isn't inserted...
@@ -141,15 +168,14 @@ void SolarSensorState::Apply(melonDS::NDS& nds) const noexcept {
 
     auto* solarcart = static_cast<melonDS::GBACart::CartGameSolarSensor*>(gbacart);
 
-    if (_lux) {
-        // If we could read the illuminance sensor...
-        // Taken from the mgba core's use of the light sensor
-        // (I don't actually know how this math works)
-        uint8_t lightLevel = static_cast<uint8_t>(cbrtf(*_lux) * 8);
-        TracyPlot("Solar Sensor Light Level", static_cast<int64_t>(lightLevel));
-        solarcart->SetLightLevel(lightLevel);
+    if (_pendingLightLevel) {
+        // If the illuminance sensor reported a new light level...
+        TracyPlot("Solar Sensor Light Level", static_cast<int64_t>(*_pendingLightLevel));
+        solarcart->SetLightLevel(*_pendingLightLevel);
+        _pendingLightLevel = std::nullopt;
     }
-    else {
+    else if (!_lux) {
+        // Each frame a button is held moves the light level by one step, as with melonDS's own frontend
         if (_buttonUp) {
             solarcart->SetInput(melonDS::GBACart::Input_SolarSensorUp, true);
         }
@@ -157,4 +183,4 @@ void SolarSensorState::Apply(melonDS::NDS& nds) const noexcept {
             solarcart->SetInput(melonDS::GBACart::Input_SolarSensorDown, true);
         }
     }
-}
\ No newline at end of file
+}
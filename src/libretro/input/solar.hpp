@@ -28,6 +28,7 @@ namespace melonDS {
 namespace MelonDsDs {
     class CoreConfig;
     class JoypadState;
+    struct InputPollResult;
 
     class SolarSensorState {
     public:
@@ -38,9 +39,25 @@ namespace MelonDsDs {
         SolarSensorState(SolarSensorState&&) noexcept;
         SolarSensorState& operator=(SolarSensorState&&) noexcept;
 
-        void Update(const JoypadState& joypad) noexcept;
+        /// How often the host's illuminance sensor is read, in frames.
+        /// Real light levels change far more slowly than that (and most sensors don't report any faster).
+        static constexpr unsigned POLL_INTERVAL = 6;
+
+        void Update(const JoypadState& joypad, const InputPollResult& poll) noexcept;
         void SetConfig(const CoreConfig& config) noexcept;
-        void Apply(melonDS::NDS& nds) const noexcept;
+        /// Only touches the emulated cart if the light level changed or a light level button is held.
+        void Apply(melonDS::NDS& nds) noexcept;
+
+        /// Reads the host's illuminance sensor (enabling it first if that had to be deferred).
+        /// Driven by the core's scheduler instead of being called every frame.
+        /// @returns How many frames until the sensor should be read again, or 0 if it's not in use.
+        [[nodiscard]] unsigned Poll() noexcept;
+        [[nodiscard]] bool UsesHostSensor() const noexcept {
+            return _state == InterfaceState::On || _state == InterfaceState::Deferred;
+        }
+
+        /// \c true if \c Update needs the mouse wheel, i.e. the light level isn't coming from a real sensor (yet).
+        [[nodiscard]] bool UsesLightLevelButtons() const noexcept { return _state != InterfaceState::On; }
 
         [[nodiscard]] std::optional<float> LuxReading() const noexcept { return _lux; }
     private:
@@ -52,6 +69,9 @@ namespace MelonDsDs {
         };
         unsigned int _port;
         std::optional<float> _lux;
+        // The light level from the most recent reading, if it hasn't been given to the cart yet
+        std::optional<uint8_t> _pendingLightLevel;
+        std::optional<uint8_t> _lightLevel;
         bool _buttonUp = false;
         bool _buttonDown = false;
         InterfaceState _state = InterfaceState::Off;
@@ -38,6 +38,8 @@
 
 #include "config/config.hpp"
 #include "core/core.hpp"
+#include "core/startup.hpp"
+#include "cpu.hpp"
 #include "environment.hpp"
 #include "exceptions.hpp"
 #include "info.hpp"
@@ -64,6 +66,8 @@ namespace MelonDsDs {
 }
 
 PUBLIC_SYMBOL void retro_init(void) {
+    MelonDsDs::startup::Begin();
+    MelonDsDs::startup::Stage stage("retro_init");
 #ifdef HAVE_TRACY
     tracy::StartupProfiler();
 #endif
@@ -74,6 +78,8 @@ PUBLIC_SYMBOL void retro_init(void) {
     retro::info("{} {}", MELONDSDS_NAME, MELONDSDS_VERSION);
     retro_assert(!MelonDsDs::Core.IsInitialized());
 
+    MelonDsDs::cpu::Init();
+
     retro::task::init(false, nullptr);
 
     memset(MelonDsDs::CoreStateBuffer.data(), 0, MelonDsDs::CoreStateBuffer.size());
@@ -92,6 +98,7 @@ PUBLIC_SYMBOL bool retro_load_game(const struct retro_game_info *info) {
     }
 
     std::span<const retro_game_info> content = info ? std::span(info, 1) : std::span<const retro_game_info>();
+    MelonDsDs::startup::Stage stage("retro_load_game");
 
     return MelonDsDs::Core.LoadGame(MelonDsDs::MELONDSDS_GAME_TYPE_NDS, content);
 }
@@ -141,6 +148,7 @@ PUBLIC_SYMBOL unsigned retro_get_region(void) {
 PUBLIC_SYMBOL bool retro_load_game_special(unsigned type, const struct retro_game_info *info, size_t num) {
     ZoneScopedN(TracyFunction);
     retro::debug("retro_load_game_special({}, {}, {})", MelonDsDs::get_game_type_name(type), fmt::ptr(info), num);
+    MelonDsDs::startup::Stage stage("retro_load_game_special");
 
     return MelonDsDs::Core.LoadGame(type, std::span(info, num));
 }
@@ -300,34 +308,41 @@ extern "C" bool MelonDsDs::UpdateOptionVisibility() noexcept {
     return Core.UpdateOptionVisibility();
 }
 
-int Platform::Net_SendPacket(u8* data, int len, void*) {
+// melonDS hands every Platform callback the userdata that the console was created with (see CreateConsole),
+// which is the CoreState that owns it; using it instead of the global keeps these callbacks per-instance
+static MelonDsDs::CoreState& GetCore(void* userdata) noexcept {
+    // (Components that were created before being plugged into a console may not have it yet)
+    return userdata ? *static_cast<MelonDsDs::CoreState*>(userdata) : MelonDsDs::Core;
+}
+
+int Platform::Net_SendPacket(u8* data, int len, void* userdata) {
     ZoneScopedN(TracyFunction);
 
-    return MelonDsDs::Core.LanSendPacket(std::span((std::byte*)data, len));
+    return GetCore(userdata).LanSendPacket(std::span((std::byte*)data, len));
 }
 
-int Platform::Net_RecvPacket(u8* data, void*) {
+int Platform::Net_RecvPacket(u8* data, void* userdata) {
     ZoneScopedN(TracyFunction);
 
-    return MelonDsDs::Core.LanRecvPacket(data);
+    return GetCore(userdata).LanRecvPacket(data);
 }
 
-void Platform::WriteNDSSave(const u8 *savedata, u32 savelen, u32 writeoffset, u32 writelen, void*) {
+void Platform::WriteNDSSave(const u8 *savedata, u32 savelen, u32 writeoffset, u32 writelen, void* userdata) {
     ZoneScopedN(TracyFunction);
 
-    MelonDsDs::Core.WriteNdsSave(span((const std::byte*)savedata, savelen), writeoffset, writelen);
+    GetCore(userdata).WriteNdsSave(span((const std::byte*)savedata, savelen), writeoffset, writelen);
 }
 
-void Platform::WriteGBASave(const u8 *savedata, u32 savelen, u32 writeoffset, u32 writelen, void*) {
+void Platform::WriteGBASave(const u8 *savedata, u32 savelen, u32 writeoffset, u32 writelen, void* userdata) {
     ZoneScopedN(TracyFunction);
 
-    MelonDsDs::Core.WriteGbaSave(span((const std::byte*)savedata, savelen), writeoffset, writelen);
+    GetCore(userdata).WriteGbaSave(span((const std::byte*)savedata, savelen), writeoffset, writelen);
 }
 
-void Platform::WriteFirmware(const Firmware& firmware, u32 writeoffset, u32 writelen, void*) {
+void Platform::WriteFirmware(const Firmware& firmware, u32 writeoffset, u32 writelen, void* userdata) {
     ZoneScopedN(TracyFunction);
 
-    MelonDsDs::Core.WriteFirmware(firmware, writeoffset, writelen);
+    GetCore(userdata).WriteFirmware(firmware, writeoffset, writelen);
 }
 
 extern "C" void MelonDsDs::MpStarted(uint16_t client_id, retro_netpacket_send_t send_fn, retro_netpacket_poll_receive_t poll_receive_fn) noexcept {
@@ -342,29 +357,40 @@ extern "C" void MelonDsDs::MpStopped() noexcept {
     MelonDsDs::Core.MpStopped();
 }
 
-int DeconstructPacket(u8 *data, u64 *timestamp, const std::optional<MelonDsDs::Packet> &o_p) {
-    if (!o_p.has_value()) {
+extern "C" void MelonDsDs::AudioCallback() noexcept {
+    MelonDsDs::Core.PullAudio();
+}
+
+extern "C" void MelonDsDs::AudioSetState(bool enabled) noexcept {
+    MelonDsDs::Core.SetAudioCallbackState(enabled);
+}
+
+// Copies the packet out of the receive queue and frees its slot
+static int DeconstructPacket(MelonDsDs::CoreState& core, u8 *data, u64 *timestamp, const MelonDsDs::Packet* p) {
+    if (!p) {
         return 0;
     }
-    memcpy(data, o_p->Data(), o_p->Length());
-    *timestamp = o_p->Timestamp();
-    return o_p->Length();
+    int length = p->Length();
+    memcpy(data, p->Data(), length);
+    *timestamp = p->Timestamp();
+    core.MpPopPacket();
+    return length;
 }
 
-int Platform::MP_SendPacket(u8* data, int len, u64 timestamp, void*) {
-    return MelonDsDs::Core.MpSendPacket(MelonDsDs::Packet(data, len, timestamp, 0, MelonDsDs::Packet::Type::Other)) ? len : 0;
+int Platform::MP_SendPacket(u8* data, int len, u64 timestamp, void* userdata) {
+    return GetCore(userdata).MpSendPacket(span(data, len), timestamp, 0, MelonDsDs::Packet::Type::Other) ? len : 0;
 }
 
-int Platform::MP_RecvPacket(u8* data, u64* timestamp, void*) {
-    std::optional<MelonDsDs::Packet> o_p = MelonDsDs::Core.MpNextPacket();
-    return DeconstructPacket(data, timestamp, o_p);
+int Platform::MP_RecvPacket(u8* data, u64* timestamp, void* userdata) {
+    MelonDsDs::CoreState& core = GetCore(userdata);
+    return DeconstructPacket(core, data, timestamp, core.MpNextPacket());
 }
 
-int Platform::MP_SendCmd(u8* data, int len, u64 timestamp, void*) {
-    return MelonDsDs::Core.MpSendPacket(MelonDsDs::Packet(data, len, timestamp, 0, MelonDsDs::Packet::Type::Cmd)) ? len : 0;
+int Platform::MP_SendCmd(u8* data, int len, u64 timestamp, void* userdata) {
+    return GetCore(userdata).MpSendPacket(span(data, len), timestamp, 0, MelonDsDs::Packet::Type::Cmd) ? len : 0;
 }
 
-int Platform::MP_SendReply(u8 *data, int len, u64 timestamp, u16 aid, void*) {
+int Platform::MP_SendReply(u8 *data, int len, u64 timestamp, u16 aid, void* userdata) {
     // aid is always less than 16,
     // otherwise sending a 16-bit wide aidmask in RecvReplies wouldn't make sense,
     // and neither would this line[1] from melonDS itself.
@@ -373,39 +399,21 @@ int Platform::MP_SendReply(u8 *data, int len, u64 timestamp, u16 aid, void*) {
     // [1] https://github.com/melonDS-emu/melonDS/blob/817b409ec893fb0b2b745ee18feced08706419de/src/net/LAN.cpp#L1074
     // [2] https://melonds.kuribo64.net/comments.php?id=25
     retro_assert(aid < 16);
-    return MelonDsDs::Core.MpSendPacket(MelonDsDs::Packet(data, len, timestamp, aid, MelonDsDs::Packet::Type::Reply)) ? len : 0;
+    return GetCore(userdata).MpSendPacket(span(data, len), timestamp, aid, MelonDsDs::Packet::Type::Reply) ? len : 0;
 }
 
-int Platform::MP_SendAck(u8* data, int len, u64 timestamp, void*) {
-    return MelonDsDs::Core.MpSendPacket(MelonDsDs::Packet(data, len, timestamp, 0, MelonDsDs::Packet::Type::Cmd)) ? len : 0;
+int Platform::MP_SendAck(u8* data, int len, u64 timestamp, void* userdata) {
+    return GetCore(userdata).MpSendPacket(span(data, len), timestamp, 0, MelonDsDs::Packet::Type::Cmd) ? len : 0;
 }
 
-int Platform::MP_RecvHostPacket(u8* data, u64 * timestamp, void*) {
-    std::optional<MelonDsDs::Packet> o_p = MelonDsDs::Core.MpNextPacketBlock();
-    return DeconstructPacket(data, timestamp, o_p);
+int Platform::MP_RecvHostPacket(u8* data, u64 * timestamp, void* userdata) {
+    MelonDsDs::CoreState& core = GetCore(userdata);
+    return DeconstructPacket(core, data, timestamp, core.MpNextPacketBlock());
 }
 
-u16 Platform::MP_RecvReplies(u8* packets, u64 timestamp, u16 aidmask, void*) {
-    if(!MelonDsDs::Core.MpActive()) {
+u16 Platform::MP_RecvReplies(u8* packets, u64 timestamp, u16 aidmask, void* userdata) {
+    if(!GetCore(userdata).MpActive()) {
         return 0;
     }
-    u16 ret = 0;
-    int loops = 0;
-    while((ret & aidmask) != aidmask) {
-        std::optional<MelonDsDs::Packet> o_p = MelonDsDs::Core.MpNextPacketBlock();
-        if(!o_p.has_value()) {
-            return ret;
-        }
-        MelonDsDs::Packet p = std::move(o_p).value();
-        if(p.Timestamp() < (timestamp - 32)) {
-            continue;
-        }
-        if(p.PacketType() != MelonDsDs::Packet::Type::Reply) {
-            continue;
-        }
-        ret |= 1<<p.Aid();
-        memcpy(&packets[(p.Aid()-1)*1024], p.Data(), std::min(p.Length(), (uint64_t)1024));
-        loops++;
-    }
-    return ret;
+    return GetCore(userdata).MpRecvReplies(packets, timestamp, aidmask);
 }
@@ -0,0 +1,75 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+/// An extension interface for frontends that know which game will be loaded next (e.g. a fixed playlist),
+/// so the core can read and validate it ahead of time while the current game runs.
+/// The core maps the next ROM, checks its header, and loads the BIOS, firmware,
+/// and title metadata it'll need on a worker thread;
+/// if the next \c retro_load_game is for the same path, it uses what was preloaded instead of reading it all again.
+/// Get it by passing \c MELONDSDS_GET_PRELOAD_INTERFACE to the \c retro_get_proc_address_interface
+/// that the core registers with \c RETRO_ENVIRONMENT_SET_PROC_ADDRESS_CALLBACK.
+///
+/// This header is plain C so that frontends can include it directly.
+/// All functions must be called on the same thread as \c retro_run.
+
+#ifndef MELONDSDS_PRELOAD_H
+#define MELONDSDS_PRELOAD_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MELONDSDS_PRELOAD_INTERFACE_VERSION 1
+#define MELONDSDS_GET_PRELOAD_INTERFACE "melondsds_get_preload_interface"
+
+enum melondsds_preload_status {
+    /// Nothing has been preloaded (or the last preload was cancelled or used).
+    MELONDSDS_PRELOAD_NONE = 0,
+    /// The content is still being preloaded.
+    MELONDSDS_PRELOAD_PENDING = 1,
+    /// The content is ready for the next \c retro_load_game.
+    MELONDSDS_PRELOAD_READY = 2,
+    /// The content couldn't be read or isn't a valid NDS ROM;
+    /// \c retro_load_game will load it the usual way (and report the error then).
+    MELONDSDS_PRELOAD_FAILED = 3,
+};
+
+/// Starts preloading the NDS ROM at \c path (which must be a plain file, not a path inside an archive),
+/// replacing any earlier preload for a different path.
+/// Returns \c false if the core can't preload content in the background on this system.
+typedef bool (*melondsds_preload_content_t)(const char* path);
+
+/// Stops preloading and discards whatever was preloaded.
+typedef void (*melondsds_cancel_preload_t)(void);
+
+typedef enum melondsds_preload_status (*melondsds_get_preload_status_t)(void);
+
+struct melondsds_preload_interface {
+    unsigned interface_version;
+    melondsds_preload_content_t preload_content;
+    melondsds_cancel_preload_t cancel_preload;
+    melondsds_get_preload_status_t get_preload_status;
+};
+
+typedef const struct melondsds_preload_interface* (*melondsds_get_preload_interface_t)(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MELONDSDS_PRELOAD_H
@@ -0,0 +1,75 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+/// An extension interface for frontends that would rather have the core write savestate files itself,
+/// so that compressing them doesn't hold up the frame that saved them.
+/// The core snapshots the console immediately, then compresses the snapshot on its own worker threads
+/// (in independent chunks, along with a thumbnail of the screens) and writes it while emulation continues.
+/// Get it by passing \c MELONDSDS_GET_SAVESTATE_INTERFACE to the \c retro_get_proc_address_interface
+/// that the core registers with \c RETRO_ENVIRONMENT_SET_PROC_ADDRESS_CALLBACK.
+///
+/// This header is plain C so that frontends can include it directly.
+
+#ifndef MELONDSDS_SAVESTATE_H
+#define MELONDSDS_SAVESTATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MELONDSDS_SAVESTATE_INTERFACE_VERSION 1
+#define MELONDSDS_GET_SAVESTATE_INTERFACE "melondsds_get_savestate_interface"
+
+/// Snapshots the console and queues it to be compressed and written to \c path,
+/// replacing whatever's there once the new file is complete.
+/// Returns as soon as the snapshot is taken,
+/// or \c false if the console can't be saved right now (e.g. in DSi mode).
+typedef bool (*melondsds_save_state_file_t)(const char* path);
+
+/// Loads a file written by \c save_state_file (or a plain \c retro_serialize buffer),
+/// first waiting for any queued saves to finish.
+typedef bool (*melondsds_load_state_file_t)(const char* path);
+
+/// Blocks until every queued save has been written.
+/// Returns \c false if any save queued since the last call failed.
+typedef bool (*melondsds_wait_for_state_files_t)(void);
+
+/// Gets the thumbnail embedded in a file written by \c save_state_file:
+/// both screens at native resolution, stacked vertically, as tightly-packed XRGB8888.
+/// Stores the thumbnail's size in \c width and \c height, then copies it into \c pixels
+/// if that isn't \c NULL and \c capacity (in pixels) is big enough.
+/// Returns \c false if \c path isn't a savestate file or the thumbnail wasn't copied.
+typedef bool (*melondsds_get_state_file_thumbnail_t)(const char* path, uint32_t* pixels, size_t capacity, unsigned* width, unsigned* height);
+
+struct melondsds_savestate_interface {
+    unsigned interface_version;
+    melondsds_save_state_file_t save_state_file;
+    melondsds_load_state_file_t load_state_file;
+    melondsds_wait_for_state_files_t wait_for_state_files;
+    melondsds_get_state_file_thumbnail_t get_state_file_thumbnail;
+};
+
+typedef const struct melondsds_savestate_interface* (*melondsds_get_savestate_interface_t)(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MELONDSDS_SAVESTATE_H
@@ -0,0 +1,78 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+/// An extension interface for frontends that show each DS screen on its own display
+/// (e.g. dual-screen handhelds, or streaming setups that lay out the screens themselves).
+/// Get it by passing \c MELONDSDS_GET_SCREEN_INTERFACE to the \c retro_get_proc_address_interface
+/// that the core registers with \c RETRO_ENVIRONMENT_SET_PROC_ADDRESS_CALLBACK.
+///
+/// This header is plain C so that frontends can include it directly.
+
+#ifndef MELONDSDS_SCREENS_H
+#define MELONDSDS_SCREENS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MELONDSDS_SCREEN_INTERFACE_VERSION 1
+#define MELONDSDS_GET_SCREEN_INTERFACE "melondsds_get_screen_interface"
+
+enum melondsds_screen {
+    MELONDSDS_SCREEN_TOP = 0,
+    MELONDSDS_SCREEN_BOTTOM = 1,
+};
+
+/// One of the console's screens at native resolution (256x192),
+/// in the same byte order as \c RETRO_PIXEL_FORMAT_XRGB8888.
+struct melondsds_screen_image {
+    const uint32_t* data;
+    unsigned width;
+    unsigned height;
+    /// Distance between the start of each row, in bytes
+    size_t pitch;
+};
+
+/// While enabled, the core doesn't composite the screens into a frame at all;
+/// \c retro_video_refresh_t is given \c NULL (i.e. a duplicate frame) instead,
+/// and the frontend is expected to fetch each screen with \c get_screen after \c retro_run.
+/// Returns \c false (and stays disabled) if the frontend can't accept duplicate frames.
+typedef bool (*melondsds_set_separate_screens_t)(bool enabled);
+
+/// Gets the given screen's most recent frame, which stays valid until the next \c retro_run.
+/// Works whether or not separate screens are enabled.
+/// Returns \c false if no game is running or if the screens are only on the GPU
+/// (i.e. the OpenGL renderer is drawing 3D graphics).
+typedef bool (*melondsds_get_screen_t)(enum melondsds_screen screen, struct melondsds_screen_image* image);
+
+struct melondsds_screen_interface {
+    unsigned interface_version;
+    melondsds_set_separate_screens_t set_separate_screens;
+    melondsds_get_screen_t get_screen;
+};
+
+typedef const struct melondsds_screen_interface* (*melondsds_get_screen_interface_t)(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MELONDSDS_SCREENS_H
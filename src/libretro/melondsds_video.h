@@ -0,0 +1,76 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+/// An extension interface for headless frontends that encode the core's output as video
+/// (e.g. cloud streaming), so that they can skip converting each frame from XRGB8888 themselves.
+/// Get it by passing \c MELONDSDS_GET_VIDEO_INTERFACE to the \c retro_get_proc_address_interface
+/// that the core registers with \c RETRO_ENVIRONMENT_SET_PROC_ADDRESS_CALLBACK.
+///
+/// This header is plain C so that frontends can include it directly.
+
+#ifndef MELONDSDS_VIDEO_H
+#define MELONDSDS_VIDEO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MELONDSDS_VIDEO_INTERFACE_VERSION 1
+#define MELONDSDS_GET_VIDEO_INTERFACE "melondsds_get_video_interface"
+
+/// A composited frame in NV12 (BT.601, limited range), the layout most hardware video encoders take.
+struct melondsds_nv12_frame {
+    /// One byte per pixel
+    const uint8_t* luma;
+    /// Distance between the start of each luma row, in bytes
+    size_t luma_pitch;
+    /// Interleaved Cb and Cr for each 2x2 block of pixels, with (height + 1) / 2 rows
+    const uint8_t* chroma;
+    /// Distance between the start of each chroma row, in bytes
+    size_t chroma_pitch;
+    unsigned width;
+    unsigned height;
+};
+
+/// While enabled, the core converts each composited frame to NV12 as it finishes it;
+/// \c retro_video_refresh_t is given \c NULL (i.e. a duplicate frame) instead,
+/// and the frontend is expected to fetch the frame with \c get_nv12_frame after \c retro_run.
+/// Returns \c false (and stays disabled) if the frontend can't accept duplicate frames
+/// or if the current renderer can't produce NV12 (only the software renderer can, and only when it composites on the CPU).
+typedef bool (*melondsds_set_nv12_output_t)(bool enabled);
+
+/// Gets the most recent NV12 frame, which stays valid until the next \c retro_run.
+/// Returns \c false if NV12 output is disabled or no frame has been composited since it was enabled.
+typedef bool (*melondsds_get_nv12_frame_t)(struct melondsds_nv12_frame* frame);
+
+struct melondsds_video_interface {
+    unsigned interface_version;
+    melondsds_set_nv12_output_t set_nv12_output;
+    melondsds_get_nv12_frame_t get_nv12_frame;
+};
+
+typedef const struct melondsds_video_interface* (*melondsds_get_video_interface_t)(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MELONDSDS_VIDEO_H
@@ -16,12 +16,20 @@
 
 #include "microphone.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <limits>
 #include <optional>
+#include <random>
 
 #include <libretro.h>
+#include <retro_assert.h>
+#include <retro_timers.h>
 #include <frontend/mic_blow.h>
 
 #include "config/config.hpp"
+#include "constants.hpp"
 #include "environment.hpp"
 #include "input/input.hpp"
 #include "tracy.hpp"
@@ -29,6 +37,67 @@
 using std::optional;
 using std::nullopt;
 
+// The rate we ask the frontend to capture at; it may give us something else
+constexpr unsigned HOST_MIC_RATE = 44100;
+
+// The rate at which the emulated microphone consumes samples
+constexpr double DS_MIC_RATE = MelonDsDs::MicrophoneState::SAMPLES_PER_FRAME * MelonDsDs::FPS;
+
+// How many host samples the capture thread asks for at once (about 6ms at 44.1 kHz)
+constexpr size_t CAPTURE_CHUNK_SAMPLES = 256;
+
+// How long the capture thread waits when the host mic has nothing ready
+constexpr unsigned CAPTURE_INTERVAL_MS = 4;
+
+// Older samples than this are dropped, so the mic's latency stays at about a frame or two
+constexpr size_t MAX_QUEUED_SAMPLES = 2 * MelonDsDs::MicrophoneState::SAMPLES_PER_FRAME;
+
+// Long enough that the repetition isn't audible, short enough to stay in cache (8 KiB)
+constexpr size_t NOISE_WAVEFORM_LENGTH = 4096;
+
+// melonDS only reads from this, but MicInputFrame doesn't take a const pointer
+std::array<int16_t, MelonDsDs::MicrophoneState::SAMPLES_PER_FRAME> MelonDsDs::MicrophoneState::SILENCE {};
+
+// The built-in blow sample, converted once from unsigned to signed 16-bit PCM (at 44.1 kHz)
+static std::span<const int16_t> BlowWaveform() noexcept {
+    constexpr size_t MIC_BLOW_LENGTH = sizeof(mic_blow) / sizeof(mic_blow[0]);
+    static const std::array<int16_t, MIC_BLOW_LENGTH> waveform = [] {
+        std::array<int16_t, MIC_BLOW_LENGTH> samples {};
+        for (size_t i = 0; i < MIC_BLOW_LENGTH; ++i) {
+            samples[i] = static_cast<int16_t>(mic_blow[i] ^ 0x8000);
+        }
+        return samples;
+    }();
+
+    return waveform;
+}
+
+// White noise, generated once and shared by all sessions
+static std::span<const int16_t> NoiseWaveform() noexcept {
+    static const std::array<int16_t, NOISE_WAVEFORM_LENGTH> waveform = [] {
+        std::array<int16_t, NOISE_WAVEFORM_LENGTH> samples {};
+        std::default_random_engine engine;
+        std::uniform_int_distribution<int16_t> random {std::numeric_limits<int16_t>::min(), std::numeric_limits<int16_t>::max()};
+        for (int16_t& sample : samples) {
+            sample = random(engine);
+        }
+        return samples;
+    }();
+
+    return waveform;
+}
+
+// Fills output by looping over waveform from offset, then advances offset past what was copied
+static void CopyWaveform(std::span<const int16_t> waveform, size_t& offset, std::span<int16_t> output) noexcept {
+    size_t written = 0;
+    while (written < output.size()) {
+        size_t count = std::min(output.size() - written, waveform.size() - offset);
+        memcpy(output.data() + written, waveform.data() + offset, count * sizeof(int16_t));
+        written += count;
+        offset = (offset + count) % waveform.size();
+    }
+}
+
 MelonDsDs::MicrophoneState::MicrophoneState() noexcept :
     _micInterface(retro::get_microphone_interface()) {
     if (_micInterface) {
@@ -44,6 +113,10 @@ MelonDsDs::MicrophoneState::MicrophoneState() noexcept :
     }
 }
 
+MelonDsDs::MicrophoneState::~MicrophoneState() noexcept {
+    StopCapture();
+}
+
 void MelonDsDs::MicrophoneState::SetConfig(const CoreConfig& config) noexcept {
     ZoneScopedN(TracyFunction);
 
@@ -60,13 +133,107 @@ void MelonDsDs::MicrophoneState::SetMicInputMode(MicInputMode mode) noexcept {
 
     if (_microphone && _micInputMode != MicInputMode::HostMic) {
         // If we have a host microphone open and we don't want it anymore...
+        StopCapture(); // (the capture thread must not outlive the mic)
         _microphone = nullopt;
     }
 
     if (_micInterface && _micInputMode == MicInputMode::HostMic) {
         // If we can access the host microphone and we want to use it...
-        _microphone = retro::Microphone::Open(*_micInterface, { 44100 });
+        _microphone = retro::Microphone::Open(*_micInterface, { HOST_MIC_RATE });
+        if (_microphone) {
+            StartCapture();
+        }
+    }
+}
+
+void MelonDsDs::MicrophoneState::StartCapture() noexcept {
+    ZoneScopedN(TracyFunction);
+    retro_assert(_microphone);
+    retro_assert(!_captureThread);
+
+    // The frontend isn't obligated to give us the rate we asked for
+    optional<retro_microphone_params_t> params = _microphone->GetParams();
+    unsigned hostRate = params && params->rate ? params->rate : HOST_MIC_RATE;
+    _captureResampler.emplace(hostRate, DS_MIC_RATE, ResamplerQuality::Fast, 1);
+    _captureRing.Discard();
+    _captureRing.ResetStats();
+    _hostMicActive.store(_microphone->IsActive(), std::memory_order_relaxed);
+    _captureEnabled.store(_shouldCaptureAudio, std::memory_order_release);
+
+#ifdef HAVE_THREADS
+    _captureThreadRunning.store(true, std::memory_order_release);
+    _captureThread = sthread_create(CaptureThread, this);
+    if (!_captureThread) {
+        _captureThreadRunning.store(false, std::memory_order_release);
+        retro::warn("Failed to start the microphone capture thread; capturing once per frame instead");
+    }
+#endif
+
+    retro::debug("Capturing host mic audio at {} Hz, resampled to {:.1f} Hz", hostRate, DS_MIC_RATE);
+}
+
+void MelonDsDs::MicrophoneState::StopCapture() noexcept {
+    ZoneScopedN(TracyFunction);
+    if (_captureThread) {
+        _captureThreadRunning.store(false, std::memory_order_release);
+        sthread_join(_captureThread);
+        _captureThread = nullptr;
+    }
+
+    _captureResampler = nullopt;
+    _captureRing.Discard();
+}
+
+void MelonDsDs::MicrophoneState::CaptureThread(void* self) noexcept {
+    auto& mic = *static_cast<MicrophoneState*>(self);
+    while (mic._captureThreadRunning.load(std::memory_order_acquire)) {
+        bool enabled = mic._captureEnabled.load(std::memory_order_acquire);
+        if (enabled != mic._hostMicActive.load(std::memory_order_relaxed)) {
+            // If the player just turned the mic on or off...
+            mic.SetHostMicActive(enabled);
+        }
+
+        if (!enabled) {
+            // If the player isn't using the mic right now...
+            retro_sleep(CAPTURE_INTERVAL_MS);
+            continue;
+        }
+
+        if (mic.Capture()) {
+            // If we've drained the frontend's mic (i.e. it doesn't block), give it time to fill up again
+            retro_sleep(CAPTURE_INTERVAL_MS);
+        }
+    }
+}
+
+bool MelonDsDs::MicrophoneState::Capture() noexcept {
+    ZoneScopedN(TracyFunction);
+    retro_assert(_microphone);
+    retro_assert(_captureResampler);
+
+    std::array<int16_t, CAPTURE_CHUNK_SAMPLES> hostSamples {};
+    optional<unsigned> read = _microphone->Read(hostSamples);
+    if (!read || *read == 0 || *read > hostSamples.size()) {
+        // If the host mic has nothing for us right now (or it failed)...
+        return true;
+    }
+
+    std::array<int16_t, CAPTURE_CHUNK_SAMPLES * 2> dsSamples {};
+    size_t resampled = _captureResampler->Process(std::span(hostSamples.data(), *read), dsSamples);
+    _captureRing.Write(std::span(dsSamples.data(), resampled));
+
+    return *read < hostSamples.size();
+}
+
+void MelonDsDs::MicrophoneState::SetHostMicActive(bool active) noexcept {
+    ZoneScopedN(TracyFunction);
+    retro_assert(_microphone);
+    if (!_microphone->SetActive(active)) {
+        retro::warn("Failed to turn the host microphone {}", active ? "on" : "off");
     }
+
+    // Stored even if it failed, so the capture thread doesn't retry every iteration
+    _hostMicActive.store(active, std::memory_order_relaxed);
 }
 
 
@@ -76,6 +243,7 @@ void MelonDsDs::MicrophoneState::SetMicButtonMode(MicButtonMode mode) noexcept {
     _prevShouldCaptureAudio = false;
     _prevMicButtonDown = false;
     _micButtonDown = false;
+    _captureEnabled.store(false, std::memory_order_release);
 }
 
 void MelonDsDs::MicrophoneState::SetMicButtonState(bool down) noexcept {
@@ -105,50 +273,60 @@ void MelonDsDs::MicrophoneState::SetMicButtonState(bool down) noexcept {
 
     if (_shouldCaptureAudio != _prevShouldCaptureAudio) {
         // If we should either start or stop the audio feed...
-        if (_microphone) {
-            _microphone->SetActive(_shouldCaptureAudio);
+        if (_microphone && !_captureThread) {
+            // If there's no capture thread to do it for us...
+            SetHostMicActive(_shouldCaptureAudio);
         }
+
+        // Don't play back anything left over from the last time the mic was on,
+        // and start the synthetic sounds from the top so they only depend on when the mic was turned on
+        _captureRing.Discard();
+        _blowSampleOffset = 0;
+        _noiseSampleOffset = 0;
+        _captureEnabled.store(_shouldCaptureAudio, std::memory_order_release);
     }
 }
 
 
-void MelonDsDs::MicrophoneState::Read(std::span<int16_t> buffer) noexcept {
+std::span<int16_t> MelonDsDs::MicrophoneState::Read() noexcept {
     ZoneScopedN(TracyFunction);
 
     if (!_shouldCaptureAudio) {
-        memset(buffer.data(), 0, buffer.size_bytes());
-        return;
+        // If the mic button isn't held, there's nothing to fill
+        return SILENCE;
     }
 
+    std::span<int16_t> buffer = _buffer;
     switch (_micInputMode) {
-        case MicInputMode::WhiteNoise: {
-            for (short& i : buffer)
-                i = _random(_randomEngine);
+        case MicInputMode::WhiteNoise:
+            CopyWaveform(NoiseWaveform(), _noiseSampleOffset, buffer);
+            return buffer;
+        case MicInputMode::Blow:
+            CopyWaveform(BlowWaveform(), _blowSampleOffset, buffer);
+            return buffer;
+        case MicInputMode::HostMic: {
+            if (_microphone && _captureResampler) {
+                // If the microphone is open...
+                if (!_captureThread) {
+                    // If there's no capture thread, then capture on this one
+                    while (_captureRing.Size() < buffer.size() && !Capture());
+                }
 
-            break;
-        }
-        case MicInputMode::Blow: {
-            constexpr size_t MIC_BLOW_LENGTH = sizeof(mic_blow) / sizeof(mic_blow[0]);
-
-            // builtin sample is 16-bit signed PCM
-            // sample rate is 44.1KHz
-            for (int i = 0; i < buffer.size(); ++i) {
-                buffer[i] = static_cast<int16_t>(mic_blow[_blowSampleOffset] ^ 0x8000);
-                _blowSampleOffset = (_blowSampleOffset + 1) % MIC_BLOW_LENGTH;
-            }
+                if (size_t queued = _captureRing.Size(); queued > MAX_QUEUED_SAMPLES) {
+                    // If the capture thread has gotten ahead of us, keep only the most recent audio
+                    _captureRing.Skip(queued - buffer.size());
+                }
 
-            break;
-        }
-        case MicInputMode::HostMic: {
-            if (_microphone && _microphone->IsActive() && _microphone->Read(buffer)) {
-                // If the microphone is open and turned on, and we read from it successfully...
-                break;
+                // If we couldn't get enough audio in time, pad the rest with silence
+                size_t read = _captureRing.Read(buffer);
+                TracyPlot("Mic Samples Read", static_cast<int64_t>(read));
+                memset(buffer.data() + read, 0, (buffer.size() - read) * sizeof(int16_t));
+                return buffer;
             }
             // If the mic isn't available, feed silence instead
             [[fallthrough]];
         }
         default:
-            memset(buffer.data(), 0, buffer.size_bytes());
-            break;
+            return SILENCE;
     }
 }
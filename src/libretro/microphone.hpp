@@ -17,12 +17,16 @@
 #ifndef MELONDS_DS_MICROPHONE_HPP
 #define MELONDS_DS_MICROPHONE_HPP
 
+#include <array>
+#include <atomic>
 #include <cstdint>
-#include <limits>
 #include <optional>
-#include <random>
+#include <span>
+#include <rthreads/rthreads.h>
 
 #include "config/types.hpp"
+#include "core/audio.hpp"
+#include "core/resampler.hpp"
 #include "retro/microphone.hpp"
 
 namespace MelonDsDs {
@@ -31,14 +35,25 @@ namespace MelonDsDs {
 
     class MicrophoneState {
     public:
+        /// The number of samples that the emulated microphone takes each frame.
+        static constexpr size_t SAMPLES_PER_FRAME = 735;
+
         MicrophoneState() noexcept;
+        ~MicrophoneState() noexcept;
+        MicrophoneState(const MicrophoneState&) = delete;
+        MicrophoneState& operator=(const MicrophoneState&) = delete;
+        MicrophoneState(MicrophoneState&&) = delete;
+        MicrophoneState& operator=(MicrophoneState&&) = delete;
 
         void SetConfig(const CoreConfig& config) noexcept;
         bool IsMicInterfaceAvailable() const noexcept { return _micInterface.has_value(); }
         bool IsHostMicOpen() const noexcept { return _microphone.has_value(); }
-        bool IsHostMicActive() const noexcept { return _microphone && _microphone->IsActive(); }
+        bool IsHostMicActive() const noexcept { return _microphone && _hostMicActive.load(std::memory_order_relaxed); }
 
-        void Read(std::span<int16_t> buffer) noexcept;
+        /// Returns this frame's worth of mic input.
+        /// The result is only valid until the next call,
+        /// and may point to a shared silent buffer if the mic isn't in use.
+        [[nodiscard]] std::span<int16_t> Read() noexcept;
 
         MicInputMode GetMicInputMode() const noexcept { return _micInputMode; }
         void SetMicInputMode(MicInputMode mode) noexcept;
@@ -48,18 +63,47 @@ namespace MelonDsDs {
 
         void SetMicButtonState(bool down) noexcept;
 
+        [[nodiscard]] AudioRingStats GetCaptureStats() const noexcept { return _captureRing.Stats(); }
     private:
+        void StartCapture() noexcept;
+        void StopCapture() noexcept;
+
+        /// Reads whatever the host mic has ready, resamples it to the DS's rate, and queues it for \c Read.
+        /// Runs on the capture thread if there is one, or on the emulator thread otherwise.
+        /// \returns \c true if the host mic had less audio ready than we asked for.
+        bool Capture() noexcept;
+        static void CaptureThread(void* self) noexcept;
+
+        /// Turns the host mic on or off. Like \c Capture, this runs on the capture thread if there is one,
+        /// since the frontend's mic handle isn't safe to use from two threads at once.
+        void SetHostMicActive(bool active) noexcept;
+
         std::optional<retro_microphone_interface> _micInterface {};
         std::optional<retro::Microphone> _microphone {};
         MicInputMode _micInputMode = MicInputMode::None;
         MicButtonMode _micButtonMode = MicButtonMode::Hold;
+        // Shared by every instance, since it never changes
+        static std::array<int16_t, SAMPLES_PER_FRAME> SILENCE;
+        std::array<int16_t, SAMPLES_PER_FRAME> _buffer {};
+
+        // Read cursors into the precomputed Blow and Noise waveforms
         size_t _blowSampleOffset = 0;
-        std::default_random_engine _randomEngine;
-        std::uniform_int_distribution<int16_t> _random {std::numeric_limits<int16_t>::min(), std::numeric_limits<int16_t>::max()};
+        size_t _noiseSampleOffset = 0;
         bool _micButtonDown = false;
         bool _prevMicButtonDown = false;
         bool _shouldCaptureAudio = false;
         bool _prevShouldCaptureAudio = false;
+
+        // Host mic audio, already resampled, waiting for the emulator to take it
+        MicAudioRing _captureRing {};
+        // Only touched by whichever thread runs Capture
+        std::optional<AudioResampler> _captureResampler {};
+        sthread_t* _captureThread = nullptr;
+        std::atomic_bool _captureThreadRunning = false;
+        // Mirrors _shouldCaptureAudio for the capture thread, which turns the host mic on or off to match
+        std::atomic_bool _captureEnabled = false;
+        // What SetHostMicActive last asked the host mic to do
+        std::atomic_bool _hostMicActive = false;
     };
 }
 
@@ -0,0 +1,400 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#ifdef HAVE_NETWORKING
+#include "download.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cinttypes>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <mutex>
+#include <unordered_set>
+
+#include <file/file_path.h>
+#include <lrc_hash.h>
+#include <retro_timers.h>
+#include <streams/file_stream.h>
+#include <string/stdstring.h>
+
+#include "core/savewriter.hpp"
+#include "environment.hpp"
+#include "format.hpp"
+#include "retro/dirent.hpp"
+#include "retro/http.hpp"
+#include "tracy.hpp"
+
+using std::optional;
+using std::nullopt;
+using std::string;
+using std::string_view;
+using std::vector;
+
+namespace {
+    const char* const CACHE_DIR_NAME = "cache";
+    const char* const OBJECT_DIR_NAME = "objects";
+    const char* const ENTRY_EXTENSION = "entry";
+
+    // Title metadata is a few KiB per game, so this is far more than most players will ever need
+    constexpr size_t MAX_CACHE_BYTES = 16 * 1024 * 1024;
+
+    // Entries that weren't fetched (or revalidated) this recently are probably for games that are long gone
+    constexpr std::chrono::seconds MAX_ENTRY_AGE = std::chrono::hours(24 * 90);
+
+    // The URLs that some thread is downloading right now,
+    // so that concurrent requests for the same file share one download
+    std::mutex InFlightLock;
+    std::condition_variable InFlightDone;
+    std::unordered_set<string> InFlight;
+
+    // Held while writing to the cache, so that eviction can't delete a body that's about to get an entry
+    std::mutex StoreLock;
+
+    /// Claims \c url for the calling thread, waiting for whoever had it first.
+    class InFlightClaim {
+    public:
+        InFlightClaim(string_view url, const std::atomic_bool& cancelled) : _url(url) {
+            std::unique_lock lock(InFlightLock);
+            while (InFlight.contains(_url)) {
+                if (cancelled)
+                    return;
+
+                InFlightDone.wait_for(lock, std::chrono::milliseconds(50));
+            }
+
+            InFlight.insert(_url);
+            _claimed = true;
+        }
+
+        ~InFlightClaim() noexcept {
+            if (_claimed) {
+                std::lock_guard lock(InFlightLock);
+                InFlight.erase(_url);
+                InFlightDone.notify_all();
+            }
+        }
+
+        InFlightClaim(const InFlightClaim&) = delete;
+        InFlightClaim& operator=(const InFlightClaim&) = delete;
+
+        explicit operator bool() const noexcept { return _claimed; }
+    private:
+        string _url;
+        bool _claimed = false;
+    };
+
+    /// The SHA-256 of \c data, in lowercase hex.
+    string Hash(std::span<const std::byte> data) noexcept {
+        char hash[65] {};
+        sha256_hash(hash, reinterpret_cast<const uint8_t*>(data.data()), data.size());
+        return hash;
+    }
+
+    bool IsHash(string_view hash) noexcept {
+        return hash.size() == 64 && std::ranges::all_of(hash, [](char c) { return isxdigit(static_cast<unsigned char>(c)); });
+    }
+}
+
+optional<MelonDsDs::DownloadCache> MelonDsDs::DownloadCache::Default() noexcept {
+    optional<string> directory = retro::get_system_subdir_path(CACHE_DIR_NAME);
+    if (!directory)
+        return nullopt;
+
+    return DownloadCache(std::move(*directory));
+}
+
+string MelonDsDs::DownloadCache::EntryPath(string_view url) const {
+    string name = fmt::format("{}.{}", Hash(std::as_bytes(std::span(url))), ENTRY_EXTENSION);
+
+    char path[PATH_MAX] {};
+    fill_pathname_join_special(path, _directory.c_str(), name.c_str(), sizeof(path));
+    return path;
+}
+
+string MelonDsDs::DownloadCache::ObjectDirectory() const {
+    char objects[PATH_MAX] {};
+    fill_pathname_join_special(objects, _directory.c_str(), OBJECT_DIR_NAME, sizeof(objects));
+    return objects;
+}
+
+string MelonDsDs::DownloadCache::ObjectPath(string_view hash) const {
+    string objects = ObjectDirectory();
+    string name(hash);
+
+    char path[PATH_MAX] {};
+    fill_pathname_join_special(path, objects.c_str(), name.c_str(), sizeof(path));
+    return path;
+}
+
+optional<MelonDsDs::DownloadCache::Entry> MelonDsDs::DownloadCache::ReadEntry(string_view url) const noexcept {
+    ZoneScopedN(TracyFunction);
+    string path = EntryPath(url);
+    if (!path_is_valid(path.c_str()))
+        return nullopt;
+
+    optional<Entry> entry = ReadEntryFile(path.c_str());
+    if (!entry || entry->Url != url) {
+        // Either it's corrupt or another URL has the same name; either way, it's not ours
+        retro::debug("Ignoring download cache entry \"{}\"", path);
+        return nullopt;
+    }
+
+    return entry;
+}
+
+optional<MelonDsDs::DownloadCache::Entry> MelonDsDs::DownloadCache::ReadEntryFile(const char* path) noexcept {
+    void* buffer = nullptr;
+    int64_t size = 0;
+    if (!filestream_read_file(path, &buffer, &size)) {
+        retro::warn("Failed to read download cache entry \"{}\"", path);
+        return nullopt;
+    }
+
+    // One field per line: URL, ETag, Last-Modified, body hash, body size, fetch time
+    std::array<string_view, 6> fields {};
+    string_view contents(static_cast<const char*>(buffer), size);
+    for (string_view& field : fields) {
+        size_t end = std::min(contents.find('\n'), contents.size());
+        field = contents.substr(0, end);
+        contents.remove_prefix(std::min(end + 1, contents.size()));
+    }
+
+    Entry entry {
+        .Url = string(fields[0]),
+        .ETag = string(fields[1]),
+        .LastModified = string(fields[2]),
+        .Hash = string(fields[3]),
+    };
+    bool valid = !entry.Url.empty()
+        && IsHash(entry.Hash)
+        && sscanf(string(fields[4]).c_str(), "%zu", &entry.Size) == 1
+        && sscanf(string(fields[5]).c_str(), "%" SCNd64, &entry.FetchedAt) == 1;
+    free(buffer);
+
+    return valid ? optional(std::move(entry)) : nullopt;
+}
+
+optional<vector<std::byte>> MelonDsDs::DownloadCache::ReadObject(const Entry& entry) const noexcept {
+    ZoneScopedN(TracyFunction);
+    string path = ObjectPath(entry.Hash);
+    void* buffer = nullptr;
+    int64_t size = 0;
+    if (!path_is_valid(path.c_str()) || !filestream_read_file(path.c_str(), &buffer, &size))
+        return nullopt;
+
+    vector<std::byte> body(static_cast<size_t>(size));
+    memcpy(body.data(), buffer, body.size());
+    free(buffer);
+
+    if (body.size() != entry.Size || Hash(body) != entry.Hash) {
+        retro::warn("Cached download \"{}\" is corrupt, ignoring it", path);
+        return nullopt;
+    }
+
+    return body;
+}
+
+bool MelonDsDs::DownloadCache::WriteEntry(const Entry& entry) const noexcept {
+    ZoneScopedN(TracyFunction);
+    string contents = fmt::format(
+        "{}\n{}\n{}\n{}\n{}\n{}\n",
+        entry.Url,
+        entry.ETag,
+        entry.LastModified,
+        entry.Hash,
+        entry.Size,
+        entry.FetchedAt
+    );
+
+    string path = EntryPath(entry.Url);
+    if (!SaveWriter::WriteAtomically(path, std::as_bytes(std::span(contents)))) {
+        retro::warn("Failed to write download cache entry \"{}\"", path);
+        return false;
+    }
+
+    return true;
+}
+
+bool MelonDsDs::DownloadCache::Store(Entry& entry, std::span<const std::byte> body) const noexcept {
+    ZoneScopedN(TracyFunction);
+    entry.Hash = Hash(body);
+    entry.Size = body.size();
+
+    std::lock_guard lock(StoreLock);
+    string objects = ObjectDirectory();
+    if (!path_mkdir(objects.c_str())) {
+        retro::warn("Failed to create download cache directory \"{}\"", objects);
+        return false;
+    }
+
+    // Identical bodies share a file, so it only needs writing if it isn't already there intact
+    // (it might not be if the last write was interrupted)
+    bool stored = ReadObject(entry).has_value();
+    string path = ObjectPath(entry.Hash);
+    if (!stored && !SaveWriter::WriteAtomically(path, body)) {
+        retro::warn("Failed to write cached download \"{}\"", path);
+        return false;
+    }
+
+    if (!WriteEntry(entry))
+        return false;
+
+    if (!stored) {
+        // If the cache just got bigger...
+        Evict();
+    }
+
+    return true;
+}
+
+void MelonDsDs::DownloadCache::Evict() const noexcept {
+    ZoneScopedN(TracyFunction);
+    int64_t now = time(nullptr);
+    vector<std::pair<string, Entry>> entries;
+    for (const retro::dirent& d : retro::readdir(_directory, false)) {
+        if (!d.is_regular_file() || !string_is_equal(path_get_extension(d.path), ENTRY_EXTENSION))
+            continue;
+
+        optional<Entry> entry = ReadEntryFile(d.path);
+        if (entry && now - entry->FetchedAt < MAX_ENTRY_AGE.count()) {
+            entries.emplace_back(d.path, std::move(*entry));
+        } else {
+            // If this entry is corrupt, from an older version of the cache, or hasn't been needed in ages...
+            retro::debug("Evicting download cache entry \"{}\"", d.path);
+            filestream_delete(d.path);
+        }
+    }
+
+    // Newest first, so that the oldest entries are the ones that don't fit
+    std::ranges::sort(entries, std::greater {}, [](const std::pair<string, Entry>& e) { return e.second.FetchedAt; });
+    std::unordered_set<string> kept;
+    size_t keptBytes = 0;
+    for (const auto& [path, entry] : entries) {
+        if (kept.contains(entry.Hash))
+            continue; // Shares a body with a newer entry, so it takes up no more space
+
+        if (keptBytes + entry.Size > MAX_CACHE_BYTES) {
+            retro::debug("Evicting download cache entry \"{}\" for {}", path, entry.Url);
+            filestream_delete(path.c_str());
+            continue;
+        }
+
+        keptBytes += entry.Size;
+        kept.insert(entry.Hash);
+    }
+
+    for (const retro::dirent& d : retro::readdir(ObjectDirectory(), false)) {
+        if (d.is_regular_file() && !kept.contains(path_basename(d.path))) {
+            // If no remaining entry uses this body...
+            filestream_delete(d.path);
+        }
+    }
+}
+
+optional<vector<std::byte>> MelonDsDs::DownloadCache::Fetch(
+    string_view url,
+    std::chrono::seconds maxAge,
+    std::chrono::seconds timeout,
+    const std::atomic_bool& cancelled
+) const noexcept {
+    ZoneScopedN(TracyFunction);
+    InFlightClaim claim(url, cancelled);
+    if (!claim) {
+        retro::debug("Cancelled download of {} while waiting for another one", url);
+        return nullopt;
+    }
+
+    // If another thread just downloaded this, it's fresh now
+    optional<Entry> entry = ReadEntry(url);
+    optional<vector<std::byte>> cached = entry ? ReadObject(*entry) : nullopt;
+    int64_t now = time(nullptr);
+    if (cached && now - entry->FetchedAt < maxAge.count()) {
+        retro::debug("Using cached download of {}", url);
+        return cached;
+    }
+
+    string headers;
+    if (cached && !entry->ETag.empty())
+        headers += fmt::format("If-None-Match: {}\r\n", entry->ETag);
+
+    if (cached && !entry->LastModified.empty())
+        headers += fmt::format("If-Modified-Since: {}\r\n", entry->LastModified);
+
+    retro::info("Downloading {}", url);
+    try {
+        retro::HttpConnection connection(url, "GET", {}, headers);
+
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        size_t progress = 0, total = 0;
+        while (!connection.Update(progress, total)) {
+            if (cancelled) {
+                retro::debug("Cancelled download of {}", url);
+                return nullopt;
+            }
+
+            if (std::chrono::steady_clock::now() >= deadline) {
+                retro::error("HTTP request to {} timed out after {}s", url, timeout.count());
+                return cached; // A stale copy is better than nothing
+            }
+
+            retro_sleep(5);
+        }
+
+        if (cached && connection.Status() == 304) {
+            // If the server says our copy is still good...
+            retro::debug("Cached download of {} is still current", url);
+            entry->FetchedAt = now;
+            WriteEntry(*entry);
+            return cached;
+        }
+
+        if (connection.IsError()) {
+            if (int status = connection.Status(); status > 0) {
+                retro::error("HTTP request to {} failed with {}", url, status);
+            } else {
+                retro::error("HTTP request to {} failed with unknown error", url);
+            }
+
+            return cached;
+        }
+
+        std::span<const std::byte> payload = connection.Data(false);
+        vector<std::byte> body(payload.begin(), payload.end());
+        Entry updated {
+            .Url = string(url),
+            .ETag = connection.Header("ETag").value_or(""),
+            .LastModified = connection.Header("Last-Modified").value_or(""),
+            .FetchedAt = now,
+        };
+
+        if (Store(updated, body)) {
+            retro::debug("Cached {} bytes from {}", body.size(), url);
+        }
+
+        return body;
+    }
+    catch (const std::exception& e) {
+        retro::error("Failed to start HTTP request to {}: {}", url, e.what());
+        return cached;
+    }
+}
+#endif
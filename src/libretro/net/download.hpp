@@ -0,0 +1,87 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#pragma once
+
+#ifdef HAVE_NETWORKING
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "std/span.hpp"
+
+namespace MelonDsDs {
+    /// A disk cache for files fetched over HTTP.
+    /// Bodies are stored once per distinct content (named by their SHA-256),
+    /// and each URL's entry records which body it last returned
+    /// along with the validators needed to ask the server if it's changed.
+    /// Entries that haven't been fetched in a long time are evicted,
+    /// as are the oldest ones once the bodies take up too much space.
+    class DownloadCache {
+    public:
+        explicit DownloadCache(std::string directory) noexcept : _directory(std::move(directory)) {}
+
+        /// The cache in the core's system subdirectory,
+        /// or \c nullopt if the frontend didn't provide a system directory.
+        static std::optional<DownloadCache> Default() noexcept;
+
+        /// Returns the body of \c url.
+        /// Cached bodies younger than \c maxAge are returned as-is;
+        /// older ones are revalidated with the server, and used again if it says they haven't changed
+        /// (or if it can't be reached).
+        /// Blocks until the download finishes or \c timeout elapses,
+        /// so only call this off the main thread.
+        /// If another thread is already fetching \c url, waits for it and uses its result.
+        [[nodiscard]] std::optional<std::vector<std::byte>> Fetch(
+            std::string_view url,
+            std::chrono::seconds maxAge,
+            std::chrono::seconds timeout,
+            const std::atomic_bool& cancelled
+        ) const noexcept;
+    private:
+        struct Entry {
+            std::string Url;
+            std::string ETag;
+            std::string LastModified;
+            std::string Hash; // SHA-256 of the body, in hex
+            size_t Size = 0;
+            int64_t FetchedAt = 0;
+        };
+
+        [[nodiscard]] std::string EntryPath(std::string_view url) const;
+        [[nodiscard]] std::string ObjectDirectory() const;
+        [[nodiscard]] std::string ObjectPath(std::string_view hash) const;
+        [[nodiscard]] std::optional<Entry> ReadEntry(std::string_view url) const noexcept;
+        [[nodiscard]] static std::optional<Entry> ReadEntryFile(const char* path) noexcept;
+        [[nodiscard]] std::optional<std::vector<std::byte>> ReadObject(const Entry& entry) const noexcept;
+        bool WriteEntry(const Entry& entry) const noexcept;
+        bool Store(Entry& entry, std::span<const std::byte> body) const noexcept;
+
+        /// Deletes the entries that are too old or don't fit in the cache's size limit (oldest first),
+        /// then the bodies that no remaining entry refers to.
+        /// Only call while holding the lock that \c Store takes.
+        void Evict() const noexcept;
+
+        std::string _directory;
+    };
+}
+#endif
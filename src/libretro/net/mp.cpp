@@ -15,64 +15,94 @@
 */
 #include "mp.hpp"
 #include "environment.hpp"
-#include <ctime>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <utility>
 #include <libretro.h>
 #include <retro_assert.h>
 #include <retro_endianness.h>
+#include "tracy.hpp"
 using namespace MelonDsDs;
 
 // How many successive timeouts before
 // the player gets notified they are not supposed to use a VPN.
 constexpr int SUCCESSIVE_TIMEOUTS_WARNING = 6;
-constexpr long RECV_TIMEOUT_MS = 25;
+
+// While waiting for a packet, poll without pausing for a little longer than recent packets took to arrive
+// (replies usually come back within a few hundred microseconds on a LAN)...
+constexpr std::chrono::microseconds MIN_SPIN_TIME {50};
+constexpr std::chrono::microseconds MAX_SPIN_TIME {500};
+
+// ...then give up the CPU between polls, first briefly and then by sleeping
+constexpr std::chrono::milliseconds YIELD_TIME {2};
+constexpr std::chrono::microseconds SLEEP_TIME {250};
+
+// Telemetry rates are measured over this long, and logged every few windows
+constexpr std::chrono::seconds STATS_WINDOW {1};
+constexpr unsigned STATS_LOG_WINDOWS = 10;
+
+// The type byte that marks a netpacket as a batch of packets rather than a single one
+constexpr uint8_t BATCH_TYPE = 3;
+constexpr size_t BatchRecordHeaderSize = sizeof(uint16_t);
 
 uint64_t swapToNetwork(uint64_t n) {
     return swap_if_little64(n);
 }
 
-Packet Packet::parsePk(const void *buf, uint64_t len) {
-    // Necessary because arithmetic on void* is forbidden
-    const char *indexableBuf = (const char *)buf;
-    const char *data = indexableBuf + HeaderSize;
-    retro_assert(len >= HeaderSize);
-    size_t dataLen = len - HeaderSize;
-    uint64_t timestamp = swapToNetwork(*(const uint64_t*)(indexableBuf));
-    uint8_t aid = *(const uint8_t*)(indexableBuf + 8);
-    uint8_t type = *(const uint8_t*)(indexableBuf + 9);
+std::optional<Packet::Type> Packet::PeekType(const void *buf, size_t len) noexcept {
+    if (len < HeaderSize || len > MAX_WIRE_SIZE) {
+        retro::debug("Dropping malformed packet of {} bytes", len);
+        return std::nullopt;
+    }
+
     // type 2 means cmd frame
     // type 1 means reply frame
     // type 0 means anything else
-    retro_assert(type == 2 || type == 1 || type == 0);
-    Packet::Type pkType;
+    uint8_t type = static_cast<const uint8_t *>(buf)[9];
     switch (type) {
         case 0:
-            pkType = Other;
-            break;
+            return Other;
         case 1:
-            pkType = Reply;
-            break;
+            return Reply;
         case 2:
-            pkType = Cmd;
-            break;
+            return Cmd;
+        default:
+            retro::debug("Dropping packet with unknown type {}", type);
+            return std::nullopt;
     }
-    return Packet(data, dataLen, timestamp, aid, pkType);
 }
 
-Packet::Packet(const void *data, uint64_t len, uint64_t timestamp, uint8_t aid, Packet::Type type) :
-    _data((unsigned char*)data, (unsigned char*)data + len),
-    _timestamp(timestamp),
-    _aid(aid),
-    _type(type){
+bool Packet::Parse(const void *buf, size_t len) noexcept {
+    std::optional<Type> type = PeekType(buf, len);
+    if (!type) {
+        return false;
+    }
+
+    // Necessary because arithmetic on void* is forbidden
+    const uint8_t *indexableBuf = (const uint8_t *)buf;
+    uint64_t timestamp;
+    memcpy(&timestamp, indexableBuf, sizeof(timestamp)); // (might not be aligned)
+
+    _type = *type;
+    _timestamp = swapToNetwork(timestamp);
+    _aid = indexableBuf[8];
+    _length = static_cast<uint16_t>(len - HeaderSize);
+    memcpy(_data.data(), indexableBuf + HeaderSize, _length);
+    return true;
 }
 
-std::vector<uint8_t> Packet::ToBuf() const {
-    std::vector<uint8_t> ret;
-    ret.reserve(HeaderSize + Length());
-    uint64_t netTimestamp = swapToNetwork(_timestamp);
-    ret.insert(ret.end(), (const char *)&netTimestamp, ((const char *)&netTimestamp) + sizeof(uint64_t));
-    ret.push_back(_aid);
+size_t Packet::Serialize(std::span<uint8_t> out, std::span<const uint8_t> data, uint64_t timestamp, uint8_t aid, Type type) noexcept {
+    if (data.size() > MAX_DATA_SIZE || out.size() < HeaderSize + data.size()) {
+        return 0;
+    }
+
+    uint64_t netTimestamp = swapToNetwork(timestamp);
+    memcpy(out.data(), &netTimestamp, sizeof(uint64_t));
+    out[8] = aid;
     uint8_t numericalType = 0;
-    switch(_type) {
+    switch(type) {
         case Other:
             numericalType = 0;
             break;
@@ -83,9 +113,9 @@ std::vector<uint8_t> Packet::ToBuf() const {
             numericalType = 2;
             break;
     }
-    ret.push_back(numericalType);
-    ret.insert(ret.end(), _data.begin(), _data.end());
-    return ret;
+    out[9] = numericalType;
+    memcpy(out.data() + HeaderSize, data.data(), data.size());
+    return HeaderSize + data.size();
 }
 
 bool MpState::IsReady() const noexcept {
@@ -95,72 +125,420 @@ bool MpState::IsReady() const noexcept {
 void MpState::SetSendFn(retro_netpacket_send_t sendFn) noexcept {
     if (sendFn != nullptr) {
         retro::set_warn_message("LAN Multiplayer will NOT work using VPNs or tunnels such as Hamachi!");
+        _statsWindowStart = std::chrono::steady_clock::now();
+    }
+    else {
+        // If multiplayer is ending, forget anything we didn't get to
+        receivedPackets.Clear();
+        _pendingReplies = 0;
+        _batchLength = 0;
+        _batchCount = 0;
+        _stats = {};
+        _statsWindow = {};
+        _statsWindows = 0;
+        _commandSentAt = std::nullopt;
     }
     _sendFn = sendFn;
 }
 
+void MpState::SetReceiveTimeout(std::chrono::milliseconds timeout) noexcept {
+    if (timeout != _recvTimeout) {
+        retro::debug("Local wireless receive timeout is now {}ms", timeout.count());
+        _recvTimeout = timeout;
+    }
+}
+
 void MpState::SetPollFn(retro_netpacket_poll_receive_t pollFn) noexcept {
     _pollFn = pollFn;
 }
 
+void PacketQueue::Push() noexcept {
+    if (_size == CAPACITY) {
+        // If the queue is full, make room by dropping the oldest packet
+        Pop();
+        _overflows++;
+    }
+
+    _size++;
+    TracyPlot("MP Receive Queue Depth", static_cast<int64_t>(_size));
+}
+
+void PacketQueue::Pop() noexcept {
+    retro_assert(_size > 0);
+    _head = (_head + 1) % SLOTS;
+    _size--;
+    TracyPlot("MP Receive Queue Depth", static_cast<int64_t>(_size));
+}
+
+void PacketQueue::Clear() noexcept {
+    _head = 0;
+    _size = 0;
+}
+
 void MpState::PacketReceived(const void *buf, size_t len, uint16_t client_id) noexcept {
     retro_assert(IsReady());
-    Packet p = Packet::parsePk(buf, len);
+    _statsWindow.NetpacketsReceived++;
+    if (len >= HeaderSize && static_cast<const uint8_t *>(buf)[9] == BATCH_TYPE) {
+        ReceiveBatch(buf, len, client_id);
+    }
+    else {
+        ReceivePacket(buf, len, client_id);
+    }
+}
+
+void MpState::ReceiveBatch(const void *buf, size_t len, uint16_t client_id) noexcept {
+    const uint8_t *batch = static_cast<const uint8_t *>(buf);
+    size_t offset = HeaderSize;
+    while (offset + BatchRecordHeaderSize <= len) {
+        uint16_t recordLength;
+        memcpy(&recordLength, batch + offset, sizeof(recordLength)); // (might not be aligned)
+        recordLength = swap_if_little16(recordLength);
+        offset += BatchRecordHeaderSize;
+        if (offset + recordLength > len) {
+            retro::debug("Dropping the rest of a batch with a truncated {}-byte packet", recordLength);
+            return;
+        }
+
+        ReceivePacket(batch + offset, recordLength, client_id);
+        offset += recordLength;
+    }
+}
+
+void MpState::ReceivePacket(const void *buf, size_t len, uint16_t client_id) noexcept {
+    std::optional<Packet::Type> type = Packet::PeekType(buf, len);
+    if (!type) {
+        return;
+    }
+
+    if (*type == Packet::Type::Reply) {
+        // Replies go straight to their client's slot, so they can be collected in any order
+        ReplyReceived(buf, len);
+        return;
+    }
+
+    // Parse the packet straight into the queue's spare slot
+    Packet& p = receivedPackets.Back();
+    if (!p.Parse(buf, len)) {
+        return;
+    }
+
     if(p.PacketType() == Packet::Type::Cmd) {
         _hostId = client_id;
         //retro::debug("Host client id is {}", client_id);
     }
-    receivedPackets.push(std::move(p));
+
+    uint64_t overflows = receivedPackets.Overflows();
+    receivedPackets.Push();
+    if (receivedPackets.Overflows() != overflows) {
+        retro::debug("Receive queue is full; dropped the oldest packet");
+    }
+    _statsWindow.PacketsReceived++;
+    _statsWindow.MaxQueueDepth = std::max(_statsWindow.MaxQueueDepth, receivedPackets.Size());
 }
 
-std::optional<Packet> MpState::NextPacket() noexcept {
+void MpState::ReplyReceived(const void *buf, size_t len) noexcept {
+    uint8_t aid = static_cast<const uint8_t *>(buf)[8];
+    if (aid == 0 || aid > MAX_CLIENTS) {
+        retro::debug("Dropping reply from invalid aid {}", aid);
+        return;
+    }
+
+    uint16_t bit = 1 << aid;
+    if (!_replies[aid].Parse(buf, len)) {
+        _pendingReplies &= ~bit;
+        return;
+    }
+
+    _pendingReplies |= bit;
+    _statsWindow.PacketsReceived++;
+
+    MpPeerStats& peer = _stats.Peers[aid];
+    if (_commandSentAt) {
+        // If we're the host, see how long this client took to answer our last command
+        double rtt = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - *_commandSentAt).count();
+        if (peer.Replies == 0) {
+            peer.RoundTripTime = rtt;
+        }
+        else {
+            peer.Jitter += (std::abs(rtt - peer.RoundTripTime) - peer.Jitter) / 16;
+            peer.RoundTripTime += (rtt - peer.RoundTripTime) / 8;
+        }
+    }
+    peer.Replies++;
+    _stats.PeerMask |= bit;
+}
+
+const Packet* MpState::NextPacket() noexcept {
     retro_assert(IsReady());
-    if(receivedPackets.empty()) {
-        _sendFn(RETRO_NETPACKET_FLUSH_HINT, NULL, 0, RETRO_NETPACKET_BROADCAST);
+    if(receivedPackets.Empty()) {
+        Flush();
         _pollFn();
     }
-    if(receivedPackets.empty()) {
-        return std::nullopt;
+    if(receivedPackets.Empty()) {
+        return nullptr;
     } else {
         _timeoutCount = 0;
-        Packet p = receivedPackets.front();
-        receivedPackets.pop();
-        return p;
+        return &receivedPackets.Front();
     }
 }
 
-std::optional<Packet> MpState::NextPacketBlock() noexcept {
-    retro_assert(IsReady());
-    if (receivedPackets.empty()) {
-        for(std::clock_t start = std::clock(); std::clock() < (start + (RECV_TIMEOUT_MS * CLOCKS_PER_SEC / 1000));) {
-            _sendFn(RETRO_NETPACKET_FLUSH_HINT, NULL, 0, RETRO_NETPACKET_BROADCAST);
-            _pollFn();
-            if(!receivedPackets.empty()) {
-                return NextPacket();
-            }
+void MpState::PopPacket() noexcept {
+    retro_assert(!receivedPackets.Empty());
+    receivedPackets.Pop();
+}
+
+template<typename Predicate>
+bool MpState::WaitUntil(Predicate done) noexcept {
+    if (done()) {
+        return true;
+    }
+
+    using clock = std::chrono::steady_clock;
+    clock::time_point start = clock::now();
+    clock::time_point deadline = start + _recvTimeout;
+    clock::duration spinTime = std::clamp<clock::duration>(2 * _typicalWait, MIN_SPIN_TIME, MAX_SPIN_TIME);
+    for (clock::time_point now = start; now < deadline; now = clock::now()) {
+        Flush();
+        _pollFn();
+        if (done()) {
+            clock::duration waited = clock::now() - start;
+            _waitTime += waited;
+            _typicalWait = (_typicalWait * 7 + waited) / 8;
+            _timeoutCount = 0;
+            return true;
+        }
+
+        clock::duration elapsed = now - start;
+        if (_waitFn) {
+            // If the transport can tell us when a packet arrives, sleep until then
+            _waitFn(std::chrono::duration_cast<std::chrono::microseconds>(deadline - now));
+        }
+        else if (elapsed >= YIELD_TIME) {
+            // If the packet is taking a while, stop burning the CPU for it
+            std::this_thread::sleep_for(SLEEP_TIME);
+        }
+        else if (elapsed >= spinTime) {
+            std::this_thread::yield();
         }
-    } else {
-        return NextPacket();
     }
+
+    _waitTime += clock::now() - start;
+    _typicalWait = (_typicalWait * 7 + _recvTimeout) / 8;
     _timeoutCount++;
+    _stats.Timeouts++;
+    TracyPlot("MP Timeouts", static_cast<int64_t>(_stats.Timeouts));
     if (_timeoutCount >= SUCCESSIVE_TIMEOUTS_WARNING && !_warnedHighLatency) {
         retro::set_warn_message("LAN Multiplayer will NOT work using VPNs or tunnels such as Hamachi!");
         _warnedHighLatency = true;
     }
-    retro::debug("Timeout while waiting for packet");
-    return std::nullopt;
+    return false;
 }
 
-void MpState::SendPacket(const Packet &p) noexcept {
+const Packet* MpState::NextPacketBlock() noexcept {
+    ZoneScopedN(TracyFunction);
     retro_assert(IsReady());
+    if (!WaitUntil([this] { return !receivedPackets.Empty(); })) {
+        retro::debug("Timeout while waiting for packet");
+        return nullptr;
+    }
+
+    return NextPacket();
+}
+
+uint16_t MpState::TakeReplies(uint8_t* packets, uint64_t timestamp) noexcept {
+    uint16_t taken = 0;
+    for (uint8_t aid = 1; aid <= MAX_CLIENTS; aid++) {
+        uint16_t bit = 1 << aid;
+        if (!(_pendingReplies & bit)) {
+            continue;
+        }
+
+        _pendingReplies &= ~bit;
+        const Packet& reply = _replies[aid];
+        if (IsStaleReply(reply, timestamp)) {
+            continue;
+        }
+
+        memcpy(&packets[(aid - 1) * REPLY_SLOT_SIZE], reply.Data(), std::min<size_t>(reply.Length(), REPLY_SLOT_SIZE));
+        taken |= bit;
+    }
+
+    return taken;
+}
+
+uint16_t MpState::RecvReplies(uint8_t* packets, uint64_t timestamp, uint16_t aidmask) noexcept {
+    ZoneScopedN(TracyFunction);
+    retro_assert(IsReady());
+    uint16_t received = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool complete = WaitUntil([&] {
+        received |= TakeReplies(packets, timestamp);
+        return (received & aidmask) == aidmask;
+    });
+
+    double waited = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    _stats.ReplyWait += (waited - _stats.ReplyWait) / 8;
+    if (!complete) {
+        retro::debug("Timeout while waiting for replies (expected {:#06x}, got {:#06x})", aidmask, received);
+        for (uint8_t aid = 1; aid <= MAX_CLIENTS; aid++) {
+            if ((aidmask & ~received) & (1 << aid)) {
+                _stats.Peers[aid].MissedReplies++;
+            }
+        }
+    }
+
+    return received;
+}
+
+std::chrono::steady_clock::duration MpState::TakeWaitTime() noexcept {
+    return std::exchange(_waitTime, {});
+}
+
+void MpState::SendPacket(std::span<const uint8_t> data, uint64_t timestamp, uint8_t aid, Packet::Type type) noexcept {
+    retro_assert(IsReady());
+    size_t length = Packet::Serialize(_sendBuffer, data, timestamp, aid, type);
+    if (length == 0) {
+        retro::warn("Dropping outgoing packet of {} bytes (the limit is {})", data.size(), Packet::MAX_DATA_SIZE);
+        return;
+    }
+
     uint16_t dest = RETRO_NETPACKET_BROADCAST;
-    if(p.PacketType() == Packet::Type::Cmd) {
+    _statsWindow.PacketsSent++;
+    if(type == Packet::Type::Cmd) {
         _hostId = std::nullopt;
+        _commandSentAt = std::chrono::steady_clock::now();
     }
-    if(p.PacketType() == Packet::Type::Reply && _hostId.has_value()) {
+    if(type == Packet::Type::Reply && _hostId.has_value()) {
         dest = _hostId.value();
     }
-    _sendFn(RETRO_NETPACKET_UNSEQUENCED | RETRO_NETPACKET_UNRELIABLE | RETRO_NETPACKET_FLUSH_HINT, p.ToBuf().data(), p.Length() + HeaderSize, dest);
+
+    if (_batching) {
+        size_t recordSize = BatchRecordHeaderSize + length;
+        if (_batchCount > 0 && (dest != _batchDest || _batchLength + recordSize > _batchBuffer.size())) {
+            // If this packet can't join the pending batch, send the batch first to keep packets in order
+            FlushBatch();
+        }
+
+        if (HeaderSize + recordSize <= _batchBuffer.size()) {
+            if (_batchCount == 0) {
+                // Only the type byte of a batch's header means anything
+                memset(_batchBuffer.data(), 0, HeaderSize);
+                _batchBuffer[9] = BATCH_TYPE;
+                _batchLength = HeaderSize;
+                _batchDest = dest;
+            }
+
+            uint16_t recordLength = swap_if_little16(static_cast<uint16_t>(length));
+            memcpy(_batchBuffer.data() + _batchLength, &recordLength, sizeof(recordLength));
+            memcpy(_batchBuffer.data() + _batchLength + BatchRecordHeaderSize, _sendBuffer.data(), length);
+            _batchLength += recordSize;
+            _batchCount++;
+            return;
+        }
+        // Packets too big to batch are sent on their own
+    }
+
+    _sendFn(RETRO_NETPACKET_UNSEQUENCED | RETRO_NETPACKET_UNRELIABLE | RETRO_NETPACKET_FLUSH_HINT, _sendBuffer.data(), length, dest);
+    _statsWindow.NetpacketsSent++;
+}
+
+void MpState::SetBatching(bool enabled) noexcept {
+    if (enabled == _batching) {
+        return;
+    }
+
+    if (!enabled && IsReady()) {
+        // If we're turning batching off mid-session, don't strand the pending batch
+        FlushBatch();
+    }
+    _batching = enabled;
+    retro::debug("{} local wireless packet batching", enabled ? "Enabled" : "Disabled");
+}
+
+bool MpState::FlushBatch() noexcept {
+    if (_batchCount == 0) {
+        return false;
+    }
+
+    const uint8_t *data = _batchBuffer.data();
+    size_t length = _batchLength;
+    if (_batchCount == 1) {
+        // If there's just one packet, send it as-is; a batch of one would only add overhead
+        data += HeaderSize + BatchRecordHeaderSize;
+        length -= HeaderSize + BatchRecordHeaderSize;
+    }
+
+    _sendFn(RETRO_NETPACKET_UNSEQUENCED | RETRO_NETPACKET_UNRELIABLE | RETRO_NETPACKET_FLUSH_HINT, data, length, _batchDest);
+    _statsWindow.NetpacketsSent++;
+    _batchLength = 0;
+    _batchCount = 0;
+    return true;
+}
+
+void MpState::Flush() noexcept {
+    retro_assert(IsReady());
+    if (_batching) {
+        // Every packet that isn't batched is already sent with a flush hint,
+        // so there's nothing more to do if the batch is empty
+        FlushBatch();
+    }
+    else {
+        _sendFn(RETRO_NETPACKET_FLUSH_HINT, NULL, 0, RETRO_NETPACKET_BROADCAST);
+    }
+}
+
+void MpState::UpdateStats() noexcept {
+    using clock = std::chrono::steady_clock;
+    clock::time_point now = clock::now();
+    clock::duration elapsed = now - _statsWindowStart;
+    if (elapsed < STATS_WINDOW) {
+        return;
+    }
+
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    _stats.PacketsSent = _statsWindow.PacketsSent / seconds;
+    _stats.PacketsReceived = _statsWindow.PacketsReceived / seconds;
+    _stats.NetpacketsSent = _statsWindow.NetpacketsSent / seconds;
+    _stats.NetpacketsReceived = _statsWindow.NetpacketsReceived / seconds;
+    _stats.MaxQueueDepth = _statsWindow.MaxQueueDepth;
+    _statsWindow = {};
+    _statsWindowStart = now;
+
+    TracyPlot("MP Packets Sent/s", _stats.PacketsSent);
+    TracyPlot("MP Packets Received/s", _stats.PacketsReceived);
+    TracyPlot("MP Max Queue Depth", static_cast<int64_t>(_stats.MaxQueueDepth));
+    if (++_statsWindows % STATS_LOG_WINDOWS == 0) {
+        LogStats(RETRO_LOG_DEBUG);
+    }
 }
 
+void MpState::LogStats(retro_log_level level) const noexcept {
+    retro::log(
+        level,
+        "Local wireless: {:.0f} packets/s sent in {:.0f} netpackets/s, {:.0f} packets/s received in {:.0f} netpackets/s, "
+        "queue depth up to {}, {} timeouts (after {}ms), {:.2f}ms average reply wait",
+        _stats.PacketsSent,
+        _stats.NetpacketsSent,
+        _stats.PacketsReceived,
+        _stats.NetpacketsReceived,
+        _stats.MaxQueueDepth,
+        _stats.Timeouts,
+        _recvTimeout.count(),
+        _stats.ReplyWait
+    );
 
+    for (uint8_t aid = 1; aid <= MAX_CLIENTS; aid++) {
+        if (_stats.PeerMask & (1 << aid)) {
+            const MpPeerStats& peer = _stats.Peers[aid];
+            retro::log(
+                level,
+                "Local wireless client {}: {:.2f}ms round trip ({:.2f}ms jitter), {} replies, {} missed",
+                aid,
+                peer.RoundTripTime,
+                peer.Jitter,
+                peer.Replies,
+                peer.MissedReplies
+            );
+        }
+    }
+}
@@ -14,24 +14,47 @@
     with melonDS DS. If not, see http://www.gnu.org/licenses/.
 */
 #pragma once
+#include <array>
+#include <chrono>
 #include <cstdint>
-#include <queue>
 #include <optional>
-#include <vector>
 #include <libretro.h>
 
+#include "std/span.hpp"
+
 namespace MelonDsDs {
 // timestamp, aid, and isReply, respectively.
 constexpr size_t HeaderSize = sizeof(uint64_t) + sizeof(uint8_t) + sizeof(uint8_t);
 
+/// A multiplayer packet received from another player, held in fixed-size storage
+/// so that receiving one never allocates.
 class Packet {
 public:
     enum Type {
         Reply, Cmd, Other
     };
 
-    static Packet parsePk(const void *buf, uint64_t len);
-    explicit Packet(const void *data, uint64_t len, uint64_t timestamp, uint8_t aid, Packet::Type type);
+    /// The largest payload we'll carry.
+    /// DS wireless frames are bounded by the Wi-Fi chip's 8KB of RAM (and in practice are far smaller),
+    /// so this is plenty.
+    static constexpr size_t MAX_DATA_SIZE = 4096;
+
+    /// The largest packet on the wire, header included.
+    static constexpr size_t MAX_WIRE_SIZE = HeaderSize + MAX_DATA_SIZE;
+
+    Packet() noexcept = default;
+
+    /// Reads just the type of a packet received off the network, without copying it.
+    /// \returns \c std::nullopt if \c buf isn't a valid packet.
+    [[nodiscard]] static std::optional<Type> PeekType(const void *buf, size_t len) noexcept;
+
+    /// Fills this packet from one received off the network.
+    /// \returns \c false (leaving the packet unspecified) if \c buf isn't a valid packet.
+    [[nodiscard]] bool Parse(const void *buf, size_t len) noexcept;
+
+    /// Writes the header and then \c data into \c out, ready to send.
+    /// \returns The number of bytes written, or 0 if \c data doesn't fit.
+    static size_t Serialize(std::span<uint8_t> out, std::span<const uint8_t> data, uint64_t timestamp, uint8_t aid, Type type) noexcept;
 
     [[nodiscard]] uint64_t Timestamp() const noexcept {
         return _timestamp;
@@ -46,15 +69,87 @@ public:
         return _data.data();
     };
     [[nodiscard]] uint64_t Length() const noexcept {
-        return _data.size();
+        return _length;
     };
+private:
+    uint64_t _timestamp = 0;
+    uint8_t _aid = 0;
+    Packet::Type _type = Other;
+    uint16_t _length = 0;
+    std::array<uint8_t, MAX_DATA_SIZE> _data;
+};
+
+/// A fixed-capacity FIFO of received packets.
+/// Never allocates; when it's full, the oldest packet is dropped to make room,
+/// since melonDS has no use for stale wireless frames.
+class PacketQueue {
+public:
+    /// Enough for every client's reply plus a host command or two, with room to spare for bursts.
+    static constexpr size_t CAPACITY = 32;
+
+    [[nodiscard]] bool Empty() const noexcept { return _size == 0; }
+    [[nodiscard]] size_t Size() const noexcept { return _size; }
+
+    /// Packets dropped (since the queue was created) because it was full.
+    [[nodiscard]] uint64_t Overflows() const noexcept { return _overflows; }
+
+    [[nodiscard]] Packet& Front() noexcept { return _slots[_head]; }
 
-    std::vector<uint8_t> ToBuf() const;
+    /// Returns the slot that the next packet should be written into.
+    /// This is never one of the queued packets, even when the queue is full,
+    /// so a packet that fails to parse leaves the queue as it was.
+    /// Call \c Push once it's filled in, or don't to discard it.
+    [[nodiscard]] Packet& Back() noexcept { return _slots[(_head + _size) % SLOTS]; }
+
+    /// Adds the packet written into \c Back to the queue,
+    /// dropping the oldest packet if the queue was full.
+    void Push() noexcept;
+    void Pop() noexcept;
+    void Clear() noexcept;
 private:
-    uint64_t _timestamp;
-    uint8_t _aid;
-    Packet::Type _type;
-    std::vector<uint8_t> _data;
+    // One more than the capacity, so that Back always has a free slot to parse into
+    static constexpr size_t SLOTS = CAPACITY + 1;
+    std::array<Packet, SLOTS> _slots;
+    size_t _head = 0;
+    size_t _size = 0;
+    uint64_t _overflows = 0;
+};
+
+/// Connection quality as seen from one client (on the host).
+struct MpPeerStats {
+    /// Smoothed time from sending a host command to receiving this client's reply, in milliseconds.
+    double RoundTripTime = 0;
+
+    /// Smoothed variation between successive round trips (as in RFC 3550), in milliseconds.
+    double Jitter = 0;
+    uint64_t Replies = 0;
+
+    /// How many times melonDS stopped waiting for replies before this client's arrived.
+    uint64_t MissedReplies = 0;
+};
+
+/// Local wireless telemetry, for diagnosing desyncs and tuning the receive timeout.
+struct MpStats {
+    /// Indexed by the client's aid, so index 0 is unused.
+    std::array<MpPeerStats, 16> Peers {};
+
+    /// The aids that have replied at least once.
+    uint16_t PeerMask = 0;
+
+    /// Smoothed time spent waiting for each exchange's replies, in milliseconds.
+    double ReplyWait = 0;
+
+    /// Waits for a packet or for replies that gave up.
+    uint64_t Timeouts = 0;
+
+    /// The most packets waiting in the receive queue at once over the last second.
+    size_t MaxQueueDepth = 0;
+
+    // The rest are measured over the last full second
+    double PacketsSent = 0;
+    double PacketsReceived = 0;
+    double NetpacketsSent = 0;
+    double NetpacketsReceived = 0;
 };
 
 class MpState {
@@ -62,16 +157,136 @@ public:
     void PacketReceived(const void *buf, size_t len, uint16_t client_id) noexcept;
     void SetSendFn(retro_netpacket_send_t sendFn) noexcept;
     void SetPollFn(retro_netpacket_poll_receive_t pollFn) noexcept;
+
+    /// The longest \c NextPacketBlock and \c RecvReplies wait before giving up.
+    /// Short enough on a LAN that a dropped packet barely stalls the game.
+    static constexpr std::chrono::milliseconds DEFAULT_RECV_TIMEOUT {25};
+
+    /// Sets how long to wait for packets before giving up.
+    /// Longer timeouts ride out more jitter (e.g. over internet relays),
+    /// at the cost of longer stalls when a packet really is lost.
+    void SetReceiveTimeout(std::chrono::milliseconds timeout) noexcept;
+
+    /// Sleeps until a packet might have arrived or the timeout passes, whichever comes first.
+    using WaitFn = void(*)(std::chrono::microseconds timeout) noexcept;
+
+    /// Lets a transport that can wake us up when a packet arrives do so,
+    /// instead of polling with backoff. Pass \c nullptr to go back to polling.
+    void SetWaitFn(WaitFn waitFn) noexcept { _waitFn = waitFn; }
     bool IsReady() const noexcept;
-    void SendPacket(const Packet &p) noexcept;
-    std::optional<Packet> NextPacket() noexcept;
-    std::optional<Packet> NextPacketBlock() noexcept;
+    void SendPacket(std::span<const uint8_t> data, uint64_t timestamp, uint8_t aid, Packet::Type type) noexcept;
+
+    /// If enabled, packets sent between polls are coalesced into one netpacket
+    /// instead of each being sent (and flushed) on its own.
+    /// Every player needs a build that understands batches.
+    void SetBatching(bool enabled) noexcept;
+
+    /// Sends any batched packets and asks the frontend to flush its send buffers.
+    /// Called before every poll and at the end of each frame.
+    void Flush() noexcept;
+
+    /// Returns the oldest received packet without removing it, polling once if there are none.
+    /// The packet stays valid until \c PopPacket is called.
+    const Packet* NextPacket() noexcept;
+
+    /// Like \c NextPacket, but waits a little while for a packet if there are none.
+    const Packet* NextPacketBlock() noexcept;
+
+    /// Removes the packet most recently returned by \c NextPacket or \c NextPacketBlock.
+    void PopPacket() noexcept;
+
+    /// The most clients a host can have; client aids run from 1 to this.
+    static constexpr uint8_t MAX_CLIENTS = 15;
+
+    /// Each client's reply gets this many bytes of the buffer given to \c RecvReplies.
+    static constexpr size_t REPLY_SLOT_SIZE = 1024;
+
+    /// Copies the replies to the exchange that started at \c timestamp into \c packets,
+    /// waiting until every client in \c aidmask has replied or the receive timeout passes
+    /// (whichever comes first).
+    /// Client \c n's reply is written to <tt>packets[(n - 1) * REPLY_SLOT_SIZE]</tt>.
+    /// \returns A mask of the clients whose replies were written.
+    uint16_t RecvReplies(uint8_t* packets, uint64_t timestamp, uint16_t aidmask) noexcept;
+
+    /// Replies more than this many microseconds older than the frame that melonDS is collecting replies for
+    /// are stale, and are discarded.
+    static constexpr uint64_t STALE_REPLY_WINDOW = 32;
+
+    /// \returns \c true if \c p can't be a reply to the exchange that started at \c timestamp.
+    [[nodiscard]] static bool IsStaleReply(const Packet& p, uint64_t timestamp) noexcept {
+        return p.Timestamp() < timestamp - STALE_REPLY_WINDOW;
+    }
+
+    /// Returns the time spent in \c NextPacketBlock since the last call, then resets it.
+    /// Call once per frame.
+    std::chrono::steady_clock::duration TakeWaitTime() noexcept;
+
+    [[nodiscard]] const MpStats& Stats() const noexcept { return _stats; }
+
+    /// Updates the per-second rates in \c Stats once a second has passed,
+    /// and periodically logs them. Call once per frame.
+    void UpdateStats() noexcept;
+
+    /// Logs the current \c Stats at the given level.
+    void LogStats(retro_log_level level) const noexcept;
 private:
+    void ReceivePacket(const void *buf, size_t len, uint16_t client_id) noexcept;
+    void ReceiveBatch(const void *buf, size_t len, uint16_t client_id) noexcept;
+    void ReplyReceived(const void *buf, size_t len) noexcept;
+
+    /// Sends the pending batch, if any.
+    /// \returns \c true if anything was sent.
+    bool FlushBatch() noexcept;
+
+    /// Copies every pending reply that isn't stale into \c packets, then marks them all as collected.
+    uint16_t TakeReplies(uint8_t* packets, uint64_t timestamp) noexcept;
+
+    /// Polls for packets (backing off gradually) until \c done returns \c true or the receive timeout passes.
+    /// \returns \c false on timeout.
+    template<typename Predicate>
+    bool WaitUntil(Predicate done) noexcept;
+
     bool _warnedHighLatency = false;
+    // How long recent waits for a packet took, for deciding how long to spin before yielding
+    std::chrono::steady_clock::duration _typicalWait {};
+    std::chrono::steady_clock::duration _waitTime {};
+    std::chrono::milliseconds _recvTimeout = DEFAULT_RECV_TIMEOUT;
     int _timeoutCount = 0;
     retro_netpacket_send_t _sendFn;
     retro_netpacket_poll_receive_t _pollFn;
+    WaitFn _waitFn = nullptr;
     std::optional<uint16_t> _hostId;
-    std::queue<Packet> receivedPackets;
+    PacketQueue receivedPackets;
+    // Replies are kept apart from other packets, indexed by the aid of the client that sent them
+    // (so index 0 is unused); a newer reply from a client replaces one that was never collected.
+    std::array<Packet, MAX_CLIENTS + 1> _replies;
+    uint16_t _pendingReplies = 0;
+    // Outgoing packets are serialized here, so sending doesn't allocate
+    std::array<uint8_t, Packet::MAX_WIRE_SIZE> _sendBuffer;
+
+    /// Batches are kept under a typical Ethernet MTU so they still go out as one datagram;
+    /// DS wireless frames are usually a few hundred bytes, so several fit.
+    static constexpr size_t MAX_BATCH_SIZE = 1400;
+    bool _batching = false;
+    // A batch is a header (with a type that older builds reject) followed by
+    // serialized packets, each prefixed with its length as a big-endian uint16_t
+    std::array<uint8_t, MAX_BATCH_SIZE> _batchBuffer;
+    size_t _batchLength = 0;
+    size_t _batchCount = 0;
+    uint16_t _batchDest = RETRO_NETPACKET_BROADCAST;
+
+    MpStats _stats {};
+    static_assert(std::tuple_size_v<decltype(MpStats::Peers)> == MAX_CLIENTS + 1);
+    // When the most recent host command was sent, for measuring each client's round trip
+    std::optional<std::chrono::steady_clock::time_point> _commandSentAt;
+    std::chrono::steady_clock::time_point _statsWindowStart {};
+    unsigned _statsWindows = 0;
+    struct {
+        uint64_t PacketsSent = 0;
+        uint64_t PacketsReceived = 0;
+        uint64_t NetpacketsSent = 0;
+        uint64_t NetpacketsReceived = 0;
+        size_t MaxQueueDepth = 0;
+    } _statsWindow;
 };
 }
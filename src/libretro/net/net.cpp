@@ -16,18 +16,37 @@
 
 #include "net.hpp"
 
+#include <iterator>
+#include <stdexcept>
 #include <string_view>
 
 #include <Net_Slirp.h>
+#include <libretro.h>
 #include <retro_assert.h>
+#include <file/file_path.h>
+#include <streams/file_stream.h>
+#include <string/stdstring.h>
 #include <fmt/format.h>
 #include <fmt/ranges.h>
 
+#ifdef HAVE_NETWORKING
+#include <glib-pool.h>
+#endif
+
 #include "environment.hpp"
 #include "config/config.hpp"
+#include "format.hpp"
 #include "pcap.hpp"
+#include "pcapthread.hpp"
+#include "slirpthread.hpp"
+#include "retro/task_queue.hpp"
+#include "retro/threads.hpp"
 #include "tracy.hpp"
+#include "tracy/memory.hpp"
 
+using std::optional;
+using std::string;
+using std::string_view;
 using std::vector;
 using namespace melonDS;
 
@@ -52,6 +71,8 @@ const AdapterData* SelectNetworkInterface(std::string_view iface, std::span<cons
     ZoneScopedN(TracyFunction);
     using namespace MelonDsDs;
 
+    if (adapters.empty())
+        return nullptr;
 
     if (iface != config::values::AUTO)
     {
@@ -99,6 +120,52 @@ const AdapterData* SelectNetworkInterface(std::string_view iface, std::span<cons
 
     return best;
 }
+
+// Saved in the system directory so the next session can offer the same adapters before it finishes enumerating them
+constexpr string_view ADAPTER_CACHE_NAME = "adapters.txt";
+
+// The first value of the Wi-Fi interface option is reserved for "Automatic"
+constexpr size_t MAX_ADAPTER_OPTIONS = RETRO_NUM_CORE_OPTION_VALUES_MAX - 2;
+
+static vector<AdapterData> EnumerateAdapters()
+{
+    ZoneScopedN(TracyFunction);
+
+    // Uses its own libpcap handle so the main thread can keep using NetState's in the meantime
+    optional<LibPCap> pcap = LibPCap::New();
+    if (!pcap)
+        throw std::runtime_error("Failed to load libpcap");
+
+    return pcap->GetAdapters();
+}
+
+static vector<MelonDsDs::AdapterOption> MakeAdapterOptions(std::span<const AdapterData> adapters) noexcept
+{
+    ZoneScopedN(TracyFunction);
+
+    vector<MelonDsDs::AdapterOption> options;
+    for (const AdapterData& adapter : adapters)
+    {
+        if (MelonDsDs::IsAdapterAcceptable(adapter) && options.size() < MAX_ADAPTER_OPTIONS)
+        { // If this interface would potentially work, and we haven't added the max...
+            string mac = fmt::format("{:02x}", fmt::join(adapter.MAC, ":"));
+            retro::debug(
+                "Found a \"{}\" ({}) interface with ID {} at {} bound to {} ({})",
+                adapter.FriendlyName,
+                adapter.Description,
+                adapter.DeviceName,
+                mac,
+                fmt::join(adapter.IP_v4, "."),
+                static_cast<MelonDsDs::FormattedPCapFlags>(adapter.Flags)
+            );
+
+            string label = fmt::format("{} ({})", string_is_empty(adapter.FriendlyName) ? adapter.DeviceName : adapter.FriendlyName, mac);
+            options.push_back({ .Value = std::move(mac), .Label = std::move(label) });
+        }
+    }
+
+    return options;
+}
 #endif
 
 MelonDsDs::NetState::NetState()
@@ -106,39 +173,262 @@ MelonDsDs::NetState::NetState()
     : _pcap(melonDS::LibPCap::New())
 #endif
 {
+#ifdef HAVE_NETWORKING
+    _slirpArena = gpool_arena_new();
+    if (_slirpArena)
+    {
+        gpool_arena_set_current(_slirpArena);
+    }
+    else
+    {
+        retro::warn("Failed to create an allocation arena for libslirp; it'll use malloc instead");
+    }
+#endif
+
     _net.RegisterInstance(0);
     // TODO: Handle registration properly (not yet sure what that'll entail)
 }
 
 MelonDsDs::NetState::~NetState() noexcept
 {
+    // Destroy the driver first, since a Net_Slirp can't outlive the arena it allocates from
+    _net.SetDriver(nullptr);
     _net.UnregisterInstance(0);
+
+#ifdef HAVE_NETWORKING
+    if (_slirpArena)
+    {
+        GPoolStats stats {};
+        gpool_arena_get_stats(_slirpArena, &stats);
+        retro::debug(
+            "libslirp made {} allocations ({} reused, {} too large to pool) and {} frees; "
+            "peaked at {} blocks ({} bytes) across {} slabs",
+            stats.allocations,
+            stats.reuses,
+            stats.large_allocations,
+            stats.frees,
+            stats.peak_live_blocks,
+            stats.peak_live_bytes,
+            stats.slabs
+        );
+        if (stats.live_blocks > 0)
+        {
+            retro::debug("Releasing {} blocks ({} bytes) that libslirp didn't free", stats.live_blocks, stats.live_bytes);
+        }
+
+        gpool_arena_free(_slirpArena);
+        _slirpArena = nullptr;
+    }
+#endif
 }
 
 int MelonDsDs::NetState::SendPacket(std::span<std::byte> data) noexcept
 {
+    // The driver's result goes straight back to melonDS, which may treat errors differently from dropped frames
     return _net.SendPacket(reinterpret_cast<u8*>(data.data()), data.size(), 0);
 }
 
 int MelonDsDs::NetState::RecvPacket(u8* data) noexcept
 {
+    // melonDS writes the frame directly into the caller's buffer
     return _net.RecvPacket(data, 0);
 }
 
-vector<melonDS::AdapterData> MelonDsDs::NetState::GetAdapters() const noexcept
+size_t MelonDsDs::NetState::SendPackets(std::span<const NetFrame> frames) noexcept
 {
     ZoneScopedN(TracyFunction);
 
+    size_t sent = 0;
+    for (const NetFrame& frame : frames)
+    {
+        retro_assert(frame.Length <= frame.Buffer.size());
+        if (SendPacket(frame.Buffer.first(frame.Length)) <= 0)
+            break;
+
+        sent++;
+    }
+
+    TracyPlot("Wi-Fi Frames Sent Per Batch", static_cast<int64_t>(sent));
+    return sent;
+}
+
+size_t MelonDsDs::NetState::RecvPackets(std::span<NetFrame> frames) noexcept
+{
+    ZoneScopedN(TracyFunction);
+
+    size_t received = 0;
+    for (NetFrame& frame : frames)
+    {
+        retro_assert(frame.Buffer.size() >= MAX_FRAME_SIZE);
+        int length = RecvPacket(reinterpret_cast<u8*>(frame.Buffer.data()));
+        if (length <= 0)
+            break;
+
+        frame.Length = length;
+        received++;
+    }
+
+    TracyPlot("Wi-Fi Frames Received Per Batch", static_cast<int64_t>(received));
+    return received;
+}
+
+std::span<const MelonDsDs::AdapterOption> MelonDsDs::NetState::GetAdapterOptions() const noexcept
+{
 #ifdef HAVE_NETWORKING_DIRECT_MODE
-    if (_pcap)
+    return _adapterOptions;
+#else
+    return {};
+#endif
+}
+
+void MelonDsDs::NetState::LoadAdapterCache() noexcept
+{
+    ZoneScopedN(TracyFunction);
+
+#ifdef HAVE_NETWORKING_DIRECT_MODE
+    if (_adaptersEnumerated)
+        return; // We already have a fresher list than whatever's on disk
+
+    optional<string> path = retro::get_system_subdir_path(ADAPTER_CACHE_NAME);
+    if (!path || !path_is_valid(path->c_str()))
+        return;
+
+    void* buffer = nullptr;
+    int64_t size = 0;
+    if (!filestream_read_file(path->c_str(), &buffer, &size))
+    {
+        retro::warn("Failed to read the saved network adapter list at \"{}\"", *path);
+        return;
+    }
+
+    // One adapter per line, as "value\tlabel"
+    _adapterOptions.clear();
+    for (string_view contents(static_cast<const char*>(buffer), size); !contents.empty();)
     {
-        return _pcap->GetAdapters();
+        size_t end = std::min(contents.find('\n'), contents.size());
+        string_view line = contents.substr(0, end);
+        contents.remove_prefix(std::min(end + 1, contents.size()));
+
+        if (size_t tab = line.find('\t'); tab != 0 && tab != string_view::npos && _adapterOptions.size() < MAX_ADAPTER_OPTIONS)
+        {
+            _adapterOptions.push_back({ .Value = string(line.substr(0, tab)), .Label = string(line.substr(tab + 1)) });
+        }
     }
+    free(buffer);
+
+    retro::debug("Loaded {} network adapters from \"{}\"", _adapterOptions.size(), *path);
 #endif
+}
 
-    return {};
+void MelonDsDs::NetState::RefreshAdapters(AdaptersRefreshedFn onRefreshed) noexcept
+{
+    ZoneScopedN(TracyFunction);
+
+#ifdef HAVE_NETWORKING_DIRECT_MODE
+    _onAdaptersRefreshed = std::move(onRefreshed);
+    if (_adapterTaskId && retro::task::find(*_adapterTaskId))
+    { // If we're already enumerating adapters...
+        retro::debug("Network adapter enumeration is already underway");
+        return;
+    }
+
+    struct Enumeration
+    {
+        std::unique_ptr<retro::future<vector<AdapterData>>> Adapters;
+        bool OptionsChanged = false;
+    };
+
+    auto enumeration = std::make_shared<Enumeration>();
+    retro::task::TaskSpec enumerationTask(
+        [this, enumeration](retro::task::TaskHandle& task) noexcept {
+            if (!enumeration->Adapters)
+            { // Start on the task's first tick so that whoever queued it isn't held up
+                enumeration->Adapters = std::make_unique<retro::future<vector<AdapterData>>>(EnumerateAdapters);
+            }
+
+            if (!enumeration->Adapters->ready())
+                return;
+
+            try
+            {
+                enumeration->OptionsChanged = AdaptersEnumerated(enumeration->Adapters->get());
+            }
+            catch (const std::exception& e)
+            {
+                task.SetError(e.what());
+            }
+
+            task.Finish();
+        },
+        [this, enumeration](retro::task::TaskHandle& task, void*, string_view error) noexcept {
+            if (task.IsCancelled())
+                return; // The game is probably being unloaded
+
+            if (!error.empty())
+                retro::warn("Failed to enumerate network adapters: {}", error);
+
+            if (_onAdaptersRefreshed)
+                _onAdaptersRefreshed(enumeration->OptionsChanged);
+        },
+        [enumeration](retro::task::TaskHandle&) noexcept {
+            // Waits for the enumeration thread if the task was cancelled before it finished
+            enumeration->Adapters = nullptr;
+        },
+        retro::task::ASAP,
+        "NetworkAdapterEnumerationTask"
+    );
+
+    _adapterTaskId = retro::task::push(std::move(enumerationTask));
+#else
+    (void)onRefreshed;
+#endif
+}
+
+#ifdef HAVE_NETWORKING_DIRECT_MODE
+bool MelonDsDs::NetState::AdaptersEnumerated(vector<AdapterData>&& adapters) noexcept
+{
+    ZoneScopedN(TracyFunction);
+
+    vector<AdapterOption> options = MakeAdapterOptions(adapters);
+    bool changed = options != _adapterOptions;
+    _adapters = std::move(adapters);
+    _adapterOptions = std::move(options);
+    _adaptersEnumerated = true;
+
+    retro::info("Found {} usable network adapters", _adapterOptions.size());
+    if (changed)
+    {
+        SaveAdapterCache();
+    }
+
+    return changed;
 }
 
+void MelonDsDs::NetState::SaveAdapterCache() const noexcept
+{
+    ZoneScopedN(TracyFunction);
+
+    optional<string> path = retro::get_system_subdir_path(ADAPTER_CACHE_NAME);
+    if (!path)
+        return;
+
+    string contents;
+    for (const AdapterOption& option : _adapterOptions)
+    {
+        fmt::format_to(std::back_inserter(contents), "{}\t{}\n", option.Value, option.Label);
+    }
+
+    if (filestream_write_file(path->c_str(), contents.data(), contents.size()))
+    {
+        retro::debug("Saved {} network adapters to \"{}\"", _adapterOptions.size(), *path);
+    }
+    else
+    {
+        retro::warn("Failed to save the network adapter list to \"{}\"", *path);
+    }
+}
+#endif
+
 bool operator==(const melonDS::AdapterData& lhs, const melonDS::AdapterData& rhs)
 {
     return
@@ -154,6 +444,7 @@ bool operator==(const melonDS::AdapterData& lhs, const melonDS::AdapterData& rhs
 void MelonDsDs::NetState::Apply(const CoreConfig& config) noexcept
 {
     ZoneScopedN(TracyFunction);
+    MemoryScope memory(MemoryTag::Network);
 
     NetworkMode lastMode = GetNetworkMode();
 
@@ -165,13 +456,26 @@ void MelonDsDs::NetState::Apply(const CoreConfig& config) noexcept
         { // If a previous attempt to load libpcap failed...
             _pcap = melonDS::LibPCap::New(); // ...then try again.
             // (This can happen if the player installed it with RetroArch running in the background)
+
+            if (_pcap && !_adaptersEnumerated)
+            { // If the first enumeration failed because libpcap wasn't available...
+                RefreshAdapters(_onAdaptersRefreshed);
+            }
         }
 
         if (_pcap)
         {
-            auto adapters = _pcap->GetAdapters();
+            const AdapterData* adapter = nullptr;
+            if (_adaptersEnumerated)
+            {
+                adapter = SelectNetworkInterface(config.NetworkInterface(), _adapters);
+            }
+            else
+            { // Apply will be called again once enumeration finishes
+                retro::debug("Network adapters haven't been enumerated yet; using indirect mode until they are\n");
+            }
 
-            if (const AdapterData* adapter = SelectNetworkInterface(config.NetworkInterface(), adapters); adapter)
+            if (adapter)
             {
                 if (lastMode == NetworkMode::Direct && _adapter && *adapter == *_adapter)
                 { // If we were already using direct-mode, and with the same selected adapter...
@@ -184,10 +488,24 @@ void MelonDsDs::NetState::Apply(const CoreConfig& config) noexcept
                     return;
                 }
 
-                auto driver = _pcap->Open(*adapter, [this](const u8* data, int len)
+                auto receive = [this](const u8* data, int len)
                 {
                     _net.RXEnqueue(data, len);
-                });
+                };
+
+                std::unique_ptr<NetDriver> driver;
+#ifdef HAVE_THREADS
+                // Capture on a dedicated thread, so the emulated Wi-Fi chip never waits on libpcap
+                driver = ThreadedPCapDriver::Open(*_pcap, *adapter, receive);
+                if (!driver)
+                {
+                    retro::warn("Couldn't capture packets on a separate thread; capturing on the emulator's thread instead");
+                }
+#endif
+                if (!driver)
+                {
+                    driver = _pcap->Open(*adapter, receive);
+                }
 
                 if (driver)
                 {
@@ -222,10 +540,26 @@ void MelonDsDs::NetState::Apply(const CoreConfig& config) noexcept
         if (lastMode != NetworkMode::Indirect)
         {
             // If we're not already using indirect mode...
-            _net.SetDriver(std::make_unique<Net_Slirp>([this](const u8* data, int len)
+            auto receive = [this](const u8* data, int len)
             {
                 _net.RXEnqueue(data, len);
-            }));
+            };
+
+            std::unique_ptr<NetDriver> driver;
+#ifdef HAVE_THREADS
+            // Poll libslirp on a dedicated thread, so receiving a frame is just a dequeue
+            driver = ThreadedSlirpDriver::Open(receive);
+            if (!driver)
+            {
+                retro::warn("Couldn't poll libslirp on a separate thread; polling on the emulator's thread instead");
+            }
+#endif
+            if (!driver)
+            {
+                driver = std::make_unique<Net_Slirp>(receive);
+            }
+
+            _net.SetDriver(std::move(driver));
 
 #ifdef HAVE_NETWORKING_DIRECT_MODE
             _adapter = std::nullopt;
@@ -255,6 +589,13 @@ void MelonDsDs::NetState::Apply(const CoreConfig& config) noexcept
     {
         return NetworkMode::Direct;
     }
+
+#   ifdef HAVE_THREADS
+    if (dynamic_cast<const ThreadedPCapDriver*>(_net.GetDriver().get()))
+    {
+        return NetworkMode::Direct;
+    }
+#   endif
 #endif
 
     if (dynamic_cast<const Net_Slirp*>(_net.GetDriver().get()))
@@ -262,5 +603,12 @@ void MelonDsDs::NetState::Apply(const CoreConfig& config) noexcept
         return NetworkMode::Indirect;
     }
 
+#if defined(HAVE_NETWORKING) && defined(HAVE_THREADS)
+    if (dynamic_cast<const ThreadedSlirpDriver*>(_net.GetDriver().get()))
+    {
+        return NetworkMode::Indirect;
+    }
+#endif
+
     return NetworkMode::None;
 }
@@ -16,8 +16,12 @@
 
 #pragma once
 
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <optional>
+#include <string>
+#include <vector>
 
 #ifdef HAVE_NETWORKING_DIRECT_MODE
 #include <Net_PCap.h>
@@ -32,10 +36,36 @@ namespace melonDS
     class NetDriver;
 }
 
+#ifdef HAVE_NETWORKING
+struct GPoolArena;
+#endif
+
 namespace MelonDsDs
 {
     class CoreConfig;
 
+    /// A network adapter as presented in the Wi-Fi interface core option.
+    struct AdapterOption
+    {
+        /// The adapter's MAC address, formatted as the option's value.
+        std::string Value;
+        std::string Label;
+
+        bool operator==(const AdapterOption&) const = default;
+    };
+
+    /// One Ethernet frame in a batch.
+    /// The buffer is owned by whoever passes the batch in;
+    /// \c NetState reads from or writes into it directly, without copying it anywhere else.
+    struct NetFrame
+    {
+        std::span<std::byte> Buffer;
+
+        /// The number of bytes in \c Buffer that hold the frame.
+        /// Read by \c NetState::SendPackets, written by \c NetState::RecvPackets.
+        size_t Length = 0;
+    };
+
     class NetState
     {
     public:
@@ -46,16 +76,71 @@ namespace MelonDsDs
         NetState& operator=(const NetState&) = delete;
         NetState& operator=(NetState&&) = delete;
 
+        /// The largest frame that melonDS will write into a receive buffer.
+        /// Every buffer given to \c RecvPackets must be at least this big.
+        static constexpr size_t MAX_FRAME_SIZE = 2048;
+
+        /// Sends a single frame.
+        /// @return Whatever the network driver returned for it.
         int SendPacket(std::span<std::byte> data) noexcept;
+
+        /// Receives a single frame into \c data (which must hold at least \c MAX_FRAME_SIZE bytes).
+        /// @return Whatever the network driver returned for it (the frame's length if there was one).
         int RecvPacket(melonDS::u8* data) noexcept;
-        [[nodiscard]] std::vector<melonDS::AdapterData> GetAdapters() const noexcept;
+
+        /// Sends each frame in \c frames, in order, straight from the caller's buffers.
+        /// melonDS itself sends one frame at a time, so this is for callers that have several ready at once.
+        /// @return The number of frames that were sent.
+        /// Stops at the first frame that the driver fails to send.
+        size_t SendPackets(std::span<const NetFrame> frames) noexcept;
+
+        /// Fills the buffers in \c frames with received frames until
+        /// either the batch is full or there's nothing left to receive.
+        /// @return The number of frames that were received;
+        /// the \c Length of each of the first that many elements is updated.
+        size_t RecvPackets(std::span<NetFrame> frames) noexcept;
+
+        /// The adapters that can be selected in the core options.
+        /// Until this session's first enumeration finishes,
+        /// this is the list saved by the previous session (see \c LoadAdapterCache).
+        [[nodiscard]] std::span<const AdapterOption> GetAdapterOptions() const noexcept;
+
+        /// Called on the main thread when an adapter enumeration finishes.
+        /// The argument is \c true if the list from \c GetAdapterOptions changed.
+        using AdaptersRefreshedFn = std::function<void(bool optionsChanged)>;
+
+        /// Loads the adapter list saved by a previous session,
+        /// so the Wi-Fi interface option can be registered without waiting for libpcap.
+        /// Does nothing if adapters have already been enumerated.
+        void LoadAdapterCache() noexcept;
+
+        /// Enumerates the host's network adapters in the background,
+        /// then saves the new list for future sessions.
+        /// Does nothing if an enumeration is already underway.
+        void RefreshAdapters(AdaptersRefreshedFn onRefreshed) noexcept;
+
         void Apply(const CoreConfig& config) noexcept;
         [[nodiscard]] NetworkMode GetNetworkMode() const noexcept;
     private:
+#ifdef HAVE_NETWORKING
+        /// Backs every allocation that libslirp makes through the glib stub.
+        /// Freed in bulk by the destructor, once the network driver is gone.
+        GPoolArena* _slirpArena = nullptr;
+#endif
         melonDS::Net _net;
 #ifdef HAVE_NETWORKING_DIRECT_MODE
+        bool AdaptersEnumerated(std::vector<melonDS::AdapterData>&& adapters) noexcept;
+        void SaveAdapterCache() const noexcept;
+
         std::optional<melonDS::LibPCap> _pcap;
         std::optional<melonDS::AdapterData> _adapter;
+
+        /// The host's adapters as of the last enumeration; only meaningful if \c _adaptersEnumerated.
+        std::vector<melonDS::AdapterData> _adapters;
+        std::vector<AdapterOption> _adapterOptions;
+        bool _adaptersEnumerated = false;
+        std::optional<uint32_t> _adapterTaskId;
+        AdaptersRefreshedFn _onAdaptersRefreshed;
 #endif
     };
 }
@@ -0,0 +1,169 @@
+/*
+    Copyright 2024 Jesse Talavera
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include "pcapthread.hpp"
+
+#if defined(HAVE_NETWORKING_DIRECT_MODE) && defined(HAVE_THREADS)
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+#include <Net_PCap.h>
+#include <retro_timers.h>
+
+#include "environment.hpp"
+#include "tracy.hpp"
+
+using namespace melonDS;
+using std::chrono::steady_clock;
+
+// The shortest valid Ethernet frame (two MAC addresses and an EtherType).
+// Addressing is left to the emulated Wi-Fi chip, which filters by MAC itself.
+constexpr int MIN_FRAME_SIZE = 14;
+
+// How long the capture thread sleeps when libpcap has nothing for it.
+// (The driver puts the adapter in non-blocking mode, so we can't just wait on libpcap)
+constexpr int IDLE_SLEEP_MS = 1;
+
+MelonDsDs::ThreadedPCapDriver::ThreadedPCapDriver(ReceiveCallback receive) noexcept : _receive(std::move(receive)) {
+}
+
+std::unique_ptr<MelonDsDs::ThreadedPCapDriver> MelonDsDs::ThreadedPCapDriver::Open(
+    LibPCap& pcap,
+    const AdapterData& adapter,
+    ReceiveCallback receive
+) noexcept {
+    ZoneScopedN(TracyFunction);
+
+    // Not make_unique, since the constructor is private
+    std::unique_ptr<ThreadedPCapDriver> driver(new ThreadedPCapDriver(std::move(receive)));
+    ThreadedPCapDriver* self = driver.get();
+    driver->_driver = pcap.Open(adapter, [self](const u8* data, int len) {
+        self->Enqueue(data, len);
+    });
+
+    if (!driver->_driver) {
+        return nullptr;
+    }
+
+    driver->_running.store(true, std::memory_order_release);
+    driver->_thread = sthread_create(CaptureThread, self);
+    if (!driver->_thread) {
+        driver->_running.store(false, std::memory_order_release);
+        retro::warn("Failed to start the direct-mode packet capture thread");
+        return nullptr;
+    }
+
+    return driver;
+}
+
+MelonDsDs::ThreadedPCapDriver::~ThreadedPCapDriver() noexcept {
+    ZoneScopedN(TracyFunction);
+    if (_thread) {
+        _running.store(false, std::memory_order_release);
+        sthread_join(_thread);
+        _thread = nullptr;
+    }
+
+    PCapRxStats stats = Stats();
+    retro::info(
+        "Direct-mode capture: {} frames queued, {} dropped (queue full), {} filtered, queue depth up to {}, waited up to {}us",
+        stats.Captured,
+        stats.Dropped,
+        stats.Filtered,
+        stats.MaxDepth,
+        std::chrono::duration_cast<std::chrono::microseconds>(stats.MaxLatency).count()
+    );
+}
+
+int MelonDsDs::ThreadedPCapDriver::SendPacket(u8* data, int len) noexcept {
+    ZoneScopedN(TracyFunction);
+    // The capture thread may be inside pcap_dispatch on the same handle
+    std::lock_guard lock(_pcapLock);
+    return _driver->SendPacket(data, len);
+}
+
+void MelonDsDs::ThreadedPCapDriver::RecvCheck() noexcept {
+    ZoneScopedN(TracyFunction);
+    size_t head = _head.load(std::memory_order_relaxed);
+    size_t tail = _tail.load(std::memory_order_acquire);
+    _maxDepth = std::max(_maxDepth, tail - head);
+    TracyPlot("Direct-Mode RX Queue Depth", static_cast<int64_t>(tail - head));
+
+    steady_clock::time_point now = steady_clock::now();
+    while (head != tail) {
+        const Frame& frame = _frames[head % QUEUE_CAPACITY];
+        _maxLatency = std::max(_maxLatency, now - frame.Timestamp);
+        _receive(frame.Data.data(), frame.Length);
+
+        // Only give the slot back to the capture thread once we're done with it
+        _head.store(++head, std::memory_order_release);
+    }
+}
+
+MelonDsDs::PCapRxStats MelonDsDs::ThreadedPCapDriver::Stats() const noexcept {
+    return {
+        .Captured = _captured.load(std::memory_order_relaxed),
+        .Dropped = _dropped.load(std::memory_order_relaxed),
+        .Filtered = _filtered.load(std::memory_order_relaxed),
+        .MaxDepth = _maxDepth,
+        .MaxLatency = _maxLatency,
+    };
+}
+
+void MelonDsDs::ThreadedPCapDriver::Enqueue(const u8* data, int len) noexcept {
+    if (len < MIN_FRAME_SIZE || len > static_cast<int>(MAX_FRAME_SIZE)) {
+        _filtered.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail - _head.load(std::memory_order_acquire) >= QUEUE_CAPACITY) {
+        // If the emulator isn't keeping up, drop the newest frame (as a real NIC would)
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Frame& frame = _frames[tail % QUEUE_CAPACITY];
+    frame.Timestamp = steady_clock::now();
+    frame.Length = static_cast<uint16_t>(len);
+    memcpy(frame.Data.data(), data, len);
+    _tail.store(tail + 1, std::memory_order_release);
+    _captured.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MelonDsDs::ThreadedPCapDriver::CaptureThread(void* self) noexcept {
+    auto& driver = *static_cast<ThreadedPCapDriver*>(self);
+    auto frames = [&driver] {
+        // Every frame that libpcap gives us is counted exactly once by Enqueue
+        return driver._captured.load(std::memory_order_relaxed)
+            + driver._dropped.load(std::memory_order_relaxed)
+            + driver._filtered.load(std::memory_order_relaxed);
+    };
+
+    while (driver._running.load(std::memory_order_acquire)) {
+        uint64_t before = frames();
+        {
+            std::lock_guard lock(driver._pcapLock);
+            driver._driver->RecvCheck(); // Handles at most one frame per call
+        }
+        if (frames() == before) {
+            // If there was nothing to capture, give the adapter some time
+            retro_sleep(IDLE_SLEEP_MS);
+        }
+    }
+}
+#endif
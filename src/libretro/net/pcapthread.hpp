@@ -0,0 +1,122 @@
+/*
+    Copyright 2024 Jesse Talavera
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#pragma once
+
+#if defined(HAVE_NETWORKING_DIRECT_MODE) && defined(HAVE_THREADS)
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include <NetDriver.h>
+#include <rthreads/rthreads.h>
+
+#include "retro/threads.hpp"
+
+namespace melonDS {
+    class LibPCap;
+    class Net_PCap;
+    struct AdapterData;
+}
+
+namespace MelonDsDs {
+    struct PCapRxStats {
+        uint64_t Captured = 0;
+
+        /// Frames dropped because the emulator wasn't dequeuing them fast enough.
+        uint64_t Dropped = 0;
+
+        /// Frames dropped because they were too short or too long to be Ethernet frames.
+        uint64_t Filtered = 0;
+        size_t MaxDepth = 0;
+
+        /// The longest a frame waited in the queue before the emulator took it.
+        std::chrono::steady_clock::duration MaxLatency {};
+    };
+
+    /// Wraps libpcap's driver so that frames are captured on a dedicated thread,
+    /// and the emulated Wi-Fi chip only has to dequeue them.
+    ///
+    /// A pcap handle isn't safe to use from two threads at once,
+    /// so sending and capturing are both done with \c _pcapLock held.
+    class ThreadedPCapDriver final : public melonDS::NetDriver {
+    public:
+        /// The largest frame we'll queue; anything bigger isn't a standard Ethernet frame.
+        static constexpr size_t MAX_FRAME_SIZE = 2048;
+
+        /// Enough for a few frames' worth of bursty traffic.
+        static constexpr size_t QUEUE_CAPACITY = 128;
+
+        using ReceiveCallback = std::function<void(const melonDS::u8* data, int len)>;
+
+        /// Opens \c adapter and starts capturing from it.
+        /// \param receive Called from \c RecvCheck (on the emulator's thread) for each captured frame.
+        /// \returns \c nullptr if the adapter couldn't be opened or the thread couldn't be started.
+        static std::unique_ptr<ThreadedPCapDriver> Open(
+            melonDS::LibPCap& pcap,
+            const melonDS::AdapterData& adapter,
+            ReceiveCallback receive
+        ) noexcept;
+
+        ~ThreadedPCapDriver() noexcept override;
+        ThreadedPCapDriver(const ThreadedPCapDriver&) = delete;
+        ThreadedPCapDriver& operator=(const ThreadedPCapDriver&) = delete;
+
+        int SendPacket(melonDS::u8* data, int len) noexcept override;
+
+        /// Hands every queued frame to the receive callback. Never blocks.
+        void RecvCheck() noexcept override;
+
+        [[nodiscard]] PCapRxStats Stats() const noexcept;
+    private:
+        ThreadedPCapDriver(ReceiveCallback receive) noexcept;
+        static void CaptureThread(void* self) noexcept;
+
+        /// Called on the capture thread for each frame that libpcap gives us.
+        void Enqueue(const melonDS::u8* data, int len) noexcept;
+
+        struct Frame {
+            std::chrono::steady_clock::time_point Timestamp;
+            uint16_t Length;
+            std::array<uint8_t, MAX_FRAME_SIZE> Data;
+        };
+
+        std::unique_ptr<melonDS::Net_PCap> _driver;
+        retro::slock _pcapLock;
+        ReceiveCallback _receive;
+        sthread_t* _thread = nullptr;
+        std::atomic_bool _running = false;
+
+        // A single-producer, single-consumer ring; the capture thread only writes _tail,
+        // and the emulator's thread only writes _head. Both count up forever.
+        std::array<Frame, QUEUE_CAPACITY> _frames;
+        std::atomic<size_t> _head = 0;
+        std::atomic<size_t> _tail = 0;
+
+        // Written by the capture thread
+        std::atomic<uint64_t> _captured = 0;
+        std::atomic<uint64_t> _dropped = 0;
+        std::atomic<uint64_t> _filtered = 0;
+
+        // Written by the emulator's thread
+        size_t _maxDepth = 0;
+        std::chrono::steady_clock::duration _maxLatency {};
+    };
+}
+#endif
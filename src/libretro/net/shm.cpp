@@ -0,0 +1,330 @@
+/*
+    Copyright 2024 Jesse Talavera
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include "shm.hpp"
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <optional>
+#include <thread>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <retro_assert.h>
+
+#include "environment.hpp"
+#include "mp.hpp"
+#include "tracy.hpp"
+
+using namespace MelonDsDs;
+
+namespace MelonDsDs {
+    // Change the last byte whenever the layout of ShmSegment changes
+    constexpr uint32_t SHM_MAGIC = 0x4d445301;
+    constexpr const char* SHM_NAME = "/melondsds-mp";
+
+    // Enough for each of the other instances to have a packet or two in flight
+    constexpr uint32_t RING_SLOTS = 32;
+
+    // If another sender holds a ring's lock for longer than this, it probably died mid-write
+    constexpr std::chrono::milliseconds WRITE_LOCK_TIMEOUT {1};
+
+    struct ShmSlot {
+        uint32_t Length;
+        uint16_t Sender;
+        std::array<uint8_t, Packet::MAX_WIRE_SIZE> Data;
+    };
+
+    // Any instance can write to a ring, but only its owner reads from it
+    struct ShmRing {
+        std::atomic<uint32_t> WriteLock;
+
+        // Free-running counters; the ring holds Tail - Head packets
+        std::atomic<uint32_t> Head; // Only written by the ring's owner
+        std::atomic<uint32_t> Tail; // Only written while holding WriteLock
+
+        // The futex word that the owner sleeps on; incremented after every write
+        std::atomic<uint32_t> Signal;
+        std::atomic<uint32_t> Waiting;
+        std::atomic<uint32_t> Dropped;
+        std::array<ShmSlot, RING_SLOTS> Slots;
+    };
+
+    // A newly-created segment is zero-filled, which is a valid empty state for everything in here
+    // (so there's no separate initialization step for instances to race on)
+    struct ShmSegment {
+        std::atomic<uint32_t> Magic;
+        std::atomic<uint32_t> Instances; // One bit per claimed slot
+        std::array<std::atomic<int32_t>, ShmTransport::MAX_INSTANCES> Pids;
+        std::array<ShmRing, ShmTransport::MAX_INSTANCES> Rings;
+    };
+
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "Atomics shared between processes must be lock-free");
+    static_assert(std::atomic<int32_t>::is_always_lock_free, "Atomics shared between processes must be lock-free");
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "Futex words must be plain 32-bit integers");
+    static_assert(ShmTransport::MAX_INSTANCES <= 32, "Instances must fit in a 32-bit mask");
+
+    static ShmTransport* _active = nullptr;
+
+    static void FutexWait(std::atomic<uint32_t>& word, uint32_t expected, std::chrono::microseconds timeout) noexcept;
+    static void FutexWake(std::atomic<uint32_t>& word) noexcept;
+    static bool IsProcessAlive(int32_t pid) noexcept;
+    static std::optional<uint16_t> ClaimSlot(ShmSegment& segment) noexcept;
+    static bool Push(ShmRing& ring, const void* buf, size_t len, uint16_t sender) noexcept;
+}
+
+static void MelonDsDs::FutexWait(std::atomic<uint32_t>& word, uint32_t expected, std::chrono::microseconds timeout) noexcept {
+    timespec ts {
+        .tv_sec = static_cast<time_t>(timeout.count() / 1000000),
+        .tv_nsec = static_cast<long>((timeout.count() % 1000000) * 1000),
+    };
+
+    // Not FUTEX_WAIT_PRIVATE, since the word is shared with other processes
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+}
+
+static void MelonDsDs::FutexWake(std::atomic<uint32_t>& word) noexcept {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+static bool MelonDsDs::IsProcessAlive(int32_t pid) noexcept {
+    // EPERM means the process exists, but belongs to someone else
+    return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+static std::optional<uint16_t> MelonDsDs::ClaimSlot(ShmSegment& segment) noexcept {
+    // First take back any slots held by instances that exited without closing their transport
+    uint32_t instances = segment.Instances.load();
+    for (uint16_t i = 0; i < ShmTransport::MAX_INSTANCES; i++) {
+        int32_t pid = segment.Pids[i].load();
+        if ((instances & (1u << i)) && pid != 0 && !IsProcessAlive(pid)) {
+            // (A claimed slot with a pid of 0 is still being set up by its new owner)
+            retro::info("Reclaiming local multiplayer instance {} from exited process {}", i, pid);
+            if (segment.Pids[i].compare_exchange_strong(pid, 0)) {
+                segment.Instances.fetch_and(~(1u << i));
+            }
+        }
+    }
+
+    instances = segment.Instances.load();
+    for (uint16_t i = 0; i < ShmTransport::MAX_INSTANCES; i++) {
+        uint32_t bit = 1u << i;
+        while (!(instances & bit)) {
+            // compare_exchange_weak reloads instances if another instance got there first
+            if (segment.Instances.compare_exchange_weak(instances, instances | bit)) {
+                ShmRing& ring = segment.Rings[i];
+
+                // Forget whatever the slot's last owner didn't get to
+                ring.Head.store(ring.Tail.load());
+                ring.WriteLock.store(0);
+                segment.Pids[i].store(getpid());
+                return i;
+            }
+        }
+    }
+
+    return std::nullopt;
+}
+
+static bool MelonDsDs::Push(ShmRing& ring, const void* buf, size_t len, uint16_t sender) noexcept {
+    using clock = std::chrono::steady_clock;
+    clock::time_point deadline = clock::now() + WRITE_LOCK_TIMEOUT;
+    while (ring.WriteLock.exchange(1, std::memory_order_acquire) != 0) {
+        if (clock::now() >= deadline) {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+
+    uint32_t tail = ring.Tail.load(std::memory_order_relaxed);
+    bool full = tail - ring.Head.load(std::memory_order_acquire) >= RING_SLOTS;
+    if (!full) {
+        ShmSlot& slot = ring.Slots[tail % RING_SLOTS];
+        slot.Length = static_cast<uint32_t>(len);
+        slot.Sender = sender;
+        memcpy(slot.Data.data(), buf, len);
+        ring.Tail.store(tail + 1, std::memory_order_release);
+    }
+    ring.WriteLock.store(0, std::memory_order_release);
+
+    if (full) {
+        return false;
+    }
+
+    // Bump the futex word after publishing the packet, so a sleeping owner can't miss it
+    ring.Signal.fetch_add(1);
+    if (ring.Waiting.load() > 0) {
+        FutexWake(ring.Signal);
+    }
+    return true;
+}
+
+MelonDsDs::ShmTransport::~ShmTransport() noexcept {
+    Close();
+}
+
+bool MelonDsDs::ShmTransport::Open(retro_netpacket_receive_t receive) noexcept {
+    ZoneScopedN(TracyFunction);
+    retro_assert(receive != nullptr);
+    if (_segment) {
+        return true;
+    }
+
+    if (_active) {
+        retro::error("Another shared-memory local multiplayer transport is already open");
+        return false;
+    }
+
+    int fd = shm_open(SHM_NAME, O_RDWR | O_CREAT, 0600);
+    if (fd < 0) {
+        retro::error("Failed to open shared memory segment {}: {}", SHM_NAME, strerror(errno));
+        return false;
+    }
+
+    struct stat st {};
+    if (fstat(fd, &st) < 0 || (st.st_size == 0 && ftruncate(fd, sizeof(ShmSegment)) < 0)) {
+        // If this is the first instance, then it's up to us to size the segment
+        retro::error("Failed to size shared memory segment {}: {}", SHM_NAME, strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    if (st.st_size != 0 && static_cast<size_t>(st.st_size) != sizeof(ShmSegment)) {
+        retro::error("Shared memory segment {} was created by an incompatible version of melonDS DS", SHM_NAME);
+        close(fd);
+        return false;
+    }
+
+    void* memory = mmap(nullptr, sizeof(ShmSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps the segment open
+    if (memory == MAP_FAILED) {
+        retro::error("Failed to map shared memory segment {}: {}", SHM_NAME, strerror(errno));
+        return false;
+    }
+
+    auto* segment = static_cast<ShmSegment*>(memory);
+    uint32_t magic = 0;
+    if (!segment->Magic.compare_exchange_strong(magic, SHM_MAGIC) && magic != SHM_MAGIC) {
+        // If the segment was already set up, but not by a compatible version...
+        retro::error("Shared memory segment {} was created by an incompatible version of melonDS DS", SHM_NAME);
+        munmap(memory, sizeof(ShmSegment));
+        return false;
+    }
+
+    std::optional<uint16_t> slot = ClaimSlot(*segment);
+    if (!slot) {
+        retro::error("All {} shared-memory local multiplayer slots are taken", MAX_INSTANCES);
+        munmap(memory, sizeof(ShmSegment));
+        return false;
+    }
+
+    _segment = segment;
+    _slot = *slot;
+    _receive = receive;
+    _active = this;
+    retro::info("Joined the shared-memory local multiplayer session as instance {}", _slot);
+    return true;
+}
+
+void MelonDsDs::ShmTransport::Close() noexcept {
+    ZoneScopedN(TracyFunction);
+    if (!_segment) {
+        return;
+    }
+
+    uint32_t dropped = _segment->Rings[_slot].Dropped.exchange(0);
+    _segment->Pids[_slot].store(0);
+    _segment->Instances.fetch_and(~(1u << _slot));
+
+    // The segment itself isn't unlinked, since another instance might be about to join it;
+    // it's only a couple of megabytes, and the OS frees it at shutdown
+    munmap(_segment, sizeof(ShmSegment));
+    _segment = nullptr;
+    _receive = nullptr;
+    if (_active == this) {
+        _active = nullptr;
+    }
+    retro::info("Left the shared-memory local multiplayer session ({} packets for this instance were dropped)", dropped);
+}
+
+void MelonDsDs::ShmTransport::Send(int, const void* buf, size_t len, uint16_t client_id) {
+    ZoneScopedN(TracyFunction);
+    if (!_active || !buf || len == 0) {
+        // If this is just a flush hint, there's nothing to do
+        return;
+    }
+
+    if (len > Packet::MAX_WIRE_SIZE) {
+        retro::warn("Dropping outgoing packet of {} bytes (the limit is {})", len, Packet::MAX_WIRE_SIZE);
+        return;
+    }
+
+    ShmSegment& segment = *_active->_segment;
+    uint16_t self = _active->_slot;
+    uint32_t instances = segment.Instances.load();
+    for (uint16_t i = 0; i < MAX_INSTANCES; i++) {
+        bool addressed = client_id == RETRO_NETPACKET_BROADCAST ? i != self : i == client_id;
+        if (addressed && (instances & (1u << i)) && !Push(segment.Rings[i], buf, len, self)) {
+            segment.Rings[i].Dropped.fetch_add(1);
+            retro::debug("Dropped a {}-byte packet for instance {}, which isn't keeping up", len, i);
+        }
+    }
+}
+
+void MelonDsDs::ShmTransport::Poll() {
+    ZoneScopedN(TracyFunction);
+    if (!_active) {
+        return;
+    }
+
+    ShmRing& ring = _active->_segment->Rings[_active->_slot];
+    uint32_t head = ring.Head.load(std::memory_order_relaxed);
+    uint32_t tail = ring.Tail.load(std::memory_order_acquire);
+    while (head != tail) {
+        const ShmSlot& slot = ring.Slots[head % RING_SLOTS];
+        _active->_receive(slot.Data.data(), slot.Length, slot.Sender);
+
+        // Only release the slot once we're done reading it
+        ring.Head.store(++head, std::memory_order_release);
+    }
+}
+
+void MelonDsDs::ShmTransport::Wait(std::chrono::microseconds timeout) noexcept {
+    ZoneScopedN(TracyFunction);
+    if (!_active || timeout.count() <= 0) {
+        return;
+    }
+
+    ShmRing& ring = _active->_segment->Rings[_active->_slot];
+    ring.Waiting.fetch_add(1);
+    uint32_t seen = ring.Signal.load();
+    if (ring.Head.load() == ring.Tail.load()) {
+        // If nothing has arrived since we last polled, sleep until a sender bumps the futex word
+        // (if one already has since we read it, this returns immediately)
+        FutexWait(ring.Signal, seen, timeout);
+    }
+    ring.Waiting.fetch_sub(1);
+}
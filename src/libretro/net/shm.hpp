@@ -0,0 +1,70 @@
+/*
+    Copyright 2024 Jesse Talavera
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <libretro.h>
+
+namespace MelonDsDs {
+    struct ShmSegment;
+
+    /// A local wireless transport for several instances of the core on the same machine.
+    /// Each instance has its own ring of packets in a shared memory segment,
+    /// and sleeps on a futex while waiting for other instances to write to it.
+    /// Packets are opaque here; \c MpState frames them the same way as with the frontend's netpacket interface.
+    class ShmTransport {
+    public:
+        /// The most instances that can join a session at once.
+        static constexpr uint16_t MAX_INSTANCES = 16;
+
+        ShmTransport() noexcept = default;
+        ~ShmTransport() noexcept;
+        ShmTransport(const ShmTransport&) = delete;
+        ShmTransport& operator=(const ShmTransport&) = delete;
+
+        /// Maps the shared segment (creating it if this is the first instance) and claims a slot in it.
+        /// Only one transport can be open per process.
+        /// \param receive Called by \c Poll for each packet addressed to this instance.
+        /// \returns \c false if the segment couldn't be opened or every slot is taken.
+        [[nodiscard]] bool Open(retro_netpacket_receive_t receive) noexcept;
+
+        /// Gives up this instance's slot and unmaps the segment.
+        void Close() noexcept;
+        [[nodiscard]] bool IsOpen() const noexcept { return _segment != nullptr; }
+
+        /// This instance's slot, which other instances use as its client ID.
+        [[nodiscard]] uint16_t InstanceId() const noexcept { return _slot; }
+
+        // These match libretro's netpacket interface, so MpState can use this transport in place of the frontend's.
+        // They act on whichever transport is open.
+
+        /// Writes \c buf into the ring of the given instance (or every other instance, if \c client_id is
+        /// \c RETRO_NETPACKET_BROADCAST). Flush hints are ignored, since nothing is buffered.
+        static void Send(int flags, const void* buf, size_t len, uint16_t client_id);
+
+        /// Delivers every packet waiting in this instance's ring.
+        static void Poll();
+
+        /// Sleeps until another instance writes to this instance's ring or \c timeout passes.
+        static void Wait(std::chrono::microseconds timeout) noexcept;
+    private:
+        ShmSegment* _segment = nullptr;
+        uint16_t _slot = 0;
+        retro_netpacket_receive_t _receive = nullptr;
+    };
+}
@@ -0,0 +1,150 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include "slirpthread.hpp"
+
+#if defined(HAVE_NETWORKING) && defined(HAVE_THREADS)
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+#include <Net_Slirp.h>
+#include <retro_timers.h>
+
+#include "environment.hpp"
+#include "tracy.hpp"
+
+using namespace melonDS;
+using std::chrono::steady_clock;
+
+MelonDsDs::ThreadedSlirpDriver::ThreadedSlirpDriver(ReceiveCallback receive) noexcept : _receive(std::move(receive)) {
+}
+
+std::unique_ptr<MelonDsDs::ThreadedSlirpDriver> MelonDsDs::ThreadedSlirpDriver::Open(ReceiveCallback receive) noexcept {
+    ZoneScopedN(TracyFunction);
+
+    // Not make_unique, since the constructor is private
+    std::unique_ptr<ThreadedSlirpDriver> driver(new ThreadedSlirpDriver(std::move(receive)));
+    ThreadedSlirpDriver* self = driver.get();
+    driver->_driver = std::make_unique<Net_Slirp>([self](const u8* data, int len) {
+        self->Enqueue(data, len);
+    });
+
+    driver->_running.store(true, std::memory_order_release);
+    driver->_thread = sthread_create(PollThread, self);
+    if (!driver->_thread) {
+        driver->_running.store(false, std::memory_order_release);
+        retro::warn("Failed to start the indirect-mode poll thread");
+        return nullptr;
+    }
+
+    return driver;
+}
+
+MelonDsDs::ThreadedSlirpDriver::~ThreadedSlirpDriver() noexcept {
+    ZoneScopedN(TracyFunction);
+    if (_thread) {
+        _running.store(false, std::memory_order_release);
+        sthread_join(_thread);
+        _thread = nullptr;
+    }
+
+    SlirpRxStats stats = Stats();
+    retro::info(
+        "Indirect-mode polling: {} polls, {} frames queued, {} dropped (queue full), queue depth up to {}, waited up to {}us",
+        stats.Polls,
+        stats.Received,
+        stats.Dropped,
+        stats.MaxDepth,
+        std::chrono::duration_cast<std::chrono::microseconds>(stats.MaxLatency).count()
+    );
+}
+
+int MelonDsDs::ThreadedSlirpDriver::SendPacket(u8* data, int len) noexcept {
+    ZoneScopedN(TracyFunction);
+    // libslirp may answer some frames (e.g. ARP or DHCP) right away, so Enqueue can run on this thread too
+    std::lock_guard lock(_slirpLock);
+    return _driver->SendPacket(data, len);
+}
+
+void MelonDsDs::ThreadedSlirpDriver::RecvCheck() noexcept {
+    ZoneScopedN(TracyFunction);
+    size_t head = _head.load(std::memory_order_relaxed);
+    size_t tail = _tail.load(std::memory_order_acquire);
+    _maxDepth = std::max(_maxDepth, tail - head);
+    TracyPlot("Indirect-Mode RX Queue Depth", static_cast<int64_t>(tail - head));
+
+    steady_clock::time_point now = steady_clock::now();
+    while (head != tail) {
+        const Frame& frame = _frames[head % QUEUE_CAPACITY];
+        _maxLatency = std::max(_maxLatency, now - frame.Timestamp);
+        _receive(frame.Data.data(), frame.Length);
+
+        // Only give the slot back to the producers once we're done with it
+        _head.store(++head, std::memory_order_release);
+    }
+}
+
+MelonDsDs::SlirpRxStats MelonDsDs::ThreadedSlirpDriver::Stats() const noexcept {
+    return {
+        .Received = _received.load(std::memory_order_relaxed),
+        .Dropped = _dropped.load(std::memory_order_relaxed),
+        .Polls = _polls.load(std::memory_order_relaxed),
+        .MaxDepth = _maxDepth,
+        .MaxLatency = _maxLatency,
+    };
+}
+
+void MelonDsDs::ThreadedSlirpDriver::Enqueue(const u8* data, int len) noexcept {
+    if (len <= 0 || len > static_cast<int>(MAX_FRAME_SIZE)) {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail - _head.load(std::memory_order_acquire) >= QUEUE_CAPACITY) {
+        // If the emulator isn't keeping up, drop the newest frame (TCP will retransmit it)
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Frame& frame = _frames[tail % QUEUE_CAPACITY];
+    frame.Timestamp = steady_clock::now();
+    frame.Length = static_cast<uint16_t>(len);
+    memcpy(frame.Data.data(), data, len);
+    _tail.store(tail + 1, std::memory_order_release);
+    _received.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MelonDsDs::ThreadedSlirpDriver::PollThread(void* self) noexcept {
+    auto& driver = *static_cast<ThreadedSlirpDriver*>(self);
+
+    while (driver._running.load(std::memory_order_acquire)) {
+        uint64_t before = driver._received.load(std::memory_order_relaxed);
+        {
+            ZoneScopedN("MelonDsDs::ThreadedSlirpDriver::PollThread::poll");
+            std::lock_guard lock(driver._slirpLock);
+            driver._driver->RecvCheck(); // Polls libslirp's sockets without blocking and runs its timers
+            driver._polls.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (driver._received.load(std::memory_order_relaxed) == before) {
+            // If nothing came in, wait a bit before polling again; otherwise, keep draining the sockets
+            retro_sleep(POLL_INTERVAL.count());
+        }
+    }
+}
+#endif
@@ -0,0 +1,120 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#pragma once
+
+#if defined(HAVE_NETWORKING) && defined(HAVE_THREADS)
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include <NetDriver.h>
+#include <rthreads/rthreads.h>
+
+#include "retro/threads.hpp"
+
+namespace melonDS {
+    class Net_Slirp;
+}
+
+namespace MelonDsDs {
+    struct SlirpRxStats {
+        uint64_t Received = 0;
+
+        /// Frames dropped because the emulator wasn't dequeuing them fast enough.
+        uint64_t Dropped = 0;
+
+        /// Times the poll thread drove libslirp's sockets and timers.
+        uint64_t Polls = 0;
+        size_t MaxDepth = 0;
+
+        /// The longest a frame waited in the queue before the emulator took it.
+        std::chrono::steady_clock::duration MaxLatency {};
+    };
+
+    /// Wraps libslirp's driver so that its sockets and timers are polled on a dedicated thread
+    /// at a fixed rate, instead of every time the emulated Wi-Fi chip checks for a frame.
+    /// The emulator's thread only has to dequeue the frames that the poll thread produced.
+    ///
+    /// libslirp (and the glib stub's allocator) isn't thread-safe,
+    /// so every call into it is made with \c _slirpLock held.
+    class ThreadedSlirpDriver final : public melonDS::NetDriver {
+    public:
+        /// The largest frame we'll queue; libslirp's MTU is well below this.
+        static constexpr size_t MAX_FRAME_SIZE = 2048;
+
+        /// Enough for a few frames' worth of bursty traffic.
+        static constexpr size_t QUEUE_CAPACITY = 128;
+
+        /// How long the poll thread waits between polls when libslirp had nothing for it.
+        static constexpr std::chrono::milliseconds POLL_INTERVAL {1};
+
+        using ReceiveCallback = std::function<void(const melonDS::u8* data, int len)>;
+
+        /// Starts libslirp and its poll thread.
+        /// \param receive Called from \c RecvCheck (on the emulator's thread) for each received frame.
+        /// \returns \c nullptr if the thread couldn't be started.
+        static std::unique_ptr<ThreadedSlirpDriver> Open(ReceiveCallback receive) noexcept;
+
+        ~ThreadedSlirpDriver() noexcept override;
+        ThreadedSlirpDriver(const ThreadedSlirpDriver&) = delete;
+        ThreadedSlirpDriver& operator=(const ThreadedSlirpDriver&) = delete;
+
+        int SendPacket(melonDS::u8* data, int len) noexcept override;
+
+        /// Hands every queued frame to the receive callback. Never touches libslirp.
+        void RecvCheck() noexcept override;
+
+        [[nodiscard]] SlirpRxStats Stats() const noexcept;
+    private:
+        ThreadedSlirpDriver(ReceiveCallback receive) noexcept;
+        static void PollThread(void* self) noexcept;
+
+        /// Called with \c _slirpLock held (on either thread) for each frame that libslirp produces.
+        void Enqueue(const melonDS::u8* data, int len) noexcept;
+
+        struct Frame {
+            std::chrono::steady_clock::time_point Timestamp;
+            uint16_t Length;
+            std::array<uint8_t, MAX_FRAME_SIZE> Data;
+        };
+
+        std::unique_ptr<melonDS::Net_Slirp> _driver;
+        retro::slock _slirpLock;
+        ReceiveCallback _receive;
+        sthread_t* _thread = nullptr;
+        std::atomic_bool _running = false;
+
+        // A single-consumer ring; producers only write _tail while holding _slirpLock,
+        // and the emulator's thread only writes _head. Both count up forever.
+        std::array<Frame, QUEUE_CAPACITY> _frames;
+        std::atomic<size_t> _head = 0;
+        std::atomic<size_t> _tail = 0;
+
+        // Written with _slirpLock held
+        std::atomic<uint64_t> _received = 0;
+        std::atomic<uint64_t> _dropped = 0;
+        std::atomic<uint64_t> _polls = 0;
+
+        // Written by the emulator's thread
+        size_t _maxDepth = 0;
+        std::chrono::steady_clock::duration _maxLatency {};
+    };
+}
+#endif
@@ -0,0 +1,574 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "pixels.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "cpu.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define MELONDSDS_PIXELS_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define MELONDSDS_PIXELS_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(MELONDSDS_PIXELS_X86) && (defined(__GNUC__) || defined(__clang__))
+#define MELONDSDS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define MELONDSDS_TARGET_AVX2
+#endif
+
+using namespace MelonDsDs::pixels;
+namespace cpu = MelonDsDs::cpu;
+
+namespace {
+    constexpr uint32_t COLOR_MASK = 0x00FFFFFF;
+    constexpr uint32_t ALPHA_MASK = 0xFF000000;
+    constexpr uint32_t GREEN_ALPHA_MASK = 0xFF00FF00;
+    constexpr uint32_t RED_BLUE_MASK = 0x00FF00FF;
+
+    // The scalar kernels also handle whatever's left over after the vectorized loops
+
+    void FillScalar(uint32_t* dest, size_t count, uint32_t value) noexcept {
+        for (size_t i = 0; i < count; i++) {
+            dest[i] = value;
+        }
+    }
+
+    void InvertScalar(uint32_t* dest, size_t count) noexcept {
+        for (size_t i = 0; i < count; i++) {
+            dest[i] = (dest[i] ^ COLOR_MASK) | ALPHA_MASK;
+        }
+    }
+
+    void SwapRedBlueScalar(uint32_t* dest, const uint32_t* src, size_t count) noexcept {
+        for (size_t i = 0; i < count; i++) {
+            uint32_t pixel = src[i];
+            uint32_t redBlue = pixel & RED_BLUE_MASK;
+            dest[i] = (pixel & GREEN_ALPHA_MASK) | (redBlue << 16) | (redBlue >> 16);
+        }
+    }
+
+    constexpr uint32_t ToRgb565(uint32_t pixel) noexcept {
+        return ((pixel >> 8) & 0xF800) | ((pixel >> 5) & 0x07E0) | ((pixel >> 3) & 0x001F);
+    }
+
+    void ConvertToRgb565Scalar(uint16_t* dest, const uint32_t* src, size_t count) noexcept {
+        for (size_t i = 0; i < count; i++) {
+            dest[i] = static_cast<uint16_t>(ToRgb565(src[i]));
+        }
+    }
+
+    // BT.601 limited range in 8-bit fixed point, as most hardware video encoders expect
+    constexpr uint8_t ToLuma(uint32_t pixel) noexcept {
+        int r = (pixel >> 16) & 0xFF, g = (pixel >> 8) & 0xFF, b = pixel & 0xFF;
+        return static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+    }
+
+    // Takes the sum of each channel over a 2x2 block
+    constexpr void ToChroma(uint8_t* chroma, int r, int g, int b) noexcept {
+        r = (r + 2) >> 2;
+        g = (g + 2) >> 2;
+        b = (b + 2) >> 2;
+        chroma[0] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+        chroma[1] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+    }
+
+    void ConvertToNv12Scalar(uint8_t* lumaTop, uint8_t* lumaBottom, uint8_t* chroma, const uint32_t* srcTop, const uint32_t* srcBottom, size_t count) noexcept {
+        for (size_t i = 0; i < count; i += 2) {
+            // An odd last column shares its chroma with nothing, so it stands in for its missing neighbor
+            size_t right = i + 1 < count ? i + 1 : i;
+            uint32_t pixels[4] { srcTop[i], srcTop[right], srcBottom[i], srcBottom[right] };
+            int r = 0, g = 0, b = 0;
+            for (uint32_t pixel : pixels) {
+                r += (pixel >> 16) & 0xFF;
+                g += (pixel >> 8) & 0xFF;
+                b += pixel & 0xFF;
+            }
+
+            lumaTop[i] = ToLuma(pixels[0]);
+            lumaBottom[i] = ToLuma(pixels[2]);
+            if (right != i) {
+                lumaTop[right] = ToLuma(pixels[1]);
+                lumaBottom[right] = ToLuma(pixels[3]);
+            }
+            ToChroma(chroma + i, r, g, b);
+        }
+    }
+
+    void Transpose4x4Scalar(uint32_t* dest, ptrdiff_t destPitch, const uint32_t* src, ptrdiff_t srcPitch) noexcept {
+        for (ptrdiff_t y = 0; y < 4; y++) {
+            for (ptrdiff_t x = 0; x < 4; x++) {
+                dest[x * destPitch + y] = src[y * srcPitch + x];
+            }
+        }
+    }
+
+#ifdef MELONDSDS_PIXELS_X86
+    inline __m128i ToRgb565Sse2(__m128i pixels) noexcept {
+        __m128i red = _mm_and_si128(_mm_srli_epi32(pixels, 8), _mm_set1_epi32(0xF800));
+        __m128i green = _mm_and_si128(_mm_srli_epi32(pixels, 5), _mm_set1_epi32(0x07E0));
+        __m128i blue = _mm_and_si128(_mm_srli_epi32(pixels, 3), _mm_set1_epi32(0x001F));
+        __m128i packed = _mm_or_si128(_mm_or_si128(red, green), blue);
+
+        // SSE2 can only narrow with signed saturation,
+        // so sign-extend the 16-bit results first to keep them intact
+        return _mm_srai_epi32(_mm_slli_epi32(packed, 16), 16);
+    }
+
+    void FillSse2(uint32_t* dest, size_t count, uint32_t value) noexcept {
+        __m128i fill = _mm_set1_epi32(static_cast<int>(value));
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), fill);
+        }
+        FillScalar(dest + i, count - i, value);
+    }
+
+    void InvertSse2(uint32_t* dest, size_t count) noexcept {
+        const __m128i color = _mm_set1_epi32(static_cast<int>(COLOR_MASK));
+        const __m128i alpha = _mm_set1_epi32(static_cast<int>(ALPHA_MASK));
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128i* p = reinterpret_cast<__m128i*>(dest + i);
+            __m128i pixels = _mm_loadu_si128(p);
+            _mm_storeu_si128(p, _mm_or_si128(_mm_xor_si128(pixels, color), alpha));
+        }
+        InvertScalar(dest + i, count - i);
+    }
+
+    void SwapRedBlueSse2(uint32_t* dest, const uint32_t* src, size_t count) noexcept {
+        const __m128i greenAlpha = _mm_set1_epi32(static_cast<int>(GREEN_ALPHA_MASK));
+        const __m128i redBlue = _mm_set1_epi32(static_cast<int>(RED_BLUE_MASK));
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            __m128i rb = _mm_and_si128(pixels, redBlue);
+            __m128i swapped = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_or_si128(_mm_and_si128(pixels, greenAlpha), swapped));
+        }
+        SwapRedBlueScalar(dest + i, src + i, count - i);
+    }
+
+    void ConvertToRgb565Sse2(uint16_t* dest, const uint32_t* src, size_t count) noexcept {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m128i low = ToRgb565Sse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+            __m128i high = ToRgb565Sse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 4)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_packs_epi32(low, high));
+        }
+        ConvertToRgb565Scalar(dest + i, src + i, count - i);
+    }
+
+    // Splits 8 pixels into 16-bit lanes of each channel
+    inline void SplitChannelsSse2(const uint32_t* src, __m128i& r, __m128i& g, __m128i& b) noexcept {
+        const __m128i mask = _mm_set1_epi32(0xFF);
+        __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4));
+
+        // Every channel fits in 8 bits, so signed saturation never kicks in
+        r = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(low, 16), mask), _mm_and_si128(_mm_srli_epi32(high, 16), mask));
+        g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(low, 8), mask), _mm_and_si128(_mm_srli_epi32(high, 8), mask));
+        b = _mm_packs_epi32(_mm_and_si128(low, mask), _mm_and_si128(high, mask));
+    }
+
+    inline __m128i ToLumaSse2(__m128i r, __m128i g, __m128i b) noexcept {
+        // The weighted sum needs all 16 bits, so treat it as unsigned (it never wraps past 56228)
+        __m128i sum = _mm_add_epi16(
+            _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(66)), _mm_mullo_epi16(g, _mm_set1_epi16(129))),
+            _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(25)), _mm_set1_epi16(128))
+        );
+        return _mm_add_epi16(_mm_srli_epi16(sum, 8), _mm_set1_epi16(16));
+    }
+
+    // Sums the two rows of a channel, then each horizontal pair; the 4 results end up in the low half
+    inline __m128i SumBlocksSse2(__m128i top, __m128i bottom) noexcept {
+        __m128i pairs = _mm_madd_epi16(_mm_add_epi16(top, bottom), _mm_set1_epi16(1));
+        __m128i rounded = _mm_srli_epi32(_mm_add_epi32(pairs, _mm_set1_epi32(2)), 2);
+        return _mm_packs_epi32(rounded, rounded);
+    }
+
+    inline __m128i WeighChromaSse2(__m128i r, __m128i g, __m128i b, short wr, short wg, short wb) noexcept {
+        // Signed this time, but the averages are small enough that nothing overflows
+        __m128i sum = _mm_add_epi16(
+            _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(wr)), _mm_mullo_epi16(g, _mm_set1_epi16(wg))),
+            _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(wb)), _mm_set1_epi16(128))
+        );
+        return _mm_add_epi16(_mm_srai_epi16(sum, 8), _mm_set1_epi16(128));
+    }
+
+    void Transpose4x4Sse2(uint32_t* dest, ptrdiff_t destPitch, const uint32_t* src, ptrdiff_t srcPitch) noexcept {
+        __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + srcPitch));
+        __m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * srcPitch));
+        __m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * srcPitch));
+
+        // a0 b0 a1 b1, a2 b2 a3 b3, c0 d0 c1 d1, c2 d2 c3 d3
+        __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+        __m128i t1 = _mm_unpackhi_epi32(r0, r1);
+        __m128i t2 = _mm_unpacklo_epi32(r2, r3);
+        __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), _mm_unpacklo_epi64(t0, t2));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + destPitch), _mm_unpackhi_epi64(t0, t2));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + 2 * destPitch), _mm_unpacklo_epi64(t1, t3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + 3 * destPitch), _mm_unpackhi_epi64(t1, t3));
+    }
+
+    void ConvertToNv12Sse2(uint8_t* lumaTop, uint8_t* lumaBottom, uint8_t* chroma, const uint32_t* srcTop, const uint32_t* srcBottom, size_t count) noexcept {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m128i rTop, gTop, bTop, rBottom, gBottom, bBottom;
+            SplitChannelsSse2(srcTop + i, rTop, gTop, bTop);
+            SplitChannelsSse2(srcBottom + i, rBottom, gBottom, bBottom);
+
+            // Store the bottom row's luma first, in case both rows are the same
+            __m128i yTop = ToLumaSse2(rTop, gTop, bTop);
+            __m128i yBottom = ToLumaSse2(rBottom, gBottom, bBottom);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(lumaBottom + i), _mm_packus_epi16(yBottom, yBottom));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(lumaTop + i), _mm_packus_epi16(yTop, yTop));
+
+            __m128i r = SumBlocksSse2(rTop, rBottom);
+            __m128i g = SumBlocksSse2(gTop, gBottom);
+            __m128i b = SumBlocksSse2(bTop, bBottom);
+            __m128i u = WeighChromaSse2(r, g, b, -38, -74, 112);
+            __m128i v = WeighChromaSse2(r, g, b, 112, -94, -18);
+            __m128i uv = _mm_unpacklo_epi16(u, v);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(chroma + i), _mm_packus_epi16(uv, uv));
+        }
+        ConvertToNv12Scalar(lumaTop + i, lumaBottom + i, chroma + i, srcTop + i, srcBottom + i, count - i);
+    }
+
+    MELONDSDS_TARGET_AVX2 inline __m256i ToRgb565Avx2(__m256i pixels) noexcept {
+        __m256i red = _mm256_and_si256(_mm256_srli_epi32(pixels, 8), _mm256_set1_epi32(0xF800));
+        __m256i green = _mm256_and_si256(_mm256_srli_epi32(pixels, 5), _mm256_set1_epi32(0x07E0));
+        __m256i blue = _mm256_and_si256(_mm256_srli_epi32(pixels, 3), _mm256_set1_epi32(0x001F));
+        __m256i packed = _mm256_or_si256(_mm256_or_si256(red, green), blue);
+        return _mm256_srai_epi32(_mm256_slli_epi32(packed, 16), 16);
+    }
+
+    MELONDSDS_TARGET_AVX2 void FillAvx2(uint32_t* dest, size_t count, uint32_t value) noexcept {
+        __m256i fill = _mm256_set1_epi32(static_cast<int>(value));
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), fill);
+        }
+        FillScalar(dest + i, count - i, value);
+    }
+
+    MELONDSDS_TARGET_AVX2 void InvertAvx2(uint32_t* dest, size_t count) noexcept {
+        const __m256i color = _mm256_set1_epi32(static_cast<int>(COLOR_MASK));
+        const __m256i alpha = _mm256_set1_epi32(static_cast<int>(ALPHA_MASK));
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i* p = reinterpret_cast<__m256i*>(dest + i);
+            __m256i pixels = _mm256_loadu_si256(p);
+            _mm256_storeu_si256(p, _mm256_or_si256(_mm256_xor_si256(pixels, color), alpha));
+        }
+        InvertScalar(dest + i, count - i);
+    }
+
+    MELONDSDS_TARGET_AVX2 void SwapRedBlueAvx2(uint32_t* dest, const uint32_t* src, size_t count) noexcept {
+        const __m256i greenAlpha = _mm256_set1_epi32(static_cast<int>(GREEN_ALPHA_MASK));
+        const __m256i redBlue = _mm256_set1_epi32(static_cast<int>(RED_BLUE_MASK));
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+            __m256i rb = _mm256_and_si256(pixels, redBlue);
+            __m256i swapped = _mm256_or_si256(_mm256_slli_epi32(rb, 16), _mm256_srli_epi32(rb, 16));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), _mm256_or_si256(_mm256_and_si256(pixels, greenAlpha), swapped));
+        }
+        SwapRedBlueScalar(dest + i, src + i, count - i);
+    }
+
+    MELONDSDS_TARGET_AVX2 void ConvertToRgb565Avx2(uint16_t* dest, const uint32_t* src, size_t count) noexcept {
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16) {
+            __m256i low = ToRgb565Avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)));
+            __m256i high = ToRgb565Avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 8)));
+
+            // AVX2 packs within each 128-bit lane, so the 64-bit quarters come out as low0 high0 low1 high1
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(low, high), 0xD8);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), packed);
+        }
+        ConvertToRgb565Scalar(dest + i, src + i, count - i);
+    }
+#endif
+
+#ifdef MELONDSDS_PIXELS_NEON
+    void FillNeon(uint32_t* dest, size_t count, uint32_t value) noexcept {
+        uint32x4_t fill = vdupq_n_u32(value);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            vst1q_u32(dest + i, fill);
+        }
+        FillScalar(dest + i, count - i, value);
+    }
+
+    void InvertNeon(uint32_t* dest, size_t count) noexcept {
+        const uint32x4_t color = vdupq_n_u32(COLOR_MASK);
+        const uint32x4_t alpha = vdupq_n_u32(ALPHA_MASK);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            uint32x4_t pixels = vld1q_u32(dest + i);
+            vst1q_u32(dest + i, vorrq_u32(veorq_u32(pixels, color), alpha));
+        }
+        InvertScalar(dest + i, count - i);
+    }
+
+    void SwapRedBlueNeon(uint32_t* dest, const uint32_t* src, size_t count) noexcept {
+        const uint32x4_t greenAlpha = vdupq_n_u32(GREEN_ALPHA_MASK);
+        const uint32x4_t redBlue = vdupq_n_u32(RED_BLUE_MASK);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            uint32x4_t pixels = vld1q_u32(src + i);
+            uint32x4_t rb = vandq_u32(pixels, redBlue);
+            uint32x4_t swapped = vorrq_u32(vshlq_n_u32(rb, 16), vshrq_n_u32(rb, 16));
+            vst1q_u32(dest + i, vorrq_u32(vandq_u32(pixels, greenAlpha), swapped));
+        }
+        SwapRedBlueScalar(dest + i, src + i, count - i);
+    }
+
+    void ConvertToRgb565Neon(uint16_t* dest, const uint32_t* src, size_t count) noexcept {
+        const uint32x4_t redMask = vdupq_n_u32(0xF800);
+        const uint32x4_t greenMask = vdupq_n_u32(0x07E0);
+        const uint32x4_t blueMask = vdupq_n_u32(0x001F);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            uint32x4_t pixels = vld1q_u32(src + i);
+            uint32x4_t red = vandq_u32(vshrq_n_u32(pixels, 8), redMask);
+            uint32x4_t green = vandq_u32(vshrq_n_u32(pixels, 5), greenMask);
+            uint32x4_t blue = vandq_u32(vshrq_n_u32(pixels, 3), blueMask);
+
+            // Unlike SSE2, NEON can narrow without saturating
+            vst1_u16(dest + i, vmovn_u32(vorrq_u32(vorrq_u32(red, green), blue)));
+        }
+        ConvertToRgb565Scalar(dest + i, src + i, count - i);
+    }
+
+    void Transpose4x4Neon(uint32_t* dest, ptrdiff_t destPitch, const uint32_t* src, ptrdiff_t srcPitch) noexcept {
+        // a0 b0 a2 b2 / a1 b1 a3 b3, and likewise for c and d
+        uint32x4x2_t ab = vtrnq_u32(vld1q_u32(src), vld1q_u32(src + srcPitch));
+        uint32x4x2_t cd = vtrnq_u32(vld1q_u32(src + 2 * srcPitch), vld1q_u32(src + 3 * srcPitch));
+
+        vst1q_u32(dest, vcombine_u32(vget_low_u32(ab.val[0]), vget_low_u32(cd.val[0])));
+        vst1q_u32(dest + destPitch, vcombine_u32(vget_low_u32(ab.val[1]), vget_low_u32(cd.val[1])));
+        vst1q_u32(dest + 2 * destPitch, vcombine_u32(vget_high_u32(ab.val[0]), vget_high_u32(cd.val[0])));
+        vst1q_u32(dest + 3 * destPitch, vcombine_u32(vget_high_u32(ab.val[1]), vget_high_u32(cd.val[1])));
+    }
+#endif
+
+    constexpr Kernels SCALAR_KERNELS { KernelSet::Scalar, FillScalar, InvertScalar, SwapRedBlueScalar, ConvertToRgb565Scalar, ConvertToNv12Scalar, Transpose4x4Scalar };
+#ifdef MELONDSDS_PIXELS_X86
+    constexpr Kernels SSE2_KERNELS { KernelSet::Sse2, FillSse2, InvertSse2, SwapRedBlueSse2, ConvertToRgb565Sse2, ConvertToNv12Sse2, Transpose4x4Sse2 };
+    // The NV12 conversion is bound by its 16-bit multiplies and narrowing, which AVX2 does per 128-bit lane anyway;
+    // the transpose is bound by its scattered stores, which wider registers don't help with
+    constexpr Kernels AVX2_KERNELS { KernelSet::Avx2, FillAvx2, InvertAvx2, SwapRedBlueAvx2, ConvertToRgb565Avx2, ConvertToNv12Sse2, Transpose4x4Sse2 };
+#endif
+#ifdef MELONDSDS_PIXELS_NEON
+    constexpr Kernels NEON_KERNELS { KernelSet::Neon, FillNeon, InvertNeon, SwapRedBlueNeon, ConvertToRgb565Neon, ConvertToNv12Scalar, Transpose4x4Neon };
+#endif
+
+    using cpu::Feature;
+    using cpu::Variant;
+
+    // Best first; cpu::Init picks the first one that the CPU and MELONDSDS_CPU_FEATURES allow
+    constexpr Variant<const Kernels*> PIXEL_VARIANTS[] {
+#ifdef MELONDSDS_PIXELS_X86
+        { "avx2", Feature::Avx2, &AVX2_KERNELS },
+        { "sse2", Feature::Sse2, &SSE2_KERNELS },
+#endif
+#ifdef MELONDSDS_PIXELS_NEON
+        { "neon", Feature::Neon, &NEON_KERNELS },
+#endif
+        { "scalar", std::nullopt, &SCALAR_KERNELS },
+    };
+
+    cpu::Kernel<const Kernels*> PixelKernels("pixels", PIXEL_VARIANTS);
+}
+
+const Kernels& MelonDsDs::pixels::Active() noexcept {
+    return *PixelKernels.Get();
+}
+
+const Kernels* MelonDsDs::pixels::Get(KernelSet set) noexcept {
+    switch (set) {
+        case KernelSet::Scalar:
+            return &SCALAR_KERNELS;
+#ifdef MELONDSDS_PIXELS_X86
+        case KernelSet::Sse2:
+            return &SSE2_KERNELS;
+        case KernelSet::Avx2:
+            return cpu::Detected(Feature::Avx2) ? &AVX2_KERNELS : nullptr;
+#endif
+#ifdef MELONDSDS_PIXELS_NEON
+        case KernelSet::Neon:
+            return &NEON_KERNELS;
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+const char* MelonDsDs::pixels::GetName(KernelSet set) noexcept {
+    switch (set) {
+        case KernelSet::Scalar:
+            return "scalar";
+        case KernelSet::Sse2:
+            return "sse2";
+        case KernelSet::Avx2:
+            return "avx2";
+        case KernelSet::Neon:
+            return "neon";
+        default:
+            return "unknown";
+    }
+}
+
+void MelonDsDs::pixels::FillRect(uint32_t* dest, size_t pitch, unsigned width, unsigned height, uint32_t value) noexcept {
+    if (value == 0 && pitch == width) {
+        // If we're clearing a contiguous region, memset is about as fast as it gets
+        memset(dest, 0, size_t(width) * height * sizeof(uint32_t));
+        return;
+    }
+
+    const Kernels& kernels = Active();
+    if (pitch == width) {
+        kernels.Fill(dest, size_t(width) * height, value);
+        return;
+    }
+
+    for (unsigned y = 0; y < height; y++) {
+        kernels.Fill(dest + y * pitch, width, value);
+    }
+}
+
+void MelonDsDs::pixels::CopyRect(uint32_t* dest, size_t destPitch, const uint32_t* src, size_t srcPitch, unsigned width, unsigned height) noexcept {
+    // The C library's memcpy is already vectorized for the host CPU,
+    // so all we can do is avoid per-row overhead when the rows are contiguous
+    if (destPitch == width && srcPitch == width) {
+        memcpy(dest, src, size_t(width) * height * sizeof(uint32_t));
+        return;
+    }
+
+    for (unsigned y = 0; y < height; y++) {
+        memcpy(dest + y * destPitch, src + y * srcPitch, width * sizeof(uint32_t));
+    }
+}
+
+void MelonDsDs::pixels::InvertRect(uint32_t* dest, size_t pitch, unsigned width, unsigned height) noexcept {
+    const Kernels& kernels = Active();
+    for (unsigned y = 0; y < height; y++) {
+        kernels.Invert(dest + y * pitch, width);
+    }
+}
+
+void MelonDsDs::pixels::SwapRedBlueRect(uint32_t* dest, size_t destPitch, const uint32_t* src, size_t srcPitch, unsigned width, unsigned height) noexcept {
+    const Kernels& kernels = Active();
+    if (destPitch == width && srcPitch == width) {
+        kernels.SwapRedBlue(dest, src, size_t(width) * height);
+        return;
+    }
+
+    for (unsigned y = 0; y < height; y++) {
+        kernels.SwapRedBlue(dest + y * destPitch, src + y * srcPitch, width);
+    }
+}
+
+void MelonDsDs::pixels::ConvertToRgb565Rect(uint16_t* dest, size_t destPitch, const uint32_t* src, size_t srcPitch, unsigned width, unsigned height) noexcept {
+    const Kernels& kernels = Active();
+    if (destPitch == width && srcPitch == width) {
+        kernels.ConvertToRgb565(dest, src, size_t(width) * height);
+        return;
+    }
+
+    for (unsigned y = 0; y < height; y++) {
+        kernels.ConvertToRgb565(dest + y * destPitch, src + y * srcPitch, width);
+    }
+}
+
+void MelonDsDs::pixels::ConvertToNv12Rect(uint8_t* luma, size_t lumaPitch, uint8_t* chroma, size_t chromaPitch, const uint32_t* src, size_t srcPitch, unsigned width, unsigned height) noexcept {
+    const Kernels& kernels = Active();
+    for (unsigned y = 0; y < height; y += 2) {
+        // An odd last row is its own bottom neighbor
+        unsigned bottom = y + 1 < height ? y + 1 : y;
+        kernels.ConvertToNv12(
+            luma + y * lumaPitch,
+            luma + bottom * lumaPitch,
+            chroma + (y / 2) * chromaPitch,
+            src + y * srcPitch,
+            src + bottom * srcPitch,
+            width
+        );
+    }
+}
+
+void MelonDsDs::pixels::RotateRect(uint32_t* dest, size_t destPitch, const uint32_t* src, size_t srcPitch, unsigned width, unsigned height, unsigned quarterTurns) noexcept {
+    const ptrdiff_t dp = static_cast<ptrdiff_t>(destPitch);
+    const ptrdiff_t sp = static_cast<ptrdiff_t>(srcPitch);
+    switch (quarterTurns % 4) {
+        case 0:
+            CopyRect(dest, destPitch, src, srcPitch, width, height);
+            return;
+        case 2:
+            // Upside down; each row is reversed into its mirror
+            for (unsigned y = 0; y < height; y++) {
+                const uint32_t* row = src + y * sp;
+                std::reverse_copy(row, row + width, dest + (height - 1 - y) * dp);
+            }
+            return;
+        default:
+            break;
+    }
+
+    // A quarter turn is a transpose with one axis flipped,
+    // done one 4x4 block at a time so that both images are read and written a few whole rows at a time.
+    // (x, y) goes to (y, width - 1 - x) when turning left, or (height - 1 - y, x) when turning right.
+    const Kernels& kernels = Active();
+    const bool left = quarterTurns % 4 == 1;
+    unsigned blockWidth = width & ~3u;
+    unsigned blockHeight = height & ~3u;
+    for (unsigned by = 0; by < blockHeight; by += 4) {
+        for (unsigned bx = 0; bx < blockWidth; bx += 4) {
+            if (left) {
+                // Write the block's rows bottom-up
+                kernels.Transpose4x4(dest + (width - 1 - bx) * dp + by, -dp, src + by * sp + bx, sp);
+            } else {
+                // Read the block's rows bottom-up
+                kernels.Transpose4x4(dest + bx * dp + (height - 4 - by), dp, src + (by + 3) * sp + bx, -sp);
+            }
+        }
+    }
+
+    // Whatever's left along the right and bottom edges
+    for (unsigned y = 0; y < height; y++) {
+        for (unsigned x = (y < blockHeight) ? blockWidth : 0; x < width; x++) {
+            uint32_t pixel = src[y * sp + x];
+            if (left) {
+                dest[(width - 1 - x) * dp + y] = pixel;
+            } else {
+                dest[x * dp + (height - 1 - y)] = pixel;
+            }
+        }
+    }
+}
@@ -0,0 +1,73 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#ifndef MELONDSDS_PIXELS_HPP
+#define MELONDSDS_PIXELS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/// Small per-pixel kernels used by the software presentation path.
+/// All pixels are 32-bit XRGB8888 (or ABGR8888 after swapping) unless noted otherwise.
+/// Pitches are in pixels, not bytes.
+namespace MelonDsDs::pixels {
+    enum class KernelSet {
+        Scalar,
+        Sse2,
+        Avx2,
+        Neon,
+    };
+
+    struct Kernels {
+        KernelSet Set;
+        void (*Fill)(uint32_t* dest, size_t count, uint32_t value) noexcept;
+        /// Inverts the color channels and sets the alpha channel to opaque, as the cursor does.
+        void (*Invert)(uint32_t* dest, size_t count) noexcept;
+        /// Converts ARGB8888 to ABGR8888 (or vice versa).
+        void (*SwapRedBlue)(uint32_t* dest, const uint32_t* src, size_t count) noexcept;
+        /// Converts XRGB8888 to RGB565 by dropping the low bits of each channel.
+        void (*ConvertToRgb565)(uint16_t* dest, const uint32_t* src, size_t count) noexcept;
+        /// Converts a pair of XRGB8888 rows to NV12 (BT.601, limited range):
+        /// a row of luma for each, and one row of interleaved chroma for the 2x2 blocks they share.
+        /// \c lumaBottom may equal \c lumaTop (with \c srcBottom equal to \c srcTop) for an image's odd last row.
+        void (*ConvertToNv12)(uint8_t* lumaTop, uint8_t* lumaBottom, uint8_t* chroma, const uint32_t* srcTop, const uint32_t* srcBottom, size_t count) noexcept;
+        /// Copies a 4x4 block so that \c src's rows become \c dest's columns.
+        /// Either pitch may be negative, which is how \c RotateRect flips the block as it goes.
+        void (*Transpose4x4)(uint32_t* dest, ptrdiff_t destPitch, const uint32_t* src, ptrdiff_t srcPitch) noexcept;
+    };
+
+    /// The fastest kernels this CPU supports, chosen the first time this is called.
+    [[nodiscard]] const Kernels& Active() noexcept;
+
+    /// Kernels for the given instruction set, or \c nullptr if this build or CPU doesn't support it.
+    [[nodiscard]] const Kernels* Get(KernelSet set) noexcept;
+    [[nodiscard]] const char* GetName(KernelSet set) noexcept;
+
+    void FillRect(uint32_t* dest, size_t pitch, unsigned width, unsigned height, uint32_t value) noexcept;
+    void CopyRect(uint32_t* dest, size_t destPitch, const uint32_t* src, size_t srcPitch, unsigned width, unsigned height) noexcept;
+    void InvertRect(uint32_t* dest, size_t pitch, unsigned width, unsigned height) noexcept;
+    void SwapRedBlueRect(uint32_t* dest, size_t destPitch, const uint32_t* src, size_t srcPitch, unsigned width, unsigned height) noexcept;
+    void ConvertToRgb565Rect(uint16_t* dest, size_t destPitch, const uint32_t* src, size_t srcPitch, unsigned width, unsigned height) noexcept;
+    /// Both planes' pitches are in bytes; the chroma plane needs \c (height+1)/2 rows of \c (width+1)/2 pairs.
+    void ConvertToNv12Rect(uint8_t* luma, size_t lumaPitch, uint8_t* chroma, size_t chromaPitch, const uint32_t* src, size_t srcPitch, unsigned width, unsigned height) noexcept;
+    /// Rotates a \c width by \c height image counter-clockwise by \c quarterTurns quarter turns
+    /// (the same convention as \c RETRO_ENVIRONMENT_SET_ROTATION).
+    /// For odd \c quarterTurns, \c dest must have room for \c height by \c width pixels.
+    void RotateRect(uint32_t* dest, size_t destPitch, const uint32_t* src, size_t srcPitch, unsigned width, unsigned height, unsigned quarterTurns) noexcept;
+}
+
+#endif // MELONDSDS_PIXELS_HPP
@@ -0,0 +1,403 @@
+/*
+    Copyright 2024 Jesse Talavera
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "blockcache.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#include <retro_assert.h>
+#include <streams/file_stream.h>
+
+#include "environment.hpp"
+#include "tracy.hpp"
+
+using std::vector;
+using namespace std::chrono;
+
+// Writing a run means copying it into one buffer first, so don't let that buffer get too big
+constexpr size_t MAX_RUN_PAGES = 64;
+
+MelonDsDs::BlockCache::BlockCache(RFILE* file, size_t maxPages) noexcept : _file(file), _maxPages(maxPages) {
+    ZoneScopedN(TracyFunction);
+    retro_assert(_file != nullptr);
+    retro_assert(_maxPages >= 4);
+
+    int64_t size = filestream_get_size(_file);
+    _size = size > 0 ? size : 0;
+    _fileSize = _size;
+    _lock = slock_new();
+    retro_assert(_lock != nullptr);
+
+#ifdef HAVE_THREADS
+    _wake = scond_new();
+    if (_wake) {
+        _thread = sthread_create(FlushThread, this);
+    }
+
+    if (!_thread) {
+        retro::warn("Couldn't start a background flush thread for \"{}\"; dirty blocks will be flushed inline", filestream_get_path(_file));
+    }
+#endif
+}
+
+MelonDsDs::BlockCache::~BlockCache() noexcept {
+    ZoneScopedN(TracyFunction);
+
+    if (_thread) {
+        slock_lock(_lock);
+        _stopping = true;
+        scond_signal(_wake);
+        slock_unlock(_lock);
+        sthread_join(_thread);
+    }
+
+    slock_lock(_lock);
+    FlushLocked();
+    slock_unlock(_lock);
+
+    retro::debug(
+        "Block cache for \"{}\": {} hits, {} misses, {} evictions; {} flushes wrote {} pages in {} runs ({} zeroed pages skipped)",
+        filestream_get_path(_file),
+        _stats.Hits,
+        _stats.Misses,
+        _stats.Evictions,
+        _stats.Flushes,
+        _stats.PagesWritten,
+        _stats.WriteRuns,
+        _stats.PagesSkipped
+    );
+
+    if (_wake)
+        scond_free(_wake);
+
+    slock_free(_lock);
+}
+
+void MelonDsDs::BlockCache::FlushThread(void* self) noexcept {
+    BlockCache& cache = *static_cast<BlockCache*>(self);
+
+    slock_lock(cache._lock);
+    while (!cache._stopping) {
+        scond_wait_timeout(cache._wake, cache._lock, duration_cast<microseconds>(FLUSH_INTERVAL).count());
+        if (!cache._stopping && cache._dirtyPages > 0 && steady_clock::now() - cache._firstDirty >= FLUSH_INTERVAL) {
+            // If some page has been dirty for long enough...
+            ZoneScopedN("MelonDsDs::BlockCache::FlushThread::flush");
+            cache.FlushLocked();
+        }
+    }
+    slock_unlock(cache._lock);
+}
+
+MelonDsDs::BlockCache::Page* MelonDsDs::BlockCache::GetPage(uint64_t index, bool overwrite) noexcept {
+    if (auto it = _pages.find(index); it != _pages.end()) {
+        _stats.Hits++;
+        return &it->second;
+    }
+
+    _stats.Misses++;
+    if (_pages.size() >= _maxPages) {
+        Evict();
+    }
+
+    Page page { .Data = std::make_unique<std::byte[]>(PAGE_SIZE) };
+    uint64_t offset = index * PAGE_SIZE;
+    if (!overwrite && offset < _fileSize) {
+        // If the caller needs this page's existing contents...
+        // (Anything past the end of the file reads as zeroes)
+        if (filestream_seek(_file, offset, RETRO_VFS_SEEK_POSITION_START) != 0) {
+            retro::error("Failed to seek to {} in \"{}\"", offset, filestream_get_path(_file));
+            return nullptr;
+        }
+
+        int64_t length = std::min<uint64_t>(PAGE_SIZE, _fileSize - offset);
+        if (filestream_read(_file, page.Data.get(), length) != length) {
+            retro::error("Failed to read {} bytes at {} from \"{}\"", length, offset, filestream_get_path(_file));
+            return nullptr;
+        }
+    }
+
+    return &_pages.emplace(index, std::move(page)).first->second;
+}
+
+void MelonDsDs::BlockCache::MarkDirty(Page& page) noexcept {
+    if (page.Dirty)
+        return;
+
+    if (_dirtyPages == 0) {
+        _firstDirty = steady_clock::now();
+    }
+
+    page.Dirty = true;
+    _dirtyPages++;
+}
+
+void MelonDsDs::BlockCache::Evict() noexcept {
+    ZoneScopedN(TracyFunction);
+
+    if (_dirtyPages > _pages.size() / 2) {
+        // If most of the cache is dirty, then dropping only the clean pages won't free up much
+        FlushLocked();
+    }
+
+    // Drop clean pages until the cache is down to three quarters of its capacity
+    for (auto it = _pages.begin(); it != _pages.end() && _pages.size() > _maxPages * 3 / 4;) {
+        if (it->second.Dirty) {
+            ++it;
+        } else {
+            it = _pages.erase(it);
+            _stats.Evictions++;
+        }
+    }
+}
+
+size_t MelonDsDs::BlockCache::Read(void* data, size_t length) noexcept {
+    ZoneScopedN(TracyFunction);
+    slock_lock(_lock);
+
+    length = _position < _size ? std::min<uint64_t>(length, _size - _position) : 0;
+    size_t bytesRead = 0;
+    while (bytesRead < length) {
+        uint64_t index = _position / PAGE_SIZE;
+        size_t pageOffset = _position % PAGE_SIZE;
+        size_t chunk = std::min(length - bytesRead, PAGE_SIZE - pageOffset);
+
+        const Page* page = GetPage(index, false);
+        if (!page)
+            break;
+
+        memcpy(static_cast<std::byte*>(data) + bytesRead, page->Data.get() + pageOffset, chunk);
+        bytesRead += chunk;
+        _position += chunk;
+    }
+
+    slock_unlock(_lock);
+    return bytesRead;
+}
+
+size_t MelonDsDs::BlockCache::Write(const void* data, size_t length) noexcept {
+    ZoneScopedN(TracyFunction);
+    slock_lock(_lock);
+
+    size_t bytesWritten = 0;
+    while (bytesWritten < length) {
+        uint64_t index = _position / PAGE_SIZE;
+        size_t pageOffset = _position % PAGE_SIZE;
+        size_t chunk = std::min(length - bytesWritten, PAGE_SIZE - pageOffset);
+
+        // No need to read the page first if we're replacing all of it
+        Page* page = GetPage(index, chunk == PAGE_SIZE);
+        if (!page)
+            break;
+
+        memcpy(page->Data.get() + pageOffset, static_cast<const std::byte*>(data) + bytesWritten, chunk);
+        MarkDirty(*page);
+        bytesWritten += chunk;
+        _position += chunk;
+        _size = std::max(_size, _position);
+    }
+
+    if (!_thread && _dirtyPages > 0 && steady_clock::now() - _firstDirty >= FLUSH_INTERVAL) {
+        // If there's no background thread to flush for us...
+        FlushLocked();
+    }
+
+    slock_unlock(_lock);
+    return bytesWritten;
+}
+
+bool MelonDsDs::BlockCache::Seek(int64_t offset, int whence) noexcept {
+    slock_lock(_lock);
+
+    int64_t base = 0;
+    switch (whence) {
+        case RETRO_VFS_SEEK_POSITION_START: base = 0; break;
+        case RETRO_VFS_SEEK_POSITION_CURRENT: base = _position; break;
+        case RETRO_VFS_SEEK_POSITION_END: base = _size; break;
+        default: base = -1; break;
+    }
+
+    bool ok = base >= 0 && base + offset >= 0;
+    if (ok) {
+        _position = base + offset;
+    }
+
+    slock_unlock(_lock);
+    return ok;
+}
+
+uint64_t MelonDsDs::BlockCache::Position() const noexcept {
+    slock_lock(_lock);
+    uint64_t position = _position;
+    slock_unlock(_lock);
+    return position;
+}
+
+uint64_t MelonDsDs::BlockCache::Size() const noexcept {
+    slock_lock(_lock);
+    uint64_t size = _size;
+    slock_unlock(_lock);
+    return size;
+}
+
+MelonDsDs::BlockCacheStats MelonDsDs::BlockCache::Stats() const noexcept {
+    slock_lock(_lock);
+    BlockCacheStats stats = _stats;
+    slock_unlock(_lock);
+    return stats;
+}
+
+bool MelonDsDs::BlockCache::Flush() noexcept {
+    ZoneScopedN(TracyFunction);
+    slock_lock(_lock);
+    bool ok = FlushLocked();
+    slock_unlock(_lock);
+    return ok;
+}
+
+uint64_t MelonDsDs::BlockCache::MetadataEnd() noexcept {
+    // Read the FAT boot sector's BIOS parameter block, if there is one
+    // (Read it directly if it's not cached, since caching it might evict, which might flush, which would call this)
+    std::array<uint8_t, 512> sector {};
+    if (auto it = _pages.find(0); it != _pages.end()) {
+        memcpy(sector.data(), it->second.Data.get(), sector.size());
+    } else if (_fileSize < sector.size() ||
+        filestream_seek(_file, 0, RETRO_VFS_SEEK_POSITION_START) != 0 ||
+        filestream_read(_file, sector.data(), sector.size()) != static_cast<int64_t>(sector.size())) {
+        return 0;
+    }
+    auto u16 = [&sector](size_t offset) { return static_cast<uint32_t>(sector[offset] | (sector[offset + 1] << 8)); };
+    auto u32 = [&u16](size_t offset) { return u16(offset) | (u16(offset + 2) << 16); };
+
+    uint32_t bytesPerSector = u16(11);
+    uint32_t reservedSectors = u16(14);
+    uint32_t numFats = sector[16];
+    uint32_t rootEntries = u16(17);
+    uint32_t fatSectors = u16(22) ? u16(22) : u32(36);
+
+    bool valid =
+        sector[510] == 0x55 && sector[511] == 0xAA &&
+        (bytesPerSector == 512 || bytesPerSector == 1024 || bytesPerSector == 2048 || bytesPerSector == 4096) &&
+        (numFats == 1 || numFats == 2) &&
+        reservedSectors > 0 && fatSectors > 0;
+
+    if (!valid)
+        return 0; // Not a FAT volume we understand (e.g. it's partitioned), so write everything in one pass
+
+    return (uint64_t(reservedSectors) + uint64_t(numFats) * fatSectors) * bytesPerSector + uint64_t(rootEntries) * 32;
+}
+
+bool MelonDsDs::BlockCache::IsUnallocatedZeroPage(uint64_t index, const Page& page) const noexcept {
+    if (index * PAGE_SIZE < _fileSize)
+        return false; // The file already has data here that this page might be replacing
+
+    const std::byte* data = page.Data.get();
+    return std::all_of(data, data + PAGE_SIZE, [](std::byte b) { return b == std::byte {0}; });
+}
+
+bool MelonDsDs::BlockCache::WriteRuns(const vector<uint64_t>& pages) noexcept {
+    ZoneScopedN(TracyFunction);
+
+    vector<std::byte> buffer;
+    bool ok = true;
+    for (size_t i = 0; i < pages.size();) {
+        if (Page& page = _pages.at(pages[i]); IsUnallocatedZeroPage(pages[i], page)) {
+            // If this page would only be writing zeroes past the end of the file...
+            // (Extending the file later will leave a hole there, which reads back the same)
+            page.Dirty = false;
+            _dirtyPages--;
+            _stats.PagesSkipped++;
+            i++;
+            continue;
+        }
+
+        // Gather the longest contiguous run of dirty pages that starts here
+        size_t runLength = 1;
+        while (
+            i + runLength < pages.size() &&
+            runLength < MAX_RUN_PAGES &&
+            pages[i + runLength] == pages[i] + runLength &&
+            !IsUnallocatedZeroPage(pages[i + runLength], _pages.at(pages[i + runLength]))
+        ) {
+            runLength++;
+        }
+
+        uint64_t offset = pages[i] * PAGE_SIZE;
+        buffer.resize(runLength * PAGE_SIZE);
+        for (size_t p = 0; p < runLength; ++p) {
+            Page& page = _pages.at(pages[i + p]);
+            memcpy(buffer.data() + p * PAGE_SIZE, page.Data.get(), PAGE_SIZE);
+        }
+
+        // Don't pad the file out to a whole page
+        int64_t length = std::min<uint64_t>(buffer.size(), _size - offset);
+        if (filestream_seek(_file, offset, RETRO_VFS_SEEK_POSITION_START) != 0 || filestream_write(_file, buffer.data(), length) != length) {
+            retro::error("Failed to write {} bytes at {} to \"{}\"", length, offset, filestream_get_path(_file));
+            ok = false;
+        } else {
+            _fileSize = std::max<uint64_t>(_fileSize, offset + length);
+            for (size_t p = 0; p < runLength; ++p) {
+                _pages.at(pages[i + p]).Dirty = false;
+                _dirtyPages--;
+            }
+            _stats.WriteRuns++;
+            _stats.PagesWritten += runLength;
+        }
+
+        i += runLength;
+    }
+
+    return ok;
+}
+
+bool MelonDsDs::BlockCache::FlushLocked() noexcept {
+    ZoneScopedN(TracyFunction);
+
+    if (_dirtyPages == 0)
+        return filestream_flush(_file) == 0;
+
+    uint64_t metadataEnd = MetadataEnd();
+    vector<uint64_t> data;
+    vector<uint64_t> metadata;
+    for (const auto& [index, page] : _pages) {
+        if (page.Dirty) {
+            (index * PAGE_SIZE < metadataEnd ? metadata : data).push_back(index);
+        }
+    }
+    std::sort(data.begin(), data.end());
+    std::sort(metadata.begin(), metadata.end());
+
+    // Data first, so that the file system never refers to clusters that haven't been written
+    bool ok = WriteRuns(data);
+    ok = (filestream_flush(_file) == 0) && ok;
+    ok = WriteRuns(metadata) && ok;
+    if (_fileSize < _size) {
+        // If the file's tail is all zeroes that we skipped writing...
+        if (filestream_truncate(_file, _size) == 0) {
+            _fileSize = _size;
+        } else {
+            retro::error("Failed to extend \"{}\" to {} bytes", filestream_get_path(_file), _size);
+            ok = false;
+        }
+    }
+    ok = (filestream_flush(_file) == 0) && ok;
+
+    _stats.Flushes++;
+    TracyPlot("Block Cache Pages Written", static_cast<int64_t>(data.size() + metadata.size()));
+    return ok;
+}
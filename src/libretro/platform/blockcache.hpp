@@ -0,0 +1,128 @@
+/*
+    Copyright 2024 Jesse Talavera
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <rthreads/rthreads.h>
+
+struct RFILE;
+
+namespace MelonDsDs {
+    struct BlockCacheStats {
+        uint64_t Hits = 0;
+        uint64_t Misses = 0;
+        uint64_t Evictions = 0;
+        uint64_t Flushes = 0;
+
+        /// Contiguous runs of dirty pages written back; each run is a single write to the VFS.
+        uint64_t WriteRuns = 0;
+        uint64_t PagesWritten = 0;
+
+        /// Zeroed pages past the end of the file that weren't written,
+        /// since extending the file leaves them as holes that read back as zeroes.
+        uint64_t PagesSkipped = 0;
+    };
+
+    /// A write-back cache of page-aligned blocks in front of a VFS file,
+    /// for disk images that the emulated console writes one sector at a time.
+    ///
+    /// Dirty pages are written back together, sorted and coalesced into contiguous runs,
+    /// when the file is flushed or closed and periodically in the background.
+    /// If the image holds a FAT file system, each flush writes (and syncs) the data region
+    /// before the boot sector, FATs, and root directory, so that an interrupted flush
+    /// can't leave the file system pointing at clusters that were never written.
+    ///
+    /// Zeroed pages past the end of the file aren't written at all;
+    /// instead, the file is extended (without writing) to its full size after each flush,
+    /// so clusters of a fresh image are only allocated on the host once the console uses them.
+    class BlockCache {
+    public:
+        static constexpr size_t PAGE_SIZE = 4096;
+
+        /// 8 MiB; past this, clean pages are dropped (and dirty pages flushed if necessary).
+        static constexpr size_t MAX_PAGES = 2048;
+
+        /// 1 MiB, for low-memory mode.
+        static constexpr size_t LOW_MEMORY_MAX_PAGES = 256;
+
+        /// How long a page may stay dirty before the background flush writes it.
+        static constexpr std::chrono::milliseconds FLUSH_INTERVAL {1000};
+
+        /// Doesn't take ownership of \c file, which must outlive the cache.
+        explicit BlockCache(RFILE* file, size_t maxPages = MAX_PAGES) noexcept;
+
+        /// Writes back any dirty pages.
+        ~BlockCache() noexcept;
+        BlockCache(const BlockCache&) = delete;
+        BlockCache(BlockCache&&) = delete;
+        BlockCache& operator=(const BlockCache&) = delete;
+        BlockCache& operator=(BlockCache&&) = delete;
+
+        size_t Read(void* data, size_t length) noexcept;
+        size_t Write(const void* data, size_t length) noexcept;
+
+        /// @param whence One of the \c RETRO_VFS_SEEK_POSITION constants.
+        bool Seek(int64_t offset, int whence) noexcept;
+        [[nodiscard]] uint64_t Position() const noexcept;
+        [[nodiscard]] uint64_t Size() const noexcept;
+
+        /// Writes back every dirty page, then flushes the underlying file.
+        bool Flush() noexcept;
+        [[nodiscard]] BlockCacheStats Stats() const noexcept;
+    private:
+        struct Page {
+            std::unique_ptr<std::byte[]> Data;
+            bool Dirty = false;
+        };
+
+        // All of these require _lock to be held
+        Page* GetPage(uint64_t index, bool overwrite) noexcept;
+        void MarkDirty(Page& page) noexcept;
+        void Evict() noexcept;
+        bool FlushLocked() noexcept;
+        bool WriteRuns(const std::vector<uint64_t>& pages) noexcept;
+        bool IsUnallocatedZeroPage(uint64_t index, const Page& page) const noexcept;
+        uint64_t MetadataEnd() noexcept;
+
+        static void FlushThread(void* self) noexcept;
+
+        RFILE* _file;
+        size_t _maxPages;
+        slock_t* _lock = nullptr;
+        scond_t* _wake = nullptr;
+        sthread_t* _thread = nullptr;
+        bool _stopping = false;
+
+        std::unordered_map<uint64_t, Page> _pages;
+        size_t _dirtyPages = 0;
+        std::chrono::steady_clock::time_point _firstDirty {};
+        uint64_t _position = 0;
+        uint64_t _size = 0;
+
+        /// How much of the file actually exists on the host;
+        /// anything between this and \c _size reads as zeroes.
+        uint64_t _fileSize = 0;
+        BlockCacheStats _stats {};
+    };
+}
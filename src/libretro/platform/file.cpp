@@ -16,13 +16,32 @@
 
 #define SKIP_STDIO_REDEFINES
 
+#include "file.hpp"
+#include "blockcache.hpp"
+#include "readahead.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cerrno>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
 #include <system_error>
 #include <unordered_map>
 #include <unistd.h>
 #include <vector>
 
+#ifdef HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #include <file/file_path.h>
 #include <Platform.h>
 #include <streams/file_stream.h>
@@ -35,6 +54,7 @@
 #include "../config/config.hpp"
 #include "environment.hpp"
 #include "format.hpp"
+#include "retro/threads.hpp"
 #include "tracy.hpp"
 #include "utils.hpp"
 
@@ -42,6 +62,7 @@ using namespace melonDS;
 using namespace melonDS::Platform;
 using std::unique_ptr;
 using std::unordered_map;
+using namespace std::chrono;
 
 constexpr unsigned GetRetroVfsFileAccessFlags(FileMode mode, bool file_exists) noexcept {
     unsigned retro_mode = 0;
@@ -57,17 +78,64 @@ constexpr unsigned GetRetroVfsFileAccessFlags(FileMode mode, bool file_exists) n
     return retro_mode;
 }
 
-unsigned GetRetroVfsFileAccessHints(const std::string& path) noexcept {
-    // TODO: If this path matches an SD card path, NAND path, or firmware path,
-    // then we should return RETRO_VFS_FILE_ACCESS_HINT_FREQUENT_ACCESS
+namespace {
+    // Indexed by HotFile; guarded by hotFilesLock,
+    // since system files may be opened by several loader threads at once
+    std::array<std::string, 3> hotFiles;
+    retro::slock hotFilesLock;
+    std::atomic_bool lowMemoryFileAccess = false;
+    std::atomic_size_t readAheadWindow = MelonDsDs::ReadAheadBuffer::DEFAULT_WINDOW;
+}
+
+void MelonDsDs::SetLowMemoryFileAccess(bool enabled) noexcept {
+    lowMemoryFileAccess = enabled;
+}
 
-    if (string_ends_with(path.c_str(), ".bin")) {
-        // TODO: When I submit that PR with those new Platform calls,
-        // use them instead of relying on a .bin file extension
-        return RETRO_VFS_FILE_ACCESS_HINT_FREQUENT_ACCESS;
+void MelonDsDs::SetFileReadAheadWindow(size_t bytes) noexcept {
+    readAheadWindow = bytes;
+}
+
+void MelonDsDs::RegisterHotFile(HotFile type, std::string_view path) noexcept {
+    ZoneScopedN(TracyFunction);
+    std::lock_guard lock(hotFilesLock);
+    hotFiles[static_cast<size_t>(type)] = path;
+}
+
+bool MelonDsDs::CreateSparseFile(const std::string& path, uint64_t size) noexcept {
+    ZoneScopedN(TracyFunction);
+    if (path.empty() || path_is_valid(path.c_str()))
+        return true;
+
+    RFILE* file = filestream_open(path.c_str(), RETRO_VFS_FILE_ACCESS_WRITE, RETRO_VFS_FILE_ACCESS_HINT_NONE);
+    if (!file) {
+        retro::error("Failed to create \"{}\"", path);
+        return false;
+    }
+
+    // Setting the length instead of writing zeroes leaves the whole file as a hole
+    bool ok = filestream_truncate(file, size) == 0;
+    filestream_close(file);
+    if (!ok) {
+        retro::error("Failed to extend \"{}\" to {} bytes", path, size);
+        filestream_delete(path.c_str());
+        return false;
     }
 
-    return RETRO_VFS_FILE_ACCESS_HINT_NONE;
+    retro::debug("Created sparse {}-byte file \"{}\"", size, path);
+    return true;
+}
+
+static std::optional<MelonDsDs::HotFile> GetHotFileType(const std::string& path) noexcept {
+    std::lock_guard lock(hotFilesLock);
+    auto it = std::find(hotFiles.begin(), hotFiles.end(), path);
+    if (it == hotFiles.end() || path.empty())
+        return std::nullopt;
+
+    return static_cast<MelonDsDs::HotFile>(it - hotFiles.begin());
+}
+
+unsigned GetRetroVfsFileAccessHints(bool hot) noexcept {
+    return hot ? RETRO_VFS_FILE_ACCESS_HINT_FREQUENT_ACCESS : RETRO_VFS_FILE_ACCESS_HINT_NONE;
 }
 
 constexpr unsigned GetRetroVfsFileSeekOrigin(FileSeekOrigin origin) noexcept {
@@ -84,10 +152,262 @@ constexpr unsigned GetRetroVfsFileSeekOrigin(FileSeekOrigin origin) noexcept {
 }
 
 struct melonDS::Platform::FileHandle {
-    RFILE *file;
-    unsigned hints;
+    RFILE *file = nullptr;
+    unsigned hints = 0;
+    std::string path;
+    MelonDsDs::FileIoStats stats {};
+
+    // Index into the Tracy plot names below
+    size_t plot = 0;
+
+    // If not null, all access to file goes through this
+    std::unique_ptr<MelonDsDs::BlockCache> cache;
+
+    // If not null, all reads and seeks go through this (the file is read-only)
+    std::unique_ptr<MelonDsDs::ReadAheadBuffer> readAhead;
+#ifdef HAVE_MMAP
+    // If not null, this file is memory-mapped and file is unused
+    std::byte *map = nullptr;
+    size_t size = 0;
+    size_t position = 0;
+    bool writable = false;
+#endif
 };
 
+namespace {
+    // Tracy needs plot names to outlive the plots, so they can't be built from the file names;
+    // each hot file gets its own plots, and everything else shares one set
+    constexpr std::array<const char*, 4> BytesReadPlots {
+        "DSi NAND Bytes Read", "DSi SD Card Bytes Read", "Homebrew SD Card Bytes Read", "Other File Bytes Read",
+    };
+    constexpr std::array<const char*, 4> BytesWrittenPlots {
+        "DSi NAND Bytes Written", "DSi SD Card Bytes Written", "Homebrew SD Card Bytes Written", "Other File Bytes Written",
+    };
+    constexpr std::array<const char*, 4> LatencyPlots {
+        "DSi NAND I/O Time (ms)", "DSi SD Card I/O Time (ms)", "Homebrew SD Card I/O Time (ms)", "Other File I/O Time (ms)",
+    };
+
+    struct LocalFileEntry {
+        std::string ResolvedPath;
+        bool Exists;
+    };
+
+    // Local file names (as melonDS asks for them) mapped to their paths within the system directory.
+    // Guarded by localFilesLock, since files may be opened by several loader threads at once.
+    unordered_map<std::string, LocalFileEntry> localFiles;
+    retro::slock localFilesLock;
+
+    // Stats of files closed since the last LogFileIoStats call, keyed by path
+    unordered_map<std::string, MelonDsDs::FileIoStats> closedFileStats;
+    retro::slock closedFileStatsLock;
+
+    /// Counts one call to the Platform file API and the time spent in it.
+    class IoTimer {
+    public:
+        enum class Kind { Read, Write, Seek, Flush };
+
+        IoTimer(Platform::FileHandle& file, Kind kind) noexcept : _file(file), _kind(kind), _start(steady_clock::now()) {}
+        IoTimer(const IoTimer&) = delete;
+        IoTimer& operator=(const IoTimer&) = delete;
+
+        void SetBytes(uint64_t bytes) noexcept { _bytes = bytes; }
+
+        ~IoTimer() noexcept {
+            MelonDsDs::FileIoStats& stats = _file.stats;
+            stats.Latency += steady_clock::now() - _start;
+            switch (_kind) {
+                case Kind::Read:
+                    stats.Reads++;
+                    stats.BytesRead += _bytes;
+                    TracyPlot(BytesReadPlots[_file.plot], static_cast<int64_t>(stats.BytesRead));
+                    break;
+                case Kind::Write:
+                    stats.Writes++;
+                    stats.BytesWritten += _bytes;
+                    TracyPlot(BytesWrittenPlots[_file.plot], static_cast<int64_t>(stats.BytesWritten));
+                    break;
+                case Kind::Seek:
+                    stats.Seeks++;
+                    break;
+                case Kind::Flush:
+                    stats.Flushes++;
+                    break;
+            }
+            TracyPlot(LatencyPlots[_file.plot], (duration<double, std::milli>(stats.Latency).count()));
+        }
+    private:
+        Platform::FileHandle& _file;
+        Kind _kind;
+        steady_clock::time_point _start;
+        uint64_t _bytes = 0;
+    };
+
+    size_t GetPlotIndex(std::optional<MelonDsDs::HotFile> type) noexcept {
+        return type ? static_cast<size_t>(*type) : BytesReadPlots.size() - 1;
+    }
+
+    std::string FormatFileIoStats(const MelonDsDs::FileIoStats& stats) noexcept {
+        return fmt::format(
+            "{:.2f}ms in {} reads ({} bytes), {} writes ({} bytes), {} seeks, {} flushes",
+            duration<double, std::milli>(stats.Latency).count(),
+            stats.Reads,
+            stats.BytesRead,
+            stats.Writes,
+            stats.BytesWritten,
+            stats.Seeks,
+            stats.Flushes
+        );
+    }
+}
+
+void MelonDsDs::ClearLocalFileCache() noexcept {
+    ZoneScopedN(TracyFunction);
+    std::lock_guard lock(localFilesLock);
+    localFiles.clear();
+}
+
+/// Resolves \c name against the system directory and checks whether it exists,
+/// consulting (and filling) the cache first.
+static std::optional<LocalFileEntry> ResolveLocalFile(const std::string& name) noexcept {
+    ZoneScopedN(TracyFunction);
+    {
+        std::lock_guard lock(localFilesLock);
+        if (auto it = localFiles.find(name); it != localFiles.end()) {
+            return it->second;
+        }
+    }
+
+    std::optional<std::string_view> sysdir = retro::get_system_directory();
+    if (!sysdir) {
+        retro::error("System directory not available, cannot resolve file \"{}\"", name);
+        return std::nullopt;
+    }
+
+    char fullpath[PATH_MAX];
+    size_t pathLength = fill_pathname_join_special(fullpath, sysdir->data(), name.c_str(), sizeof(fullpath));
+    pathname_make_slashes_portable(fullpath);
+
+    if (pathLength >= sizeof(fullpath)) {
+        retro::warn("Path \"{}\" is too long to be joined with system directory \"{}\"", name, *sysdir);
+    }
+
+    LocalFileEntry entry {fullpath, path_is_valid(fullpath)};
+    std::lock_guard lock(localFilesLock);
+    localFiles.insert_or_assign(name, entry);
+    return entry;
+}
+
+/// Records that the local file \c name now exists, e.g. because it was just created.
+static void MarkLocalFileExists(const std::string& name) noexcept {
+    std::lock_guard lock(localFilesLock);
+    if (auto it = localFiles.find(name); it != localFiles.end()) {
+        it->second.Exists = true;
+    }
+}
+
+MelonDsDs::FileIoStats& MelonDsDs::FileIoStats::operator+=(const FileIoStats& other) noexcept {
+    BytesRead += other.BytesRead;
+    BytesWritten += other.BytesWritten;
+    Reads += other.Reads;
+    Writes += other.Writes;
+    Seeks += other.Seeks;
+    Flushes += other.Flushes;
+    Latency += other.Latency;
+    return *this;
+}
+
+void MelonDsDs::LogFileIoStats() noexcept {
+    ZoneScopedN(TracyFunction);
+    std::vector<std::pair<std::string, FileIoStats>> files;
+    {
+        std::lock_guard lock(closedFileStatsLock);
+        files.assign(std::make_move_iterator(closedFileStats.begin()), std::make_move_iterator(closedFileStats.end()));
+        closedFileStats.clear();
+    }
+
+    if (files.empty())
+        return;
+
+    std::sort(files.begin(), files.end(), [](const auto& a, const auto& b) {
+        return a.second.Latency > b.second.Latency;
+    });
+
+    retro::info("File I/O summary ({} files, slowest first):", files.size());
+    for (const auto& [path, stats] : files) {
+        retro::info("  \"{}\": {}", path, FormatFileIoStats(stats));
+    }
+}
+
+#ifdef HAVE_MMAP
+/// Maps the entire file into memory, or returns \c nullptr if that's not possible
+/// (in which case the caller should fall back to the VFS).
+static Platform::FileHandle* OpenMappedFile(const std::string& path, FileMode mode) noexcept {
+    ZoneScopedN(TracyFunction);
+
+    if ((mode & FileMode::Write) && !(mode & FileMode::Preserve)) {
+        // If opening the file would truncate it, then the mapping would end up the wrong size
+        return nullptr;
+    }
+
+    bool writable = mode & FileMode::Write;
+    int fd = open(path.c_str(), writable ? O_RDWR : O_RDONLY); // Fails if the file doesn't exist yet, which is fine
+    if (fd < 0) {
+        retro::debug("Can't memory-map \"{}\" ({}), using the VFS instead", path, strerror(errno));
+        return nullptr;
+    }
+
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        // If the file is empty (or we don't know how big it is), then we have nothing to map
+        close(fd);
+        return nullptr;
+    }
+
+    void* map = mmap(nullptr, st.st_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps its own reference to the file
+    if (map == MAP_FAILED) {
+        retro::debug("Failed to memory-map \"{}\" ({}), using the VFS instead", path, strerror(errno));
+        return nullptr;
+    }
+
+    Platform::FileHandle *handle = new Platform::FileHandle;
+    handle->hints = GetRetroVfsFileAccessHints(true);
+    handle->map = static_cast<std::byte*>(map);
+    handle->size = st.st_size;
+    handle->writable = writable;
+    handle->path = path;
+    handle->plot = GetPlotIndex(GetHotFileType(path));
+
+    retro::debug("Memory-mapped \"{}\" ({} bytes) in FileMode {}", path, handle->size, mode);
+    return handle;
+}
+
+static size_t MappedRead(void* data, size_t length, Platform::FileHandle& file) noexcept {
+    size_t available = file.position < file.size ? file.size - file.position : 0;
+    length = std::min(length, available);
+    memcpy(data, file.map + file.position, length);
+    file.position += length;
+    return length;
+}
+
+static size_t MappedWrite(const void* data, size_t length, Platform::FileHandle& file) noexcept {
+    if (!file.writable) {
+        retro::error("Attempted to write to \"{}\", but it was opened read-only", file.path);
+        return 0;
+    }
+
+    size_t available = file.position < file.size ? file.size - file.position : 0;
+    if (length > available) {
+        retro::error("Attempted to write past the end of memory-mapped file \"{}\"", file.path);
+        length = available;
+    }
+
+    memcpy(file.map + file.position, data, length);
+    file.position += length;
+    return length;
+}
+#endif
+
 Platform::FileHandle *Platform::OpenFile(const std::string& path, FileMode mode) {
     ZoneScopedN(TracyFunction);
     if ((mode & FileMode::ReadWrite) == FileMode::None)
@@ -104,8 +424,21 @@ Platform::FileHandle *Platform::OpenFile(const std::string& path, FileMode mode)
         return nullptr;
     }
 
+    std::optional<MelonDsDs::HotFile> hotType = GetHotFileType(path);
+    bool hot = hotType.has_value();
+#ifdef HAVE_MMAP
+    if (hot && file_exists && !lowMemoryFileAccess) {
+        // If this is a file that the console will access constantly (and we can spare the address space)...
+        if (Platform::FileHandle* mapped = OpenMappedFile(path, mode)) {
+            return mapped;
+        }
+    }
+#endif
+
     Platform::FileHandle *handle = new Platform::FileHandle;
-    handle->hints = GetRetroVfsFileAccessHints(path);
+    handle->hints = GetRetroVfsFileAccessHints(hot);
+    handle->path = path;
+    handle->plot = GetPlotIndex(hotType);
     handle->file = filestream_open(path.c_str(), GetRetroVfsFileAccessFlags(mode, file_exists), handle->hints);
 
     if (!handle->file) {
@@ -114,6 +447,19 @@ Platform::FileHandle *Platform::OpenFile(const std::string& path, FileMode mode)
         return nullptr;
     }
 
+    if ((hotType == MelonDsDs::HotFile::DsiSdCard || hotType == MelonDsDs::HotFile::HomebrewSdCard) && (mode & FileMode::Write)) {
+        // If this is an SD card image that the console will be writing to one sector at a time...
+        size_t maxPages = lowMemoryFileAccess ? MelonDsDs::BlockCache::LOW_MEMORY_MAX_PAGES : MelonDsDs::BlockCache::MAX_PAGES;
+        handle->cache = std::make_unique<MelonDsDs::BlockCache>(handle->file, maxPages);
+        retro::debug("Opened \"{}\" in FileMode {} with a write-back block cache", path, mode);
+        return handle;
+    }
+
+    if (size_t window = readAheadWindow; window > 0 && !hot && !(mode & FileMode::Write)) {
+        // If this is a ROM or some other file that might be streamed from slow storage...
+        handle->readAhead = std::make_unique<MelonDsDs::ReadAheadBuffer>(handle->file, window);
+    }
+
     retro::debug("Opened \"{}\" in FileMode {}", path, mode);
 
     return handle;
@@ -125,21 +471,24 @@ Platform::FileHandle *Platform::OpenLocalFile(const std::string& path, FileMode
         return OpenFile(path, mode);
     }
 
-    std::optional<std::string_view> sysdir = retro::get_system_directory();
-    if (!sysdir) {
-        retro::error("System directory not available, cannot open file \"{}\"", path);
+    std::optional<LocalFileEntry> entry = ResolveLocalFile(path);
+    if (!entry) {
         return nullptr;
     }
 
-    char fullpath[PATH_MAX];
-    size_t pathLength = fill_pathname_join_special(fullpath, sysdir->data(), path.c_str(), sizeof(fullpath));
-    pathname_make_slashes_portable(fullpath);
+    if (!entry->Exists && (mode & FileMode::NoCreate)) {
+        // No need to ask the filesystem again
+        retro::warn("Attempted to open \"{}\" in FileMode {}, but the file doesn't exist and FileMode::NoCreate is set\n", entry->ResolvedPath, mode);
+        return nullptr;
+    }
 
-    if (pathLength >= sizeof(fullpath)) {
-        retro::warn("Path \"{}\" is too long to be joined with system directory \"{}\"", path, *sysdir);
+    FileHandle* handle = OpenFile(entry->ResolvedPath, mode);
+    if (handle && !entry->Exists) {
+        // If we just created this file...
+        MarkLocalFileExists(path);
     }
 
-    return OpenFile(fullpath, mode);
+    return handle;
 }
 
 bool Platform::FileExists(const std::string& name)
@@ -158,21 +507,8 @@ bool Platform::LocalFileExists(const std::string& name)
         return path_is_valid(name.c_str());
     }
 
-    std::optional<std::string_view> sysdir = retro::get_system_directory();
-    if (!sysdir) {
-        retro::error("System directory not available, cannot open file \"{}\"", name);
-        return false;
-    }
-
-    char fullpath[PATH_MAX];
-    size_t pathLength = fill_pathname_join_special(fullpath, sysdir->data(), name.c_str(), sizeof(fullpath));
-    pathname_make_slashes_portable(fullpath);
-
-    if (pathLength >= sizeof(fullpath)) {
-        Log(LogLevel::Warn, "Path \"%s\" is too long to be joined with system directory \"%s\"", name.c_str(), sysdir->data());
-    }
-
-    return path_is_valid(fullpath);
+    std::optional<LocalFileEntry> entry = ResolveLocalFile(name);
+    return entry && entry->Exists;
 }
 
 /// Close a file opened with \c OpenFile.
@@ -184,15 +520,39 @@ bool Platform::CloseFile(FileHandle* file)
         return false;
     }
 
-    char path[PATH_MAX];
-    strlcpy(path, filestream_get_path(file->file), sizeof(path));
+    retro::debug("I/O for \"{}\": {}", file->path, FormatFileIoStats(file->stats));
+    {
+        std::lock_guard lock(closedFileStatsLock);
+        closedFileStats[file->path] += file->stats;
+    }
+
+#ifdef HAVE_MMAP
+    if (file->map) {
+        retro::debug("Unmapping \"{}\"", file->path);
+        bool ok = munmap(file->map, file->size) == 0;
+        if (!ok) {
+            retro::error("Failed to unmap \"{}\" ({})", file->path, strerror(errno));
+        }
+        delete file;
+        return ok;
+    }
+#endif
+
+    const std::string& path = file->path;
     retro::debug("Closing \"{}\"", path);
-    bool ok = (filestream_close(file->file) == 0);
+    bool ok = true;
+    if (file->cache) {
+        // Write back whatever's still dirty before the file goes away
+        ok = file->cache->Flush();
+        file->cache = nullptr;
+    }
+    file->readAhead = nullptr; // Stops its thread before the file goes away
+    ok = (filestream_close(file->file) == 0) && ok;
 
     if (!ok) {
         retro::error("Failed to close \"{}\"", path);
     }
-    delete file;
+    delete file; // path refers to this, so don't use it after here
 
     return ok;
 }
@@ -204,6 +564,17 @@ bool Platform::IsEndOfFile(FileHandle* file)
     if (!file)
         return false;
 
+#ifdef HAVE_MMAP
+    if (file->map)
+        return file->position >= file->size;
+#endif
+
+    if (file->cache)
+        return file->cache->Position() >= file->cache->Size();
+
+    if (file->readAhead)
+        return file->readAhead->Position() >= file->readAhead->Size();
+
     return filestream_eof(file->file) == EOF;
 }
 
@@ -213,7 +584,60 @@ bool Platform::FileReadLine(char* str, int count, FileHandle* file)
     if (!file || !str)
         return false;
 
-    return filestream_gets(file->file, str, count);
+    IoTimer timer(*file, IoTimer::Kind::Read);
+
+#ifdef HAVE_MMAP
+    if (file->map) {
+        if (count <= 0 || file->position >= file->size)
+            return false;
+
+        // Like fgets, read up to and including the next newline
+        int length = 0;
+        while (length < count - 1 && file->position < file->size) {
+            char c = static_cast<char>(file->map[file->position++]);
+            str[length++] = c;
+            if (c == '\n')
+                break;
+        }
+        str[length] = '\0';
+        timer.SetBytes(length);
+        return true;
+    }
+#endif
+
+    if (file->cache) {
+        if (count <= 0)
+            return false;
+
+        int length = 0;
+        char c = '\0';
+        while (length < count - 1 && c != '\n' && file->cache->Read(&c, 1) == 1) {
+            str[length++] = c;
+        }
+        str[length] = '\0';
+        timer.SetBytes(length);
+        return length > 0;
+    }
+
+    if (file->readAhead) {
+        if (count <= 0)
+            return false;
+
+        int length = 0;
+        char c = '\0';
+        while (length < count - 1 && c != '\n' && file->readAhead->Read(&c, 1) == 1) {
+            str[length++] = c;
+        }
+        str[length] = '\0';
+        timer.SetBytes(length);
+        return length > 0;
+    }
+
+    bool ok = filestream_gets(file->file, str, count);
+    if (ok)
+        timer.SetBytes(strlen(str));
+
+    return ok;
 }
 
 bool Platform::FileSeek(FileHandle* file, s64 offset, FileSeekOrigin origin)
@@ -222,14 +646,61 @@ bool Platform::FileSeek(FileHandle* file, s64 offset, FileSeekOrigin origin)
     if (!file)
         return false;
 
+    IoTimer timer(*file, IoTimer::Kind::Seek);
+
+#ifdef HAVE_MMAP
+    if (file->map) {
+        s64 base = 0;
+        switch (origin) {
+            case FileSeekOrigin::Start: base = 0; break;
+            case FileSeekOrigin::Current: base = file->position; break;
+            case FileSeekOrigin::End: base = file->size; break;
+            default: return false;
+        }
+
+        if (base + offset < 0)
+            return false;
+
+        file->position = base + offset;
+        return true;
+    }
+#endif
+
+    if (file->cache)
+        return file->cache->Seek(offset, GetRetroVfsFileSeekOrigin(origin));
+
+    if (file->readAhead)
+        return file->readAhead->Seek(offset, GetRetroVfsFileSeekOrigin(origin));
+
     return filestream_seek(file->file, offset, GetRetroVfsFileSeekOrigin(origin)) == 0;
 }
 
 void Platform::FileRewind(FileHandle* file)
 {
     ZoneScopedN(TracyFunction);
-    if (file)
-        filestream_rewind(file->file);
+    if (!file)
+        return;
+
+    IoTimer timer(*file, IoTimer::Kind::Seek);
+
+#ifdef HAVE_MMAP
+    if (file->map) {
+        file->position = 0;
+        return;
+    }
+#endif
+
+    if (file->cache) {
+        file->cache->Seek(0, RETRO_VFS_SEEK_POSITION_START);
+        return;
+    }
+
+    if (file->readAhead) {
+        file->readAhead->Seek(0, RETRO_VFS_SEEK_POSITION_START);
+        return;
+    }
+
+    filestream_rewind(file->file);
 }
 
 u64 Platform::FileRead(void* data, u64 size, u64 count, FileHandle* file)
@@ -238,6 +709,30 @@ u64 Platform::FileRead(void* data, u64 size, u64 count, FileHandle* file)
     if (!file || !data)
         return 0;
 
+    IoTimer timer(*file, IoTimer::Kind::Read);
+
+#ifdef HAVE_MMAP
+    if (file->map) {
+        size_t bytesRead = MappedRead(data, size * count, *file);
+        if (bytesRead != size * count) {
+            retro::warn("Read {} bytes from file \"{}\", expected {}", bytesRead, file->path, size * count);
+        }
+
+        timer.SetBytes(bytesRead);
+        return bytesRead / size;
+    }
+#endif
+
+    if (file->cache || file->readAhead) {
+        size_t bytesRead = file->cache ? file->cache->Read(data, size * count) : file->readAhead->Read(data, size * count);
+        if (bytesRead != size * count) {
+            retro::warn("Read {} bytes from file \"{}\", expected {}", bytesRead, filestream_get_path(file->file), size * count);
+        }
+
+        timer.SetBytes(bytesRead);
+        return bytesRead / size;
+    }
+
     int64_t bytesRead = filestream_read(file->file, data, size * count);
     if (bytesRead < 0) {
         retro::error("Failed to read from file \"{}\"", filestream_get_path(file->file));
@@ -245,6 +740,7 @@ u64 Platform::FileRead(void* data, u64 size, u64 count, FileHandle* file)
         retro::warn("Read {} bytes from file \"{}\", expected {}", bytesRead, filestream_get_path(file->file), size * count);
     }
 
+    timer.SetBytes(std::max<int64_t>(bytesRead, 0));
     return bytesRead / size;
 }
 
@@ -254,6 +750,18 @@ bool Platform::FileFlush(FileHandle* file)
     if (!file)
         return false;
 
+    IoTimer timer(*file, IoTimer::Kind::Flush);
+
+#ifdef HAVE_MMAP
+    if (file->map) {
+        // Schedule the write-back without waiting for it; the mapping is already coherent with the file
+        return !file->writable || msync(file->map, file->size, MS_ASYNC) == 0;
+    }
+#endif
+
+    if (file->cache)
+        return file->cache->Flush();
+
     return filestream_flush(file->file) == 0;
 }
 
@@ -263,8 +771,19 @@ u64 Platform::FileWrite(const void* data, u64 size, u64 count, FileHandle* file)
     if (!file || !data)
         return 0;
 
-    u64 bytesWritten = filestream_write(file->file, data, size * count);
-
+    IoTimer timer(*file, IoTimer::Kind::Write);
+    u64 bytesWritten = 0;
+#ifdef HAVE_MMAP
+    if (file->map)
+        bytesWritten = MappedWrite(data, size * count, *file);
+    else
+#endif
+    if (file->cache)
+        bytesWritten = file->cache->Write(data, size * count);
+    else
+        bytesWritten = std::max<int64_t>(filestream_write(file->file, data, size * count), 0);
+
+    timer.SetBytes(bytesWritten);
     return bytesWritten / size;
 }
 
@@ -276,7 +795,29 @@ u64 Platform::FileWriteFormatted(FileHandle* file, const char* fmt, ...)
 
     va_list args;
     va_start(args, fmt);
-    u64 ret = filestream_vprintf(file->file, fmt, args);
+    u64 ret = 0;
+    if (file->cache
+#ifdef HAVE_MMAP
+        || file->map
+#endif
+    ) {
+        // If we're not writing through the VFS, format the text ourselves
+        va_list copy;
+        va_copy(copy, args);
+        int length = vsnprintf(nullptr, 0, fmt, copy);
+        va_end(copy);
+
+        if (length > 0) {
+            std::vector<char> text(length + 1);
+            vsnprintf(text.data(), text.size(), fmt, args);
+            ret = FileWrite(text.data(), 1, length, file);
+        }
+    }
+    else {
+        IoTimer timer(*file, IoTimer::Kind::Write);
+        ret = filestream_vprintf(file->file, fmt, args);
+        timer.SetBytes(ret);
+    }
     va_end(args);
     return ret;
 }
@@ -287,6 +828,17 @@ u64 Platform::FileLength(FileHandle* file)
     if (!file)
         return 0;
 
+#ifdef HAVE_MMAP
+    if (file->map)
+        return file->size;
+#endif
+
+    if (file->cache)
+        return file->cache->Size();
+
+    if (file->readAhead)
+        return file->readAhead->Size();
+
     int64_t size = filestream_get_size(file->file);
     if (filestream_error(file->file)) {
         retro::error("Failed to get size of file \"{}\"", filestream_get_path(file->file));
@@ -0,0 +1,83 @@
+/*
+    Copyright 2024 Jesse Talavera
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace MelonDsDs
+{
+    /// Files that the emulated console reads and writes constantly while it runs.
+    enum class HotFile
+    {
+        DsiNand,
+        DsiSdCard,
+        HomebrewSdCard,
+    };
+
+    /// Marks \c path as the file that currently serves as \c type,
+    /// replacing whichever file was registered as \c type before.
+    /// While registered, \c Platform::OpenFile memory-maps the file if it can
+    /// instead of accessing it through the frontend's VFS.
+    /// Pass an empty path to unregister \c type.
+    void RegisterHotFile(HotFile type, std::string_view path) noexcept;
+
+    /// If enabled, hot files opened afterwards are accessed through the frontend's VFS
+    /// instead of being memory-mapped, and SD card images get a smaller block cache,
+    /// so that multi-gigabyte disk images don't compete with the console for memory.
+    void SetLowMemoryFileAccess(bool enabled) noexcept;
+
+    /// Sets how many bytes at a time are read ahead from files that are opened read-only
+    /// (other than hot files) and then read sequentially, such as ROMs and firmware.
+    /// Affects files opened afterwards; 0 disables read-ahead.
+    void SetFileReadAheadWindow(size_t bytes) noexcept;
+
+    /// Creates \c path as a zero-filled file of \c size bytes without writing any of it,
+    /// so that the host only allocates the file's blocks as they're written
+    /// (on file systems that support sparse files).
+    /// Does nothing if \c path already exists.
+    /// @returns \c false if the file didn't exist and couldn't be created.
+    bool CreateSparseFile(const std::string& path, uint64_t size) noexcept;
+
+    /// Forgets the resolved paths and existence checks cached by
+    /// \c Platform::OpenLocalFile and \c Platform::LocalFileExists.
+    /// Called when content is loaded or unloaded, since either may change the system directory's contents.
+    void ClearLocalFileCache() noexcept;
+
+    /// I/O counters for a file opened with \c Platform::OpenFile,
+    /// covering every read, write, seek, and flush made through the \c Platform file API.
+    struct FileIoStats {
+        uint64_t BytesRead = 0;
+        uint64_t BytesWritten = 0;
+        uint64_t Reads = 0;
+        uint64_t Writes = 0;
+        uint64_t Seeks = 0;
+        uint64_t Flushes = 0;
+
+        /// Total time spent inside those calls.
+        std::chrono::nanoseconds Latency {};
+
+        FileIoStats& operator+=(const FileIoStats& other) noexcept;
+    };
+
+    /// Logs the I/O counters of every file closed since the last call,
+    /// sorted by how much time was spent on each, then forgets them.
+    void LogFileIoStats() noexcept;
+}
@@ -0,0 +1,332 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "memory.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <sys/sysctl.h>
+#include <sys/types.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#ifdef HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "environment.hpp"
+#include "retro/threads.hpp"
+#include "tracy.hpp"
+
+namespace {
+    /// Every live SharedFileMapping, so GetSharedMappingUsage can find them in smaps.
+    struct SharedMappingRegistry {
+        std::vector<std::pair<const std::byte*, size_t>> Mappings;
+        retro::slock Lock;
+    };
+
+    std::atomic_bool fileSharingEnabled = true;
+
+    SharedMappingRegistry& GetSharedMappings() noexcept {
+        // Never destroyed, since static caches in other files may unmap their files during exit
+        static auto* registry = new SharedMappingRegistry;
+        return *registry;
+    }
+}
+
+std::optional<uint64_t> MelonDsDs::memory::GetPhysicalMemory() noexcept {
+#ifdef _WIN32
+    MEMORYSTATUSEX status {};
+    status.dwLength = sizeof(status);
+    if (GlobalMemoryStatusEx(&status)) {
+        return status.ullTotalPhys;
+    }
+#elif defined(__APPLE__)
+    uint64_t memory = 0;
+    size_t length = sizeof(memory);
+    if (sysctlbyname("hw.memsize", &memory, &length, nullptr, 0) == 0) {
+        return memory;
+    }
+#elif defined(_SC_PHYS_PAGES) && defined(_SC_PAGESIZE)
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && pageSize > 0) {
+        return static_cast<uint64_t>(pages) * static_cast<uint64_t>(pageSize);
+    }
+#endif
+
+    return std::nullopt;
+}
+
+bool MelonDsDs::memory::IsLowMemoryDevice() noexcept {
+    static const bool lowMemory = [] {
+        std::optional<uint64_t> memory = GetPhysicalMemory();
+        if (!memory) {
+            retro::debug("Couldn't query the amount of physical memory; assuming it's not a low-memory device");
+            return false;
+        }
+
+        bool low = *memory <= LOW_MEMORY_THRESHOLD;
+        retro::debug("Host has {} MiB of physical memory{}", *memory / (1024 * 1024), low ? " (low-memory device)" : "");
+        return low;
+    }();
+
+    return lowMemory;
+}
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+static MelonDsDs::memory::HugePageStatus GetTransparentHugePageMode() noexcept {
+    using enum MelonDsDs::memory::HugePageStatus;
+    // Looks like "always [madvise] never", with the active mode in brackets
+    FILE* file = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if (!file)
+        return Unsupported;
+
+    char mode[64] {};
+    bool read = fgets(mode, sizeof(mode), file) != nullptr;
+    fclose(file);
+    if (!read)
+        return Unsupported;
+
+    return strstr(mode, "[never]") ? Disabled : Advised;
+}
+
+static size_t GetHugePageSize() noexcept {
+    constexpr size_t DEFAULT_HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+    FILE* file = fopen("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r");
+    if (!file)
+        return DEFAULT_HUGE_PAGE_SIZE;
+
+    unsigned long size = 0;
+    bool read = fscanf(file, "%lu", &size) == 1;
+    fclose(file);
+    return read && size > 0 ? size : DEFAULT_HUGE_PAGE_SIZE;
+}
+#endif
+
+MelonDsDs::memory::HugePageStatus MelonDsDs::memory::AdviseHugePages(void* ptr, size_t size) noexcept {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (!ptr || size == 0)
+        return HugePageStatus::TooSmall;
+
+    static const HugePageStatus mode = GetTransparentHugePageMode();
+    if (mode != HugePageStatus::Advised)
+        return mode;
+
+    static const size_t hugePageSize = GetHugePageSize();
+    uintptr_t start = reinterpret_cast<uintptr_t>(ptr);
+    uintptr_t alignedStart = (start + hugePageSize - 1) & ~(hugePageSize - 1);
+    uintptr_t alignedEnd = (start + size) & ~(hugePageSize - 1);
+    if (alignedStart >= alignedEnd)
+        return HugePageStatus::TooSmall;
+
+    if (madvise(reinterpret_cast<void*>(alignedStart), alignedEnd - alignedStart, MADV_HUGEPAGE) != 0) {
+        retro::debug("madvise(MADV_HUGEPAGE) failed for {} bytes at {}: {}", alignedEnd - alignedStart, ptr, strerror(errno));
+        return HugePageStatus::Failed;
+    }
+
+    return HugePageStatus::Advised;
+#else
+    (void)ptr;
+    (void)size;
+    return HugePageStatus::Unsupported;
+#endif
+}
+
+std::optional<size_t> MelonDsDs::memory::GetHugePageBytes(const void* ptr, size_t size) noexcept {
+#ifdef __linux__
+    FILE* file = fopen("/proc/self/smaps", "r");
+    if (!file)
+        return std::nullopt;
+
+    uintptr_t start = reinterpret_cast<uintptr_t>(ptr);
+    uintptr_t end = start + size;
+    bool overlaps = false;
+    size_t hugeBytes = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        unsigned long mapStart = 0, mapEnd = 0;
+        unsigned long kib = 0;
+        if (sscanf(line, "%lx-%lx ", &mapStart, &mapEnd) == 2) {
+            // If this line starts a new mapping...
+            overlaps = mapStart < end && start < mapEnd;
+        }
+        else if (overlaps && (
+            sscanf(line, "AnonHugePages: %lu kB", &kib) == 1 ||
+            sscanf(line, "ShmemPmdMapped: %lu kB", &kib) == 1 ||
+            sscanf(line, "FilePmdMapped: %lu kB", &kib) == 1
+        )) {
+            hugeBytes += kib * 1024;
+        }
+    }
+    fclose(file);
+
+    return std::min(hugeBytes, size);
+#else
+    (void)ptr;
+    (void)size;
+    return std::nullopt;
+#endif
+}
+
+MelonDsDs::memory::SharedFileMapping MelonDsDs::memory::SharedFileMapping::Open(const char* path) noexcept {
+    ZoneScopedN(TracyFunction);
+#ifdef HAVE_MMAP
+    if (!path || !fileSharingEnabled.load(std::memory_order_relaxed))
+        return {};
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return {};
+
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return {};
+    }
+
+    void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps its own reference to the file
+    if (map == MAP_FAILED) {
+        retro::debug("Failed to map \"{}\" ({}); reading it instead", path, strerror(errno));
+        return {};
+    }
+
+    retro::debug("Mapped {} bytes of \"{}\" for sharing", st.st_size, path);
+    return {static_cast<const std::byte*>(map), static_cast<size_t>(st.st_size)};
+#else
+    (void)path;
+    return {};
+#endif
+}
+
+MelonDsDs::memory::SharedFileMapping::SharedFileMapping(const std::byte* data, size_t size) noexcept : _data(data), _size(size) {
+    SharedMappingRegistry& registry = GetSharedMappings();
+    std::lock_guard lock(registry.Lock);
+    registry.Mappings.emplace_back(_data, _size);
+}
+
+MelonDsDs::memory::SharedFileMapping::~SharedFileMapping() noexcept {
+    Reset();
+}
+
+MelonDsDs::memory::SharedFileMapping::SharedFileMapping(SharedFileMapping&& other) noexcept :
+    _data(std::exchange(other._data, nullptr)),
+    _size(std::exchange(other._size, 0)) {
+}
+
+MelonDsDs::memory::SharedFileMapping& MelonDsDs::memory::SharedFileMapping::operator=(SharedFileMapping&& other) noexcept {
+    if (this != &other) {
+        Reset();
+        _data = std::exchange(other._data, nullptr);
+        _size = std::exchange(other._size, 0);
+    }
+    return *this;
+}
+
+void MelonDsDs::memory::SharedFileMapping::Reset() noexcept {
+    if (!_data)
+        return;
+
+    {
+        SharedMappingRegistry& registry = GetSharedMappings();
+        std::lock_guard lock(registry.Lock);
+        auto it = std::find(registry.Mappings.begin(), registry.Mappings.end(), std::make_pair(_data, _size));
+        if (it != registry.Mappings.end()) {
+            registry.Mappings.erase(it);
+        }
+    }
+
+#ifdef HAVE_MMAP
+    if (munmap(const_cast<std::byte*>(_data), _size) != 0) {
+        retro::error("Failed to unmap {} bytes at {} ({})", _size, static_cast<const void*>(_data), strerror(errno));
+    }
+#endif
+    _data = nullptr;
+    _size = 0;
+}
+
+MelonDsDs::memory::SharedMappingUsage MelonDsDs::memory::GetSharedMappingUsage() noexcept {
+    ZoneScopedN(TracyFunction);
+    SharedMappingUsage usage {};
+    SharedMappingRegistry& registry = GetSharedMappings();
+    std::lock_guard lock(registry.Lock);
+    const auto& sharedMappings = registry.Mappings;
+    usage.Mappings = sharedMappings.size();
+    for (const auto& [data, size] : sharedMappings) {
+        usage.MappedBytes += size;
+    }
+
+#ifdef __linux__
+    if (sharedMappings.empty())
+        return usage;
+
+    FILE* file = fopen("/proc/self/smaps", "r");
+    if (!file)
+        return usage;
+
+    bool overlaps = false;
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        unsigned long mapStart = 0, mapEnd = 0;
+        unsigned long clean = 0, dirty = 0;
+        if (sscanf(line, "%lx-%lx ", &mapStart, &mapEnd) == 2) {
+            // If this line starts a new mapping...
+            overlaps = std::any_of(sharedMappings.begin(), sharedMappings.end(), [&](const auto& mapping) {
+                uintptr_t start = reinterpret_cast<uintptr_t>(mapping.first);
+                return mapStart < start + mapping.second && start < mapEnd;
+            });
+        }
+        else if (overlaps && sscanf(line, "Shared_Clean: %lu kB", &clean) == 1) {
+            usage.SharedBytes += clean * 1024;
+        }
+        else if (overlaps && sscanf(line, "Shared_Dirty: %lu kB", &dirty) == 1) {
+            usage.SharedBytes += dirty * 1024;
+        }
+        else if (overlaps && sscanf(line, "Private_Clean: %lu kB", &clean) == 1) {
+            usage.PrivateBytes += clean * 1024;
+        }
+        else if (overlaps && sscanf(line, "Private_Dirty: %lu kB", &dirty) == 1) {
+            usage.PrivateBytes += dirty * 1024;
+        }
+    }
+    fclose(file);
+#endif
+
+    return usage;
+}
+
+void MelonDsDs::memory::SetFileSharingEnabled(bool enabled) noexcept {
+    fileSharingEnabled.store(enabled, std::memory_order_relaxed);
+}
@@ -0,0 +1,118 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#ifndef MELONDS_DS_MEMORY_HPP
+#define MELONDS_DS_MEMORY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "std/span.hpp"
+
+namespace MelonDsDs::memory {
+    /// Devices with no more physical memory than this get low-memory mode
+    /// if the \c melonds_low_memory_mode option is set to "auto".
+    /// About 1.5 GiB, so that 1 GiB devices qualify even if they report a bit more than that.
+    constexpr uint64_t LOW_MEMORY_THRESHOLD = 1536ull * 1024 * 1024;
+
+    /// The host's physical memory in bytes, or \c nullopt if it can't be queried on this platform.
+    [[nodiscard]] std::optional<uint64_t> GetPhysicalMemory() noexcept;
+
+    /// \c true if the host's physical memory is at most \c LOW_MEMORY_THRESHOLD.
+    /// Queried once, then cached.
+    [[nodiscard]] bool IsLowMemoryDevice() noexcept;
+
+    enum class HugePageStatus : uint8_t {
+        /// This platform can't give huge pages to memory that's already allocated
+        Unsupported,
+        /// The OS supports huge pages, but they're turned off
+        Disabled,
+        /// The region is too small or misaligned to contain a whole huge page
+        TooSmall,
+        /// The OS accepted the request; it may promote the region's pages whenever it likes
+        Advised,
+        Failed,
+    };
+
+    constexpr const char* GetHugePageStatusName(HugePageStatus status) noexcept {
+        switch (status) {
+            case HugePageStatus::Disabled: return "disabled";
+            case HugePageStatus::TooSmall: return "too small";
+            case HugePageStatus::Advised: return "advised";
+            case HugePageStatus::Failed: return "failed";
+            default: return "unsupported";
+        }
+    }
+
+    /// Asks the OS to back as much of the given region as it can with transparent huge pages,
+    /// to cut down on TLB misses when it's accessed randomly.
+    /// Only whole huge pages within the region are affected.
+    HugePageStatus AdviseHugePages(void* ptr, size_t size) noexcept;
+
+    /// How many bytes of the mappings that overlap the given region are currently backed by huge pages
+    /// (capped at \c size), or \c nullopt if this platform can't tell.
+    [[nodiscard]] std::optional<size_t> GetHugePageBytes(const void* ptr, size_t size) noexcept;
+
+    /// A read-only mapping of an entire file, shared with every other process that maps the same file
+    /// (e.g. other instances of the core loading the same BIOS or ROM),
+    /// so that they all use one physical copy from the OS's page cache.
+    /// Anything that needs to modify the contents must copy them first.
+    ///
+    /// If the file is truncated while it's mapped, reading the lost pages raises \c SIGBUS;
+    /// that's why \c SetFileSharingEnabled can turn this off.
+    class SharedFileMapping {
+    public:
+        /// \returns An empty mapping if the file is empty, doesn't exist, sharing is disabled,
+        /// or it can't be mapped on this platform (in which case the caller should read it normally).
+        [[nodiscard]] static SharedFileMapping Open(const char* path) noexcept;
+
+        SharedFileMapping() noexcept = default;
+        ~SharedFileMapping() noexcept;
+        SharedFileMapping(const SharedFileMapping&) = delete;
+        SharedFileMapping& operator=(const SharedFileMapping&) = delete;
+        SharedFileMapping(SharedFileMapping&& other) noexcept;
+        SharedFileMapping& operator=(SharedFileMapping&& other) noexcept;
+
+        explicit operator bool() const noexcept { return _data != nullptr; }
+        [[nodiscard]] std::span<const std::byte> Data() const noexcept { return {_data, _size}; }
+    private:
+        SharedFileMapping(const std::byte* data, size_t size) noexcept;
+        void Reset() noexcept;
+
+        const std::byte* _data = nullptr;
+        size_t _size = 0;
+    };
+
+    struct SharedMappingUsage {
+        /// Live \c SharedFileMapping objects, and how many bytes of files they map in total
+        int64_t Mappings;
+        int64_t MappedBytes;
+
+        /// Of the mapped pages that are resident, how many bytes are also mapped by another process,
+        /// and how many only by this one; both are 0 if this platform can't tell.
+        int64_t SharedBytes;
+        int64_t PrivateBytes;
+    };
+
+    [[nodiscard]] SharedMappingUsage GetSharedMappingUsage() noexcept;
+
+    /// Whether \c SharedFileMapping::Open maps files at all; existing mappings aren't affected.
+    void SetFileSharingEnabled(bool enabled) noexcept;
+}
+
+#endif // MELONDS_DS_MEMORY_HPP
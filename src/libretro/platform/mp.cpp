@@ -16,6 +16,7 @@
 
 #include <Platform.h>
 #include "tracy.hpp"
+#include "tracy/memory.hpp"
 #include "core/core.hpp"
 #include "environment.hpp"
 #include <fmt/base.h>
@@ -23,6 +24,12 @@
 
 using namespace melonDS;
 
+#ifdef HAVE_MP_SHARED_MEMORY
+namespace MelonDsDs {
+    extern CoreState& Core;
+}
+#endif
+
 constexpr retro_fastforwarding_override FASTFORWARD_OVERRIDE_FORBIDDEN = {
     1.0f,
     false,
@@ -32,6 +39,19 @@ constexpr retro_fastforwarding_override FASTFORWARD_OVERRIDE_FORBIDDEN = {
 
 void MelonDsDs::CoreState::MpStarted(retro_netpacket_send_t send, retro_netpacket_poll_receive_t poll_receive) noexcept {
     ZoneScopedN(TracyFunction);
+#ifdef HAVE_MP_SHARED_MEMORY
+    if (_shmTransport.IsOpen()) {
+        // If we're already exchanging packets with other instances on this machine...
+        retro::warn("Ignoring netplay's multiplayer session, since the shared-memory transport is in use");
+        return;
+    }
+#endif
+    StartMp(send, poll_receive);
+}
+
+void MelonDsDs::CoreState::StartMp(retro_netpacket_send_t send, retro_netpacket_poll_receive_t poll_receive) noexcept {
+    ZoneScopedN(TracyFunction);
+    MemoryScope memory(MemoryTag::Network);
     _mpState.SetSendFn(send);
     _mpState.SetPollFn(poll_receive);
     if (retro::set_fastforwarding_override(FASTFORWARD_OVERRIDE_FORBIDDEN)) {
@@ -45,42 +65,109 @@ void MelonDsDs::CoreState::MpStarted(retro_netpacket_send_t send, retro_netpacke
 
 void MelonDsDs::CoreState::MpPacketReceived(const void *buf, size_t len, uint16_t client_id) noexcept {
     ZoneScopedN(TracyFunction);
+    MemoryScope memory(MemoryTag::Network);
+#ifdef HAVE_MP_SHARED_MEMORY
+    if (_shmTransport.IsOpen()) {
+        return;
+    }
+#endif
     _mpState.PacketReceived(buf, len, client_id);
 }
 
 void MelonDsDs::CoreState::MpStopped() noexcept {
     ZoneScopedN(TracyFunction);
+#ifdef HAVE_MP_SHARED_MEMORY
+    if (_shmTransport.IsOpen()) {
+        return;
+    }
+#endif
+    StopMp();
+}
+
+void MelonDsDs::CoreState::StopMp() noexcept {
+    ZoneScopedN(TracyFunction);
+    if (_mpState.IsReady()) {
+        _mpState.LogStats(RETRO_LOG_INFO);
+    }
     _mpState.SetSendFn(nullptr);
     _mpState.SetPollFn(nullptr);
     retro::clear_fastforwarding_override();
     retro::info("Stopping multiplayer on libretro side");
 }
 
-bool MelonDsDs::CoreState::MpSendPacket(const MelonDsDs::Packet &p) noexcept {
+#ifdef HAVE_MP_SHARED_MEMORY
+void MelonDsDs::CoreState::StartSharedMemoryMp() noexcept {
+    ZoneScopedN(TracyFunction);
+    if (_mpState.IsReady()) {
+        // If netplay already started a session before the game was loaded...
+        retro::warn("Leaving netplay's multiplayer session in favor of the shared-memory transport");
+        StopMp();
+    }
+
+    // (A lambda so the transport's packets don't go through MpPacketReceived, which ignores the frontend's)
+    auto received = [](const void *buf, size_t len, uint16_t client_id) {
+        MelonDsDs::Core._mpState.PacketReceived(buf, len, client_id);
+    };
+
+    if (!_shmTransport.Open(received)) {
+        retro::set_error_message("Couldn't start shared-memory local multiplayer. See the log for details.");
+        return;
+    }
+
+    StartMp(ShmTransport::Send, ShmTransport::Poll);
+    _mpState.SetWaitFn(ShmTransport::Wait);
+}
+
+void MelonDsDs::CoreState::StopSharedMemoryMp() noexcept {
+    ZoneScopedN(TracyFunction);
+    if (!_shmTransport.IsOpen()) {
+        return;
+    }
+
+    StopMp();
+    _mpState.SetWaitFn(nullptr);
+    _shmTransport.Close();
+}
+#endif
+
+bool MelonDsDs::CoreState::MpSendPacket(std::span<const uint8_t> data, uint64_t timestamp, uint8_t aid, Packet::Type type) noexcept {
     ZoneScopedN(TracyFunction);
+    MemoryScope memory(MemoryTag::Network);
     if(!_mpState.IsReady()) {
         return false;
     }
-    _mpState.SendPacket(p);
+    _mpState.SendPacket(data, timestamp, aid, type);
     return true;
 }
 
-std::optional<MelonDsDs::Packet> MelonDsDs::CoreState::MpNextPacket() noexcept {
+const MelonDsDs::Packet* MelonDsDs::CoreState::MpNextPacket() noexcept {
     ZoneScopedN(TracyFunction);
     if(!_mpState.IsReady()) {
-        return std::nullopt;
+        return nullptr;
     }
     return _mpState.NextPacket();
 }
 
-std::optional<MelonDsDs::Packet> MelonDsDs::CoreState::MpNextPacketBlock() noexcept {
+const MelonDsDs::Packet* MelonDsDs::CoreState::MpNextPacketBlock() noexcept {
     ZoneScopedN(TracyFunction);
     if(!_mpState.IsReady()) {
-        return std::nullopt;
+        return nullptr;
     }
     return _mpState.NextPacketBlock();
 }
 
+void MelonDsDs::CoreState::MpPopPacket() noexcept {
+    _mpState.PopPacket();
+}
+
+uint16_t MelonDsDs::CoreState::MpRecvReplies(uint8_t* packets, uint64_t timestamp, uint16_t aidmask) noexcept {
+    ZoneScopedN(TracyFunction);
+    if(!_mpState.IsReady()) {
+        return 0;
+    }
+    return _mpState.RecvReplies(packets, timestamp, aidmask);
+}
+
 bool MelonDsDs::CoreState::MpActive() const noexcept {
     return _mpState.IsReady();
 }
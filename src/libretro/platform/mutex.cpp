@@ -16,14 +16,16 @@
 
 #include <Platform.h>
 
-#include "retro/threads.hpp"
+#include "sync.hpp"
 #include "tracy.hpp"
 
 using namespace melonDS;
 using Platform::Mutex;
 
+// Only creation and destruction are instrumented, since locking is on melonDS's hot paths
+// (Tracy builds still see contention through TracyLockable)
 struct Platform::Mutex {
-    TracyLockable(retro::slock, mutex);
+    TracyLockable(MelonDsDs::LightMutex, mutex);
 };
 
 Mutex* Platform::Mutex_Create()
@@ -40,12 +42,10 @@ void Platform::Mutex_Free(Mutex* mutex)
 
 void Platform::Mutex_Lock(Mutex* mutex)
 {
-    ZoneScopedN(TracyFunction);
     mutex->mutex.lock();
 }
 
 void Platform::Mutex_Unlock(Mutex* mutex)
 {
-    ZoneScopedN(TracyFunction);
     mutex->mutex.unlock();
 }
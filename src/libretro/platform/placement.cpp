@@ -0,0 +1,226 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "placement.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+
+#include "environment.hpp"
+#include "tracy.hpp"
+
+using MelonDsDs::ThreadPlacement;
+using std::optional;
+
+namespace {
+    /// The host's cores, split by how fast they are.
+    struct CpuTopology {
+        cpu_set_t Original;
+        cpu_set_t Performance;
+        cpu_set_t Efficiency;
+
+        /// False if every core is alike (or we couldn't tell them apart),
+        /// in which case placement requests are ignored
+        bool Heterogeneous;
+    };
+
+    std::mutex placementLock;
+    std::vector<pid_t> renderThreads;
+    ThreadPlacement renderPlacement = ThreadPlacement::Any;
+}
+
+static const char* PlacementName(ThreadPlacement placement) noexcept {
+    switch (placement) {
+        case ThreadPlacement::Performance:
+            return "performance cores";
+        case ThreadPlacement::Efficiency:
+            return "efficiency cores";
+        default:
+            return "any core";
+    }
+}
+
+static pid_t CurrentThreadId() noexcept {
+    return static_cast<pid_t>(syscall(SYS_gettid));
+}
+
+// Reads a single unsigned integer from a sysfs file
+static optional<unsigned long> ReadCpuAttribute(int cpu, const char* attribute) noexcept {
+    char path[96];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/%s", cpu, attribute);
+    FILE* file = fopen(path, "r");
+    if (!file)
+        return std::nullopt;
+
+    unsigned long value = 0;
+    bool read = fscanf(file, "%lu", &value) == 1;
+    fclose(file);
+    return read ? optional(value) : std::nullopt;
+}
+
+static CpuTopology DetectTopology() noexcept {
+    ZoneScopedN(TracyFunction);
+    CpuTopology topology {};
+    CPU_ZERO(&topology.Performance);
+    CPU_ZERO(&topology.Efficiency);
+
+    if (sched_getaffinity(0, sizeof(topology.Original), &topology.Original) != 0) {
+        retro::warn("Couldn't get the thread's CPU affinity (error {}); thread placement is unavailable", errno);
+        topology.Heterogeneous = false;
+        return topology;
+    }
+
+    // Prefer the scheduler's own capacity estimate (set on big.LITTLE and other hybrid ARM SoCs),
+    // but fall back to each core's maximum clock speed where the kernel doesn't expose it.
+    const char* attributes[] = {"cpu_capacity", "cpufreq/cpuinfo_max_freq"};
+    int cpuCount = std::clamp<int>(sysconf(_SC_NPROCESSORS_CONF), 0, CPU_SETSIZE);
+    std::vector<unsigned long> ratings; // Only cores we're allowed to run on are rated; the rest stay at 0
+    for (const char* attribute : attributes) {
+        ratings.assign(cpuCount, 0);
+        bool complete = true;
+        for (int cpu = 0; cpu < cpuCount && complete; ++cpu) {
+            if (CPU_ISSET(cpu, &topology.Original)) {
+                optional<unsigned long> rating = ReadCpuAttribute(cpu, attribute);
+                complete = rating.has_value();
+                ratings[cpu] = rating.value_or(0);
+            }
+        }
+
+        if (!complete)
+            ratings.clear();
+        else
+            break;
+    }
+
+    unsigned long slowest = ULONG_MAX;
+    unsigned long fastest = 0;
+    for (unsigned long rating : ratings) {
+        if (rating > 0) {
+            slowest = std::min(slowest, rating);
+            fastest = std::max(fastest, rating);
+        }
+    }
+
+    if (fastest == 0 || slowest == fastest) {
+        retro::info("All of this device's CPU cores are alike; thread placement options will have no effect");
+        topology.Heterogeneous = false;
+        return topology;
+    }
+
+    // Treat the slowest cluster as the efficiency cores and everything else as performance cores,
+    // so that mid-tier cores on three-cluster SoCs still count as fast
+    for (size_t cpu = 0; cpu < ratings.size(); ++cpu) {
+        if (ratings[cpu] > 0) {
+            CPU_SET(cpu, ratings[cpu] == slowest ? &topology.Efficiency : &topology.Performance);
+        }
+    }
+
+    retro::info(
+        "Found {} performance and {} efficiency CPU cores",
+        CPU_COUNT(&topology.Performance),
+        CPU_COUNT(&topology.Efficiency)
+    );
+    topology.Heterogeneous = true;
+    return topology;
+}
+
+static const CpuTopology& GetTopology() noexcept {
+    // Detected on first use, which is on the emulation thread before any render thread is placed
+    static const CpuTopology topology = DetectTopology();
+    return topology;
+}
+
+static const cpu_set_t& GetMask(const CpuTopology& topology, ThreadPlacement placement) noexcept {
+    switch (placement) {
+        case ThreadPlacement::Performance:
+            return topology.Performance;
+        case ThreadPlacement::Efficiency:
+            return topology.Efficiency;
+        default:
+            return topology.Original;
+    }
+}
+
+static bool Place(pid_t tid, ThreadPlacement placement) noexcept {
+    const CpuTopology& topology = GetTopology();
+    if (!topology.Heterogeneous)
+        return false;
+
+    const cpu_set_t& mask = GetMask(topology, placement);
+    if (sched_setaffinity(tid, sizeof(mask), &mask) != 0) {
+        retro::warn("Couldn't move thread {} to {} (error {})", tid, PlacementName(placement), errno);
+        return false;
+    }
+
+    return true;
+}
+
+void MelonDsDs::placement::RegisterRenderThread() noexcept {
+    pid_t tid = CurrentThreadId();
+    std::lock_guard lock(placementLock);
+    renderThreads.push_back(tid);
+    if (renderPlacement != ThreadPlacement::Any) {
+        Place(tid, renderPlacement);
+    }
+}
+
+void MelonDsDs::placement::UnregisterRenderThread() noexcept {
+    pid_t tid = CurrentThreadId();
+    std::lock_guard lock(placementLock);
+    auto it = std::find(renderThreads.begin(), renderThreads.end(), tid);
+    if (it != renderThreads.end()) {
+        *it = renderThreads.back();
+        renderThreads.pop_back();
+    }
+}
+
+void MelonDsDs::placement::PlaceEmulationThread(ThreadPlacement placement) noexcept {
+    ZoneScopedN(TracyFunction);
+    if (Place(0, placement)) {
+        retro::info("Placed the emulation thread on {}", PlacementName(placement));
+    }
+}
+
+void MelonDsDs::placement::PlaceRenderThreads(ThreadPlacement placement) noexcept {
+    ZoneScopedN(TracyFunction);
+    GetTopology(); // So that the original affinity comes from this thread, not a render thread
+
+    std::lock_guard lock(placementLock);
+    if (placement == renderPlacement)
+        return;
+
+    renderPlacement = placement;
+    size_t placed = 0;
+    for (pid_t tid : renderThreads) {
+        placed += Place(tid, placement);
+    }
+
+    if (GetTopology().Heterogeneous) {
+        retro::info("Placed render threads on {} ({} running now)", PlacementName(placement), placed);
+    }
+}
@@ -0,0 +1,45 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#ifndef MELONDS_DS_PLACEMENT_HPP
+#define MELONDS_DS_PLACEMENT_HPP
+
+#include "../config/types.hpp"
+
+namespace MelonDsDs::placement {
+#ifdef HAVE_THREAD_PLACEMENT
+    /// Records the calling thread as one of melonDS's render threads,
+    /// and moves it to whichever cores the render threads were last placed on.
+    void RegisterRenderThread() noexcept;
+
+    /// Forgets the calling thread; must be called before a thread registered with \c RegisterRenderThread exits.
+    void UnregisterRenderThread() noexcept;
+
+    /// Restricts the calling thread (i.e. the frontend's emulation thread) to the given class of cores.
+    void PlaceEmulationThread(ThreadPlacement placement) noexcept;
+
+    /// Restricts all current and future render threads to the given class of cores.
+    void PlaceRenderThreads(ThreadPlacement placement) noexcept;
+#else
+    inline void RegisterRenderThread() noexcept {}
+    inline void UnregisterRenderThread() noexcept {}
+    inline void PlaceEmulationThread(ThreadPlacement) noexcept {}
+    inline void PlaceRenderThreads(ThreadPlacement) noexcept {}
+#endif
+}
+
+#endif //MELONDS_DS_PLACEMENT_HPP
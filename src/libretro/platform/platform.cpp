@@ -75,6 +75,9 @@ static retro_log_level to_retro_log_level(Platform::LogLevel level) {
 
 void Platform::Log(Platform::LogLevel level, const char *fmt...) {
     retro_log_level retro_level = to_retro_log_level(level);
+    if (!retro::is_log_enabled(retro_level))
+        return; // Don't bother building the string
+
     va_list va;
     va_start(va, fmt);
     char text[1024] = "[melonDS] ";
@@ -0,0 +1,291 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include "readahead.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include <retro_assert.h>
+#include <streams/file_stream.h>
+
+#include "environment.hpp"
+#include "tracy.hpp"
+
+MelonDsDs::ReadAheadBuffer::ReadAheadBuffer(RFILE* file, size_t window) noexcept : _file(file), _window(window) {
+    ZoneScopedN(TracyFunction);
+    retro_assert(_file != nullptr);
+    retro_assert(_window > 0);
+
+    int64_t size = filestream_get_size(_file);
+    _size = size > 0 ? size : 0;
+    _filePosition = std::max<int64_t>(filestream_tell(_file), 0);
+    _lock = slock_new();
+    retro_assert(_lock != nullptr);
+}
+
+MelonDsDs::ReadAheadBuffer::~ReadAheadBuffer() noexcept {
+    ZoneScopedN(TracyFunction);
+
+    if (_thread) {
+        slock_lock(_lock);
+        _stopping = true;
+        scond_signal(_wake);
+        slock_unlock(_lock);
+        sthread_join(_thread);
+    }
+
+    if (_readingAhead) {
+        uint64_t reads = _stats.Hits + _stats.Misses;
+        retro::debug(
+            "Read-ahead for \"{}\": {} hits, {} misses ({:.1f}% hit rate); {} prefetches read {} bytes ({} stalls, {} discarded)",
+            filestream_get_path(_file),
+            _stats.Hits,
+            _stats.Misses,
+            reads ? 100.0 * _stats.Hits / reads : 0.0,
+            _stats.Prefetches,
+            _stats.PrefetchedBytes,
+            _stats.Stalls,
+            _stats.Discards
+        );
+    }
+
+    if (_done)
+        scond_free(_done);
+
+    if (_wake)
+        scond_free(_wake);
+
+    slock_free(_lock);
+}
+
+void MelonDsDs::ReadAheadBuffer::StartReadingAhead() noexcept {
+    ZoneScopedN(TracyFunction);
+    _readingAhead = true;
+    _current.Data = std::make_unique<std::byte[]>(_window);
+
+#ifdef HAVE_THREADS
+    _wake = scond_new();
+    _done = scond_new();
+    if (_wake && _done) {
+        _next.Data = std::make_unique<std::byte[]>(_window);
+        _thread = sthread_create(PrefetchThread, this);
+    }
+
+    if (!_thread) {
+        _next.Data = nullptr;
+        retro::warn("Couldn't start a read-ahead thread for \"{}\"; reading ahead inline", filestream_get_path(_file));
+    }
+#endif
+
+    retro::debug("\"{}\" is being read sequentially; reading ahead {} bytes at a time", filestream_get_path(_file), _window);
+}
+
+void MelonDsDs::ReadAheadBuffer::PrefetchThread(void* self) noexcept {
+    ReadAheadBuffer& buffer = *static_cast<ReadAheadBuffer*>(self);
+
+    slock_lock(buffer._lock);
+    while (!buffer._stopping) {
+        if (buffer._state != PrefetchState::Requested) {
+            scond_wait(buffer._wake, buffer._lock);
+            continue;
+        }
+
+        // While the prefetch is in flight, the caller won't touch _next or _file
+        buffer._state = PrefetchState::InFlight;
+        uint64_t start = buffer._next.Start;
+        slock_unlock(buffer._lock);
+
+        size_t length;
+        {
+            ZoneScopedN("MelonDsDs::ReadAheadBuffer::PrefetchThread::read");
+            length = buffer.ReadAt(buffer._next.Data.get(), start, buffer._window);
+        }
+
+        slock_lock(buffer._lock);
+        buffer._next.Length = length;
+        buffer._state = PrefetchState::Ready;
+        buffer._stats.Prefetches++;
+        buffer._stats.PrefetchedBytes += length;
+        scond_broadcast(buffer._done);
+    }
+    slock_unlock(buffer._lock);
+}
+
+void MelonDsDs::ReadAheadBuffer::Prefetch(uint64_t start) noexcept {
+    if (!_thread || start >= _size)
+        return;
+
+    WaitForPrefetch();
+    if (_state == PrefetchState::Ready) {
+        // If the window we read ahead wasn't what the caller wanted next...
+        _stats.Discards++;
+    }
+
+    _next.Start = start;
+    _next.Length = 0;
+    _state = PrefetchState::Requested;
+    scond_signal(_wake);
+}
+
+void MelonDsDs::ReadAheadBuffer::WaitForPrefetch() noexcept {
+    while (_state == PrefetchState::Requested || _state == PrefetchState::InFlight) {
+        scond_wait(_done, _lock);
+    }
+}
+
+bool MelonDsDs::ReadAheadBuffer::PromotePrefetch() noexcept {
+    if (_state == PrefetchState::Idle || _next.Start != _position)
+        return false;
+
+    if (_state != PrefetchState::Ready) {
+        // If the caller caught up with the prefetch thread...
+        ZoneScopedN("MelonDsDs::ReadAheadBuffer::PromotePrefetch::stall");
+        _stats.Stalls++;
+        WaitForPrefetch();
+    }
+
+    _state = PrefetchState::Idle;
+    if (_next.Length == 0)
+        return false; // The prefetch failed, so let the caller read the file itself
+
+    std::swap(_current, _next);
+    Prefetch(_current.Start + _current.Length);
+    return true;
+}
+
+size_t MelonDsDs::ReadAheadBuffer::ReadAt(std::byte* data, uint64_t offset, size_t length) noexcept {
+    if (offset != _filePosition) {
+        if (filestream_seek(_file, offset, RETRO_VFS_SEEK_POSITION_START) != 0) {
+            retro::error("Failed to seek to {} in \"{}\"", offset, filestream_get_path(_file));
+            _filePosition = UINT64_MAX; // We don't know where the cursor is now
+            return 0;
+        }
+        _filePosition = offset;
+    }
+
+    int64_t bytesRead = filestream_read(_file, data, length);
+    if (bytesRead < 0) {
+        retro::error("Failed to read {} bytes at {} from \"{}\"", length, offset, filestream_get_path(_file));
+        _filePosition = UINT64_MAX;
+        return 0;
+    }
+
+    _filePosition += bytesRead;
+    return bytesRead;
+}
+
+size_t MelonDsDs::ReadAheadBuffer::Read(void* data, size_t length) noexcept {
+    ZoneScopedN(TracyFunction);
+    slock_lock(_lock);
+
+    _sequentialReads = _position == _lastEnd ? _sequentialReads + 1 : 0;
+    bool sequential = _sequentialReads >= SEQUENTIAL_THRESHOLD;
+    if (!_readingAhead && sequential) {
+        StartReadingAhead();
+    }
+
+    auto* out = static_cast<std::byte*>(data);
+    size_t total = 0;
+    bool hit = true;
+    while (total < length && _position < _size) {
+        if (_current.Contains(_position)) {
+            size_t offset = _position - _current.Start;
+            size_t chunk = std::min(length - total, _current.Length - offset);
+            memcpy(out + total, _current.Data.get() + offset, chunk);
+            total += chunk;
+            _position += chunk;
+            continue;
+        }
+
+        if (PromotePrefetch())
+            continue;
+
+        hit = false;
+        WaitForPrefetch(); // The file's cursor is shared with the prefetch thread
+        size_t remaining = length - total;
+        if (sequential && remaining < _window) {
+            // Read a whole window now, then start on the one after it in the background
+            _current.Start = _position;
+            _current.Length = ReadAt(_current.Data.get(), _position, _window);
+            if (_current.Length == 0)
+                break;
+
+            Prefetch(_current.Start + _current.Length);
+            continue;
+        }
+
+        // Big or random reads go straight to the file, so that they don't waste the read-ahead
+        size_t bytesRead = ReadAt(out + total, _position, remaining);
+        total += bytesRead;
+        _position += bytesRead;
+        break;
+    }
+
+    if (total > 0) {
+        if (hit)
+            _stats.Hits++;
+        else
+            _stats.Misses++;
+    }
+
+    _lastEnd = _position;
+    slock_unlock(_lock);
+    return total;
+}
+
+bool MelonDsDs::ReadAheadBuffer::Seek(int64_t offset, int whence) noexcept {
+    slock_lock(_lock);
+
+    int64_t base = 0;
+    switch (whence) {
+        case RETRO_VFS_SEEK_POSITION_START: base = 0; break;
+        case RETRO_VFS_SEEK_POSITION_CURRENT: base = _position; break;
+        case RETRO_VFS_SEEK_POSITION_END: base = _size; break;
+        default: base = -1; break;
+    }
+
+    bool ok = base >= 0 && base + offset >= 0;
+    if (ok) {
+        // The buffers stay valid, since the file is read-only
+        _position = base + offset;
+    }
+
+    slock_unlock(_lock);
+    return ok;
+}
+
+uint64_t MelonDsDs::ReadAheadBuffer::Position() const noexcept {
+    slock_lock(_lock);
+    uint64_t position = _position;
+    slock_unlock(_lock);
+    return position;
+}
+
+uint64_t MelonDsDs::ReadAheadBuffer::Size() const noexcept {
+    slock_lock(_lock);
+    uint64_t size = _size;
+    slock_unlock(_lock);
+    return size;
+}
+
+MelonDsDs::ReadAheadStats MelonDsDs::ReadAheadBuffer::Stats() const noexcept {
+    slock_lock(_lock);
+    ReadAheadStats stats = _stats;
+    slock_unlock(_lock);
+    return stats;
+}
@@ -0,0 +1,132 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include <rthreads/rthreads.h>
+
+struct RFILE;
+
+namespace MelonDsDs {
+    struct ReadAheadStats {
+        /// Reads served entirely from the read-ahead buffers.
+        uint64_t Hits = 0;
+
+        /// Reads that had to go to the VFS for at least some of their data.
+        uint64_t Misses = 0;
+
+        /// Windows read in the background ahead of the caller.
+        uint64_t Prefetches = 0;
+        uint64_t PrefetchedBytes = 0;
+
+        /// Reads that had to wait for a background read to finish.
+        uint64_t Stalls = 0;
+
+        /// Background reads thrown away unused because the caller moved elsewhere.
+        uint64_t Discards = 0;
+    };
+
+    /// Sequential read-ahead in front of a read-only VFS file,
+    /// for ROMs and images on slow media where each small read costs a full round trip.
+    ///
+    /// Reads pass straight through to the file until several in a row pick up where the last one left off.
+    /// While that continues, each miss reads a whole window at once,
+    /// and the following window is read on a background thread while the caller consumes the current one.
+    /// The buffers and the thread aren't created until the file is first read sequentially,
+    /// so randomly-accessed files cost nothing extra.
+    class ReadAheadBuffer {
+    public:
+        /// How many consecutive sequential reads it takes to start reading ahead.
+        static constexpr unsigned SEQUENTIAL_THRESHOLD = 2;
+
+        /// 256 KiB.
+        static constexpr size_t DEFAULT_WINDOW = 256 * 1024;
+
+        /// Doesn't take ownership of \c file, which must outlive the buffer
+        /// and must not be read or written except through it.
+        ReadAheadBuffer(RFILE* file, size_t window) noexcept;
+        ~ReadAheadBuffer() noexcept;
+        ReadAheadBuffer(const ReadAheadBuffer&) = delete;
+        ReadAheadBuffer(ReadAheadBuffer&&) = delete;
+        ReadAheadBuffer& operator=(const ReadAheadBuffer&) = delete;
+        ReadAheadBuffer& operator=(ReadAheadBuffer&&) = delete;
+
+        size_t Read(void* data, size_t length) noexcept;
+
+        /// @param whence One of the \c RETRO_VFS_SEEK_POSITION constants.
+        bool Seek(int64_t offset, int whence) noexcept;
+        [[nodiscard]] uint64_t Position() const noexcept;
+        [[nodiscard]] uint64_t Size() const noexcept;
+        [[nodiscard]] ReadAheadStats Stats() const noexcept;
+    private:
+        struct Window {
+            std::unique_ptr<std::byte[]> Data;
+            uint64_t Start = 0;
+            size_t Length = 0;
+
+            [[nodiscard]] bool Contains(uint64_t offset) const noexcept {
+                return Data && offset >= Start && offset < Start + Length;
+            }
+        };
+
+        enum class PrefetchState {
+            Idle,
+            Requested,
+            InFlight,
+            Ready,
+        };
+
+        // All of these require _lock to be held
+        void StartReadingAhead() noexcept;
+        void Prefetch(uint64_t start) noexcept;
+        void WaitForPrefetch() noexcept;
+        bool PromotePrefetch() noexcept;
+
+        /// Doesn't require _lock, but the caller must be the only one touching _file
+        /// (i.e. no prefetch may be in flight, or the caller is the prefetch thread).
+        size_t ReadAt(std::byte* data, uint64_t offset, size_t length) noexcept;
+
+        static void PrefetchThread(void* self) noexcept;
+
+        RFILE* _file;
+        size_t _window;
+        slock_t* _lock = nullptr;
+        scond_t* _wake = nullptr;
+        scond_t* _done = nullptr;
+        sthread_t* _thread = nullptr;
+        bool _stopping = false;
+
+        Window _current {};
+        Window _next {};
+        PrefetchState _state = PrefetchState::Idle;
+        bool _readingAhead = false;
+
+        uint64_t _position = 0;
+        uint64_t _size = 0;
+
+        /// Where the VFS file's own cursor is, so that sequential reads don't need a seek.
+        uint64_t _filePosition = 0;
+
+        /// Where the previous read ended, and how many reads in a row have started there.
+        uint64_t _lastEnd = 0;
+        unsigned _sequentialReads = 0;
+        ReadAheadStats _stats {};
+    };
+}
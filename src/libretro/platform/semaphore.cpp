@@ -16,15 +16,16 @@
 
 #include <Platform.h>
 
+#include "sync.hpp"
 #include "tracy.hpp"
 
-#include "std/semaphore.hpp"
-
 using namespace melonDS;
 using Platform::Semaphore;
 
+// The threaded software renderer syncs on these every scanline,
+// so only creation and destruction are instrumented
 struct Platform::Semaphore {
-    std::counting_semaphore<> semaphore {0};
+    MelonDsDs::LightSemaphore semaphore;
 };
 
 Semaphore *Platform::Semaphore_Create()
@@ -35,29 +36,24 @@ Semaphore *Platform::Semaphore_Create()
 
 void Platform::Semaphore_Reset(Semaphore *sema)
 {
-    ZoneScopedN(TracyFunction);
-    while (sema->semaphore.try_acquire());
+    sema->semaphore.reset();
 }
 
 bool Platform::Semaphore_TryWait(Semaphore* sema, int timeout_ms)
 {
-    ZoneScopedN(TracyFunction);
-
     if (!timeout_ms)
         return sema->semaphore.try_acquire();
 
-    return sema->semaphore.try_acquire_for(std::chrono::milliseconds(timeout_ms));
+    return sema->semaphore.try_acquire_for(timeout_ms);
 }
 
 void Platform::Semaphore_Post(Semaphore *sema, int count)
 {
-    ZoneScopedN(TracyFunction);
     sema->semaphore.release(count);
 }
 
 void Platform::Semaphore_Wait(Semaphore *sema)
 {
-    ZoneScopedN(TracyFunction);
     sema->semaphore.acquire();
 }
 
@@ -66,4 +62,3 @@ void Platform::Semaphore_Free(Semaphore *sema)
     ZoneScopedN(TracyFunction);
     delete sema;
 }
-
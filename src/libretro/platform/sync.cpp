@@ -0,0 +1,214 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include "sync.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <thread>
+
+#if defined(__linux__)
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(_WIN32) && _WIN32_WINNT >= 0x0602
+#include <windows.h>
+#define MELONDSDS_HAVE_WAIT_ON_ADDRESS
+#else
+#include <rthreads/rthreads.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+using std::atomic;
+
+static_assert(sizeof(atomic<uint32_t>) == sizeof(uint32_t) && atomic<uint32_t>::is_always_lock_free);
+
+namespace {
+    constexpr uint32_t MIN_SPINS = 8;
+    constexpr uint32_t MAX_SPINS = 2048;
+
+    atomic<uint64_t> spinAcquires = 0;
+    atomic<uint64_t> waits = 0;
+
+    inline void CpuRelax() noexcept {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+        _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        __asm__ __volatile__("yield");
+#endif
+    }
+
+    // Spins until attempt() succeeds or the limit runs out, then nudges the limit
+    // towards however long it actually took (or down, if spinning didn't help)
+    template <typename F>
+    bool Spin(atomic<uint32_t>& spinLimit, F&& attempt) noexcept {
+        // With only one core, whoever we're waiting for can't make progress while we spin
+        static const bool multicore = std::thread::hardware_concurrency() > 1;
+        if (!multicore)
+            return false;
+
+        uint32_t limit = spinLimit.load(std::memory_order_relaxed);
+        for (uint32_t i = 0; i < limit; ++i) {
+            CpuRelax();
+            if (attempt()) {
+                uint32_t target = std::clamp(2 * (i + 1), MIN_SPINS, MAX_SPINS);
+                int32_t step = (static_cast<int32_t>(target) - static_cast<int32_t>(limit)) / 8;
+                spinLimit.store(static_cast<uint32_t>(static_cast<int32_t>(limit) + step), std::memory_order_relaxed);
+                spinAcquires.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+
+        spinLimit.store(std::max(limit - limit / 8, MIN_SPINS), std::memory_order_relaxed);
+        return false;
+    }
+
+#if !defined(__linux__) && !defined(MELONDSDS_HAVE_WAIT_ON_ADDRESS)
+    // Without a futex-like API, sleepers park on one of a few condition variables picked by address.
+    // Wakers take the same lock after changing the word, so a wakeup can't slip in
+    // between a sleeper's check and its wait.
+    struct ParkingBucket {
+        slock_t* Lock = slock_new();
+        scond_t* Cond = scond_new();
+    };
+
+    ParkingBucket& BucketFor(const atomic<uint32_t>& word) noexcept {
+        static std::array<ParkingBucket, 16> buckets;
+        return buckets[(reinterpret_cast<uintptr_t>(&word) >> 4) % buckets.size()];
+    }
+#endif
+}
+
+MelonDsDs::SyncStats MelonDsDs::GetSyncStats() noexcept {
+    return {
+        .SpinAcquires = spinAcquires.load(std::memory_order_relaxed),
+        .Waits = waits.load(std::memory_order_relaxed),
+    };
+}
+
+void MelonDsDs::ResetSyncStats() noexcept {
+    spinAcquires.store(0, std::memory_order_relaxed);
+    waits.store(0, std::memory_order_relaxed);
+}
+
+void MelonDsDs::sync::Wait(atomic<uint32_t>& word, uint32_t expected) noexcept {
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+#elif defined(MELONDSDS_HAVE_WAIT_ON_ADDRESS)
+    WaitOnAddress(&word, &expected, sizeof(expected), INFINITE);
+#else
+    ParkingBucket& bucket = BucketFor(word);
+    slock_lock(bucket.Lock);
+    if (word.load(std::memory_order_relaxed) == expected) {
+        scond_wait(bucket.Cond, bucket.Lock);
+    }
+    slock_unlock(bucket.Lock);
+#endif
+}
+
+void MelonDsDs::sync::WaitFor(atomic<uint32_t>& word, uint32_t expected, int timeoutMs) noexcept {
+#if defined(__linux__)
+    timespec timeout { .tv_sec = timeoutMs / 1000, .tv_nsec = (timeoutMs % 1000) * 1000000L };
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, &timeout, nullptr, 0);
+#elif defined(MELONDSDS_HAVE_WAIT_ON_ADDRESS)
+    WaitOnAddress(&word, &expected, sizeof(expected), timeoutMs);
+#else
+    ParkingBucket& bucket = BucketFor(word);
+    slock_lock(bucket.Lock);
+    if (word.load(std::memory_order_relaxed) == expected) {
+        scond_wait_timeout(bucket.Cond, bucket.Lock, int64_t(timeoutMs) * 1000);
+    }
+    slock_unlock(bucket.Lock);
+#endif
+}
+
+void MelonDsDs::sync::Wake(atomic<uint32_t>& word, uint32_t count) noexcept {
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, std::min<uint32_t>(count, INT_MAX), nullptr, nullptr, 0);
+#elif defined(MELONDSDS_HAVE_WAIT_ON_ADDRESS)
+    if (count == 1) {
+        WakeByAddressSingle(&word);
+    }
+    else {
+        WakeByAddressAll(&word);
+    }
+#else
+    (void)count;
+    ParkingBucket& bucket = BucketFor(word);
+    slock_lock(bucket.Lock);
+    scond_broadcast(bucket.Cond);
+    slock_unlock(bucket.Lock);
+#endif
+}
+
+bool MelonDsDs::LightSemaphore::AcquireSlow(int timeoutMs) noexcept {
+    if (Spin(_spinLimit, [this] { return try_acquire(); }))
+        return true;
+
+    using std::chrono::steady_clock;
+    steady_clock::time_point deadline = steady_clock::now() + std::chrono::milliseconds(std::max(timeoutMs, 0));
+
+    // Announce ourselves before the last check, so that a release() either sees us or we see its permit
+    _waiters.fetch_add(1, std::memory_order_seq_cst);
+    bool acquired = false;
+    while (true) {
+        uint32_t count = _count.load(std::memory_order_seq_cst);
+        if (count > 0) {
+            if (_count.compare_exchange_weak(count, count - 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+                acquired = true;
+                break;
+            }
+            continue;
+        }
+
+        waits.fetch_add(1, std::memory_order_relaxed);
+        if (timeoutMs < 0) {
+            sync::Wait(_count, 0);
+            continue;
+        }
+
+        auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - steady_clock::now());
+        if (remaining.count() <= 0)
+            break;
+
+        sync::WaitFor(_count, 0, static_cast<int>(remaining.count()));
+    }
+    _waiters.fetch_sub(1, std::memory_order_relaxed);
+    return acquired;
+}
+
+void MelonDsDs::LightMutex::LockSlow() noexcept {
+    bool locked = Spin(_spinLimit, [this] {
+        uint32_t expected = UNLOCKED;
+        return _state.load(std::memory_order_relaxed) == UNLOCKED &&
+            _state.compare_exchange_weak(expected, LOCKED, std::memory_order_acquire, std::memory_order_relaxed);
+    });
+
+    if (locked)
+        return;
+
+    // Mark the lock as contended so that its owner knows to wake us when it's done
+    while (_state.exchange(CONTENDED, std::memory_order_acquire) != UNLOCKED) {
+        waits.fetch_add(1, std::memory_order_relaxed);
+        sync::Wait(_state, CONTENDED);
+    }
+}
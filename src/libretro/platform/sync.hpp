@@ -0,0 +1,133 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef MELONDS_DS_SYNC_HPP
+#define MELONDS_DS_SYNC_HPP
+
+#include <atomic>
+#include <cstdint>
+
+namespace MelonDsDs {
+    /// Contention counters shared by every \c LightSemaphore and \c LightMutex.
+    /// Only the slow paths update them, so uncontended operations don't pay for them.
+    struct SyncStats {
+        /// Times a thread got what it wanted while spinning, without sleeping
+        uint64_t SpinAcquires;
+
+        /// Times a thread went to sleep waiting for a permit or a lock
+        uint64_t Waits;
+    };
+
+    [[nodiscard]] SyncStats GetSyncStats() noexcept;
+    void ResetSyncStats() noexcept;
+
+    namespace sync {
+        /// Sleeps until \c word is woken, unless it no longer holds \c expected.
+        /// May return spuriously.
+        void Wait(std::atomic<uint32_t>& word, uint32_t expected) noexcept;
+
+        /// Like \c Wait, but gives up after \c timeoutMs milliseconds.
+        void WaitFor(std::atomic<uint32_t>& word, uint32_t expected, int timeoutMs) noexcept;
+
+        /// Wakes up to \c count threads sleeping on \c word.
+        void Wake(std::atomic<uint32_t>& word, uint32_t count) noexcept;
+    }
+
+    /// A counting semaphore that only involves the OS when a thread has to sleep.
+    ///
+    /// Waiting spins for a short while before sleeping;
+    /// the spin length adapts to how long recent waits took to succeed.
+    class LightSemaphore {
+    public:
+        bool try_acquire() noexcept {
+            uint32_t count = _count.load(std::memory_order_relaxed);
+            while (count > 0) {
+                if (_count.compare_exchange_weak(count, count - 1, std::memory_order_acquire, std::memory_order_relaxed))
+                    return true;
+            }
+
+            return false;
+        }
+
+        void acquire() noexcept {
+            if (!try_acquire()) {
+                AcquireSlow(-1);
+            }
+        }
+
+        /// @returns \c false if no permit became available within \c timeoutMs milliseconds.
+        bool try_acquire_for(int timeoutMs) noexcept {
+            return try_acquire() || AcquireSlow(timeoutMs);
+        }
+
+        void release(uint32_t count = 1) noexcept {
+            _count.fetch_add(count, std::memory_order_seq_cst);
+            if (_waiters.load(std::memory_order_seq_cst) > 0) {
+                // If anyone might be asleep...
+                sync::Wake(_count, count);
+            }
+        }
+
+        /// Discards all available permits.
+        void reset() noexcept {
+            _count.store(0, std::memory_order_relaxed);
+        }
+    private:
+        bool AcquireSlow(int timeoutMs) noexcept;
+
+        std::atomic<uint32_t> _count = 0;
+        std::atomic<uint32_t> _waiters = 0;
+        std::atomic<uint32_t> _spinLimit = 64;
+    };
+
+    /// A mutex that only involves the OS when it's contended,
+    /// after spinning for a short (adaptive) while.
+    class LightMutex {
+    public:
+        void lock() noexcept {
+            uint32_t expected = UNLOCKED;
+            if (!_state.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire, std::memory_order_relaxed)) {
+                LockSlow();
+            }
+        }
+
+        bool try_lock() noexcept {
+            uint32_t expected = UNLOCKED;
+            return _state.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire, std::memory_order_relaxed);
+        }
+
+        void unlock() noexcept {
+            if (_state.exchange(UNLOCKED, std::memory_order_release) == CONTENDED) {
+                // If someone might be asleep waiting for the lock...
+                sync::Wake(_state, 1);
+            }
+        }
+    private:
+        enum : uint32_t {
+            UNLOCKED,
+            LOCKED,
+            // Locked, and other threads may be sleeping on it
+            CONTENDED,
+        };
+
+        void LockSlow() noexcept;
+
+        std::atomic<uint32_t> _state = UNLOCKED;
+        std::atomic<uint32_t> _spinLimit = 64;
+    };
+}
+
+#endif // MELONDS_DS_SYNC_HPP
@@ -18,8 +18,15 @@
 #include <rthreads/rthreads.h>
 #include <Platform.h>
 
+#include <atomic>
 #include <utility>
 
+#include <fmt/format.h>
+
+#include "placement.hpp"
+#include "tracy/memory.hpp"
+#include "tracy.hpp"
+
 using namespace melonDS;
 using Platform::Thread;
 struct Platform::Thread {
@@ -27,18 +34,32 @@ struct Platform::Thread {
 };
 struct ThreadData {
     std::function<void()> fn;
+    unsigned index;
 };
 
+// melonDS's threads (e.g. the threaded 3D renderer) each run a loop for as long as their owner exists,
+// so they get threads of their own rather than tying up the core's thread pool
+static std::atomic_uint threadCount = 0;
+
 static void function_trampoline(void *param) {
     auto *data = (ThreadData *) param;
+#ifdef HAVE_TRACY
+    tracy::SetThreadName(fmt::format("melonDS Thread {}", data->index).c_str());
+#elif defined(HAVE_TRACE_RECORDER)
+    MelonDsDs::trace::SetThreadName(fmt::format("melonDS Thread {}", data->index).c_str());
+#endif
+    // All of melonDS's threads do rendering work, so they follow the render thread placement option
+    MelonDsDs::placement::RegisterRenderThread();
+    MelonDsDs::MemoryScope memory(MelonDsDs::MemoryTag::Render);
     data->fn();
+    MelonDsDs::placement::UnregisterRenderThread();
     delete data;
 }
 
 Thread *Platform::Thread_Create(std::function<void()> func) {
 #if HAVE_THREADS
     return new Thread {
-        sthread_create(function_trampoline, new ThreadData{std::move(func)})
+        sthread_create(function_trampoline, new ThreadData{std::move(func), threadCount++})
     };
 #else
     return nullptr;
@@ -0,0 +1,99 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "jobs.hpp"
+
+#include <Platform.h>
+
+#include "environment.hpp"
+#include "tracy.hpp"
+
+MelonDsDs::JobGroup::JobGroup(unsigned workers) noexcept {
+    ZoneScopedN(TracyFunction);
+    start = melonDS::Platform::Semaphore_Create();
+    done = melonDS::Platform::Semaphore_Create();
+    threads.reserve(workers);
+    for (unsigned i = 0; i < workers; i++) {
+        melonDS::Platform::Thread* thread = melonDS::Platform::Thread_Create([this] { WorkerMain(); });
+        if (!thread) {
+            // If threads aren't available on this platform...
+            break;
+        }
+
+        threads.push_back(thread);
+    }
+
+    retro::debug("Started {} job worker thread(s)", threads.size());
+}
+
+MelonDsDs::JobGroup::~JobGroup() noexcept {
+    ZoneScopedN(TracyFunction);
+    quit = true;
+    melonDS::Platform::Semaphore_Post(start, threads.size());
+    for (melonDS::Platform::Thread* thread : threads) {
+        melonDS::Platform::Thread_Wait(thread);
+        melonDS::Platform::Thread_Free(thread);
+    }
+
+    melonDS::Platform::Semaphore_Free(start);
+    melonDS::Platform::Semaphore_Free(done);
+}
+
+void MelonDsDs::JobGroup::Run(unsigned count, const std::function<void(unsigned)>& job) noexcept {
+    ZoneScopedN(TracyFunction);
+    if (threads.empty() || count <= 1) {
+        // If there's nobody to share the work with...
+        for (unsigned i = 0; i < count; i++) {
+            job(i);
+        }
+        return;
+    }
+
+    currentJob = &job;
+    jobCount = count;
+    nextJob.store(0, std::memory_order_relaxed);
+
+    // The semaphores order these writes before the workers read them
+    melonDS::Platform::Semaphore_Post(start, threads.size());
+    RunJobs();
+
+    for (size_t i = 0; i < threads.size(); i++) {
+        // Each start signal is answered by exactly one done signal,
+        // so once we have them all no worker can still be touching currentJob
+        melonDS::Platform::Semaphore_Wait(done);
+    }
+
+    currentJob = nullptr;
+}
+
+void MelonDsDs::JobGroup::WorkerMain() noexcept {
+    while (true) {
+        melonDS::Platform::Semaphore_Wait(start);
+        if (quit)
+            return;
+
+        RunJobs();
+        melonDS::Platform::Semaphore_Post(done, 1);
+    }
+}
+
+void MelonDsDs::JobGroup::RunJobs() noexcept {
+    ZoneScopedN(TracyFunction);
+    for (unsigned i = nextJob.fetch_add(1, std::memory_order_relaxed); i < jobCount; i = nextJob.fetch_add(1, std::memory_order_relaxed)) {
+        (*currentJob)(i);
+    }
+}
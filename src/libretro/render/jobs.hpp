@@ -0,0 +1,63 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#ifndef MELONDSDS_RENDER_JOBS_HPP
+#define MELONDSDS_RENDER_JOBS_HPP
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+namespace melonDS::Platform {
+    struct Thread;
+    struct Semaphore;
+}
+
+namespace MelonDsDs {
+    /// A fixed set of persistent worker threads for splitting one task into independent jobs.
+    /// The thread that calls \c Run participates too, and \c Run doesn't return until every job is done.
+    class JobGroup {
+    public:
+        /// Starts up to \c workers threads; fewer may be started if the platform can't create them.
+        explicit JobGroup(unsigned workers) noexcept;
+        ~JobGroup() noexcept;
+        JobGroup(const JobGroup&) = delete;
+        JobGroup& operator=(const JobGroup&) = delete;
+        JobGroup(JobGroup&&) = delete;
+        JobGroup& operator=(JobGroup&&) = delete;
+
+        /// The number of threads that can run jobs at once, including the caller's.
+        [[nodiscard]] unsigned Concurrency() const noexcept { return threads.size() + 1; }
+
+        /// Calls \c job once for each index in [0, \c count), spread across the workers.
+        /// Jobs must not depend on each other.
+        void Run(unsigned count, const std::function<void(unsigned)>& job) noexcept;
+    private:
+        void WorkerMain() noexcept;
+        void RunJobs() noexcept;
+
+        std::vector<melonDS::Platform::Thread*> threads;
+        melonDS::Platform::Semaphore* start = nullptr;
+        melonDS::Platform::Semaphore* done = nullptr;
+        const std::function<void(unsigned)>* currentJob = nullptr;
+        unsigned jobCount = 0;
+        std::atomic_uint nextJob = 0;
+        bool quit = false;
+    };
+}
+
+#endif // MELONDSDS_RENDER_JOBS_HPP
@@ -17,11 +17,17 @@
 
 #include "opengl.hpp"
 
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
 
 #include <GPU3D_OpenGL.h>
 #include <NDS.h>
 
+#include <encodings/crc32.h>
 #include <gfx/gl_capabilities.h>
 #include <glsm/glsm.h>
 #include <retro_assert.h>
@@ -31,6 +37,7 @@
 #include "../core/core.hpp"
 #include "exceptions.hpp"
 #include "format.hpp"
+#include "programcache.hpp"
 #include "screenlayout.hpp"
 #include "tracy.hpp"
 
@@ -138,23 +145,65 @@ constexpr unsigned GetVertexCount(ScreenLayout layout, MelonDsDs::HybridSideScre
 extern retro_hw_render_callback hw_render;
 
 static const char* const SHADER_PROGRAM_NAME = "melonDS DS Shader Program";
+static const char* const SHADER_PROGRAM_CACHE_NAME = "screen";
 
+// How long to wait for the GPU to finish an old frame before giving up on it (in nanoseconds)
+constexpr GLuint64 FRAME_FENCE_TIMEOUT = 100'000'000;
 
-std::unique_ptr<MelonDsDs::OpenGLRenderState> MelonDsDs::OpenGLRenderState::New() noexcept {
+// How much each new GPU timing contributes to the reported average
+constexpr float GPU_FRAME_TIME_SMOOTHING = 0.1f;
+
+// How long each emulated frame may take, in milliseconds
+constexpr float FRAME_BUDGET_MS = 1000.0f / 59.8261f;
+
+// Dynamic resolution lowers the scale when the GPU takes longer than this share of the frame budget...
+constexpr float SCALE_DOWN_THRESHOLD = 0.9f;
+
+// ...and raises it when the next scale up is expected to take less than this share
+constexpr float SCALE_UP_THRESHOLD = 0.75f;
+
+// How long the CPU must spend waiting on the GPU each frame before we consider it the bottleneck
+constexpr float GPU_BOUND_WAIT_MS = 0.5f;
+
+// Number of frames to wait after changing the scale before judging it,
+// so the averages reflect the new scale and we don't bounce between two of them
+constexpr unsigned SCALE_COOLDOWN_FRAMES = 60;
+
+
+std::unique_ptr<MelonDsDs::OpenGLRenderState> MelonDsDs::OpenGLRenderState::New(
+    bool softwareComposition,
+    OpenGlStateIsolation stateIsolation
+) noexcept {
     ZoneScopedN(TracyFunction);
     try {
-        return std::make_unique<OpenGLRenderState>();
+        return std::make_unique<OpenGLRenderState>(softwareComposition, stateIsolation);
     } catch (const opengl_not_initialized_exception& e) {
         retro::debug("OpenGL context could not be initialized: {}", e.what());
         return nullptr;
     }
 }
 
-MelonDsDs::OpenGLRenderState::OpenGLRenderState() {
+MelonDsDs::OpenGLRenderState::OpenGLRenderState(
+    bool softwareComposition,
+    OpenGlStateIsolation stateIsolation
+) : _softwareComposition(softwareComposition) {
     ZoneScopedN(TracyFunction);
     retro::debug(TracyFunction);
     glsm_ctx_params_t params = {};
 
+    if (stateIsolation != OpenGlStateIsolation::Disabled) {
+        // A shared context keeps the frontend's own GL work out of ours,
+        // so we don't have to save and restore everything around each frame.
+        // (The frontend only honors this if it's asked before SET_HW_RENDER.)
+        bool shared = retro::set_hw_shared_context();
+        _stateIsolated = shared || stateIsolation == OpenGlStateIsolation::Enabled;
+        retro::debug(
+            "Frontend {} a shared GL context; {} full GL state around each frame",
+            shared ? "granted" : "did not grant",
+            _stateIsolated ? "won't save and restore the" : "will save and restore the"
+        );
+    }
+
     // MelonDS needs at least OpenGL 3.2 for OpenGL renderer
     // (it doesn't use the legacy fixed-function pipeline)
     params.context_type = RETRO_HW_CONTEXT_OPENGL_CORE;
@@ -187,10 +236,37 @@ MelonDsDs::OpenGLRenderState::~OpenGLRenderState() noexcept {
         TracyGpuZone(TracyFunction);
         glsm_ctl(GLSM_CTL_STATE_BIND, nullptr);
         glDeleteTextures(1, &screen_framebuffer_texture);
+        glDeleteBuffers(_screenPbos.size(), _screenPbos.data());
 
         glDeleteVertexArrays(1, &vao);
         glDeleteBuffers(1, &vbo);
+        for (GLsync fence : _uboFences) {
+            if (fence) {
+                glDeleteSync(fence);
+            }
+        }
+        if (_uboMapping) {
+            glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+        }
+        glDeleteBuffers(1, &ubo);
+        for (GLsync fence : _frameFences) {
+            if (fence) {
+                glDeleteSync(fence);
+            }
+        }
+#if defined(HAVE_OPENGL) && defined(GL_TIME_ELAPSED)
+        if (_timerQueriesAvailable) {
+            if (_activeTimerQuery) {
+                glEndQuery(GL_TIME_ELAPSED);
+            }
+            for (std::array<GLuint, GPU_STAGE_COUNT>& queries : _timerQueries) {
+                glDeleteQueries(queries.size(), queries.data());
+            }
+        }
+#endif
         glDeleteProgram(_screenProgram);
+        _frameReadback = std::nullopt;
         glsm_ctl(GLSM_CTL_STATE_UNBIND, nullptr);
 
 #ifdef HAVE_TRACY
@@ -248,16 +324,15 @@ void MelonDsDs::OpenGLRenderState::ContextReset(melonDS::NDS& nds, const CoreCon
     // (The "correct" way to do this would be to add a Reinitialize() method to GLRenderer
     // that recreates all resources)
     nds.GPU.GPU3D.SetCurrentRenderer(std::make_unique<melonDS::SoftRenderer>());
-    auto renderer = melonDS::GLRenderer::New();
-    if (!renderer) {
-        retro::error("Failed to initialize OpenGL renderer!");
-        throw opengl_not_initialized_exception();
-    }
-    retro::debug("Constructed OpenGL renderer");
-    renderer->SetRenderSettings(config.BetterPolygonSplitting(), config.ScaleFactor());
-    retro::debug("Applied OpenGL renderer settings");
-    nds.GPU.SetRenderer3D(std::move(renderer));
-    retro::debug("Installed OpenGL renderer");
+
+    // Compiling the OpenGL renderer's shaders can take a long time on some drivers,
+    // so we'll present the software renderer's output until the first frame is on screen,
+    // then install the OpenGL renderer.
+    auto softRenderer = std::make_unique<melonDS::SoftRenderer>();
+    softRenderer->SetThreaded(config.ThreadedSoftRenderer(), nds.GPU);
+    nds.GPU.SetRenderer3D(std::move(softRenderer));
+    RequestRenderer();
+    retro::debug("Installed software renderer until the OpenGL renderer is ready");
 
     SetUpCoreOpenGlState(config);
     retro::debug("Initialized core OpenGL state");
@@ -292,21 +367,47 @@ void MelonDsDs::OpenGLRenderState::SetUpCoreOpenGlState(const CoreConfig& config
         retro::debug("OpenGL debugging extensions are available");
     }
 
+#if defined(HAVE_OPENGL) && defined(GL_TIME_ELAPSED)
+    // Timer queries are core in OpenGL 3.3, but OpenGL ES needs a different extension
+    _timerQueriesAvailable = gl_query_extension("ARB_timer_query");
+    if (_timerQueriesAvailable) {
+        retro::debug("OpenGL timer queries are available");
+        for (std::array<GLuint, GPU_STAGE_COUNT>& queries : _timerQueries) {
+            glGenQueries(queries.size(), queries.data());
+        }
+    }
+#endif
+
     // TODO: Check gl_check_capability for GL_CAPS_VAO and GL_CAPS_FBO
 
-    bool shaderCompiled = melonDS::OpenGL::CompileVertexFragmentProgram(
-        _screenProgram,
+    // Compiling shaders can take a long time on some drivers,
+    // so we try to reuse the program from an earlier session first
+    _screenProgram = LoadCachedProgram(
+        SHADER_PROGRAM_CACHE_NAME,
         embedded_melondsds_vertex_shader,
-        embedded_melondsds_fragment_shader,
-        SHADER_PROGRAM_NAME,
-        {
-            {"vPosition", 0},
-            {"vTexcoord", 1},
-        },
-        {
-            {"oColor", 0},
-        }
+        embedded_melondsds_fragment_shader
     );
+    bool shaderCompiled = _screenProgram != 0;
+
+    if (!shaderCompiled) {
+        shaderCompiled = melonDS::OpenGL::CompileVertexFragmentProgram(
+            _screenProgram,
+            embedded_melondsds_vertex_shader,
+            embedded_melondsds_fragment_shader,
+            SHADER_PROGRAM_NAME,
+            {
+                {"vPosition", 0},
+                {"vTexcoord", 1},
+            },
+            {
+                {"oColor", 0},
+            }
+        );
+
+        if (shaderCompiled) {
+            CacheProgram(_screenProgram, SHADER_PROGRAM_CACHE_NAME, embedded_melondsds_vertex_shader, embedded_melondsds_fragment_shader);
+        }
+    }
 
     if (!shaderCompiled)
         throw shader_compilation_failed_exception("Failed to compile and link melonDS DS screen shader program.");
@@ -324,14 +425,55 @@ void MelonDsDs::OpenGLRenderState::SetUpCoreOpenGlState(const CoreConfig& config
     glUniform1i(uni_id, 0);
 
     memset(&GL_ShaderConfig, 0, sizeof(GL_ShaderConfig));
+    memset(&_uploadedShaderConfig, 0, sizeof(_uploadedShaderConfig));
+    _shaderConfigUploaded = false;
+    _uboMapping = nullptr;
+    _uboFences = {};
+    _uboIndex = 0;
+    _outputTextureFilters = {};
+
+    // The driver may pad the uniform block beyond what our struct covers,
+    // and each copy in the ring has to start on an aligned offset
+    GLint blockSize = 0;
+    glGetActiveUniformBlockiv(_screenProgram, uConfigBlockIndex, GL_UNIFORM_BLOCK_DATA_SIZE, &blockSize);
+    GLint offsetAlignment = 1;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+    offsetAlignment = std::max(offsetAlignment, 1);
+    GLsizeiptr configSize = std::max<GLsizeiptr>(blockSize, sizeof(GL_ShaderConfig));
+    _uboStride = ((configSize + offsetAlignment - 1) / offsetAlignment) * offsetAlignment;
 
     glGenBuffers(1, &ubo);
     glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+
+#if defined(HAVE_OPENGL) && defined(GL_MAP_PERSISTENT_BIT) && defined(GL_MAP_COHERENT_BIT)
+    if (gl_query_extension("ARB_buffer_storage")) {
+        // If we can keep the UBO mapped for its whole lifetime,
+        // then updating the config is just a memcpy into a slot the GPU isn't reading.
+        // (Dynamic storage is so we can still fall back to glBufferSubData if the GPU falls behind.)
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_UNIFORM_BUFFER, _uboStride * UBO_RING_SIZE, nullptr, flags | GL_DYNAMIC_STORAGE_BIT);
+        _uboMapping = glMapBufferRange(GL_UNIFORM_BUFFER, 0, _uboStride * UBO_RING_SIZE, flags);
+        if (_uboMapping) {
+            retro::debug("Persistently mapped the shader config UBO");
+        }
+        else {
+            // Buffer storage is immutable, so we need a new buffer for the fallback
+            retro::warn("Failed to persistently map the shader config UBO, will use glBufferSubData instead");
+            glDeleteBuffers(1, &ubo);
+            glGenBuffers(1, &ubo);
+            glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        }
+    }
+#endif
+
+    if (!_uboMapping) {
+        glBufferData(GL_UNIFORM_BUFFER, _uboStride, nullptr, GL_DYNAMIC_DRAW);
+    }
+
     if (_openGlDebugAvailable) {
         glObjectLabel(GL_BUFFER, ubo, -1, "melonDS DS Shader Config UBO");
     }
-    glBufferData(GL_UNIFORM_BUFFER, sizeof(GL_ShaderConfig), &GL_ShaderConfig, GL_STATIC_DRAW);
-    glBindBufferBase(GL_UNIFORM_BUFFER, 16, ubo);
+    glBindBufferRange(GL_UNIFORM_BUFFER, 16, ubo, 0, _uboStride);
 
     glGenBuffers(1, &vbo);
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
@@ -356,12 +498,18 @@ void MelonDsDs::OpenGLRenderState::SetUpCoreOpenGlState(const CoreConfig& config
     if (_openGlDebugAvailable) {
         glObjectLabel(GL_TEXTURE, screen_framebuffer_texture, -1, "melonDS DS Screen Texture");
     }
+    // Holds the software renderer's screens while the OpenGL renderer warms up
+    // (or when we're only compositing the screens with OpenGL), laid out like the OpenGL renderer's output (top screen above the bottom screen)
     GLint filter = config.ScreenFilter() == ScreenFilter::Linear ? GL_LINEAR : GL_NEAREST;
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8UI, NDS_SCREEN_WIDTH * 3 + 1, NDS_SCREEN_HEIGHT * 2, 0, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, nullptr);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, NDS_SCREEN_WIDTH, NDS_SCREEN_HEIGHT * 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    _screenTextureFilter = filter;
+
+    glGenBuffers(_screenPbos.size(), _screenPbos.data());
+    _screenPboIndex = 0;
 
     _needsRefresh = true;
 }
@@ -374,17 +522,36 @@ void MelonDsDs::OpenGLRenderState::Render(
 ) noexcept {
     ZoneScopedN(TracyFunction);
     TracyGpuZone(TracyFunction);
-    retro_assert(nds.GetRenderer3D().Accelerated);
 
-    glsm_ctl(GLSM_CTL_STATE_BIND, nullptr);
+    _glCalls = 0;
+    if (_stateIsolated) {
+        // Nobody else uses this context, but melonDS's 3D renderer does;
+        // everything else we depend on is explicitly set below.
+        GlCall(glDisable, GL_SCISSOR_TEST);
+        GlCall(glDisable, GL_CULL_FACE);
+        GlCall(glColorMask, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    } else {
+        GlCall(glsm_ctl, GLSM_CTL_STATE_BIND, nullptr);
+    }
+
+#if defined(HAVE_OPENGL) && defined(GL_TIME_ELAPSED)
+    if (_activeTimerQuery == GPU_STAGE_EMULATION) {
+        // Everything the GPU did since BeginFrame was the emulator's work;
+        // everything from here on is ours
+        GlCall(glEndQuery, GL_TIME_ELAPSED);
+        GlCall(glBeginQuery, GL_TIME_ELAPSED, _timerQueries[_timerQueryIndex][GPU_STAGE_PRESENTATION]);
+        _activeTimerQuery = GPU_STAGE_PRESENTATION;
+    }
+#endif
 
     GLuint current_fbo = glsm_get_current_framebuffer();
     // Tell OpenGL that we want to draw to (and read from) the screen framebuffer
-    glBindFramebuffer(GL_FRAMEBUFFER, current_fbo);
+    GlCall(glBindFramebuffer, GL_FRAMEBUFFER, current_fbo);
 
-    melonDS::GLRenderer& renderer = static_cast<melonDS::GLRenderer&>(nds.GetRenderer3D());
+    // Null if we're still showing the software renderer's output while the OpenGL renderer warms up
+    melonDS::GLRenderer* renderer = nds.GetRenderer3D().Accelerated ? static_cast<melonDS::GLRenderer*>(&nds.GetRenderer3D()) : nullptr;
 
-    if (renderer.GetBetterPolygons() != config.BetterPolygonSplitting() || renderer.GetScaleFactor() != config.ScaleFactor())
+    if (renderer && renderer->GetBetterPolygons() != config.BetterPolygonSplitting())
         // If any of the OpenGL renderer's settings have changed...
         _needsRefresh = true;
 
@@ -392,6 +559,28 @@ void MelonDsDs::OpenGLRenderState::Render(
         InitFrameState(nds, config, screenLayout);
         _needsRefresh = false;
     }
+    else if (_vertexGeneration != screenLayout.Generation() || screenLayout.LayoutIndex() != _drawnLayoutIndex) [[unlikely]] {
+        // If we switched to another layout (or the layouts themselves changed),
+        // then only the output's geometry is different; the renderer's state is still good
+        if (_vertexGeneration != screenLayout.Generation()) {
+            InitVertices(screenLayout);
+        }
+
+        GlCall(glClearColor, 0, 0, 0, 0);
+        GlCall(glClear, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        GL_ShaderConfig.uScreenSize = screenLayout.OutputSize();
+        GL_ShaderConfig.u3DScale = screenLayout.Scale();
+        _drawnLayoutIndex = screenLayout.LayoutIndex();
+    }
+    else if (int renderScale = RenderScale(config); renderer && renderer->GetScaleFactor() != renderScale) {
+        // If only the internal resolution changed (e.g. by dynamic resolution),
+        // then the output geometry is the same and only the 3D renderer needs to know.
+        // (Changes to the configured scale factor change the screen layout, which requests a refresh anyway.)
+        renderer->SetRenderSettings(config.BetterPolygonSplitting(), renderScale);
+
+        // Changing the render settings may recreate the output textures with their default filters
+        _outputTextureFilters = {};
+    }
 
     if (!nds.IsLidClosed() && input.CursorVisible()) {
         float cursorSize = config.CursorSize();
@@ -405,44 +594,103 @@ void MelonDsDs::OpenGLRenderState::Render(
         GL_ShaderConfig.cursorVisible = false;
     }
 
-    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
-    void *unibuf = glMapBuffer(GL_UNIFORM_BUFFER, GL_WRITE_ONLY);
-    if (unibuf) memcpy(unibuf, &GL_ShaderConfig, sizeof(GL_ShaderConfig));
-    glUnmapBuffer(GL_UNIFORM_BUFFER);
-
-    glUseProgram(_screenProgram);
+    UploadShaderConfig();
 
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_STENCIL_TEST);
-    glDisable(GL_BLEND);
+    // The 3D renderer and the frontend both change the program, capabilities, and viewport
+    // between our frames (and glsm restores its own copy of them on bind),
+    // so these have to be set every time.
+    GlCall(glUseProgram, _screenProgram);
 
-    glViewport(0, 0, screenLayout.BufferWidth(), screenLayout.BufferHeight());
+    GlCall(glDisable, GL_DEPTH_TEST);
+    GlCall(glDisable, GL_STENCIL_TEST);
+    GlCall(glDisable, GL_BLEND);
 
-    glActiveTexture(GL_TEXTURE0);
+    GlCall(glViewport, 0, 0, screenLayout.OutputWidth(), screenLayout.OutputHeight());
 
-    renderer.BindOutputTexture(nds.GPU.FrontBuffer);
+    GlCall(glActiveTexture, GL_TEXTURE0);
 
     // Set the filtering mode for the active texture
     // For simplicity, we'll just use the same filter for both minification and magnification
     GLint filter = config.ScreenFilter() == ScreenFilter::Linear ? GL_LINEAR : GL_NEAREST;
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    GLint* textureFilter = nullptr;
+    if (renderer) {
+        renderer->BindOutputTexture(nds.GPU.FrontBuffer);
+        ++_glCalls;
+
+        if (renderer != _filteredRenderer) {
+            // If the 3D renderer was replaced, then its output textures are new too
+            _outputTextureFilters = {};
+            _filteredRenderer = renderer;
+        }
+        textureFilter = &_outputTextureFilters[nds.GPU.FrontBuffer & 1];
+    }
+    else {
+        UploadSoftwareScreens(nds);
+        textureFilter = &_screenTextureFilter;
+    }
 
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBindVertexArray(vao);
+    if (*textureFilter != filter) {
+        // If this texture doesn't already use the right filter...
+        // (nothing else changes it after the texture is created, so it's safe to remember)
+        GlCall(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        GlCall(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        *textureFilter = filter;
+    }
+
+    // The VAO already refers to our VBO, so there's no need to bind the VBO as well
+    GlCall(glBindVertexArray, vao);
     if (nds.IsLidClosed()) [[unlikely]] {
         // If the emulated lid is closed, just draw a blank
         // so that there's no annoying flickering with some games
-        glClearColor(0, 0, 0, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        GlCall(glClearColor, 0, 0, 0, 0);
+        GlCall(glClear, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     }
     else {
-        glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+        GlCall(glDrawArrays, GL_TRIANGLES, _drawnLayoutIndex * screen_vertices[0].size(), vertexCounts[_drawnLayoutIndex]);
     }
 
-    glFlush();
+    if (_frameReadbackEnabled) [[unlikely]] {
+        ReadBackFrame(current_fbo, screenLayout);
+    }
+    else if (_frameReadback) [[unlikely]] {
+        // If frame readback was just disabled, clean up its objects while the context is bound
+        _frameReadback = std::nullopt;
+        _readbackFrames.clear();
+    }
 
-    glsm_ctl(GLSM_CTL_STATE_UNBIND, nullptr);
+    if (_uboMapping) {
+        // Mark when the GPU is done with this copy of the config, so we know when we can overwrite it
+        if (_uboFences[_uboIndex]) {
+            GlCall(glDeleteSync, _uboFences[_uboIndex]);
+        }
+        _uboFences[_uboIndex] = GlCall(glFenceSync, GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+#if defined(HAVE_OPENGL) && defined(GL_TIME_ELAPSED)
+    if (_activeTimerQuery == GPU_STAGE_PRESENTATION) {
+        // If we timed both of this frame's stages...
+        GlCall(glEndQuery, GL_TIME_ELAPSED);
+        _timerQueryPending[_timerQueryIndex] = true;
+        _timerQueryIndex = (_timerQueryIndex + 1) % TIMER_QUERY_COUNT;
+        _activeTimerQuery = std::nullopt;
+    }
+#endif
+
+    // Mark when the GPU is done with this frame, so BeginFrame knows how far ahead the CPU is.
+    // There's no need to flush here; waiting on the fence will flush it if necessary,
+    // and the frontend flushes when it presents the frame anyway.
+    if (_frameFences[_frameFenceIndex]) {
+        GlCall(glDeleteSync, _frameFences[_frameFenceIndex]);
+    }
+    _frameFences[_frameFenceIndex] = GlCall(glFenceSync, GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    _frameFenceIndex = (_frameFenceIndex + 1) % _frameFences.size();
+
+    if (!_stateIsolated) {
+        GlCall(glsm_ctl, GLSM_CTL_STATE_UNBIND, nullptr);
+    }
+
+    _glCallsLastFrame = _glCalls;
+    TracyPlot("OpenGL Presenter Calls", static_cast<int64_t>(_glCallsLastFrame));
 
 #ifdef HAVE_TRACY
     if (_tracyCapture) {
@@ -453,11 +701,306 @@ void MelonDsDs::OpenGLRenderState::Render(
 
     retro::video_refresh(
         RETRO_HW_FRAME_BUFFER_VALID,
-        screenLayout.BufferWidth(),
-        screenLayout.BufferHeight(),
+        screenLayout.OutputWidth(),
+        screenLayout.OutputHeight(),
         0
     );
     TracyGpuCollect;
+
+    if (_rendererPending && ++_warmupFrames > WARMUP_FRAMES) {
+        // If the frontend has had something to show for a few frames,
+        // now's the time to compile the OpenGL renderer's shaders.
+        InstallRenderer(nds, config);
+    }
+}
+
+void MelonDsDs::OpenGLRenderState::BeginFrame(const CoreConfig& config) noexcept {
+    ZoneScopedN(TracyFunction);
+    if (!_contextInitialized) {
+        return;
+    }
+
+    WaitForFramesInFlight(config.MaxFramesInFlight());
+
+#if defined(HAVE_OPENGL) && defined(GL_TIME_ELAPSED)
+    if (_timerQueriesAvailable) {
+        CollectTimerQueries();
+        UpdateDynamicResolution(config);
+        if (_activeTimerQuery) {
+            // If the last frame was a dupe or was skipped, Render never ended its query;
+            // queries can't overlap, so end it here and throw away the partial result
+            glEndQuery(GL_TIME_ELAPSED);
+            _activeTimerQuery = std::nullopt;
+        }
+
+        if (!_timerQueryPending[_timerQueryIndex]) {
+            // If the GPU has already reported the oldest query's result, we can reuse it for this frame
+            // (this covers the 3D renderer's work during NDS::RunFrame as well as our own)
+            glBeginQuery(GL_TIME_ELAPSED, _timerQueries[_timerQueryIndex][GPU_STAGE_EMULATION]);
+            _activeTimerQuery = GPU_STAGE_EMULATION;
+        }
+    }
+#endif
+}
+
+void MelonDsDs::OpenGLRenderState::WaitForFramesInFlight(unsigned maxFramesInFlight) noexcept {
+    ZoneScopedN(TracyFunction);
+    maxFramesInFlight = std::clamp<unsigned>(maxFramesInFlight, 1, _frameFences.size());
+
+    // The fence for the frame submitted maxFramesInFlight frames ago
+    unsigned index = (_frameFenceIndex + _frameFences.size() - maxFramesInFlight) % _frameFences.size();
+    GLsync& fence = _frameFences[index];
+    if (!fence) {
+        // If we haven't submitted that many frames yet (or we already waited on it)...
+        return;
+    }
+
+    // GL_SYNC_FLUSH_COMMANDS_BIT makes sure the fence actually reaches the GPU,
+    // otherwise we could wait forever
+    auto waitStart = std::chrono::steady_clock::now();
+    GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FRAME_FENCE_TIMEOUT);
+    if (result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED) [[unlikely]] {
+        retro::debug("Gave up waiting for the GPU to finish a frame ({})", static_cast<FormattedGLEnum>(result));
+    }
+    std::chrono::duration<float, std::milli> waited = std::chrono::steady_clock::now() - waitStart;
+    _fenceWaitTime = std::lerp(_fenceWaitTime, waited.count(), GPU_FRAME_TIME_SMOOTHING);
+
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void MelonDsDs::OpenGLRenderState::CollectTimerQueries() noexcept {
+    ZoneScopedN(TracyFunction);
+#if defined(HAVE_OPENGL) && defined(GL_TIME_ELAPSED)
+    for (unsigned i = 0; i < TIMER_QUERY_COUNT; ++i) {
+        // For each query, oldest first...
+        unsigned index = (_timerQueryIndex + i) % TIMER_QUERY_COUNT;
+        if (!_timerQueryPending[index]) {
+            continue;
+        }
+
+        const std::array<GLuint, GPU_STAGE_COUNT>& queries = _timerQueries[index];
+        bool available = std::all_of(queries.begin(), queries.end(), [](GLuint query) {
+            GLuint available = GL_FALSE;
+            glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+            return available != GL_FALSE;
+        });
+        if (!available) {
+            // If this frame isn't done yet, then none of the newer ones will be either
+            break;
+        }
+
+        std::array<float, GPU_STAGE_COUNT> elapsedMs {};
+        for (unsigned stage = 0; stage < GPU_STAGE_COUNT; ++stage) {
+            // The result is in nanoseconds, so a 32-bit value is enough for any reasonable frame
+            GLuint elapsed = 0;
+            glGetQueryObjectuiv(queries[stage], GL_QUERY_RESULT, &elapsed);
+            elapsedMs[stage] = elapsed / 1'000'000.0f;
+        }
+        _timerQueryPending[index] = false;
+
+        GpuStageTimes stages { elapsedMs[GPU_STAGE_EMULATION], elapsedMs[GPU_STAGE_PRESENTATION] };
+        float frameMs = stages.Emulation + stages.Presentation;
+        _gpuFrameTime = _gpuFrameTime ? std::lerp(*_gpuFrameTime, frameMs, GPU_FRAME_TIME_SMOOTHING) : frameMs;
+        if (_gpuStageTimes) {
+            _gpuStageTimes->Emulation = std::lerp(_gpuStageTimes->Emulation, stages.Emulation, GPU_FRAME_TIME_SMOOTHING);
+            _gpuStageTimes->Presentation = std::lerp(_gpuStageTimes->Presentation, stages.Presentation, GPU_FRAME_TIME_SMOOTHING);
+        }
+        else {
+            _gpuStageTimes = stages;
+        }
+        TracyPlot("GPU Frame Time (ms)", frameMs);
+        TracyPlot("GPU Emulation Time (ms)", stages.Emulation);
+        TracyPlot("GPU Presentation Time (ms)", stages.Presentation);
+    }
+#endif
+}
+
+int MelonDsDs::OpenGLRenderState::RenderScale(const CoreConfig& config) const noexcept {
+    if (!config.DynamicResolution() || !_timerQueriesAvailable) {
+        // If dynamic resolution is disabled (or we can't measure the GPU's workload)...
+        return config.ScaleFactor();
+    }
+
+    return std::clamp(_dynamicScale, config.MinScaleFactor(), config.ScaleFactor());
+}
+
+void MelonDsDs::OpenGLRenderState::UpdateDynamicResolution(const CoreConfig& config) noexcept {
+    ZoneScopedN(TracyFunction);
+    int maxScale = config.ScaleFactor();
+    int minScale = config.MinScaleFactor();
+    if (!config.DynamicResolution()) {
+        // If dynamic resolution is disabled, start from the top when it's next enabled
+        _dynamicScale = maxScale;
+        _framesSinceScaleChange = 0;
+        return;
+    }
+
+    _dynamicScale = std::clamp(_dynamicScale, minScale, maxScale);
+    if (!_gpuFrameTime || ++_framesSinceScaleChange < SCALE_COOLDOWN_FRAMES) {
+        // If we don't know enough about the current scale to judge it yet...
+        return;
+    }
+
+    float gpuFrameTime = *_gpuFrameTime;
+    if (_dynamicScale > minScale && gpuFrameTime > FRAME_BUDGET_MS * SCALE_DOWN_THRESHOLD && _fenceWaitTime > GPU_BOUND_WAIT_MS) {
+        // If the GPU is holding back the CPU (rather than just waiting on it)...
+        --_dynamicScale;
+        _framesSinceScaleChange = 0;
+        retro::debug("GPU took {:.2f}ms per frame, lowering internal resolution to {}x", gpuFrameTime, _dynamicScale);
+    }
+    else if (_dynamicScale < maxScale) {
+        // Most of the GPU's work scales with the number of pixels
+        float growth = static_cast<float>(_dynamicScale + 1) / _dynamicScale;
+        if (gpuFrameTime * growth * growth < FRAME_BUDGET_MS * SCALE_UP_THRESHOLD) {
+            // If the next scale up should still fit comfortably within the frame...
+            ++_dynamicScale;
+            _framesSinceScaleChange = 0;
+            retro::debug("GPU took {:.2f}ms per frame, raising internal resolution to {}x", gpuFrameTime, _dynamicScale);
+        }
+    }
+    TracyPlot("Dynamic Internal Resolution", static_cast<int64_t>(_dynamicScale));
+}
+
+void MelonDsDs::OpenGLRenderState::ReadBackFrame(GLuint fbo, const ScreenLayoutData& screenLayout) noexcept {
+    ZoneScopedN(TracyFunction);
+    TracyGpuZone(TracyFunction);
+
+    glm::uvec2 bufferSize = screenLayout.OutputSize();
+    if (_frameReadback && _frameReadback->Size() != bufferSize) {
+        // If the screen layout changed size since the last readback, the pending frames are useless
+        _frameReadback = std::nullopt;
+        _readbackFrames.clear();
+    }
+
+    if (!_frameReadback) {
+        _frameReadback.emplace(bufferSize, _openGlDebugAvailable, "Frame Readback");
+    }
+
+    _frameReadback->Collect([this](const uint8_t* pixels, glm::uvec2 size, unsigned) {
+        _lastFrameChecksum = encoding_crc32(0, pixels, size.x * size.y * 4);
+        retro_assert(!_readbackFrames.empty());
+        _frameChecksums.push_back({_readbackFrames.front(), *_lastFrameChecksum});
+        _readbackFrames.pop_front();
+    });
+
+    if (_frameReadback->Request(fbo, bufferSize)) {
+        _readbackFrames.push_back(_framesReadBack);
+    }
+    ++_framesReadBack;
+}
+
+void MelonDsDs::OpenGLRenderState::SetFrameReadbackEnabled(bool enabled) noexcept {
+    if (enabled && !_frameReadbackEnabled) {
+        _framesReadBack = 0;
+    }
+
+    _frameReadbackEnabled = enabled;
+    if (!enabled) {
+        _lastFrameChecksum = std::nullopt;
+        _frameChecksums.clear();
+    }
+}
+
+void MelonDsDs::OpenGLRenderState::TakeFrameChecksums(std::vector<FrameChecksum>& checksums) noexcept {
+    checksums.insert(checksums.end(), _frameChecksums.begin(), _frameChecksums.end());
+    _frameChecksums.clear();
+}
+
+void MelonDsDs::OpenGLRenderState::RequestRenderer() noexcept {
+    if (_softwareComposition) {
+        // If we're only compositing the software renderer's screens, we don't need the OpenGL renderer
+        return;
+    }
+
+    _rendererPending = true;
+    _warmupFrames = 0;
+}
+
+void MelonDsDs::OpenGLRenderState::SetSoftwareComposition(bool softwareComposition) noexcept {
+    if (softwareComposition == _softwareComposition) {
+        return;
+    }
+
+    _softwareComposition = softwareComposition;
+    if (softwareComposition) {
+        _rendererPending = false;
+    }
+    else {
+        RequestRenderer();
+    }
+    _needsRefresh = true;
+}
+
+void MelonDsDs::OpenGLRenderState::InstallRenderer(melonDS::NDS& nds, const CoreConfig& config) noexcept {
+    ZoneScopedN(TracyFunction);
+    TracyGpuZone(TracyFunction);
+    _rendererPending = false;
+
+    glsm_ctl(GLSM_CTL_STATE_BIND, nullptr);
+
+    if (!_parallelCompileEnabled && gl_query_extension("KHR_parallel_shader_compile")) {
+        // If the driver can compile shaders on its own threads, let it use as many as it likes
+        using MaxShaderCompilerThreadsFunc = void (*)(GLuint);
+        if (auto maxThreads = reinterpret_cast<MaxShaderCompilerThreadsFunc>(hw_render.get_proc_address("glMaxShaderCompilerThreadsKHR"))) {
+            maxThreads(0xFFFFFFFF);
+            retro::debug("Enabled parallel shader compilation");
+        }
+        _parallelCompileEnabled = true;
+    }
+
+    if (auto glRenderer = melonDS::GLRenderer::New()) {
+        retro::debug("Constructed OpenGL renderer");
+        glRenderer->SetRenderSettings(config.BetterPolygonSplitting(), RenderScale(config));
+        nds.GPU.SetRenderer3D(std::move(glRenderer));
+        retro::debug("Installed OpenGL renderer");
+        _needsRefresh = true;
+    }
+    else {
+        // The software renderer's output is still presented with OpenGL, so the game can keep going
+        retro::error("Failed to initialize OpenGL renderer!");
+        retro::set_warn_message("Failed to initialize OpenGL renderer, falling back to software mode.");
+    }
+
+    glsm_ctl(GLSM_CTL_STATE_UNBIND, nullptr);
+}
+
+void MelonDsDs::OpenGLRenderState::UploadSoftwareScreens(const melonDS::NDS& nds) noexcept {
+    ZoneScopedN(TracyFunction);
+    TracyGpuZone(TracyFunction);
+
+    constexpr GLsizeiptr SCREEN_BYTES = NDS_SCREEN_AREA<GLsizeiptr> * PIXEL_SIZE;
+    const uint32_t* topScreen = nds.GPU.Framebuffer[nds.GPU.FrontBuffer][0].get();
+    const uint32_t* bottomScreen = nds.GPU.Framebuffer[nds.GPU.FrontBuffer][1].get();
+
+    GlCall(glBindTexture, GL_TEXTURE_2D, screen_framebuffer_texture);
+
+    // The screen shader expects the same byte order as the software renderer's output,
+    // so the screens can be uploaded as-is
+    GlCall(glPixelStorei, GL_UNPACK_ALIGNMENT, 4);
+
+    // Stream the screens through alternating PBOs,
+    // so the upload doesn't have to wait for the GPU to finish with the last frame's
+    GLuint pbo = _screenPbos[_screenPboIndex];
+    _screenPboIndex = (_screenPboIndex + 1) % _screenPbos.size();
+    GlCall(glBindBuffer, GL_PIXEL_UNPACK_BUFFER, pbo);
+    GlCall(glBufferData, GL_PIXEL_UNPACK_BUFFER, SCREEN_BYTES * 2, nullptr, GL_STREAM_DRAW); // Orphan the old storage
+    auto* mapping = static_cast<std::byte*>(GlCall(glMapBufferRange, GL_PIXEL_UNPACK_BUFFER, 0, SCREEN_BYTES * 2, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    if (mapping) {
+        memcpy(mapping, topScreen, SCREEN_BYTES);
+        memcpy(mapping + SCREEN_BYTES, bottomScreen, SCREEN_BYTES);
+        GlCall(glUnmapBuffer, GL_PIXEL_UNPACK_BUFFER);
+        GlCall(glTexSubImage2D, GL_TEXTURE_2D, 0, 0, 0, NDS_SCREEN_WIDTH, NDS_SCREEN_HEIGHT * 2, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+
+    // The 3D renderer uploads its own textures from client memory, so don't leave the PBO bound
+    GlCall(glBindBuffer, GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (!mapping) {
+        // If the PBO couldn't be mapped, upload straight from the emulator's framebuffers
+        GlCall(glTexSubImage2D, GL_TEXTURE_2D, 0, 0, 0, NDS_SCREEN_WIDTH, NDS_SCREEN_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, topScreen);
+        GlCall(glTexSubImage2D, GL_TEXTURE_2D, 0, 0, NDS_SCREEN_HEIGHT, NDS_SCREEN_WIDTH, NDS_SCREEN_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, bottomScreen);
+    }
 }
 
 void MelonDsDs::OpenGLRenderState::ContextDestroyed() {
@@ -471,11 +1014,44 @@ void MelonDsDs::OpenGLRenderState::ContextDestroyed() {
     _screenProgram = 0;
     screen_framebuffer_texture = 0;
     screen_vertices = {};
-    vertexCount = 0;
+    vertexCounts = {};
+    _vertexGeneration = std::nullopt;
+    _drawnLayoutIndex = 0;
     vao = 0;
     vbo = 0;
     GL_ShaderConfig = {};
+    _uploadedShaderConfig = {};
+    _shaderConfigUploaded = false;
     ubo = 0;
+    _uboStride = 0;
+    _uboMapping = nullptr;
+    _uboFences = {};
+    _uboIndex = 0;
+    _outputTextureFilters = {};
+    _filteredRenderer = nullptr;
+    _screenTextureFilter = 0;
+    _screenPbos = {};
+    _screenPboIndex = 0;
+    _rendererPending = false;
+    _parallelCompileEnabled = false;
+    _warmupFrames = 0;
+    _glCalls = 0;
+    _glCallsLastFrame = 0;
+    _frameReadback = std::nullopt;
+    _lastFrameChecksum = std::nullopt;
+    _readbackFrames.clear();
+    _frameFences = {};
+    _frameFenceIndex = 0;
+    _timerQueriesAvailable = false;
+    _activeTimerQuery = std::nullopt;
+    _timerQueries = {};
+    _timerQueryPending = {};
+    _timerQueryIndex = 0;
+    _gpuFrameTime = std::nullopt;
+    _gpuStageTimes = std::nullopt;
+    _fenceWaitTime = 0;
+    _dynamicScale = config::video::MAX_OPENGL_SCALE;
+    _framesSinceScaleChange = 0;
     // TODO: Delete these objects, since the context hasn't been destroyed yet
     // (just in case it's not really destroyed afterwards)
 
@@ -487,35 +1063,112 @@ void MelonDsDs::OpenGLRenderState::ContextDestroyed() {
 void MelonDsDs::OpenGLRenderState::InitFrameState(melonDS::NDS& nds, const CoreConfig& config, const ScreenLayoutData& screenLayout) noexcept {
     ZoneScopedN(TracyFunction);
     TracyGpuZone(TracyFunction);
-    retro_assert(nds.GPU.GetRenderer3D().Accelerated);
 
     glClearColor(0, 0, 0, 0);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    melonDS::GLRenderer& renderer = static_cast<melonDS::GLRenderer&>(nds.GPU.GetRenderer3D());
-    renderer.SetRenderSettings(config.BetterPolygonSplitting(), config.ScaleFactor());
+    if (nds.GPU.GetRenderer3D().Accelerated) {
+        // If the OpenGL renderer is installed (rather than still warming up)...
+        melonDS::GLRenderer& renderer = static_cast<melonDS::GLRenderer&>(nds.GPU.GetRenderer3D());
+        renderer.SetRenderSettings(config.BetterPolygonSplitting(), RenderScale(config));
+    }
+
+    // Changing the render settings may recreate the output textures with their default filters
+    _outputTextureFilters = {};
 
-    GL_ShaderConfig.uScreenSize = screenLayout.BufferSize();
+    GL_ShaderConfig.uScreenSize = screenLayout.OutputSize();
     GL_ShaderConfig.u3DScale = screenLayout.Scale();
     GL_ShaderConfig.cursorPos = vec4(-1);
 
-    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
-    void *unibuf = glMapBuffer(GL_UNIFORM_BUFFER, GL_WRITE_ONLY);
-    if (unibuf) memcpy(unibuf, &GL_ShaderConfig, sizeof(GL_ShaderConfig));
-    glUnmapBuffer(GL_UNIFORM_BUFFER);
+    UploadShaderConfig();
 
     InitVertices(screenLayout);
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(screen_vertices), screen_vertices.data());
+void MelonDsDs::OpenGLRenderState::UploadShaderConfig() noexcept {
+    ZoneScopedN(TracyFunction);
+    TracyGpuZone(TracyFunction);
+
+    if (_shaderConfigUploaded && memcmp(&GL_ShaderConfig, &_uploadedShaderConfig, sizeof(GL_ShaderConfig)) == 0) {
+        // If the GPU already has this config, then there's nothing to upload
+        return;
+    }
+
+    if (_uboMapping) {
+        unsigned next = (_uboIndex + 1) % UBO_RING_SIZE;
+        GLsync& fence = _uboFences[next];
+        if (fence && GlCall(glClientWaitSync, fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            // If the GPU is still reading the next copy, then let the driver handle the synchronization
+            // (rather than waiting on the fence ourselves)
+            GlCall(glBindBuffer, GL_UNIFORM_BUFFER, ubo);
+            GlCall(glBufferSubData, GL_UNIFORM_BUFFER, _uboIndex * _uboStride, sizeof(GL_ShaderConfig), &GL_ShaderConfig);
+        }
+        else {
+            if (fence) {
+                GlCall(glDeleteSync, fence);
+                fence = nullptr;
+            }
+
+            memcpy(static_cast<std::byte*>(_uboMapping) + next * _uboStride, &GL_ShaderConfig, sizeof(GL_ShaderConfig));
+            _uboIndex = next;
+            GlCall(glBindBufferRange, GL_UNIFORM_BUFFER, 16, ubo, _uboIndex * _uboStride, _uboStride);
+        }
+    }
+    else {
+        GlCall(glBindBuffer, GL_UNIFORM_BUFFER, ubo);
+        GlCall(glBufferSubData, GL_UNIFORM_BUFFER, 0, sizeof(GL_ShaderConfig), &GL_ShaderConfig);
+    }
+
+    memcpy(&_uploadedShaderConfig, &GL_ShaderConfig, sizeof(GL_ShaderConfig));
+    _shaderConfigUploaded = true;
 }
 
 void MelonDsDs::OpenGLRenderState::InitVertices(const ScreenLayoutData& screenLayout) noexcept {
     ZoneScopedN(TracyFunction);
-    ScreenLayout layout = screenLayout.Layout();
+    TracyGpuZone(TracyFunction);
     HybridSideScreenDisplay hybridSideScreenDisplay = screenLayout.HybridSmallScreenLayout();
-    vertexCount = GetVertexCount(layout, hybridSideScreenDisplay);
+    for (unsigned i = 0; i < screenLayout.NumberOfLayouts(); ++i) {
+        ScreenLayout layout = screenLayout.Layout(i);
+        vertexCounts[i] = GetVertexCount(layout, hybridSideScreenDisplay);
+        InitLayoutVertices(screen_vertices[i], layout, screenLayout.TransformedScreenPoints(i));
+        if (unsigned quarterTurns = screenLayout.CoreRotation(i)) {
+            // If the frontend can't rotate the screen, then we'll have to draw it rotated ourselves
+            RotateLayoutVertices(screen_vertices[i], quarterTurns, screenLayout.BufferSize(i));
+        }
+    }
 
-    const array<vec2, 12>& transformedPoints = screenLayout.TransformedScreenPoints();
+    // Upload every layout's vertices now, so that switching layouts doesn't have to
+    GlCall(glBindBuffer, GL_ARRAY_BUFFER, vbo);
+    GlCall(glBufferSubData, GL_ARRAY_BUFFER, 0, sizeof(screen_vertices[0]) * screenLayout.NumberOfLayouts(), screen_vertices.data());
+    _vertexGeneration = screenLayout.Generation();
+    _drawnLayoutIndex = screenLayout.LayoutIndex();
+}
+
+void MelonDsDs::OpenGLRenderState::RotateLayoutVertices(std::array<Vertex, 18>& vertices, unsigned quarterTurns, glm::uvec2 bufferSize) noexcept {
+    // Counter-clockwise, like RETRO_ENVIRONMENT_SET_ROTATION and pixels::RotateRect
+    vec2 size(bufferSize);
+    for (Vertex& vertex : vertices) {
+        vec2 p = vertex.position;
+        switch (quarterTurns % 4) {
+            case 1:
+                vertex.position = vec2(p.y, size.x - p.x);
+                break;
+            case 2:
+                vertex.position = size - p;
+                break;
+            case 3:
+                vertex.position = vec2(size.y - p.y, p.x);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void MelonDsDs::OpenGLRenderState::InitLayoutVertices(
+    std::array<Vertex, 18>& vertices,
+    ScreenLayout layout,
+    const array<vec2, 12>& transformedPoints
+) noexcept {
     array<unsigned, 18> indexes = GetPositionIndexes(layout);
 
     // melonDS's OpenGL renderer draws both screens into a single texture,
@@ -531,13 +1184,13 @@ void MelonDsDs::OpenGLRenderState::InitVertices(const ScreenLayoutData& screenLa
         case ScreenLayout::FlippedLargescreenBottom:
             for (unsigned i = 0; i < VERTEXES_PER_SCREEN; ++i) {
                 // Top screen
-                screen_vertices[i] = {
+                vertices[i] = {
                     .position = transformedPoints[indexes[i]],
                     .texcoord = TOP_SCREEN_TEXCOORDS[i],
                 };
 
                 // Touch screen
-                screen_vertices[i + VERTEXES_PER_SCREEN] = {
+                vertices[i + VERTEXES_PER_SCREEN] = {
                     .position = transformedPoints[indexes[i + VERTEXES_PER_SCREEN]],
                     .texcoord = BOTTOM_SCREEN_TEXCOORDS[i],
                 };
@@ -549,13 +1202,13 @@ void MelonDsDs::OpenGLRenderState::InitVertices(const ScreenLayoutData& screenLa
         case ScreenLayout::FlippedLargescreenTop:
             for (unsigned i = 0; i < VERTEXES_PER_SCREEN; ++i) {
                 // Top screen
-                screen_vertices[i] = {
+                vertices[i] = {
                     .position = transformedPoints[indexes[i]],
                     .texcoord = BOTTOM_SCREEN_TEXCOORDS[i],
                 };
 
                 // Touch screen
-                screen_vertices[i + VERTEXES_PER_SCREEN] = {
+                vertices[i + VERTEXES_PER_SCREEN] = {
                     .position = transformedPoints[indexes[i + VERTEXES_PER_SCREEN]],
                     .texcoord = TOP_SCREEN_TEXCOORDS[i],
                 };
@@ -563,7 +1216,7 @@ void MelonDsDs::OpenGLRenderState::InitVertices(const ScreenLayoutData& screenLa
             break;
         case ScreenLayout::TopOnly:
             for (unsigned i = 0; i < VERTEXES_PER_SCREEN; ++i) {
-                screen_vertices[i] = {
+                vertices[i] = {
                     .position = transformedPoints[indexes[i]],
                     .texcoord = TOP_SCREEN_TEXCOORDS[i],
                 };
@@ -571,7 +1224,7 @@ void MelonDsDs::OpenGLRenderState::InitVertices(const ScreenLayoutData& screenLa
             break;
         case ScreenLayout::BottomOnly:
             for (unsigned i = 0; i < VERTEXES_PER_SCREEN; ++i) {
-                screen_vertices[i] = {
+                vertices[i] = {
                     .position = transformedPoints[indexes[i]],
                     .texcoord = BOTTOM_SCREEN_TEXCOORDS[i],
                 };
@@ -581,19 +1234,19 @@ void MelonDsDs::OpenGLRenderState::InitVertices(const ScreenLayoutData& screenLa
         case ScreenLayout::FlippedHybridTop:
             for (unsigned i = 0; i < VERTEXES_PER_SCREEN; ++i) {
                 // Hybrid screen
-                screen_vertices[i] = {
+                vertices[i] = {
                     .position = transformedPoints[indexes[i]],
                     .texcoord = TOP_SCREEN_TEXCOORDS[i],
                 };
 
                 // Bottom screen
-                screen_vertices[i + VERTEXES_PER_SCREEN] = {
+                vertices[i + VERTEXES_PER_SCREEN] = {
                     .position = transformedPoints[indexes[i + VERTEXES_PER_SCREEN]],
                     .texcoord = BOTTOM_SCREEN_TEXCOORDS[i],
                 };
 
                 // Top screen
-                screen_vertices[i + 2*VERTEXES_PER_SCREEN] = {
+                vertices[i + 2*VERTEXES_PER_SCREEN] = {
                     .position = transformedPoints[indexes[i + 2*VERTEXES_PER_SCREEN]],
                     .texcoord = TOP_SCREEN_TEXCOORDS[i],
                 };
@@ -604,19 +1257,19 @@ void MelonDsDs::OpenGLRenderState::InitVertices(const ScreenLayoutData& screenLa
         case ScreenLayout::FlippedHybridBottom:
             for (unsigned i = 0; i < VERTEXES_PER_SCREEN; ++i) {
                 // Hybrid screen
-                screen_vertices[i] = {
+                vertices[i] = {
                     .position = transformedPoints[indexes[i]],
                     .texcoord = BOTTOM_SCREEN_TEXCOORDS[i],
                 };
 
                 // Top screen
-                screen_vertices[i + VERTEXES_PER_SCREEN] = {
+                vertices[i + VERTEXES_PER_SCREEN] = {
                     .position = transformedPoints[indexes[i + VERTEXES_PER_SCREEN]],
                     .texcoord = TOP_SCREEN_TEXCOORDS[i],
                 };
 
                 // Bottom screen
-                screen_vertices[i + 2*VERTEXES_PER_SCREEN] = {
+                vertices[i + 2*VERTEXES_PER_SCREEN] = {
                     .position = transformedPoints[indexes[i + 2*VERTEXES_PER_SCREEN]],
                     .texcoord = BOTTOM_SCREEN_TEXCOORDS[i],
                 };
@@ -19,10 +19,15 @@
 #define MELONDSDS_RENDER_OPENGL_HPP
 
 #include <array>
+#include <deque>
 #include <memory>
 #include <optional>
+#include <vector>
 
+#include "config/constants.hpp"
+#include "config/types.hpp"
 #include "render.hpp"
+#include "readback.hpp"
 
 #include "PlatformOGLPrivate.h"
 #include <glm/vec2.hpp>
@@ -33,20 +38,29 @@
 #include "tracy/opengl.hpp"
 #endif
 
+namespace melonDS {
+    class GLRenderer;
+}
+
 namespace MelonDsDs {
     using glm::vec2;
     using glm::vec4;
 
     class OpenGLRenderState final : public RenderState {
     public:
-        static std::unique_ptr<OpenGLRenderState> New() noexcept;
-        OpenGLRenderState();
+        /// \param softwareComposition If true, the software renderer's screens are composited with OpenGL
+        /// instead of using the OpenGL 3D renderer.
+        /// \param stateIsolation Whether to skip saving and restoring the GL state around each frame.
+        /// Only read when the context is requested, so changing it requires a new render state.
+        static std::unique_ptr<OpenGLRenderState> New(bool softwareComposition, OpenGlStateIsolation stateIsolation) noexcept;
+        OpenGLRenderState(bool softwareComposition, OpenGlStateIsolation stateIsolation);
         ~OpenGLRenderState() noexcept override;
         OpenGLRenderState(const OpenGLRenderState&) = delete;
         OpenGLRenderState(OpenGLRenderState&&) = delete;
         OpenGLRenderState& operator=(const OpenGLRenderState&) = delete;
         OpenGLRenderState& operator=(OpenGLRenderState&&) = delete;
         [[nodiscard]] bool Ready() const noexcept override { return _contextInitialized; }
+        void BeginFrame(const CoreConfig& config) noexcept override;
         void Render(
             melonDS::NDS& nds,
             const InputState& input,
@@ -58,6 +72,24 @@ namespace MelonDsDs {
             _needsRefresh = true;
         }
 
+        [[nodiscard]] unsigned GlCallsLastFrame() const noexcept override { return _glCallsLastFrame; }
+        [[nodiscard]] std::optional<float> GpuFrameTime() const noexcept override { return _gpuFrameTime; }
+        [[nodiscard]] std::optional<GpuStageTimes> GpuFrameStages() const noexcept override { return _gpuStageTimes; }
+        void SetFrameReadbackEnabled(bool enabled) noexcept override;
+        [[nodiscard]] std::optional<uint32_t> LastFrameChecksum() const noexcept override { return _lastFrameChecksum; }
+        void TakeFrameChecksums(std::vector<FrameChecksum>& checksums) noexcept override;
+        void SkipFrameReadback() noexcept override {
+            if (_frameReadbackEnabled)
+                ++_framesReadBack;
+        }
+
+        /// Installs the OpenGL 3D renderer after a few frames,
+        /// presenting the software renderer's output in the meantime.
+        void RequestRenderer() noexcept;
+
+        [[nodiscard]] bool SoftwareComposition() const noexcept { return _softwareComposition; }
+        void SetSoftwareComposition(bool softwareComposition) noexcept;
+
         void ContextReset(melonDS::NDS& nds, const CoreConfig& config);
         void ContextDestroyed();
     private:
@@ -71,25 +103,120 @@ namespace MelonDsDs {
         void SetUpCoreOpenGlState(const CoreConfig& config);
         void InitFrameState(melonDS::NDS& nds, const CoreConfig& config, const ScreenLayoutData& screenLayout) noexcept;
         void InitVertices(const ScreenLayoutData& screenLayout) noexcept;
+        static void InitLayoutVertices(std::array<Vertex, 18>& vertices, ScreenLayout layout, const std::array<vec2, 12>& transformedPoints) noexcept;
+        /// Turns a layout's vertices \c quarterTurns times counter-clockwise, for when the frontend can't rotate the screen.
+        static void RotateLayoutVertices(std::array<Vertex, 18>& vertices, unsigned quarterTurns, glm::uvec2 bufferSize) noexcept;
+        void InstallRenderer(melonDS::NDS& nds, const CoreConfig& config) noexcept;
+        void UploadSoftwareScreens(const melonDS::NDS& nds) noexcept;
+        void ReadBackFrame(GLuint fbo, const ScreenLayoutData& screenLayout) noexcept;
+        void WaitForFramesInFlight(unsigned maxFramesInFlight) noexcept;
+        void CollectTimerQueries() noexcept;
+        void UpdateDynamicResolution(const CoreConfig& config) noexcept;
+        [[nodiscard]] int RenderScale(const CoreConfig& config) const noexcept;
+
+        // Number of frames presented with the software renderer before compiling the OpenGL renderer,
+        // so the frontend has something to show in the meantime
+        static constexpr unsigned WARMUP_FRAMES = 1;
+        bool _softwareComposition = false;
+        /// If true, the frontend won't touch our GL state between frames,
+        /// so Render only resets what melonDS's 3D renderer may have changed
+        bool _stateIsolated = false;
+        bool _rendererPending = false;
+        bool _parallelCompileEnabled = false;
+        unsigned _warmupFrames = 0;
         bool _openGlDebugAvailable = false;
         bool _needsRefresh = true;
         bool _contextInitialized = false;
         GLuint _screenProgram = 0;
         GLuint screen_framebuffer_texture = 0;
-        std::array<Vertex, 18> screen_vertices {};
-        unsigned vertexCount = 0;
+        /// Vertices for each configured screen layout, all uploaded at once
+        /// so that switching layouts only changes which ones are drawn
+        std::array<std::array<Vertex, 18>, config::screen::MAX_SCREEN_LAYOUTS> screen_vertices {};
+        std::array<unsigned, config::screen::MAX_SCREEN_LAYOUTS> vertexCounts {};
+        /// The \c ScreenLayoutData::Generation that \c screen_vertices was built from
+        std::optional<uint32_t> _vertexGeneration;
+        unsigned _drawnLayoutIndex = 0;
         GLuint vao = 0;
         GLuint vbo = 0;
 
-        struct {
+        struct ShaderConfig {
             vec2 uScreenSize;
             uint32_t u3DScale;
             uint32_t uFilterMode;
             vec4 cursorPos;
             bool cursorVisible;
-        } GL_ShaderConfig {};
+        };
+
+        void UploadShaderConfig() noexcept;
+
+        // Issues an OpenGL call and counts it towards this frame's tally
+        template<typename Function, typename... Args>
+        auto GlCall(Function function, Args... args) noexcept {
+            ++_glCalls;
+            return function(args...);
+        }
 
+        // Number of copies of the shader config that the UBO holds when it's persistently mapped,
+        // so that we can write a new one while the GPU is still reading an older one
+        static constexpr unsigned UBO_RING_SIZE = 3;
+        ShaderConfig GL_ShaderConfig {};
+        // What the GPU last saw, so we only upload the config when it changes
+        ShaderConfig _uploadedShaderConfig {};
+        bool _shaderConfigUploaded = false;
         GLuint ubo = 0;
+        // Distance between copies of the shader config in the UBO (at least as big as the uniform block)
+        GLsizeiptr _uboStride = 0;
+        // Null if the UBO isn't persistently mapped (e.g. on GLES without buffer storage)
+        void* _uboMapping = nullptr;
+        std::array<GLsync, UBO_RING_SIZE> _uboFences {};
+        unsigned _uboIndex = 0;
+
+        // The filter we last set on each of the 3D renderer's output textures (0 if unknown),
+        // so we only set it again when the screen filter option changes
+        std::array<GLint, 2> _outputTextureFilters {};
+        const melonDS::GLRenderer* _filteredRenderer = nullptr;
+        GLint _screenTextureFilter = 0;
+        std::array<GLuint, 2> _screenPbos {};
+        unsigned _screenPboIndex = 0;
+        unsigned _glCalls = 0;
+        unsigned _glCallsLastFrame = 0;
+
+        // Signaled when the GPU finishes each of the last few frames,
+        // so the CPU doesn't get too far ahead of it
+        std::array<GLsync, config::video::MAX_FRAMES_IN_FLIGHT> _frameFences {};
+        unsigned _frameFenceIndex = 0;
+
+        // Measures how long the GPU spends on each frame (if supported);
+        // there's one more set of queries than frames in flight so we never wait on a result.
+        // Time-elapsed queries can't nest, so each frame is timed as consecutive stages.
+        static constexpr unsigned TIMER_QUERY_COUNT = config::video::MAX_FRAMES_IN_FLIGHT + 1;
+        static constexpr unsigned GPU_STAGE_EMULATION = 0;
+        static constexpr unsigned GPU_STAGE_PRESENTATION = 1;
+        static constexpr unsigned GPU_STAGE_COUNT = 2;
+        bool _timerQueriesAvailable = false;
+        // The stage of the current frame being timed, if any
+        std::optional<unsigned> _activeTimerQuery;
+        std::array<std::array<GLuint, GPU_STAGE_COUNT>, TIMER_QUERY_COUNT> _timerQueries {};
+        std::array<bool, TIMER_QUERY_COUNT> _timerQueryPending {};
+        unsigned _timerQueryIndex = 0;
+        std::optional<float> _gpuFrameTime;
+        std::optional<GpuStageTimes> _gpuStageTimes;
+        // Recent average of how long the CPU had to wait for the GPU each frame, in milliseconds
+        // (the GPU time alone can't tell a slow GPU from a GPU that's waiting on the CPU)
+        float _fenceWaitTime = 0;
+
+        // The OpenGL renderer's scale factor when dynamic resolution is enabled
+        // (the output geometry always uses the configured scale factor)
+        int _dynamicScale = config::video::MAX_OPENGL_SCALE;
+        unsigned _framesSinceScaleChange = 0;
+
+        bool _frameReadbackEnabled = false;
+        std::optional<GlReadback> _frameReadback;
+        std::optional<uint32_t> _lastFrameChecksum;
+        // Which frame each pending readback holds, oldest first (in the same order as _frameReadback's slots)
+        std::deque<uint64_t> _readbackFrames;
+        std::vector<FrameChecksum> _frameChecksums;
+        uint64_t _framesReadBack = 0;
 
 #ifdef HAVE_TRACY
         std::optional<OpenGlTracyCapture> _tracyCapture;
@@ -0,0 +1,209 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "programcache.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+#include <compat/strl.h>
+#include <file/file_path.h>
+#include <retro_miscellaneous.h>
+#include <streams/file_stream.h>
+
+#include "environment.hpp"
+#include "tracy.hpp"
+#include "version.hpp"
+
+using std::optional;
+using std::string;
+using std::string_view;
+
+#ifdef GL_NUM_PROGRAM_BINARY_FORMATS
+namespace {
+    constexpr char PROGRAM_CACHE_MAGIC[4] = {'M', 'D', 'S', 'P'};
+    constexpr uint32_t PROGRAM_CACHE_VERSION = 1;
+
+    struct ProgramCacheHeader {
+        char magic[4];
+        uint32_t version;
+        // Hash of the driver's identity and the shader sources;
+        // if either changes, the binary is no longer valid
+        uint64_t key;
+        uint32_t format;
+        uint32_t length;
+    };
+
+    constexpr uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325;
+    constexpr uint64_t FNV_PRIME = 0x100000001b3;
+
+    uint64_t HashBytes(uint64_t hash, string_view bytes) noexcept {
+        for (char c : bytes) {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= FNV_PRIME;
+        }
+
+        // Hash a terminator as well, so that ("ab", "c") and ("a", "bc") differ
+        hash ^= 0xff;
+        hash *= FNV_PRIME;
+        return hash;
+    }
+
+    string_view GetGlString(GLenum name) noexcept {
+        const char* value = reinterpret_cast<const char*>(glGetString(name));
+        return value ? string_view(value) : string_view();
+    }
+
+    uint64_t GetProgramKey(string_view vertexSource, string_view fragmentSource) noexcept {
+        uint64_t hash = FNV_OFFSET_BASIS;
+        hash = HashBytes(hash, GetGlString(GL_VENDOR));
+        hash = HashBytes(hash, GetGlString(GL_RENDERER));
+        hash = HashBytes(hash, GetGlString(GL_VERSION));
+        hash = HashBytes(hash, MELONDSDS_VERSION);
+        hash = HashBytes(hash, vertexSource);
+        hash = HashBytes(hash, fragmentSource);
+        return hash;
+    }
+
+    bool ProgramBinariesSupported() noexcept {
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
+    }
+
+    optional<string> GetProgramCachePath(string_view name) noexcept {
+        return retro::get_system_subdir_path(fmt::format("shader_cache/{}.bin", name));
+    }
+}
+#endif
+
+GLuint MelonDsDs::LoadCachedProgram(string_view name, string_view vertexSource, string_view fragmentSource) noexcept {
+    ZoneScopedN(TracyFunction);
+#ifdef GL_NUM_PROGRAM_BINARY_FORMATS
+    if (!ProgramBinariesSupported()) {
+        retro::debug("This OpenGL driver doesn't support program binaries, not using the program cache");
+        return 0;
+    }
+
+    optional<string> path = GetProgramCachePath(name);
+    if (!path) {
+        return 0;
+    }
+
+    void* buffer = nullptr;
+    int64_t length = 0;
+    if (!filestream_read_file(path->c_str(), &buffer, &length) || !buffer) {
+        retro::debug("No cached binary for program \"{}\"", name);
+        return 0;
+    }
+
+    ProgramCacheHeader header {};
+    if (length < static_cast<int64_t>(sizeof(header))) {
+        retro::warn("Cached binary for program \"{}\" is truncated, will recompile it", name);
+        free(buffer);
+        return 0;
+    }
+
+    memcpy(&header, buffer, sizeof(header));
+    if (memcmp(header.magic, PROGRAM_CACHE_MAGIC, sizeof(PROGRAM_CACHE_MAGIC)) != 0 ||
+        header.version != PROGRAM_CACHE_VERSION ||
+        header.key != GetProgramKey(vertexSource, fragmentSource) ||
+        header.length != length - static_cast<int64_t>(sizeof(header))) {
+        // If the driver or the shaders changed since the binary was cached...
+        retro::info("Cached binary for program \"{}\" is out of date, will recompile it", name);
+        free(buffer);
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.format, static_cast<const std::byte*>(buffer) + sizeof(header), header.length);
+    free(buffer);
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (linked != GL_TRUE) {
+        // The driver is allowed to reject a binary for any reason (e.g. an update that kept the version string)
+        retro::info("OpenGL driver rejected the cached binary for program \"{}\", will recompile it", name);
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    retro::debug("Loaded program \"{}\" from \"{}\"", name, *path);
+    return program;
+#else
+    return 0;
+#endif
+}
+
+void MelonDsDs::CacheProgram(GLuint program, string_view name, string_view vertexSource, string_view fragmentSource) noexcept {
+    ZoneScopedN(TracyFunction);
+#ifdef GL_NUM_PROGRAM_BINARY_FORMATS
+    if (!ProgramBinariesSupported()) {
+        return;
+    }
+
+    optional<string> path = GetProgramCachePath(name);
+    if (!path) {
+        retro::warn("Failed to get the path of the program cache");
+        return;
+    }
+
+    GLint binaryLength = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+    if (binaryLength <= 0) {
+        retro::debug("OpenGL driver didn't provide a binary for program \"{}\"", name);
+        return;
+    }
+
+    std::vector<std::byte> contents(sizeof(ProgramCacheHeader) + binaryLength);
+    ProgramCacheHeader header {};
+    memcpy(header.magic, PROGRAM_CACHE_MAGIC, sizeof(PROGRAM_CACHE_MAGIC));
+    header.version = PROGRAM_CACHE_VERSION;
+    header.key = GetProgramKey(vertexSource, fragmentSource);
+
+    GLsizei written = 0;
+    GLenum format = 0;
+    glGetProgramBinary(program, binaryLength, &written, &format, contents.data() + sizeof(header));
+    if (written <= 0) {
+        retro::warn("Failed to get the binary for program \"{}\"", name);
+        return;
+    }
+
+    header.format = format;
+    header.length = written;
+    memcpy(contents.data(), &header, sizeof(header));
+
+    char dir[PATH_MAX_LENGTH];
+    strlcpy(dir, path->c_str(), sizeof(dir));
+    path_basedir(dir);
+    if (!path_mkdir(dir)) {
+        retro::warn("Failed to create directory \"{}\" for the program cache", dir);
+        return;
+    }
+
+    if (filestream_write_file(path->c_str(), contents.data(), sizeof(header) + written)) {
+        retro::debug("Cached {}-byte binary for program \"{}\" in \"{}\"", written, name, *path);
+    }
+    else {
+        retro::warn("Failed to write program cache to \"{}\"", *path);
+    }
+#endif
+}
@@ -0,0 +1,35 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#ifndef MELONDSDS_RENDER_PROGRAMCACHE_HPP
+#define MELONDSDS_RENDER_PROGRAMCACHE_HPP
+
+#include <string_view>
+
+#include "PlatformOGLPrivate.h"
+
+namespace MelonDsDs {
+    /// Creates a linked program from a binary cached by an earlier session,
+    /// if one exists for the current driver and the given shader sources.
+    /// \returns The new program, or 0 if there was no usable cached binary.
+    GLuint LoadCachedProgram(std::string_view name, std::string_view vertexSource, std::string_view fragmentSource) noexcept;
+
+    /// Saves a linked program's binary so that later sessions can skip compiling it.
+    void CacheProgram(GLuint program, std::string_view name, std::string_view vertexSource, std::string_view fragmentSource) noexcept;
+}
+
+#endif // MELONDSDS_RENDER_PROGRAMCACHE_HPP
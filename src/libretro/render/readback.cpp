@@ -0,0 +1,168 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "readback.hpp"
+
+#include <fmt/format.h>
+
+#include "tracy.hpp"
+
+using glm::uvec2;
+
+MelonDsDs::GlReadback::GlReadback(uvec2 size, bool debug, const char* label) noexcept : _size(size), _debug(debug) {
+    ZoneScopedN(TracyFunction);
+
+    // Allocate the textures for the resized image
+    glGenTextures(FRAME_LAG, _textures.data());
+
+    // Create some FBOs to let us write to the textures
+    glGenFramebuffers(FRAME_LAG, _fbos.data());
+
+    // Create some PBOs to let the CPU read from the textures
+    glGenBuffers(FRAME_LAG, _pbos.data());
+
+    if (_debug) {
+        for (unsigned i = 0; i < FRAME_LAG; ++i) {
+            fmt::basic_memory_buffer<char, 1024> labelBuffer;
+            fmt::format_to(std::back_inserter(labelBuffer), "{} Texture #{}{}", label, i, '\0');
+            glObjectLabel(GL_TEXTURE, _textures[i], -1, labelBuffer.data());
+            labelBuffer.clear();
+            fmt::format_to(std::back_inserter(labelBuffer), "{} FBO #{}{}", label, i, '\0');
+            glObjectLabel(GL_FRAMEBUFFER, _fbos[i], -1, labelBuffer.data());
+            labelBuffer.clear();
+            fmt::format_to(std::back_inserter(labelBuffer), "{} PBO #{}{}", label, i, '\0');
+            glObjectLabel(GL_BUFFER, _pbos[i], -1, labelBuffer.data());
+        }
+    }
+
+    GLint oldFbo = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &oldFbo);
+    for (unsigned i = 0; i < FRAME_LAG; i++) {
+        // Let's configure one texture at a time...
+        glBindTexture(GL_TEXTURE_2D, _textures[i]);
+
+        // We'll use nearest-neighbor interpolation to avoid blurring
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        // And we want our texture to be 2D, in RGBA format, without mipmaps,
+        // and with each component being an unsigned byte.
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, _size.x, _size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+        // Now we'll configure the FBO used to draw to this texture...
+        glBindFramebuffer(GL_FRAMEBUFFER, _fbos[i]);
+
+        // ...we'll attach a texture to the new FBO.
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _textures[i], 0);
+
+        // And we'll create a new PBO so we can read from the texture.
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, _pbos[i]);
+
+        // And the PBO has to be big enough to hold the whole image.
+        glBufferData(GL_PIXEL_PACK_BUFFER, _size.x * _size.y * 4, nullptr, GL_STREAM_READ);
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, oldFbo);
+}
+
+MelonDsDs::GlReadback::~GlReadback() noexcept {
+    ZoneScopedN(TracyFunction);
+
+    glDeleteTextures(FRAME_LAG, _textures.data());
+    glDeleteFramebuffers(FRAME_LAG, _fbos.data());
+    glDeleteBuffers(FRAME_LAG, _pbos.data());
+
+    for (GLsync fence : _fences) {
+        if (fence) {
+            glDeleteSync(fence);
+        }
+    }
+}
+
+bool MelonDsDs::GlReadback::Request(GLuint sourceFbo, uvec2 sourceSize) noexcept {
+    ZoneScopedN(TracyFunction);
+
+    if (_pending == FRAME_LAG) {
+        // If every slot is still waiting on the GPU, then drop this request rather than wait
+        return false;
+    }
+
+    unsigned index = (_oldest + _pending) % FRAME_LAG;
+
+    // Get the capture FBO ready to receive the image...
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, sourceFbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _fbos[index]);
+
+    // Copy the source framebuffer's contents to the capture FBO, scaling along the way
+    glBlitFramebuffer(0, 0, sourceSize.x, sourceSize.y, 0, 0, _size.x, _size.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+    // Get the capture FBO ready to read its contents out...
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, _fbos[index]);
+
+    // Get the PBO ready to receive the image...
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, _pbos[index]);
+
+    // Actually read the image into the PBO
+    // (nullptr means to read data into the bound PBO, not to the CPU)
+    glReadPixels(0, 0, _size.x, _size.y, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    // Okay, now we're done with the capture FBO; you can have the source FBO back
+    glBindFramebuffer(GL_FRAMEBUFFER, sourceFbo);
+
+    // Create a new fence that'll go off when every OpenGL command that came before it finishes
+    // (No other acceptable arguments are currently defined for glFenceSync)
+    _fences[index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    if (_debug) {
+        fmt::basic_memory_buffer<char, 1024> labelBuffer;
+        fmt::format_to(std::back_inserter(labelBuffer), "Readback Fence Slot #{}{}", index, '\0');
+        glObjectPtrLabel(_fences[index], -1, labelBuffer.data());
+    }
+    ++_pending;
+    return true;
+}
+
+void MelonDsDs::GlReadback::Collect(const Callback& callback) noexcept {
+    ZoneScopedN(TracyFunction);
+
+    while (_pending > 0) {
+        // Until we've checked all the pending fences...
+        GLsync& fence = _fences[_oldest];
+
+        // Check this fence, but don't wait for it
+        // If the fence hasn't gone off yet, then stop checking
+        // (none of the newer fences will have been signaled yet)
+        if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) break;
+
+        // The fence has been signaled!
+        // That means the image we want is ready to read.
+        glDeleteSync(fence);
+        fence = nullptr;
+
+        // Expose the PBO's contents to RAM
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, _pbos[_oldest]);
+        if (const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, _size.x * _size.y * 4, GL_MAP_READ_BIT)) {
+            callback(static_cast<const uint8_t*>(pixels), _size, _pending - 1);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        _oldest = (_oldest + 1) % FRAME_LAG;
+        --_pending;
+    }
+}
@@ -0,0 +1,72 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#ifndef MELONDSDS_RENDER_READBACK_HPP
+#define MELONDSDS_RENDER_READBACK_HPP
+
+#include <array>
+#include <cstdint>
+#include <functional>
+
+#include "PlatformOGLPrivate.h"
+#include <glm/vec2.hpp>
+
+namespace MelonDsDs {
+    /// \brief Reads frames back from the GPU without stalling the CPU.
+    /// Each request copies (and scales) a framebuffer into a texture of its own,
+    /// then reads that into a PBO guarded by a fence;
+    /// finished readbacks are collected on later frames once their fences have gone off.
+    class GlReadback {
+    public:
+        /// Called for each finished readback with RGBA8888 pixels,
+        /// bottom row first (as OpenGL provides them), and how many requests are still pending.
+        using Callback = std::function<void(const uint8_t* pixels, glm::uvec2 size, unsigned pending)>;
+
+        GlReadback(glm::uvec2 size, bool debug, const char* label) noexcept;
+        ~GlReadback() noexcept;
+
+        // Copying the OpenGL objects is too much of a hassle.
+        GlReadback(const GlReadback&) = delete;
+        GlReadback& operator=(const GlReadback&) = delete;
+        GlReadback(GlReadback&&) = delete;
+        GlReadback& operator=(GlReadback&&) = delete;
+
+        /// Queues a copy of the region of \c sourceFbo that starts at the origin and has the given size,
+        /// scaled to this readback's size. Leaves \c sourceFbo bound.
+        /// \returns \c false if every slot is still waiting on the GPU, in which case nothing is queued.
+        bool Request(GLuint sourceFbo, glm::uvec2 sourceSize) noexcept;
+
+        /// Calls \c callback for each finished readback (oldest first) without waiting for the GPU.
+        void Collect(const Callback& callback) noexcept;
+
+        [[nodiscard]] glm::uvec2 Size() const noexcept { return _size; }
+        [[nodiscard]] unsigned Pending() const noexcept { return _pending; }
+    private:
+        static constexpr unsigned FRAME_LAG = 4;
+        glm::uvec2 _size;
+        std::array<GLuint, FRAME_LAG> _textures {};
+        std::array<GLuint, FRAME_LAG> _fbos {};
+        std::array<GLuint, FRAME_LAG> _pbos {};
+        std::array<GLsync, FRAME_LAG> _fences {};
+        // Index of the oldest pending readback
+        unsigned _oldest = 0;
+        unsigned _pending = 0;
+        bool _debug;
+    };
+}
+
+#endif // MELONDSDS_RENDER_READBACK_HPP
@@ -16,6 +16,8 @@
 
 #include "render.hpp"
 
+#include <algorithm>
+
 #include "PlatformOGLPrivate.h"
 
 #include <NDS.h>
@@ -23,15 +25,22 @@
 #include <retro_assert.h>
 
 #include "config/config.hpp"
+#include "environment.hpp"
 #include "message/error.hpp"
 #include "render/software.hpp"
 #include "screenlayout.hpp"
+#include "tracy/memory.hpp"
 
 #if defined(HAVE_OPENGL) || defined(HAVE_OPENGLES)
 #include <GPU3D_OpenGL.h>
 #include "render/opengl.hpp"
 #endif
 
+#ifdef HAVE_VULKAN
+#include "exceptions.hpp"
+#include "render/vulkan.hpp"
+#endif
+
 
 void MelonDsDs::RenderStateWrapper::Render(
     melonDS::NDS& nds,
@@ -39,9 +48,79 @@ void MelonDsDs::RenderStateWrapper::Render(
     const CoreConfig& config,
     const ScreenLayoutData& screenLayout
 ) noexcept {
-    if (_renderState) {
+    if (!_renderState)
+        return;
+
+    if (_separateScreenOutput && !nds.GPU.GetRenderer3D().Accelerated) [[unlikely]] {
+        // The frontend reads each screen straight from the GPU's framebuffers,
+        // so don't spend any time on a composited frame that won't be shown
+        retro::video_refresh(nullptr, screenLayout.OutputWidth(), screenLayout.OutputHeight(), 0);
+        return;
+    }
+
+    if (_renderState->Ready()) [[likely]] {
         _renderState->Render(nds, input, config, screenLayout);
+        _fallbackPresented = false;
+        if (_frameReadbackEnabled && _fallback) [[unlikely]] {
+            _fallback->SkipFrameReadback();
+        }
+        return;
+    }
+
+    if (!_fallback) {
+        // If the render state has no context and nothing can stand in for it...
+        return;
+    }
+
+    _fallbackPresented = true;
+    if (_frameReadbackEnabled) [[unlikely]] {
+        // The render state didn't see this frame, but its checksums must still be numbered as if it had
+        _renderState->SkipFrameReadback();
+    }
+
+    if (screenLayout.Scale() == 1) {
+        _fallback->Render(nds, input, config, screenLayout);
+    }
+    else {
+        // The software renderer's screens are native resolution, but the layout was built for OpenGL's
+        // (only a few frames are drawn this way, so the copy isn't worth avoiding)
+        ScreenLayoutData nativeLayout = screenLayout;
+        nativeLayout.SetScale(1);
+        nativeLayout.Update();
+        _fallback->Render(nds, input, config, nativeLayout);
+    }
+}
+
+void MelonDsDs::RenderStateWrapper::TakeFrameChecksums(std::vector<FrameChecksum>& checksums) noexcept {
+    size_t first = checksums.size();
+    if (_fallback) {
+        _fallback->TakeFrameChecksums(checksums);
     }
+
+    size_t fromRenderState = checksums.size();
+    if (_renderState) {
+        _renderState->TakeFrameChecksums(checksums);
+    }
+
+    // Each list is already in order, but the render state's readbacks may lag behind the fallback's frames
+    std::inplace_merge(
+        checksums.begin() + first,
+        checksums.begin() + fromRenderState,
+        checksums.end(),
+        [](const FrameChecksum& a, const FrameChecksum& b) { return a.Frame < b.Frame; }
+    );
+}
+
+bool MelonDsDs::RenderStateWrapper::Ready(const melonDS::NDS& nds) const noexcept {
+    if (!_renderState)
+        return false;
+
+    if (_renderState->Ready()) [[likely]]
+        return true;
+
+    // Until the OpenGL context is ready, the software renderer's screens can be shown instead
+    // (but not if the OpenGL renderer is installed, since it can't run without its context)
+    return _fallback && !nds.GPU.GetRenderer3D().Accelerated;
 }
 
 void MelonDsDs::RenderStateWrapper::Render(
@@ -50,10 +129,20 @@ void MelonDsDs::RenderStateWrapper::Render(
     const ScreenLayoutData& screenLayout
 ) noexcept {
     SetRenderer(config);
-    static_cast<SoftwareRenderState*>(_renderState.get())->Render(error, screenLayout);
+    auto* softwareRenderState = dynamic_cast<SoftwareRenderState*>(_renderState.get());
+    if (!softwareRenderState) [[unlikely]] {
+        // If a GPU render state is still installed, the error screen can't be drawn with it
+        retro::warn("Replacing the current render state to draw the error screen");
+        _renderState = std::make_unique<SoftwareRenderState>(config);
+        _fallback = nullptr;
+        softwareRenderState = static_cast<SoftwareRenderState*>(_renderState.get());
+    }
+
+    softwareRenderState->Render(error, screenLayout);
 }
 
 void MelonDsDs::RenderStateWrapper::Apply(const CoreConfig& config) noexcept {
+    MemoryScope memory(MemoryTag::Render);
     SetRenderer(config);
 }
 
@@ -62,13 +151,16 @@ void MelonDsDs::RenderStateWrapper::SetRenderer(const CoreConfig& config) {
     switch (config.ConfiguredRenderer()) {
 #if defined(HAVE_OPENGL) || defined(HAVE_OPENGLES)
         case RenderMode::OpenGl: {
-            if (dynamic_cast<OpenGLRenderState*>(_renderState.get()) != nullptr) {
+            if (auto* glRender = dynamic_cast<OpenGLRenderState*>(_renderState.get())) {
                 // If we already have the OpenGL renderer configured...
+                // (we might have been compositing the software renderer's screens with it)
+                glRender->SetSoftwareComposition(false);
                 break;
             }
 
-            if (auto state = OpenGLRenderState::New()) {
+            if (auto state = OpenGLRenderState::New(false, config.StateIsolation())) {
                 _renderState = std::move(state);
+                _fallback = std::make_unique<SoftwareRenderState>(config);
                 retro::debug("Initialized OpenGL render state");
                 break;
             }
@@ -78,63 +170,171 @@ void MelonDsDs::RenderStateWrapper::SetRenderer(const CoreConfig& config) {
         }
 #endif
         case RenderMode::Software: {
+            if (config.GpuComposition() && SetGpuCompositor(config)) {
+                // If we want to composite the software renderer's screens on the GPU, and we can...
+                break;
+            }
             if (dynamic_cast<SoftwareRenderState*>(_renderState.get()) != nullptr) {
                 // If we already have the software renderer configured...
                 break;
             }
 
             _renderState = std::make_unique<SoftwareRenderState>(config);
+            _fallback = nullptr;
             retro::debug("Initialized software render state");
             break;
         }
     }
 
     retro_assert(_renderState != nullptr);
+    if (_frameReadbackEnabled) [[unlikely]] {
+        // If the render state was just replaced, the new one needs to know too
+        _renderState->SetFrameReadbackEnabled(true);
+        if (_fallback) {
+            _fallback->SetFrameReadbackEnabled(true);
+        }
+    }
+
+    if (_nv12Output && !_renderState->SetNv12Output(true)) [[unlikely]] {
+        retro::warn("This renderer can't output NV12 frames, so they'll be sent to the frontend as usual");
+    }
+}
+
+bool MelonDsDs::RenderStateWrapper::SetGpuCompositor(const CoreConfig& config) {
+#if defined(HAVE_OPENGL) || defined(HAVE_OPENGLES)
+    if (auto* glRender = dynamic_cast<OpenGLRenderState*>(_renderState.get())) {
+        // If we already have an OpenGL context, then just reuse it
+        glRender->SetSoftwareComposition(true);
+        return true;
+    }
+#endif
+
+#ifdef HAVE_VULKAN
+    if (dynamic_cast<VulkanRenderState*>(_renderState.get())) {
+        // Likewise for a Vulkan context
+        return true;
+    }
+
+    // Some frontends (and devices) have much better Vulkan drivers than OpenGL drivers,
+    // so use whichever one the frontend's video driver would rather give us
+    bool preferVulkan = retro::get_preferred_hw_render() == RETRO_HW_CONTEXT_VULKAN;
+    auto tryVulkan = [this, &config] {
+        if (auto state = VulkanRenderState::New()) {
+            _renderState = std::move(state);
+            _fallback = std::make_unique<SoftwareRenderState>(config);
+            retro::debug("Initialized Vulkan render state for composing software-rendered screens");
+            return true;
+        }
+
+        return false;
+    };
+
+    if (preferVulkan && tryVulkan()) {
+        return true;
+    }
+#endif
+
+#if defined(HAVE_OPENGL) || defined(HAVE_OPENGLES)
+    if (auto state = OpenGLRenderState::New(true, config.StateIsolation())) {
+        _renderState = std::move(state);
+        _fallback = std::make_unique<SoftwareRenderState>(config);
+        retro::debug("Initialized OpenGL render state for composing software-rendered screens");
+        return true;
+    }
+#endif
+
+#ifdef HAVE_VULKAN
+    if (!preferVulkan && tryVulkan()) {
+        return true;
+    }
+#endif
+
+#if defined(HAVE_OPENGL) || defined(HAVE_OPENGLES) || defined(HAVE_VULKAN)
+    retro::warn("Failed to initialize the GPU for screen composition, will compose screens on the CPU");
+#endif
+    return false;
+}
+
+bool MelonDsDs::RenderStateWrapper::SetNv12Output(bool enabled) noexcept {
+    if (_renderState && !_renderState->SetNv12Output(enabled)) {
+        return false;
+    }
+
+    // Remembered so that it survives renderer changes (see SetRenderer)
+    _nv12Output = enabled;
+    return true;
+}
+
+static void InstallSoftRenderer(const MelonDsDs::CoreConfig& config, melonDS::NDS& nds) noexcept {
+    if (auto* softRender = dynamic_cast<melonDS::SoftRenderer*>(&nds.GetRenderer3D())) {
+        // If we're already using the software renderer...
+        softRender->SetThreaded(config.ThreadedSoftRenderer(), nds.GPU);
+    }
+    else {
+        auto renderer = std::make_unique<melonDS::SoftRenderer>();
+        renderer->SetThreaded(config.ThreadedSoftRenderer(), nds.GPU);
+        nds.GPU.SetRenderer3D(std::move(renderer));
+    }
 }
 
 void MelonDsDs::RenderStateWrapper::UpdateRenderer(const CoreConfig& config, melonDS::NDS& nds) noexcept {
+    MemoryScope memory(MemoryTag::Render);
     assert(_renderState != nullptr);
 
     if (dynamic_cast<SoftwareRenderState*>(_renderState.get())) {
         // If we're configured to use the software renderer...
-        if (auto* softRender = dynamic_cast<melonDS::SoftRenderer*>(&nds.GetRenderer3D())) {
-            // ...and we already are...
-            softRender->SetThreaded(config.ThreadedSoftRenderer(), nds.GPU);
-        }
-        else {
-            auto renderer = std::make_unique<melonDS::SoftRenderer>();
-            renderer->SetThreaded(config.ThreadedSoftRenderer(), nds.GPU);
-            nds.GPU.SetRenderer3D(std::move(renderer));
-        }
+        InstallSoftRenderer(config, nds);
         return;
     }
 
 #if defined(HAVE_OPENGL) || defined(HAVE_OPENGLES)
-    if (auto* glRender = dynamic_cast<OpenGLRenderState*>(_renderState.get()); glRender && !nds.GPU.GetRenderer3D().Accelerated) {
-        // If we're configured to use the OpenGL renderer, and we aren't already...
-        retro::debug("Initializing OpenGL renderer");
-        if (auto renderer = melonDS::GLRenderer::New()) {
-            retro::debug("Initialized OpenGL renderer.");
-            nds.GPU.SetRenderer3D(std::move(renderer));
+    if (auto* glRender = dynamic_cast<OpenGLRenderState*>(_renderState.get())) {
+        if (glRender->SoftwareComposition()) {
+            // If we're only using OpenGL to composite the software renderer's screens...
+            InstallSoftRenderer(config, nds);
             glRender->RequestRefresh();
-        } else {
-            retro::set_warn_message("Failed to initialize OpenGL renderer, falling back to software mode.");
-            _renderState = std::make_unique<SoftwareRenderState>(config);
-            auto softwareRenderer = std::make_unique<melonDS::SoftRenderer>();
-            softwareRenderer->SetThreaded(config.ThreadedSoftRenderer(), nds.GPU);
-            nds.GPU.SetRenderer3D(std::move(softwareRenderer));
-
         }
+        else if (!nds.GPU.GetRenderer3D().Accelerated) {
+            // If we're configured to use the OpenGL renderer, and we aren't already...
+            // (The OpenGL renderer is installed once the presenter has shown a few software-rendered frames,
+            // so that compiling its shaders doesn't leave the screen frozen)
+            retro::debug("Will initialize OpenGL renderer after warming up");
+            glRender->RequestRenderer();
+            glRender->RequestRefresh();
+        }
+    }
+#endif
+
+#ifdef HAVE_VULKAN
+    if (dynamic_cast<VulkanRenderState*>(_renderState.get())) {
+        // Vulkan is only ever used to composite the software renderer's screens
+        InstallSoftRenderer(config, nds);
     }
 #endif
 }
 
 void MelonDsDs::RenderStateWrapper::ContextReset(melonDS::NDS& nds, const CoreConfig& config) {
+    MemoryScope memory(MemoryTag::Render);
 #if defined(HAVE_OPENGL) || defined(HAVE_OPENGLES)
     if (auto glRenderState = dynamic_cast<OpenGLRenderState*>(_renderState.get())) {
         glRenderState->ContextReset(nds, config);
     }
 #endif
+
+#ifdef HAVE_VULKAN
+    if (auto vkRenderState = dynamic_cast<VulkanRenderState*>(_renderState.get())) {
+        try {
+            vkRenderState->ContextReset();
+        }
+        catch (const vulkan_exception& e) {
+            // The software renderer's screens can still be shown without our help (see _fallback),
+            // so there's no need to shut down over this
+            retro::error("{}", e.what());
+            retro::set_warn_message("Failed to initialize Vulkan, screens will be composed on the CPU.");
+            vkRenderState->ContextDestroyed();
+        }
+    }
+#endif
 }
 
 void MelonDsDs::RenderStateWrapper::ContextDestroyed() {
@@ -143,6 +343,12 @@ void MelonDsDs::RenderStateWrapper::ContextDestroyed() {
         glRenderState->ContextDestroyed();
     }
 #endif
+
+#ifdef HAVE_VULKAN
+    if (auto vkRenderState = dynamic_cast<VulkanRenderState*>(_renderState.get())) {
+        vkRenderState->ContextDestroyed();
+    }
+#endif
 }
 
 std::optional<MelonDsDs::RenderMode> MelonDsDs::RenderStateWrapper::GetRenderMode() const noexcept {
@@ -153,6 +359,12 @@ std::optional<MelonDsDs::RenderMode> MelonDsDs::RenderStateWrapper::GetRenderMod
     if (dynamic_cast<OpenGLRenderState*>(_renderState.get()))
         return RenderMode::OpenGl;
 
+#ifdef HAVE_VULKAN
+    // The Vulkan render state only composites the software renderer's screens
+    if (dynamic_cast<VulkanRenderState*>(_renderState.get()))
+        return RenderMode::Software;
+#endif
+
     return std::nullopt;
 #else
     return _renderState ? std::make_optional(RenderMode::Software) : std::nullopt;
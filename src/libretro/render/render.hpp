@@ -17,8 +17,11 @@
 #ifndef MELONDS_DS_RENDER_HPP
 #define MELONDS_DS_RENDER_HPP
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <optional>
+#include <vector>
 
 #include "config/types.hpp"
 
@@ -30,11 +33,40 @@ namespace MelonDsDs {
     class InputState;
     class ScreenLayoutData;
     class CoreConfig;
+    class SoftwareRenderState;
 
     namespace error {
         class ErrorScreen;
     }
 
+    /// The CRC32 of a frame that was read back for verification.
+    struct FrameChecksum {
+        /// How many frames had been presented since readback was enabled, not counting this one
+        uint64_t Frame;
+        uint32_t Checksum;
+
+        bool operator==(const FrameChecksum&) const noexcept = default;
+    };
+
+    /// Recent averages of the GPU time spent on each stage of a frame, in milliseconds.
+    struct GpuStageTimes {
+        /// Work submitted while the emulator ran the frame,
+        /// i.e. melonDS's 3D rendering and its 2D/3D compositing.
+        float Emulation;
+        /// Drawing the composited screens into the frontend's framebuffer (and reading them back, if enabled).
+        float Presentation;
+    };
+
+    /// A presented frame in NV12, i.e. a full-resolution luma plane followed by a half-resolution interleaved chroma plane.
+    struct Nv12Frame {
+        const uint8_t* Luma = nullptr;
+        size_t LumaPitch = 0;
+        const uint8_t* Chroma = nullptr;
+        size_t ChromaPitch = 0;
+        unsigned Width = 0;
+        unsigned Height = 0;
+    };
+
     class RenderState {
     public:
         virtual ~RenderState() noexcept = default;
@@ -42,13 +74,60 @@ namespace MelonDsDs {
         /// Returns true if all state necessary for rendering is ready.
         /// This includes the OpenGL context (if applicable) and the emulator's renderer.
         virtual bool Ready() const noexcept = 0;
+        /// Called before the emulator runs each frame,
+        /// so the renderer can wait for the GPU to catch up (if necessary).
+        virtual void BeginFrame(const CoreConfig& config) noexcept {}
         virtual void Render(melonDS::NDS& nds, const InputState& input, const CoreConfig& config, const ScreenLayoutData& screenLayout) noexcept = 0;
         virtual void RequestRefresh() noexcept {}
+
+        /// Returns the recent average of the GPU time spent on each frame in milliseconds,
+        /// or \c std::nullopt if this renderer doesn't use the GPU or can't measure it.
+        [[nodiscard]] virtual std::optional<float> GpuFrameTime() const noexcept { return std::nullopt; }
+
+        /// Returns \c GpuFrameTime broken down by stage,
+        /// or \c std::nullopt if this renderer doesn't use the GPU or can't measure it.
+        [[nodiscard]] virtual std::optional<GpuStageTimes> GpuFrameStages() const noexcept { return std::nullopt; }
+
+        /// Returns the number of OpenGL calls the presenter made for the last frame,
+        /// or 0 if this renderer doesn't use OpenGL.
+        [[nodiscard]] virtual unsigned GlCallsLastFrame() const noexcept { return 0; }
+
+        /// Enables or disables reading each presented frame back from the GPU
+        /// so it can be checksummed, if this renderer supports it.
+        virtual void SetFrameReadbackEnabled(bool enabled) noexcept {}
+
+        /// Returns the CRC32 of the most recent frame read back from the GPU,
+        /// or \c std::nullopt if no frame has been read back yet.
+        /// This frame may be a few frames behind the one most recently presented.
+        [[nodiscard]] virtual std::optional<uint32_t> LastFrameChecksum() const noexcept { return std::nullopt; }
+
+        /// Moves the checksum of every frame read back since the last call to the end of \c checksums,
+        /// oldest first. Frames that couldn't be read back (e.g. because the GPU fell behind) are skipped.
+        virtual void TakeFrameChecksums(std::vector<FrameChecksum>& checksums) noexcept {}
+
+        /// Counts a frame that another render state presented while frame readback was enabled,
+        /// so that every render state numbers its checksums the same way.
+        virtual void SkipFrameReadback() noexcept {}
+
+        /// Enables or disables converting each presented frame to NV12 instead of sending it to the frontend.
+        /// Returns \c false if this renderer can't (in which case it stays disabled).
+        virtual bool SetNv12Output(bool enabled) noexcept { return !enabled; }
+
+        /// The most recently presented frame in NV12,
+        /// or \c nullptr if NV12 output is disabled or nothing has been presented since it was enabled.
+        [[nodiscard]] virtual const Nv12Frame* LastNv12Frame() const noexcept { return nullptr; }
     };
 
     class RenderStateWrapper {
     public:
-        bool Ready() const noexcept { return _renderState && _renderState->Ready(); }
+        /// Returns true if a frame of \c nds can be rendered;
+        /// this may be the case while the OpenGL or Vulkan context isn't ready, see \c _fallback.
+        bool Ready(const melonDS::NDS& nds) const noexcept;
+        void BeginFrame(const CoreConfig& config) noexcept {
+            if (_renderState) {
+                _renderState->BeginFrame(config);
+            }
+        }
         void Render(melonDS::NDS& nds, const InputState& input, const CoreConfig& config, const ScreenLayoutData& screenLayout) noexcept;
         void Render(const error::ErrorScreen& error, const CoreConfig& config, const ScreenLayoutData& screenLayout) noexcept;
         void RequestRefresh() noexcept {
@@ -62,9 +141,64 @@ namespace MelonDsDs {
         void ContextReset(melonDS::NDS& nds, const CoreConfig& config);
         void ContextDestroyed();
         std::optional<RenderMode> GetRenderMode() const noexcept;
+        [[nodiscard]] unsigned GlCallsLastFrame() const noexcept {
+            return _renderState ? _renderState->GlCallsLastFrame() : 0;
+        }
+        void SetFrameReadbackEnabled(bool enabled) noexcept {
+            _frameReadbackEnabled = enabled;
+            if (_renderState) {
+                _renderState->SetFrameReadbackEnabled(enabled);
+            }
+            if (_fallback) {
+                _fallback->SetFrameReadbackEnabled(enabled);
+            }
+        }
+        [[nodiscard]] std::optional<float> GpuFrameTime() const noexcept {
+            return _renderState ? _renderState->GpuFrameTime() : std::nullopt;
+        }
+        [[nodiscard]] std::optional<GpuStageTimes> GpuFrameStages() const noexcept {
+            return _renderState ? _renderState->GpuFrameStages() : std::nullopt;
+        }
+        [[nodiscard]] std::optional<uint32_t> LastFrameChecksum() const noexcept {
+            if (_fallbackPresented && _fallback)
+                return _fallback->LastFrameChecksum();
+
+            return _renderState ? _renderState->LastFrameChecksum() : std::nullopt;
+        }
+
+        /// Takes the checksums of frames presented by both the render state and its fallback, oldest first.
+        void TakeFrameChecksums(std::vector<FrameChecksum>& checksums) noexcept;
+
+        /// If enabled, frames from the software renderer aren't composited;
+        /// the frontend gets each screen through \c melondsds_screen_interface instead.
+        void SetSeparateScreenOutput(bool enabled) noexcept { _separateScreenOutput = enabled; }
+        [[nodiscard]] bool SeparateScreenOutput() const noexcept { return _separateScreenOutput; }
+
+        /// If enabled (and if the current renderer supports it), each frame is converted to NV12
+        /// and kept for \c melondsds_video_interface; the frontend is sent a duplicate frame instead.
+        bool SetNv12Output(bool enabled) noexcept;
+        [[nodiscard]] const Nv12Frame* LastNv12Frame() const noexcept {
+            return _renderState ? _renderState->LastNv12Frame() : nullptr;
+        }
     private:
         void SetRenderer(const CoreConfig& config);
+        /// Installs (or reuses) a render state that composites the software renderer's screens on the GPU.
+        /// @returns \c false if no GPU API is available, in which case the render state is left alone.
+        bool SetGpuCompositor(const CoreConfig& config);
         std::unique_ptr<RenderState> _renderState;
+
+        /// Presents the software renderer's screens whenever the OpenGL or Vulkan render state has no context,
+        /// so that the console doesn't have to wait for it to start.
+        /// Kept for as long as that render state is, since its context can be lost (or fail to come back) later.
+        std::unique_ptr<SoftwareRenderState> _fallback;
+
+        // True if _fallback presented the most recent frame instead of _renderState
+        bool _fallbackPresented = false;
+
+        // Kept here rather than in the render state so that it survives renderer changes
+        bool _separateScreenOutput = false;
+        bool _nv12Output = false;
+        bool _frameReadbackEnabled = false;
     };
 }
 
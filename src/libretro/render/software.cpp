@@ -16,15 +16,23 @@
 
 #include "software.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <thread>
+
+#include <encodings/crc32.h>
 #include <retro_assert.h>
 
 #include <NDS.h>
-#include <gfx/scaler/pixconv.h>
+#include <Platform.h>
 
 #include "config/config.hpp"
 #include "config/types.hpp"
+#include "environment.hpp"
 #include "input/input.hpp"
 #include "message/error.hpp"
+#include "pixels.hpp"
 #include "screenlayout.hpp"
 #include "tracy.hpp"
 
@@ -34,8 +42,101 @@ using glm::vec3;
 using glm::uvec2;
 using std::span;
 
+namespace {
+    using MelonDsDs::NDS_SCREEN_HEIGHT;
+    using MelonDsDs::NDS_SCREEN_WIDTH;
+
+    // Including the thread that's composing the frame; used unless the player says otherwise
+    constexpr unsigned MAX_AUTO_COMPOSITION_THREADS = 4;
+
+    /// Where each of a source pixel's \c Ratio output pixels samples from,
+    /// relative to that source pixel, when bilinearly upscaling by an integer ratio.
+    struct BilinearPhase {
+        int Offset;
+        // Weight of the pixel after Offset, out of 256
+        uint32_t Weight;
+    };
+
+    template<unsigned Ratio>
+    constexpr std::array<BilinearPhase, Ratio> BilinearPhases() noexcept {
+        std::array<BilinearPhase, Ratio> phases {};
+        for (unsigned k = 0; k < Ratio; k++) {
+            // Output pixel k's center maps to (k + 0.5) / Ratio - 0.5 in source space
+            int numerator = int(2 * k + 1) - int(Ratio);
+            if (numerator < 0) {
+                phases[k] = { -1, uint32_t((numerator + int(2 * Ratio)) * 256 / int(2 * Ratio)) };
+            }
+            else {
+                phases[k] = { 0, uint32_t(numerator * 256 / int(2 * Ratio)) };
+            }
+        }
+
+        return phases;
+    }
+
+    /// Blends two XRGB8888 pixels, with \c weight (out of 256) going to \c b.
+    constexpr uint32_t Lerp(uint32_t a, uint32_t b, uint32_t weight) noexcept {
+        uint32_t inverse = 256 - weight;
+        uint32_t redBlue = ((((a & 0x00FF00FF) * inverse) + ((b & 0x00FF00FF) * weight)) >> 8) & 0x00FF00FF;
+        uint32_t alphaGreen = ((((a >> 8) & 0x00FF00FF) * inverse) + (((b >> 8) & 0x00FF00FF) * weight)) & 0xFF00FF00;
+        return redBlue | alphaGreen;
+    }
+
+    constexpr unsigned ClampIndex(int index, unsigned size) noexcept {
+        return index < 0 ? 0 : (unsigned(index) >= size ? size - 1 : unsigned(index));
+    }
+
+    /// Scales source rows [firstRow, lastRow) into the corresponding rows of \c dest.
+    template<unsigned Ratio>
+    void ScaleNearest(uint32_t* dest, const uint32_t* src, unsigned firstRow, unsigned lastRow) noexcept {
+        constexpr unsigned destWidth = NDS_SCREEN_WIDTH * Ratio;
+        for (unsigned y = firstRow; y < lastRow; y++) {
+            const uint32_t* srcRow = src + y * NDS_SCREEN_WIDTH;
+            uint32_t* destRow = dest + y * Ratio * destWidth;
+            for (unsigned x = 0; x < NDS_SCREEN_WIDTH; x++) {
+                for (unsigned k = 0; k < Ratio; k++) {
+                    destRow[x * Ratio + k] = srcRow[x];
+                }
+            }
+
+            for (unsigned k = 1; k < Ratio; k++) {
+                // The other rows are identical, so just copy the one we expanded
+                memcpy(destRow + k * destWidth, destRow, destWidth * sizeof(uint32_t));
+            }
+        }
+    }
+
+    template<unsigned Ratio>
+    void ScaleBilinear(uint32_t* dest, const uint32_t* src, unsigned firstRow, unsigned lastRow) noexcept {
+        constexpr unsigned destWidth = NDS_SCREEN_WIDTH * Ratio;
+        constexpr std::array<BilinearPhase, Ratio> phases = BilinearPhases<Ratio>();
+        std::array<uint32_t, NDS_SCREEN_WIDTH> blendedRow {};
+        for (unsigned y = firstRow; y < lastRow; y++) {
+            for (unsigned ky = 0; ky < Ratio; ky++) {
+                // Blend the two nearest source rows first, then expand the result horizontally
+                const BilinearPhase& vertical = phases[ky];
+                const uint32_t* above = src + ClampIndex(int(y) + vertical.Offset, NDS_SCREEN_HEIGHT) * NDS_SCREEN_WIDTH;
+                const uint32_t* below = src + ClampIndex(int(y) + vertical.Offset + 1, NDS_SCREEN_HEIGHT) * NDS_SCREEN_WIDTH;
+                for (unsigned x = 0; x < NDS_SCREEN_WIDTH; x++) {
+                    blendedRow[x] = Lerp(above[x], below[x], vertical.Weight);
+                }
+
+                uint32_t* destRow = dest + (y * Ratio + ky) * destWidth;
+                for (unsigned x = 0; x < NDS_SCREEN_WIDTH; x++) {
+                    for (unsigned kx = 0; kx < Ratio; kx++) {
+                        const BilinearPhase& horizontal = phases[kx];
+                        uint32_t left = blendedRow[ClampIndex(int(x) + horizontal.Offset, NDS_SCREEN_WIDTH)];
+                        uint32_t right = blendedRow[ClampIndex(int(x) + horizontal.Offset + 1, NDS_SCREEN_WIDTH)];
+                        destRow[x * Ratio + kx] = Lerp(left, right, horizontal.Weight);
+                    }
+                }
+            }
+        }
+    }
+}
+
 MelonDsDs::SoftwareRenderState::SoftwareRenderState(const CoreConfig& config) noexcept :
-    buffer(1, 1),
+    buffer(uvec2(1), true),
     hybridBuffer(1, 1),
     hybridScaler(
         SCALER_FMT_ARGB8888,
@@ -45,10 +146,15 @@ MelonDsDs::SoftwareRenderState::SoftwareRenderState(const CoreConfig& config) no
         NDS_SCREEN_HEIGHT,
         NDS_SCREEN_WIDTH * config.HybridRatio(),
         NDS_SCREEN_HEIGHT * config.HybridRatio()
-    ) {
+    ),
+    rotatedBuffer(uvec2(1), true),
+    presentBuffer(uvec2(1), true) {
+}
+
+MelonDsDs::SoftwareRenderState::~SoftwareRenderState() noexcept {
+    StopCompositor();
 }
 
-// TODO: Consider using RETRO_ENVIRONMENT_GET_CURRENT_SOFTWARE_FRAMEBUFFER
 void MelonDsDs::SoftwareRenderState::Render(
     melonDS::NDS& nds,
     const InputState& inputState,
@@ -56,47 +162,447 @@ void MelonDsDs::SoftwareRenderState::Render(
     const ScreenLayoutData& screenLayout
 ) noexcept {
     ZoneScopedN(TracyFunction);
+    presentedErrorScreen = nullptr; // The console's frames will overwrite it
 
-    buffer.SetSize(screenLayout.BufferSize());
+#ifdef HAVE_TRACY
+    if (tracy::ProfilerAvailable()) {
+        // If Tracy is connected, send it the native screens (not the composited frame)
+        if (!tracyCapture) {
+            tracyCapture.emplace();
+        }
 
-    if (IsHybridLayout(screenLayout.Layout()) || IsLargeScreenLayout(screenLayout.Layout())) {
-        uvec2 requiredHybridBufferSize = NDS_SCREEN_SIZE<unsigned> * screenLayout.HybridRatio();
-        hybridBuffer.SetSize(requiredHybridBufferSize);
+        tracyCapture->CaptureFrame(
+            nds.GPU.Framebuffer[nds.GPU.FrontBuffer][0].get(),
+            nds.GPU.Framebuffer[nds.GPU.FrontBuffer][1].get()
+        );
+    }
+#endif
 
-        auto filter = config.ScreenFilter() == ScreenFilter::Nearest ? SCALER_TYPE_POINT : SCALER_TYPE_BILINEAR;
-        hybridScaler.SetScalerType(filter);
-        hybridScaler.SetOutSize(requiredHybridBufferSize.x, requiredHybridBufferSize.y);
+    if (config.PipelinedComposition() && StartCompositor()) {
+        // If we want to composite the screens on another thread (and we can)...
+        RenderPipelined(nds, inputState, config, screenLayout);
+        return;
     }
 
+    StopCompositor();
+    ConfigureBuffers(config, screenLayout);
+
     const uint32_t* topScreenBuffer = nds.GPU.Framebuffer[nds.GPU.FrontBuffer][0].get();
     const uint32_t* bottomScreenBuffer = nds.GPU.Framebuffer[nds.GPU.FrontBuffer][1].get();
+    std::optional<ivec2> cursor;
+    if (!nds.IsLidClosed() && inputState.CursorVisible()) {
+        cursor = inputState.TouchPosition();
+    }
+
+    if (FrameUnchanged(topScreenBuffer, bottomScreenBuffer, cursor, config.CursorSize(), screenLayout)) {
+        // If this frame would look exactly like the last one...
+        if (retro::can_dupe()) {
+            // ...then ask the frontend to show the last one again, if it can.
+            retro::video_refresh(nullptr, screenLayout.OutputWidth(), screenLayout.OutputHeight(), 0);
+            ChecksumFrame(nullptr);
+            return;
+        }
+
+        if (lastFrameInBuffer) {
+            // Otherwise just send the last one again, if we still have it.
+            Present(buffer, screenLayout.CoreRotation());
+            return;
+        }
+    }
+
+    // Draw straight into the frontend's framebuffer if it'll give us one,
+    // as that saves the frontend from having to copy our buffer.
+    // (Unless we're rotating the frame, as then it's the rotated copy that goes to the frontend)
+    std::optional<PixelBuffer> frontendBuffer;
+    if (screenLayout.CoreRotation() == 0) {
+        frontendBuffer = AcquireFrontendFramebuffer(buffer.Size());
+    }
+    PixelBuffer& target = frontendBuffer ? *frontendBuffer : buffer;
+
     CombineScreens(
+        target,
         span<const uint32_t, NDS_SCREEN_AREA<size_t>>(topScreenBuffer, NDS_SCREEN_AREA<size_t>),
         span<const uint32_t, NDS_SCREEN_AREA<size_t>>(bottomScreenBuffer, NDS_SCREEN_AREA<size_t>),
         screenLayout
     );
 
-    if (!nds.IsLidClosed() && inputState.CursorVisible()) {
-        DrawCursor(inputState, config, screenLayout);
+    if (cursor) {
+        DrawCursor(target, *cursor, config.CursorSize(), screenLayout);
     }
 
-    retro::video_refresh(buffer[0], buffer.Width(), buffer.Height(), buffer.Stride());
+    lastFrameInBuffer = !frontendBuffer;
+    Present(target, screenLayout.CoreRotation());
+}
 
-#ifdef HAVE_TRACY
-    if (tracy::ProfilerAvailable()) {
-        // If Tracy is connected...
-        ZoneScopedN("MelonDsDs::render::RenderSoftware::SendFrameToTracy");
-        std::unique_ptr<uint8_t[]> frame = std::make_unique<uint8_t[]>(buffer.Width() * buffer.Height() * 4);
-        {
-            ZoneScopedN("conv_argb8888_abgr8888");
-            conv_argb8888_abgr8888(frame.get(), buffer[0], buffer.Width(), buffer.Height(), buffer.Stride(), buffer.Stride());
+bool MelonDsDs::SoftwareRenderState::FrameUnchanged(
+    const uint32_t* topBuffer,
+    const uint32_t* bottomBuffer,
+    std::optional<ivec2> cursor,
+    float cursorSize,
+    const ScreenLayoutData& screenLayout
+) noexcept {
+    ZoneScopedN(TracyFunction);
+    constexpr size_t screenBytes = NDS_SCREEN_AREA<size_t> * PIXEL_SIZE;
+    CompositionState layout = DescribeLayout(screenLayout);
+
+    bool unchanged = presentedLayout &&
+        presentedLayout->SameLayout(layout) &&
+        presentedCursor == cursor &&
+        (!cursor || presentedCursorSize == cursorSize) &&
+        memcmp(presentedScreens.data(), topBuffer, screenBytes) == 0 &&
+        memcmp(presentedScreens.data() + NDS_SCREEN_AREA<size_t>, bottomBuffer, screenBytes) == 0;
+
+    if (!unchanged) {
+        // Remember this frame so we can compare the next one to it
+        presentedScreens.resize(NDS_SCREEN_AREA<size_t> * 2);
+        memcpy(presentedScreens.data(), topBuffer, screenBytes);
+        memcpy(presentedScreens.data() + NDS_SCREEN_AREA<size_t>, bottomBuffer, screenBytes);
+        presentedLayout = layout;
+        presentedCursor = cursor;
+        presentedCursorSize = cursorSize;
+    }
+
+    return unchanged;
+}
+
+std::optional<MelonDsDs::PixelBuffer> MelonDsDs::SoftwareRenderState::AcquireFrontendFramebuffer(uvec2 size) noexcept {
+    ZoneScopedN(TracyFunction);
+    if (!useFrontendFramebuffer || retro::get_pixel_format() != RETRO_PIXEL_FORMAT_XRGB8888)
+        return std::nullopt;
+
+    // The cursor is drawn by inverting pixels, so we need to read the framebuffer too
+    std::optional<retro_framebuffer> framebuffer = retro::get_software_framebuffer(
+        size.x,
+        size.y,
+        RETRO_MEMORY_ACCESS_WRITE | RETRO_MEMORY_ACCESS_READ
+    );
+
+    if (!framebuffer) {
+        // If the frontend doesn't support this at all, then don't bother asking again
+        useFrontendFramebuffer = false;
+        retro::debug("Frontend doesn't provide a software framebuffer; compositing into our own");
+        return std::nullopt;
+    }
+
+    if (framebuffer->format != RETRO_PIXEL_FORMAT_XRGB8888 ||
+        framebuffer->width != size.x ||
+        framebuffer->height != size.y ||
+        framebuffer->pitch % PIXEL_SIZE != 0 ||
+        framebuffer->pitch < size.x * PIXEL_SIZE) {
+        // If the frontend gave us a framebuffer we can't use this frame (e.g. it resized the window)...
+        return std::nullopt;
+    }
+
+    return PixelBuffer(static_cast<uint32_t*>(framebuffer->data), size, framebuffer->pitch);
+}
+
+void MelonDsDs::SoftwareRenderState::RenderPipelined(
+    melonDS::NDS& nds,
+    const InputState& inputState,
+    const CoreConfig& config,
+    const ScreenLayoutData& screenLayout
+) noexcept {
+    ZoneScopedN(TracyFunction);
+
+    // The frame we're about to present was composited for whichever layout was staged with it
+    unsigned quarterTurns = screenLayout.CoreRotation();
+    if (compositionPending) {
+        // If the compositor is still working on the previous frame...
+        ZoneScopedN("MelonDsDs::SoftwareRenderState::RenderPipelined::Wait");
+        melonDS::Platform::Semaphore_Wait(compositorDone);
+        compositionPending = false;
+        if (stagedLayout) {
+            quarterTurns = stagedLayout->CoreRotation();
         }
-        // libretro wants pixels in XRGB8888 format,
-        // but Tracy wants them in XBGR8888 format.
+    }
+    else {
+        // If the pipeline is empty (e.g. we just enabled it), then we have nothing to show yet.
+        // Composite this frame here so the frontend gets a picture;
+        // it'll be shown again next frame as the pipeline fills up.
+        ConfigureBuffers(config, screenLayout);
+        CombineScreens(
+            buffer,
+            span<const uint32_t, NDS_SCREEN_AREA<size_t>>(nds.GPU.Framebuffer[nds.GPU.FrontBuffer][0].get(), NDS_SCREEN_AREA<size_t>),
+            span<const uint32_t, NDS_SCREEN_AREA<size_t>>(nds.GPU.Framebuffer[nds.GPU.FrontBuffer][1].get(), NDS_SCREEN_AREA<size_t>),
+            screenLayout
+        );
 
-        FrameImage(frame.get(), buffer.Width(), buffer.Height(), 0, false);
+        if (!nds.IsLidClosed() && inputState.CursorVisible()) {
+            DrawCursor(buffer, inputState.TouchPosition(), config.CursorSize(), screenLayout);
+        }
     }
-#endif
+
+    // The compositor is idle now, so we can safely touch its buffers
+    std::swap(buffer, presentBuffer);
+    presentedLayout = std::nullopt;
+    Present(presentBuffer, quarterTurns);
+
+    // Now stage this frame for the compositor
+    ConfigureBuffers(config, screenLayout);
+    memcpy(stagedScreens.data(), nds.GPU.Framebuffer[nds.GPU.FrontBuffer][0].get(), NDS_SCREEN_AREA<size_t> * PIXEL_SIZE);
+    memcpy(stagedScreens.data() + NDS_SCREEN_AREA<size_t>, nds.GPU.Framebuffer[nds.GPU.FrontBuffer][1].get(), NDS_SCREEN_AREA<size_t> * PIXEL_SIZE);
+    stagedLayout = screenLayout;
+    stagedCursor = (!nds.IsLidClosed() && inputState.CursorVisible()) ? std::make_optional(inputState.TouchPosition()) : std::nullopt;
+    stagedCursorSize = config.CursorSize();
+
+    compositionPending = true;
+    melonDS::Platform::Semaphore_Post(compositorStart, 1);
+}
+
+void MelonDsDs::SoftwareRenderState::CompositorMain() noexcept {
+    while (true) {
+        melonDS::Platform::Semaphore_Wait(compositorStart);
+        if (compositorQuit)
+            return;
+
+        ZoneScopedN(TracyFunction);
+        retro_assert(stagedLayout.has_value());
+        CombineScreens(
+            buffer,
+            span<const uint32_t, NDS_SCREEN_AREA<size_t>>(stagedScreens.data(), NDS_SCREEN_AREA<size_t>),
+            span<const uint32_t, NDS_SCREEN_AREA<size_t>>(stagedScreens.data() + NDS_SCREEN_AREA<size_t>, NDS_SCREEN_AREA<size_t>),
+            *stagedLayout
+        );
+
+        if (stagedCursor) {
+            DrawCursor(buffer, *stagedCursor, stagedCursorSize, *stagedLayout);
+        }
+
+        melonDS::Platform::Semaphore_Post(compositorDone, 1);
+    }
+}
+
+bool MelonDsDs::SoftwareRenderState::StartCompositor() noexcept {
+    if (compositorThread)
+        return true;
+
+    ZoneScopedN(TracyFunction);
+    compositorStart = melonDS::Platform::Semaphore_Create();
+    compositorDone = melonDS::Platform::Semaphore_Create();
+    compositorQuit = false;
+    compositionPending = false;
+    stagedScreens.resize(NDS_SCREEN_AREA<size_t> * 2);
+    compositorThread = melonDS::Platform::Thread_Create([this] { CompositorMain(); });
+
+    if (!compositorThread) {
+        // If threads aren't available on this platform...
+        melonDS::Platform::Semaphore_Free(compositorStart);
+        melonDS::Platform::Semaphore_Free(compositorDone);
+        compositorStart = nullptr;
+        compositorDone = nullptr;
+        retro::warn("Failed to start the compositor thread; falling back to synchronous composition");
+        return false;
+    }
+
+    retro::debug("Started the compositor thread");
+    return true;
+}
+
+void MelonDsDs::SoftwareRenderState::StopCompositor() noexcept {
+    if (!compositorThread)
+        return;
+
+    ZoneScopedN(TracyFunction);
+    if (compositionPending) {
+        // Let the compositor finish its current frame; the result is discarded
+        melonDS::Platform::Semaphore_Wait(compositorDone);
+        compositionPending = false;
+    }
+
+    compositorQuit = true;
+    melonDS::Platform::Semaphore_Post(compositorStart, 1);
+    melonDS::Platform::Thread_Wait(compositorThread);
+    melonDS::Platform::Thread_Free(compositorThread);
+    melonDS::Platform::Semaphore_Free(compositorStart);
+    melonDS::Platform::Semaphore_Free(compositorDone);
+    compositorThread = nullptr;
+    compositorStart = nullptr;
+    compositorDone = nullptr;
+    stagedLayout = std::nullopt;
+    retro::debug("Stopped the compositor thread");
+}
+
+void MelonDsDs::SoftwareRenderState::ConfigureBuffers(const CoreConfig& config, const ScreenLayoutData& screenLayout) noexcept {
+    if (!config.LowMemoryMode()) {
+        // Make room for the biggest configured layout now, so that switching layouts never reallocates.
+        // (Only a capacity check after the first time; when pipelining,
+        // buffer and presentBuffer take turns here, so both are covered within two frames)
+        buffer.Reserve(screenLayout.MaxBufferSize());
+        if (retro::get_pixel_format() == RETRO_PIXEL_FORMAT_RGB565) {
+            uvec2 maxSize = screenLayout.MaxOutputSize();
+            rgb565Buffer.reserve(size_t(maxSize.x) * maxSize.y);
+        }
+    }
+
+    if (screenLayout.CoreRotation() != 0) {
+        // If we're rotating the screen ourselves, we need somewhere to put the rotated frame
+        if (!config.LowMemoryMode()) {
+            rotatedBuffer.Reserve(screenLayout.MaxOutputSize());
+        }
+        rotatedBuffer.SetSize(screenLayout.OutputSize());
+    }
+    else if (config.LowMemoryMode() && rotatedBuffer.Size() != uvec2(1)) {
+        // If the frontend is rotating the screen (or it doesn't need rotating), don't keep the buffer around
+        rotatedBuffer.SetSize(uvec2(1));
+        rotatedBuffer.ShrinkToFit();
+    }
+
+    buffer.SetSize(screenLayout.BufferSize());
+    if (config.LowMemoryMode()) {
+        // If we'd rather reallocate on every layout change than hold on to the biggest buffer we've ever needed...
+        buffer.ShrinkToFit();
+    }
+
+    if (config.ParallelComposition()) {
+        unsigned threads = config.ParallelCompositionThreads();
+        if (threads == 0) {
+            // One band per core, counting the thread that's composing; it's not worth going much wider than that
+            threads = std::clamp(std::thread::hardware_concurrency(), 2u, MAX_AUTO_COMPOSITION_THREADS);
+        }
+
+        if (!compositionJobs || threads != compositionThreads) {
+            // If we want to split composition across threads but haven't started the right number of them...
+            compositionJobs = nullptr; // Stop the old workers before starting the new ones
+            compositionJobs = std::make_unique<JobGroup>(threads - 1);
+            compositionThreads = threads;
+        }
+    }
+    else if (compositionJobs) {
+        compositionJobs = nullptr;
+    }
+
+    if (IsHybridLayout(screenLayout.Layout()) || IsLargeScreenLayout(screenLayout.Layout())) {
+        uvec2 requiredHybridBufferSize = NDS_SCREEN_SIZE<unsigned> * screenLayout.HybridRatio();
+        hybridBuffer.SetSize(requiredHybridBufferSize);
+        if (config.LowMemoryMode()) {
+            hybridBuffer.ShrinkToFit();
+        }
+
+        auto filter = config.ScreenFilter() == ScreenFilter::Nearest ? SCALER_TYPE_POINT : SCALER_TYPE_BILINEAR;
+        hybridScaler.SetScalerType(filter);
+        hybridScaler.SetOutSize(requiredHybridBufferSize.x, requiredHybridBufferSize.y);
+    }
+    else if (!config.LowMemoryMode() && screenLayout.MaxHybridBufferSize() != uvec2(0)) {
+        // If another configured layout will need the hybrid screen's staging area, have it ready
+        hybridBuffer.Reserve(screenLayout.MaxHybridBufferSize());
+    }
+    else if (config.LowMemoryMode() && hybridBuffer.Size() != uvec2(1)) {
+        // If this layout doesn't need the hybrid screen's staging area, don't keep it around
+        hybridBuffer.SetSize(uvec2(1));
+        hybridBuffer.ShrinkToFit();
+    }
+}
+
+void MelonDsDs::SoftwareRenderState::Present(const PixelBuffer& composited, unsigned quarterTurns) noexcept {
+    ZoneScopedN(TracyFunction);
+    const PixelBuffer* rotated = &composited;
+    if (quarterTurns % 4 != 0) [[unlikely]] {
+        // If the frontend can't rotate the screen (or we were told not to let it)...
+        uvec2 size = quarterTurns % 2 ? uvec2(composited.Height(), composited.Width()) : composited.Size();
+        rotatedBuffer.SetSize(size);
+        pixels::RotateRect(
+            rotatedBuffer[0],
+            rotatedBuffer.Stride() / PIXEL_SIZE,
+            composited[0],
+            composited.Stride() / PIXEL_SIZE,
+            composited.Width(),
+            composited.Height(),
+            quarterTurns
+        );
+        rotated = &rotatedBuffer;
+    }
+
+    const PixelBuffer& frame = *rotated;
+    ChecksumFrame(&frame);
+    if (nv12Output) [[unlikely]] {
+        // The frontend will fetch this frame itself, so it needs nothing new from video_refresh
+        unsigned width = frame.Width(), height = frame.Height();
+        size_t chromaPitch = size_t((width + 1) / 2) * 2;
+        size_t lumaSize = size_t(width) * height;
+        nv12Buffer.resize(lumaSize + chromaPitch * ((height + 1) / 2));
+        pixels::ConvertToNv12Rect(
+            nv12Buffer.data(),
+            width,
+            nv12Buffer.data() + lumaSize,
+            chromaPitch,
+            frame[0],
+            frame.Stride() / PIXEL_SIZE,
+            width,
+            height
+        );
+        nv12Frame = Nv12Frame {
+            .Luma = nv12Buffer.data(),
+            .LumaPitch = width,
+            .Chroma = nv12Buffer.data() + lumaSize,
+            .ChromaPitch = chromaPitch,
+            .Width = width,
+            .Height = height,
+        };
+        retro::video_refresh(nullptr, width, height, 0);
+    }
+    else if (retro::get_pixel_format() == RETRO_PIXEL_FORMAT_RGB565) {
+        // If the frontend agreed to take 16-bit frames, convert the finished frame now
+        rgb565Buffer.resize(size_t(frame.Width()) * frame.Height());
+        pixels::ConvertToRgb565Rect(
+            rgb565Buffer.data(),
+            frame.Width(),
+            frame[0],
+            frame.Stride() / PIXEL_SIZE,
+            frame.Width(),
+            frame.Height()
+        );
+        retro::video_refresh(rgb565Buffer.data(), frame.Width(), frame.Height(), frame.Width() * sizeof(uint16_t));
+    }
+    else {
+        retro::video_refresh(frame[0], frame.Width(), frame.Height(), frame.Stride());
+    }
+
+}
+
+void MelonDsDs::SoftwareRenderState::ChecksumFrame(const PixelBuffer* frame) noexcept {
+    if (!frameReadbackEnabled) [[likely]]
+        return;
+
+    ZoneScopedN(TracyFunction);
+    if (frame) {
+        // Hash each row on its own, as the frame's rows may be padded
+        uint32_t checksum = 0;
+        for (unsigned y = 0; y < frame->Height(); ++y) {
+            checksum = encoding_crc32(checksum, reinterpret_cast<const uint8_t*>((*frame)[y]), frame->Width() * PIXEL_SIZE);
+        }
+        lastFrameChecksum = checksum;
+    }
+
+    if (lastFrameChecksum) {
+        frameChecksums.push_back({framesReadBack, *lastFrameChecksum});
+    }
+    ++framesReadBack;
+}
+
+void MelonDsDs::SoftwareRenderState::SetFrameReadbackEnabled(bool enabled) noexcept {
+    if (enabled && !frameReadbackEnabled) {
+        framesReadBack = 0;
+    }
+
+    frameReadbackEnabled = enabled;
+    if (!enabled) {
+        lastFrameChecksum = std::nullopt;
+        frameChecksums.clear();
+    }
+}
+
+bool MelonDsDs::SoftwareRenderState::SetNv12Output(bool enabled) noexcept {
+    nv12Output = enabled;
+    if (!enabled) {
+        nv12Frame = std::nullopt;
+        nv12Buffer = {};
+    }
+    return true;
+}
+
+void MelonDsDs::SoftwareRenderState::TakeFrameChecksums(std::vector<FrameChecksum>& checksums) noexcept {
+    checksums.insert(checksums.end(), frameChecksums.begin(), frameChecksums.end());
+    frameChecksums.clear();
 }
 
 void MelonDsDs::SoftwareRenderState::Render(
@@ -105,13 +611,39 @@ void MelonDsDs::SoftwareRenderState::Render(
 ) noexcept {
     ZoneScopedN(TracyFunction);
 
-    buffer.SetSize(screenLayout.BufferSize());
-    CombineScreens(error.TopScreen(), error.BottomScreen(), screenLayout);
+    StopCompositor();
+    bool unchanged =
+        lastFrameInBuffer &&
+        presentedErrorScreen == &error &&
+        presentedErrorLayout == screenLayout.Layout() &&
+        presentedErrorGeneration == screenLayout.Generation() &&
+        buffer.Size() == screenLayout.BufferSize();
+
+    if (unchanged) {
+        // If we already composited this error screen for this layout...
+        if (retro::can_dupe()) {
+            // ...then there's nothing to draw or send.
+            retro::video_refresh(nullptr, screenLayout.OutputWidth(), screenLayout.OutputHeight(), 0);
+            ChecksumFrame(nullptr);
+            return;
+        }
+
+        Present(buffer, screenLayout.CoreRotation());
+        return;
+    }
 
-    retro::video_refresh(buffer[0], buffer.Width(), buffer.Height(), buffer.Stride());
+    buffer.SetSize(screenLayout.BufferSize());
+    CombineScreens(buffer, error.TopScreen(), error.BottomScreen(), screenLayout);
+    presentedLayout = std::nullopt;
+    presentedErrorScreen = &error;
+    presentedErrorLayout = screenLayout.Layout();
+    presentedErrorGeneration = screenLayout.Generation();
+    lastFrameInBuffer = true;
+
+    Present(buffer, screenLayout.CoreRotation());
 }
 
-void MelonDsDs::SoftwareRenderState::CopyScreen(const uint32_t* src, uvec2 destTranslation, ScreenLayout layout) noexcept {
+void MelonDsDs::SoftwareRenderState::CopyScreen(PixelBuffer& target, const uint32_t* src, uvec2 destTranslation, ScreenLayout layout) noexcept {
     ZoneScopedN(TracyFunction);
     // Only used for software rendering
 
@@ -124,103 +656,233 @@ void MelonDsDs::SoftwareRenderState::CopyScreen(const uint32_t* src, uvec2 destT
     // then its pixels can't all be contiguous in memory.
     // In that case, we have to copy each row of pixels individually to a different offset.
     if (LayoutSupportsDirectCopy(layout)) {
-        buffer.CopyDirect(src, destTranslation);
+        target.CopyDirect(src, destTranslation);
     }
     else {
         // Not all of this screen's pixels will be contiguous in memory, so we have to copy them row by row
-        buffer.CopyRows(src, destTranslation, NDS_SCREEN_SIZE<unsigned>);
+        target.CopyRows(src, destTranslation, NDS_SCREEN_SIZE<unsigned>);
     }
 }
 
-void MelonDsDs::SoftwareRenderState::DrawCursor(const InputState& input, const CoreConfig& config,
-    const ScreenLayoutData& screenLayout
-) noexcept {
+void MelonDsDs::SoftwareRenderState::DrawCursor(PixelBuffer& target, ivec2 touch, float size, const ScreenLayoutData& screenLayout) noexcept {
     ZoneScopedN(TracyFunction);
     // Only used for software rendering
 
     if (screenLayout.Layout() == ScreenLayout::TopOnly)
         return;
 
-    ivec2 cursorSize = ivec2(config.CursorSize());
+    ivec2 cursorSize = ivec2(size);
     if (screenLayout.Layout() == ScreenLayout::LargescreenBottom || screenLayout.Layout() == ScreenLayout::FlippedLargescreenBottom) {
         cursorSize = ivec2(screenLayout.HybridRatio())*cursorSize;
     }
-    ivec2 clampedTouch = clamp(input.TouchPosition(), ivec2(0), ivec2(NDS_SCREEN_WIDTH - 1, NDS_SCREEN_HEIGHT - 1));
+    ivec2 clampedTouch = clamp(touch, ivec2(0), ivec2(NDS_SCREEN_WIDTH - 1, NDS_SCREEN_HEIGHT - 1));
     ivec2 transformedTouch = screenLayout.GetBottomScreenMatrix() * vec3(clampedTouch, 1);
 
-    uvec2 start = clamp(transformedTouch - ivec2(cursorSize), ivec2(0), ivec2(buffer.Size()));
-    uvec2 end = clamp(transformedTouch + ivec2(cursorSize), ivec2(0), ivec2(buffer.Size()));
-    for (uint32_t y = start.y; y < end.y; y++) {
-        for (uint32_t x = start.x; x < end.x; x++) {
-            // TODO: Replace with SIMD (does GLM have a SIMD version of this?)
-            uint32_t& pixel = buffer[uvec2(x, y)];
-            pixel = (0xFFFFFF - pixel) | 0xFF000000;
+    uvec2 start = clamp(transformedTouch - ivec2(cursorSize), ivec2(0), ivec2(target.Size()));
+    uvec2 end = clamp(transformedTouch + ivec2(cursorSize), ivec2(0), ivec2(target.Size()));
+    if (CompositionState* state = FindCompositionState(target)) {
+        state->cursorArea = std::make_pair(start, end);
+    }
+
+    if (start.x < end.x && start.y < end.y) {
+        pixels::InvertRect(target[start.y] + start.x, target.Stride() / PIXEL_SIZE, end.x - start.x, end.y - start.y);
+    }
+}
+
+void MelonDsDs::SoftwareRenderState::ScaleHybridScreen(const uint32_t* src, unsigned ratio, unsigned firstRow, unsigned lastRow) noexcept {
+    ZoneScopedN(TracyFunction);
+    uint32_t* dest = hybridBuffer[0];
+    bool nearest = hybridScaler.GetScalerType() == SCALER_TYPE_POINT;
+
+    // Integer upscaling is simple enough that specialized kernels beat libretro-common's general-purpose scaler
+    switch (ratio) {
+        case 2:
+            nearest ? ScaleNearest<2>(dest, src, firstRow, lastRow) : ScaleBilinear<2>(dest, src, firstRow, lastRow);
+            return;
+        case 3:
+            nearest ? ScaleNearest<3>(dest, src, firstRow, lastRow) : ScaleBilinear<3>(dest, src, firstRow, lastRow);
+            return;
+        case 4:
+            nearest ? ScaleNearest<4>(dest, src, firstRow, lastRow) : ScaleBilinear<4>(dest, src, firstRow, lastRow);
+            return;
+        default:
+            // The general-purpose scaler can only do the whole screen at once
+            retro_assert(firstRow == 0 && lastRow == NDS_SCREEN_HEIGHT);
+            hybridScaler.Scale(dest, src);
+            return;
+    }
+}
+
+void MelonDsDs::SoftwareRenderState::CombineScaledScreens(
+    PixelBuffer& target,
+    const uint32_t* primary,
+    uvec2 primaryTranslation,
+    std::span<const SmallScreen> smallScreens,
+    const ScreenLayoutData& screenLayout
+) noexcept {
+    ZoneScopedN(TracyFunction);
+    unsigned ratio = screenLayout.HybridRatio();
+    ScreenLayout layout = screenLayout.Layout();
+
+    // The big screen is split into bands of rows that are each scaled and copied independently
+    bool canSplit = compositionJobs && ratio >= 2 && ratio <= 4;
+    unsigned bands = canSplit ? compositionJobs->Concurrency() : 1;
+    auto job = [&](unsigned index) {
+        if (index < bands) {
+            unsigned firstRow = NDS_SCREEN_HEIGHT * index / bands;
+            unsigned lastRow = NDS_SCREEN_HEIGHT * (index + 1) / bands;
+            ScaleHybridScreen(primary, ratio, firstRow, lastRow);
+            target.CopyRows(
+                hybridBuffer[firstRow * ratio],
+                primaryTranslation + uvec2(0, firstRow * ratio),
+                uvec2(NDS_SCREEN_WIDTH * ratio, (lastRow - firstRow) * ratio)
+            );
+        }
+        else {
+            const SmallScreen& screen = smallScreens[index - bands];
+            CopyScreen(target, screen.Pixels, screen.Translation, layout);
+        }
+    };
+
+    unsigned jobs = bands + smallScreens.size();
+    if (compositionJobs) {
+        compositionJobs->Run(jobs, job);
+    }
+    else {
+        for (unsigned i = 0; i < jobs; i++) {
+            job(i);
+        }
+    }
+}
+
+bool MelonDsDs::SoftwareRenderState::CompositionState::SameLayout(const CompositionState& other) const noexcept {
+    return data == other.data &&
+        size == other.size &&
+        stride == other.stride &&
+        layout == other.layout &&
+        hybridSmallScreen == other.hybridSmallScreen &&
+        hybridRatio == other.hybridRatio &&
+        topTranslation == other.topTranslation &&
+        bottomTranslation == other.bottomTranslation &&
+        hybridTranslation == other.hybridTranslation &&
+        hybridFilter == other.hybridFilter &&
+        rotation == other.rotation &&
+        generation == other.generation;
+}
+
+MelonDsDs::SoftwareRenderState::CompositionState MelonDsDs::SoftwareRenderState::DescribeLayout(const ScreenLayoutData& screenLayout) noexcept {
+    return CompositionState {
+        .layout = screenLayout.Layout(),
+        .hybridSmallScreen = screenLayout.HybridSmallScreenLayout(),
+        .hybridRatio = screenLayout.HybridRatio(),
+        .topTranslation = screenLayout.GetTopScreenTranslation(),
+        .bottomTranslation = screenLayout.GetBottomScreenTranslation(),
+        .hybridTranslation = screenLayout.GetHybridScreenTranslation(),
+        .hybridFilter = hybridScaler.GetScalerType(),
+        .rotation = screenLayout.CoreRotation(),
+        .generation = screenLayout.Generation(),
+    };
+}
+
+MelonDsDs::SoftwareRenderState::CompositionState* MelonDsDs::SoftwareRenderState::FindCompositionState(const PixelBuffer& target) noexcept {
+    for (CompositionState& state : compositionStates) {
+        if (state.data != nullptr && state.data == target[0])
+            return &state;
+    }
+
+    return nullptr;
+}
+
+void MelonDsDs::SoftwareRenderState::PrepareTarget(PixelBuffer& target, const ScreenLayoutData& screenLayout) noexcept {
+    ZoneScopedN(TracyFunction);
+
+    if (target.IsExternal()) {
+        // If this is the frontend's framebuffer, we have no idea what was in it before
+        target.Clear();
+        return;
+    }
+
+    CompositionState current = DescribeLayout(screenLayout);
+    current.data = target[0];
+    current.size = target.Size();
+    current.stride = target.Stride();
+
+    CompositionState* previous = FindCompositionState(target);
+    if (previous && previous->SameLayout(current)) {
+        // If this buffer's gaps are still blank from the last time we used it...
+        if (previous->cursorArea) {
+            // ...then we only need to erase the cursor, which may have been drawn over them.
+            auto [start, end] = *previous->cursorArea;
+            target.Clear(start, end - start);
+            previous->cursorArea = std::nullopt;
         }
+        return;
+    }
+
+    // The layout changed (or this is a new buffer), so the old screens may be anywhere
+    target.Clear();
+    if (previous) {
+        *previous = current;
+    }
+    else {
+        compositionStates[1] = compositionStates[0];
+        compositionStates[0] = current;
     }
 }
 
 void MelonDsDs::SoftwareRenderState::CombineScreens(
+    PixelBuffer& target,
     std::span<const uint32_t, NDS_SCREEN_AREA<size_t>> topBuffer,
     std::span<const uint32_t, NDS_SCREEN_AREA<size_t>> bottomBuffer,
     const ScreenLayoutData& screenLayout
 ) noexcept {
     ZoneScopedN(TracyFunction);
 
-    buffer.Clear();
+    PrepareTarget(target, screenLayout);
     ScreenLayout layout = screenLayout.Layout();
 
     if (IsHybridLayout(layout)) {
         auto primaryBuffer = layout == ScreenLayout::HybridTop || layout == ScreenLayout::FlippedHybridTop ? topBuffer : bottomBuffer;
-
-        hybridScaler.Scale(hybridBuffer[0], primaryBuffer.data());
-        buffer.CopyRows(
-            hybridBuffer[0],
-            screenLayout.GetHybridScreenTranslation(),
-            NDS_SCREEN_SIZE<unsigned> * screenLayout.HybridRatio()
-        );
-
         HybridSideScreenDisplay smallScreenLayout = screenLayout.HybridSmallScreenLayout();
+        std::array<SmallScreen, 2> smallScreens {};
+        size_t numSmallScreens = 0;
 
         if (smallScreenLayout == HybridSideScreenDisplay::Both || layout == ScreenLayout::HybridBottom || layout == ScreenLayout::FlippedHybridBottom) {
             // If we should display both screens, or if the bottom one is the primary...
-            buffer.CopyRows(topBuffer.data(), screenLayout.GetTopScreenTranslation(), NDS_SCREEN_SIZE<unsigned>);
+            smallScreens[numSmallScreens++] = { topBuffer.data(), screenLayout.GetTopScreenTranslation() };
         }
 
         if (smallScreenLayout == HybridSideScreenDisplay::Both || layout == ScreenLayout::HybridTop || layout == ScreenLayout::FlippedHybridTop) {
             // If we should display both screens, or if the top one is being focused...
-            buffer.CopyRows(bottomBuffer.data(), screenLayout.GetBottomScreenTranslation(), NDS_SCREEN_SIZE<unsigned>);
+            smallScreens[numSmallScreens++] = { bottomBuffer.data(), screenLayout.GetBottomScreenTranslation() };
         }
-    } 
+
+        CombineScaledScreens(
+            target,
+            primaryBuffer.data(),
+            screenLayout.GetHybridScreenTranslation(),
+            std::span<const SmallScreen>(smallScreens.data(), numSmallScreens),
+            screenLayout
+        );
+    }
     else if (IsLargeScreenLayout(layout)) {
         bool focusTop = layout == ScreenLayout::LargescreenTop || layout == ScreenLayout::FlippedLargescreenTop;
         if (focusTop) {
-            auto primaryBuffer = topBuffer;
-            hybridScaler.Scale(hybridBuffer[0], primaryBuffer.data());
-            buffer.CopyRows(
-                hybridBuffer[0],
-                screenLayout.GetTopScreenTranslation(),
-                NDS_SCREEN_SIZE<unsigned> * screenLayout.HybridRatio()
-            );
             // If the top screen is the primary copy the bottom to the small screen
-            CopyScreen(bottomBuffer.data(), screenLayout.GetBottomScreenTranslation(), layout);
+            SmallScreen bottom { bottomBuffer.data(), screenLayout.GetBottomScreenTranslation() };
+            CombineScaledScreens(target, topBuffer.data(), screenLayout.GetTopScreenTranslation(), std::span<const SmallScreen>(&bottom, 1), screenLayout);
         } else {
-            auto primaryBuffer = bottomBuffer;
-            hybridScaler.Scale(hybridBuffer[0], primaryBuffer.data());
-            buffer.CopyRows(
-                hybridBuffer[0],
-                screenLayout.GetBottomScreenTranslation(),
-                NDS_SCREEN_SIZE<unsigned> * screenLayout.HybridRatio()
-            );            
             // If the bottom screen is the primary copy the top to the small screen
-            CopyScreen(topBuffer.data(), screenLayout.GetTopScreenTranslation(), layout);
+            SmallScreen top { topBuffer.data(), screenLayout.GetTopScreenTranslation() };
+            CombineScaledScreens(target, bottomBuffer.data(), screenLayout.GetBottomScreenTranslation(), std::span<const SmallScreen>(&top, 1), screenLayout);
         }
-    } 
+    }
     else {
         if (layout != ScreenLayout::BottomOnly)
-            CopyScreen(topBuffer.data(), screenLayout.GetTopScreenTranslation(), layout);
+            CopyScreen(target, topBuffer.data(), screenLayout.GetTopScreenTranslation(), layout);
 
         if (layout != ScreenLayout::TopOnly)
-            CopyScreen(bottomBuffer.data(), screenLayout.GetBottomScreenTranslation(), layout);
+            CopyScreen(target, bottomBuffer.data(), screenLayout.GetBottomScreenTranslation(), layout);
     }
 }
 
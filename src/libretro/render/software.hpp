@@ -17,16 +17,27 @@
 #ifndef MELONDSDS_RENDER_SOFTWARE_HPP
 #define MELONDSDS_RENDER_SOFTWARE_HPP
 
+#include <array>
+#include <memory>
 #include <optional>
+#include <utility>
 #include <span>
+#include <vector>
 
 #include <glm/mat3x3.hpp>
 #include <glm/vec2.hpp>
 
 #include "buffer.hpp"
+#include "jobs.hpp"
 #include "render.hpp"
 #include "screenlayout.hpp"
 #include "retro/scaler.hpp"
+#include "tracy/software.hpp"
+
+namespace melonDS::Platform {
+    struct Thread;
+    struct Semaphore;
+}
 
 namespace MelonDsDs {
     namespace error {
@@ -38,6 +49,9 @@ namespace MelonDsDs {
     class SoftwareRenderState final : public RenderState {
     public:
         SoftwareRenderState(const CoreConfig& config) noexcept;
+        ~SoftwareRenderState() noexcept override;
+        SoftwareRenderState(const SoftwareRenderState&) = delete;
+        SoftwareRenderState& operator=(const SoftwareRenderState&) = delete;
         bool Ready() const noexcept override { return true; }
         void Render(
             melonDS::NDS& nds,
@@ -55,19 +69,165 @@ namespace MelonDsDs {
         unsigned BufferHeight() const noexcept { return buffer.Height(); }
         glm::uvec2 BufferSize() const noexcept { return buffer.Size(); }
 
+        void SetFrameReadbackEnabled(bool enabled) noexcept override;
+        [[nodiscard]] std::optional<uint32_t> LastFrameChecksum() const noexcept override { return lastFrameChecksum; }
+        void TakeFrameChecksums(std::vector<FrameChecksum>& checksums) noexcept override;
+        void SkipFrameReadback() noexcept override {
+            if (frameReadbackEnabled)
+                ++framesReadBack;
+        }
+        bool SetNv12Output(bool enabled) noexcept override;
+        [[nodiscard]] const Nv12Frame* LastNv12Frame() const noexcept override { return nv12Frame ? &*nv12Frame : nullptr; }
+
     private:
-        void CopyScreen(const uint32_t* src, glm::uvec2 destTranslation, ScreenLayout layout) noexcept;
-        void DrawCursor(const InputState& input, const CoreConfig& config, const ScreenLayoutData& screenLayout) noexcept;
+        // Times composition by itself for the native microbenchmarks
+        friend class CompositionBenchmark;
+
+        void ConfigureBuffers(const CoreConfig& config, const ScreenLayoutData& screenLayout) noexcept;
+        [[nodiscard]] std::optional<PixelBuffer> AcquireFrontendFramebuffer(glm::uvec2 size) noexcept;
+        /// Checksums \c frame if frame readback is enabled,
+        /// or repeats the last checksum if \c frame is \c nullptr (i.e. the frontend was asked to dupe it).
+        void ChecksumFrame(const PixelBuffer* frame) noexcept;
+        void CopyScreen(PixelBuffer& target, const uint32_t* src, glm::uvec2 destTranslation, ScreenLayout layout) noexcept;
+        void DrawCursor(PixelBuffer& target, glm::ivec2 touch, float size, const ScreenLayoutData& screenLayout) noexcept;
         void CombineScreens(
+            PixelBuffer& target,
             std::span<const uint32_t, NDS_SCREEN_AREA<size_t>> topBuffer,
             std::span<const uint32_t, NDS_SCREEN_AREA<size_t>> bottomBuffer,
             const ScreenLayoutData& screenLayout
         ) noexcept;
+        /// Sends \c frame to the frontend, first rotating it by \c quarterTurns if the core is rotating the screen.
+        void Present(const PixelBuffer& frame, unsigned quarterTurns) noexcept;
+        /// Upscales source rows [firstRow, lastRow) of one screen into \c hybridBuffer.
+        void ScaleHybridScreen(const uint32_t* src, unsigned ratio, unsigned firstRow, unsigned lastRow) noexcept;
+
+        struct SmallScreen {
+            const uint32_t* Pixels;
+            glm::uvec2 Translation;
+        };
+
+        /// Draws a hybrid or large-screen layout, splitting the work across \c compositionJobs if enabled.
+        void CombineScaledScreens(
+            PixelBuffer& target,
+            const uint32_t* primary,
+            glm::uvec2 primaryTranslation,
+            std::span<const SmallScreen> smallScreens,
+            const ScreenLayoutData& screenLayout
+        ) noexcept;
+
+        /// Remembers how a buffer was laid out when it was last composited,
+        /// so that the gaps between the screens don't need to be cleared every frame.
+        struct CompositionState {
+            const uint32_t* data = nullptr;
+            glm::uvec2 size {};
+            unsigned stride = 0;
+            ScreenLayout layout {};
+            HybridSideScreenDisplay hybridSmallScreen {};
+            unsigned hybridRatio = 0;
+            glm::uvec2 topTranslation {};
+            glm::uvec2 bottomTranslation {};
+            glm::uvec2 hybridTranslation {};
+            // Changes to these don't move the screens, but they do change what the frame looks like
+            scaler_type hybridFilter {};
+            unsigned rotation = 0;
+            uint32_t generation = 0;
+            // The cursor can extend past the screens, so the area it covered must be cleared next time
+            std::optional<std::pair<glm::uvec2, glm::uvec2>> cursorArea;
+
+            [[nodiscard]] bool SameLayout(const CompositionState& other) const noexcept;
+        };
+
+        /// Clears whatever parts of \c target won't be fully overwritten by the screens.
+        void PrepareTarget(PixelBuffer& target, const ScreenLayoutData& screenLayout) noexcept;
+        [[nodiscard]] CompositionState* FindCompositionState(const PixelBuffer& target) noexcept;
+        /// Describes where the screens go (and how they're drawn), but not which buffer they go in.
+        [[nodiscard]] CompositionState DescribeLayout(const ScreenLayoutData& screenLayout) noexcept;
+
+        /// Returns \c true if this frame would look exactly like the last one we presented.
+        /// Otherwise, remembers it for next time.
+        [[nodiscard]] bool FrameUnchanged(
+            const uint32_t* topBuffer,
+            const uint32_t* bottomBuffer,
+            std::optional<glm::ivec2> cursor,
+            float cursorSize,
+            const ScreenLayoutData& screenLayout
+        ) noexcept;
+
+        /// Composites the previous frame on a worker thread while the next one is emulated.
+        /// Presentation itself still happens on the main thread,
+        /// as libretro doesn't allow \c video_refresh to be called from anywhere else.
+        void RenderPipelined(
+            melonDS::NDS& nds,
+            const InputState& input,
+            const CoreConfig& config,
+            const ScreenLayoutData& screenLayout
+        ) noexcept;
+        [[gnu::cold]] bool StartCompositor() noexcept;
+        [[gnu::cold]] void StopCompositor() noexcept;
+        void CompositorMain() noexcept;
 
         PixelBuffer buffer;
         // Used as a staging area for the hybrid screen to be scaled
         PixelBuffer hybridBuffer;
         retro::Scaler hybridScaler;
+        // Only set if the screens should be combined on multiple threads
+        std::unique_ptr<JobGroup> compositionJobs;
+        // How many threads compositionJobs was asked for, including ours (it may have started fewer)
+        unsigned compositionThreads = 0;
+
+        // One for each buffer we composite into (buffer and presentBuffer are swapped when pipelining)
+        std::array<CompositionState, 2> compositionStates {};
+
+        // Copy of the screens (and everything else that went into them) from the last presented frame,
+        // so we can tell when a frame doesn't need to be drawn again
+        std::vector<uint32_t> presentedScreens;
+        std::optional<CompositionState> presentedLayout;
+        std::optional<glm::ivec2> presentedCursor;
+        float presentedCursorSize = 0;
+        // False if the last frame was drawn into the frontend's framebuffer instead of ours
+        bool lastFrameInBuffer = false;
+
+        // The error screen that buffer holds, and the layout it was composited for;
+        // it never changes, so it only needs to be composited again if the layout does
+        const error::ErrorScreen* presentedErrorScreen = nullptr;
+        ScreenLayout presentedErrorLayout {};
+        uint32_t presentedErrorGeneration = 0;
+
+        // The finished frame, rotated for frontends that can't rotate it themselves
+        PixelBuffer rotatedBuffer;
+
+        // The finished frame, converted for frontends that asked for RGB565
+        std::vector<uint16_t> rgb565Buffer;
+
+        // The finished frame, converted for frontends that fetch NV12 frames through melondsds_video_interface
+        bool nv12Output = false;
+        std::vector<uint8_t> nv12Buffer;
+        std::optional<Nv12Frame> nv12Frame;
+
+        // Checksums of the presented frames, for verifying that optimizations don't change the output
+        bool frameReadbackEnabled = false;
+        std::optional<uint32_t> lastFrameChecksum;
+        std::vector<FrameChecksum> frameChecksums;
+        uint64_t framesReadBack = 0;
+
+        // Holds the most recently composited frame while the compositor is working on the next one
+        PixelBuffer presentBuffer;
+        // Copy of the emulated screens that the compositor reads from,
+        // as the emulator will overwrite its own framebuffers during the next frame
+        std::vector<uint32_t> stagedScreens;
+        std::optional<ScreenLayoutData> stagedLayout;
+        std::optional<glm::ivec2> stagedCursor;
+        float stagedCursorSize = 0;
+        melonDS::Platform::Thread* compositorThread = nullptr;
+        melonDS::Platform::Semaphore* compositorStart = nullptr;
+        melonDS::Platform::Semaphore* compositorDone = nullptr;
+        bool compositorQuit = false;
+        bool compositionPending = false;
+        // Cleared if the frontend doesn't support RETRO_ENVIRONMENT_GET_CURRENT_SOFTWARE_FRAMEBUFFER
+        bool useFrontendFramebuffer = true;
+#ifdef HAVE_TRACY
+        std::optional<SoftwareTracyCapture> tracyCapture;
+#endif
     };
 }
 
@@ -0,0 +1,687 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include "vulkan.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+
+#include <glm/common.hpp>
+
+#include <NDS.h>
+#include <retro_assert.h>
+#include <vulkan/vulkan_symbol_wrapper.h>
+
+#include "config/config.hpp"
+#include "environment.hpp"
+#include "exceptions.hpp"
+#include "input/input.hpp"
+#include "libretro.hpp"
+#include "pixels.hpp"
+#include "screenlayout.hpp"
+#include "tracy.hpp"
+
+using glm::ivec2;
+using glm::uvec2;
+using glm::vec2;
+using std::array;
+using std::optional;
+using std::vector;
+using MelonDsDs::ScreenLayout;
+
+// melonDS's framebuffers are XRGB8888, which is BGRA in memory on every platform we support
+constexpr VkFormat SCREEN_FORMAT = VK_FORMAT_B8G8R8A8_UNORM;
+
+// Big enough for both screens stacked on top of each other, whether they're turned sideways or not
+constexpr uvec2 SCREENS_IMAGE_SIZE(MelonDsDs::NDS_SCREEN_WIDTH, MelonDsDs::NDS_SCREEN_WIDTH * 2);
+
+constexpr VkDeviceSize STAGING_SLOT_SIZE = MelonDsDs::NDS_SCREEN_AREA<VkDeviceSize> * 2 * MelonDsDs::PIXEL_SIZE;
+
+// More than any frontend uses, but the sync index mask could technically claim 32
+constexpr unsigned MAX_SLOTS = 4;
+
+constexpr VkImageSubresourceRange COLOR_SUBRESOURCE_RANGE {
+    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+    .baseMipLevel = 0,
+    .levelCount = 1,
+    .baseArrayLayer = 0,
+    .layerCount = 1,
+};
+
+constexpr VkImageSubresourceLayers COLOR_SUBRESOURCE_LAYERS {
+    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+    .mipLevel = 0,
+    .baseArrayLayer = 0,
+    .layerCount = 1,
+};
+
+static VkImageMemoryBarrier ImageBarrier(
+    VkImage image,
+    VkAccessFlags srcAccess,
+    VkAccessFlags dstAccess,
+    VkImageLayout oldLayout,
+    VkImageLayout newLayout
+) noexcept {
+    return {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = srcAccess,
+        .dstAccessMask = dstAccess,
+        .oldLayout = oldLayout,
+        .newLayout = newLayout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = COLOR_SUBRESOURCE_RANGE,
+    };
+}
+
+std::unique_ptr<MelonDsDs::VulkanRenderState> MelonDsDs::VulkanRenderState::New() noexcept {
+    ZoneScopedN(TracyFunction);
+    try {
+        return std::make_unique<VulkanRenderState>();
+    } catch (const vulkan_not_initialized_exception& e) {
+        retro::debug("Vulkan context could not be initialized: {}", e.what());
+        return nullptr;
+    }
+}
+
+MelonDsDs::VulkanRenderState::VulkanRenderState() {
+    ZoneScopedN(TracyFunction);
+    retro::debug(TracyFunction);
+
+    // Blits and buffer-to-image copies are all core Vulkan 1.0
+    retro_hw_render_callback callback {};
+    callback.context_type = RETRO_HW_CONTEXT_VULKAN;
+    callback.version_major = VK_API_VERSION_1_0;
+    callback.version_minor = 0;
+    callback.context_reset = HardwareContextReset;
+    callback.context_destroy = HardwareContextDestroyed;
+
+    if (!retro::set_hw_render(callback)) {
+        throw vulkan_not_initialized_exception("The frontend did not accept a Vulkan context");
+    }
+}
+
+MelonDsDs::VulkanRenderState::~VulkanRenderState() noexcept {
+    retro::debug(TracyFunction);
+    ContextDestroyed();
+
+    // See ~OpenGLRenderState
+    retro_hw_render_callback none {};
+    none.context_type = RETRO_HW_CONTEXT_NONE;
+    retro::set_hw_render(none);
+}
+
+void MelonDsDs::VulkanRenderState::ContextReset() {
+    ZoneScopedN(TracyFunction);
+    retro::debug(TracyFunction);
+
+    // If the context was reset without being destroyed first, whatever we had belongs to a dead device
+    _vulkan = nullptr;
+    _slots.clear();
+    _stagingBuffer = VK_NULL_HANDLE;
+    _stagingMemory = VK_NULL_HANDLE;
+
+    const retro_hw_render_interface_vulkan* vulkan = nullptr;
+    if (!retro::environment(RETRO_ENVIRONMENT_GET_HW_RENDER_INTERFACE, &vulkan) || !vulkan) {
+        throw vulkan_exception("Frontend did not provide a hardware render interface", "Failed to initialize Vulkan.");
+    }
+
+    if (vulkan->interface_type != RETRO_HW_RENDER_INTERFACE_VULKAN) {
+        throw vulkan_exception("Frontend's hardware render interface is not Vulkan", "Failed to initialize Vulkan.");
+    }
+
+    if (vulkan->interface_version != RETRO_HW_RENDER_INTERFACE_VULKAN_VERSION) {
+        throw vulkan_exception(
+            fmt::format(
+                "Frontend's Vulkan interface is version {}, expected {}",
+                vulkan->interface_version,
+                RETRO_HW_RENDER_INTERFACE_VULKAN_VERSION
+            ),
+            "Failed to initialize Vulkan."
+        );
+    }
+
+    retro::debug("Initializing Vulkan function pointers");
+    vulkan_symbol_wrapper_init(vulkan->get_instance_proc_addr);
+    if (!vulkan_symbol_wrapper_load_core_instance_symbols(vulkan->instance)) {
+        throw vulkan_exception("Failed to load Vulkan instance functions", "Failed to initialize Vulkan.");
+    }
+
+    if (!vulkan_symbol_wrapper_load_core_device_symbols(vulkan->device)) {
+        throw vulkan_exception("Failed to load Vulkan device functions", "Failed to initialize Vulkan.");
+    }
+
+    VkPhysicalDeviceProperties properties {};
+    vkGetPhysicalDeviceProperties(vulkan->gpu, &properties);
+    retro::info(
+        "Vulkan device: {} (API version {}.{}.{})",
+        properties.deviceName,
+        VK_VERSION_MAJOR(properties.apiVersion),
+        VK_VERSION_MINOR(properties.apiVersion),
+        VK_VERSION_PATCH(properties.apiVersion)
+    );
+
+    VkFormatProperties formatProperties {};
+    vkGetPhysicalDeviceFormatProperties(vulkan->gpu, SCREEN_FORMAT, &formatProperties);
+    constexpr VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+    if ((formatProperties.optimalTilingFeatures & requiredFeatures) != requiredFeatures) {
+        // Required by the spec, but some drivers have been known to lie
+        throw vulkan_exception("Vulkan device can't blit or sample BGRA8 images", "Failed to initialize Vulkan.");
+    }
+    _linearBlitSupported = formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    vkGetPhysicalDeviceMemoryProperties(vulkan->gpu, &_memoryProperties);
+
+    _vulkan = vulkan;
+    try {
+        CreateResources();
+    }
+    catch (...) {
+        DestroyResources();
+        _vulkan = nullptr;
+        throw;
+    }
+}
+
+void MelonDsDs::VulkanRenderState::ContextDestroyed() noexcept {
+    ZoneScopedN(TracyFunction);
+    if (!_vulkan)
+        return;
+
+    retro::debug(TracyFunction);
+    DestroyResources();
+    _vulkan = nullptr;
+}
+
+void MelonDsDs::VulkanRenderState::CreateResources() {
+    ZoneScopedN(TracyFunction);
+    retro_assert(_vulkan != nullptr);
+    VkDevice device = _vulkan->device;
+
+    // The frontend cycles through its sync indexes,
+    // so anything a frame uses can be reused once that frame's index comes around again
+    uint32_t syncIndexMask = _vulkan->get_sync_index_mask(_vulkan->handle);
+    unsigned slotCount = std::clamp<unsigned>(std::bit_width(syncIndexMask), 1, MAX_SLOTS);
+    retro::debug("Creating {} Vulkan frame slot(s) for sync index mask {:#x}", slotCount, syncIndexMask);
+
+    VkBufferCreateInfo bufferInfo {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = STAGING_SLOT_SIZE * slotCount,
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    if (vkCreateBuffer(device, &bufferInfo, nullptr, &_stagingBuffer) != VK_SUCCESS) {
+        throw vulkan_exception("Failed to create Vulkan staging buffer", "Failed to initialize Vulkan.");
+    }
+
+    VkMemoryRequirements requirements {};
+    vkGetBufferMemoryRequirements(device, _stagingBuffer, &requirements);
+
+    // Coherent memory saves us from flushing every frame; the submission makes our writes visible to the GPU
+    optional<uint32_t> memoryType = FindMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (!memoryType) {
+        throw vulkan_exception("No host-visible coherent Vulkan memory for the staging buffer", "Failed to initialize Vulkan.");
+    }
+
+    VkMemoryAllocateInfo allocateInfo {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = requirements.size,
+        .memoryTypeIndex = *memoryType,
+    };
+    if (vkAllocateMemory(device, &allocateInfo, nullptr, &_stagingMemory) != VK_SUCCESS) {
+        throw vulkan_exception("Failed to allocate Vulkan staging memory", "Failed to initialize Vulkan.");
+    }
+
+    void* mapping = nullptr;
+    if (vkBindBufferMemory(device, _stagingBuffer, _stagingMemory, 0) != VK_SUCCESS ||
+        vkMapMemory(device, _stagingMemory, 0, VK_WHOLE_SIZE, 0, &mapping) != VK_SUCCESS) {
+        throw vulkan_exception("Failed to map Vulkan staging memory", "Failed to initialize Vulkan.");
+    }
+
+    _slots.resize(slotCount);
+    for (unsigned i = 0; i < slotCount; ++i) {
+        Slot& slot = _slots[i];
+        slot.staging = reinterpret_cast<uint32_t*>(static_cast<std::byte*>(mapping) + STAGING_SLOT_SIZE * i);
+
+        CreateImage(slot.screens, SCREENS_IMAGE_SIZE, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+        VkCommandPoolCreateInfo poolInfo {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+            .queueFamilyIndex = _vulkan->queue_index,
+        };
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &slot.commandPool) != VK_SUCCESS) {
+            throw vulkan_exception("Failed to create Vulkan command pool", "Failed to initialize Vulkan.");
+        }
+
+        VkCommandBufferAllocateInfo commandBufferInfo {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = slot.commandPool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1,
+        };
+        if (vkAllocateCommandBuffers(device, &commandBufferInfo, &slot.commandBuffer) != VK_SUCCESS) {
+            throw vulkan_exception("Failed to allocate Vulkan command buffer", "Failed to initialize Vulkan.");
+        }
+
+        // The output image is created on the first frame, once we know how big it needs to be
+    }
+}
+
+void MelonDsDs::VulkanRenderState::DestroyResources() noexcept {
+    ZoneScopedN(TracyFunction);
+    retro_assert(_vulkan != nullptr);
+    VkDevice device = _vulkan->device;
+
+    // Nothing we destroy can still be in use by the GPU, and the queue must not be in use while we wait
+    if (_vulkan->lock_queue) {
+        _vulkan->lock_queue(_vulkan->handle);
+    }
+    vkDeviceWaitIdle(device);
+    if (_vulkan->unlock_queue) {
+        _vulkan->unlock_queue(_vulkan->handle);
+    }
+
+    for (Slot& slot : _slots) {
+        DestroyImage(slot.screens);
+        DestroyImage(slot.output);
+        if (slot.commandPool) {
+            // Also frees the command buffer
+            vkDestroyCommandPool(device, slot.commandPool, nullptr);
+        }
+    }
+    _slots.clear();
+
+    if (_stagingBuffer) {
+        vkDestroyBuffer(device, _stagingBuffer, nullptr);
+        _stagingBuffer = VK_NULL_HANDLE;
+    }
+
+    if (_stagingMemory) {
+        // Freeing memory unmaps it
+        vkFreeMemory(device, _stagingMemory, nullptr);
+        _stagingMemory = VK_NULL_HANDLE;
+    }
+}
+
+void MelonDsDs::VulkanRenderState::CreateImage(Image& image, uvec2 size, VkImageUsageFlags usage) {
+    ZoneScopedN(TracyFunction);
+    VkDevice device = _vulkan->device;
+    VkImageCreateInfo imageInfo {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = SCREEN_FORMAT,
+        .extent = { size.x, size.y, 1 },
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    if (vkCreateImage(device, &imageInfo, nullptr, &image.image) != VK_SUCCESS) {
+        throw vulkan_exception(fmt::format("Failed to create {}x{} Vulkan image", size.x, size.y), "Failed to initialize Vulkan.");
+    }
+
+    VkMemoryRequirements requirements {};
+    vkGetImageMemoryRequirements(device, image.image, &requirements);
+
+    optional<uint32_t> memoryType = FindMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (!memoryType) {
+        // Some integrated GPUs don't bother marking any memory as device-local
+        memoryType = FindMemoryType(requirements.memoryTypeBits, 0);
+    }
+
+    VkMemoryAllocateInfo allocateInfo {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = requirements.size,
+        .memoryTypeIndex = memoryType.value_or(0),
+    };
+    if (!memoryType ||
+        vkAllocateMemory(device, &allocateInfo, nullptr, &image.memory) != VK_SUCCESS ||
+        vkBindImageMemory(device, image.image, image.memory, 0) != VK_SUCCESS) {
+        throw vulkan_exception(fmt::format("Failed to allocate memory for {}x{} Vulkan image", size.x, size.y), "Failed to initialize Vulkan.");
+    }
+
+    image.size = size;
+}
+
+void MelonDsDs::VulkanRenderState::DestroyImage(Image& image) noexcept {
+    VkDevice device = _vulkan->device;
+    if (image.image) {
+        vkDestroyImage(device, image.image, nullptr);
+    }
+
+    if (image.memory) {
+        vkFreeMemory(device, image.memory, nullptr);
+    }
+
+    image = {};
+}
+
+optional<uint32_t> MelonDsDs::VulkanRenderState::FindMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const noexcept {
+    for (uint32_t i = 0; i < _memoryProperties.memoryTypeCount; ++i) {
+        if ((typeBits & (1u << i)) && (_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+
+    return std::nullopt;
+}
+
+void MelonDsDs::VulkanRenderState::Render(
+    melonDS::NDS& nds,
+    const InputState& input,
+    const CoreConfig& config,
+    const ScreenLayoutData& screenLayout
+) noexcept {
+    ZoneScopedN(TracyFunction);
+    retro_assert(_vulkan != nullptr);
+
+    // Once this returns, the GPU is done with everything that belongs to this frame's slot
+    _vulkan->wait_sync_index(_vulkan->handle);
+    unsigned syncIndex = _vulkan->get_sync_index(_vulkan->handle);
+    Slot& slot = _slots[syncIndex % _slots.size()];
+
+    uvec2 outputSize = screenLayout.OutputSize();
+    if (slot.output.size != outputSize) {
+        // If the layout changed since this slot was last used...
+        DestroyImage(slot.output);
+        try {
+            CreateImage(slot.output, outputSize, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+        }
+        catch (const vulkan_exception& e) {
+            retro::error("{}", e.what());
+            DestroyImage(slot.output);
+            return;
+        }
+
+        slot.outputImage = {
+            .image_view = VK_NULL_HANDLE,
+            .image_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .create_info = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+                .image = slot.output.image,
+                .viewType = VK_IMAGE_VIEW_TYPE_2D,
+                .format = SCREEN_FORMAT,
+                // melonDS doesn't promise anything about the alpha channel
+                .components = {
+                    VK_COMPONENT_SWIZZLE_R,
+                    VK_COMPONENT_SWIZZLE_G,
+                    VK_COMPONENT_SWIZZLE_B,
+                    VK_COMPONENT_SWIZZLE_ONE,
+                },
+                .subresourceRange = COLOR_SUBRESOURCE_RANGE,
+            },
+        };
+    }
+
+    _blits.clear();
+    uvec2 screenSize = NDS_SCREEN_SIZE<unsigned>;
+    if (!nds.IsLidClosed()) [[likely]] {
+        // If the emulated lid is closed, just draw a blank
+        // so that there's no annoying flickering with some games
+        unsigned quarterTurns = GetScreenBlits(_blits, screenLayout);
+        optional<ivec2> cursor = input.CursorVisible() ? std::make_optional(input.TouchPosition()) : std::nullopt;
+        StageScreens(slot, nds, cursor, config.CursorSize(), quarterTurns);
+        if (quarterTurns % 2) {
+            screenSize = uvec2(screenSize.y, screenSize.x);
+        }
+    }
+
+    VkFilter filter = config.ScreenFilter() == ScreenFilter::Linear && _linearBlitSupported ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+    RecordFrame(slot, _blits, screenSize, filter);
+
+    _vulkan->set_image(_vulkan->handle, &slot.outputImage, 0, nullptr, VK_QUEUE_FAMILY_IGNORED);
+    _vulkan->set_command_buffers(_vulkan->handle, 1, &slot.commandBuffer);
+    retro::video_refresh(RETRO_HW_FRAME_BUFFER_VALID, outputSize.x, outputSize.y, 0);
+}
+
+unsigned MelonDsDs::VulkanRenderState::GetScreenBlits(vector<ScreenBlit>& blits, const ScreenLayoutData& screenLayout) noexcept {
+    ZoneScopedN(TracyFunction);
+
+    // The first transformed point of each screen's rectangle (see GetPositionIndexes in opengl.cpp)
+    constexpr unsigned TOP = 0, BOTTOM = 4, HYBRID = 8;
+    struct DrawnScreen {
+        unsigned firstPoint;
+        unsigned screen;
+    };
+    array<DrawnScreen, 3> drawn {};
+    unsigned count = 2;
+    bool bothSmallScreens = screenLayout.HybridSmallScreenLayout() == HybridSideScreenDisplay::Both;
+    switch (screenLayout.Layout()) {
+        case ScreenLayout::TopOnly:
+            drawn = {{{TOP, 0}}};
+            count = 1;
+            break;
+        case ScreenLayout::BottomOnly:
+            drawn = {{{BOTTOM, 1}}};
+            count = 1;
+            break;
+        case ScreenLayout::HybridTop:
+        case ScreenLayout::FlippedHybridTop:
+            drawn = {{{HYBRID, 0}, {BOTTOM, 1}, {TOP, 0}}};
+            count = bothSmallScreens ? 3 : 2;
+            break;
+        case ScreenLayout::HybridBottom:
+        case ScreenLayout::FlippedHybridBottom:
+            drawn = {{{HYBRID, 1}, {TOP, 0}, {BOTTOM, 1}}};
+            count = bothSmallScreens ? 3 : 2;
+            break;
+        default:
+            // Every other layout puts the top screen in the top screen's rectangle, and likewise for the bottom
+            drawn = {{{TOP, 0}, {BOTTOM, 1}}};
+            break;
+    }
+
+    // If the frontend can't rotate the screen, then we turn the whole layout ourselves (see RotateLayoutVertices)
+    const array<vec2, 12>& points = screenLayout.TransformedScreenPoints();
+    vec2 bufferSize(screenLayout.BufferSize());
+    unsigned coreTurns = screenLayout.CoreRotation();
+    auto rotate = [bufferSize, coreTurns](vec2 p) noexcept {
+        switch (coreTurns % 4) {
+            case 1:
+                return vec2(p.y, bufferSize.x - p.x);
+            case 2:
+                return bufferSize - p;
+            case 3:
+                return vec2(bufferSize.y - p.y, p.x);
+            default:
+                return p;
+        }
+    };
+
+    ivec2 outputSize(screenLayout.OutputSize());
+    unsigned quarterTurns = 0;
+    for (unsigned i = 0; i < count; ++i) {
+        // Each screen's corners are in the order northwest, northeast, southeast, southwest
+        // (relative to the screen's own contents, not to the output)
+        vec2 northwest = rotate(points[drawn[i].firstPoint]);
+        vec2 northeast = rotate(points[drawn[i].firstPoint + 1]);
+        vec2 southeast = rotate(points[drawn[i].firstPoint + 2]);
+
+        // Blits can't turn an image, so work out how far the layout turns the screens
+        // (all of a layout's screens face the same way) and turn them before they're uploaded
+        vec2 across = northeast - northwest;
+        if (std::abs(across.x) >= std::abs(across.y)) {
+            quarterTurns = across.x >= 0 ? 0 : 2;
+        }
+        else {
+            // +Y points down, so a screen whose top edge runs upwards has been turned counter-clockwise
+            quarterTurns = across.y < 0 ? 1 : 3;
+        }
+
+        ivec2 start = clamp(ivec2(glm::round(glm::min(northwest, southeast))), ivec2(0), outputSize);
+        ivec2 end = clamp(ivec2(glm::round(glm::max(northwest, southeast))), ivec2(0), outputSize);
+        if (start.x < end.x && start.y < end.y) {
+            blits.push_back({ drawn[i].screen, start, end });
+        }
+    }
+
+    return quarterTurns;
+}
+
+void MelonDsDs::VulkanRenderState::StageScreens(
+    Slot& slot,
+    const melonDS::NDS& nds,
+    optional<ivec2> cursor,
+    float cursorSize,
+    unsigned quarterTurns
+) noexcept {
+    ZoneScopedN(TracyFunction);
+    const uint32_t* topScreen = nds.GPU.Framebuffer[nds.GPU.FrontBuffer][0].get();
+    const uint32_t* bottomScreen = nds.GPU.Framebuffer[nds.GPU.FrontBuffer][1].get();
+
+    if (cursor) {
+        // The cursor is drawn onto the bottom screen before it's turned, so that it turns with it
+        // (and so that it's scaled along with any screen that shows it, like the OpenGL presenter's)
+        _cursorScreen.assign(bottomScreen, bottomScreen + NDS_SCREEN_AREA<size_t>);
+        ivec2 size = ivec2(cursorSize);
+        ivec2 start = clamp(*cursor - size, ivec2(0), NDS_SCREEN_SIZE<int>);
+        ivec2 end = clamp(*cursor + size, ivec2(0), NDS_SCREEN_SIZE<int>);
+        if (start.x < end.x && start.y < end.y) {
+            pixels::InvertRect(_cursorScreen.data() + start.y * NDS_SCREEN_WIDTH + start.x, NDS_SCREEN_WIDTH, end.x - start.x, end.y - start.y);
+        }
+        bottomScreen = _cursorScreen.data();
+    }
+
+    // Each screen is packed tightly, one after the other
+    unsigned stagedWidth = quarterTurns % 2 ? NDS_SCREEN_HEIGHT : NDS_SCREEN_WIDTH;
+    pixels::RotateRect(slot.staging, stagedWidth, topScreen, NDS_SCREEN_WIDTH, NDS_SCREEN_WIDTH, NDS_SCREEN_HEIGHT, quarterTurns);
+    pixels::RotateRect(slot.staging + NDS_SCREEN_AREA<size_t>, stagedWidth, bottomScreen, NDS_SCREEN_WIDTH, NDS_SCREEN_WIDTH, NDS_SCREEN_HEIGHT, quarterTurns);
+}
+
+void MelonDsDs::VulkanRenderState::RecordFrame(
+    Slot& slot,
+    const vector<ScreenBlit>& blits,
+    uvec2 screenSize,
+    VkFilter filter
+) noexcept {
+    ZoneScopedN(TracyFunction);
+    VkCommandBuffer cmd = slot.commandBuffer;
+    VkDeviceSize stagingOffset = STAGING_SLOT_SIZE * static_cast<VkDeviceSize>(&slot - _slots.data());
+    vkResetCommandPool(_vulkan->device, slot.commandPool, 0);
+
+    VkCommandBufferBeginInfo beginInfo {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    vkBeginCommandBuffer(cmd, &beginInfo);
+
+    // Neither image's old contents are needed, so they can start out undefined every frame
+    array<VkImageMemoryBarrier, 2> toTransferDst {
+        ImageBarrier(slot.screens.image, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL),
+        ImageBarrier(slot.output.image, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL),
+    };
+    vkCmdPipelineBarrier(
+        cmd,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+        0, nullptr,
+        0, nullptr,
+        toTransferDst.size(), toTransferDst.data()
+    );
+
+    // The gaps between the screens are black
+    VkClearColorValue black {};
+    vkCmdClearColorImage(cmd, slot.output.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &black, 1, &COLOR_SUBRESOURCE_RANGE);
+
+    if (!blits.empty()) {
+        // If there's anything to draw... (i.e. the lid isn't closed)
+        array<VkBufferImageCopy, 2> copies {};
+        for (unsigned i = 0; i < copies.size(); ++i) {
+            copies[i] = {
+                .bufferOffset = stagingOffset + NDS_SCREEN_AREA<VkDeviceSize> * PIXEL_SIZE * i,
+                .bufferRowLength = screenSize.x,
+                .bufferImageHeight = screenSize.y,
+                .imageSubresource = COLOR_SUBRESOURCE_LAYERS,
+                .imageOffset = { 0, static_cast<int32_t>(screenSize.y * i), 0 },
+                .imageExtent = { screenSize.x, screenSize.y, 1 },
+            };
+        }
+        vkCmdCopyBufferToImage(cmd, _stagingBuffer, slot.screens.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, copies.size(), copies.data());
+
+        VkImageMemoryBarrier toTransferSrc = ImageBarrier(
+            slot.screens.image,
+            VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_ACCESS_TRANSFER_READ_BIT,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+        );
+        // The clear and the blits both write to the output image, so they must happen in order
+        VkImageMemoryBarrier afterClear = ImageBarrier(
+            slot.output.image,
+            VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+        );
+        array<VkImageMemoryBarrier, 2> beforeBlits { toTransferSrc, afterClear };
+        vkCmdPipelineBarrier(
+            cmd,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            0, nullptr,
+            0, nullptr,
+            beforeBlits.size(), beforeBlits.data()
+        );
+
+        ivec2 sourceSize(screenSize);
+        for (const ScreenBlit& blit : blits) {
+            VkImageBlit region {
+                .srcSubresource = COLOR_SUBRESOURCE_LAYERS,
+                .srcOffsets = {
+                    { 0, sourceSize.y * static_cast<int32_t>(blit.screen), 0 },
+                    { sourceSize.x, sourceSize.y * static_cast<int32_t>(blit.screen + 1), 1 },
+                },
+                .dstSubresource = COLOR_SUBRESOURCE_LAYERS,
+                .dstOffsets = {
+                    { blit.start.x, blit.start.y, 0 },
+                    { blit.end.x, blit.end.y, 1 },
+                },
+            };
+
+            // Unscaled screens are copied exactly, whatever the filter
+            VkFilter blitFilter = (blit.end - blit.start) == sourceSize ? VK_FILTER_NEAREST : filter;
+            vkCmdBlitImage(
+                cmd,
+                slot.screens.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                slot.output.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                1, &region,
+                blitFilter
+            );
+        }
+    }
+
+    // The frontend samples the output image in its own fragment shader
+    VkImageMemoryBarrier toShaderRead = ImageBarrier(
+        slot.output.image,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_ACCESS_SHADER_READ_BIT,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    );
+    vkCmdPipelineBarrier(
+        cmd,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+        0, nullptr,
+        0, nullptr,
+        1, &toShaderRead
+    );
+
+    vkEndCommandBuffer(cmd);
+}
@@ -0,0 +1,115 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef MELONDSDS_RENDER_VULKAN_HPP
+#define MELONDSDS_RENDER_VULKAN_HPP
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <libretro_vulkan.h>
+
+#include "render.hpp"
+
+namespace MelonDsDs {
+    enum class ScreenLayout;
+
+    /// Composites the software renderer's screens with the frontend's Vulkan device,
+    /// for frontends (or drivers) that don't offer a usable OpenGL context.
+    ///
+    /// There are no shaders involved; the screens are uploaded through a persistently-mapped staging ring,
+    /// then copied into place with image blits (which can scale, but not turn, an image).
+    /// Screens that must be drawn sideways or upside down are turned on the CPU while they're staged.
+    class VulkanRenderState final : public RenderState {
+    public:
+        static std::unique_ptr<VulkanRenderState> New() noexcept;
+        VulkanRenderState();
+        ~VulkanRenderState() noexcept override;
+        VulkanRenderState(const VulkanRenderState&) = delete;
+        VulkanRenderState(VulkanRenderState&&) = delete;
+        VulkanRenderState& operator=(const VulkanRenderState&) = delete;
+        VulkanRenderState& operator=(VulkanRenderState&&) = delete;
+        [[nodiscard]] bool Ready() const noexcept override { return _vulkan != nullptr; }
+        void Render(
+            melonDS::NDS& nds,
+            const InputState& input,
+            const CoreConfig& config,
+            const ScreenLayoutData& screenLayout
+        ) noexcept override;
+
+        void ContextReset();
+        void ContextDestroyed() noexcept;
+    private:
+        struct Image {
+            VkImage image = VK_NULL_HANDLE;
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            glm::uvec2 size {};
+        };
+
+        /// Everything needed to draw one frame; there's one for each of the frontend's sync indexes,
+        /// so that we never touch anything the GPU might still be using.
+        struct Slot {
+            /// Both screens as they were staged, the top one above the bottom one
+            Image screens;
+            Image output;
+            retro_vulkan_image outputImage {};
+            VkCommandPool commandPool = VK_NULL_HANDLE;
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+            /// This slot's part of the staging ring
+            uint32_t* staging = nullptr;
+        };
+
+        /// Where one screen is drawn in the output image
+        struct ScreenBlit {
+            unsigned screen;
+            glm::ivec2 start;
+            glm::ivec2 end;
+        };
+
+        void CreateResources();
+        void DestroyResources() noexcept;
+        void CreateImage(Image& image, glm::uvec2 size, VkImageUsageFlags usage);
+        void DestroyImage(Image& image) noexcept;
+        [[nodiscard]] std::optional<uint32_t> FindMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const noexcept;
+        void StageScreens(Slot& slot, const melonDS::NDS& nds, std::optional<glm::ivec2> cursor, float cursorSize, unsigned quarterTurns) noexcept;
+        void RecordFrame(Slot& slot, const std::vector<ScreenBlit>& blits, glm::uvec2 screenSize, VkFilter filter) noexcept;
+        /// Works out where each screen goes (and how far it's turned) from the layout's geometry,
+        /// the same geometry that \c OpenGLRenderState::InitVertices uses.
+        /// \returns How many quarter turns counter-clockwise each screen must be staged with.
+        static unsigned GetScreenBlits(std::vector<ScreenBlit>& blits, const ScreenLayoutData& screenLayout) noexcept;
+
+        // Null until the frontend resets the context
+        const retro_hw_render_interface_vulkan* _vulkan = nullptr;
+        VkPhysicalDeviceMemoryProperties _memoryProperties {};
+        bool _linearBlitSupported = false;
+
+        // Holds every slot's screens; mapped for as long as it exists
+        VkBuffer _stagingBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory _stagingMemory = VK_NULL_HANDLE;
+        std::vector<Slot> _slots;
+
+        // Reused every frame
+        std::vector<ScreenBlit> _blits;
+        // The bottom screen with the cursor drawn on it, before it's staged
+        std::vector<uint32_t> _cursorScreen;
+    };
+}
+
+#endif // MELONDSDS_RENDER_VULKAN_HPP
@@ -16,13 +16,17 @@
 
 #include "http.hpp"
 
+#include <algorithm>
+#include <cctype>
 #include <stdexcept>
 
 #include <net/net_http.h>
+#include <lists/string_list.h>
 #include <retro_assert.h>
 
-retro::HttpConnection::HttpConnection(std::string_view url, std::string_view method, std::string_view data) :
-    _connection(net_http_connection_new(url.data(), method.data(), data.data())) {
+retro::HttpConnection::HttpConnection(std::string_view url, std::string_view method, std::string_view data, std::string_view headers) :
+    _connection(net_http_connection_new(url.data(), method.data(), data.data())),
+    _headers(headers) {
 
     if (!_connection) {
 
@@ -33,6 +37,13 @@ retro::HttpConnection::HttpConnection(std::string_view url, std::string_view met
         throw std::bad_alloc();
     }
 
+#ifdef HAVE_NET_HTTP_HEADERS
+    if (!_headers.empty()) {
+        // The connection doesn't copy the headers, so we keep them alive ourselves
+        net_http_connection_set_headers(_connection, _headers.c_str());
+    }
+#endif
+
     bool url_parsed = net_http_connection_iterate(_connection);
     retro_assert(url_parsed);
 
@@ -79,4 +90,33 @@ std::span<const std::byte> retro::HttpConnection::Data(bool acceptError) const n
     uint8_t* payload = net_http_data(_http, &length, acceptError);
 
     return std::span((const std::byte*)payload, length);
+}
+
+std::optional<std::string> retro::HttpConnection::Header(std::string_view name) const noexcept {
+#ifdef HAVE_NET_HTTP_HEADERS
+    const string_list* headers = net_http_headers(_http);
+    if (!headers)
+        return std::nullopt;
+
+    for (size_t i = 0; i < headers->size; ++i) {
+        // Each element is one "Name: value" line
+        std::string_view line = headers->elems[i].data ? headers->elems[i].data : "";
+        size_t colon = line.find(':');
+        if (colon != name.size() || !std::equal(name.begin(), name.end(), line.begin(), [](char a, char b) {
+            return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+        }))
+            continue;
+
+        std::string_view value = line.substr(colon + 1);
+        while (!value.empty() && (value.front() == ' ' || value.front() == '\t'))
+            value.remove_prefix(1);
+        while (!value.empty() && (value.back() == '\r' || value.back() == ' '))
+            value.remove_suffix(1);
+
+        return std::string(value);
+    }
+#else
+    (void)name;
+#endif
+    return std::nullopt;
 }
\ No newline at end of file
@@ -17,6 +17,8 @@
 #ifndef MELONDSDS_RETRO_HTTP_HPP
 #define MELONDSDS_RETRO_HTTP_HPP
 
+#include <optional>
+#include <string>
 #include <string_view>
 #include "std/span.hpp"
 
@@ -26,7 +28,9 @@ namespace retro {
     class Http;
     class HttpConnection {
     public:
-        HttpConnection(std::string_view url, std::string_view method, std::string_view data = {});
+        /// \param headers Extra request headers, each one ending with \c "\r\n".
+        /// Ignored if this build's libretro-common can't send custom headers.
+        HttpConnection(std::string_view url, std::string_view method, std::string_view data = {}, std::string_view headers = {});
         ~HttpConnection() noexcept;
         HttpConnection(const HttpConnection&) = delete;
         HttpConnection(HttpConnection&&) = delete;
@@ -37,9 +41,14 @@ namespace retro {
         bool IsError() const noexcept;
         int Status() const noexcept;
         std::span<const std::byte> Data(bool acceptError) const noexcept;
+
+        /// Returns the value of the response header \c name (case-insensitive),
+        /// or \c nullopt if the server didn't send it (or this build can't read response headers).
+        std::optional<std::string> Header(std::string_view name) const noexcept;
     private:
         http_connection_t* _connection = nullptr;
         http_t* _http = nullptr;
+        std::string _headers;
     };
 }
 
@@ -17,16 +17,100 @@ Copyright 2023 Jesse Talavera-Greenberg
 #include "info.hpp"
 
 #include <cstring>
+
+#include <encodings/crc32.h>
+#include <file/file_path.h>
 #include <libretro.h>
+#include <streams/file_stream.h>
+
+retro::GameInfo::GameInfo(const retro_game_info& info) noexcept : GameInfo(info, false) {
+}
 
-retro::GameInfo::GameInfo(const retro_game_info& info) noexcept :
+retro::GameInfo::GameInfo(const retro_game_info& info, bool persistent) noexcept : GameInfo(info, persistent, {}) {
+}
+
+retro::GameInfo::GameInfo(const retro_game_info& info, bool persistent, MelonDsDs::memory::SharedFileMapping preloaded) noexcept :
     _path(info.path ? info.path : ""),
-    _data(info.data && info.size ? std::make_unique<std::byte[]>(info.size) : nullptr),
+    _data(persistent ? static_cast<const std::byte*>(info.data) : nullptr),
     _size(info.size),
     _meta(info.meta ? info.meta : "")
 {
-    if (_data) {
-        memcpy(_data.get(), info.data, info.size);
+    if (persistent || !info.data || !info.size)
+        return;
+
+    if (!_path.empty() && path_is_valid(_path.c_str())) {
+        // If the content came straight from a file (rather than from inside an archive)...
+        _mapping = preloaded ? std::move(preloaded) : MelonDsDs::memory::SharedFileMapping::Open(_path.c_str());
+        std::span<const std::byte> mapped = _mapping.Data();
+        if (_mapping && (mapped.size() != info.size || memcmp(mapped.data(), info.data, info.size) != 0)) {
+            // If the frontend patched the content, then the file isn't what we were given
+            _mapping = {};
+        }
+
+        if (_mapping) {
+            _data = mapped.data();
+            return;
+        }
+    }
+
+    _ownedData = std::make_unique<std::byte[]>(info.size);
+    memcpy(_ownedData.get(), info.data, info.size);
+    _data = _ownedData.get();
+}
+
+size_t retro::GameInfo::ReleaseData(size_t keep) noexcept {
+    if (!OwnsData() || _size <= keep || IsDataReleased())
+        return 0;
+
+    if (_path.empty() || !path_is_valid(_path.c_str())) {
+        // If we couldn't read the content back (e.g. it came from inside an archive)...
+        return 0;
     }
+
+    uint32_t checksum = encoding_crc32(0, reinterpret_cast<const uint8_t*>(_data), _size);
+    std::unique_ptr<std::byte[]> kept = keep ? std::make_unique<std::byte[]>(keep) : nullptr;
+    if (kept) {
+        memcpy(kept.get(), _data, keep);
+    }
+
+    size_t freed = _size - keep;
+    _releasedSize = _size;
+    _releasedChecksum = checksum;
+    _ownedData = std::move(kept);
+    _mapping = {};
+    _data = _ownedData.get();
+    _size = keep;
+
+    return freed;
 }
 
+bool retro::GameInfo::ReloadData() noexcept {
+    if (!IsDataReleased())
+        return true;
+
+    RFILE* file = filestream_open(_path.c_str(), RETRO_VFS_FILE_ACCESS_READ, RETRO_VFS_FILE_ACCESS_HINT_NONE);
+    if (!file)
+        return false;
+
+    // Read straight into the new buffer, so that we never hold two copies of the content at once
+    std::unique_ptr<std::byte[]> data;
+    if (int64_t length = filestream_get_size(file); length >= 0 && static_cast<uint64_t>(length) == _releasedSize) {
+        data = std::make_unique<std::byte[]>(_releasedSize);
+        if (filestream_read(file, data.get(), length) != length) {
+            data = nullptr;
+        }
+    }
+    filestream_close(file);
+
+    if (!data || encoding_crc32(0, reinterpret_cast<const uint8_t*>(data.get()), _releasedSize) != _releasedChecksum) {
+        return false;
+    }
+
+    _ownedData = std::move(data);
+    _data = _ownedData.get();
+    _size = _releasedSize;
+    _releasedSize = 0;
+    _releasedChecksum = 0;
+
+    return true;
+}
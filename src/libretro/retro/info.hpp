@@ -18,10 +18,12 @@
 #define MELONDSDS_RETRO_GAMEINFO_HPP
 
 #include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <string_view>
 
+#include "platform/memory.hpp"
 #include "std/span.hpp"
 
 struct retro_game_info;
@@ -32,16 +34,58 @@ namespace retro {
     public:
         GameInfo(const retro_game_info& info) noexcept;
 
+        /// If \c persistent is \c true, then the frontend guarantees that \c info.data
+        /// stays valid until the game is unloaded, so it's referenced instead of copied.
+        /// Otherwise, if \c info.path names a file with exactly the same contents,
+        /// that file is mapped instead of copied so that other processes can share its pages.
+        GameInfo(const retro_game_info& info, bool persistent) noexcept;
+
+        /// As above, but uses \c preloaded (a mapping of \c info.path made ahead of time) instead of mapping the file again.
+        /// \c preloaded is only used if it has exactly the same contents as \c info.data.
+        GameInfo(const retro_game_info& info, bool persistent, MelonDsDs::memory::SharedFileMapping preloaded) noexcept;
+
+        GameInfo(const GameInfo&) = delete;
+        GameInfo& operator=(const GameInfo&) = delete;
+        GameInfo(GameInfo&&) noexcept = default;
+        GameInfo& operator=(GameInfo&&) noexcept = default;
+
         std::string_view GetPath() const noexcept { return _path; }
         std::span<const std::byte> GetData() const noexcept {
-            return std::span(_data.get(), _size);
+            return std::span(_data, _size);
         }
         std::string_view GetMeta() const noexcept { return _meta; }
+
+        /// \c true if this object holds its own copy of the content data (mapped or not).
+        bool OwnsData() const noexcept { return _ownedData != nullptr || IsMapped(); }
+
+        /// \c true if the content data is a shared mapping of \c GetPath.
+        bool IsMapped() const noexcept { return static_cast<bool>(_mapping); }
+
+        /// Frees this object's copy of the content data except for the first \c keep bytes
+        /// (e.g. the ROM header, which is consulted for the rest of the session),
+        /// so that \c GetData only returns those bytes until \c ReloadData is called.
+        /// Does nothing unless this object owns its data and \c GetPath names a file that \c ReloadData can read.
+        /// A mapping is released too, which frees address space rather than memory.
+        /// @returns The number of bytes freed.
+        size_t ReleaseData(size_t keep) noexcept;
+
+        /// \c true if the data was released with \c ReleaseData and hasn't been reloaded since.
+        bool IsDataReleased() const noexcept { return _releasedSize != 0; }
+
+        /// Reads the released data back from \c GetPath.
+        /// @returns \c false if the file couldn't be read or no longer matches the released data
+        /// (e.g. the frontend patched the content when loading it), in which case nothing changes.
+        bool ReloadData() noexcept;
     private:
         std::string _path;
-        std::unique_ptr<std::byte[]> _data;
+        std::unique_ptr<std::byte[]> _ownedData;
+        MelonDsDs::memory::SharedFileMapping _mapping;
+        const std::byte* _data;
         size_t _size;
         std::string _meta;
+        // The length and checksum of the data before it was released; 0 if it wasn't
+        size_t _releasedSize = 0;
+        uint32_t _releasedChecksum = 0;
     };
 
 } // retro
@@ -0,0 +1,216 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "logsink.hpp"
+
+#include <cstring>
+#include <thread>
+
+namespace {
+    // How long the drain thread sleeps when the queue is empty before checking again,
+    // in case a producer's wakeup raced with the thread going to sleep
+    constexpr int64_t DRAIN_TIMEOUT_US = 10'000;
+}
+
+retro::AsyncLogSink::AsyncLogSink() noexcept {
+    for (size_t i = 0; i < CAPACITY; ++i) {
+        _slots[i].Sequence.store(i, std::memory_order_relaxed);
+    }
+    _drainLock = slock_new();
+    _wakeLock = slock_new();
+    _wake = scond_new();
+}
+
+retro::AsyncLogSink::~AsyncLogSink() noexcept {
+    Stop();
+    scond_free(_wake);
+    slock_free(_wakeLock);
+    slock_free(_drainLock);
+}
+
+bool retro::AsyncLogSink::Start(retro_log_printf_t log) noexcept {
+    _log.store(log, std::memory_order_release);
+    if (Running())
+        return true;
+
+    if (!_drainLock || !_wakeLock || !_wake)
+        return false;
+
+    _running.store(true, std::memory_order_release);
+    _thread = sthread_create(DrainThread, this);
+    if (!_thread) {
+        _running.store(false, std::memory_order_release);
+        return false;
+    }
+
+    return true;
+}
+
+void retro::AsyncLogSink::Stop() noexcept {
+    if (!_thread)
+        return;
+
+    // Sequentially consistent, to pair with Push's check of _pushers and _running
+    _running.store(false);
+    slock_lock(_wakeLock);
+    scond_signal(_wake);
+    slock_unlock(_wakeLock);
+    sthread_join(_thread);
+    _thread = nullptr;
+
+    while (_pushers.load() > 0) {
+        // If another thread saw the sink running and is still queuing its record...
+        std::this_thread::yield();
+    }
+
+    // Anything queued after the thread's last drain
+    Flush();
+    _log.store(nullptr, std::memory_order_release);
+}
+
+bool retro::AsyncLogSink::Push(retro_log_level level, std::string_view text, bool flush) noexcept {
+    _pushers.fetch_add(1);
+    if (!_running.load()) {
+        // If the sink has stopped (or is stopping), the caller has to log this itself
+        _pushers.fetch_sub(1, std::memory_order_release);
+        return false;
+    }
+
+    bool queued = Enqueue(level, text, flush);
+    _pushers.fetch_sub(1, std::memory_order_release);
+    return queued;
+}
+
+bool retro::AsyncLogSink::Enqueue(retro_log_level level, std::string_view text, bool flush) noexcept {
+    if (text.size() > RECORD_SIZE) {
+        // If this record won't fit in a slot, deliver everything before it so that the caller can log it in order
+        _oversized.fetch_add(1, std::memory_order_relaxed);
+        Flush();
+        return false;
+    }
+
+    size_t ticket = _tail.load(std::memory_order_relaxed);
+    Slot* slot = nullptr;
+    bool stalled = false;
+    while (true) {
+        slot = &_slots[ticket & INDEX_MASK];
+        size_t sequence = slot->Sequence.load(std::memory_order_acquire);
+        auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(ticket);
+        if (difference == 0) {
+            // If this slot is free, try to claim it
+            if (_tail.compare_exchange_weak(ticket, ticket + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (difference < 0) {
+            // If the queue is full, wait for the drain to catch up (or do it ourselves if it's stopping)
+            if (!stalled) {
+                _stalls.fetch_add(1, std::memory_order_relaxed);
+                stalled = true;
+            }
+
+            if (!Running()) {
+                Drain();
+            } else {
+                std::this_thread::yield();
+            }
+            ticket = _tail.load(std::memory_order_relaxed);
+        }
+        else {
+            // Another thread claimed this slot first
+            ticket = _tail.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->Level = level;
+    memcpy(slot->Text.data(), text.data(), text.size());
+    slot->Sequence.store(ticket + 1, std::memory_order_release);
+    _queued.fetch_add(1, std::memory_order_relaxed);
+
+    if (flush || !Running()) {
+        // If the sink started stopping after we checked, its final flush may already be draining this record
+        WaitFor(ticket);
+    }
+    else if (_sleeping.load(std::memory_order_acquire)) {
+        scond_signal(_wake);
+    }
+
+    return true;
+}
+
+void retro::AsyncLogSink::Flush() noexcept {
+    size_t tail = _tail.load(std::memory_order_acquire);
+    if (tail != 0) {
+        WaitFor(tail - 1);
+    }
+}
+
+void retro::AsyncLogSink::WaitFor(size_t ticket) noexcept {
+    while (_delivered.load(std::memory_order_acquire) <= ticket) {
+        // Drain on this thread rather than waiting to be woken,
+        // so records still get delivered if the sink is stopping
+        if (Drain() == 0) {
+            // If an older record is still being written by another thread...
+            std::this_thread::yield();
+        }
+    }
+}
+
+size_t retro::AsyncLogSink::Drain() noexcept {
+    // No Tracy zone here, since the sink may be started before Tracy is
+    slock_lock(_drainLock);
+    retro_log_printf_t log = _log.load(std::memory_order_acquire);
+    size_t delivered = 0;
+    while (true) {
+        Slot& slot = _slots[_head & INDEX_MASK];
+        if (slot.Sequence.load(std::memory_order_acquire) != _head + 1)
+            break; // The next record hasn't been written yet (or there isn't one)
+
+        if (log) {
+            log(slot.Level, slot.Text.data());
+        }
+        slot.Sequence.store(_head + CAPACITY, std::memory_order_release);
+        ++_head;
+        ++delivered;
+        _delivered.store(_head, std::memory_order_release);
+    }
+    slock_unlock(_drainLock);
+    return delivered;
+}
+
+void retro::AsyncLogSink::DrainThread(void* self) noexcept {
+    auto& sink = *static_cast<AsyncLogSink*>(self);
+    while (sink.Running()) {
+        if (sink.Drain() > 0)
+            continue;
+
+        sink._sleeping.store(true, std::memory_order_release);
+        slock_lock(sink._wakeLock);
+        if (sink.Running()) {
+            scond_wait_timeout(sink._wake, sink._wakeLock, DRAIN_TIMEOUT_US);
+        }
+        slock_unlock(sink._wakeLock);
+        sink._sleeping.store(false, std::memory_order_release);
+    }
+}
+
+retro::LogSinkStats retro::AsyncLogSink::Stats() const noexcept {
+    return {
+        .Queued = _queued.load(std::memory_order_relaxed),
+        .Oversized = _oversized.load(std::memory_order_relaxed),
+        .Stalls = _stalls.load(std::memory_order_relaxed),
+    };
+}
@@ -0,0 +1,129 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#ifndef MELONDS_DS_LOGSINK_HPP
+#define MELONDS_DS_LOGSINK_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include <libretro.h>
+#include <rthreads/rthreads.h>
+
+namespace retro {
+    struct LogSinkStats {
+        uint64_t Queued = 0;
+
+        /// Records that were too long for a slot, and so were logged directly (after the queue was flushed).
+        uint64_t Oversized = 0;
+
+        /// Times a thread had to wait for the queue to make room.
+        uint64_t Stalls = 0;
+    };
+
+    /// Hands formatted log records to the frontend's log callback on a background thread,
+    /// so that frontends that write (and flush) each line to disk don't stall the thread that logged it.
+    ///
+    /// Records are queued in a lock-free bounded ring that any thread can push to;
+    /// they're delivered in the order their slots were claimed, one at a time.
+    /// Only the drain is serialized (by \c _drainLock), so a thread that needs its record delivered now
+    /// (e.g. an error, or anything logged after the sink stops) can drain the queue itself.
+    class AsyncLogSink {
+    public:
+        /// Each record (including its newline and null terminator) must fit in one slot;
+        /// longer records are logged synchronously instead.
+        static constexpr size_t RECORD_SIZE = 512;
+
+        /// Enough for a burst of logging at boot (e.g. opening every system file) without stalling.
+        static constexpr size_t CAPACITY = 512;
+
+        AsyncLogSink() noexcept;
+
+        /// Stops the background thread, if it's running.
+        ~AsyncLogSink() noexcept;
+        AsyncLogSink(const AsyncLogSink&) = delete;
+        AsyncLogSink(AsyncLogSink&&) = delete;
+        AsyncLogSink& operator=(const AsyncLogSink&) = delete;
+        AsyncLogSink& operator=(AsyncLogSink&&) = delete;
+
+        /// Starts delivering queued records to \c log, or switches to it if the sink is already running.
+        /// @returns \c false if the background thread couldn't be started.
+        bool Start(retro_log_printf_t log) noexcept;
+
+        /// Delivers every queued record, then stops the background thread.
+        /// Records pushed after this are rejected, and nothing more is delivered to the old log callback.
+        void Stop() noexcept;
+
+        [[nodiscard]] bool Running() const noexcept { return _running.load(std::memory_order_acquire); }
+
+        /// Queues \c text (which must end with a null terminator) to be delivered at \c level.
+        /// If \c flush is \c true, waits until it's been delivered.
+        /// @returns \c false if the sink isn't running, or if \c text is too long to queue
+        /// (in which case older records are delivered first, so the caller can log it directly without reordering anything).
+        bool Push(retro_log_level level, std::string_view text, bool flush) noexcept;
+
+        /// Waits until every record queued so far has been delivered.
+        void Flush() noexcept;
+
+        [[nodiscard]] LogSinkStats Stats() const noexcept;
+    private:
+        static constexpr size_t INDEX_MASK = CAPACITY - 1;
+        static_assert((CAPACITY & INDEX_MASK) == 0, "CAPACITY must be a power of 2");
+
+        struct Slot {
+            // Equal to the slot's ticket when it's free to write,
+            // one more than that once a record is written, and CAPACITY more once it's delivered
+            std::atomic<size_t> Sequence;
+            retro_log_level Level;
+            std::array<char, RECORD_SIZE> Text;
+        };
+
+        static void DrainThread(void* self) noexcept;
+
+        /// Queues a record for a running sink; \c Push does the rest.
+        bool Enqueue(retro_log_level level, std::string_view text, bool flush) noexcept;
+
+        /// Delivers queued records in order until it reaches one that isn't written yet.
+        /// @returns The number of records delivered.
+        size_t Drain() noexcept;
+
+        /// Waits until the record with \c ticket has been delivered.
+        void WaitFor(size_t ticket) noexcept;
+
+        std::array<Slot, CAPACITY> _slots;
+        alignas(64) std::atomic<size_t> _tail = 0;
+        alignas(64) size_t _head = 0; // Guarded by _drainLock
+        std::atomic<size_t> _delivered = 0;
+        std::atomic<retro_log_printf_t> _log = nullptr;
+        std::atomic_bool _running = false;
+        std::atomic_bool _sleeping = false;
+        // Threads inside Push; Stop waits for them so that no record is queued after its final flush
+        std::atomic<size_t> _pushers = 0;
+        std::atomic<uint64_t> _queued = 0;
+        std::atomic<uint64_t> _oversized = 0;
+        std::atomic<uint64_t> _stalls = 0;
+        slock_t* _drainLock = nullptr;
+        slock_t* _wakeLock = nullptr;
+        scond_t* _wake = nullptr;
+        sthread_t* _thread = nullptr;
+    };
+}
+
+#endif // MELONDS_DS_LOGSINK_HPP
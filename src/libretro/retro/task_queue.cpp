@@ -23,6 +23,7 @@
 #include <retro_assert.h>
 
 #include "tracy.hpp"
+#include "tracy/memory.hpp"
 
 using std::string_view;
 
@@ -125,6 +126,7 @@ void retro::task::check() noexcept {
 
 void retro::task::TaskSpec::TaskHandlerWrapper(retro_task_t* task) noexcept {
     ZoneScopedN(TracyFunction);
+    MelonDsDs::MemoryScope memory(MelonDsDs::MemoryTag::Config);
     retro_assert(task != nullptr);
     TaskFunctions* functions = static_cast<TaskFunctions*>(task->user_data);
 
@@ -0,0 +1,254 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include "threadpool.hpp"
+
+#include <climits>
+
+#include <fmt/format.h>
+#include <retro_assert.h>
+
+#if defined(__linux__) && !defined(__ANDROID__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+#include "environment.hpp"
+#include "tracy.hpp"
+
+using retro::ThreadPool;
+
+namespace {
+    ThreadPool* currentPool = nullptr;
+
+    // The worker that the calling thread belongs to, if any
+    thread_local unsigned currentWorker = UINT32_MAX;
+    thread_local const ThreadPool* currentWorkerPool = nullptr;
+
+    void PinCurrentThread(unsigned cpu, const std::string& name) noexcept {
+#if defined(__linux__) && !defined(__ANDROID__)
+        if (cpu >= CPU_SETSIZE) {
+            retro::warn("Couldn't pin {} to CPU {} (only the first {} CPUs can be pinned to)", name, cpu, CPU_SETSIZE);
+            return;
+        }
+
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        if (int error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus); error != 0) {
+            retro::warn("Couldn't pin {} to CPU {} (error {})", name, cpu, error);
+        }
+#elif defined(_WIN32)
+        if (cpu >= sizeof(DWORD_PTR) * CHAR_BIT) {
+            // An affinity mask only covers the CPUs in the thread's processor group
+            retro::warn("Couldn't pin {} to CPU {} (only the first {} CPUs can be pinned to)", name, cpu, sizeof(DWORD_PTR) * CHAR_BIT);
+            return;
+        }
+
+        if (SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) == 0) {
+            retro::warn("Couldn't pin {} to CPU {} (error {})", name, cpu, GetLastError());
+        }
+#else
+        retro::warn("Thread affinity isn't supported on this platform, not pinning {} to CPU {}", name, cpu);
+#endif
+    }
+}
+
+ThreadPool::ThreadPool([[maybe_unused]] unsigned size, [[maybe_unused]] std::span<const unsigned> affinity) noexcept {
+    ZoneScopedN(TracyFunction);
+    retro_assert(currentPool == nullptr);
+    currentPool = this;
+
+#ifdef HAVE_THREADS
+    _sleepLock = slock_new();
+    _wake = scond_new();
+    if (!_sleepLock || !_wake) {
+        retro::warn("Couldn't initialize the worker thread pool; background work will run inline");
+        return;
+    }
+
+    _workers.reserve(size);
+    for (unsigned i = 0; i < size; ++i) {
+        auto worker = std::make_unique<Worker>(Worker {
+            .Pool = this,
+            .Index = i,
+            .Cpu = affinity.empty() ? std::nullopt : std::make_optional(affinity[i % affinity.size()]),
+            .Name = fmt::format("melonDS DS Worker {}", i),
+        });
+
+        worker->Lock = slock_new();
+        if (!worker->Lock)
+            break;
+
+        _workers.push_back(std::move(worker));
+    }
+
+    // Workers steal from each other as soon as they start,
+    // so the list can't change once the first one is running
+    for (auto& worker : _workers) {
+        worker->Thread = sthread_create(WorkerThread, worker.get());
+        if (!worker->Thread)
+            break;
+
+        ++_started;
+    }
+
+    if (_started < size) {
+        retro::warn("Only started {} of {} worker threads", _started, size);
+    }
+    else {
+        retro::debug("Started {} worker threads", _started);
+    }
+#endif
+}
+
+ThreadPool::~ThreadPool() noexcept {
+    ZoneScopedN(TracyFunction);
+
+    if (_started > 0) {
+        for (auto& worker : _workers) {
+            slock_lock(worker->Lock);
+            _pending -= worker->Jobs.size();
+            worker->Jobs.clear();
+            slock_unlock(worker->Lock);
+        }
+
+        slock_lock(_sleepLock);
+        _stopping = true;
+        scond_broadcast(_wake);
+        slock_unlock(_sleepLock);
+
+        for (auto& worker : _workers) {
+            if (worker->Thread) {
+                sthread_join(worker->Thread);
+            }
+        }
+    }
+
+    for (auto& worker : _workers) {
+        slock_free(worker->Lock);
+    }
+    _workers.clear();
+
+    if (_wake) {
+        scond_free(_wake);
+    }
+
+    if (_sleepLock) {
+        slock_free(_sleepLock);
+    }
+
+    retro_assert(currentPool == this);
+    currentPool = nullptr;
+}
+
+ThreadPool* ThreadPool::Current() noexcept {
+    return currentPool;
+}
+
+bool ThreadPool::Submit(std::function<void()>& job) noexcept {
+    if (_started == 0)
+        return false;
+
+    // Jobs submitted by a worker (e.g. a load that starts other loads) stay on that worker's queue,
+    // where they're likely to run next while their inputs are still in its cache
+    unsigned index = (currentWorkerPool == this)
+        ? currentWorker
+        : _nextWorker.fetch_add(1, std::memory_order_relaxed) % _started;
+
+    // Counted before it's queued so that a worker never sees more jobs than _pending says there are
+    _pending.fetch_add(1, std::memory_order_relaxed);
+    Worker& worker = *_workers[index];
+    slock_lock(worker.Lock);
+    worker.Jobs.push_back(std::move(job));
+    slock_unlock(worker.Lock);
+
+    slock_lock(_sleepLock);
+    scond_signal(_wake);
+    slock_unlock(_sleepLock);
+    return true;
+}
+
+bool ThreadPool::TryPop(Worker& worker, std::function<void()>& job) noexcept {
+    // Workers take their newest job first...
+    slock_lock(worker.Lock);
+    bool found = !worker.Jobs.empty();
+    if (found) {
+        job = std::move(worker.Jobs.back());
+        worker.Jobs.pop_back();
+    }
+    slock_unlock(worker.Lock);
+    return found;
+}
+
+bool ThreadPool::TrySteal(const Worker& thief, std::function<void()>& job) noexcept {
+    // ...and steal the oldest jobs from other workers
+    for (size_t offset = 1; offset < _workers.size(); ++offset) {
+        Worker& victim = *_workers[(thief.Index + offset) % _workers.size()];
+        slock_lock(victim.Lock);
+        bool found = !victim.Jobs.empty();
+        if (found) {
+            job = std::move(victim.Jobs.front());
+            victim.Jobs.pop_front();
+        }
+        slock_unlock(victim.Lock);
+
+        if (found)
+            return true;
+    }
+
+    return false;
+}
+
+void ThreadPool::WorkerThread(void* data) noexcept {
+    Worker& worker = *static_cast<Worker*>(data);
+    ThreadPool& pool = *worker.Pool;
+    currentWorker = worker.Index;
+    currentWorkerPool = &pool;
+#ifdef HAVE_TRACY
+    tracy::SetThreadName(worker.Name.c_str());
+#elif defined(HAVE_TRACE_RECORDER)
+    MelonDsDs::trace::SetThreadName(worker.Name.c_str());
+#endif
+
+    if (worker.Cpu) {
+        PinCurrentThread(*worker.Cpu, worker.Name);
+    }
+
+    std::function<void()> job;
+    while (true) {
+        if (pool.TryPop(worker, job) || pool.TrySteal(worker, job)) {
+            pool._pending.fetch_sub(1, std::memory_order_relaxed);
+            job();
+            job = nullptr;
+            continue;
+        }
+
+        slock_lock(pool._sleepLock);
+        while (!pool._stopping && pool._pending.load(std::memory_order_relaxed) == 0) {
+            scond_wait(pool._wake, pool._sleepLock);
+        }
+        bool stopping = pool._stopping;
+        slock_unlock(pool._sleepLock);
+
+        if (stopping)
+            break;
+    }
+
+    currentWorkerPool = nullptr;
+}
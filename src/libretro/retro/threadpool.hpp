@@ -0,0 +1,88 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef MELONDS_DS_THREADPOOL_HPP
+#define MELONDS_DS_THREADPOOL_HPP
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <rthreads/rthreads.h>
+
+#include "std/span.hpp"
+
+namespace retro {
+    /// A fixed set of worker threads that the core's background work runs on,
+    /// so that loading a game doesn't create and destroy a thread for each file.
+    ///
+    /// Each worker has its own queue; jobs submitted from a worker go to that worker's queue,
+    /// and idle workers steal from the others' queues.
+    /// Only one pool is current at a time, and \c retro::future submits its work to it.
+    class ThreadPool {
+    public:
+        /// Starts \c size workers.
+        /// If \c affinity isn't empty, worker \c i is pinned to CPU <tt>affinity[i % affinity.size()]</tt>.
+        /// Becomes the current pool.
+        ThreadPool(unsigned size, std::span<const unsigned> affinity) noexcept;
+
+        /// Discards any jobs that haven't started, then stops the workers.
+        ~ThreadPool() noexcept;
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool(ThreadPool&&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+        ThreadPool& operator=(ThreadPool&&) = delete;
+
+        /// @returns The pool that \c retro::future runs its work on, or \c nullptr if there isn't one.
+        [[nodiscard]] static ThreadPool* Current() noexcept;
+
+        /// Queues \c job to run on one of the workers.
+        /// Jobs that haven't started when the pool is destroyed are dropped without running.
+        /// @returns \c false if there are no workers, in which case \c job is left untouched.
+        bool Submit(std::function<void()>& job) noexcept;
+
+        [[nodiscard]] unsigned Size() const noexcept { return _started; }
+    private:
+        struct Worker {
+            ThreadPool* Pool;
+            unsigned Index;
+            std::optional<unsigned> Cpu;
+            std::string Name;
+            sthread_t* Thread = nullptr;
+            slock_t* Lock = nullptr;
+            std::deque<std::function<void()>> Jobs {};
+        };
+
+        static void WorkerThread(void* worker) noexcept;
+        bool TryPop(Worker& worker, std::function<void()>& job) noexcept;
+        bool TrySteal(const Worker& thief, std::function<void()>& job) noexcept;
+
+        std::vector<std::unique_ptr<Worker>> _workers {};
+        // Workers past this index couldn't be started
+        unsigned _started = 0;
+        slock_t* _sleepLock = nullptr;
+        scond_t* _wake = nullptr;
+        std::atomic_size_t _pending = 0;
+        std::atomic_uint _nextWorker = 0;
+        bool _stopping = false;
+    };
+}
+
+#endif //MELONDS_DS_THREADPOOL_HPP
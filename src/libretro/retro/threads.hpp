@@ -18,9 +18,18 @@
 #ifndef MELONDS_DS_THREADS_HPP
 #define MELONDS_DS_THREADS_HPP
 
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
 #include <stdexcept>
+#include <utility>
 #include <rthreads/rthreads.h>
 
+#include "environment.hpp"
+#include "threadpool.hpp"
+
 namespace retro {
     class slock {
     public:
@@ -36,6 +45,153 @@ namespace retro {
     private:
         slock_t* mutex;
     };
+
+    /// Runs a function on the current \c ThreadPool and holds onto its result (or exception) until \c get is called.
+    /// If there's no pool (or it has no workers), the function runs on the calling thread.
+    /// If no worker has picked up the function by the time \c get or \c wait needs it,
+    /// the waiting thread runs it instead, so futures can safely wait on other futures.
+    /// The destructor drops the function if no worker has started it yet,
+    /// or else waits for it to finish;
+    /// either way, it's safe to capture locals by reference if the \c future is declared after them.
+    /// Whatever the function logs is held until then and delivered on the waiting thread,
+    /// so that worker threads never call the frontend's log callback.
+    template <typename T>
+    class future {
+    public:
+        template <typename F>
+        explicit future(F&& fn) : _state(std::make_shared<State>(std::forward<F>(fn))) {
+#ifdef HAVE_THREADS
+            if (ThreadPool* pool = ThreadPool::Current()) {
+                // The job holds its own reference to the state,
+                // since it may not be dequeued until after this future is gone
+                std::function<void()> job = [state = _state] { state->TryRun(); };
+                if (pool->Submit(job))
+                    return;
+            }
+#endif
+            _state->TryRun();
+        }
+
+        future(const future&) = delete;
+        future(future&&) = delete;
+        future& operator=(const future&) = delete;
+        future& operator=(future&&) = delete;
+
+        ~future() noexcept {
+            if (!_state->TryAbandon()) {
+                // If a worker is already running the function (or it's done)...
+                wait();
+            }
+        }
+
+        /// Returns \c true if the function has finished, without waiting for it.
+        [[nodiscard]] bool ready() const noexcept {
+            return _state->Status.load(std::memory_order_acquire) == DONE;
+        }
+
+        void wait() noexcept {
+            if (_state->TryRun()) {
+                // No worker had started the function yet, so we just ran it ourselves
+                _state->Logs.Replay();
+                return;
+            }
+
+#ifdef HAVE_THREADS
+            slock_lock(_state->Lock);
+            while (_state->Status.load(std::memory_order_acquire) != DONE) {
+                scond_wait(_state->Done, _state->Lock);
+            }
+            slock_unlock(_state->Lock);
+#endif
+            _state->Logs.Replay();
+        }
+
+        /// Waits for the function to finish, then returns its result or rethrows its exception.
+        /// Must only be called once.
+        T get() {
+            wait();
+            if (_state->Error) {
+                std::rethrow_exception(std::exchange(_state->Error, nullptr));
+            }
+
+            return std::move(*_state->Value);
+        }
+    private:
+        enum : int { QUEUED, RUNNING, DONE };
+
+        struct State {
+            template <typename F>
+            explicit State(F&& fn) : Fn(std::forward<F>(fn)) {
+                Lock = slock_new();
+#ifdef HAVE_THREADS
+                Done = scond_new();
+#endif
+            }
+
+            State(const State&) = delete;
+            State& operator=(const State&) = delete;
+
+            ~State() noexcept {
+                if (Done) {
+                    scond_free(Done);
+                }
+
+                if (Lock) {
+                    slock_free(Lock);
+                }
+            }
+
+            // Runs the function if nobody else has started it.
+            // Returns false if it was already started (or finished) elsewhere.
+            bool TryRun() noexcept {
+                int expected = QUEUED;
+                if (!Status.compare_exchange_strong(expected, RUNNING, std::memory_order_acq_rel))
+                    return false;
+
+                {
+                    ScopedLogCapture capture(Logs);
+                    try {
+                        Value.emplace(Fn());
+                    }
+                    catch (...) {
+                        Error = std::current_exception();
+                    }
+                    Fn = nullptr; // Release anything the function captured
+                }
+
+                slock_lock(Lock);
+                Status.store(DONE, std::memory_order_release);
+#ifdef HAVE_THREADS
+                scond_broadcast(Done);
+#endif
+                slock_unlock(Lock);
+                return true;
+            }
+
+            // Marks the function as done without running it, if nobody has started it.
+            // Returns false if it was already started (or finished) elsewhere.
+            bool TryAbandon() noexcept {
+                int expected = QUEUED;
+                if (!Status.compare_exchange_strong(expected, DONE, std::memory_order_acq_rel))
+                    return false;
+
+                // The queued job still holds the state, but it won't touch Fn now
+                Fn = nullptr;
+                return true;
+            }
+
+            std::function<T()> Fn;
+            std::optional<T> Value;
+            std::exception_ptr Error;
+            // Only touched by whoever runs the function, then by whoever waits for it
+            LogBuffer Logs;
+            slock_t* Lock = nullptr;
+            scond_t* Done = nullptr;
+            std::atomic_int Status = QUEUED;
+        };
+
+        std::shared_ptr<State> _state;
+    };
 }
 
 #endif //MELONDS_DS_THREADS_HPP
@@ -23,6 +23,7 @@
 
 #include <GPU3D.h>
 
+#include <glm/common.hpp>
 #include <glm/gtx/matrix_transform_2d.hpp>
 #include <retro_assert.h>
 
@@ -44,6 +45,15 @@ using glm::mat3;
 
 MelonDsDs::ScreenLayoutData::ScreenLayoutData() :
     _dirty(true), // Uninitialized
+    _geometriesStale(true),
+    _generation(0),
+    _geometries(),
+    _maxBufferSize(0),
+    _maxOutputSize(0),
+    _maxHybridBufferSize(0),
+    _rotationMethod(ScreenRotationMethod::Auto),
+    _frontendCantRotate(false),
+    _coreRotation(0),
     orientation(retro::ScreenOrientation::Normal),
     joystickMatrix(1), // Identity matrix
     topScreenMatrix(1),
@@ -52,7 +62,9 @@ MelonDsDs::ScreenLayoutData::ScreenLayoutData() :
     hybridScreenMatrix(1),
     pointerMatrix(1),
     hybridRatio(2),
-    _numberOfLayouts(1) {
+    _layoutIndex(0),
+    _numberOfLayouts(1),
+    _layouts() {
 }
 
 MelonDsDs::ScreenLayoutData::~ScreenLayoutData() noexcept {
@@ -153,9 +165,8 @@ constexpr mat3 FlippedHybridSouthwestMatrix(unsigned resolutionScale, unsigned h
     );
 }
 
-mat3 MelonDsDs::ScreenLayoutData::GetTopScreenMatrix(unsigned scale) const noexcept {
-    ZoneScopedN(TracyFunction);
-    switch (Layout()) {
+mat3 MelonDsDs::ScreenLayoutData::GetTopScreenMatrix(ScreenLayout layout, unsigned scale) const noexcept {
+    switch (layout) {
         case ScreenLayout::TopBottom:
         case ScreenLayout::TopOnly:
         case ScreenLayout::LeftRight:
@@ -186,9 +197,8 @@ mat3 MelonDsDs::ScreenLayoutData::GetTopScreenMatrix(unsigned scale) const noexc
     }
 }
 
-mat3 MelonDsDs::ScreenLayoutData::GetBottomScreenMatrix(unsigned scale) const noexcept {
-    ZoneScopedN(TracyFunction);
-    switch (Layout()) {
+mat3 MelonDsDs::ScreenLayoutData::GetBottomScreenMatrix(ScreenLayout layout, unsigned scale) const noexcept {
+    switch (layout) {
         case ScreenLayout::TopBottom:
         case ScreenLayout::TurnLeft:
         case ScreenLayout::TurnRight:
@@ -219,9 +229,8 @@ mat3 MelonDsDs::ScreenLayoutData::GetBottomScreenMatrix(unsigned scale) const no
     }
 }
 
-glm::mat3 MelonDsDs::ScreenLayoutData::GetHybridScreenMatrix(unsigned scale) const noexcept {
-    ZoneScopedN(TracyFunction);
-    switch (Layout()) {
+glm::mat3 MelonDsDs::ScreenLayoutData::GetHybridScreenMatrix(ScreenLayout layout, unsigned scale) const noexcept {
+    switch (layout) {
         case ScreenLayout::HybridBottom:
         case ScreenLayout::HybridTop:
             return HybridWestMatrix(scale, hybridRatio);
@@ -235,20 +244,21 @@ glm::mat3 MelonDsDs::ScreenLayoutData::GetHybridScreenMatrix(unsigned scale) con
 
 void MelonDsDs::ScreenLayoutData::Apply(const CoreConfig& config, const RenderStateWrapper& renderState) noexcept {
 #if defined(HAVE_OPENGL) || defined(HAVE_OPENGLES)
-    SetScale(renderState.GetRenderMode() == RenderMode::Software ? 1 : config.ScaleFactor());
+    // The software renderer's screens are always native resolution, even when they're composited with OpenGL
+    bool nativeScale = renderState.GetRenderMode() == RenderMode::Software || config.ConfiguredRenderer() == RenderMode::Software;
+    SetScale(nativeScale ? 1 : config.ScaleFactor());
 #else
     SetScale(1);
 #endif
     SetLayouts(config.ScreenLayouts());
     HybridSmallScreenLayout(config.SmallScreenLayout());
     ScreenGap(config.ScreenGap());
+    RotationMethod(config.ScreenRotation());
     HybridRatio(config.HybridRatio());
     Update();
 }
 
-void MelonDsDs::ScreenLayoutData::Update() noexcept {
-    ZoneScopedN(TracyFunction);
-
+MelonDsDs::ScreenLayoutData::LayoutGeometry MelonDsDs::ScreenLayoutData::ComputeGeometry(ScreenLayout layout) const noexcept {
     // These points represent the NDS screen coordinates without transformations
     constexpr array<vec2, 4> baseScreenPoints = {
         vec2(0, 0), // northwest
@@ -257,16 +267,22 @@ void MelonDsDs::ScreenLayoutData::Update() noexcept {
         vec2(0, NDS_SCREEN_HEIGHT) // southwest
     };
 
+    LayoutGeometry geometry;
+    geometry.Layout = layout;
+
     // Get the matrices we'll be using
     // (except the pointer matrix, we need to compute the buffer size first)
-    topScreenMatrix = GetTopScreenMatrix(resolutionScale);
-    bottomScreenMatrix = GetBottomScreenMatrix(resolutionScale);
-    hybridScreenMatrix = GetHybridScreenMatrix(resolutionScale);
-    hybridScreenMatrixInverse = inverse(hybridScreenMatrix);
-    bottomScreenMatrixInverse = inverse(bottomScreenMatrix);
+    const mat3 topScreenMatrix = GetTopScreenMatrix(layout, resolutionScale);
+    const mat3 bottomScreenMatrix = GetBottomScreenMatrix(layout, resolutionScale);
+    const mat3 hybridScreenMatrix = GetHybridScreenMatrix(layout, resolutionScale);
+    geometry.TopScreenMatrix = topScreenMatrix;
+    geometry.BottomScreenMatrix = bottomScreenMatrix;
+    geometry.HybridScreenMatrix = hybridScreenMatrix;
+    geometry.HybridScreenMatrixInverse = inverse(hybridScreenMatrix);
+    geometry.BottomScreenMatrixInverse = inverse(bottomScreenMatrix);
 
     // Transform the base screen points
-    transformedScreenPoints = {
+    geometry.TransformedScreenPoints = {
         topScreenMatrix * vec3(baseScreenPoints[0], 1),
         topScreenMatrix * vec3(baseScreenPoints[1], 1),
         topScreenMatrix * vec3(baseScreenPoints[2], 1),
@@ -282,47 +298,116 @@ void MelonDsDs::ScreenLayoutData::Update() noexcept {
     };
 
     // We need to compute the buffer size to use it for rendering and the touch screen
-    bufferSize = uvec2(0);
-    for (const vec2& p : transformedScreenPoints) {
+    uvec2 bufferSize = uvec2(0);
+    for (const vec2& p : geometry.TransformedScreenPoints) {
         bufferSize.x = max<unsigned>(bufferSize.x, p.x);
         bufferSize.y = max<unsigned>(bufferSize.y, p.y);
     }
 
-    topScreenTranslation = transformedScreenPoints[0];
-    bottomScreenTranslation = transformedScreenPoints[4];
-    hybridScreenTranslation = transformedScreenPoints[8];
-    pointerMatrix = math::ts<float>(vec2(bufferSize) / 2.0f, vec2(bufferSize) / (2.0f * RETRO_MAX_POINTER_COORDINATE<float>));
+    geometry.BufferSize = bufferSize;
+    geometry.TopScreenTranslation = geometry.TransformedScreenPoints[0];
+    geometry.BottomScreenTranslation = geometry.TransformedScreenPoints[4];
+    geometry.HybridScreenTranslation = geometry.TransformedScreenPoints[8];
+    geometry.PointerMatrix = math::ts<float>(vec2(bufferSize) / 2.0f, vec2(bufferSize) / (2.0f * RETRO_MAX_POINTER_COORDINATE<float>));
+
+    return geometry;
+}
+
+void MelonDsDs::ScreenLayoutData::PrecomputeGeometries() noexcept {
+    ZoneScopedN(TracyFunction);
+    _maxBufferSize = uvec2(0);
+    _maxOutputSize = uvec2(0);
+    _maxHybridBufferSize = uvec2(0);
+    for (unsigned i = 0; i < _numberOfLayouts; ++i) {
+        _geometries[i] = ComputeGeometry(_layouts[i]);
+        uvec2 size = _geometries[i].BufferSize;
+        _maxBufferSize = glm::max(_maxBufferSize, size);
+        _maxOutputSize = glm::max(_maxOutputSize, size);
+        if (_rotationMethod != ScreenRotationMethod::Frontend && (_layouts[i] == ScreenLayout::TurnLeft || _layouts[i] == ScreenLayout::TurnRight)) {
+            // We won't know until we get there if the frontend can rotate this layout, so make room for either
+            _maxOutputSize = glm::max(_maxOutputSize, uvec2(size.y, size.x));
+        }
+        if (IsHybridLayout(_layouts[i]) || IsLargeScreenLayout(_layouts[i])) {
+            _maxHybridBufferSize = NDS_SCREEN_SIZE<unsigned> * hybridRatio;
+        }
+    }
+
+    ++_generation;
+    _geometriesStale = false;
+}
+
+void MelonDsDs::ScreenLayoutData::Update() noexcept {
+    ZoneScopedN(TracyFunction);
+
+    if (_geometriesStale) {
+        // If any option that the layouts depend on has changed since we last computed them...
+        PrecomputeGeometries();
+    }
+
+    const LayoutGeometry& geometry = _geometries[_layoutIndex];
+    retro_assert(geometry.Layout == Layout());
+    transformedScreenPoints = geometry.TransformedScreenPoints;
+    topScreenMatrix = geometry.TopScreenMatrix;
+    bottomScreenMatrix = geometry.BottomScreenMatrix;
+    bottomScreenMatrixInverse = geometry.BottomScreenMatrixInverse;
+    hybridScreenMatrix = geometry.HybridScreenMatrix;
+    hybridScreenMatrixInverse = geometry.HybridScreenMatrixInverse;
+    pointerMatrix = geometry.PointerMatrix;
+    topScreenTranslation = geometry.TopScreenTranslation;
+    bottomScreenTranslation = geometry.BottomScreenTranslation;
+    hybridScreenTranslation = geometry.HybridScreenTranslation;
+    bufferSize = geometry.BufferSize;
 
     ScreenLayout layout = Layout();
     retro::ScreenOrientation newOrientation = LayoutOrientation(layout);
 
-    if (retro::set_screen_rotation(newOrientation)) {
-        // Try to rotate the screen. If that failed...
-        pointerMatrix = glm::rotate(pointerMatrix, LayoutAngle(layout));
-        orientation = newOrientation;
+    bool rotated = false;
+    if (RotatesInCore()) {
+        // If we're rotating the screen ourselves, make sure the frontend isn't doing it too
+        retro::set_screen_rotation(retro::ScreenOrientation::Normal);
+        rotated = true;
+    } else if (retro::set_screen_rotation(newOrientation)) {
+        rotated = true;
     } else if (newOrientation != retro::ScreenOrientation::Normal) {
         // A rotation to normal orientation may "fail", even though it's the default.
-        // So only log an error if we're trying to rotate to something besides 0 degrees.
-        retro::set_error_message("Failed to rotate screen.");
+        // So only fall back (or log an error) if we're trying to rotate to something besides 0 degrees.
+        if (_rotationMethod == ScreenRotationMethod::Auto) {
+            // The frontend won't be able to rotate any other layout either,
+            // so the renderers must redo every layout's geometry with the rotation baked in
+            retro::info("Frontend can't rotate the screen; rotating it in the core instead");
+            _frontendCantRotate = true;
+            ++_generation;
+            rotated = true;
+        } else {
+            retro::set_error_message("Failed to rotate screen.");
+        }
+    }
+
+    _coreRotation = CoreRotation(_layoutIndex);
+    if (rotated) {
+        // Either way, the pointer's coordinates are relative to the rotated image
+        pointerMatrix = glm::rotate(pointerMatrix, LayoutAngle(layout));
+        orientation = newOrientation;
     }
 
     _dirty = false;
 }
 
-retro_game_geometry MelonDsDs::ScreenLayoutData::Geometry(RenderMode renderer) const noexcept {
+retro_game_geometry MelonDsDs::ScreenLayoutData::Geometry([[maybe_unused]] RenderMode renderer) const noexcept {
+    // Only as big as the configured layouts need (rather than the biggest any configuration could need),
+    // so the frontend doesn't allocate a huge framebuffer that we'll never fill.
+    // Switching between these layouts never exceeds it; changing the layouts may (see CoreState::Run).
+    uvec2 maxSize = glm::max(_maxOutputSize, OutputSize());
     retro_game_geometry geometry {
-        .base_width = BufferWidth(),
-        .base_height = BufferHeight(),
-        .max_width = MaxSoftwareRenderedWidth(),
-        .max_height = MaxSoftwareRenderedHeight(),
+        .base_width = OutputWidth(),
+        .base_height = OutputHeight(),
+        .max_width = maxSize.x,
+        .max_height = maxSize.y,
         .aspect_ratio = BufferAspectRatio(),
     };
 
 #if defined(HAVE_OPENGL) || defined(HAVE_OPENGLES)
-    if (renderer == RenderMode::OpenGl) {
-        geometry.max_width = MaxOpenGlRenderedWidth();
-        geometry.max_height = MaxOpenGlRenderedHeight();
-    }
+    retro_assert(renderer != RenderMode::OpenGl || (maxSize.x <= MaxOpenGlRenderedWidth() && maxSize.y <= MaxOpenGlRenderedHeight()));
 #endif
     static_assert(MaxSoftwareRenderedWidth() > 0);
     static_assert(MaxSoftwareRenderedHeight() > 0);
@@ -97,6 +97,18 @@ namespace MelonDsDs {
         }
     }
 
+    constexpr retro::ScreenOrientation LayoutOrientation(ScreenLayout layout) noexcept {
+        switch (layout) {
+            case ScreenLayout::TurnLeft:
+                return retro::ScreenOrientation::RotatedLeft;
+            case ScreenLayout::TurnRight:
+                return retro::ScreenOrientation::RotatedRight;
+            case ScreenLayout::UpsideDown:
+                return retro::ScreenOrientation::UpsideDown;
+            default:
+                return retro::ScreenOrientation::Normal;
+        }
+    }
 
     class ScreenLayoutData {
     public:
@@ -104,6 +116,9 @@ namespace MelonDsDs {
         ~ScreenLayoutData() noexcept;
 
         void Apply(const CoreConfig& config, const RenderStateWrapper& renderState) noexcept;
+
+        /// Switches to the active layout's precomputed geometry,
+        /// recomputing every configured layout's geometry first if any of their parameters changed.
         void Update() noexcept;
 
         void SetDirty() noexcept { _dirty = true; }
@@ -118,6 +133,29 @@ namespace MelonDsDs {
         /// The size of the image necessary to hold this layout, in pixels
         glm::uvec2 BufferSize() const noexcept { return bufferSize; }
 
+        /// How many quarter turns counter-clockwise the core must rotate each frame before sending it,
+        /// or 0 if the frontend is rotating the screen (or no rotation is needed).
+        unsigned CoreRotation() const noexcept { return _coreRotation; }
+
+        /// \c CoreRotation for the configured layout at \c index.
+        unsigned CoreRotation(unsigned index) const noexcept {
+            return RotatesInCore() ? static_cast<unsigned>(LayoutOrientation(_layouts[index])) : 0;
+        }
+
+        /// The size of the image sent to the frontend for the configured layout at \c index, as of the last \c Update.
+        glm::uvec2 OutputSize(unsigned index) const noexcept {
+            glm::uvec2 size = _geometries[index].BufferSize;
+            return CoreRotation(index) % 2 ? glm::uvec2(size.y, size.x) : size;
+        }
+
+        /// The size of the image sent to the frontend, in pixels.
+        /// Same as \c BufferSize unless the core is turning the screen sideways.
+        glm::uvec2 OutputSize() const noexcept {
+            return _coreRotation % 2 ? glm::uvec2(bufferSize.y, bufferSize.x) : bufferSize;
+        }
+        unsigned OutputWidth() const noexcept { return OutputSize().x; }
+        unsigned OutputHeight() const noexcept { return OutputSize().y; }
+
         float BufferAspectRatio() const noexcept {
             switch (Layout()) {
                 case ScreenLayout::TurnLeft:
@@ -131,16 +169,14 @@ namespace MelonDsDs {
         unsigned LayoutIndex() const noexcept { return _layoutIndex; }
         unsigned NumberOfLayouts() const noexcept { return _numberOfLayouts; }
         ScreenLayout Layout() const noexcept { return _layouts[_layoutIndex]; }
-        void SetLayouts(const std::array<ScreenLayout, config::screen::MAX_SCREEN_LAYOUTS>& layouts, unsigned numberOfLayouts) noexcept {
-            ScreenLayout oldLayout = Layout();
+        ScreenLayout Layout(unsigned index) const noexcept { return _geometries[index].Layout; }
 
-            if (_layoutIndex >= numberOfLayouts) {
-                _layoutIndex = numberOfLayouts - 1;
-            }
-            _layouts = layouts;
-            _numberOfLayouts = numberOfLayouts;
+        /// Incremented whenever the configured layouts' geometry is recomputed.
+        /// If it hasn't changed, then switching layouts only changes \c LayoutIndex.
+        uint32_t Generation() const noexcept { return _generation; }
 
-            if (oldLayout != Layout()) _dirty = true;
+        void SetLayouts(const std::array<ScreenLayout, config::screen::MAX_SCREEN_LAYOUTS>& layouts, unsigned numberOfLayouts) noexcept {
+            SetLayouts(std::span(layouts.data(), numberOfLayouts));
         }
 
         void SetLayouts(const std::span<const ScreenLayout> layouts) noexcept {
@@ -149,6 +185,9 @@ namespace MelonDsDs {
             if (_layoutIndex >= layouts.size()) {
                 _layoutIndex = layouts.size() - 1;
             }
+            if (layouts.size() != _numberOfLayouts || !std::equal(layouts.begin(), layouts.end(), _layouts.begin())) {
+                _geometriesStale = true;
+            }
             memcpy(_layouts.data(), layouts.data(), layouts.size() * sizeof(ScreenLayout));
             _numberOfLayouts = layouts.size();
 
@@ -165,6 +204,7 @@ namespace MelonDsDs {
         HybridSideScreenDisplay HybridSmallScreenLayout() const noexcept { return hybridSmallScreenLayout; }
         void HybridSmallScreenLayout(HybridSideScreenDisplay _layout) noexcept {
             if (IsHybridLayout(Layout()) && _layout != hybridSmallScreenLayout) _dirty = true;
+            if (_layout != hybridSmallScreenLayout) _geometriesStale = true;
             hybridSmallScreenLayout = _layout;
         }
 
@@ -179,21 +219,28 @@ namespace MelonDsDs {
             }
         }
 
+        ScreenRotationMethod RotationMethod() const noexcept { return _rotationMethod; }
+        void RotationMethod(ScreenRotationMethod method) noexcept {
+            if (method != _rotationMethod) _dirty = _geometriesStale = true;
+            _rotationMethod = method;
+        }
+
         unsigned ScreenGap() const noexcept { return screenGap; }
         void ScreenGap(unsigned _screen_gap) noexcept {
-            if (_screen_gap != screenGap) _dirty = true;
+            if (_screen_gap != screenGap) _dirty = _geometriesStale = true;
             screenGap = _screen_gap;
         }
 
         unsigned Scale() const noexcept { return resolutionScale; }
         void SetScale(unsigned _scale) noexcept {
-            if (_scale != resolutionScale) _dirty = true;
+            if (_scale != resolutionScale) _dirty = _geometriesStale = true;
             resolutionScale = _scale;
         }
 
         unsigned HybridRatio() const noexcept { return hybridRatio; }
         void HybridRatio(unsigned _hybrid_ratio) noexcept {
             if (IsHybridLayout(Layout()) && _hybrid_ratio != hybridRatio) _dirty = true;
+            if (_hybrid_ratio != hybridRatio) _geometriesStale = true;
             hybridRatio = _hybrid_ratio;
         }
 
@@ -221,6 +268,27 @@ namespace MelonDsDs {
             return transformedScreenPoints;
         }
 
+        /// The transformed screen points of the configured layout at \c index, as of the last \c Update.
+        [[nodiscard]] const std::array<glm::vec2, 12>& TransformedScreenPoints(unsigned index) const noexcept {
+            return _geometries[index].TransformedScreenPoints;
+        }
+
+        /// The buffer size of the configured layout at \c index, as of the last \c Update.
+        [[nodiscard]] glm::uvec2 BufferSize(unsigned index) const noexcept {
+            return _geometries[index].BufferSize;
+        }
+
+        /// The largest buffer that any configured layout needs, as of the last \c Update.
+        /// Buffers this big never have to be resized when switching layouts.
+        [[nodiscard]] glm::uvec2 MaxBufferSize() const noexcept { return _maxBufferSize; }
+
+        /// The largest image that any configured layout may send to the frontend, as of the last \c Update.
+        /// Accounts for sideways layouts that the core may have to rotate itself.
+        [[nodiscard]] glm::uvec2 MaxOutputSize() const noexcept { return _maxOutputSize; }
+
+        /// The size of the upscaled hybrid screen if any configured layout needs one, or 0 if none do.
+        [[nodiscard]] glm::uvec2 MaxHybridBufferSize() const noexcept { return _maxHybridBufferSize; }
+
         [[nodiscard]] retro_game_geometry Geometry(RenderMode renderer) const noexcept;
 
         [[nodiscard]] retro::ScreenOrientation EffectiveOrientation() const noexcept { return orientation; }
@@ -229,11 +297,44 @@ namespace MelonDsDs {
         [[nodiscard]] glm::uvec2 GetBottomScreenTranslation() const noexcept { return bottomScreenTranslation; }
         [[nodiscard]] glm::uvec2 GetHybridScreenTranslation() const noexcept { return hybridScreenTranslation; }
     private:
-        glm::mat3 GetTopScreenMatrix(unsigned scale) const noexcept;
-        glm::mat3 GetBottomScreenMatrix(unsigned scale) const noexcept;
-        glm::mat3 GetHybridScreenMatrix(unsigned scale) const noexcept;
+        /// Everything about a layout that only depends on the layout options,
+        /// so it can be computed ahead of time for each configured layout.
+        struct LayoutGeometry {
+            ScreenLayout Layout;
+            std::array<glm::vec2, 12> TransformedScreenPoints;
+            glm::mat3 TopScreenMatrix;
+            glm::mat3 BottomScreenMatrix;
+            glm::mat3 BottomScreenMatrixInverse;
+            glm::mat3 HybridScreenMatrix;
+            glm::mat3 HybridScreenMatrixInverse;
+            /// Not including the rotation, since that depends on whether the frontend can rotate the screen
+            glm::mat3 PointerMatrix;
+            glm::uvec2 TopScreenTranslation;
+            glm::uvec2 BottomScreenTranslation;
+            glm::uvec2 HybridScreenTranslation;
+            glm::uvec2 BufferSize;
+        };
+
+        glm::mat3 GetTopScreenMatrix(ScreenLayout layout, unsigned scale) const noexcept;
+        glm::mat3 GetBottomScreenMatrix(ScreenLayout layout, unsigned scale) const noexcept;
+        glm::mat3 GetHybridScreenMatrix(ScreenLayout layout, unsigned scale) const noexcept;
+        LayoutGeometry ComputeGeometry(ScreenLayout layout) const noexcept;
+        bool RotatesInCore() const noexcept {
+            return _rotationMethod == ScreenRotationMethod::Core || (_rotationMethod == ScreenRotationMethod::Auto && _frontendCantRotate);
+        }
+        void PrecomputeGeometries() noexcept;
 
         bool _dirty;
+        bool _geometriesStale;
+        uint32_t _generation;
+        std::array<LayoutGeometry, config::screen::MAX_SCREEN_LAYOUTS> _geometries;
+        glm::uvec2 _maxBufferSize;
+        glm::uvec2 _maxOutputSize;
+        glm::uvec2 _maxHybridBufferSize;
+        ScreenRotationMethod _rotationMethod;
+        // Set once the frontend refuses to rotate the screen, so we stop asking
+        bool _frontendCantRotate;
+        unsigned _coreRotation;
         unsigned resolutionScale;
         retro::ScreenOrientation orientation;
         std::array<glm::vec2, 12> transformedScreenPoints;
@@ -291,19 +392,6 @@ namespace MelonDsDs {
         }
     }
 
-    constexpr retro::ScreenOrientation LayoutOrientation(ScreenLayout layout) noexcept {
-        switch (layout) {
-            case ScreenLayout::TurnLeft:
-                return retro::ScreenOrientation::RotatedLeft;
-            case ScreenLayout::TurnRight:
-                return retro::ScreenOrientation::RotatedRight;
-            case ScreenLayout::UpsideDown:
-                return retro::ScreenOrientation::UpsideDown;
-            default:
-                return retro::ScreenOrientation::Normal;
-        }
-    }
-
     constexpr float LayoutAngle(ScreenLayout layout) noexcept {
         switch (layout) {
             case ScreenLayout::TurnLeft:
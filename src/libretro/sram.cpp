@@ -16,11 +16,15 @@
 
 #include "sram.hpp"
 
+#include <algorithm>
+#include <array>
 #include <cstring>
 #include <memory>
 #include <optional>
 #include <string_view>
 
+#include <compat/strl.h>
+#include <encodings/crc32.h>
 #include <file/file_path.h>
 #include <retro_assert.h>
 #include <streams/file_stream.h>
@@ -38,6 +42,7 @@
 #include "environment.hpp"
 #include "exceptions.hpp"
 #include "libretro.hpp"
+#include "retro/file.hpp"
 #include "retro/task_queue.hpp"
 #include "tracy.hpp"
 
@@ -49,6 +54,164 @@ using std::string;
 using std::string_view;
 using namespace melonDS;
 
+namespace {
+    constexpr std::array<char, 8> JOURNAL_MAGIC = {'M', 'D', 'S', 'J', 'R', 'N', 'L', '1'};
+
+    // Offset, length, and CRC32, in the host's byte order (the journal never leaves the machine that wrote it)
+    constexpr size_t JOURNAL_RECORD_HEADER_SIZE = 12;
+
+    uint32_t JournalRecordChecksum(const uint8_t* header, const uint8_t* data, uint32_t length) noexcept {
+        return encoding_crc32(encoding_crc32(0, header, 8), data, length);
+    }
+}
+
+MelonDsDs::sram::SaveJournal::SaveJournal(string&& path, retro::rfile_ptr&& file, uint64_t size) noexcept :
+    _path(std::move(path)),
+    _file(std::move(file)),
+    _size(size) {
+}
+
+optional<MelonDsDs::sram::SaveJournal> MelonDsDs::sram::SaveJournal::Open(string_view savePath) noexcept {
+    ZoneScopedN(TracyFunction);
+    string path = fmt::format("{}.journal", savePath);
+
+    if (path_is_valid(path.c_str())) {
+        // If an earlier session left a journal behind...
+        retro::rfile_ptr file = retro::make_rfile(path, RETRO_VFS_FILE_ACCESS_READ_WRITE | RETRO_VFS_FILE_ACCESS_UPDATE_EXISTING);
+        if (!file) {
+            retro::error("Failed to open save journal \"{}\"", path);
+            return nullopt;
+        }
+
+        int64_t size = filestream_get_size(file.get());
+        return SaveJournal(std::move(path), std::move(file), std::max<int64_t>(size, 0));
+    }
+
+    retro::rfile_ptr file = retro::make_rfile(path, RETRO_VFS_FILE_ACCESS_READ_WRITE);
+    if (!file || filestream_write(file.get(), JOURNAL_MAGIC.data(), JOURNAL_MAGIC.size()) != static_cast<int64_t>(JOURNAL_MAGIC.size())) {
+        retro::error("Failed to create save journal \"{}\"", path);
+        return nullopt;
+    }
+
+    filestream_flush(file.get());
+    return SaveJournal(std::move(path), std::move(file), JOURNAL_MAGIC.size());
+}
+
+std::vector<MelonDsDs::sram::DirtyRange> MelonDsDs::sram::SaveJournal::Replay(std::span<uint8_t> sram) noexcept {
+    ZoneScopedN(TracyFunction);
+    std::vector<DirtyRange> replayed;
+
+    std::array<char, JOURNAL_MAGIC.size()> magic {};
+    if (filestream_seek(_file.get(), 0, RETRO_VFS_SEEK_POSITION_START) < 0 ||
+        filestream_read(_file.get(), magic.data(), magic.size()) != static_cast<int64_t>(magic.size()) ||
+        magic != JOURNAL_MAGIC) {
+        // If this isn't a journal we wrote (or it's empty)...
+        retro::warn("Save journal \"{}\" has no valid header, starting it over", _path);
+        Rewrite();
+        return replayed;
+    }
+
+    uint64_t end = JOURNAL_MAGIC.size();
+    std::vector<uint8_t> data;
+    while (true) {
+        std::array<uint8_t, JOURNAL_RECORD_HEADER_SIZE> header {};
+        if (filestream_read(_file.get(), header.data(), header.size()) != static_cast<int64_t>(header.size()))
+            break;
+
+        uint32_t offset, length, checksum;
+        memcpy(&offset, header.data(), sizeof(offset));
+        memcpy(&length, header.data() + 4, sizeof(length));
+        memcpy(&checksum, header.data() + 8, sizeof(checksum));
+        if (uint64_t(offset) + length > sram.size())
+            break; // Also guards against a corrupt length making us allocate gigabytes
+
+        data.resize(length);
+        if (filestream_read(_file.get(), data.data(), length) != length)
+            break;
+
+        if (JournalRecordChecksum(header.data(), data.data(), length) != checksum)
+            break;
+
+        memcpy(sram.data() + offset, data.data(), length);
+        replayed.push_back({offset, offset + length});
+        end += header.size() + length;
+    }
+
+    if (end < _size) {
+        // If the last record was torn (or something else followed it), drop it so new records aren't appended after garbage
+        retro::warn("Discarding {} bytes of incomplete records at the end of save journal \"{}\"", _size - end, _path);
+        filestream_truncate(_file.get(), end);
+        _size = end;
+    }
+
+    filestream_seek(_file.get(), 0, RETRO_VFS_SEEK_POSITION_END);
+    return replayed;
+}
+
+bool MelonDsDs::sram::SaveJournal::Append(uint32_t offset, std::span<const uint8_t> data) noexcept {
+    ZoneScopedN(TracyFunction);
+    uint32_t length = data.size();
+    std::array<uint8_t, JOURNAL_RECORD_HEADER_SIZE> header {};
+    memcpy(header.data(), &offset, sizeof(offset));
+    memcpy(header.data() + 4, &length, sizeof(length));
+    uint32_t checksum = JournalRecordChecksum(header.data(), data.data(), length);
+    memcpy(header.data() + 8, &checksum, sizeof(checksum));
+
+    if (filestream_seek(_file.get(), _size, RETRO_VFS_SEEK_POSITION_START) < 0 ||
+        filestream_write(_file.get(), header.data(), header.size()) != static_cast<int64_t>(header.size()) ||
+        filestream_write(_file.get(), data.data(), length) != length) {
+        // A partial record fails its checksum, so it's ignored on replay
+        retro::error("Failed to append {}-byte record to save journal \"{}\"", length, _path);
+        return false;
+    }
+
+    // Enough to survive the core crashing, though not necessarily the OS
+    filestream_flush(_file.get());
+    _size += header.size() + length;
+    TracyPlot("Save Journal Size", static_cast<int64_t>(_size));
+    return true;
+}
+
+bool MelonDsDs::sram::SaveJournal::Clear() noexcept {
+    ZoneScopedN(TracyFunction);
+    _compactedSize = nullopt;
+    if (_size == JOURNAL_MAGIC.size())
+        return true;
+
+    uint64_t recordBytes = _size - JOURNAL_MAGIC.size();
+    if (!Rewrite())
+        return false;
+
+    retro::debug("Compacted {} bytes of records out of save journal \"{}\"", recordBytes, _path);
+    return true;
+}
+
+bool MelonDsDs::sram::SaveJournal::Rewrite() noexcept {
+    if (filestream_truncate(_file.get(), 0) != 0 ||
+        filestream_seek(_file.get(), 0, RETRO_VFS_SEEK_POSITION_START) < 0 ||
+        filestream_write(_file.get(), JOURNAL_MAGIC.data(), JOURNAL_MAGIC.size()) != static_cast<int64_t>(JOURNAL_MAGIC.size())) {
+        retro::error("Failed to clear save journal \"{}\"", _path);
+        return false;
+    }
+
+    filestream_flush(_file.get());
+    _size = JOURNAL_MAGIC.size();
+    return true;
+}
+
+void MelonDsDs::sram::SaveJournal::FinishCompaction() noexcept {
+    if (!_compactedSize)
+        return;
+
+    if (*_compactedSize == _size) {
+        Clear();
+    }
+    else {
+        // If the game wrote more since the save file's rewrite began, those records aren't in it yet
+        _compactedSize = nullopt;
+    }
+}
+
 MelonDsDs::sram::SaveManager::SaveManager(u32 initialLength) :
     _sram(std::make_unique<u8[]>(initialLength)),
     _sram_length(initialLength) {
@@ -56,7 +219,10 @@ MelonDsDs::sram::SaveManager::SaveManager(u32 initialLength) :
 
 MelonDsDs::sram::SaveManager::SaveManager(SaveManager&& other) noexcept :
     _sram(std::move(other._sram)),
-    _sram_length(other._sram_length) {
+    _sram_length(other._sram_length),
+    _dirtyRanges(std::move(other._dirtyRanges)),
+    _file(std::move(other._file)),
+    _journal(std::move(other._journal)) {
     other._sram = nullptr;
     other._sram_length = 0;
 }
@@ -65,6 +231,9 @@ MelonDsDs::sram::SaveManager& MelonDsDs::sram::SaveManager::operator=(SaveManage
     if (this != &other) {
         _sram = std::move(other._sram);
         _sram_length = other._sram_length;
+        _dirtyRanges = std::move(other._dirtyRanges);
+        _file = std::move(other._file);
+        _journal = std::move(other._journal);
         other._sram = nullptr;
         other._sram_length = 0;
     }
@@ -81,20 +250,183 @@ void MelonDsDs::sram::SaveManager::Flush(const u8 *savedata, u32 savelen, u32 wr
         _sram = std::make_unique<u8[]>(_sram_length);
 
         memcpy(_sram.get(), savedata, _sram_length);
+        _dirtyRanges.clear();
+        MarkDirty(0, _sram_length);
+        AppendToJournal(0, _sram_length);
     } else {
         if ((writeoffset + writelen) > savelen) {
             // If the write goes past the end of the SRAM, we have to wrap around
             u32 len = savelen - writeoffset;
-            memcpy(_sram.get() + writeoffset, savedata + writeoffset, len);
+            Write(savedata, writeoffset, savelen);
             len = writelen - len;
             if (len > savelen) len = savelen;
-            memcpy(_sram.get(), savedata, len);
+            Write(savedata, 0, len);
         } else {
-            memcpy(_sram.get() + writeoffset, savedata + writeoffset, writelen);
+            Write(savedata, writeoffset, writeoffset + writelen);
         }
     }
 }
 
+void MelonDsDs::sram::SaveManager::Write(const u8* savedata, u32 start, u32 end) noexcept {
+    // Only the bytes that actually changed are marked dirty and journaled,
+    // so that loading a savestate (which rewrites all of SRAM) doesn't journal a full copy every time.
+    // _sram always matches the journal's latest image, since every change to it is journaled.
+    const u8* changed = std::mismatch(savedata + start, savedata + end, _sram.get() + start).first;
+    if (changed == savedata + end)
+        return;
+
+    u32 first = changed - savedata;
+    u32 last = end;
+    while (last > first && savedata[last - 1] == _sram[last - 1]) {
+        --last;
+    }
+
+    memcpy(_sram.get() + first, savedata + first, last - first);
+    MarkDirty(first, last);
+    AppendToJournal(first, last);
+}
+
+bool MelonDsDs::sram::SaveManager::Matches(const u8 *savedata, u32 savelen, u32 writeoffset, u32 writelen) const noexcept {
+    ZoneScopedN(TracyFunction);
+    if (!_sram || _sram_length != savelen || (writeoffset + writelen) > savelen)
+        return false; // Not worth handling the wraparound case, as melonDS never writes all of SRAM that way
+
+    return memcmp(_sram.get() + writeoffset, savedata + writeoffset, writelen) == 0;
+}
+
+void MelonDsDs::sram::SaveManager::MarkDirty(u32 start, u32 end) noexcept {
+    if (start >= end) return;
+
+    // Find the first range that ends at or after this one starts,
+    // then absorb every range that starts at or before this one ends
+    auto first = std::ranges::lower_bound(_dirtyRanges, start, {}, &DirtyRange::End);
+    auto last = first;
+    while (last != _dirtyRanges.end() && last->Start <= end) {
+        start = std::min(start, last->Start);
+        end = std::max(end, last->End);
+        ++last;
+    }
+
+    first = _dirtyRanges.erase(first, last);
+    _dirtyRanges.insert(first, {start, end});
+
+    if (_dirtyRanges.size() > MAX_DIRTY_RANGES) {
+        _dirtyRanges = { {_dirtyRanges.front().Start, _dirtyRanges.back().End} };
+    }
+}
+
+void MelonDsDs::sram::SaveManager::AppendToJournal(u32 start, u32 end) noexcept {
+    if (_journal && start < end) {
+        _journal->Append(start, std::span<const uint8_t>(_sram.get() + start, end - start));
+    }
+}
+
+optional<u32> MelonDsDs::sram::SaveManager::OpenJournal(string_view savePath) noexcept {
+    ZoneScopedN(TracyFunction);
+    _journal = SaveJournal::Open(savePath);
+    if (!_journal) {
+        return nullopt;
+    }
+
+    u32 replayed = 0;
+    for (const DirtyRange& range : _journal->Replay(std::span<uint8_t>(_sram.get(), _sram_length))) {
+        MarkDirty(range.Start, range.End);
+        replayed += range.End - range.Start;
+    }
+
+    if (replayed > 0) {
+        retro::info("Recovered {} bytes of unsaved writes from save journal \"{}\"", replayed, _journal->Path());
+    }
+
+    return replayed;
+}
+
+bool MelonDsDs::sram::SaveManager::OpenDirect(string_view path) noexcept {
+    ZoneScopedN(TracyFunction);
+    retro_assert(!path.empty());
+    string pathString(path);
+
+    if (path_is_valid(pathString.c_str())) {
+        // If there's already save data here...
+        _file = retro::make_rfile(pathString, RETRO_VFS_FILE_ACCESS_READ_WRITE | RETRO_VFS_FILE_ACCESS_UPDATE_EXISTING);
+        if (!_file) {
+            retro::error("Failed to open \"{}\" for direct save data access", path);
+            return false;
+        }
+
+        int64_t size = filestream_get_size(_file.get());
+        int64_t length = std::min<int64_t>(std::max<int64_t>(size, 0), _sram_length);
+        if (filestream_read(_file.get(), _sram.get(), length) != length) {
+            retro::error("Failed to read {} bytes of save data from \"{}\"", length, path);
+            _file = nullptr;
+            return false;
+        }
+
+        if (size != _sram_length) {
+            retro::warn("Save data at \"{}\" is {} bytes, but the game expects {}", path, size, _sram_length);
+        }
+
+        retro::info("Loaded {}-byte save data from \"{}\"; changes will be written there directly", length, path);
+        _dirtyRanges.clear();
+        if (size < _sram_length) {
+            // Make sure the file's long enough to hold the whole buffer
+            MarkDirty(length, _sram_length);
+        }
+    }
+    else {
+        _file = retro::make_rfile(pathString, RETRO_VFS_FILE_ACCESS_READ_WRITE);
+        if (!_file) {
+            retro::error("Failed to create \"{}\" for direct save data access", path);
+            return false;
+        }
+
+        retro::info("Created {}-byte save data at \"{}\"; changes will be written there directly", _sram_length, path);
+        _dirtyRanges.clear();
+        MarkDirty(0, _sram_length);
+    }
+
+    return WriteDirtyRanges();
+}
+
+bool MelonDsDs::sram::SaveManager::WriteDirtyRanges() noexcept {
+    ZoneScopedN(TracyFunction);
+    if (!_file || _dirtyRanges.empty()) {
+        return true;
+    }
+
+    std::vector<DirtyRange> failed;
+    uint32_t written = 0;
+    for (const DirtyRange& range : _dirtyRanges) {
+        int64_t length = range.End - range.Start;
+        if (filestream_seek(_file.get(), range.Start, RETRO_VFS_SEEK_POSITION_START) < 0 ||
+            filestream_write(_file.get(), _sram.get() + range.Start, length) != length) {
+            failed.push_back(range);
+        }
+        else {
+            written += length;
+        }
+    }
+
+    // One flush for the whole batch, no matter how many ranges there were
+    filestream_flush(_file.get());
+    TracyPlot("NDS SRAM Bytes Written", static_cast<int64_t>(written));
+
+    if (!failed.empty()) {
+        retro::error("Failed to write {} of {} dirty SRAM ranges to \"{}\"", failed.size(), _dirtyRanges.size(), filestream_get_path(_file.get()));
+    }
+    else {
+        retro::debug("Wrote {} bytes of SRAM in {} ranges to \"{}\"", written, _dirtyRanges.size(), filestream_get_path(_file.get()));
+    }
+
+    _dirtyRanges = std::move(failed);
+    if (_dirtyRanges.empty() && _journal) {
+        // Everything the journal recorded is in the save file now
+        _journal->Clear();
+    }
+
+    return _dirtyRanges.empty();
+}
+
 // Does not load the NDS SRAM, since retro_get_memory is used for that.
 // But it will allocate the SRAM buffer
 void MelonDsDs::CoreState::InitNdsSave(const NdsCart &nds_cart) {
@@ -122,6 +454,28 @@ void MelonDsDs::CoreState::InitNdsSave(const NdsCart &nds_cart) {
         if (sram_length > 0) {
             _ndsSaveManager = std::make_optional<sram::SaveManager>(sram_length);
             retro::debug("Allocated {}-byte SRAM buffer for loaded NDS ROM.", sram_length);
+
+            if (Config.NdsSaveDirect() && _ndsInfo) {
+                // If we're meant to write the save data ourselves...
+                // (use the same file name the frontend would, so switching modes doesn't lose anything)
+                char name[PATH_MAX] {};
+                const char *ptr = path_basename(_ndsInfo->GetPath().data());  // "game.nds"
+                strlcpy(name, ptr ? ptr : _ndsInfo->GetPath().data(), sizeof(name));
+                path_remove_extension(name); // "game"
+                string fileName = fmt::format("{}.srm", name);
+
+                optional<string> savePath = retro::get_save_path(fileName);
+                if (!savePath || !_ndsSaveManager->OpenDirect(*savePath)) {
+                    retro::warn("Couldn't write save data directly; falling back to the frontend's save data handling");
+                }
+                else if (Config.SaveJournal()) {
+                    // If we want writes to survive a crash before they're flushed...
+                    if (optional<u32> replayed = _ndsSaveManager->OpenJournal(*savePath); replayed && *replayed > 0) {
+                        // Put the recovered writes in the save file now, which also clears the journal
+                        _ndsSaveManager->WriteDirtyRanges();
+                    }
+                }
+            }
         } else {
             retro::debug("Loaded NDS ROM does not use SRAM.");
         }
@@ -131,11 +485,24 @@ void MelonDsDs::CoreState::InitNdsSave(const NdsCart &nds_cart) {
 }
 
 void MelonDsDs::CoreState::WriteNdsSave(std::span<const std::byte> savedata, uint32_t writeoffset, uint32_t writelen) noexcept {
-    // No need to maintain a flush timer for NDS SRAM,
-    // because retro_get_memory lets us delegate autosave to the frontend.
+    // No need to maintain a flush timer for NDS SRAM unless we're writing it ourselves,
+    // because otherwise retro_get_memory lets us delegate autosave to the frontend.
 
     if (_ndsSaveManager) {
+        if (_unserializing && _ndsSaveManager->Matches((const uint8_t*)savedata.data(), savedata.size(), writeoffset, writelen)) {
+            // melonDS hands us all of SRAM whenever a savestate is loaded,
+            // but with rollback or rewind it's almost always what we already have;
+            // skipping it saves a copy and a pointless disk write per load.
+            return;
+        }
+
         _ndsSaveManager->Flush((const uint8_t*)savedata.data(), savedata.size(), writeoffset, writelen);
+
+        if (_ndsSaveManager->IsDirect()) {
+            // Like with GBA SRAM, the timer resets with each write
+            // so that a burst of writes ends up as one batch of disk writes.
+            _scheduler.Schedule(_ndsFlushTimer, Config.FlushDelay());
+        }
     }
 }
 
@@ -143,19 +510,32 @@ void MelonDsDs::CoreState::WriteGbaSave(std::span<const std::byte> savedata, uin
     ZoneScopedN(TracyFunction);
 
     retro_assert(_gbaSaveManager.has_value());
+    if (_unserializing && _gbaSaveManager->Matches((const uint8_t*)savedata.data(), savedata.size(), writeoffset, writelen)) {
+        // Same as with NDS SRAM
+        return;
+    }
+
+    if (sram::SaveJournal* journal = _gbaSaveManager->Journal(); journal && journal->IsCompacting() && _gbaSaveInfo) {
+        // If the last full write of GBA SRAM has landed, its journal records can go
+        if (_saveWriter.IsWritten(_gbaSaveInfo->GetPath())) {
+            journal->FinishCompaction();
+        }
+    }
+
     _gbaSaveManager->Flush((const uint8_t*)savedata.data(), savedata.size(), writeoffset, writelen);
 
     // Start the countdown until we flush the SRAM back to disk.
     // The timer resets every time we write to SRAM,
     // so that a sequence of SRAM writes doesn't result in
     // a sequence of disk writes.
-    _timeToGbaFlush = Config.FlushDelay();
+    _scheduler.Schedule(_gbaFlushTimer, Config.FlushDelay());
 }
 
 void MelonDsDs::CoreState::WriteFirmware(const Firmware& firmware, uint32_t writeoffset, uint32_t writelen) noexcept {
     ZoneScopedN(TracyFunction);
 
-    _timeToFirmwareFlush = Config.FlushDelay();
+    _firmwareDirty = true;
+    _scheduler.Schedule(_firmwareFlushTimer, Config.FlushDelay());
 }
 
 
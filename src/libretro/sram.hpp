@@ -18,9 +18,14 @@
 #define MELONDS_DS_SRAM_HPP
 
 #include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
 #include <vector>
 
 #include "libretro.hpp"
+#include "retro/file.hpp"
+#include "std/span.hpp"
 
 //! Definitions for managing SRAM.
 
@@ -31,12 +36,68 @@ namespace retro::task {
 struct retro_game_info;
 
 namespace MelonDsDs::sram  {
+    /// A half-open range of SRAM bytes that were written since the last flush.
+    struct DirtyRange {
+        uint32_t Start;
+        uint32_t End;
+    };
+
+    /// An append-only log of SRAM writes kept next to a save file,
+    /// so that writes made since the save file was last written survive a crash.
+    ///
+    /// Each record holds an offset, a length, the written bytes, and a CRC32 of all three;
+    /// replay stops at the first record that's incomplete or corrupt (e.g. torn by a crash mid-append).
+    /// Records hold absolute contents, so replaying ones that the save file already has is harmless.
+    class SaveJournal {
+    public:
+        /// Opens the journal for the save file at \c savePath, creating it if it doesn't exist.
+        /// Existing records are kept until \c Replay or \c Clear is called.
+        static std::optional<SaveJournal> Open(std::string_view savePath) noexcept;
+
+        /// Applies every intact record to \c sram in the order they were written,
+        /// then drops anything after the last intact record.
+        /// \returns The ranges of \c sram that were overwritten.
+        std::vector<DirtyRange> Replay(std::span<uint8_t> sram) noexcept;
+
+        /// Appends and flushes a record of \c data being written at \c offset.
+        bool Append(uint32_t offset, std::span<const uint8_t> data) noexcept;
+
+        /// Discards every record, once the save file is known to contain them.
+        bool Clear() noexcept;
+
+        /// Notes that the save file is being rewritten (e.g. in the background) with everything recorded so far.
+        void BeginCompaction() noexcept { _compactedSize = _size; }
+        [[nodiscard]] bool IsCompacting() const noexcept { return _compactedSize.has_value(); }
+
+        /// Call once the rewrite started by \c BeginCompaction is on disk.
+        /// Clears the journal unless records were appended in the meantime,
+        /// in which case they're kept for the next compaction.
+        void FinishCompaction() noexcept;
+
+        [[nodiscard]] const std::string& Path() const noexcept { return _path; }
+        [[nodiscard]] uint64_t Size() const noexcept { return _size; }
+    private:
+        SaveJournal(std::string&& path, retro::rfile_ptr&& file, uint64_t size) noexcept;
+
+        /// Truncates the journal down to its header.
+        bool Rewrite() noexcept;
+
+        std::string _path;
+        retro::rfile_ptr _file;
+        uint64_t _size;
+        std::optional<uint64_t> _compactedSize;
+    };
+
     /// An intermediate save buffer used as a staging ground between retro_get_memory and NDSCart::LoadSave.
     /// retro_get_memory is only called on the main thread at the beginning,
     /// so RetroArch's auto-save can't accommodate the possibility
     /// of a different SRAM buffer being used for each session.
     class SaveManager {
     public:
+        /// Past this many separate dirty ranges, they're all merged into one
+        /// so that games that scatter writes across SRAM don't make us issue lots of tiny writes.
+        static constexpr size_t MAX_DIRTY_RANGES = 64;
+
         explicit SaveManager(uint32_t initialLength);
         SaveManager(const SaveManager&) = delete;
         SaveManager(SaveManager&&) noexcept;
@@ -53,13 +114,50 @@ namespace MelonDsDs::sram  {
         /// \param writelen Length of the updated data.
         void Flush(const uint8_t *savedata, uint32_t savelen, uint32_t writeoffset, uint32_t writelen);
 
+        /// Returns \c true if passing the same arguments to \c Flush wouldn't change anything,
+        /// e.g. because a savestate was loaded with the same SRAM that we already have.
+        [[nodiscard]] bool Matches(const uint8_t *savedata, uint32_t savelen, uint32_t writeoffset, uint32_t writelen) const noexcept;
+
         [[nodiscard]] const uint8_t *Sram() const { return _sram.get(); }
         uint8_t *Sram() { return _sram.get(); }
         [[nodiscard]] uint32_t SramLength() const { return _sram_length; }
 
+        /// Ranges of SRAM written since the dirty ranges were last cleared or written,
+        /// sorted and with overlapping or adjacent ranges merged.
+        [[nodiscard]] std::span<const DirtyRange> DirtyRanges() const noexcept { return _dirtyRanges; }
+        [[nodiscard]] bool IsDirty() const noexcept { return !_dirtyRanges.empty(); }
+        void ClearDirtyRanges() noexcept { _dirtyRanges.clear(); }
+
+        /// Saves SRAM straight to the file at \c path from now on,
+        /// rather than leaving the whole buffer for the frontend to save.
+        /// Existing data at \c path is loaded into SRAM; if there isn't any, the file is created.
+        /// \returns \c false if the file couldn't be opened or created.
+        bool OpenDirect(std::string_view path) noexcept;
+        [[nodiscard]] bool IsDirect() const noexcept { return _file != nullptr; }
+
+        /// Writes each dirty range to the file given to \c OpenDirect, then flushes the file once.
+        /// If every range was written, the journal (if any) is cleared.
+        /// \returns \c false if any range couldn't be written; those ranges stay dirty.
+        bool WriteDirtyRanges() noexcept;
+
+        /// Records each write passed to \c Flush in a journal next to the save file at \c savePath from now on,
+        /// after replaying into SRAM any writes that an earlier session journaled but never saved.
+        /// Replayed writes are marked dirty.
+        /// \returns The number of bytes replayed from the journal, or \c nullopt if it couldn't be opened.
+        std::optional<uint32_t> OpenJournal(std::string_view savePath) noexcept;
+        [[nodiscard]] SaveJournal* Journal() noexcept { return _journal ? &*_journal : nullptr; }
+
     private:
+        /// Copies the bytes in [start, end) of \c savedata that differ from SRAM, then marks them dirty and journals them.
+        void Write(const uint8_t* savedata, uint32_t start, uint32_t end) noexcept;
+        void MarkDirty(uint32_t start, uint32_t end) noexcept;
+        void AppendToJournal(uint32_t start, uint32_t end) noexcept;
+
         std::unique_ptr<uint8_t[]> _sram;
         uint32_t _sram_length;
+        std::vector<DirtyRange> _dirtyRanges;
+        retro::rfile_ptr _file;
+        std::optional<SaveJournal> _journal;
     };
 }
 
@@ -25,19 +25,33 @@
 
 #ifdef HAVE_TRACY
 #include <tracy/Tracy.hpp>
+#elif defined(HAVE_TRACE_RECORDER)
+#include "recorder.hpp"
+// Without Tracy, zones can still go to the built-in trace recorder
+#define ZoneNamed(x,y) MelonDsDs::trace::Zone x(__func__, y)
+#define ZoneNamedN(x,y,z) MelonDsDs::trace::Zone x(y, z)
+#define ZoneNamedC(x,y,z) MelonDsDs::trace::Zone x(__func__, z)
+#define ZoneNamedNC(x,y,z,w) MelonDsDs::trace::Zone x(y, w)
+
+#define ZoneScoped MelonDsDs::trace::Zone ___melonds_trace_zone(__func__)
+#define ZoneScopedN(x) MelonDsDs::trace::Zone ___melonds_trace_zone(x)
+#define ZoneScopedC(x) MelonDsDs::trace::Zone ___melonds_trace_zone(__func__)
+#define ZoneScopedNC(x,y) MelonDsDs::trace::Zone ___melonds_trace_zone(x)
 #else
 #define ZoneNamed(x,y)
 #define ZoneNamedN(x,y,z)
 #define ZoneNamedC(x,y,z)
 #define ZoneNamedNC(x,y,z,w)
 
-#define ZoneTransient(x,y)
-#define ZoneTransientN(x,y,z)
-
 #define ZoneScoped
 #define ZoneScopedN(x)
 #define ZoneScopedC(x)
 #define ZoneScopedNC(x,y)
+#endif
+
+#ifndef HAVE_TRACY
+#define ZoneTransient(x,y)
+#define ZoneTransientN(x,y,z)
 
 #define ZoneText(x,y)
 #define ZoneTextV(x,y,z)
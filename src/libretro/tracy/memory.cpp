@@ -14,7 +14,177 @@
     with melonDS DS. If not, see http://www.gnu.org/licenses/.
 */
 
-#include <tracy/Tracy.hpp>
+#include "memory.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <optional>
+
+#include "tracy/client.hpp"
+
+using MelonDsDs::MemoryTag;
+
+namespace {
+    struct alignas(64) TagCounters {
+        std::atomic_int64_t Bytes;
+        std::atomic_int64_t PeakBytes;
+        std::atomic_int64_t Allocations;
+    };
+
+    // What operator delete needs to know about a block that our operator new handed out
+    struct Allocation {
+        uintptr_t Address; // 0 if this slot is empty
+        uint64_t Size;
+        MemoryTag Tag;
+    };
+
+    // Every allocation's size and tag is kept out of band, keyed by its address,
+    // so blocks are laid out exactly as malloc returns them.
+    // That way operator delete never reads memory it didn't allocate,
+    // and a block can be freed by another module's operator delete (or ours can free another module's).
+    // Each shard is an open-addressed hash table with linear probing,
+    // grown with malloc (not operator new) so it never recurses into itself.
+    struct alignas(64) AllocationShard {
+        std::atomic_flag Lock;
+        Allocation* Slots;
+        size_t Capacity; // Always a power of 2, or 0 if nothing's been allocated yet
+        size_t Count;
+    };
+
+    constexpr size_t SHARD_COUNT = 64;
+    constexpr size_t MIN_SHARD_CAPACITY = 256;
+
+    TagCounters counters[MelonDsDs::MEMORY_TAG_COUNT] {};
+    AllocationShard shards[SHARD_COUNT] {};
+    thread_local MemoryTag currentTag = MemoryTag::Other;
+    thread_local uint64_t threadAllocations = 0;
+
+    size_t Hash(uintptr_t address) noexcept {
+        // malloc's alignment leaves the low bits all zero, so mix them in from the high bits
+        uint64_t hash = static_cast<uint64_t>(address) * 0x9e3779b97f4a7c15ull;
+        return static_cast<size_t>(hash ^ (hash >> 32));
+    }
+
+    AllocationShard& ShardOf(uintptr_t address) noexcept {
+        return shards[(Hash(address) >> 16) % SHARD_COUNT];
+    }
+
+    class ShardLock {
+    public:
+        explicit ShardLock(AllocationShard& shard) noexcept : _shard(shard) {
+            while (_shard.Lock.test_and_set(std::memory_order_acquire)) {
+                _shard.Lock.wait(true, std::memory_order_relaxed);
+            }
+        }
+        ~ShardLock() noexcept {
+            _shard.Lock.clear(std::memory_order_release);
+            _shard.Lock.notify_one();
+        }
+        ShardLock(const ShardLock&) = delete;
+        ShardLock& operator=(const ShardLock&) = delete;
+    private:
+        AllocationShard& _shard;
+    };
+
+    void Place(Allocation* slots, size_t capacity, const Allocation& allocation) noexcept {
+        size_t i = Hash(allocation.Address) & (capacity - 1);
+        while (slots[i].Address != 0) {
+            i = (i + 1) & (capacity - 1);
+        }
+        slots[i] = allocation;
+    }
+
+    // Returns false if the table couldn't grow, in which case the block just isn't counted
+    bool Track(const Allocation& allocation) noexcept {
+        AllocationShard& shard = ShardOf(allocation.Address);
+        ShardLock lock(shard);
+        if ((shard.Count + 1) * 4 > shard.Capacity * 3) {
+            // If this shard would be more than 3/4 full...
+            size_t capacity = shard.Capacity ? shard.Capacity * 2 : MIN_SHARD_CAPACITY;
+            auto* slots = static_cast<Allocation*>(std::calloc(capacity, sizeof(Allocation)));
+            if (!slots)
+                return false;
+
+            for (size_t i = 0; i < shard.Capacity; ++i) {
+                if (shard.Slots[i].Address != 0) {
+                    Place(slots, capacity, shard.Slots[i]);
+                }
+            }
+            std::free(shard.Slots);
+            shard.Slots = slots;
+            shard.Capacity = capacity;
+        }
+
+        Place(shard.Slots, shard.Capacity, allocation);
+        ++shard.Count;
+        return true;
+    }
+
+    // Returns the block's bookkeeping and forgets it,
+    // or nullopt if our operator new didn't allocate it (or couldn't track it)
+    std::optional<Allocation> Untrack(uintptr_t address) noexcept {
+        AllocationShard& shard = ShardOf(address);
+        ShardLock lock(shard);
+        if (shard.Capacity == 0)
+            return std::nullopt;
+
+        size_t mask = shard.Capacity - 1;
+        size_t i = Hash(address) & mask;
+        while (shard.Slots[i].Address != address) {
+            if (shard.Slots[i].Address == 0)
+                return std::nullopt;
+
+            i = (i + 1) & mask;
+        }
+
+        Allocation allocation = shard.Slots[i];
+        shard.Slots[i] = {};
+        --shard.Count;
+
+        // Backward-shift deletion, so that lookups never need tombstones
+        for (size_t j = (i + 1) & mask; shard.Slots[j].Address != 0; j = (j + 1) & mask) {
+            size_t home = Hash(shard.Slots[j].Address) & mask;
+            if (((j - home) & mask) >= ((j - i) & mask)) {
+                // If the entry at j can move back to the gap at i without passing its home slot...
+                shard.Slots[i] = shard.Slots[j];
+                shard.Slots[j] = {};
+                i = j;
+            }
+        }
+
+        return allocation;
+    }
+}
+
+static void Charge(MemoryTag tag, int64_t bytes) noexcept {
+    TagCounters& tagCounters = counters[static_cast<size_t>(tag)];
+    tagCounters.Allocations.fetch_add(bytes > 0 ? 1 : -1, std::memory_order_relaxed);
+    int64_t total = tagCounters.Bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    int64_t peak = tagCounters.PeakBytes.load(std::memory_order_relaxed);
+    while (total > peak && !tagCounters.PeakBytes.compare_exchange_weak(peak, total, std::memory_order_relaxed));
+}
+
+MelonDsDs::MemoryScope::MemoryScope(MemoryTag tag) noexcept : _previous(currentTag) {
+    currentTag = tag;
+}
+
+MelonDsDs::MemoryScope::~MemoryScope() noexcept {
+    currentTag = _previous;
+}
+
+MelonDsDs::MemoryUsage MelonDsDs::GetMemoryUsage(MemoryTag tag) noexcept {
+    const TagCounters& tagCounters = counters[static_cast<size_t>(tag)];
+    return {
+        .Bytes = tagCounters.Bytes.load(std::memory_order_relaxed),
+        .PeakBytes = tagCounters.PeakBytes.load(std::memory_order_relaxed),
+        .Allocations = tagCounters.Allocations.load(std::memory_order_relaxed),
+    };
+}
+
+uint64_t MelonDsDs::GetThreadAllocationCount() noexcept {
+    return threadAllocations;
+}
 
 // Defining these functions in the global scope
 // overrides operator new and operator delete
@@ -25,8 +195,13 @@ void* operator new(std::size_t count)
     if (count == 0)
         ++count; // avoid std::malloc(0) which may return nullptr on success
 
-    if (void *ptr = std::malloc(count)) {
-        TracySecureAlloc(ptr, count);
+    if (void* ptr = std::malloc(count)) {
+        MemoryTag tag = currentTag;
+        if (Track({ reinterpret_cast<uintptr_t>(ptr), count, tag })) {
+            Charge(tag, static_cast<int64_t>(count));
+            TracySecureAllocN(ptr, count, MelonDsDs::GetMemoryTagName(tag));
+        }
+        ++threadAllocations;
         return ptr;
     }
 
@@ -35,6 +210,62 @@ void* operator new(std::size_t count)
 
 void operator delete(void* ptr) noexcept
 {
-    TracySecureFree(ptr);
+    if (!ptr)
+        return;
+
+    if (std::optional<Allocation> allocation = Untrack(reinterpret_cast<uintptr_t>(ptr))) {
+        // If our operator new allocated this block (as opposed to another module's)...
+        TracySecureFreeN(ptr, MelonDsDs::GetMemoryTagName(allocation->Tag));
+        Charge(allocation->Tag, -static_cast<int64_t>(allocation->Size));
+    }
+
     std::free(ptr);
 }
+
+// The standard library's versions of these already forward to the above,
+// but sanitizer runtimes replace them with their own; keep every form going through ours.
+
+void* operator new[](std::size_t count)
+{
+    return operator new(count);
+}
+
+void* operator new(std::size_t count, const std::nothrow_t&) noexcept
+{
+    try {
+        return operator new(count);
+    }
+    catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t count, const std::nothrow_t&) noexcept
+{
+    return operator new(count, std::nothrow);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+    operator delete(ptr);
+}
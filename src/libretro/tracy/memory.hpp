@@ -0,0 +1,104 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#ifndef MELONDS_DS_TRACY_MEMORY_HPP
+#define MELONDS_DS_TRACY_MEMORY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace MelonDsDs {
+    /// The part of the core that an allocation is charged to.
+    enum class MemoryTag : uint8_t {
+        Other,
+        /// The emulated console and the content loaded into it
+        Console,
+        /// Renderers, framebuffers, and screen composition
+        Render,
+        /// Multiplayer packets and Wi-Fi emulation
+        Network,
+        /// Core options and background tasks
+        Config,
+        Savestate,
+    };
+
+    constexpr size_t MEMORY_TAG_COUNT = static_cast<size_t>(MemoryTag::Savestate) + 1;
+
+    /// Also used as the names of Tracy's memory pools, so these must stay string literals.
+    constexpr const char* GetMemoryTagName(MemoryTag tag) noexcept {
+        switch (tag) {
+            case MemoryTag::Console: return "Console";
+            case MemoryTag::Render: return "Render";
+            case MemoryTag::Network: return "Network";
+            case MemoryTag::Config: return "Config";
+            case MemoryTag::Savestate: return "Savestate";
+            default: return "Other";
+        }
+    }
+
+    constexpr std::optional<MemoryTag> ParseMemoryTag(std::string_view name) noexcept {
+        for (size_t i = 0; i < MEMORY_TAG_COUNT; ++i) {
+            if (name == GetMemoryTagName(static_cast<MemoryTag>(i)))
+                return static_cast<MemoryTag>(i);
+        }
+
+        return std::nullopt;
+    }
+
+    struct MemoryUsage {
+        /// Bytes currently allocated under this tag
+        int64_t Bytes;
+
+        /// The most bytes that were ever allocated under this tag at once
+        int64_t PeakBytes;
+
+        /// Allocations currently live under this tag
+        int64_t Allocations;
+    };
+
+#ifdef HAVE_MEMORY_ACCOUNTING
+    /// Charges every \c operator \c new on this thread to \c tag until the scope ends.
+    /// Scopes nest; the innermost one wins.
+    class MemoryScope {
+    public:
+        explicit MemoryScope(MemoryTag tag) noexcept;
+        ~MemoryScope() noexcept;
+        MemoryScope(const MemoryScope&) = delete;
+        MemoryScope& operator=(const MemoryScope&) = delete;
+    private:
+        MemoryTag _previous;
+    };
+
+    [[nodiscard]] MemoryUsage GetMemoryUsage(MemoryTag tag) noexcept;
+
+    /// How many times this thread has called \c operator \c new, regardless of tag.
+    [[nodiscard]] uint64_t GetThreadAllocationCount() noexcept;
+#else
+    class MemoryScope {
+    public:
+        explicit MemoryScope(MemoryTag) noexcept {}
+    };
+
+    /// Always empty, as allocations aren't counted in this build
+    [[nodiscard]] inline MemoryUsage GetMemoryUsage(MemoryTag) noexcept { return {}; }
+    [[nodiscard]] inline uint64_t GetThreadAllocationCount() noexcept { return 0; }
+#endif
+}
+
+#endif //MELONDS_DS_TRACY_MEMORY_HPP
@@ -17,12 +17,11 @@
 #pragma once
 
 #if defined(HAVE_TRACY) && (defined(HAVE_OPENGL) || defined(HAVE_OPENGLES))
-#include <array>
-#include <queue>
-
 #include "PlatformOGLPrivate.h"
 #include <tracy/TracyOpenGL.hpp>
 
+#include "render/readback.hpp"
+
 namespace MelonDsDs {
     /// \brief Class for capturing OpenGL frames for Tracy.
     /// Suitable for both OpenGL renderers.
@@ -38,14 +37,7 @@ namespace MelonDsDs {
         OpenGlTracyCapture& operator=(OpenGlTracyCapture&&) = delete;
         void CaptureFrame(GLuint current_fbo, float scale) noexcept;
     private:
-        static constexpr int FRAME_LAG = 4;
-        std::array<GLuint, FRAME_LAG> _tracyTextures;
-        std::array<GLuint, FRAME_LAG> _tracyFbos;
-        std::array<GLuint, FRAME_LAG> _tracyPbos;
-        std::array<GLsync, FRAME_LAG> _tracyFences;
-        int _tracyIndex = 0;
-        std::queue<int> _tracyQueue;
-        bool _debug;
+        GlReadback _readback;
     };
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,387 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "recorder.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <new>
+
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+    struct TraceEvent {
+        const char* Name;
+        uint64_t Start;
+        uint64_t Duration;
+    };
+
+    // About 200KB per thread, or a few seconds of a busy thread's zones
+    constexpr size_t RING_SIZE = 8192;
+    constexpr size_t MAX_THREADS = 64;
+    constexpr size_t MAX_THREAD_NAME_LENGTH = 48;
+
+    struct ThreadRing {
+        // Only the owning thread writes events; it publishes each one by bumping this
+        std::atomic_uint64_t Head;
+        char Name[MAX_THREAD_NAME_LENGTH];
+        TraceEvent Events[RING_SIZE];
+    };
+
+    std::array<std::atomic<ThreadRing*>, MAX_THREADS> rings {};
+    std::atomic_uint32_t ringCount = 0;
+    thread_local ThreadRing* threadRing = nullptr;
+    thread_local bool threadRingFailed = false;
+
+    // Kept in static storage so the crash handler doesn't have to allocate;
+    // the file is opened up front so the handler only has to write to it
+    char crashPath[1024] {};
+    int crashFile = -1;
+    std::atomic_flag crashSaved = ATOMIC_FLAG_INIT;
+    constexpr int CRASH_SIGNALS[] = {
+        SIGSEGV,
+        SIGABRT,
+        SIGFPE,
+        SIGILL,
+#ifdef SIGBUS
+        SIGBUS,
+#endif
+    };
+#ifdef _WIN32
+    using SignalHandler = void (*)(int);
+    SignalHandler previousHandlers[std::size(CRASH_SIGNALS)] {};
+#else
+    struct sigaction previousActions[std::size(CRASH_SIGNALS)] {};
+#endif
+
+    // Formats the trace straight to a file descriptor through a fixed buffer.
+    // Unlike stdio, this doesn't allocate or lock, so it's safe to use in a signal handler.
+    class TraceWriter {
+    public:
+        explicit TraceWriter(int fd) noexcept : _fd(fd) {}
+        ~TraceWriter() noexcept { Flush(); }
+        TraceWriter(const TraceWriter&) = delete;
+        TraceWriter& operator=(const TraceWriter&) = delete;
+
+        void Put(char c) noexcept {
+            if (_length == sizeof(_buffer)) {
+                Flush();
+            }
+            _buffer[_length++] = c;
+        }
+
+        void Put(const char* string) noexcept {
+            for (const char* c = string; *c; ++c) {
+                Put(*c);
+            }
+        }
+
+        void PutUnsigned(uint64_t value, unsigned minDigits = 1) noexcept {
+            char digits[20];
+            unsigned count = 0;
+            do {
+                digits[count++] = static_cast<char>('0' + value % 10);
+                value /= 10;
+            } while (value != 0 || count < minDigits);
+
+            while (count > 0) {
+                Put(digits[--count]);
+            }
+        }
+
+        // Chrome's trace format wants microseconds; keep the nanoseconds as three decimal places
+        void PutMicroseconds(uint64_t nanoseconds) noexcept {
+            PutUnsigned(nanoseconds / 1000);
+            Put('.');
+            PutUnsigned(nanoseconds % 1000, 3);
+        }
+
+        void PutJsonString(const char* string) noexcept {
+            constexpr char HEX[] = "0123456789abcdef";
+            Put('"');
+            for (const char* c = string; *c; ++c) {
+                if (*c == '"' || *c == '\\') {
+                    Put('\\');
+                    Put(*c);
+                }
+                else if (static_cast<unsigned char>(*c) < 0x20) {
+                    Put("\\u00");
+                    Put(HEX[(*c >> 4) & 0xf]);
+                    Put(HEX[*c & 0xf]);
+                }
+                else {
+                    Put(*c);
+                }
+            }
+            Put('"');
+        }
+
+        [[nodiscard]] bool Ok() const noexcept { return _ok; }
+
+        void Flush() noexcept {
+            const char* data = _buffer;
+            while (_length > 0 && _ok) {
+#ifdef _WIN32
+                int written = _write(_fd, data, static_cast<unsigned>(_length));
+#else
+                ssize_t written = write(_fd, data, _length);
+                if (written < 0 && errno == EINTR)
+                    continue;
+#endif
+                if (written <= 0) {
+                    _ok = false;
+                    break;
+                }
+                data += written;
+                _length -= written;
+            }
+            _length = 0;
+        }
+    private:
+        int _fd;
+        bool _ok = true;
+        size_t _length = 0;
+        char _buffer[4096];
+    };
+}
+
+static ThreadRing* GetThreadRing() noexcept {
+    if (threadRing || threadRingFailed) [[likely]]
+        return threadRing;
+
+    uint32_t slot = ringCount.fetch_add(1, std::memory_order_relaxed);
+    ThreadRing* ring = slot < MAX_THREADS ? new(std::nothrow) ThreadRing {} : nullptr;
+    if (!ring) {
+        // If there are too many threads (or too little memory), this one just won't be recorded
+        threadRingFailed = true;
+        return nullptr;
+    }
+
+    snprintf(ring->Name, sizeof(ring->Name), "Thread %u", slot);
+
+    // Never freed, so a thread's events outlive it and can still be saved
+    rings[slot].store(ring, std::memory_order_release);
+    threadRing = ring;
+    return ring;
+}
+
+void MelonDsDs::trace::Record(const char* name, uint64_t startNs, uint64_t durationNs) noexcept {
+    ThreadRing* ring = GetThreadRing();
+    if (!ring) [[unlikely]]
+        return;
+
+    uint64_t head = ring->Head.load(std::memory_order_relaxed);
+    ring->Events[head % RING_SIZE] = { name, startNs, durationNs };
+    ring->Head.store(head + 1, std::memory_order_release);
+}
+
+void MelonDsDs::trace::SetThreadName(const char* name) noexcept {
+    if (ThreadRing* ring = GetThreadRing()) {
+        snprintf(ring->Name, sizeof(ring->Name), "%s", name);
+    }
+}
+
+static bool SaveTo(int fd) noexcept {
+    TraceWriter writer(fd);
+    writer.Put("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    uint32_t count = std::min<uint32_t>(ringCount.load(std::memory_order_relaxed), MAX_THREADS);
+    for (uint32_t tid = 0; tid < count; ++tid) {
+        const ThreadRing* ring = rings[tid].load(std::memory_order_acquire);
+        if (!ring)
+            continue;
+
+        writer.Put(first ? "" : ",\n");
+        writer.Put("{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":");
+        writer.PutUnsigned(tid);
+        writer.Put(",\"args\":{\"name\":");
+        writer.PutJsonString(ring->Name);
+        writer.Put("}}");
+        first = false;
+
+        uint64_t head = ring->Head.load(std::memory_order_acquire);
+        uint64_t start = head > RING_SIZE ? head - RING_SIZE : 0;
+        for (uint64_t i = start; i < head; ++i) {
+            TraceEvent event = ring->Events[i % RING_SIZE];
+            if (!event.Name)
+                continue;
+
+            writer.Put(",\n{\"ph\":\"X\",\"pid\":1,\"name\":");
+            writer.PutJsonString(event.Name);
+            writer.Put(",\"tid\":");
+            writer.PutUnsigned(tid);
+            writer.Put(",\"ts\":");
+            writer.PutMicroseconds(event.Start);
+            writer.Put(",\"dur\":");
+            writer.PutMicroseconds(event.Duration);
+            writer.Put('}');
+        }
+    }
+
+    writer.Put("\n]}\n");
+    writer.Flush();
+    return writer.Ok();
+}
+
+static int OpenTraceFile(const char* path) noexcept {
+#ifdef _WIN32
+    return _open(path, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    return open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+#endif
+}
+
+static void CloseTraceFile(int fd) noexcept {
+#ifdef _WIN32
+    _close(fd);
+#else
+    close(fd);
+#endif
+}
+
+bool MelonDsDs::trace::Save(const char* path) noexcept {
+    int fd = OpenTraceFile(path);
+    if (fd < 0)
+        return false;
+
+    bool ok = SaveTo(fd);
+    CloseTraceFile(fd);
+    return ok;
+}
+
+#ifdef _WIN32
+static void CrashHandler(int signal) noexcept {
+    if (!crashSaved.test_and_set() && crashFile >= 0) {
+        // If this is the first crash we've seen (the handler itself might crash)...
+        SaveTo(crashFile);
+    }
+
+    for (size_t i = 0; i < std::size(CRASH_SIGNALS); ++i) {
+        if (CRASH_SIGNALS[i] == signal) {
+            SignalHandler previous = previousHandlers[i];
+            if (previous != SIG_DFL && previous != SIG_IGN && previous != SIG_ERR) {
+                // If the frontend had its own crash handler, let it have a go
+                std::signal(signal, previous);
+                previous(signal);
+                return;
+            }
+        }
+    }
+
+    std::signal(signal, SIG_DFL);
+    std::raise(signal);
+}
+#else
+static void CrashHandler(int signal, siginfo_t* info, void* context) noexcept {
+    int savedErrno = errno;
+    if (!crashSaved.test_and_set() && crashFile >= 0) {
+        // If this is the first crash we've seen (the handler itself might crash)...
+        SaveTo(crashFile);
+    }
+
+    for (size_t i = 0; i < std::size(CRASH_SIGNALS); ++i) {
+        if (CRASH_SIGNALS[i] != signal)
+            continue;
+
+        // Put back whatever was there before us, so the crash ends the way it would have without us
+        const struct sigaction& previous = previousActions[i];
+        sigaction(signal, &previous, nullptr);
+        errno = savedErrno;
+        if (previous.sa_flags & SA_SIGINFO) {
+            // If the frontend had its own crash handler, let it have a go
+            previous.sa_sigaction(signal, info, context);
+            return;
+        }
+
+        if (previous.sa_handler != SIG_DFL && previous.sa_handler != SIG_IGN) {
+            previous.sa_handler(signal);
+            return;
+        }
+
+        break;
+    }
+
+    struct sigaction defaultAction {};
+    defaultAction.sa_handler = SIG_DFL;
+    sigemptyset(&defaultAction.sa_mask);
+    sigaction(signal, &defaultAction, nullptr);
+    raise(signal);
+}
+#endif
+
+void MelonDsDs::trace::InstallCrashHandler(const char* path) noexcept {
+    if (crashPath[0] != '\0') {
+        // If we already installed the handler (e.g. for a previous game), start over with the new path
+        UninstallCrashHandler();
+    }
+
+    int fd = OpenTraceFile(path);
+    if (fd < 0)
+        return;
+
+    snprintf(crashPath, sizeof(crashPath), "%s", path);
+    crashFile = fd;
+    crashSaved.clear();
+    for (size_t i = 0; i < std::size(CRASH_SIGNALS); ++i) {
+#ifdef _WIN32
+        previousHandlers[i] = std::signal(CRASH_SIGNALS[i], CrashHandler);
+#else
+        struct sigaction action {};
+        action.sa_sigaction = CrashHandler;
+        action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+        sigemptyset(&action.sa_mask);
+        sigaction(CRASH_SIGNALS[i], &action, &previousActions[i]);
+#endif
+    }
+}
+
+void MelonDsDs::trace::UninstallCrashHandler() noexcept {
+    if (crashPath[0] == '\0')
+        return;
+
+    for (size_t i = 0; i < std::size(CRASH_SIGNALS); ++i) {
+#ifdef _WIN32
+        std::signal(CRASH_SIGNALS[i], previousHandlers[i] == SIG_ERR ? SIG_DFL : previousHandlers[i]);
+#else
+        struct sigaction current {};
+        if (sigaction(CRASH_SIGNALS[i], nullptr, &current) == 0 && (current.sa_flags & SA_SIGINFO) && current.sa_sigaction == CrashHandler) {
+            // If nobody replaced our handler since we installed it...
+            sigaction(CRASH_SIGNALS[i], &previousActions[i], nullptr);
+        }
+#endif
+    }
+
+    CloseTraceFile(crashFile);
+    crashFile = -1;
+    if (!crashSaved.test_and_set()) {
+        // If the core never crashed, don't leave an empty trace behind
+        std::remove(crashPath);
+    }
+    crashPath[0] = '\0';
+}
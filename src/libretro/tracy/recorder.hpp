@@ -0,0 +1,74 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#ifndef MELONDS_DS_TRACY_RECORDER_HPP
+#define MELONDS_DS_TRACY_RECORDER_HPP
+
+#include <chrono>
+#include <cstdint>
+
+/// A lightweight stand-in for Tracy that keeps the last few thousand zones of each thread in memory,
+/// so that builds without Tracy can still produce a trace (in Chrome's JSON format) when asked.
+/// Only compiled in with HAVE_TRACE_RECORDER.
+namespace MelonDsDs::trace {
+    inline uint64_t Now() noexcept {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /// Adds a completed zone to the calling thread's ring buffer.
+    /// \c name must outlive the recorder (e.g. a string literal).
+    void Record(const char* name, uint64_t startNs, uint64_t durationNs) noexcept;
+
+    /// Labels the calling thread in saved traces. The name is copied.
+    void SetThreadName(const char* name) noexcept;
+
+    /// Writes every thread's recorded zones to \c path as Chrome trace JSON,
+    /// which can be opened in Perfetto or chrome://tracing.
+    /// Threads keep recording while this runs, so their oldest events may be torn or missing.
+    bool Save(const char* path) noexcept;
+
+    /// Saves a trace to \c path if the core crashes, then passes the crash on to any previous handler.
+    /// The file is created (empty) now, so that the handler itself only has to write to it.
+    void InstallCrashHandler(const char* path) noexcept;
+
+    /// Puts back the handlers that \c InstallCrashHandler replaced,
+    /// and deletes the trace file if nothing was saved to it.
+    /// Must be called before the core is unloaded, or the handlers would point at unmapped code.
+    void UninstallCrashHandler() noexcept;
+
+    class Zone {
+    public:
+        explicit Zone(const char* name, bool active = true) noexcept :
+            _name(active ? name : nullptr),
+            _start(active ? Now() : 0) {
+        }
+
+        ~Zone() noexcept {
+            if (_name) {
+                Record(_name, _start, Now() - _start);
+            }
+        }
+
+        Zone(const Zone&) = delete;
+        Zone& operator=(const Zone&) = delete;
+    private:
+        const char* _name;
+        uint64_t _start;
+    };
+}
+
+#endif //MELONDS_DS_TRACY_RECORDER_HPP
@@ -0,0 +1,96 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include "software.hpp"
+
+#include <cstring>
+
+#include <Platform.h>
+
+#include "environment.hpp"
+#include "pixels.hpp"
+#include "screenlayout.hpp"
+#include "tracy.hpp"
+
+MelonDsDs::SoftwareTracyCapture::SoftwareTracyCapture() noexcept :
+    // Allocated up front so that capturing a frame never allocates
+    _frames(NDS_SCREEN_AREA<size_t> * 2 * FRAME_LAG) {
+    ZoneScopedN(TracyFunction);
+    _framesReady = melonDS::Platform::Semaphore_Create();
+    _thread = melonDS::Platform::Thread_Create([this] { WorkerMain(); });
+
+    retro::debug("Initialized software Tracy capture");
+}
+
+MelonDsDs::SoftwareTracyCapture::~SoftwareTracyCapture() noexcept {
+    ZoneScopedN(TracyFunction);
+    if (_thread) {
+        _quit = true;
+        melonDS::Platform::Semaphore_Post(_framesReady, 1);
+        melonDS::Platform::Thread_Wait(_thread);
+        melonDS::Platform::Thread_Free(_thread);
+    }
+
+    melonDS::Platform::Semaphore_Free(_framesReady);
+}
+
+void MelonDsDs::SoftwareTracyCapture::CaptureFrame(const uint32_t* topScreen, const uint32_t* bottomScreen) noexcept {
+    if (!tracy::ProfilerAvailable())
+        return;
+
+    ZoneScopedN(TracyFunction);
+    if (_framesInFlight.load(std::memory_order_acquire) >= FRAME_LAG) {
+        // If the worker hasn't caught up, then skip this frame rather than wait
+        return;
+    }
+
+    uint32_t* frame = _frames.data() + _nextCapture * NDS_SCREEN_AREA<size_t> * 2;
+    memcpy(frame, topScreen, NDS_SCREEN_AREA<size_t> * PIXEL_SIZE);
+    memcpy(frame + NDS_SCREEN_AREA<size_t>, bottomScreen, NDS_SCREEN_AREA<size_t> * PIXEL_SIZE);
+    _nextCapture = (_nextCapture + 1) % FRAME_LAG;
+
+    if (!_thread) {
+        // If threads aren't available, convert and send the frame here
+        pixels::SwapRedBlueRect(frame, NDS_SCREEN_WIDTH, frame, NDS_SCREEN_WIDTH, NDS_SCREEN_WIDTH, NDS_SCREEN_HEIGHT * 2);
+        FrameImage(frame, NDS_SCREEN_WIDTH, NDS_SCREEN_HEIGHT * 2, 0, false);
+        _nextSend = _nextCapture;
+        return;
+    }
+
+    _framesInFlight.fetch_add(1, std::memory_order_release);
+    melonDS::Platform::Semaphore_Post(_framesReady, 1);
+}
+
+void MelonDsDs::SoftwareTracyCapture::WorkerMain() noexcept {
+    while (true) {
+        melonDS::Platform::Semaphore_Wait(_framesReady);
+        if (_quit)
+            return;
+
+        ZoneScopedN(TracyFunction);
+        uint32_t* frame = _frames.data() + _nextSend * NDS_SCREEN_AREA<size_t> * 2;
+
+        // libretro wants pixels in XRGB8888 format,
+        // but Tracy wants them in XBGR8888 format.
+        pixels::SwapRedBlueRect(frame, NDS_SCREEN_WIDTH, frame, NDS_SCREEN_WIDTH, NDS_SCREEN_WIDTH, NDS_SCREEN_HEIGHT * 2);
+
+        // This frame was captured at least one frame ago
+        FrameImage(frame, NDS_SCREEN_WIDTH, NDS_SCREEN_HEIGHT * 2, _framesInFlight.load(std::memory_order_relaxed), false);
+        _nextSend = (_nextSend + 1) % FRAME_LAG;
+        _framesInFlight.fetch_sub(1, std::memory_order_release);
+    }
+}
@@ -0,0 +1,61 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#pragma once
+
+#ifdef HAVE_TRACY
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace melonDS::Platform {
+    struct Thread;
+    struct Semaphore;
+}
+
+namespace MelonDsDs {
+    /// \brief Class for sending the software renderer's frames to Tracy.
+    /// Frames are captured at the DS's native resolution (both screens stacked),
+    /// and converted and sent on a worker thread so the emulator isn't held up.
+    class SoftwareTracyCapture {
+    public:
+        SoftwareTracyCapture() noexcept;
+        ~SoftwareTracyCapture() noexcept;
+        SoftwareTracyCapture(const SoftwareTracyCapture&) = delete;
+        SoftwareTracyCapture& operator=(const SoftwareTracyCapture&) = delete;
+        SoftwareTracyCapture(SoftwareTracyCapture&&) = delete;
+        SoftwareTracyCapture& operator=(SoftwareTracyCapture&&) = delete;
+
+        /// Copies both screens into the next free capture buffer and hands it to the worker.
+        /// If every buffer is still in use, the frame is dropped.
+        void CaptureFrame(const uint32_t* topScreen, const uint32_t* bottomScreen) noexcept;
+    private:
+        static constexpr unsigned FRAME_LAG = 4;
+        void WorkerMain() noexcept;
+
+        // One contiguous allocation, split into FRAME_LAG frames of two screens each
+        std::vector<uint32_t> _frames;
+        unsigned _nextCapture = 0;
+        unsigned _nextSend = 0;
+        std::atomic_uint _framesInFlight = 0;
+        melonDS::Platform::Thread* _thread = nullptr;
+        melonDS::Platform::Semaphore* _framesReady = nullptr;
+        std::atomic_bool _quit = false;
+    };
+}
+#endif
@@ -0,0 +1,114 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include <array>
+#include <cstdint>
+#include <numeric>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "config/config.hpp"
+#include "config/constants.hpp"
+#include "harness.hpp"
+#include "render/software.hpp"
+#include "screenlayout.hpp"
+
+namespace MelonDsDs {
+    /// Times composition by itself, without the presentation or change detection around it.
+    class CompositionBenchmark {
+    public:
+        static void Configure(SoftwareRenderState& state, const CoreConfig& config, const ScreenLayoutData& layout) noexcept {
+            state.ConfigureBuffers(config, layout);
+        }
+
+        static void Combine(SoftwareRenderState& state, const uint32_t* top, const uint32_t* bottom, const ScreenLayoutData& layout) noexcept {
+            state.CombineScreens(
+                state.buffer,
+                std::span<const uint32_t, NDS_SCREEN_AREA<size_t>>(top, NDS_SCREEN_AREA<size_t>),
+                std::span<const uint32_t, NDS_SCREEN_AREA<size_t>>(bottom, NDS_SCREEN_AREA<size_t>),
+                layout
+            );
+        }
+    };
+}
+
+namespace {
+    using MelonDsDs::ScreenLayout;
+
+    constexpr std::array LAYOUTS {
+        std::pair(ScreenLayout::TopBottom, "top-bottom"),
+        std::pair(ScreenLayout::LeftRight, "left-right"),
+        std::pair(ScreenLayout::TopOnly, "top"),
+        std::pair(ScreenLayout::TurnLeft, "rotate-left"),
+        std::pair(ScreenLayout::UpsideDown, "rotate-180"),
+        std::pair(ScreenLayout::HybridTop, "hybrid-top"),
+        std::pair(ScreenLayout::LargescreenTop, "largescreen-top"),
+    };
+}
+
+void MelonDsDs::benchmark::RunCompositionBenchmarks(Runner& runner) noexcept {
+    std::vector<uint32_t> top(NDS_SCREEN_AREA<size_t>);
+    std::vector<uint32_t> bottom(NDS_SCREEN_AREA<size_t>);
+    std::iota(top.begin(), top.end(), 0x00102030u);
+    std::iota(bottom.begin(), bottom.end(), 0x00302010u);
+
+#ifdef HAVE_THREADS
+    constexpr std::array PARALLEL { false, true };
+#else
+    constexpr std::array PARALLEL { false };
+#endif
+    for (bool parallel : PARALLEL) {
+        CoreConfig config;
+        config.SetScreenFilter(ScreenFilter::Linear);
+#ifdef HAVE_THREADS
+        config.SetParallelComposition(parallel);
+#endif
+        SoftwareRenderState state(config);
+
+        for (const auto& [layout, layoutName] : LAYOUTS) {
+            bool scaled = IsHybridLayout(layout) || IsLargeScreenLayout(layout);
+            if (parallel && !scaled)
+                continue; // Only scaled layouts are split across threads
+
+            for (unsigned ratio = 2; ratio <= (scaled ? config::screen::MAX_HYBRID_RATIO : 2); ++ratio) {
+                config.SetHybridRatio(ratio);
+
+                ScreenLayoutData screenLayout;
+                std::array layouts { layout };
+                screenLayout.SetLayouts(layouts);
+                screenLayout.SetScale(1);
+                screenLayout.ScreenGap(0);
+                screenLayout.HybridRatio(ratio);
+                screenLayout.HybridSmallScreenLayout(HybridSideScreenDisplay::Both);
+                screenLayout.Update();
+
+                std::string name = scaled
+                    ? fmt::format("SoftwareRenderState::CombineScreens ({}, {}:1{})", layoutName, ratio, parallel ? ", parallel" : "")
+                    : fmt::format("SoftwareRenderState::CombineScreens ({})", layoutName);
+                CompositionBenchmark::Configure(state, config, screenLayout);
+                runner.Run(name, [&] {
+                    CompositionBenchmark::Combine(state, top.data(), bottom.data(), screenLayout);
+                    DoNotOptimize(state);
+                });
+            }
+        }
+    }
+}
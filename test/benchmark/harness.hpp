@@ -0,0 +1,103 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#ifndef MELONDSDS_BENCHMARK_HARNESS_HPP
+#define MELONDSDS_BENCHMARK_HARNESS_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace MelonDsDs::benchmark {
+    /// Keeps the compiler from optimizing away the computation of \c value.
+    template<typename T>
+    inline void DoNotOptimize(const T& value) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r,m"(value) : "memory");
+#else
+        const volatile char* volatile sink = reinterpret_cast<const volatile char*>(&value);
+        (void)sink;
+#endif
+    }
+
+    struct Result {
+        std::string Name;
+        // Per sample
+        uint64_t Iterations;
+        double MedianNs;
+        double MinNs;
+        double MaxNs;
+    };
+
+    /// Times each benchmark in batches of iterations,
+    /// sized so that each batch (a "sample") takes at least \c minSampleTime.
+    class Runner {
+    public:
+        Runner(std::string_view filter, std::chrono::nanoseconds minSampleTime, unsigned samples) noexcept :
+            _filter(filter), _minSampleTime(minSampleTime), _samples(samples) {}
+
+        /// Runs \c body repeatedly unless \c name doesn't contain the filter.
+        /// \c body is a template parameter (rather than a \c std::function)
+        /// so that the indirect call doesn't end up in the measurements.
+        template<typename Body>
+        void Run(std::string_view name, Body&& body) noexcept {
+            if (name.find(_filter) == std::string_view::npos)
+                return;
+
+            // Warm up (caches, lazily-allocated buffers) and find a batch size that's long enough to time precisely
+            uint64_t iterations = 1;
+            while (TimeBatch(body, iterations) < _minSampleTime && iterations < (uint64_t(1) << 40)) {
+                iterations *= 2;
+            }
+
+            std::vector<double> samples;
+            samples.reserve(_samples);
+            for (unsigned i = 0; i < _samples; ++i) {
+                std::chrono::nanoseconds elapsed = TimeBatch(body, iterations);
+                samples.push_back(double(elapsed.count()) / double(iterations));
+            }
+
+            Record(name, iterations, samples);
+        }
+
+        [[nodiscard]] const std::vector<Result>& Results() const noexcept { return _results; }
+    private:
+        template<typename Body>
+        static std::chrono::nanoseconds TimeBatch(Body& body, uint64_t iterations) noexcept {
+            auto start = std::chrono::steady_clock::now();
+            for (uint64_t i = 0; i < iterations; ++i) {
+                body();
+            }
+            return std::chrono::steady_clock::now() - start;
+        }
+
+        void Record(std::string_view name, uint64_t iterations, std::vector<double>& samples) noexcept;
+
+        std::string_view _filter;
+        std::chrono::nanoseconds _minSampleTime;
+        unsigned _samples;
+        std::vector<Result> _results;
+    };
+
+    void RunPixelBenchmarks(Runner& runner) noexcept;
+    void RunCompositionBenchmarks(Runner& runner) noexcept;
+    void RunParsingBenchmarks(Runner& runner) noexcept;
+}
+
+#endif // MELONDSDS_BENCHMARK_HARNESS_HPP
@@ -0,0 +1,141 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+// A native microbenchmark driver for the core's hot paths.
+// Prints its results as JSON so that CI can compare them across commits;
+// run with --help for options.
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+#include <fmt/format.h>
+#include <libretro.h>
+
+#include "config/definitions.hpp"
+#include "harness.hpp"
+#include "version.hpp"
+
+#ifndef MELONDSDS_VERSION
+#define MELONDSDS_VERSION "unknown"
+#endif
+
+using std::string_view;
+
+void MelonDsDs::benchmark::Runner::Record(string_view name, uint64_t iterations, std::vector<double>& samples) noexcept {
+    std::sort(samples.begin(), samples.end());
+    size_t middle = samples.size() / 2;
+    double median = samples.size() % 2 ? samples[middle] : (samples[middle - 1] + samples[middle]) / 2;
+    _results.push_back({std::string(name), iterations, median, samples.front(), samples.back()});
+    fmt::print(stderr, "{:<48} {:>12.1f} ns/op ({} x {})\n", name, median, samples.size(), iterations);
+}
+
+// Answers option queries with each option's default, as a frontend would on a fresh install
+static bool BenchmarkEnvironment(unsigned cmd, void* data) noexcept {
+    if (cmd != RETRO_ENVIRONMENT_GET_VARIABLE)
+        return false;
+
+    auto* variable = static_cast<retro_variable*>(data);
+    for (const retro_core_option_v2_definition& definition : MelonDsDs::config::definitions::CoreOptionDefinitions) {
+        if (variable->key && strcmp(variable->key, definition.key) == 0) {
+            variable->value = definition.default_value;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+template<typename T>
+static bool ParseArgument(string_view arg, string_view name, T& value) noexcept {
+    if (!arg.starts_with(name))
+        return false;
+
+    string_view number = arg.substr(name.size());
+    auto [end, ec] = std::from_chars(number.data(), number.data() + number.size(), value);
+    return ec == std::errc() && end == number.data() + number.size();
+}
+
+int main(int argc, char* argv[]) {
+    string_view filter;
+    string_view outputPath;
+    unsigned samples = 15;
+    unsigned minSampleTimeMs = 10;
+
+    for (int i = 1; i < argc; ++i) {
+        string_view arg = argv[i];
+        if (arg.starts_with("--filter=")) {
+            filter = arg.substr(strlen("--filter="));
+        } else if (arg.starts_with("--output=")) {
+            outputPath = arg.substr(strlen("--output="));
+        } else if (ParseArgument(arg, "--samples=", samples) && samples > 0) {
+            continue;
+        } else if (ParseArgument(arg, "--min-time-ms=", minSampleTimeMs) && minSampleTimeMs > 0) {
+            continue;
+        } else {
+            fmt::print(
+                stderr,
+                "Usage: {} [--filter=SUBSTRING] [--output=FILE] [--samples=N] [--min-time-ms=N]\n"
+                "Writes JSON results to FILE, or to standard output if not given.\n",
+                argv[0]
+            );
+            return arg == "--help" ? 0 : 2;
+        }
+    }
+
+    retro_set_environment(BenchmarkEnvironment);
+
+    MelonDsDs::benchmark::Runner runner(filter, std::chrono::milliseconds(minSampleTimeMs), samples);
+    MelonDsDs::benchmark::RunPixelBenchmarks(runner);
+    MelonDsDs::benchmark::RunCompositionBenchmarks(runner);
+    MelonDsDs::benchmark::RunParsingBenchmarks(runner);
+
+    fmt::memory_buffer json;
+    fmt::format_to(std::back_inserter(json), "{{\n  \"version\": \"{}\",\n  \"samples\": {},\n  \"benchmarks\": [", MELONDSDS_VERSION, samples);
+    for (size_t i = 0; i < runner.Results().size(); ++i) {
+        const MelonDsDs::benchmark::Result& result = runner.Results()[i];
+        fmt::format_to(
+            std::back_inserter(json),
+            "{}\n    {{\"name\": \"{}\", \"iterations\": {}, \"ns_per_op\": {{\"median\": {:.3f}, \"min\": {:.3f}, \"max\": {:.3f}}}}}",
+            i ? "," : "",
+            result.Name,
+            result.Iterations,
+            result.MedianNs,
+            result.MinNs,
+            result.MaxNs
+        );
+    }
+    fmt::format_to(std::back_inserter(json), "\n  ]\n}}\n");
+
+    if (outputPath.empty()) {
+        fwrite(json.data(), 1, json.size(), stdout);
+        return 0;
+    }
+
+    if (FILE* file = fopen(std::string(outputPath).c_str(), "wb")) {
+        bool written = fwrite(json.data(), 1, json.size(), file) == json.size();
+        return fclose(file) == 0 && written ? 0 : 1;
+    }
+
+    fmt::print(stderr, "Failed to open {} for writing\n", outputPath);
+    return 1;
+}
@@ -0,0 +1,95 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "config/config.hpp"
+#include "core/cheats.hpp"
+#include "harness.hpp"
+#include "net/mp.hpp"
+
+namespace {
+    // The size of a typical multiplayer frame; most are far smaller than Packet::MAX_DATA_SIZE
+    constexpr size_t PAYLOAD_SIZE = 256;
+
+    // A short code, and one long enough to be typical of codes that patch a lot of memory
+    constexpr std::string_view SHORT_CHEAT = "02000000 00000001";
+    constexpr std::string_view LONG_CHEAT =
+        "94000130 FCFF0000 62112520 00000000 B2112520 00000000 10000BE4 00000063\n"
+        "D2000000 00000000 94000130 FCFF0000 62112520 00000000 B2112520 00000000\n"
+        "20000BD2 00000009 D2000000 00000000 94000130 FCFF0000 62112520 00000000\n"
+        "B2112520 00000000 C0000000 0000000F 10000C00 000003E7 DC000000 00000004\n"
+        "D2000000 00000000 94000130 FFF30000 62112520 00000000 B2112520 00000000";
+}
+
+void MelonDsDs::benchmark::RunParsingBenchmarks(Runner& runner) noexcept {
+    std::array<uint8_t, PAYLOAD_SIZE> payload {};
+    for (size_t i = 0; i < payload.size(); ++i) {
+        payload[i] = static_cast<uint8_t>(i * 31);
+    }
+
+    std::array<uint8_t, Packet::MAX_WIRE_SIZE> wire {};
+    size_t wireSize = Packet::Serialize(wire, payload, 0x123456789ABCDEF0, 1, Packet::Cmd);
+    Packet packet;
+
+    runner.Run("Packet::Serialize", [&] {
+        size_t written = Packet::Serialize(wire, payload, 0x123456789ABCDEF0, 1, Packet::Cmd);
+        DoNotOptimize(written);
+        DoNotOptimize(wire[0]);
+    });
+
+    runner.Run("Packet::PeekType", [&] {
+        auto type = Packet::PeekType(wire.data(), wireSize);
+        DoNotOptimize(type);
+    });
+
+    runner.Run("Packet::Parse", [&] {
+        bool parsed = packet.Parse(wire.data(), wireSize);
+        DoNotOptimize(parsed);
+        DoNotOptimize(packet);
+    });
+
+    std::vector<uint32_t> code;
+    code.reserve(64);
+    runner.Run("ParseCheatCode (short)", [&] {
+        bool parsed = ParseCheatCode(SHORT_CHEAT, code);
+        DoNotOptimize(parsed);
+        DoNotOptimize(code.data());
+    });
+
+    runner.Run("ParseCheatCode (long)", [&] {
+        bool parsed = ParseCheatCode(LONG_CHEAT, code);
+        DoNotOptimize(parsed);
+        DoNotOptimize(code.data());
+    });
+
+    ParseCheatCode(LONG_CHEAT, code);
+    runner.Run("ValidateCheatCode (long)", [&] {
+        bool valid = ValidateCheatCode(code);
+        DoNotOptimize(valid);
+    });
+
+    // Every option is at its default (see BenchmarkEnvironment in main.cpp)
+    CoreConfig config;
+    runner.Run("ParseConfig", [&] {
+        config::ParseConfig(config);
+        DoNotOptimize(config);
+    });
+}
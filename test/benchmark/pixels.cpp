@@ -0,0 +1,115 @@
+/*
+    Copyright 2023 Jesse Talavera-Greenberg
+
+    melonDS DS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS DS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS DS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#include <array>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include <fmt/format.h>
+#include <glm/vec2.hpp>
+
+#include "buffer.hpp"
+#include "config/constants.hpp"
+#include "harness.hpp"
+#include "pixels.hpp"
+#include "retro/scaler.hpp"
+#include "screenlayout.hpp"
+
+using glm::uvec2;
+
+namespace {
+    using MelonDsDs::NDS_SCREEN_AREA;
+    using MelonDsDs::NDS_SCREEN_HEIGHT;
+    using MelonDsDs::NDS_SCREEN_SIZE;
+    using MelonDsDs::NDS_SCREEN_WIDTH;
+
+    // Arbitrary but not uniform, so that nothing can be skipped
+    std::vector<uint32_t> MakeScreen() noexcept {
+        std::vector<uint32_t> screen(NDS_SCREEN_AREA<size_t>);
+        std::iota(screen.begin(), screen.end(), 0x00102030u);
+        return screen;
+    }
+}
+
+void MelonDsDs::benchmark::RunPixelBenchmarks(Runner& runner) noexcept {
+    const std::vector<uint32_t> screen = MakeScreen();
+
+    // Two screens stacked vertically, as in the default layout
+    const uvec2 stackedSize(NDS_SCREEN_WIDTH, NDS_SCREEN_HEIGHT * 2);
+    PixelBuffer packed(stackedSize);
+    PixelBuffer padded(stackedSize, true);
+
+    runner.Run("PixelBuffer::CopyDirect", [&] {
+        packed.CopyDirect(screen.data(), uvec2(0, NDS_SCREEN_HEIGHT));
+        DoNotOptimize(packed[0u]);
+    });
+
+    runner.Run("PixelBuffer::CopyDirect (padded rows)", [&] {
+        padded.CopyDirect(screen.data(), uvec2(0, NDS_SCREEN_HEIGHT));
+        DoNotOptimize(padded[0u]);
+    });
+
+    runner.Run("PixelBuffer::CopyRows", [&] {
+        packed.CopyRows(screen.data(), uvec2(0, NDS_SCREEN_HEIGHT), NDS_SCREEN_SIZE<unsigned>);
+        DoNotOptimize(packed[0u]);
+    });
+
+    runner.Run("PixelBuffer::Clear", [&] {
+        packed.Clear();
+        DoNotOptimize(packed[0u]);
+    });
+
+    runner.Run("PixelBuffer::Clear (padded rows)", [&] {
+        padded.Clear();
+        DoNotOptimize(padded[0u]);
+    });
+
+    runner.Run("PixelBuffer::Clear (rectangle)", [&] {
+        packed.Clear(uvec2(0, NDS_SCREEN_HEIGHT / 2), NDS_SCREEN_SIZE<unsigned>);
+        DoNotOptimize(packed[0u]);
+    });
+
+    std::vector<uint8_t> nv12(size_t(stackedSize.x) * stackedSize.y * 3 / 2);
+    runner.Run("pixels::ConvertToNv12Rect", [&] {
+        uint8_t* chroma = nv12.data() + size_t(stackedSize.x) * stackedSize.y;
+        pixels::ConvertToNv12Rect(nv12.data(), stackedSize.x, chroma, stackedSize.x, packed[0u], packed.Stride() / sizeof(uint32_t), stackedSize.x, stackedSize.y);
+        DoNotOptimize(nv12[0]);
+    });
+
+    PixelBuffer rotated(uvec2(stackedSize.y, stackedSize.x));
+    for (unsigned quarterTurns : {1u, 2u}) {
+        PixelBuffer& dest = quarterTurns % 2 ? rotated : padded;
+        runner.Run(fmt::format("pixels::RotateRect ({} degrees)", quarterTurns * 90), [&] {
+            pixels::RotateRect(dest[0u], dest.Stride() / sizeof(uint32_t), packed[0u], packed.Stride() / sizeof(uint32_t), stackedSize.x, stackedSize.y, quarterTurns);
+            DoNotOptimize(dest[0u]);
+        });
+    }
+
+    for (unsigned ratio = 2; ratio <= config::screen::MAX_HYBRID_RATIO; ++ratio) {
+        uvec2 scaledSize = NDS_SCREEN_SIZE<unsigned> * ratio;
+        std::vector<uint32_t> scaled(size_t(scaledSize.x) * scaledSize.y);
+        for (scaler_type type : {SCALER_TYPE_POINT, SCALER_TYPE_BILINEAR}) {
+            retro::Scaler scaler(SCALER_FMT_ARGB8888, SCALER_FMT_ARGB8888, type, NDS_SCREEN_WIDTH, NDS_SCREEN_HEIGHT, scaledSize.x, scaledSize.y);
+            std::string name = fmt::format("retro::Scaler::Scale ({}:1, {})", ratio, type == SCALER_TYPE_POINT ? "nearest" : "bilinear");
+            runner.Run(name, [&] {
+                scaler.Scale(scaled.data(), screen.data());
+                DoNotOptimize(scaled[0]);
+            });
+        }
+    }
+}
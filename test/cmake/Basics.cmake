@@ -55,6 +55,21 @@ add_python_test(
     CONTENT "${NDS_ROM}"
 )
 
+add_python_test(
+    NAME "Core runs for multiple frames with background work run inline"
+    TEST_MODULE basics.core_run_frames
+    CONTENT "${NDS_ROM}"
+    CORE_OPTION "MELONDSDS_THREAD_POOL_SIZE=0"
+)
+
+add_python_test(
+    NAME "Core runs for multiple frames with one worker thread"
+    TEST_MODULE basics.core_run_frames
+    CONTENT "${NDS_ROM}"
+    CORE_OPTION "MELONDSDS_THREAD_POOL_SIZE=1"
+    CORE_OPTION "MELONDSDS_THREAD_POOL_AFFINITY=0"
+)
+
 add_python_test(
     NAME "Core resets emulator state"
     TEST_MODULE basics.core_resets
@@ -67,12 +82,62 @@ add_python_test(
     CONTENT "${NDS_ROM}"
 )
 
+add_python_test(
+    NAME "Core generates audio with dynamic rate control"
+    TEST_MODULE basics.core_generates_audio
+    CONTENT "${NDS_ROM}"
+    CORE_OPTION "melonds_audio_rate_control=enabled"
+)
+
+add_python_test(
+    NAME "Core delivers audio through the frontend's audio callback"
+    TEST_MODULE basics.core_delivers_audio_through_callback
+    CONTENT "${NDS_ROM}"
+    CORE_OPTION "melonds_audio_callback=enabled"
+)
+
+add_python_test(
+    NAME "Core delivers audio through the frontend's audio callback with rate control"
+    TEST_MODULE basics.core_delivers_audio_through_callback
+    CONTENT "${NDS_ROM}"
+    CORE_OPTION "melonds_audio_callback=enabled"
+    CORE_OPTION "melonds_audio_rate_control=enabled"
+)
+
+add_python_test(
+    NAME "Core generates audio at 48 kHz"
+    TEST_MODULE basics.core_generates_audio
+    CONTENT "${NDS_ROM}"
+    CORE_OPTION "melonds_audio_output_rate=48000"
+    CORE_OPTION "melonds_audio_resampler_quality=best"
+)
+
+add_python_test(
+    NAME "Deterministic emulation pins the RTC to the absolute start time"
+    TEST_MODULE basics.core_pins_rtc_when_deterministic
+    CONTENT "${NDS_ROM}"
+    CORE_OPTION "melonds_deterministic=enabled"
+    CORE_OPTION "melonds_start_time_mode=sync"
+    CORE_OPTION "melonds_start_time_absolute_year=2004"
+    CORE_OPTION "melonds_start_time_absolute_month=11"
+    CORE_OPTION "melonds_start_time_absolute_day=21"
+    CORE_OPTION "melonds_start_time_absolute_hour=12"
+    CORE_OPTION "melonds_start_time_absolute_minute=34"
+)
+
 add_python_test(
     NAME "Core generates video"
     TEST_MODULE basics.core_generates_video
     CONTENT "${NDS_ROM}"
 )
 
+add_python_test(
+    NAME "Core verifies frame hashes against a recorded run"
+    TEST_MODULE basics.core_verifies_frame_hashes
+    CONTENT "${NDS_ROM}"
+    TIMEOUT 60
+)
+
 add_python_test(
     NAME "Core accepts button input"
     TEST_MODULE basics.core_accepts_button_input
@@ -105,6 +170,18 @@ add_python_test(
     CONTENT "${NDS_ROM}"
 )
 
+add_python_test(
+    NAME "Core saves and loads compressed state files"
+    TEST_MODULE basics.core_saves_and_loads_state_file
+    CONTENT "${NDS_ROM}"
+)
+
+add_python_test(
+    NAME "Core preloads the next content in the background"
+    TEST_MODULE basics.core_preloads_content
+    CONTENT "${NDS_ROM}"
+)
+
 add_python_test(
     NAME "Core exposes emulated RAM"
     TEST_MODULE basics.core_exposes_ram
@@ -133,6 +210,12 @@ add_python_test(
     NDS_SYSFILES
 )
 
+add_python_test(
+    NAME "Core rotates the screen itself if asked to"
+    TEST_MODULE basics.core_rotates_screen_in_core
+    NDS_SYSFILES
+)
+
 add_python_test(
     NAME "Core can send messages (API V0)"
     TEST_MODULE basics.core_sends_messages_v0
@@ -160,6 +243,13 @@ add_python_test(
     CONTENT "${NDS_ROM}"
 )
 
+add_python_test(
+    NAME "Core sets pixel format to RGB565 if requested"
+    TEST_MODULE basics.core_sets_pixel_format_rgb565
+    CONTENT "${NDS_ROM}"
+    CORE_OPTION melonds_rgb565_output=enabled
+)
+
 add_python_test(
     NAME "Core sets input descriptors"
     TEST_MODULE basics.core_defines_input_descriptors
@@ -209,6 +299,20 @@ add_python_test(
     NDS_SYSFILES
 )
 
+add_python_test(
+    NAME "Core logs output from a background thread"
+    TEST_MODULE basics.core_logs_output
+    NDS_SYSFILES
+    CORE_OPTION "MELONDSDS_LOG_ASYNC=1"
+)
+
+add_python_test(
+    NAME "Core delivers every record logged from a worker thread in order"
+    TEST_MODULE basics.core_logs_from_worker_thread
+    NDS_SYSFILES
+    CORE_OPTION "MELONDSDS_LOG_ASYNC=1"
+)
+
 add_python_test(
     NAME "Core gets the frontend's save directory"
     TEST_MODULE basics.core_gets_save_directory
@@ -337,3 +441,26 @@ add_python_test(
     TEST_MODULE basics.core_gets_power_state
     CONTENT "${NDS_ROM}"
 )
+
+add_python_test(
+    NAME "Core steps back through its rewind history and evicts old snapshots"
+    TEST_MODULE basics.core_rewinds
+    CONTENT "${NDS_ROM}"
+    CORE_OPTION melonds_rewind_buffer_size=16
+    CORE_OPTION melonds_rewind_interval=1
+)
+
+add_python_test(
+    NAME "Core shows frames from ahead of the emulated console with run-ahead"
+    TEST_MODULE basics.core_runs_ahead
+    CONTENT "${NDS_ROM}"
+    CORE_OPTION "melonds_deterministic=enabled"
+    CORE_OPTION "melonds_start_time_mode=sync"
+    TIMEOUT 120
+)
+
+add_python_test(
+    NAME "Core caches downloads, revalidates stale ones, and falls back to them offline"
+    TEST_MODULE basics.core_caches_downloads
+    CONTENT "${NDS_ROM}"
+)
@@ -259,4 +259,13 @@ add_python_test(
     CORE_OPTION "melonds_firmware_dsi_path=melonDS DS/${DSI_FIRMWARE_NAME}"
     CORE_OPTION "melonds_dsi_nand_path=melonDS DS/${DSI_NAND_NAME}"
     DSI_SYSFILES
-)
\ No newline at end of file
+)
+add_python_test(
+    NAME "Unchanged DSiWare save data isn't rewritten on unload"
+    TEST_MODULE save.dsiware_save_not_rewritten
+    CONTENT "${DSIWARE_ROM}"
+    CORE_OPTION "melonds_console_mode=dsi"
+    CORE_OPTION "melonds_firmware_dsi_path=melonDS DS/${DSI_FIRMWARE_NAME}"
+    CORE_OPTION "melonds_dsi_nand_path=melonDS DS/${DSI_NAND_NAME}"
+    DSI_SYSFILES
+)
@@ -15,3 +15,15 @@ add_python_test(
     TEST_MODULE cheats.not_enabled_if_invalid
     CONTENT "${NDS_ROM}"
 )
+
+add_python_test(
+    NAME "Malformed cheats are not enabled"
+    TEST_MODULE cheats.not_enabled_if_malformed
+    CONTENT "${NDS_ROM}"
+)
+
+add_python_test(
+    NAME "Disabled cheats are not run"
+    TEST_MODULE cheats.disabled_cheats_not_run
+    CONTENT "${NDS_ROM}"
+)
@@ -26,4 +26,9 @@ add_python_test(
     NAME "Host microphone is open and active at start when in Always mode"
     TEST_MODULE microphone.active_at_start_if_always
     CONTENT "${NDS_ROM}"
-)
\ No newline at end of file
+)
+add_python_test(
+    NAME "Host microphone audio is captured and resampled"
+    TEST_MODULE microphone.captures_host_audio
+    CONTENT "${NDS_ROM}"
+)
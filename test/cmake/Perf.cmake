@@ -0,0 +1,144 @@
+add_python_test(
+    NAME "Benchmark mode runs for the requested frames and writes a report"
+    TEST_MODULE perf.benchmark_writes_report
+    CONTENT "${NDS_ROM}"
+    CORE_OPTION "MELONDSDS_BENCHMARK_FRAMES=300"
+    TIMEOUT 60
+)
+
+add_python_test(
+    NAME "Benchmark mode writes a report without audio/video output"
+    TEST_MODULE perf.benchmark_writes_report
+    CONTENT "${NDS_ROM}"
+    CORE_OPTION "MELONDSDS_BENCHMARK_FRAMES=300"
+    CORE_OPTION "MELONDSDS_BENCHMARK_SKIP_AV=1"
+    TIMEOUT 60
+)
+
+add_python_test(
+    NAME "Savestate latency and size"
+    TEST_MODULE perf.savestate_latency
+    CONTENT "${NDS_ROM}"
+    CORE_OPTION "MELONDSDS_PERF_SAVESTATE_CYCLES=100"
+    CORE_OPTION "MELONDSDS_PERF_SAVESTATE_MAX_P99_MS=50"
+    TIMEOUT 60
+)
+
+add_python_test(
+    NAME "Memory is charged to the subsystem that allocated it"
+    TEST_MODULE perf.memory_accounting
+    CONTENT "${NDS_ROM}"
+    SKIP_RETURN_CODE 77
+    TIMEOUT 60
+)
+
+add_python_test(
+    NAME "Main RAM is backed by huge pages where the OS supports it"
+    TEST_MODULE perf.huge_pages
+    CONTENT "${NDS_ROM}"
+)
+
+add_python_test(
+    NAME "Immutable system files and content are shared with other processes"
+    TEST_MODULE perf.shared_mappings
+    CONTENT "${NDS_ROM}"
+)
+
+add_python_test(
+    NAME "Each frame's input is read with a handful of frontend calls"
+    TEST_MODULE perf.input_calls
+    CONTENT "${NDS_ROM}"
+    CORE_OPTION melonds_touch_mode=auto
+)
+
+add_python_test(
+    NAME "Steady-state frames don't allocate from the heap"
+    TEST_MODULE perf.frame_allocations
+    CONTENT "${NDS_ROM}"
+    CORE_OPTION "MELONDSDS_PERF_MAX_FRAME_ALLOCATIONS=0"
+    CORE_OPTION melonds_show_frame_timings=enabled
+    CORE_OPTION melonds_show_current_layout=enabled
+    SKIP_RETURN_CODE 77
+    TIMEOUT 60
+)
+
+add_python_test(
+    NAME "Pixel kernels match the scalar versions and report their throughput"
+    TEST_MODULE perf.pixel_kernels
+    TIMEOUT 60
+)
+
+add_python_test(
+    NAME "MELONDSDS_CPU_FEATURES=none dispatches every kernel to its scalar variant"
+    TEST_MODULE perf.cpu_feature_override
+    CORE_OPTION "MELONDSDS_CPU_FEATURES=none"
+)
+
+add_python_test(
+    NAME "Audio resampler produces the right amount of audio and reports its throughput"
+    TEST_MODULE perf.audio_resampler
+    TIMEOUT 60
+)
+
+add_python_test(
+    NAME "Semaphores and mutexes exclude each other and report their latency"
+    TEST_MODULE perf.sync_primitives
+    TIMEOUT 60
+)
+
+add_python_test(
+    NAME "Startup trace covers each stage and fits the time budget"
+    TEST_MODULE perf.startup_budget
+    CONTENT "${NDS_ROM}"
+    CORE_OPTION "MELONDSDS_PERF_STARTUP_MAX_MS=5000"
+    TIMEOUT 60
+)
+
+# The regression gate compares each run against a baseline recorded earlier on the same machine;
+# the first run of each configuration records its baseline and is reported as skipped.
+# Run just these tests with `ctest -L perf-gate`.
+set(PERF_BASELINE_DIR "${CMAKE_CURRENT_BINARY_DIR}/perf-baseline" CACHE PATH "Where the performance regression gate keeps its baselines. Point this at a shared directory to gate CI runs.")
+set(PERF_GATE_FRAMES 600 CACHE STRING "How many frames each performance regression gate test runs for")
+
+function(add_perf_gate_test NAME KEY CONTENT)
+    add_python_test(
+        NAME "Performance hasn't regressed: ${NAME}"
+        TEST_MODULE perf.regression_gate
+        CONTENT "${CONTENT}"
+        CORE_OPTION "MELONDSDS_BENCHMARK_FRAMES=${PERF_GATE_FRAMES}"
+        CORE_OPTION "MELONDSDS_BENCHMARK_SKIP_AV=1"
+        CORE_OPTION "MELONDSDS_PERF_BASELINE_DIR=${PERF_BASELINE_DIR}"
+        CORE_OPTION "MELONDSDS_PERF_BASELINE_KEY=${KEY}"
+        SKIP_RETURN_CODE 77
+        LABELS perf-gate
+        TIMEOUT 120
+        ${ARGN}
+    )
+endfunction()
+
+add_perf_gate_test("NDS ROM, software renderer" nds-rom-software "${NDS_ROM}"
+    CORE_OPTION "melonds_render_mode=software"
+)
+
+add_perf_gate_test("NDS ROM, OpenGL renderer" nds-rom-opengl "${NDS_ROM}"
+    CORE_OPTION "melonds_render_mode=opengl"
+    REQUIRES_OPENGL
+)
+
+add_perf_gate_test("micrecord.nds, software renderer" micrecord-software "${MICRECORD_NDS}"
+    CORE_OPTION "melonds_render_mode=software"
+    CORE_OPTION "melonds_boot_mode=direct"
+)
+
+add_perf_gate_test("micrecord.nds, OpenGL renderer" micrecord-opengl "${MICRECORD_NDS}"
+    CORE_OPTION "melonds_render_mode=opengl"
+    CORE_OPTION "melonds_boot_mode=direct"
+    REQUIRES_OPENGL
+)
+
+add_python_test(
+    NAME "Replaying recorded input reproduces the recorded session"
+    TEST_MODULE perf.input_replay_is_deterministic
+    CONTENT "${NDS_ROM}"
+    TIMEOUT 120
+)
@@ -53,4 +53,13 @@ add_python_test(
     CORE_OPTION "melonds_dsi_nand_path=melonDS DS/${DSI_NAND_NAME}"
     CORE_OPTION "melonds_firmware_dsi_path=melonDS DS/${DSI_FIRMWARE_NAME}"
     CORE_OPTION "melonds_sysfile_mode=native"
-)
\ No newline at end of file
+)
+add_python_test(
+    NAME "Core recreates its console from a freed ROM in low-memory mode"
+    TEST_MODULE reset.low_memory_rebuild
+    CONTENT "${NDS_ROM}"
+    CORE_OPTION "melonds_boot_mode=direct"
+    CORE_OPTION "melonds_console_mode=ds"
+    CORE_OPTION "melonds_low_memory_mode=enabled"
+    CORE_OPTION "melonds_sysfile_mode=builtin"
+)
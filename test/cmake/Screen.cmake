@@ -5,3 +5,63 @@ add_python_test(
     CORE_OPTION melonds_hybrid_ratio=3
     CORE_OPTION melonds_screen_layout1=hybrid-top
 )
+
+add_python_test(
+    NAME "Core supports parallel composition of hybrid layouts"
+    TEST_MODULE basics.core_run_frames
+    CONTENT "${NDS_ROM}"
+    CORE_OPTION melonds_hybrid_ratio=3
+    CORE_OPTION melonds_screen_layout1=hybrid-top
+    CORE_OPTION melonds_parallel_composition=enabled
+)
+
+add_python_test(
+    NAME "Core supports parallel composition of large-screen layouts"
+    TEST_MODULE basics.core_run_frames
+    CONTENT "${NDS_ROM}"
+    CORE_OPTION melonds_hybrid_ratio=2
+    CORE_OPTION melonds_screen_layout1=largescreen-top
+    CORE_OPTION melonds_parallel_composition=enabled
+)
+
+add_python_test(
+    NAME "Core supports parallel composition with a chosen thread count"
+    TEST_MODULE basics.core_run_frames
+    CONTENT "${NDS_ROM}"
+    CORE_OPTION melonds_hybrid_ratio=4
+    CORE_OPTION melonds_screen_layout1=hybrid-top
+    CORE_OPTION melonds_parallel_composition=enabled
+    CORE_OPTION melonds_parallel_composition_threads=8
+)
+
+add_python_test(
+    NAME "Core reuses precomputed geometry when cycling screen layouts"
+    TEST_MODULE basics.core_cycles_precomputed_layouts
+    CONTENT "${NDS_ROM}"
+    CORE_OPTION melonds_number_of_screen_layouts=3
+    CORE_OPTION melonds_screen_layout1=top-bottom
+    CORE_OPTION melonds_screen_layout2=left-right
+    CORE_OPTION melonds_screen_layout3=hybrid-top
+)
+
+add_python_test(
+    NAME "Core reports the configured layouts' maximum geometry up front"
+    TEST_MODULE basics.core_reports_max_layout_geometry
+    CONTENT "${NDS_ROM}"
+    CORE_OPTION melonds_number_of_screen_layouts=3
+    CORE_OPTION melonds_screen_layout1=top-bottom
+    CORE_OPTION melonds_screen_layout2=left-right
+    CORE_OPTION melonds_screen_layout3=hybrid-top
+)
+
+add_python_test(
+    NAME "Core outputs each screen separately through its screen interface"
+    TEST_MODULE basics.core_outputs_separate_screens
+    CONTENT "${NDS_ROM}"
+)
+
+add_python_test(
+    NAME "Core outputs NV12 frames through its video interface"
+    TEST_MODULE basics.core_outputs_nv12_frames
+    CONTENT "${NDS_ROM}"
+)
@@ -24,6 +24,35 @@ add_python_test(
     REQUIRES_OPENGL
 )
 
+add_python_test(
+    NAME "Core runs for multiple frames with software rendering and GPU composition"
+    TEST_MODULE opengl.core_loads_unloads
+    CONTENT "${NDS_ROM}"
+    CORE_OPTION "melonds_render_mode=software"
+    CORE_OPTION "melonds_gpu_composition=enabled"
+    REQUIRES_OPENGL
+)
+
+add_python_test(
+    NAME "Core runs for multiple frames with OpenGL and one frame in flight"
+    TEST_MODULE opengl.core_loads_unloads
+    CONTENT "${NDS_ROM}"
+    CORE_OPTION "melonds_render_mode=opengl"
+    CORE_OPTION "melonds_opengl_frames_in_flight=1"
+    REQUIRES_OPENGL
+)
+
+add_python_test(
+    NAME "Core runs for multiple frames with OpenGL and dynamic resolution"
+    TEST_MODULE opengl.core_loads_unloads
+    CONTENT "${NDS_ROM}"
+    CORE_OPTION "melonds_render_mode=opengl"
+    CORE_OPTION "melonds_opengl_resolution=4"
+    CORE_OPTION "melonds_opengl_dynamic_resolution=enabled"
+    CORE_OPTION "melonds_opengl_min_resolution=2"
+    REQUIRES_OPENGL
+)
+
 add_python_test(
     NAME "Core falls back to software renderer if OpenGL is unavailable"
     TEST_MODULE opengl.core_falls_back_to_software
@@ -65,6 +94,27 @@ add_python_test(
     TIMEOUT 30
 )
 
+add_python_test(
+    NAME "OpenGL presenter only changes state when it needs to"
+    TEST_MODULE opengl.core_skips_redundant_gl_calls
+    CONTENT "${NDS_ROM}"
+    REQUIRES_OPENGL
+)
+
+add_python_test(
+    NAME "Core times the GPU across dupe and skipped frames without OpenGL errors"
+    TEST_MODULE opengl.core_times_gpu_across_dupe_frames
+    CONTENT "${NDS_ROM}"
+    REQUIRES_OPENGL
+)
+
+add_python_test(
+    NAME "Core reads back OpenGL frames without stalling"
+    TEST_MODULE opengl.core_reads_back_frames_asynchronously
+    CONTENT "${NDS_ROM}"
+    REQUIRES_OPENGL
+)
+
 # See https://github.com/JesseTG/melonds-ds/issues/155
 add_python_test(
     NAME "Core does not crash at in-core error screen when using OpenGL"
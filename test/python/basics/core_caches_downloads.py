@@ -0,0 +1,70 @@
+import http.server
+import threading
+from ctypes import CFUNCTYPE, POINTER, c_bool, c_char_p, c_int64, c_uint8
+
+import prelude
+
+BODY = b"melonDS DS download cache test\n" * 64
+ETAG = '"melondsds-download-cache-test"'
+TIMEOUT = 10
+FRESH = 3600
+STALE = 0
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    # The If-None-Match header of each request, in order
+    requests: list[str | None] = []
+
+    def do_GET(self):
+        validator = self.headers.get("If-None-Match")
+        Handler.requests.append(validator)
+        if validator == ETAG:
+            self.send_response(304)
+            self.send_header("ETag", ETAG)
+            self.end_headers()
+            return
+
+        self.send_response(200)
+        self.send_header("ETag", ETAG)
+        self.send_header("Content-Length", str(len(BODY)))
+        self.end_headers()
+        self.wfile.write(BODY)
+
+    def log_message(self, format, *args):
+        pass
+
+
+server = http.server.ThreadingHTTPServer(("127.0.0.1", 0), Handler)
+threading.Thread(target=server.serve_forever, daemon=True).start()
+url = f"http://127.0.0.1:{server.server_port}/cached.tmd".encode()
+
+with prelude.session() as session:
+    download = session.get_proc_address(
+        b"melondsds_download",
+        CFUNCTYPE(c_int64, c_char_p, c_int64, c_int64, POINTER(c_uint8), c_int64)
+    )
+    revalidates = session.get_proc_address(b"melondsds_download_cache_revalidates", CFUNCTYPE(c_bool))
+    assert download is not None and revalidates is not None, "This build doesn't support networking"
+
+    def fetch(max_age: int) -> bytes | None:
+        buffer = (c_uint8 * (len(BODY) * 2))()
+        size = download(url, max_age, TIMEOUT, buffer, len(buffer))
+        return bytes(buffer[:size]) if size >= 0 else None
+
+    assert fetch(FRESH) == BODY, "First download returned the wrong body"
+    assert len(Handler.requests) == 1, f"Expected one request, got {len(Handler.requests)}"
+
+    # A fresh copy comes straight from the cache
+    assert fetch(FRESH) == BODY, "Cache hit returned the wrong body"
+    assert len(Handler.requests) == 1, "A fresh cached copy shouldn't touch the network"
+
+    # A stale copy is revalidated, and the server says it's still current
+    assert fetch(STALE) == BODY, "Revalidated download returned the wrong body"
+    assert len(Handler.requests) == 2, "A stale cached copy should be revalidated"
+    if revalidates():
+        assert Handler.requests[-1] == ETAG, f"Expected If-None-Match: {ETAG}, got {Handler.requests[-1]}"
+
+    # A stale copy is used if the server can't be reached at all
+    server.shutdown()
+    server.server_close()
+    assert fetch(STALE) == BODY, "Expected the stale copy when the server is down"
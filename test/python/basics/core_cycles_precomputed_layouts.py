@@ -0,0 +1,38 @@
+import itertools
+
+from libretro import JoypadState
+
+import prelude
+
+LAYOUTS = 3
+FRAMES_PER_LAYOUT = 10
+
+
+def generate_input():
+    for _ in range(LAYOUTS * 2):
+        # Stay on each layout for a little while, then cycle to the next one
+        yield from itertools.repeat(None, FRAMES_PER_LAYOUT - 1)
+        yield JoypadState(r3=True)
+
+    yield from itertools.repeat(None)
+
+
+with prelude.builder().with_input(generate_input).build() as session:
+    geometries = []
+    for _ in range(LAYOUTS * 2):
+        for _ in range(FRAMES_PER_LAYOUT):
+            session.run()
+
+        frame = session.video.screenshot()
+        geometry = session.video.geometry
+        assert frame is not None
+        assert geometry is not None
+        assert (frame.width, frame.height) == (geometry.base_width, geometry.base_height), \
+            f"Frame size {frame.width}x{frame.height} doesn't match geometry {geometry.base_width}x{geometry.base_height}"
+
+        geometries.append((geometry.base_width, geometry.base_height))
+
+first_pass = geometries[:LAYOUTS]
+second_pass = geometries[LAYOUTS:]
+assert len(set(first_pass)) == LAYOUTS, f"Expected {LAYOUTS} distinct layouts, got {first_pass}"
+assert first_pass == second_pass, f"Layouts changed between cycles: {first_pass} vs {second_pass}"
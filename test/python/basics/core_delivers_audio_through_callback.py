@@ -0,0 +1,38 @@
+from ctypes import CFUNCTYPE, POINTER, byref, c_bool, c_size_t, c_uint64
+from typing import cast
+from libretro import Session, ArrayAudioDriver
+
+import prelude
+
+get_audio_ring_stats_t = CFUNCTYPE(
+    c_bool,
+    POINTER(c_size_t),
+    POINTER(c_size_t),
+    POINTER(c_size_t),
+    POINTER(c_uint64),
+    POINTER(c_uint64),
+)
+
+session: Session
+with prelude.session() as session:
+    get_audio_ring_stats = session.get_proc_address(b"melondsds_get_audio_ring_stats", get_audio_ring_stats_t)
+    assert get_audio_ring_stats is not None, "melondsds_get_audio_ring_stats not defined in the core"
+
+    audio = cast(ArrayAudioDriver, session.audio)
+    for i in range(300):
+        session.run()
+
+    fill = c_size_t()
+    min_fill = c_size_t()
+    max_fill = c_size_t()
+    underruns = c_uint64()
+    written = c_uint64()
+    if get_audio_ring_stats(byref(fill), byref(min_fill), byref(max_fill), byref(underruns), byref(written)):
+        # If the frontend accepted the audio callback, then audio should've gone into the ring...
+        assert written.value > 0, "Core didn't write any audio to the ring"
+        assert fill.value <= 8192, f"Ring fill {fill.value} exceeds its capacity"
+        assert min_fill.value <= max_fill.value
+    else:
+        # ...otherwise the core should've fallen back to sending audio once per frame
+        assert audio.buffer is not None
+        assert len(audio.buffer) > 0
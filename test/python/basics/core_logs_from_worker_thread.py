@@ -0,0 +1,22 @@
+from ctypes import CFUNCTYPE, c_uint
+from typing import cast
+from libretro import UnformattedLogDriver
+
+import prelude
+
+RECORDS = 2000  # More than the async log sink's queue holds at once
+
+with prelude.session() as session:
+    log = cast(UnformattedLogDriver, session.log)
+    assert log is not None
+
+    log_from_worker = session.get_proc_address(b"melondsds_log_from_worker", CFUNCTYPE(None, c_uint))
+    assert log_from_worker is not None, "melondsds_log_from_worker not defined in the core"
+
+    log_from_worker(RECORDS)
+
+# The session is over, so anything the sink still had queued should have been delivered at deinit
+assert log.records is not None
+logged = [r.getMessage().strip() for r in log.records if "Worker log record" in r.getMessage()]
+expected = [f"Worker log record {i} of {RECORDS}" for i in range(RECORDS)]
+assert logged == expected, f"Expected {RECORDS} worker records in order, got {len(logged)}"
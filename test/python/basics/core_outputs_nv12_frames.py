@@ -0,0 +1,54 @@
+from ctypes import CFUNCTYPE, POINTER, Structure, c_bool, c_size_t, c_uint, c_uint8, byref, string_at
+
+import prelude
+
+INTERFACE_VERSION = 1
+
+
+class Nv12Frame(Structure):
+    _fields_ = (
+        ("luma", POINTER(c_uint8)),
+        ("luma_pitch", c_size_t),
+        ("chroma", POINTER(c_uint8)),
+        ("chroma_pitch", c_size_t),
+        ("width", c_uint),
+        ("height", c_uint),
+    )
+
+
+class VideoInterface(Structure):
+    _fields_ = (
+        ("interface_version", c_uint),
+        ("set_nv12_output", CFUNCTYPE(c_bool, c_bool)),
+        ("get_nv12_frame", CFUNCTYPE(c_bool, POINTER(Nv12Frame))),
+    )
+
+
+with prelude.session() as session:
+    get_interface = session.get_proc_address(b"melondsds_get_video_interface", CFUNCTYPE(POINTER(VideoInterface)))
+    assert get_interface is not None
+
+    interface = get_interface().contents
+    assert interface.interface_version == INTERFACE_VERSION
+    assert not interface.get_nv12_frame(byref(Nv12Frame())), "Expected no NV12 frame before NV12 output is enabled"
+    assert interface.set_nv12_output(True), "Expected NV12 output to be enabled"
+
+    for _ in range(70):
+        session.run()
+
+    frame = Nv12Frame()
+    assert interface.get_nv12_frame(byref(frame)), "Failed to get an NV12 frame"
+    assert frame.width > 0 and frame.height > 0
+    assert frame.luma_pitch >= frame.width
+    assert frame.chroma_pitch >= ((frame.width + 1) // 2) * 2
+
+    luma = string_at(frame.luma, frame.luma_pitch * frame.height)
+    chroma = string_at(frame.chroma, frame.chroma_pitch * ((frame.height + 1) // 2))
+
+    # Limited range keeps every sample within these bounds
+    assert all(16 <= y <= 235 for y in luma), "Expected every luma sample to be in limited range"
+    assert all(16 <= c <= 240 for c in chroma), "Expected every chroma sample to be in limited range"
+    assert len(set(luma)) > 1, "Expected the frame to have been drawn"
+
+    assert interface.set_nv12_output(False)
+    assert not interface.get_nv12_frame(byref(Nv12Frame())), "Expected no NV12 frame once NV12 output is disabled"
@@ -0,0 +1,49 @@
+from ctypes import CFUNCTYPE, POINTER, Structure, c_bool, c_size_t, c_uint, c_uint32, byref, string_at
+
+import prelude
+
+INTERFACE_VERSION = 1
+SCREEN_TOP = 0
+SCREEN_BOTTOM = 1
+WIDTH, HEIGHT = 256, 192
+
+
+class ScreenImage(Structure):
+    _fields_ = (
+        ("data", POINTER(c_uint32)),
+        ("width", c_uint),
+        ("height", c_uint),
+        ("pitch", c_size_t),
+    )
+
+
+class ScreenInterface(Structure):
+    _fields_ = (
+        ("interface_version", c_uint),
+        ("set_separate_screens", CFUNCTYPE(c_bool, c_bool)),
+        ("get_screen", CFUNCTYPE(c_bool, c_uint, POINTER(ScreenImage))),
+    )
+
+
+with prelude.session() as session:
+    get_interface = session.get_proc_address(b"melondsds_get_screen_interface", CFUNCTYPE(POINTER(ScreenInterface)))
+    assert get_interface is not None
+
+    interface = get_interface().contents
+    assert interface.interface_version == INTERFACE_VERSION
+    assert interface.set_separate_screens(True), "Expected separate screen output to be enabled"
+
+    for _ in range(70):
+        session.run()
+
+    screens = []
+    for screen in (SCREEN_TOP, SCREEN_BOTTOM):
+        image = ScreenImage()
+        assert interface.get_screen(screen, byref(image)), f"Failed to get screen {screen}"
+        assert (image.width, image.height) == (WIDTH, HEIGHT), f"Expected a {WIDTH}x{HEIGHT} screen, got {image.width}x{image.height}"
+        assert image.pitch == WIDTH * 4
+        screens.append(string_at(image.data, image.pitch * image.height))
+
+    assert any(any(screen) for screen in screens), "Expected at least one screen to have been drawn"
+    assert not interface.get_screen(2, byref(ScreenImage())), "Expected an invalid screen to be rejected"
+    assert interface.set_separate_screens(False)
@@ -0,0 +1,20 @@
+import os
+from ctypes import CFUNCTYPE, POINTER, byref, c_bool, c_int
+
+import prelude
+
+expected = tuple(int(os.environ[f"melonds_start_time_absolute_{field}"]) for field in ("year", "month", "day", "hour", "minute"))
+
+with prelude.session() as session:
+    get_rtc = session.get_proc_address(b"melondsds_get_rtc_date_time", CFUNCTYPE(c_bool, *([POINTER(c_int)] * 5)))
+    assert get_rtc is not None, "melondsds_get_rtc_date_time not defined in the core"
+
+    for i in range(10):
+        session.run()
+
+    fields = [c_int() for _ in range(5)]
+    assert get_rtc(*(byref(f) for f in fields)), "Failed to read the RTC"
+    actual = tuple(f.value for f in fields)
+
+    # The host clock is ignored (even in sync mode), so every player's console starts at the same time
+    assert actual == expected, f"Expected the RTC to read {expected}, got {actual}"
@@ -0,0 +1,63 @@
+import os
+from ctypes import CFUNCTYPE, POINTER, Structure, c_bool, c_char_p, c_int, c_uint
+
+import prelude
+
+INTERFACE_VERSION = 1
+PRELOAD_NONE = 0
+PRELOAD_PENDING = 1
+PRELOAD_READY = 2
+PRELOAD_FAILED = 3
+MAX_FRAMES = 600
+
+
+class PreloadInterface(Structure):
+    _fields_ = (
+        ("interface_version", c_uint),
+        ("preload_content", CFUNCTYPE(c_bool, c_char_p)),
+        ("cancel_preload", CFUNCTYPE(None)),
+        ("get_preload_status", CFUNCTYPE(c_int)),
+    )
+
+
+def wait_for_preload(session, interface) -> int:
+    for _ in range(MAX_FRAMES):
+        status = interface.get_preload_status()
+        if status != PRELOAD_PENDING:
+            return status
+        session.run()
+
+    return interface.get_preload_status()
+
+
+content_path = os.fsencode(prelude.content_path)
+missing_path = os.path.join(prelude.save_directory, b"core_preloads_content_missing.nds")
+
+with prelude.session() as session:
+    get_interface = session.get_proc_address(b"melondsds_get_preload_interface", CFUNCTYPE(POINTER(PreloadInterface)))
+    assert get_interface is not None
+
+    interface = get_interface().contents
+    assert interface.interface_version == INTERFACE_VERSION
+    assert interface.get_preload_status() == PRELOAD_NONE
+
+    for _ in range(30):
+        session.run()
+
+    assert interface.preload_content(content_path), "Failed to start preloading the content"
+    status = wait_for_preload(session, interface)
+    assert status == PRELOAD_READY, f"Expected the content to be preloaded, got status {status}"
+
+    # Asking again for the same content keeps what was already preloaded
+    assert interface.preload_content(content_path)
+    assert interface.get_preload_status() == PRELOAD_READY
+
+    interface.cancel_preload()
+    assert interface.get_preload_status() == PRELOAD_NONE
+
+    assert interface.preload_content(missing_path)
+    status = wait_for_preload(session, interface)
+    assert status == PRELOAD_FAILED, f"Expected a missing file to fail to preload, got status {status}"
+
+    for _ in range(30):
+        session.run()
@@ -0,0 +1,39 @@
+import itertools
+
+from libretro import JoypadState
+
+import prelude
+
+LAYOUTS = 3
+FRAMES_PER_LAYOUT = 10
+
+
+def generate_input():
+    for _ in range(LAYOUTS):
+        yield from itertools.repeat(None, FRAMES_PER_LAYOUT - 1)
+        yield JoypadState(r3=True)
+
+    yield from itertools.repeat(None)
+
+
+with prelude.builder().with_input(generate_input).build() as session:
+    av_info = session.core.get_system_av_info()
+    reported_max = (av_info.geometry.max_width, av_info.geometry.max_height)
+
+    geometries = []
+    for _ in range(LAYOUTS):
+        for _ in range(FRAMES_PER_LAYOUT):
+            session.run()
+
+        geometry = session.video.geometry
+        assert geometry is not None
+        geometries.append(geometry)
+
+for geometry in geometries:
+    assert (geometry.max_width, geometry.max_height) == reported_max, \
+        f"Max geometry changed from {reported_max} to {geometry.max_width}x{geometry.max_height} when switching layouts"
+
+widths = [g.base_width for g in geometries]
+heights = [g.base_height for g in geometries]
+assert reported_max == (max(widths), max(heights)), \
+    f"Expected the max geometry {reported_max} to fit the configured layouts exactly ({widths}, {heights})"
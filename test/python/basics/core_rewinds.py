@@ -0,0 +1,66 @@
+import hashlib
+from ctypes import CFUNCTYPE, POINTER, c_uint64, byref
+
+from libretro import Session
+from libretro.h import RETRO_MEMORY_SYSTEM_RAM
+
+import prelude
+
+FRAMES = 60
+STEPS = 5
+EVICTION_CAPACITY = 512 * 1024
+EVICTION_FRAMES = 300
+
+
+def ram_hash(memory) -> bytes:
+    return hashlib.sha256(memory[:].tobytes()).digest()
+
+
+session: Session
+with prelude.session() as session:
+    get_stats = session.get_proc_address(
+        b"melondsds_get_rewind_stats",
+        CFUNCTYPE(None, POINTER(c_uint64), POINTER(c_uint64))
+    )
+    set_capacity = session.get_proc_address(b"melondsds_set_rewind_capacity", CFUNCTYPE(None, c_uint64))
+    step_back = session.get_proc_address(b"melondsds_rewind_step_back", CFUNCTYPE(None))
+    assert get_stats is not None and set_capacity is not None and step_back is not None, \
+        "This build doesn't support rewinding"
+
+    def stats() -> tuple[int, int]:
+        length, evicted = c_uint64(), c_uint64()
+        get_stats(byref(length), byref(evicted))
+        return length.value, evicted.value
+
+    memory = session.core.get_memory(RETRO_MEMORY_SYSTEM_RAM)
+    assert memory is not None
+
+    # Snapshots are taken at the end of each frame (unless the last one is still being compressed),
+    # so each one should match the RAM as it was after some frame
+    hashes = []
+    for i in range(FRAMES):
+        session.run()
+        hashes.append(ram_hash(memory))
+
+    length, _ = stats()
+    assert length >= STEPS, f"Expected at least {STEPS} snapshots after {FRAMES} frames, got {length}"
+
+    current = len(hashes) - 1
+    for step in range(STEPS):
+        step_back()
+        restored = ram_hash(memory)
+        earlier = [i for i in range(current) if hashes[i] == restored]
+        assert earlier, f"Step {step + 1} didn't restore RAM from any frame before frame {current}"
+        current = earlier[-1]
+
+    assert stats()[0] == length - STEPS, "Each step back should consume one snapshot"
+
+    # Shrink the buffer until it can only hold a few dozen snapshots, then keep going
+    _, evicted_before = stats()
+    set_capacity(EVICTION_CAPACITY)
+    for i in range(EVICTION_FRAMES):
+        session.run()
+
+    length, evicted = stats()
+    assert evicted > evicted_before, f"Expected old snapshots to be evicted from a {EVICTION_CAPACITY // 1024}KiB buffer"
+    assert 0 < length < EVICTION_FRAMES, f"Expected the history to stay bounded, got {length} snapshots"
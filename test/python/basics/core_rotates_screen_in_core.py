@@ -0,0 +1,93 @@
+import itertools
+from ctypes import CFUNCTYPE, c_int
+
+from libretro import JoypadState, Rotation
+import prelude
+
+options = {
+    b"melonds_number_of_screen_layouts": b"2",
+    b"melonds_screen_layout1": b"top-bottom",
+    b"melonds_screen_layout2": b"rotate-left",
+    b"melonds_screen_gap": b"0",
+    b"melonds_screen_rotation": b"core",
+    b"melonds_show_cursor": b"disabled",
+}
+
+# Long enough for the firmware to draw something that isn't symmetric
+FRAMES_BEFORE_ROTATION = 120
+
+# How many sample points along each axis are compared between the two frames
+SAMPLES = 48
+
+
+def generate_input():
+    # Wait a little while...
+    yield from itertools.repeat(None, FRAMES_BEFORE_ROTATION)
+
+    # Cycle to the next screen layout
+    yield JoypadState(r3=True)
+
+    yield from itertools.repeat(None)
+
+
+def pixel(frame, x: int, y: int) -> bytes:
+    offset = (y * frame.width + x) * 4
+    return bytes(frame.data[offset:offset + 4])
+
+
+def difference(rotated, original, to_original) -> int:
+    """Sums the differences between sampled pixels of rotated and the pixels of original they should have come from."""
+    total = 0
+    for sy in range(SAMPLES):
+        for sx in range(SAMPLES):
+            x = sx * rotated.width // SAMPLES
+            y = sy * rotated.height // SAMPLES
+            a = pixel(rotated, x, y)
+            b = pixel(original, *to_original(x, y))
+            total += sum(abs(i - j) for i, j in zip(a, b))
+    return total
+
+
+with prelude.builder().with_input(generate_input).with_options(options).build() as session:
+    screen_layout = session.get_proc_address(b"melondsds_screen_layout", CFUNCTYPE(c_int))
+    assert screen_layout is not None, "melondsds_screen_layout not defined"
+
+    for i in range(FRAMES_BEFORE_ROTATION):
+        session.run()
+
+    layout1 = screen_layout()
+    assert layout1 == 0, f"Expected screen layout 0 (TopBottom), got {layout1}"
+
+    frame1 = session.video.screenshot(False)
+    assert frame1 is not None
+    assert len(frame1.data) == frame1.width * frame1.height * 4
+    assert len(set(bytes(frame1.data[i:i + 4]) for i in range(0, len(frame1.data), 4))) > 1, "Expected a frame with more than one color"
+
+    # Just long enough for the new layout to take effect, so the screens' contents barely change
+    for i in range(3):
+        session.run()
+
+    layout2 = screen_layout()
+    assert layout2 == 10, f"Expected screen layout 10 (TurnLeft), got {layout2}"
+    assert session.video.rotation == Rotation.NONE, f"Core asked the frontend to rotate the screen by {session.video.rotation}"
+
+    frame2 = session.video.screenshot(False)
+    geometry2 = session.video.geometry
+
+    assert frame2 is not None
+    assert geometry2 is not None
+
+    assert frame2.width == geometry2.base_width, \
+        f"Frame width ({frame2.width}) should match geometry base width ({geometry2.base_width})"
+
+    assert frame2.height == geometry2.base_height, \
+        f"Frame height ({frame2.height}) should match geometry base height ({geometry2.base_height})"
+
+    assert (frame2.width, frame2.height) == (frame1.height, frame1.width), \
+        f"Expected a {frame1.height}x{frame1.width} frame, got {frame2.width}x{frame2.height}"
+
+    # Rotating left turns the frame 90 degrees counter-clockwise (like RETRO_ENVIRONMENT_SET_ROTATION would),
+    # so frame1's top-right corner ends up at frame2's top-left
+    ccw = difference(frame2, frame1, lambda x, y: (frame1.width - 1 - y, x))
+    cw = difference(frame2, frame1, lambda x, y: (y, frame1.height - 1 - x))
+    assert ccw < cw, f"Frame looks rotated clockwise instead of counter-clockwise (difference {ccw} vs. {cw})"
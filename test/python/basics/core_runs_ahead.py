@@ -0,0 +1,34 @@
+import hashlib
+
+import prelude
+
+FRAMES = 300
+RUN_AHEAD = 2
+# Skip the boot screens, which don't change from one frame to the next
+FIRST_CHECKED_FRAME = 60
+
+
+def run(options: dict[bytes, bytes]) -> list[bytes]:
+    frames = []
+    with prelude.builder().with_options(options).build() as session:
+        for i in range(FRAMES):
+            session.run()
+            frames.append(hashlib.sha256(session.video.screenshot(False).data).digest())
+
+    return frames
+
+
+baseline = run({**prelude.options, b"melonds_run_ahead": b"disabled"})
+ahead = run({**prelude.options, b"melonds_run_ahead": str(RUN_AHEAD).encode()})
+
+checked = range(FIRST_CHECKED_FRAME, FRAMES - RUN_AHEAD)
+moving = [i for i in checked if baseline[i] != baseline[i + RUN_AHEAD]]
+assert moving, "The screen never changed, so run-ahead can't be told apart from the baseline"
+
+# Each frame shown with run-ahead is the one the baseline showed RUN_AHEAD frames later,
+# since the hidden frames see the same input and the console rolls back after each one
+mismatched = [i for i in checked if ahead[i] != baseline[i + RUN_AHEAD]]
+assert not mismatched, f"Frames {mismatched} didn't show what the baseline showed {RUN_AHEAD} frames later"
+
+behind = [i for i in moving if ahead[i] == baseline[i]]
+assert not behind, f"Frames {behind} showed the baseline's frame instead of running ahead"
@@ -0,0 +1,52 @@
+import os
+from ctypes import CFUNCTYPE, POINTER, Structure, c_bool, c_char_p, c_size_t, c_uint, c_uint32, byref
+
+import prelude
+
+INTERFACE_VERSION = 1
+
+
+class SavestateInterface(Structure):
+    _fields_ = (
+        ("interface_version", c_uint),
+        ("save_state_file", CFUNCTYPE(c_bool, c_char_p)),
+        ("load_state_file", CFUNCTYPE(c_bool, c_char_p)),
+        ("wait_for_state_files", CFUNCTYPE(c_bool)),
+        ("get_state_file_thumbnail", CFUNCTYPE(c_bool, c_char_p, POINTER(c_uint32), c_size_t, POINTER(c_uint), POINTER(c_uint))),
+    )
+
+
+path = os.path.join(prelude.save_directory, b"core_saves_and_loads_state_file.mdsz")
+
+with prelude.session() as session:
+    get_interface = session.get_proc_address(b"melondsds_get_savestate_interface", CFUNCTYPE(POINTER(SavestateInterface)))
+    assert get_interface is not None
+
+    interface = get_interface().contents
+    assert interface.interface_version == INTERFACE_VERSION
+
+    for _ in range(70):
+        session.run()
+
+    assert interface.save_state_file(path), "Failed to queue the savestate file"
+
+    # The state is compressed and written while the game keeps running
+    for _ in range(5):
+        session.run()
+
+    assert interface.wait_for_state_files(), "Failed to write the savestate file"
+    assert os.path.getsize(path) < session.core.serialize_size(), "Expected the savestate file to be compressed"
+
+    width = c_uint()
+    height = c_uint()
+    assert not interface.get_state_file_thumbnail(path, None, 0, byref(width), byref(height))
+    assert (width.value, height.value) == (256, 384), f"Expected a 256x384 thumbnail, got {width.value}x{height.value}"
+
+    pixels = (c_uint32 * (width.value * height.value))()
+    assert interface.get_state_file_thumbnail(path, pixels, len(pixels), byref(width), byref(height))
+    assert len(set(pixels)) > 1, "Expected the thumbnail to show the screens"
+
+    for _ in range(30):
+        session.run()
+
+    assert interface.load_state_file(path), "Failed to load the savestate file"
@@ -0,0 +1,10 @@
+from libretro import Session, PixelFormat
+
+import prelude
+
+session: Session
+with prelude.session() as session:
+    assert session.video.pixel_format == PixelFormat.RGB565
+
+    for i in range(60):
+        session.run()
@@ -0,0 +1,67 @@
+import os
+from ctypes import CFUNCTYPE, POINTER, byref, c_bool, c_uint64
+from itertools import cycle, repeat
+
+from libretro import JoypadState
+
+import prelude
+
+recording_path = os.path.join(prelude.testdir, b"input.mdsdinput").decode()
+hashes_path = os.path.join(prelude.testdir, b"frames.txt").decode()
+tampered_path = os.path.join(prelude.testdir, b"frames-tampered.txt").decode()
+frames = 300
+tampered_frame = 200
+
+
+def generate_input():
+    yield from repeat(0, 120)
+    yield from cycle((*repeat(0, 29), JoypadState(a=True)))
+
+
+def verify(path: str) -> tuple[int, int | None]:
+    os.environ["MELONDSDS_FRAME_HASH_VERIFY"] = path
+    with prelude.builder().build() as session:
+        frames_checked = session.get_proc_address(b"melondsds_frame_hashes_checked", CFUNCTYPE(c_uint64))
+        assert frames_checked is not None, "melondsds_frame_hashes_checked not defined in the core"
+
+        first_mismatch = session.get_proc_address(b"melondsds_first_frame_hash_mismatch", CFUNCTYPE(c_bool, POINTER(c_uint64)))
+        assert first_mismatch is not None, "melondsds_first_frame_hash_mismatch not defined in the core"
+
+        for i in range(frames):
+            session.run()
+
+        mismatch = c_uint64()
+        return frames_checked(), mismatch.value if first_mismatch(byref(mismatch)) else None
+
+
+os.environ["MELONDSDS_INPUT_RECORD"] = recording_path
+os.environ["MELONDSDS_FRAME_HASH_RECORD"] = hashes_path
+with prelude.builder().with_input(generate_input).build() as session:
+    for i in range(frames):
+        session.run()
+
+assert os.path.isfile(hashes_path), f"Frame checksums weren't written to {hashes_path}"
+del os.environ["MELONDSDS_INPUT_RECORD"]
+del os.environ["MELONDSDS_FRAME_HASH_RECORD"]
+
+with open(hashes_path, "r") as f:
+    lines = f.readlines()
+
+# The header, plus one line per presented frame
+assert len(lines) == frames + 1, f"Expected {frames} frame checksums, got {len(lines) - 1}"
+
+with open(tampered_path, "w") as f:
+    for line in lines:
+        frame, _, checksum = line.partition(" ")
+        if frame == str(tampered_frame):
+            line = f"{frame} {int(checksum, 16) ^ 1:08x}\n"
+        f.write(line)
+
+os.environ["MELONDSDS_INPUT_REPLAY"] = recording_path
+
+checked, mismatch = verify(hashes_path)
+assert checked == frames, f"Expected {frames} verified frames, got {checked}"
+assert mismatch is None, f"Replayed frame {mismatch} didn't match the recording"
+
+checked, mismatch = verify(tampered_path)
+assert mismatch == tampered_frame, f"Expected the first mismatch at frame {tampered_frame}, got {mismatch}"
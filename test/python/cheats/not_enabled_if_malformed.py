@@ -0,0 +1,19 @@
+from ctypes import CFUNCTYPE, c_uint
+from typing import cast
+
+from libretro import Session, LoggerMessageInterface, LogLevel
+
+import prelude
+
+session: Session
+with prelude.session() as session:
+    message = cast(LoggerMessageInterface, session.message)
+    num_cheats = session.get_proc_address(b"melondsds_num_cheats", CFUNCTYPE(c_uint))
+
+    # Parses fine, but the last instruction is missing its second word
+    session.core.cheat_set(0, True, b'02000000 DEADBEEF 02000004')
+
+    assert message.message_exts[-1].level == LogLevel.WARNING
+
+    cheats = num_cheats()
+    assert cheats == 0, f"Expected 0 cheats, got {cheats}"
@@ -0,0 +1,34 @@
+from collections.abc import Iterator
+from ctypes import CFUNCTYPE, POINTER, byref, c_bool, c_uint64
+from random import randint
+
+from libretro import Session
+
+import prelude
+
+def generate_noise() -> Iterator[int]:
+    while True:
+        yield randint(-30000, 30000)
+
+options = {
+    "melonds_mic_input": "microphone",
+    "melonds_mic_input_active": "always"
+}
+
+get_mic_capture_stats_t = CFUNCTYPE(c_bool, POINTER(c_uint64), POINTER(c_uint64), POINTER(c_uint64))
+
+session: Session
+with prelude.builder().with_mic(generate_noise).with_options(options).build() as session:
+    get_mic_capture_stats = session.get_proc_address(b"melondsds_get_mic_capture_stats", get_mic_capture_stats_t)
+    assert get_mic_capture_stats is not None, "melondsds_get_mic_capture_stats not defined in the core"
+
+    for i in range(120):
+        session.run()
+
+    captured = c_uint64()
+    consumed = c_uint64()
+    underruns = c_uint64()
+    assert get_mic_capture_stats(byref(captured), byref(consumed), byref(underruns)), "Host microphone isn't open"
+    assert captured.value > 0, "Core didn't capture any host mic audio"
+    assert consumed.value > 0, "Emulated microphone didn't receive any captured audio"
+    assert consumed.value <= captured.value
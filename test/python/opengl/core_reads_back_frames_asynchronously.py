@@ -0,0 +1,33 @@
+from ctypes import CFUNCTYPE, POINTER, c_bool, c_uint32, byref
+from typing import cast
+from libretro import ModernGlVideoDriver
+
+import prelude
+
+options = {
+    b"melonds_render_mode": b"opengl",
+}
+
+with prelude.builder().with_options(options).with_video(ModernGlVideoDriver).build() as session:
+    video = cast(ModernGlVideoDriver, session.video)
+    set_frame_readback = session.get_proc_address(b"melondsds_set_frame_readback", CFUNCTYPE(None, c_bool))
+    assert set_frame_readback is not None, "melondsds_set_frame_readback not defined in the core"
+
+    frame_checksum = session.get_proc_address(b"melondsds_frame_checksum", CFUNCTYPE(c_bool, POINTER(c_uint32)))
+    assert frame_checksum is not None, "melondsds_frame_checksum not defined in the core"
+
+    for i in range(60):
+        session.run()
+
+    checksum = c_uint32(0)
+    assert not frame_checksum(byref(checksum)), "Expected no checksum before enabling frame readback"
+
+    set_frame_readback(True)
+    for i in range(10):
+        session.run()
+
+    assert frame_checksum(byref(checksum)), "Expected a checksum within a few frames of enabling frame readback"
+
+    set_frame_readback(False)
+    session.run()
+    assert not frame_checksum(byref(checksum)), "Expected no checksum after disabling frame readback"
@@ -0,0 +1,34 @@
+from ctypes import CFUNCTYPE, c_uint
+from typing import cast
+from libretro import ModernGlVideoDriver
+
+import prelude
+
+options = {
+    b"melonds_render_mode": b"opengl",
+    b"melonds_opengl_filtering": b"nearest",
+}
+
+with prelude.builder().with_options(options).with_video(ModernGlVideoDriver).build() as session:
+    video = cast(ModernGlVideoDriver, session.video)
+    gl_calls_last_frame = session.get_proc_address(b"melondsds_opengl_calls_last_frame", CFUNCTYPE(c_uint))
+    assert gl_calls_last_frame is not None, "melondsds_opengl_calls_last_frame not defined in the core"
+
+    for i in range(120):
+        session.run()
+
+    steady = gl_calls_last_frame()
+    assert steady > 0, "Expected the OpenGL presenter to make some calls"
+
+    session.run()
+    assert gl_calls_last_frame() == steady, f"Expected {steady} calls on an unchanged frame, got {gl_calls_last_frame()}"
+
+    session.options.variables["melonds_opengl_filtering"] = b"linear"
+    session.run()
+    changed = gl_calls_last_frame()
+    assert changed > steady, f"Expected more than {steady} calls after changing the filter, got {changed}"
+
+    for i in range(3):
+        session.run()
+
+    assert gl_calls_last_frame() == steady, f"Expected {steady} calls once the filter was applied, got {gl_calls_last_frame()}"
@@ -0,0 +1,33 @@
+from ctypes import CFUNCTYPE, c_uint
+from itertools import repeat
+
+from libretro import JoypadState, ModernGlVideoDriver
+
+import prelude
+
+options = {
+    b"melonds_render_mode": b"opengl",
+    b"melonds_opengl_dynamic_resolution": b"enabled",
+    b"melonds_lid_power_saving": b"enabled",
+    b"melonds_frameskip": b"auto",
+}
+
+
+def generate_input():
+    yield from repeat(0, 60)
+    # L2 + Y toggles the lid, so the closed-lid frames are sent as dupes...
+    yield JoypadState(l2=True, y=True)
+    yield from repeat(0, 120)
+    # ...and then opened again, so the core goes back to drawing (and timing) every frame
+    yield JoypadState(l2=True, y=True)
+    yield from repeat(0)
+
+
+with prelude.builder().with_options(options).with_input(generate_input).with_video(ModernGlVideoDriver).build() as session:
+    opengl_error = session.get_proc_address(b"melondsds_opengl_error", CFUNCTYPE(c_uint))
+    assert opengl_error is not None, "melondsds_opengl_error not defined in the core"
+
+    for i in range(300):
+        session.run()
+        error = opengl_error()
+        assert error == 0, f"Expected no OpenGL errors, got {error:#06x} on frame {i}"
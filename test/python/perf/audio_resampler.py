@@ -0,0 +1,28 @@
+import json
+import os
+from ctypes import CFUNCTYPE, c_char_p, c_double, c_uint
+
+import prelude
+
+ITERATIONS = int(os.getenv("MELONDSDS_PERF_RESAMPLER_ITERATIONS", "2000"))
+QUALITIES = (b"fast", b"balanced", b"best")
+RATES = (44100, 48000)
+
+with prelude.noload_session() as session:
+    benchmark = session.get_proc_address(b"melondsds_benchmark_resampler", CFUNCTYPE(c_double, c_char_p, c_uint, c_uint))
+    assert benchmark is not None
+
+    report = {"iterations": ITERATIONS, "ns_per_frame": {}}
+    for quality in QUALITIES:
+        results = {}
+        for rate in RATES:
+            ns = benchmark(quality, rate, ITERATIONS)
+            assert ns != -2, f"{quality} resampler produced the wrong number of frames at {rate} Hz"
+            assert ns > 0, f"{quality} resampler failed at {rate} Hz"
+            results[rate] = ns
+
+        report["ns_per_frame"][quality.decode()] = results
+
+    assert benchmark(b"nonsense", 48000, 1) < 0, "Expected an unknown quality to be rejected"
+
+print(json.dumps(report, indent=2))
@@ -0,0 +1,32 @@
+import json
+import os
+
+import prelude
+
+report_path = os.path.join(prelude.testdir, b"benchmark.json")
+os.environ["MELONDSDS_BENCHMARK_REPORT"] = report_path.decode()
+frames = int(os.environ["MELONDSDS_BENCHMARK_FRAMES"])
+
+with prelude.session() as session:
+    for i in range(frames + 60):
+        session.run()
+        # The core should shut itself down once the benchmark is done
+
+    assert False, f"Core should have shut down after {frames} frames"
+
+# noinspection PyUnreachableCode
+assert session.is_shutdown
+
+# The report is written when the core is deinitialized
+assert os.path.isfile(report_path), f"Benchmark report wasn't written to {report_path}"
+
+with open(report_path, "r") as f:
+    report = json.load(f)
+
+print(json.dumps(report, indent=2))
+
+assert report["frames"] == frames, f"Expected {frames} benchmarked frames, got {report['frames']}"
+assert report["fps"] > 0, f"Expected a positive frame rate, got {report['fps']}"
+for phase in ("RunFrame", "Render", "Total"):
+    assert phase in report["phases"], f"Report is missing the {phase} phase"
+    assert report["phases"][phase]["avg_ms"] >= 0
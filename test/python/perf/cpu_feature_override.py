@@ -0,0 +1,21 @@
+import os
+from ctypes import CFUNCTYPE, c_bool, c_char_p
+
+import prelude
+
+with prelude.noload_session() as session:
+    kernel_variant = session.get_proc_address(b"melondsds_kernel_variant", CFUNCTYPE(c_char_p, c_char_p))
+    kernel_set = session.get_proc_address(b"melondsds_pixel_kernel_set", CFUNCTYPE(c_char_p))
+    kernels_match = session.get_proc_address(b"melondsds_pixel_kernels_match", CFUNCTYPE(c_bool))
+    assert kernel_variant is not None
+    assert kernel_set is not None
+    assert kernels_match is not None
+
+    assert os.getenv("MELONDSDS_CPU_FEATURES") == "none"
+    assert kernel_variant(b"pixels") == b"scalar", f"Expected the scalar pixel kernels, got {kernel_variant(b'pixels')}"
+    assert kernel_set() == b"scalar", f"Expected the scalar pixel kernels, got {kernel_set()}"
+    assert kernel_variant(b"resampler") == b"scalar", f"Expected the scalar resampler, got {kernel_variant(b'resampler')}"
+    assert kernel_variant(b"nonexistent") is None
+
+    # Restricting the dispatcher shouldn't affect the other variants
+    assert kernels_match(), "Vectorized pixel kernels don't match the scalar ones"
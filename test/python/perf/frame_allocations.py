@@ -0,0 +1,36 @@
+import os
+import sys
+from ctypes import CFUNCTYPE, POINTER, c_bool, c_uint64, byref
+
+import prelude
+
+SKIP = 77  # Matches SKIP_RETURN_CODE in Perf.cmake
+WARMUP_FRAMES = 120
+MEASURED_FRAMES = 300
+budget = int(os.getenv("MELONDSDS_PERF_MAX_FRAME_ALLOCATIONS", "0"))
+
+with prelude.session() as session:
+    get_allocations = session.get_proc_address(
+        b"melondsds_get_frame_heap_allocations",
+        CFUNCTYPE(c_bool, POINTER(c_uint64))
+    )
+    assert get_allocations is not None
+
+    allocations = c_uint64()
+    if not get_allocations(byref(allocations)):
+        print("This build doesn't count allocations")
+        sys.exit(SKIP)
+
+    # Let the core finish booting and fill its caches
+    for i in range(WARMUP_FRAMES):
+        session.run()
+
+    counts = []
+    for i in range(MEASURED_FRAMES):
+        session.run()
+        assert get_allocations(byref(allocations))
+        counts.append(allocations.value)
+
+print(f"Heap allocations per frame: max {max(counts)}, total {sum(counts)} over {len(counts)} frames")
+over = [(i, n) for i, n in enumerate(counts) if n > budget]
+assert not over, f"{len(over)} steady-state frames made more than {budget} heap allocations (first: frame {over[0][0]} with {over[0][1]})"
@@ -0,0 +1,28 @@
+import sys
+from ctypes import CFUNCTYPE, POINTER, c_bool, c_char_p, c_uint64, byref
+
+import prelude
+
+STATUSES = (b"unsupported", b"disabled", b"too small", b"advised", b"failed")
+
+with prelude.session() as session:
+    get_status = session.get_proc_address(b"melondsds_main_ram_huge_page_status", CFUNCTYPE(c_char_p))
+    get_bytes = session.get_proc_address(b"melondsds_get_main_ram_huge_page_bytes", CFUNCTYPE(c_bool, POINTER(c_uint64)))
+    assert get_status is not None
+    assert get_bytes is not None
+
+    # Touch main RAM so the kernel has a reason to promote it
+    for i in range(60):
+        session.run()
+
+    status = get_status()
+    assert status in STATUSES, f"Unexpected huge page status {status}"
+    assert status != b"failed", "The OS rejected the request for huge pages"
+
+    huge_bytes = c_uint64()
+    if get_bytes(byref(huge_bytes)):
+        assert huge_bytes.value <= 16 * 1024 * 1024, f"Reported {huge_bytes.value} bytes of huge pages for 16MiB of RAM"
+        print(f"Main RAM huge pages: {status.decode()}, {huge_bytes.value // 1024} KiB backed")
+    else:
+        print(f"Main RAM huge pages: {status.decode()}")
+        assert not sys.platform.startswith("linux"), "Expected Linux to report huge page usage"
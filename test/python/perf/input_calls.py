@@ -0,0 +1,25 @@
+from ctypes import CFUNCTYPE, c_uint32
+
+import prelude
+
+WARMUP_FRAMES = 30
+MEASURED_FRAMES = 60
+
+# One input_poll, one joypad bitmask, two analog axes, and the pointer's pressed/X/Y
+MAX_CALLS = 7
+
+with prelude.session() as session:
+    get_calls = session.get_proc_address(b"melondsds_get_frame_input_calls", CFUNCTYPE(c_uint32))
+    assert get_calls is not None
+
+    for i in range(WARMUP_FRAMES):
+        session.run()
+
+    counts = []
+    for i in range(MEASURED_FRAMES):
+        session.run()
+        counts.append(get_calls())
+
+print(f"Frontend input calls per frame: min {min(counts)}, max {max(counts)}")
+assert min(counts) > 0, "Input wasn't read from the frontend at all"
+assert max(counts) <= MAX_CALLS, f"Reading one frame's input took up to {max(counts)} frontend calls, expected at most {MAX_CALLS}"
@@ -0,0 +1,38 @@
+import os
+from itertools import cycle, repeat
+
+from libretro import JoypadState
+
+import prelude
+
+recording_path = os.path.join(prelude.testdir, b"input.mdsdinput").decode()
+frames = 600
+
+
+def generate_input():
+    # Press A every so often so that the recording has something worth replaying
+    yield from repeat(0, 240)
+    yield from cycle((*repeat(0, 29), JoypadState(a=True)))
+
+
+os.environ["MELONDSDS_INPUT_RECORD"] = recording_path
+with prelude.builder().with_input(generate_input).build() as session:
+    for i in range(frames):
+        session.run()
+
+    recorded = session.video.screenshot()
+
+# The recording is written when the game is unloaded
+assert os.path.isfile(recording_path), f"Input recording wasn't written to {recording_path}"
+del os.environ["MELONDSDS_INPUT_RECORD"]
+
+os.environ["MELONDSDS_INPUT_REPLAY"] = recording_path
+with prelude.builder().build() as session:
+    # No input from the frontend; everything the console sees comes from the recording
+    for i in range(frames):
+        session.run()
+
+    replayed = session.video.screenshot()
+
+assert (recorded.width, recorded.height) == (replayed.width, replayed.height)
+assert recorded.data == replayed.data, "Replayed session diverged from the recorded one"
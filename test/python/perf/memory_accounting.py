@@ -0,0 +1,44 @@
+import json
+import sys
+from ctypes import CFUNCTYPE, POINTER, c_bool, c_char_p, c_int64, byref
+
+import prelude
+
+TAGS = (b"Other", b"Console", b"Render", b"Network", b"Config", b"Savestate")
+SKIP = 77  # Matches SKIP_RETURN_CODE in Perf.cmake
+
+with prelude.session() as session:
+    get_usage = session.get_proc_address(
+        b"melondsds_get_memory_usage",
+        CFUNCTYPE(c_bool, c_char_p, POINTER(c_int64), POINTER(c_int64), POINTER(c_int64))
+    )
+    assert get_usage is not None
+
+    def usage(tag: bytes):
+        size, peak, count = c_int64(), c_int64(), c_int64()
+        if not get_usage(tag, byref(size), byref(peak), byref(count)):
+            return None
+        return {"bytes": size.value, "peak_bytes": peak.value, "allocations": count.value}
+
+    if usage(b"Console") is None:
+        print("This build doesn't count allocations per subsystem")
+        sys.exit(SKIP)
+
+    assert usage(b"Nonsense") is None, "Expected an unknown tag to be rejected"
+
+    for i in range(60):
+        session.run()
+
+    size = session.core.serialize_size()
+    assert size > 0
+    buffer = bytearray(size)
+    assert session.core.serialize(buffer)
+
+    report = {tag.decode(): usage(tag) for tag in TAGS}
+
+print(json.dumps(report, indent=2))
+
+assert report["Console"]["bytes"] > 0, "The console's memory wasn't charged to it"
+for tag, stats in report.items():
+    assert stats["bytes"] >= 0, f"{tag} freed more than it allocated"
+    assert stats["peak_bytes"] >= stats["bytes"], f"{tag}'s peak is below its current usage"
@@ -0,0 +1,34 @@
+import json
+import os
+from ctypes import CFUNCTYPE, c_bool, c_char_p, c_double, c_uint
+
+import prelude
+
+ITERATIONS = int(os.getenv("MELONDSDS_PERF_PIXEL_KERNEL_ITERATIONS", "50"))
+KERNELS = (b"fill", b"copy_rect", b"invert", b"swap_red_blue", b"rgb565")
+SETS = (b"scalar", b"sse2", b"avx2", b"neon")
+
+with prelude.noload_session() as session:
+    kernel_set = session.get_proc_address(b"melondsds_pixel_kernel_set", CFUNCTYPE(c_char_p))
+    kernels_match = session.get_proc_address(b"melondsds_pixel_kernels_match", CFUNCTYPE(c_bool))
+    benchmark = session.get_proc_address(b"melondsds_benchmark_pixel_kernel", CFUNCTYPE(c_double, c_char_p, c_char_p, c_uint))
+    assert kernel_set is not None
+    assert kernels_match is not None
+    assert benchmark is not None
+
+    active = kernel_set()
+    assert active in SETS, f"Unexpected kernel set {active}"
+    assert kernels_match(), "Vectorized pixel kernels don't match the scalar ones"
+
+    report = {"active": active.decode(), "iterations": ITERATIONS, "ns_per_pixel": {}}
+    for kernel in KERNELS:
+        results = {}
+        for s in SETS:
+            ns = benchmark(kernel, s, ITERATIONS)
+            if ns >= 0:
+                results[s.decode()] = ns
+
+        assert "scalar" in results, f"Scalar {kernel} kernel should always be available"
+        report["ns_per_pixel"][kernel.decode()] = results
+
+print(json.dumps(report, indent=2))
@@ -0,0 +1,106 @@
+"""
+Runs the core in benchmark mode and compares the results against a stored baseline,
+failing if it got meaningfully slower or hungrier since the baseline was recorded.
+
+The baseline for each configuration is kept in its own JSON file
+(MELONDSDS_PERF_BASELINE_DIR/MELONDSDS_PERF_BASELINE_KEY.json).
+If it doesn't exist yet (or MELONDSDS_PERF_UPDATE_BASELINE is set), this run becomes the baseline.
+Baselines are only meaningful on the machine and build type that recorded them.
+"""
+
+import json
+import os
+import sys
+from ctypes import CFUNCTYPE, POINTER, c_bool, c_char_p, c_int64, byref
+
+import prelude
+
+SKIP = 77  # Matches SKIP_RETURN_CODE in Perf.cmake
+MEMORY_TAGS = (b"Console", b"Render", b"Network", b"Config", b"Savestate", b"Other")
+MEMORY_POLL_INTERVAL = 60
+
+frames = int(os.environ["MELONDSDS_BENCHMARK_FRAMES"])
+baseline_dir = os.environ["MELONDSDS_PERF_BASELINE_DIR"]
+baseline_key = os.environ["MELONDSDS_PERF_BASELINE_KEY"]
+update_baseline = bool(os.getenv("MELONDSDS_PERF_UPDATE_BASELINE"))
+
+# How much worse than the baseline a run may be before it counts as a regression
+fps_tolerance = float(os.getenv("MELONDSDS_PERF_FPS_TOLERANCE", "0.15"))
+phase_tolerance = float(os.getenv("MELONDSDS_PERF_PHASE_TOLERANCE", "0.25"))
+phase_slack_ms = float(os.getenv("MELONDSDS_PERF_PHASE_SLACK_MS", "0.5"))  # So that tiny phases don't fail on noise
+memory_tolerance = float(os.getenv("MELONDSDS_PERF_MEMORY_TOLERANCE", "0.10"))
+
+report_path = os.path.join(prelude.testdir, b"benchmark.json")
+os.environ["MELONDSDS_BENCHMARK_REPORT"] = report_path.decode()
+
+memory = {}
+with prelude.session() as session:
+    get_usage = session.get_proc_address(
+        b"melondsds_get_memory_usage",
+        CFUNCTYPE(c_bool, c_char_p, POINTER(c_int64), POINTER(c_int64), POINTER(c_int64))
+    )
+
+    def poll_memory():
+        size, peak, count = c_int64(), c_int64(), c_int64()
+        for tag in MEMORY_TAGS:
+            if get_usage and get_usage(tag, byref(size), byref(peak), byref(count)):
+                memory[tag.decode()] = peak.value
+
+    for i in range(frames + 60):
+        if i % MEMORY_POLL_INTERVAL == 0:
+            # The core shuts itself down when the benchmark ends, so keep the latest peaks on hand
+            poll_memory()
+        session.run()
+
+    assert False, f"Core should have shut down after {frames} frames"
+
+# noinspection PyUnreachableCode
+assert session.is_shutdown
+assert os.path.isfile(report_path), f"Benchmark report wasn't written to {report_path}"
+
+with open(report_path, "r") as f:
+    report = json.load(f)
+
+result = {
+    "fps": report["fps"],
+    "phases": {name: phase["avg_ms"] for name, phase in report["phases"].items()},
+    "peak_rss_kib": report.get("peak_rss_kib"),
+    "peak_memory_bytes": memory,
+}
+print(json.dumps(result, indent=2))
+
+os.makedirs(baseline_dir, exist_ok=True)
+baseline_path = os.path.join(baseline_dir, f"{baseline_key}.json")
+if update_baseline or not os.path.isfile(baseline_path):
+    with open(baseline_path, "w") as f:
+        json.dump(result, f, indent=2)
+    print(f"Recorded a new baseline at {baseline_path}")
+    sys.exit(SKIP)
+
+with open(baseline_path, "r") as f:
+    baseline = json.load(f)
+
+regressions = []
+min_fps = baseline["fps"] * (1 - fps_tolerance)
+if result["fps"] < min_fps:
+    regressions.append(f"fps: {result['fps']:.2f} < {min_fps:.2f} (baseline {baseline['fps']:.2f})")
+
+for name, baseline_ms in baseline["phases"].items():
+    current_ms = result["phases"].get(name)
+    max_ms = baseline_ms * (1 + phase_tolerance) + phase_slack_ms
+    if current_ms is not None and current_ms > max_ms:
+        regressions.append(f"{name}: {current_ms:.3f}ms > {max_ms:.3f}ms (baseline {baseline_ms:.3f}ms)")
+
+if baseline.get("peak_rss_kib") and result["peak_rss_kib"]:
+    max_rss = baseline["peak_rss_kib"] * (1 + memory_tolerance)
+    if result["peak_rss_kib"] > max_rss:
+        regressions.append(f"peak RSS: {result['peak_rss_kib']}KiB > {max_rss:.0f}KiB (baseline {baseline['peak_rss_kib']}KiB)")
+
+for tag, baseline_bytes in baseline.get("peak_memory_bytes", {}).items():
+    current_bytes = memory.get(tag)
+    max_bytes = baseline_bytes * (1 + memory_tolerance) + 64 * 1024
+    if current_bytes is not None and current_bytes > max_bytes:
+        regressions.append(f"{tag} memory: {current_bytes}B > {max_bytes:.0f}B (baseline {baseline_bytes}B)")
+
+assert not regressions, f"Performance regressed against {baseline_path}:\n" + "\n".join(regressions)
+print(f"No regressions against {baseline_path}")
@@ -0,0 +1,67 @@
+import json
+import os
+import statistics
+import time
+
+import prelude
+
+WARMUP_FRAMES = 300
+CYCLES = int(os.getenv("MELONDSDS_PERF_SAVESTATE_CYCLES", "100"))
+MAX_P99_MS = float(os.getenv("MELONDSDS_PERF_SAVESTATE_MAX_P99_MS", "0"))
+
+
+def percentile(samples: list[float], p: float) -> float:
+    ordered = sorted(samples)
+    return ordered[min(len(ordered) - 1, int(len(ordered) * p / 100))]
+
+
+def summarize(samples: list[float]) -> dict[str, float]:
+    return {
+        "min_ms": min(samples),
+        "avg_ms": statistics.fmean(samples),
+        "p50_ms": percentile(samples, 50),
+        "p99_ms": percentile(samples, 99),
+        "max_ms": max(samples),
+    }
+
+
+with prelude.session() as session:
+    for i in range(WARMUP_FRAMES):
+        session.run()
+
+    # The first call may need to run a throwaway savestate to learn the size
+    start = time.perf_counter()
+    size = session.core.serialize_size()
+    first_size_ms = (time.perf_counter() - start) * 1000
+    assert size > 0
+
+    buffer = bytearray(size)
+    serialize_ms = []
+    unserialize_ms = []
+    for i in range(CYCLES):
+        session.run()
+
+        start = time.perf_counter()
+        assert session.core.serialize(buffer), f"Failed to save state on cycle {i}"
+        serialize_ms.append((time.perf_counter() - start) * 1000)
+
+        start = time.perf_counter()
+        assert session.core.unserialize(buffer), f"Failed to load state on cycle {i}"
+        unserialize_ms.append((time.perf_counter() - start) * 1000)
+
+    assert session.core.serialize_size() == size, "Savestate size changed during the benchmark"
+
+report = {
+    "bytes": size,
+    "cycles": CYCLES,
+    "first_serialize_size_ms": first_size_ms,
+    "serialize": summarize(serialize_ms),
+    "unserialize": summarize(unserialize_ms),
+}
+
+print(json.dumps(report, indent=2))
+
+if MAX_P99_MS > 0:
+    for name in ("serialize", "unserialize"):
+        p99 = report[name]["p99_ms"]
+        assert p99 <= MAX_P99_MS, f"p99 {name} latency of {p99:.3f}ms exceeds the {MAX_P99_MS}ms budget"
@@ -0,0 +1,40 @@
+import json
+import sys
+from ctypes import CFUNCTYPE, POINTER, c_int64, byref
+
+import prelude
+
+with prelude.session() as session:
+    get_usage = session.get_proc_address(
+        b"melondsds_get_shared_mapping_usage",
+        CFUNCTYPE(None, POINTER(c_int64), POINTER(c_int64), POINTER(c_int64), POINTER(c_int64))
+    )
+    assert get_usage is not None
+
+    for i in range(60):
+        session.run()
+
+    mappings, mapped, shared, private = c_int64(), c_int64(), c_int64(), c_int64()
+    get_usage(byref(mappings), byref(mapped), byref(shared), byref(private))
+    report = {
+        "mappings": mappings.value,
+        "mapped_bytes": mapped.value,
+        "shared_bytes": shared.value,
+        "private_bytes": private.value,
+    }
+
+print(json.dumps(report, indent=2))
+
+assert report["mappings"] >= 0
+assert (report["mapped_bytes"] > 0) == (report["mappings"] > 0), "Every mapping should cover part of a file"
+assert report["shared_bytes"] >= 0 and report["private_bytes"] >= 0
+
+# Resident pages are counted in whole pages, so allow for rounding up the last page of each file
+slack = 64 * 1024 * report["mappings"]
+assert report["shared_bytes"] + report["private_bytes"] <= report["mapped_bytes"] + slack, \
+    "More of the mapped files is resident than was mapped"
+
+if sys.platform.startswith("linux"):
+    # Linux builds always have mmap, and the content is loaded straight from a file
+    assert report["mappings"] > 0, "Expected the content to be mapped instead of copied"
+    assert report["shared_bytes"] + report["private_bytes"] > 0, "Expected Linux to report the mapped files' resident pages"
@@ -0,0 +1,38 @@
+import json
+import os
+
+import prelude
+
+# Fails the test if startup takes longer than this; 0 means no limit
+MAX_MS = float(os.getenv("MELONDSDS_PERF_STARTUP_MAX_MS", "0"))
+
+trace_path = os.path.join(prelude.testdir, b"startup.json")
+os.environ["MELONDSDS_STARTUP_TRACE"] = trace_path.decode()
+
+with prelude.session() as session:
+    for i in range(10):
+        session.run()
+
+    # The trace is written when the first frame is presented
+    assert os.path.isfile(trace_path), f"Startup trace wasn't written to {trace_path}"
+
+with open(trace_path, "r") as f:
+    trace = json.load(f)
+
+print(json.dumps(trace, indent=2))
+
+events = {e["name"]: e for e in trace["traceEvents"]}
+for stage in ("Startup", "retro_init", "retro_load_game", "InitContent", "CreateConsole"):
+    assert stage in events, f"Startup trace is missing the {stage} stage"
+
+for event in trace["traceEvents"]:
+    assert event["ph"] == "X", f"Expected a complete event, got {event}"
+    assert event["ts"] >= 0 and event["dur"] >= 0, f"Invalid timestamps in {event}"
+
+startup_ms = events["Startup"]["dur"] / 1000
+print(f"Startup took {startup_ms:.2f}ms")
+for name, event in events.items():
+    assert event["ts"] + event["dur"] <= events["Startup"]["dur"], f"{name} ended after startup did"
+
+if MAX_MS > 0:
+    assert startup_ms <= MAX_MS, f"Startup took {startup_ms:.2f}ms, budget is {MAX_MS:.2f}ms"
@@ -0,0 +1,33 @@
+import json
+import os
+from ctypes import CFUNCTYPE, POINTER, c_char_p, c_double, c_uint, c_uint64, byref
+
+import prelude
+
+ITERATIONS = int(os.getenv("MELONDSDS_PERF_SYNC_ITERATIONS", "20000"))
+BENCHMARKS = (b"semaphore", b"semaphore_reset", b"mutex")
+
+with prelude.noload_session() as session:
+    benchmark = session.get_proc_address(b"melondsds_benchmark_sync", CFUNCTYPE(c_double, c_char_p, c_uint))
+    assert benchmark is not None
+
+    get_stats = session.get_proc_address(b"melondsds_get_sync_stats", CFUNCTYPE(None, POINTER(c_uint64), POINTER(c_uint64)))
+    assert get_stats is not None
+
+    report = {"iterations": ITERATIONS, "ns_per_op": {}}
+    for name in BENCHMARKS:
+        ns = benchmark(name, ITERATIONS)
+        legacy_ns = benchmark(b"legacy_" + name, ITERATIONS)
+        assert ns != -2, f"{name} failed to exclude other threads"
+        assert ns > 0, f"{name} benchmark failed"
+        assert legacy_ns > 0, f"legacy {name} benchmark failed"
+        report["ns_per_op"][name.decode()] = {"new": ns, "legacy": legacy_ns}
+
+    assert benchmark(b"nonsense", 1) < 0, "Expected an unknown benchmark to be rejected"
+
+    spin_acquires = c_uint64()
+    waits = c_uint64()
+    get_stats(byref(spin_acquires), byref(waits))
+    report["contention"] = {"spin_acquires": spin_acquires.value, "waits": waits.value}
+
+print(json.dumps(report, indent=2))
@@ -0,0 +1,29 @@
+from libretro import Session
+
+import prelude
+
+options = {
+    b"melonds_show_cursor": b"disabled",
+    b"melonds_low_memory_mode": b"enabled",
+}
+
+session: Session
+with prelude.builder().with_options(options).build() as session:
+    for i in range(300):
+        session.run()
+
+    before_reset_frame = session.video.screenshot()
+
+    # Slot-2 devices are baked into the console, so this forces a new one to be created from the ROM,
+    # which low-memory mode freed after the first console was created
+    session.options.variables["melonds_slot2_device"] = b"rumble-pak"
+    session.core.reset()
+
+    blank_frame = None
+    for i in range(300):
+        session.core.run()
+        if blank_frame is None:
+            blank_frame = session.video.screenshot()
+
+    after_reset_frame = session.video.screenshot()
+    assert blank_frame != after_reset_frame, "Screen is still blank after recreating the console in low-memory mode"
@@ -0,0 +1,29 @@
+import glob
+import os
+
+import prelude
+
+# An hour ago, so that a rewrite can't land within the filesystem's timestamp resolution
+PAST = os.stat(prelude.save_dir).st_mtime - 3600
+
+name = os.path.splitext(os.path.basename(prelude.content_path))[0]
+pattern = os.path.join(os.fsdecode(prelude.save_dir), glob.escape(name) + ".*.sav")
+
+with prelude.session() as session:
+    # Long enough for the game to create its save data
+    for i in range(300):
+        session.run()
+
+saves = glob.glob(pattern)
+assert saves, f"Expected the game to export its save data to {pattern}"
+
+for path in saves:
+    os.utime(path, (PAST, PAST))
+
+with prelude.session() as session:
+    # Unload without running, so the game has no chance to touch its saves
+    pass
+
+for path in saves:
+    mtime = os.stat(path).st_mtime
+    assert mtime == PAST, f"Unchanged save data in {path} was rewritten on unload"